@@ -143,6 +143,8 @@ std::string ConvertUnits(const char* input_unit, std::vector<double>* vals) {
     return "unitless_biggerIsBetter";
   } else if (strcmp(input_unit, "bytes") == 0) {
     return "sizeInBytes";
+  } else if (strcmp(input_unit, "count") == 0) {
+    return "count_smallerIsBetter";
   } else {
     fprintf(stderr, "Units not recognized: %s\n", input_unit);
     exit(1);
@@ -5,8 +5,10 @@
 #include "garnet/bin/media/audio_core/audio_capturer_impl.h"
 
 #include <lib/fit/defer.h>
+#include <algorithm>
 
 #include "garnet/bin/media/audio_core/audio_core_impl.h"
+#include "garnet/bin/media/audio_core/ring_buffer_mix.h"
 #include "lib/fxl/logging.h"
 #include "lib/media/audio/types.h"
 
@@ -257,11 +259,13 @@ void AudioCapturerImpl::AddPayloadBuffer(uint32_t id, zx::vmo payload_buf_vmo) {
   payload_buf_frames_ =
       static_cast<uint32_t>(payload_buf_size_ / bytes_per_frame_);
 
-  // Allocate our intermediate buffer for mixing.
-  //
-  // TODO(johngro):  This does not need to be as long (in frames) as the user
-  // supplied VMO. Limit this to something more reasonable.
-  mix_buf_.reset(new float[payload_buf_frames_]);
+  // Allocate our intermediate buffer for mixing. We never mix more than
+  // max_frames_per_capture_ frames at a time. When we capture float samples,
+  // we mix directly into the payload buffer and this is never used.
+  if (format_->sample_format != fuchsia::media::AudioSampleFormat::FLOAT) {
+    mix_buf_.reset(new float[static_cast<size_t>(max_frames_per_capture_) *
+                             format_->channels]);
+  }
 
   // Map the VMO into our process.
   uintptr_t tmp;
@@ -651,6 +655,7 @@ zx_status_t AudioCapturerImpl::Process() {
     if (mix_target == nullptr) {
       frames_to_clock_mono_ = TimelineFunction();
       frames_to_clock_mono_gen_.Next();
+      shared_stage_ = nullptr;
       frame_count_ = 0;
       mix_timer_->Cancel();
 
@@ -672,28 +677,19 @@ zx_status_t AudioCapturerImpl::Process() {
 
     // If we have yet to establish a timeline transformation from capture frames
     // to clock monotonic, establish one now.
-    //
-    // TODO(johngro) : If we have only one capture source, and our frame rate
-    // matches their frame rate, align our start time exactly with one of their
-    // sample boundaries.
     int64_t now = zx_clock_get(ZX_CLOCK_MONOTONIC);
     if (!frames_to_clock_mono_.invertable()) {
-      // TODO(johngro) : It would be nice if we could alter the offsets in a
-      // timeline function without needing to change the scale factor. This
-      // would allow us to establish a new mapping here without needing to
-      // re-reduce the ratio between frames_per_second_ and nanoseconds every
-      // time. Since the frame rate we supply is already reduced, this step
-      // should go pretty quickly.
-      frames_to_clock_mono_ =
-          TimelineFunction(now, frame_count_, frames_to_clock_mono_rate_);
-      frames_to_clock_mono_gen_.Next();
-      FXL_DCHECK(frames_to_clock_mono_.invertable());
+      EstablishTimeline(now);
     }
 
     // Limit our job size to our max job size.
     if (mix_frames > max_frames_per_capture_) {
       mix_frames = max_frames_per_capture_;
     }
+    if ((shared_stage_ != nullptr) &&
+        (mix_frames > shared_stage_->max_read_frames())) {
+      mix_frames = shared_stage_->max_read_frames();
+    }
 
     // Now figure out what time it will be when we can finish this job If this
     // time is in the future, wait until then.
@@ -721,14 +717,21 @@ zx_status_t AudioCapturerImpl::Process() {
     }
 
     // Mix the requested number of frames from our sources to our intermediate
-    // buffer, then the intermediate buffer into our output target.
-    if (!MixToIntermediate(mix_frames)) {
+    // buffer, then the intermediate buffer into our output target. If we are
+    // capturing float samples, skip the intermediate buffer entirely: mix
+    // straight into the payload buffer and let the output producer clamp the
+    // result in place.
+    float* mix_buf =
+        (format_->sample_format == fuchsia::media::AudioSampleFormat::FLOAT)
+            ? static_cast<float*>(mix_target)
+            : mix_buf_.get();
+    if (!MixToIntermediate(mix_buf, mix_frames)) {
       ShutdownFromMixDomain();
       return ZX_ERR_INTERNAL;
     }
 
     FXL_DCHECK(output_producer_ != nullptr);
-    output_producer_->ProduceOutput(mix_buf_.get(), mix_target, mix_frames);
+    output_producer_->ProduceOutput(mix_buf, mix_target, mix_frames);
 
     // Update the pending buffer in progress, and if it is finished, send it
     // back to the user. If the buffer has been flushed (there is either no
@@ -763,9 +766,7 @@ zx_status_t AudioCapturerImpl::Process() {
           // It looks like we were flushed while we were mixing. Invalidate our
           // timeline function, we will re-establish it and flag a discontinuity
           // next time we have work to do.
-          frames_to_clock_mono_ =
-              TimelineFunction(now, frame_count_, frames_to_clock_mono_rate_);
-          frames_to_clock_mono_gen_.Next();
+          EstablishTimeline(now);
         }
       }
     }
@@ -842,7 +843,54 @@ void AudioCapturerImpl::SetMute(bool mute) {
   cleanup.cancel();
 }
 
-bool AudioCapturerImpl::MixToIntermediate(uint32_t mix_frames) {
+void AudioCapturerImpl::EstablishTimeline(int64_t now) {
+  // If we are capturing from exactly one device, try to share the work of
+  // converting its ring buffer to our format with any other capturers doing
+  // the same. To do so, we align our frame timeline with the shared stage's
+  // frame grid so that each of our frames is exactly one of its frames.
+  fbl::RefPtr<AudioDevice> device;
+  {
+    fbl::AutoLock links_lock(&links_lock_);
+    uint32_t ring_buffer_sources = 0;
+    for (auto& link : source_links_) {
+      if (link->source_type() == AudioLink::SourceType::RingBuffer) {
+        ++ring_buffer_sources;
+        device = fbl::WrapRefPtr(
+            static_cast<AudioDevice*>(link->GetSource().get()));
+      }
+    }
+
+    if (ring_buffer_sources != 1) {
+      device = nullptr;
+    }
+  }
+
+  if (device == nullptr) {
+    shared_stage_ = nullptr;
+  } else if ((shared_stage_ == nullptr) ||
+             (shared_stage_->device() != device)) {
+    shared_stage_ = SharedCaptureStage::Get(device, format_->channels,
+                                            format_->frames_per_second);
+  }
+
+  if (shared_stage_ != nullptr) {
+    const auto& stage_trans = shared_stage_->frames_to_clock_mono();
+    int64_t stage_frame = std::max<int64_t>(stage_trans.ApplyInverse(now), 0);
+    frames_to_clock_mono_ =
+        TimelineFunction(stage_trans.Apply(stage_frame), frame_count_,
+                         frames_to_clock_mono_rate_);
+    shared_stage_frame_offset_ = stage_frame - frame_count_;
+  } else {
+    frames_to_clock_mono_ =
+        TimelineFunction(now, frame_count_, frames_to_clock_mono_rate_);
+  }
+
+  frames_to_clock_mono_gen_.Next();
+  FXL_DCHECK(frames_to_clock_mono_.invertable());
+}
+
+bool AudioCapturerImpl::MixToIntermediate(float* mix_buf,
+                                          uint32_t mix_frames) {
   // Take a snapshot of our source link references; skip the packet based
   // sources, we don't know how to sample from them yet.
   FXL_DCHECK(source_link_refs_.size() == 0);
@@ -874,8 +922,8 @@ bool AudioCapturerImpl::MixToIntermediate(uint32_t mix_frames) {
       [this]() FXL_NO_THREAD_SAFETY_ANALYSIS { source_link_refs_.clear(); });
 
   // Silence our intermediate buffer.
-  size_t job_bytes = sizeof(mix_buf_[0]) * mix_frames * format_->channels;
-  ::memset(mix_buf_.get(), 0u, job_bytes);
+  size_t job_bytes = sizeof(mix_buf[0]) * mix_frames * format_->channels;
+  ::memset(mix_buf, 0u, job_bytes);
 
   // If our capturer is mute, we have nothing to do after filling with silence.
   if (mute_ || (stream_gain_db_.load() <= fuchsia::media::MUTED_GAIN_DB)) {
@@ -914,6 +962,19 @@ bool AudioCapturerImpl::MixToIntermediate(uint32_t mix_frames) {
       continue;
     }
 
+    // If our timeline is aligned with a shared conversion stage for this
+    // device, fetch our frames (scaled by this link's gain) from it instead of
+    // sampling the ring buffer ourselves.
+    if ((shared_stage_ != nullptr) &&
+        (shared_stage_->device().get() == device)) {
+      if (shared_stage_->Read(frame_count_ + shared_stage_frame_offset_,
+                              mix_frames, info->gain.GetGainScale(), mix_buf,
+                              accumulate)) {
+        accumulate = true;
+      }
+      continue;
+    }
+
     AudioDriver::RingBufferSnapshot rb_snap;
     driver->SnapshotRingBuffer(&rb_snap);
 
@@ -927,203 +988,11 @@ bool AudioCapturerImpl::MixToIntermediate(uint32_t mix_frames) {
 
     // Update clock transformation if needed.
     FXL_DCHECK(info->mixer != nullptr);
-    UpdateTransformation(info, rb_snap);
-
-    // TODO(johngro) : Much of the code after this is very similar to the logic
-    // used to sample from packet sources (we basically model it as either 1 or
-    // 2 packets, depending on which regions of the ring buffer are available to
-    // be read from). In the future, we should come back here and re-factor
-    // this in such a way that we can sample from either packets or
-    // ring-buffers, and so we can share the common logic with the output mixer
-    // logic as well.
-    //
-    // Based on what time it is now, figure out what the safe portions of the
-    // ring buffer are to read from. Because it is a ring buffer, we may end up
-    // with either one contiguous region of frames, or two contiguous regions
-    // (split across the ring boundary). Figure out the starting PTSs of these
-    // regions (expressed in fractional start frames) in the process.
-    const auto& rb = rb_snap.ring_buffer;
-    zx_time_t now = zx_clock_get(ZX_CLOCK_MONOTONIC);
-
-    int64_t end_fence_frames =
-        (info->clock_mono_to_frac_source_frames.Apply(now)) >>
-        kPtsFractionalBits;
-
-    int64_t start_fence_frames =
-        end_fence_frames - rb_snap.end_fence_to_start_fence_frames;
-    start_fence_frames = std::max<int64_t>(start_fence_frames, 0);
-    FXL_DCHECK(end_fence_frames >= 0);
-    FXL_DCHECK(end_fence_frames - start_fence_frames < rb->frames());
-
-    struct {
-      uint32_t srb_pos;   // start ring buffer pos
-      uint32_t len;       // region length in frames
-      int64_t sfrac_pts;  // start fractional frame pts
-    } regions[2];
-
-    uint32_t start_frames_mod =
-        static_cast<uint32_t>(start_fence_frames % rb->frames());
-    uint32_t end_frames_mod =
-        static_cast<uint32_t>(end_fence_frames % rb->frames());
-
-    if (start_frames_mod <= end_frames_mod) {
-      // One region
-      regions[0].srb_pos = start_frames_mod;
-      regions[0].len = end_frames_mod - start_frames_mod;
-      regions[0].sfrac_pts = start_fence_frames << kPtsFractionalBits;
-
-      regions[1].len = 0;
-    } else {
-      // Two regions
-      regions[0].srb_pos = start_frames_mod;
-      regions[0].len = rb->frames() - start_frames_mod;
-      regions[0].sfrac_pts = start_fence_frames << kPtsFractionalBits;
-
-      regions[1].srb_pos = 0;
-      regions[1].len = end_frames_mod;
-      regions[1].sfrac_pts =
-          regions[0].sfrac_pts + (regions[0].len << kPtsFractionalBits);
-    }
-
-    uint32_t frames_left = mix_frames;
-    float* buf = mix_buf_.get();
+    UpdateRingBufferTransformation(info, rb_snap, frames_to_clock_mono_,
+                                   frames_to_clock_mono_gen_.get());
 
-    // Now for each of the possible regions, intersect with our job and mix.
-    for (const auto& region : regions) {
-      // If we encounter a region of zero length, we are done.
-      if (region.len == 0) {
-        break;
-      }
-
-      // Figure out where the first and last sampling points of this job are,
-      // expressed in fractional source frames
-      FXL_DCHECK(frames_left > 0);
-      const auto& trans = info->dest_frames_to_frac_source_frames;
-      int64_t job_start = trans.Apply(frame_count_ + mix_frames - frames_left);
-      int64_t job_end = job_start + trans.rate().Scale(frames_left - 1);
-
-      // Figure out the PTS of the final frame of audio in our source region
-      int64_t efrac_pts = region.sfrac_pts + (region.len << kPtsFractionalBits);
-      FXL_DCHECK((efrac_pts - region.sfrac_pts) >= Mixer::FRAC_ONE);
-      int64_t final_pts = efrac_pts - Mixer::FRAC_ONE;
-
-      // If the PTS of the final frame of audio in our source region is before
-      // the negative window edge of our filter centered at our job's first
-      // sampling point, then this source region is entirely in the past and may
-      // be skipped.
-      if (final_pts < (job_start - info->mixer->neg_filter_width())) {
-        continue;
-      }
-
-      // If the PTS of the first frame of audio in our source region is after
-      // the positive window edge of our filter centered at our job's sampling
-      // point, then source region is entirely in the future and we are done.
-      if (region.sfrac_pts > (job_end + info->mixer->pos_filter_width())) {
-        break;
-      }
-
-      // Looks like the contents of this source region intersect our mixer's
-      // filter. Compute where in the intermediate buffer the first sample will
-      // be produced, as well as where, relative to the start of the source
-      // region, this sample will be taken from.
-      int64_t source_offset_64 = job_start - region.sfrac_pts;
-      int64_t output_offset_64 = 0;
-      int64_t first_sample_pos_window_edge =
-          job_start + info->mixer->pos_filter_width();
-
-      const TimelineRate& dest_to_src =
-          info->dest_frames_to_frac_source_frames.rate();
-      // If first frame in this source region comes after positive edge of
-      // filter window, we must skip output frames before producing data.
-      if (region.sfrac_pts > first_sample_pos_window_edge) {
-        int64_t src_to_skip = region.sfrac_pts - first_sample_pos_window_edge;
-
-        // "+subject_delta-1" so that we 'round up' any fractional leftover.
-        output_offset_64 = dest_to_src.Inverse().Scale(
-            src_to_skip + dest_to_src.subject_delta() - 1);
-        source_offset_64 += dest_to_src.Scale(output_offset_64);
-      }
-
-      FXL_DCHECK(output_offset_64 >= 0);
-      FXL_DCHECK(output_offset_64 < static_cast<int64_t>(mix_frames));
-      FXL_DCHECK(source_offset_64 <= std::numeric_limits<int32_t>::max());
-      FXL_DCHECK(source_offset_64 >= std::numeric_limits<int32_t>::min());
-
-      uint32_t region_frac_frame_len = region.len << kPtsFractionalBits;
-      uint32_t output_offset = static_cast<uint32_t>(output_offset_64);
-      int32_t frac_source_offset = static_cast<int32_t>(source_offset_64);
-
-      FXL_DCHECK(frac_source_offset <
-                 static_cast<int32_t>(region_frac_frame_len));
-
-      const uint8_t* region_source =
-          rb->virt() + (region.srb_pos * rb->frame_size());
-
-      // Invalidate the region of the cache we are just about to read on
-      // architectures who require it.
-      //
-      // TODO(johngro): Optimize this. In particular...
-      // 1) When we have multiple clients of this ring buffer, it would be good
-      //    not to invalidate what has already been invalidated.
-      // 2) If our driver's ring buffer is not being fed directly from hardware,
-      //    there is no reason to invalidate the cache here.
-      //
-      // Also, at some point I need to come back and double check that the
-      // mixer's filter width is being accounted for properly here.
-      FXL_DCHECK(output_offset <= frames_left);
-      uint64_t cache_target_frac_frames =
-          dest_to_src.Scale(frames_left - output_offset);
-      uint32_t cache_target_frames =
-          ((cache_target_frac_frames - 1) >> kPtsFractionalBits) + 1;
-      cache_target_frames = std::min(cache_target_frames, region.len);
-      zx_cache_flush(region_source, cache_target_frames * rb->frame_size(),
-                     ZX_CACHE_FLUSH_DATA | ZX_CACHE_FLUSH_INVALIDATE);
-
-      // Looks like we are ready to go. Mix.
-      // TODO(mpuryear): integrate bookkeeping into the Mixer itself (MTWN-129).
-      //
-      // When calling Mix(), we communicate the resampling rate with three
-      // parameters. We augment frac_step_size with rate_modulo and denominator
-      // arguments that capture the remaining rate component that cannot be
-      // expressed by a 19.13 fixed-point step_size. Note: frac_step_size and
-      // frac_input_offset use the same format -- they have the same limitations
-      // in what they can and cannot communicate. This begs two questions:
-      //
-      // Q1: For perfect position accuracy, just as we track incoming/outgoing
-      // fractional source offset, wouldn't we also need a src_pos_modulo?
-      // A1: Yes, for optimum position accuracy (within quantization limits), we
-      // SHOULD incorporate the ongoing subframe_position_modulo in this way.
-      //
-      // For now, we are deferring this work, tracking it with MTWN-128.
-      //
-      // Q2: Why did we solve this issue for rate but not for initial position?
-      // A2: We solved this issue for *rate* because its effect accumulates over
-      // time, causing clearly measurable distortion that becomes crippling with
-      // larger jobs. For *position*, there is no accumulated magnification over
-      // time -- in analyzing the distortion that this should cause, mix job
-      // size would affect the distortion frequency but not amplitude. We expect
-      // the effects to be below audible thresholds. Until the effects are
-      // measurable and attributable to this jitter, we will defer this work.
-      //
-      // Update: src_pos_modulo is added to Mix(), but for now we omit it here.
-      bool consumed_source = info->mixer->Mix(
-          buf, frames_left, &output_offset, region_source,
-          region_frac_frame_len, &frac_source_offset, accumulate, info);
-      FXL_DCHECK(output_offset <= frames_left);
-
-      if (!consumed_source) {
-        // Looks like we didn't consume all of this region. Assert that we
-        // have produced all of our frames and we are done.
-        FXL_DCHECK(output_offset == frames_left);
-        break;
-      }
-
-      buf += output_offset * format_->channels;
-      frames_left -= output_offset;
-      if (!frames_left) {
-        break;
-      }
-    }
+    MixFromRingBuffer(rb_snap, info, frame_count_, mix_frames,
+                      format_->channels, mix_buf, accumulate);
 
     // We have now added something to the intermediate mix buffer. For our next
     // source to process, we cannot assume that it is just silence. Set the
@@ -1134,50 +1003,6 @@ bool AudioCapturerImpl::MixToIntermediate(uint32_t mix_frames) {
   return true;
 }
 
-void AudioCapturerImpl::UpdateTransformation(
-    Bookkeeping* info, const AudioDriver::RingBufferSnapshot& rb_snap) {
-  FXL_DCHECK(info != nullptr);
-
-  if ((info->dest_trans_gen_id == frames_to_clock_mono_gen_.get()) &&
-      (info->source_trans_gen_id == rb_snap.gen_id)) {
-    return;
-  }
-
-  FXL_DCHECK(rb_snap.ring_buffer != nullptr);
-  FXL_DCHECK(rb_snap.ring_buffer->frame_size() != 0);
-  FXL_DCHECK(rb_snap.clock_mono_to_ring_pos_bytes.invertable());
-
-  TimelineRate src_bytes_to_frac_frames(1u << kPtsFractionalBits,
-                                        rb_snap.ring_buffer->frame_size());
-
-  auto src_clock_mono_to_ring_pos_frac_frames =
-      TimelineFunction::Compose(TimelineFunction(src_bytes_to_frac_frames),
-                                rb_snap.clock_mono_to_ring_pos_bytes);
-
-  info->dest_frames_to_frac_source_frames = TimelineFunction::Compose(
-      src_clock_mono_to_ring_pos_frac_frames, frames_to_clock_mono_);
-
-  int64_t offset = static_cast<int64_t>(rb_snap.position_to_end_fence_frames);
-
-  info->clock_mono_to_frac_source_frames = TimelineFunction::Compose(
-      TimelineFunction(-offset, 0, TimelineRate(1u, 1u)),
-      src_clock_mono_to_ring_pos_frac_frames);
-
-  int64_t tmp_step_size =
-      info->dest_frames_to_frac_source_frames.rate().Scale(1);
-  FXL_DCHECK(tmp_step_size >= 0);
-  FXL_DCHECK(tmp_step_size <= std::numeric_limits<uint32_t>::max());
-  info->step_size = static_cast<uint32_t>(tmp_step_size);
-  info->denominator = info->SnapshotDenominatorFromDestTrans();
-  info->rate_modulo =
-      info->dest_frames_to_frac_source_frames.rate().subject_delta() -
-      (info->denominator * info->step_size);
-
-  FXL_DCHECK(info->denominator > 0);
-  info->dest_trans_gen_id = frames_to_clock_mono_gen_.get();
-  info->source_trans_gen_id = rb_snap.gen_id;
-}
-
 void AudioCapturerImpl::DoStopAsyncCapture() {
   // If this is being called, we had better be in the async stopping state.
   FXL_DCHECK(state_.load() == State::AsyncStopping);
@@ -1207,6 +1032,7 @@ void AudioCapturerImpl::DoStopAsyncCapture() {
   // Invalidate our clock transformation (our next packet will be discontinuous)
   frames_to_clock_mono_ = TimelineFunction();
   frames_to_clock_mono_gen_.Next();
+  shared_stage_ = nullptr;
 
   // If we had a timer set, make sure that it is canceled. There is no point in
   // having it armed right now as we are in the process of stopping.
@@ -18,6 +18,7 @@
 #include "garnet/bin/media/audio_core/audio_object.h"
 #include "garnet/bin/media/audio_core/mixer/mixer.h"
 #include "garnet/bin/media/audio_core/mixer/output_producer.h"
+#include "garnet/bin/media/audio_core/shared_capture_stage.h"
 #include "garnet/bin/media/audio_core/utils.h"
 #include "lib/fidl/cpp/binding.h"
 #include "lib/media/timeline/timeline_function.h"
@@ -167,10 +168,9 @@ class AudioCapturerImpl
 
   // Methods used by capture/mixer thread(s). Must be called from mix_domain.
   zx_status_t Process() FXL_EXCLUSIVE_LOCKS_REQUIRED(mix_domain_->token());
-  bool MixToIntermediate(uint32_t mix_frames)
+  bool MixToIntermediate(float* mix_buf, uint32_t mix_frames)
       FXL_EXCLUSIVE_LOCKS_REQUIRED(mix_domain_->token());
-  void UpdateTransformation(Bookkeeping* bk,
-                            const AudioDriver::RingBufferSnapshot& rb_snap)
+  void EstablishTimeline(int64_t now)
       FXL_EXCLUSIVE_LOCKS_REQUIRED(mix_domain_->token());
   void DoStopAsyncCapture() FXL_EXCLUSIVE_LOCKS_REQUIRED(mix_domain_->token());
   bool QueueNextAsyncPendingBuffer()
@@ -244,6 +244,12 @@ class AudioCapturerImpl
   GenerationId frames_to_clock_mono_gen_ FXL_GUARDED_BY(mix_domain_->token());
   int64_t frame_count_ FXL_GUARDED_BY(mix_domain_->token()) = 0;
 
+  // When we capture from a single device, the shared conversion stage we read
+  // from, and the difference between its frame numbers and ours.
+  std::shared_ptr<SharedCaptureStage> shared_stage_
+      FXL_GUARDED_BY(mix_domain_->token());
+  int64_t shared_stage_frame_offset_ FXL_GUARDED_BY(mix_domain_->token()) = 0;
+
   uint32_t async_frames_per_packet_;
   uint32_t async_next_frame_offset_ FXL_GUARDED_BY(mix_domain_->token()) = 0;
   StopAsyncCaptureCallback pending_async_stop_cbk_;
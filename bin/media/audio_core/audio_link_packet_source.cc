@@ -4,6 +4,9 @@
 
 #include "garnet/bin/media/audio_core/audio_link_packet_source.h"
 
+#include <algorithm>
+#include <limits>
+
 #include "garnet/bin/media/audio_core/audio_object.h"
 #include "garnet/bin/media/audio_core/audio_renderer_format_info.h"
 #include "garnet/bin/media/audio_core/audio_renderer_impl.h"
@@ -108,8 +111,9 @@ void AudioLinkPacketSource::CopyPendingQueue(
   pending_packet_queue_ = other->pending_packet_queue_;
 }
 
-fbl::RefPtr<AudioPacketRef> AudioLinkPacketSource::LockPendingQueueFront(
-    bool* was_flushed) {
+bool AudioLinkPacketSource::LockPendingQueueFront(PacketSpan* span,
+                                                  bool* was_flushed) {
+  FXL_DCHECK(span);
   FXL_DCHECK(was_flushed);
   std::lock_guard<std::mutex> locker(pending_mutex_);
 
@@ -119,14 +123,59 @@ fbl::RefPtr<AudioPacketRef> AudioLinkPacketSource::LockPendingQueueFront(
   *was_flushed = flushed_;
   flushed_ = false;
 
-  if (pending_packet_queue_.size()) {
-    return pending_packet_queue_.front();
-  } else {
-    return nullptr;
+  if (pending_packet_queue_.empty()) {
+    return false;
+  }
+
+  // Start with the front packet, then extend the span for as long as the
+  // following packets continue it (and it stays short enough for the mixer to
+  // address with a signed 32-bit fractional frame offset).
+  auto& front = pending_packet_queue_.front();
+  span->payload = front->payload();
+  span->start_pts = front->start_pts();
+  span->end_pts = front->end_pts();
+  span->frac_frame_len = front->frac_frame_len();
+  span->packet_count = 1;
+
+  size_t limit = std::min(pending_packet_queue_.size(), kMaxSpanPackets);
+  while (span->packet_count < limit) {
+    const auto& pkt = pending_packet_queue_[span->packet_count];
+    uint64_t len = static_cast<uint64_t>(span->frac_frame_len) +
+                   pkt->frac_frame_len();
+    if (!pkt->continues_previous() ||
+        (len > static_cast<uint64_t>(std::numeric_limits<int32_t>::max()))) {
+      break;
+    }
+
+    FXL_DCHECK(pkt->start_pts() == span->end_pts);
+    span->end_pts = pkt->end_pts();
+    span->frac_frame_len = static_cast<uint32_t>(len);
+    ++span->packet_count;
+  }
+
+  return true;
+}
+
+size_t AudioLinkPacketSource::CountLockedPacketsEndingBy(int64_t pts) const {
+  std::lock_guard<std::mutex> locker(pending_mutex_);
+  FXL_DCHECK(processing_in_progress_);
+
+  // If a flush happened while we were processing, the packets we locked are no
+  // longer in the pending queue, and there is nothing left to release.
+  if (flushed_) {
+    return 0;
   }
+
+  size_t count = 0;
+  size_t limit = std::min(pending_packet_queue_.size(), kMaxSpanPackets);
+  while ((count < limit) && (pending_packet_queue_[count]->end_pts() <= pts)) {
+    ++count;
+  }
+
+  return count;
 }
 
-void AudioLinkPacketSource::UnlockPendingQueueFront(bool release_packet) {
+void AudioLinkPacketSource::UnlockPendingQueueFront(size_t release_count) {
   {
     std::lock_guard<std::mutex> locker(pending_mutex_);
     FXL_DCHECK(processing_in_progress_);
@@ -151,15 +200,11 @@ void AudioLinkPacketSource::UnlockPendingQueueFront(bool release_packet) {
       return;
     }
 
-    // If the sink wants us to release the front of the pending queue, and no
-    // flush operation happened while they were processing, then there had
-    // better be a packet at the front of the queue to release.
-
-    // Assert that the user either got no packet when they locked the queue
-    // (because the queue was empty), or that they got the front of the queue
-    // and that the front of the queue has not changed.
-    FXL_DCHECK(!release_packet || !pending_packet_queue_.empty());
-    if (release_packet) {
+    // If the sink wants us to release packets from the front of the pending
+    // queue, and no flush operation happened while they were processing, then
+    // those packets had better still be at the front of the queue.
+    FXL_DCHECK(release_count <= pending_packet_queue_.size());
+    while (release_count--) {
       pending_packet_queue_.pop_front();
     }
   }
@@ -23,6 +23,23 @@ namespace audio {
 //
 class AudioLinkPacketSource : public AudioLink {
  public:
+  // A run of packets at the front of the pending queue, each of which continues
+  // the one before it both in presentation time and in the payload buffer.
+  // Destinations mix a span as if it were a single packet, which keeps the
+  // per-packet overhead out of the mix loop when clients send many small
+  // packets.
+  struct PacketSpan {
+    void* payload = nullptr;
+    int64_t start_pts = 0;
+    int64_t end_pts = 0;
+    uint32_t frac_frame_len = 0;
+    size_t packet_count = 0;
+  };
+
+  // The maximum number of packets coalesced into a single span. This bounds
+  // the work done while holding the pending queue lock.
+  static constexpr size_t kMaxSpanPackets = 64;
+
   static std::shared_ptr<AudioLinkPacketSource> Create(
       fbl::RefPtr<AudioObject> source, fbl::RefPtr<AudioObject> dest);
   ~AudioLinkPacketSource() override;
@@ -55,17 +72,25 @@ class AudioLinkPacketSource : public AudioLink {
   // source.
   //
   // When consuming audio, destinations must always pair their calls to
-  // LockPendingQueueFront and UnlockPendingQueueFront, passing the pointer to
-  // the reference to the front of the queue they obtained in the process (even
-  // if the front of the queue was nullptr).
+  // LockPendingQueueFront and UnlockPendingQueueFront (even if the queue was
+  // empty). LockPendingQueueFront returns false if the queue is empty, and
+  // otherwise describes the longest span of packets at the front of the queue
+  // which may be mixed as one. UnlockPendingQueueFront releases the first
+  // |release_count| packets of that span.
   //
   // Doing so ensures that sources which are attempting to flush the pending
   // queue are forced to wait if the front of the queue is involved in a mixing
   // operation.  This, in turn, guarantees that audio packets are always
   // returned to the user in the order which they were queued in without forcing
   // AudioRenderers to wait to queue new data if a mix operation is in progress.
-  fbl::RefPtr<AudioPacketRef> LockPendingQueueFront(bool* was_flushed);
-  void UnlockPendingQueueFront(bool release_packet);
+  bool LockPendingQueueFront(PacketSpan* span, bool* was_flushed);
+  void UnlockPendingQueueFront(size_t release_count);
+
+  // While the front of the queue is locked, count the packets at the start of
+  // the locked span whose end_pts is at or before |pts|. Destinations use this
+  // to release the packets they have finished with when they could only
+  // consume part of a span.
+  size_t CountLockedPacketsEndingBy(int64_t pts) const;
 
  private:
   AudioLinkPacketSource(fbl::RefPtr<AudioObject> source,
@@ -14,14 +14,15 @@ AudioPacketRef::AudioPacketRef(
     fbl::RefPtr<fzl::RefCountedVmoMapper> vmo_ref,
     fuchsia::media::AudioRenderer::SendPacketCallback callback,
     fuchsia::media::StreamPacket packet, AudioCoreImpl* service,
-    uint32_t frac_frame_len, int64_t start_pts)
+    uint32_t frac_frame_len, int64_t start_pts, bool continues_previous)
     : vmo_ref_(std::move(vmo_ref)),
       callback_(std::move(callback)),
       packet_(std::move(packet)),
       service_(service),
       frac_frame_len_(frac_frame_len),
       start_pts_(start_pts),
-      end_pts_(start_pts + frac_frame_len) {
+      end_pts_(start_pts + frac_frame_len),
+      continues_previous_(continues_previous) {
   FXL_DCHECK(service_);
   FXL_DCHECK(vmo_ref_ != nullptr);
 }
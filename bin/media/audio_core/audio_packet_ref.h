@@ -32,7 +32,8 @@ class AudioPacketRef
   AudioPacketRef(fbl::RefPtr<fzl::RefCountedVmoMapper> vmo_ref,
                  fuchsia::media::AudioRenderer::SendPacketCallback callback,
                  fuchsia::media::StreamPacket packet, AudioCoreImpl* server,
-                 uint32_t frac_frame_len, int64_t start_pts);
+                 uint32_t frac_frame_len, int64_t start_pts,
+                 bool continues_previous);
 
   // Accessors for starting and ending presentation time stamps expressed in
   // units of audio frames (note, not media time), as signed 50.13 fixed point
@@ -56,6 +57,11 @@ class AudioPacketRef
   int64_t end_pts() const { return end_pts_; }
   uint32_t frac_frame_len() const { return frac_frame_len_; }
 
+  // True if this packet picks up exactly where the packet sent before it left
+  // off, both on the presentation timeline and in the payload buffer. Runs of
+  // such packets may be mixed as if they were a single packet.
+  bool continues_previous() const { return continues_previous_; }
+
   void Cleanup() {
     FXL_DCHECK(callback_ != nullptr);
     callback_();
@@ -87,6 +93,7 @@ class AudioPacketRef
   uint32_t frac_frame_len_;
   int64_t start_pts_;
   int64_t end_pts_;
+  bool continues_previous_;
   bool was_recycled_ = false;
 
  private:
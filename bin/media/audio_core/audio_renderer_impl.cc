@@ -303,6 +303,7 @@ void AudioRendererImpl::AddPayloadBuffer(uint32_t id, zx::vmo payload_buffer) {
   // once teisenbe@ provides guidance on the best-practice for doing this.
   zx_status_t res;
   payload_buffer_ = fbl::AdoptRef(new fzl::RefCountedVmoMapper());
+  next_payload_offset_valid_ = false;
   res = payload_buffer_->Map(payload_buffer, 0, 0, ZX_VM_PERM_READ);
   if (res != ZX_OK) {
     FXL_LOG(ERROR) << "Failed to map payload buffer (res = " << res << ")";
@@ -464,10 +465,20 @@ void AudioRendererImpl::SendPacket(fuchsia::media::StreamPacket packet,
   constexpr auto mask = ~((static_cast<int64_t>(1) << kPtsFractionalBits) - 1);
   start_pts &= mask;
 
+  // If this packet starts exactly where the previous one ended, both in time
+  // and in the payload buffer, flag it so that our destinations can mix the two
+  // as one.
+  bool continues_previous =
+      next_payload_offset_valid_ && (start_pts == next_frac_frame_pts_) &&
+      (packet.payload_offset == next_payload_offset_) &&
+      !(packet.flags & fuchsia::media::STREAM_PACKET_FLAG_DISCONTINUITY);
+  next_payload_offset_ = end;
+  next_payload_offset_valid_ = true;
+
   // Create the packet.
   auto packet_ref = fbl::AdoptRef(new AudioPacketRef(
       payload_buffer_, std::move(callback), std::move(packet), owner_,
-      frame_count << kPtsFractionalBits, start_pts));
+      frame_count << kPtsFractionalBits, start_pts, continues_previous));
 
   // The end pts is the value we will use for the next packet's start PTS, if
   // the user does not provide an explicit PTS.
@@ -519,6 +530,7 @@ void AudioRendererImpl::DiscardAllPackets(DiscardAllPacketsCallback callback) {
   // Invalidate any internal state which gets reset after a flush.
   next_frac_frame_pts_ = 0;
   pts_to_frac_frames_valid_ = false;
+  next_payload_offset_valid_ = false;
   pause_time_frac_frames_valid_ = false;
 }
 
@@ -164,6 +164,11 @@ class AudioRendererImpl
   bool pts_continuity_threshold_set_ = false;
   int64_t pts_continuity_threshold_frac_frame_ = 0;
 
+  // Packet coalescing state. The payload offset at which a packet would need
+  // to start in order to be contiguous with the previous packet (if any).
+  uint64_t next_payload_offset_ = 0;
+  bool next_payload_offset_valid_ = false;
+
   // Play/Pause state
   int64_t pause_time_frac_frames_;
   bool pause_time_frac_frames_valid_ = false;
@@ -0,0 +1,133 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "garnet/bin/media/audio_core/capture_frame_cache.h"
+
+#include <string.h>
+#include <algorithm>
+
+#include "lib/fxl/logging.h"
+
+namespace media {
+namespace audio {
+
+CaptureFrameCache::CaptureFrameCache(uint32_t channels,
+                                     uint32_t capacity_frames,
+                                     ConvertFunc convert)
+    : channels_(channels),
+      capacity_frames_(capacity_frames),
+      convert_(std::move(convert)),
+      frames_(new float[static_cast<size_t>(capacity_frames) * channels]) {
+  FXL_DCHECK(channels_ > 0);
+  FXL_DCHECK(capacity_frames_ > 0);
+  FXL_DCHECK(convert_);
+}
+
+void CaptureFrameCache::Read(int64_t frame, uint32_t frames,
+                             Gain::AScale scale, float* dest,
+                             bool accumulate) {
+  FXL_DCHECK(frame >= 0);
+  FXL_DCHECK(frames <= capacity_frames_);
+  FXL_DCHECK(dest != nullptr);
+
+  int64_t end_frame = frame + frames;
+  if (end_frame > end_) {
+    // We can only extend the cached run forward. If this request starts before
+    // it, or is so far ahead of it that converting the frames in between would
+    // evict all of them anyway, start over at the requested frame.
+    if ((frame < start_) || (end_frame - end_ > capacity_frames_)) {
+      start_ = frame;
+      end_ = frame;
+    }
+    Fill(end_frame);
+  }
+
+  // Copy out what is cached, and produce silence for the rest.
+  while (frame < end_frame) {
+    int64_t todo_end;
+    bool cached = false;
+    if (frame < start_) {
+      todo_end = std::min(end_frame, start_);
+    } else if (frame < end_) {
+      todo_end = std::min(end_frame, end_);
+      cached = true;
+    } else {
+      todo_end = end_frame;
+    }
+
+    uint32_t todo = static_cast<uint32_t>(todo_end - frame);
+    if (cached) {
+      CopyOut(frame, todo, scale, dest, accumulate);
+    } else if (!accumulate) {
+      ::memset(dest, 0, todo * channels_ * sizeof(*dest));
+    }
+
+    dest += todo * channels_;
+    frame = todo_end;
+  }
+}
+
+void CaptureFrameCache::Fill(int64_t end_frame) {
+  FXL_DCHECK(end_frame > end_);
+
+  while (end_ < end_frame) {
+    uint32_t offset = static_cast<uint32_t>(end_ % capacity_frames_);
+    uint32_t todo = static_cast<uint32_t>(
+        std::min<int64_t>(end_frame - end_, capacity_frames_ - offset));
+
+    Converted converted =
+        convert_(end_, todo, frames_.get() + (offset * channels_));
+    FXL_DCHECK(converted.offset <= todo);
+    FXL_DCHECK(converted.frames <= todo - converted.offset);
+
+    // Frames which are no longer available break the cached run; it starts
+    // over after them.
+    if (converted.offset > 0) {
+      start_ = end_ + converted.offset;
+    }
+    end_ += converted.offset + converted.frames;
+
+    // We just overwrote the oldest frames in the cache (if any).
+    start_ = std::max<int64_t>(start_, end_ - capacity_frames_);
+
+    // Stop at the first frame which is not available yet.
+    if (converted.offset + converted.frames < todo) {
+      break;
+    }
+  }
+}
+
+void CaptureFrameCache::CopyOut(int64_t frame, uint32_t frames,
+                                Gain::AScale scale, float* dest,
+                                bool accumulate) const {
+  FXL_DCHECK(frame >= start_);
+  FXL_DCHECK(frame + frames <= end_);
+
+  // The requested frames may wrap around the end of the cache.
+  while (frames > 0) {
+    uint32_t offset = static_cast<uint32_t>(frame % capacity_frames_);
+    uint32_t todo = std::min(frames, capacity_frames_ - offset);
+    const float* src = frames_.get() + (offset * channels_);
+    uint32_t samples = todo * channels_;
+
+    if (accumulate) {
+      for (uint32_t i = 0; i < samples; ++i) {
+        dest[i] += src[i] * scale;
+      }
+    } else if (scale == Gain::kUnityScale) {
+      ::memcpy(dest, src, samples * sizeof(*dest));
+    } else {
+      for (uint32_t i = 0; i < samples; ++i) {
+        dest[i] = src[i] * scale;
+      }
+    }
+
+    dest += samples;
+    frame += todo;
+    frames -= todo;
+  }
+}
+
+}  // namespace audio
+}  // namespace media
@@ -0,0 +1,85 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef GARNET_BIN_MEDIA_AUDIO_CORE_CAPTURE_FRAME_CACHE_H_
+#define GARNET_BIN_MEDIA_AUDIO_CORE_CAPTURE_FRAME_CACHE_H_
+
+#include <lib/fit/function.h>
+#include <stdint.h>
+
+#include <memory>
+
+#include "garnet/bin/media/audio_core/mixer/gain.h"
+
+namespace media {
+namespace audio {
+
+// A CaptureFrameCache holds the most recently converted float frames of a
+// SharedCaptureStage, indexed by stage frame number, so that each frame is
+// converted once no matter how many capturers read it.
+//
+// The cache only ever holds frames which were actually converted; it covers
+// the single contiguous run [start(), end()). Frames which could not be
+// converted (because they are no longer, or are not yet, in the ring buffer's
+// safe region) are produced as silence for the read which asked for them, but
+// are never cached, so a later read of the same frames tries again.
+//
+// A read which starts ahead of the cached run converts forward from end()
+// rather than starting over, as long as the cache can hold all of it. The
+// frames in between are the ones that lagging readers are about to ask for.
+//
+// This class is not thread safe; SharedCaptureStage serializes access to it.
+class CaptureFrameCache {
+ public:
+  // The run of frames produced by a ConvertFunc, relative to the first frame
+  // it was asked for. Frames before the run are no longer available and will
+  // never be, while frames after it are not available yet. An |offset| equal
+  // to the number of frames asked for means that none of them are available
+  // any more.
+  struct Converted {
+    uint32_t offset = 0;
+    uint32_t frames = 0;
+  };
+
+  // Converts the |frames| frames starting at stage frame |frame| into |buf|,
+  // and returns the run of them which it actually produced.
+  using ConvertFunc =
+      fit::function<Converted(int64_t frame, uint32_t frames, float* buf)>;
+
+  CaptureFrameCache(uint32_t channels, uint32_t capacity_frames,
+                    ConvertFunc convert);
+
+  uint32_t channels() const { return channels_; }
+  uint32_t capacity_frames() const { return capacity_frames_; }
+  int64_t start() const { return start_; }
+  int64_t end() const { return end_; }
+
+  // Produce the |frames| frames starting at stage frame |frame| into |dest|,
+  // scaling by |scale| and either accumulating into or overwriting what is
+  // already there. Frames which are not cached yet are converted first.
+  // |frames| must be no larger than capacity_frames().
+  void Read(int64_t frame, uint32_t frames, Gain::AScale scale, float* dest,
+            bool accumulate);
+
+ private:
+  // Convert the frames [end_, end_frame) into the cache, stopping early at the
+  // first frame which cannot be converted yet.
+  void Fill(int64_t end_frame);
+
+  // Copy |frames| cached frames starting at |frame| into |dest|.
+  void CopyOut(int64_t frame, uint32_t frames, Gain::AScale scale, float* dest,
+               bool accumulate) const;
+
+  const uint32_t channels_;
+  const uint32_t capacity_frames_;
+  ConvertFunc convert_;
+  std::unique_ptr<float[]> frames_;
+  int64_t start_ = 0;
+  int64_t end_ = 0;
+};
+
+}  // namespace audio
+}  // namespace media
+
+#endif  // GARNET_BIN_MEDIA_AUDIO_CORE_CAPTURE_FRAME_CACHE_H_
@@ -27,6 +27,10 @@ static constexpr fuchsia::media::AudioSampleFormat kDefaultAudioFmt =
     fuchsia::media::AudioSampleFormat::SIGNED_24_IN_32;
 static constexpr int64_t kDefaultLowWaterNsec = ZX_MSEC(20);
 static constexpr int64_t kDefaultHighWaterNsec = ZX_MSEC(30);
+static constexpr int64_t kMinHighWaterNsec = ZX_MSEC(5);
+static constexpr int64_t kMinWakeupPeriodNsec = ZX_MSEC(2);
+static constexpr int64_t kSchedSafetyMarginNsec = ZX_MSEC(1);
+static constexpr uint32_t kSchedWindowCycles = 200;
 static constexpr int64_t kDefaultMaxRetentionNsec = ZX_MSEC(60);
 static constexpr int64_t kDefaultRetentionGapNsec = ZX_MSEC(10);
 static constexpr zx_duration_t kUnderflowCooldown = ZX_SEC(1);
@@ -39,9 +43,23 @@ fbl::RefPtr<AudioOutput> DriverOutput::Create(zx::channel stream_channel,
   return fbl::AdoptRef(new DriverOutput(manager, fbl::move(stream_channel)));
 }
 
+// We start out mixing with the default (conservative) high and low water
+// marks, and let the scheduler bring them down as far as the measured wakeup
+// latency and mix job duration on this system allow.
+static MixScheduler::Config DriverOutputSchedConfig() {
+  MixScheduler::Config config;
+  config.min_lead = kMinHighWaterNsec;
+  config.max_lead = kDefaultHighWaterNsec;
+  config.min_period = kMinWakeupPeriodNsec;
+  config.max_period = kDefaultHighWaterNsec - kDefaultLowWaterNsec;
+  config.safety_margin = kSchedSafetyMarginNsec;
+  config.window_cycles = kSchedWindowCycles;
+  return config;
+}
+
 DriverOutput::DriverOutput(AudioDeviceManager* manager,
                            zx::channel initial_stream_channel)
-    : StandardOutputBase(manager),
+    : StandardOutputBase(manager, DriverOutputSchedConfig()),
       initial_stream_channel_(fbl::move(initial_stream_channel)) {}
 
 DriverOutput::~DriverOutput() { wav_writer_.Close(); }
@@ -153,6 +171,9 @@ bool DriverOutput::StartMixJob(MixJob* job, fxl::TimePoint process_start) {
             << ") mSec.  Cooling down for at least "
             << kUnderflowCooldown / 1000000.0 << " mSec.";
 
+        mix_scheduler_.OnUnderflow();
+        FXL_LOG(INFO) << "Mix scheduler: " << mix_scheduler_.GetStats();
+
         underflow_start_time_ = now;
         output_producer_->FillWithSilence(rb.virt(), rb.frames());
         zx_cache_flush(rb.virt(), rb.size(), ZX_CACHE_FLUSH_DATA);
@@ -167,7 +188,7 @@ bool DriverOutput::StartMixJob(MixJob* job, fxl::TimePoint process_start) {
     }
 
     int64_t fill_target =
-        fifo_frames + cm2rd_pos.Apply(now + kDefaultHighWaterNsec);
+        fifo_frames + cm2rd_pos.Apply(now + mix_scheduler_.lead());
 
     // Are we in the middle of an underflow cooldown?  If so, check to see if we
     // have recovered yet.
@@ -282,8 +303,12 @@ void DriverOutput::ApplyGainLimits(::fuchsia::media::AudioGainInfo* in_out_info,
 
 void DriverOutput::ScheduleNextLowWaterWakeup() {
   // Schedule the next callback for when we are at the low water mark behind
-  // the write pointer.
+  // the write pointer. Our low water mark is one wakeup period short of our
+  // high water mark, both of which the mix scheduler may have just changed.
   const auto& cm2rd_pos = clock_mono_to_ring_buf_pos_frames_;
+  low_water_frames_ =
+      driver_->fifo_depth_frames() +
+      cm2rd_pos.rate().Scale(mix_scheduler_.lead() - mix_scheduler_.period());
   int64_t low_water_frames = frames_sent_ - low_water_frames_;
   int64_t low_water_time = cm2rd_pos.ApplyInverse(low_water_frames);
   SetNextSchedTime(fxl::TimePoint::FromEpochDelta(
@@ -388,7 +413,9 @@ void DriverOutput::OnDriverConfigComplete() {
 
   // Now that our driver is completely configured, we should have all the info
   // we need in order to compute the minimum clock lead time requrirement for
-  // this output.
+  // this output. Our mix scheduler never lets our high water mark exceed
+  // kDefaultHighWaterNsec, so clients that honor this lead time are safe no
+  // matter how it tunes our schedule.
   int64_t fifo_depth_nsec = TimelineRate::Scale(
       driver_->fifo_depth_frames(), ZX_SEC(1), driver_->frames_per_sec());
   min_clock_lead_time_nsec_ =
@@ -453,7 +480,9 @@ void DriverOutput::OnDriverStartComplete() {
 
   const TimelineFunction& trans = clock_mono_to_ring_buf_pos_frames_;
   uint32_t fd_frames = driver_->fifo_depth_frames();
-  low_water_frames_ = fd_frames + trans.rate().Scale(kDefaultLowWaterNsec);
+  low_water_frames_ =
+      fd_frames +
+      trans.rate().Scale(mix_scheduler_.lead() - mix_scheduler_.period());
   frames_sent_ = low_water_frames_;
   frames_to_mix_ = 0;
 
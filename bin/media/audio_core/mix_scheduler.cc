@@ -0,0 +1,189 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "garnet/bin/media/audio_core/mix_scheduler.h"
+
+#include <fbl/algorithm.h>
+#include <fbl/auto_lock.h>
+#include <zircon/syscalls.h>
+#include <iomanip>
+
+#include "lib/fxl/logging.h"
+
+namespace media {
+namespace audio {
+
+// The most we will reduce the low water mark by at the end of a single window.
+static constexpr zx_duration_t kMaxStepDown = ZX_USEC(500);
+
+// The number of windows after an underflow during which we will not reduce the
+// low water mark at all.
+static constexpr uint32_t kUnderflowHoldWindows = 30;
+
+// The percentile of recent wakeup latencies and mix durations we plan for.
+static constexpr uint32_t kPlanningPercentile = 99;
+
+void LatencyHistogram::Add(zx_duration_t value) {
+  size_t ndx = 0;
+  if (value > 0) {
+    uint64_t usec = static_cast<uint64_t>(value) / ZX_USEC(1);
+    if (usec) {
+      ndx = 64 - __builtin_clzll(usec);
+    }
+    max_ = fbl::max(max_, value);
+  }
+
+  ++buckets_[fbl::min(ndx, kNumBuckets - 1)];
+  ++count_;
+}
+
+void LatencyHistogram::Reset() {
+  buckets_.fill(0);
+  count_ = 0;
+  max_ = 0;
+}
+
+zx_duration_t LatencyHistogram::Percentile(uint32_t percent) const {
+  FXL_DCHECK(percent <= 100);
+  if (!count_) {
+    return 0;
+  }
+
+  uint64_t target = ((count_ * percent) + 99) / 100;
+  uint64_t seen = 0;
+  for (size_t i = 0; i < (kNumBuckets - 1); ++i) {
+    seen += buckets_[i];
+    if (seen >= target) {
+      return fbl::min(BucketLimit(i), max_);
+    }
+  }
+
+  return max_;
+}
+
+// static
+zx_duration_t LatencyHistogram::BucketLimit(size_t ndx) {
+  FXL_DCHECK(ndx < kNumBuckets);
+  return ZX_USEC(1) << ndx;
+}
+
+// static
+MixScheduler::Config MixScheduler::FixedConfig(zx_duration_t lead,
+                                               zx_duration_t period) {
+  Config config;
+  config.min_lead = lead;
+  config.max_lead = lead;
+  config.min_period = period;
+  config.max_period = period;
+  config.safety_margin = 0;
+  config.window_cycles = 100;
+  return config;
+}
+
+MixScheduler::MixScheduler(const Config& config)
+    : config_(config), lead_(config.max_lead), period_(config.max_period) {
+  FXL_DCHECK(config_.min_lead <= config_.max_lead);
+  FXL_DCHECK(config_.min_period <= config_.max_period);
+  FXL_DCHECK(config_.min_period < config_.min_lead);
+  FXL_DCHECK(config_.max_period < config_.max_lead);
+  FXL_DCHECK(config_.window_cycles > 0);
+
+  // Start with the most conservative schedule, and work our way down from
+  // there once we know what this system is capable of.
+  fbl::AutoLock lock(&stats_lock_);
+  stats_.headroom = lead_ - period_;
+}
+
+void MixScheduler::OnCycle(zx_duration_t wakeup_latency,
+                           zx_duration_t mix_duration) {
+  fbl::AutoLock lock(&stats_lock_);
+  window_latency_.Add(wakeup_latency);
+  window_duration_.Add(mix_duration);
+  stats_.wakeup_latency.Add(wakeup_latency);
+  stats_.mix_duration.Add(mix_duration);
+  ++stats_.cycles;
+
+  if (window_latency_.count() >= config_.window_cycles) {
+    Adjust();
+    window_latency_.Reset();
+    window_duration_.Reset();
+  }
+}
+
+void MixScheduler::OnUnderflow() {
+  fbl::AutoLock lock(&stats_lock_);
+  ++stats_.underflows;
+  hold_windows_ = kUnderflowHoldWindows;
+
+  // Whatever we measured in this window was not enough. Double the low water
+  // mark and start a new measurement window.
+  SetLowWater((lead_ - period_) * 2);
+  window_latency_.Reset();
+  window_duration_.Reset();
+}
+
+MixScheduler::Stats MixScheduler::GetStats() const {
+  fbl::AutoLock lock(&stats_lock_);
+  Stats ret = stats_;
+  ret.lead = lead_;
+  ret.period = period_;
+  return ret;
+}
+
+void MixScheduler::Adjust() {
+  zx_duration_t cost = window_latency_.Percentile(kPlanningPercentile) +
+                       window_duration_.Percentile(kPlanningPercentile);
+  zx_duration_t cur_low_water = lead_ - period_;
+  zx_duration_t low_water = cost + config_.safety_margin;
+  stats_.headroom = cur_low_water - cost;
+
+  if (low_water < cur_low_water) {
+    if (hold_windows_) {
+      --hold_windows_;
+      return;
+    }
+    low_water = fbl::max(low_water, cur_low_water - kMaxStepDown);
+  }
+
+  SetLowWater(low_water);
+}
+
+void MixScheduler::SetLowWater(zx_duration_t low_water) {
+  // Wake up about twice per low water interval, and mix up to low water plus
+  // one period ahead. If this would put us past our maximum lead time, settle
+  // for the low water which the maximum lead leaves room for. Shrinking the
+  // period instead would have a system which is struggling to keep up wake up
+  // more often.
+  zx_duration_t period =
+      fbl::clamp(low_water / 2, config_.min_period, config_.max_period);
+  low_water = fbl::min(low_water, config_.max_lead - period);
+  zx_duration_t lead =
+      fbl::clamp(low_water + period, config_.min_lead, config_.max_lead);
+
+  if ((lead != lead_) || (period != period_)) {
+    lead_ = lead;
+    period_ = period;
+    ++stats_.adjustments;
+  }
+}
+
+std::ostream& operator<<(std::ostream& os, const MixScheduler::Stats& stats) {
+  auto msec = [](zx_duration_t val) { return val / 1000000.0; };
+
+  os << std::fixed << std::setprecision(3) << "lead " << msec(stats.lead)
+     << " mSec, period " << msec(stats.period) << " mSec, headroom "
+     << msec(stats.headroom) << " mSec, " << stats.cycles << " cycles, "
+     << stats.underflows << " underflows, " << stats.adjustments
+     << " adjustments; wakeup latency p50/p99/max "
+     << msec(stats.wakeup_latency.Percentile(50)) << "/"
+     << msec(stats.wakeup_latency.Percentile(99)) << "/"
+     << msec(stats.wakeup_latency.max()) << " mSec; mix duration p50/p99/max "
+     << msec(stats.mix_duration.Percentile(50)) << "/"
+     << msec(stats.mix_duration.Percentile(99)) << "/"
+     << msec(stats.mix_duration.max()) << " mSec";
+  return os;
+}
+
+}  // namespace audio
+}  // namespace media
@@ -0,0 +1,131 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef GARNET_BIN_MEDIA_AUDIO_CORE_MIX_SCHEDULER_H_
+#define GARNET_BIN_MEDIA_AUDIO_CORE_MIX_SCHEDULER_H_
+
+#include <fbl/mutex.h>
+#include <zircon/types.h>
+
+#include <array>
+#include <ostream>
+
+#include "lib/fxl/synchronization/thread_annotations.h"
+
+namespace media {
+namespace audio {
+
+// A fixed size histogram of durations, using power-of-two buckets of
+// microseconds. Bucket 0 holds [0, 1) uSec, bucket N holds [2^(N-1), 2^N) uSec,
+// and the final bucket holds everything larger. Adding a sample is a handful of
+// instructions and never allocates, so this is safe to use on the mix path.
+class LatencyHistogram {
+ public:
+  static constexpr size_t kNumBuckets = 24;
+
+  void Add(zx_duration_t value);
+  void Reset();
+
+  uint64_t count() const { return count_; }
+  zx_duration_t max() const { return max_; }
+  const std::array<uint64_t, kNumBuckets>& buckets() const { return buckets_; }
+
+  // Returns the upper bound of the bucket holding the |percent|th percentile
+  // sample (or max(), if that is smaller), or 0 if the histogram is empty.
+  // Because of the bucket sizes, this overestimates by up to a factor of 2.
+  zx_duration_t Percentile(uint32_t percent) const;
+
+  // The upper bound (exclusive) of bucket |ndx|.
+  static zx_duration_t BucketLimit(size_t ndx);
+
+ private:
+  std::array<uint64_t, kNumBuckets> buckets_{};
+  uint64_t count_ = 0;
+  zx_duration_t max_ = 0;
+};
+
+// MixScheduler decides how far ahead of an output's read pointer we mix (the
+// lead time), and how often we wake up to do so (the period).
+//
+// Each time the output wakes up, it reports how late the wakeup was relative to
+// when it asked to be woken, and how long the mix pass took. Once per window
+// of cycles, the scheduler recomputes the amount of audio which must remain
+// buffered when we wake up (the worst-case observed wakeup latency plus mix
+// duration, plus a safety margin) and derives the lead time and period from
+// that, within the configured bounds. Increases take effect immediately;
+// decreases are applied gradually, and are suspended for a while after an
+// underflow.
+//
+// Scheduling methods must only be called from the owning output's mix domain.
+// Stats may be snapshotted from any thread.
+class MixScheduler {
+ public:
+  struct Config {
+    zx_duration_t min_lead;
+    zx_duration_t max_lead;
+    zx_duration_t min_period;
+    zx_duration_t max_period;
+    zx_duration_t safety_margin;
+    uint32_t window_cycles;
+  };
+
+  struct Stats {
+    zx_duration_t lead = 0;
+    zx_duration_t period = 0;
+    // How much buffered audio we expect to have left when a mix pass which
+    // starts as late as, and runs as long as, the worst we have seen recently
+    // finishes. Zero or negative means we are at risk of underflowing.
+    zx_duration_t headroom = 0;
+    uint64_t cycles = 0;
+    uint64_t underflows = 0;
+    uint64_t adjustments = 0;
+    LatencyHistogram wakeup_latency;
+    LatencyHistogram mix_duration;
+  };
+
+  // A scheduler with min == max for both the lead and the period never adjusts
+  // anything, but still gathers statistics.
+  static Config FixedConfig(zx_duration_t lead, zx_duration_t period);
+
+  explicit MixScheduler(const Config& config);
+
+  zx_duration_t lead() const { return lead_; }
+  zx_duration_t period() const { return period_; }
+
+  // Report one wakeup/mix cycle.
+  void OnCycle(zx_duration_t wakeup_latency, zx_duration_t mix_duration)
+      FXL_LOCKS_EXCLUDED(stats_lock_);
+
+  // Report an underflow. The low water mark is doubled immediately, as far as
+  // the maximum lead time allows, and is not reduced again for a while.
+  void OnUnderflow() FXL_LOCKS_EXCLUDED(stats_lock_);
+
+  Stats GetStats() const FXL_LOCKS_EXCLUDED(stats_lock_);
+
+ private:
+  void Adjust() FXL_EXCLUSIVE_LOCKS_REQUIRED(stats_lock_);
+  void SetLowWater(zx_duration_t low_water)
+      FXL_EXCLUSIVE_LOCKS_REQUIRED(stats_lock_);
+  zx_duration_t Headroom() const FXL_EXCLUSIVE_LOCKS_REQUIRED(stats_lock_);
+
+  const Config config_;
+
+  // Only ever written from the mix domain while holding stats_lock_, so the mix
+  // domain may read these without the lock.
+  zx_duration_t lead_;
+  zx_duration_t period_;
+
+  mutable fbl::Mutex stats_lock_;
+  LatencyHistogram window_latency_ FXL_GUARDED_BY(stats_lock_);
+  LatencyHistogram window_duration_ FXL_GUARDED_BY(stats_lock_);
+  uint32_t hold_windows_ FXL_GUARDED_BY(stats_lock_) = 0;
+  Stats stats_ FXL_GUARDED_BY(stats_lock_);
+};
+
+std::ostream& operator<<(std::ostream& os, const MixScheduler::Stats& stats);
+
+}  // namespace audio
+}  // namespace media
+
+#endif  // GARNET_BIN_MEDIA_AUDIO_CORE_MIX_SCHEDULER_H_
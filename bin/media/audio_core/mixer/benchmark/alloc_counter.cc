@@ -0,0 +1,49 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "garnet/bin/media/audio_core/mixer/benchmark/alloc_counter.h"
+
+#include <stdlib.h>
+#include <atomic>
+#include <new>
+
+namespace {
+std::atomic<uint64_t> allocation_count{0};
+
+void* CountedAlloc(size_t size) {
+  allocation_count.fetch_add(1, std::memory_order_relaxed);
+  void* ptr = malloc(size ? size : 1);
+  if (ptr == nullptr) {
+    abort();
+  }
+  return ptr;
+}
+}  // namespace
+
+namespace media {
+namespace audio {
+namespace benchmark {
+
+uint64_t AllocationCount() {
+  return allocation_count.load(std::memory_order_relaxed);
+}
+
+}  // namespace benchmark
+}  // namespace audio
+}  // namespace media
+
+// Replacements for the global allocation functions. Array and nothrow forms
+// are routed here as well, so every heap allocation made by Mixer code shows up.
+void* operator new(size_t size) { return CountedAlloc(size); }
+void* operator new[](size_t size) { return CountedAlloc(size); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+  return CountedAlloc(size);
+}
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+  return CountedAlloc(size);
+}
+void operator delete(void* ptr) noexcept { free(ptr); }
+void operator delete[](void* ptr) noexcept { free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { free(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { free(ptr); }
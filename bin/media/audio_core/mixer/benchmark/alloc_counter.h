@@ -0,0 +1,23 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef GARNET_BIN_MEDIA_AUDIO_CORE_MIXER_BENCHMARK_ALLOC_COUNTER_H_
+#define GARNET_BIN_MEDIA_AUDIO_CORE_MIXER_BENCHMARK_ALLOC_COUNTER_H_
+
+#include <stdint.h>
+
+namespace media {
+namespace audio {
+namespace benchmark {
+
+// Returns the number of calls to global operator new (any form) made by this
+// process so far. alloc_counter.cc replaces the global allocation functions,
+// so it must be linked only into the benchmark binary.
+uint64_t AllocationCount();
+
+}  // namespace benchmark
+}  // namespace audio
+}  // namespace media
+
+#endif  // GARNET_BIN_MEDIA_AUDIO_CORE_MIXER_BENCHMARK_ALLOC_COUNTER_H_
@@ -0,0 +1,110 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+
+#include "garnet/bin/media/audio_core/mixer/benchmark/mixer_benchmark.h"
+#include "garnet/bin/media/audio_core/mixer/benchmark/results_json.h"
+#include "lib/fxl/command_line.h"
+#include "lib/fxl/strings/string_number_conversions.h"
+
+using media::audio::benchmark::MixerBenchmark;
+
+namespace {
+
+constexpr double kDefaultThresholdPercent = 10.0;
+
+void Usage(const char* prog_name) {
+  printf(
+      "Usage: %s [--runs=<n>] [--frames=<n>] [--filter=<substring>]\n"
+      "          [--out=<results.json>] [--baseline=<results.json>]\n"
+      "          [--threshold=<percent>]\n"
+      "\n"
+      "  --runs       Timed Mix() calls per case (default %u)\n"
+      "  --frames     Destination frames per Mix() call (default %u)\n"
+      "  --filter     Only run cases whose label contains this substring\n"
+      "  --out        Write results for catapult_converter to this file\n"
+      "  --baseline   Compare against results previously written by --out;\n"
+      "               exit with an error if any case regressed\n"
+      "  --threshold  Allowed slowdown vs. baseline, in percent (default %.0f)\n",
+      prog_name, MixerBenchmark::kDefaultNumRuns,
+      MixerBenchmark::kDefaultDestFrames, kDefaultThresholdPercent);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  auto command_line = fxl::CommandLineFromArgcArgv(argc, argv);
+  if (command_line.HasOption("help")) {
+    Usage(argv[0]);
+    return 0;
+  }
+
+  MixerBenchmark::Options options;
+  std::string value;
+  if (command_line.GetOptionValue("runs", &value) &&
+      (!fxl::StringToNumberWithError(value, &options.num_runs) ||
+       options.num_runs == 0)) {
+    Usage(argv[0]);
+    return 1;
+  }
+  if (command_line.GetOptionValue("frames", &value) &&
+      (!fxl::StringToNumberWithError(value, &options.dest_frames) ||
+       options.dest_frames == 0)) {
+    Usage(argv[0]);
+    return 1;
+  }
+  command_line.GetOptionValue("filter", &options.filter);
+
+  double threshold_percent = kDefaultThresholdPercent;
+  if (command_line.GetOptionValue("threshold", &value)) {
+    threshold_percent = atof(value.c_str());
+  }
+
+  auto results = MixerBenchmark(options).Run();
+
+  printf("%-40s %12s %12s %8s\n", "Case", "Mean ns/fr", "Best ns/fr",
+         "Allocs");
+  for (const auto& result : results) {
+    double total = 0.0, best = result.ns_per_frame.front();
+    for (auto ns : result.ns_per_frame) {
+      total += ns;
+      best = std::min(best, ns);
+    }
+    printf("%-40s %12.3f %12.3f %8lu\n", result.label.c_str(),
+           total / result.ns_per_frame.size(), best,
+           static_cast<unsigned long>(result.allocations));
+  }
+
+  std::string out_path;
+  if (command_line.GetOptionValue("out", &out_path) &&
+      !media::audio::benchmark::WriteResults(out_path, results)) {
+    fprintf(stderr, "Failed to write %s\n", out_path.c_str());
+    return 1;
+  }
+
+  std::string baseline_path;
+  if (command_line.GetOptionValue("baseline", &baseline_path)) {
+    std::vector<media::audio::benchmark::Regression> regressions;
+    if (!media::audio::benchmark::CompareToBaseline(
+            baseline_path, results, threshold_percent, &regressions)) {
+      return 1;
+    }
+
+    for (const auto& regression : regressions) {
+      printf("REGRESSION %s: baseline %.3f, now %.3f\n",
+             regression.label.c_str(), regression.baseline_value,
+             regression.current_value);
+    }
+    if (!regressions.empty()) {
+      printf("%zu case(s) regressed by more than %.1f%%\n", regressions.size(),
+             threshold_percent);
+      return 1;
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,285 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "garnet/bin/media/audio_core/mixer/benchmark/mixer_benchmark.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <type_traits>
+
+#include "garnet/bin/media/audio_core/mixer/benchmark/alloc_counter.h"
+#include "lib/fxl/logging.h"
+#include "lib/fxl/strings/string_printf.h"
+
+namespace media {
+namespace audio {
+namespace benchmark {
+
+namespace {
+
+using Resampler = ::media::audio::Mixer::Resampler;
+using SampleFormat = ::fuchsia::media::AudioSampleFormat;
+
+constexpr Resampler kSamplerTypes[] = {Resampler::SampleAndHold,
+                                       Resampler::LinearInterpolation};
+constexpr SampleFormat kSampleFormats[] = {
+    SampleFormat::UNSIGNED_8, SampleFormat::SIGNED_16,
+    SampleFormat::SIGNED_24_IN_32, SampleFormat::FLOAT};
+// Based on our lack of support for arbitrary channelization, only these.
+constexpr uint32_t kChannelConfigs[][2] = {{1, 1}, {1, 2}, {2, 1},
+                                           {2, 2}, {4, 4}};
+// Against a 48k destination: unity, "micro-SRC", integer up and down ratios.
+constexpr uint32_t kSourceRates[] = {48000, 44100, 96000, 24000};
+constexpr GainMode kGainModes[] = {GainMode::Mute, GainMode::Unity,
+                                   GainMode::Scaled};
+constexpr float kScaledGainDb = -42.68f;
+// Packet rate cases: 1, 2 and 5 mSec packets at 48k, against the same stream
+// mixed as one coalesced span. Only the common renderer configurations.
+constexpr uint32_t kPacketFrames[] = {48, 96, 240,
+                                      BenchmarkCase::kSinglePacket};
+constexpr uint32_t kPacketSourceRates[] = {48000, 44100};
+
+const char* SamplerName(Resampler sampler_type) {
+  return (sampler_type == Resampler::SampleAndHold ? "Point" : "Linear");
+}
+
+const char* FormatName(SampleFormat sample_format) {
+  switch (sample_format) {
+    case SampleFormat::UNSIGNED_8:
+      return "un8";
+    case SampleFormat::SIGNED_16:
+      return "i16";
+    case SampleFormat::SIGNED_24_IN_32:
+      return "i24";
+    case SampleFormat::FLOAT:
+      return "f32";
+  }
+  return "unknown";
+}
+
+const char* GainName(GainMode gain_mode) {
+  switch (gain_mode) {
+    case GainMode::Mute:
+      return "Mute";
+    case GainMode::Unity:
+      return "Unity";
+    case GainMode::Scaled:
+      return "Scaled";
+  }
+  return "unknown";
+}
+
+float GainDb(GainMode gain_mode) {
+  switch (gain_mode) {
+    case GainMode::Mute:
+      return fuchsia::media::MUTED_GAIN_DB;
+    case GainMode::Unity:
+      return 0.0f;
+    case GainMode::Scaled:
+      return kScaledGainDb;
+  }
+  return 0.0f;
+}
+
+// Fill the source with a full-scale cosine, so the mixer sees realistic data.
+template <typename SampleType>
+void FillSource(SampleType* source, uint32_t num_samples) {
+  double amplitude, offset = 0.0;
+  if (std::is_same<SampleType, uint8_t>::value) {
+    amplitude = std::numeric_limits<int8_t>::max();
+    offset = 0x80;
+  } else if (std::is_same<SampleType, int16_t>::value) {
+    amplitude = std::numeric_limits<int16_t>::max();
+  } else if (std::is_same<SampleType, int32_t>::value) {
+    amplitude = std::numeric_limits<int32_t>::max() & ~0x0FF;
+  } else {
+    amplitude = 1.0;
+  }
+
+  for (uint32_t idx = 0; idx < num_samples; ++idx) {
+    source[idx] = static_cast<SampleType>(
+        amplitude * cos(2.0 * M_PI * idx * 997.0 / 48000.0) + offset);
+  }
+}
+
+}  // namespace
+
+std::string BenchmarkCase::Label() const {
+  if (packet_frames == kSinglePacket) {
+    return fxl::StringPrintf("Packets/%s/%s/%u-%u/%u/Span",
+                             SamplerName(sampler_type),
+                             FormatName(sample_format), num_input_chans,
+                             num_output_chans, source_rate);
+  }
+  if (packet_frames) {
+    return fxl::StringPrintf("Packets/%s/%s/%u-%u/%u/%u",
+                             SamplerName(sampler_type),
+                             FormatName(sample_format), num_input_chans,
+                             num_output_chans, source_rate, packet_frames);
+  }
+  return fxl::StringPrintf("Mix/%s/%s/%u-%u/%u/%s/%c",
+                           SamplerName(sampler_type),
+                           FormatName(sample_format), num_input_chans,
+                           num_output_chans, source_rate, GainName(gain_mode),
+                           (accumulate ? '+' : '-'));
+}
+
+// static
+std::vector<BenchmarkCase> MixerBenchmark::AllCases() {
+  std::vector<BenchmarkCase> cases;
+  for (auto sampler_type : kSamplerTypes) {
+    for (auto sample_format : kSampleFormats) {
+      for (const auto& chans : kChannelConfigs) {
+        for (auto source_rate : kSourceRates) {
+          for (auto gain_mode : kGainModes) {
+            for (bool accumulate : {false, true}) {
+              cases.push_back({sampler_type, sample_format, chans[0], chans[1],
+                               source_rate, gain_mode, accumulate});
+            }
+          }
+        }
+      }
+    }
+  }
+
+  for (auto sampler_type : kSamplerTypes) {
+    for (auto source_rate : kPacketSourceRates) {
+      for (auto packet_frames : kPacketFrames) {
+        BenchmarkCase bench_case = {sampler_type, SampleFormat::SIGNED_16,
+                                    2, 2, source_rate, GainMode::Unity,
+                                    true};
+        bench_case.packet_frames = packet_frames;
+        cases.push_back(bench_case);
+      }
+    }
+  }
+  return cases;
+}
+
+std::vector<BenchmarkResult> MixerBenchmark::Run() {
+  std::vector<BenchmarkResult> results;
+
+  for (const auto& bench_case : AllCases()) {
+    BenchmarkResult result;
+    result.label = bench_case.Label();
+    if (!options_.filter.empty() &&
+        result.label.find(options_.filter) == std::string::npos) {
+      continue;
+    }
+
+    if (RunCase(bench_case, &result)) {
+      results.push_back(std::move(result));
+    } else {
+      FXL_LOG(WARNING) << "Skipping " << result.label << ": no mixer";
+    }
+  }
+
+  return results;
+}
+
+bool MixerBenchmark::RunCase(const BenchmarkCase& bench_case,
+                             BenchmarkResult* result) {
+  switch (bench_case.sample_format) {
+    case SampleFormat::UNSIGNED_8:
+      return RunCaseTyped<uint8_t>(bench_case, result);
+    case SampleFormat::SIGNED_16:
+      return RunCaseTyped<int16_t>(bench_case, result);
+    case SampleFormat::SIGNED_24_IN_32:
+      return RunCaseTyped<int32_t>(bench_case, result);
+    case SampleFormat::FLOAT:
+      return RunCaseTyped<float>(bench_case, result);
+  }
+  return false;
+}
+
+template <typename SampleType>
+bool MixerBenchmark::RunCaseTyped(const BenchmarkCase& bench_case,
+                                  BenchmarkResult* result) {
+  fuchsia::media::AudioStreamType src_details;
+  src_details.sample_format = bench_case.sample_format;
+  src_details.channels = bench_case.num_input_chans;
+  src_details.frames_per_second = bench_case.source_rate;
+
+  fuchsia::media::AudioStreamType dest_details;
+  dest_details.sample_format = SampleFormat::FLOAT;
+  dest_details.channels = bench_case.num_output_chans;
+  dest_details.frames_per_second = kDestRate;
+
+  MixerPtr mixer =
+      Mixer::Select(src_details, dest_details, bench_case.sampler_type);
+  if (mixer == nullptr) {
+    return false;
+  }
+
+  const uint32_t dest_frames = options_.dest_frames;
+  const uint32_t source_frames = static_cast<uint32_t>(
+      (static_cast<uint64_t>(dest_frames) * bench_case.source_rate) /
+          kDestRate +
+      1);
+
+  auto source = std::make_unique<SampleType[]>(source_frames *
+                                               bench_case.num_input_chans);
+  auto accum =
+      std::make_unique<float[]>(dest_frames * bench_case.num_output_chans);
+  FillSource(source.get(), source_frames * bench_case.num_input_chans);
+
+  Bookkeeping info;
+  info.step_size = (bench_case.source_rate * Mixer::FRAC_ONE) / kDestRate;
+  info.denominator = kDestRate;
+  info.rate_modulo = (bench_case.source_rate * Mixer::FRAC_ONE) -
+                     (info.step_size * kDestRate);
+  info.gain.SetSourceGain(GainDb(bench_case.gain_mode));
+
+  // Mix the source in packets of |packet_frames|, carrying the fractional
+  // source offset across packet boundaries the same way the output does.
+  const uint32_t packet_frames =
+      bench_case.packet_frames ? bench_case.packet_frames : source_frames;
+  auto do_mix = [&]() {
+    uint32_t dest_offset = 0;
+    int32_t frac_src_offset = 0;
+    info.src_pos_modulo = 0;
+    for (uint32_t frame = 0;
+         (frame < source_frames) && (dest_offset < dest_frames);
+         frame += packet_frames) {
+      uint32_t frames = std::min(packet_frames, source_frames - frame);
+      uint32_t frac_frames = frames * Mixer::FRAC_ONE;
+      if (!mixer->Mix(accum.get(), dest_frames, &dest_offset,
+                      source.get() + (frame * bench_case.num_input_chans),
+                      frac_frames, &frac_src_offset, bench_case.accumulate,
+                      &info)) {
+        break;
+      }
+      frac_src_offset -= frac_frames;
+    }
+  };
+
+  // One untimed "cold" run, so that first-touch costs do not skew the mean.
+  do_mix();
+
+  result->ns_per_frame.clear();
+  result->ns_per_frame.reserve(options_.num_runs);
+  uint64_t alloc_count_before = AllocationCount();
+  for (uint32_t run = 0; run < options_.num_runs; ++run) {
+    auto start_time = std::chrono::steady_clock::now();
+    do_mix();
+    auto elapsed = std::chrono::steady_clock::now() - start_time;
+
+    result->ns_per_frame.push_back(
+        static_cast<double>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed)
+                .count()) /
+        dest_frames);
+  }
+  // ns_per_frame was reserved up front, so it contributes no allocations here.
+  result->allocations = AllocationCount() - alloc_count_before;
+
+  return true;
+}
+
+}  // namespace benchmark
+}  // namespace audio
+}  // namespace media
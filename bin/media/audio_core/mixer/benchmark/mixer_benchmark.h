@@ -0,0 +1,90 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef GARNET_BIN_MEDIA_AUDIO_CORE_MIXER_BENCHMARK_MIXER_BENCHMARK_H_
+#define GARNET_BIN_MEDIA_AUDIO_CORE_MIXER_BENCHMARK_MIXER_BENCHMARK_H_
+
+#include <fuchsia/media/cpp/fidl.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "garnet/bin/media/audio_core/mixer/mixer.h"
+
+namespace media {
+namespace audio {
+namespace benchmark {
+
+enum class GainMode { Mute, Unity, Scaled };
+
+// One point in the benchmark matrix. Destination is always float, 48 kHz.
+struct BenchmarkCase {
+  Mixer::Resampler sampler_type;
+  fuchsia::media::AudioSampleFormat sample_format;
+  uint32_t num_input_chans;
+  uint32_t num_output_chans;
+  uint32_t source_rate;
+  GainMode gain_mode;
+  bool accumulate;
+  // For packet rate cases, the source is split into packets of this many
+  // frames and each packet is mixed with its own Mix() call, the way the output
+  // mixes queued renderer packets which it cannot coalesce. kSinglePacket mixes
+  // the same source as one coalesced span. Zero for the regular Mix cases.
+  static constexpr uint32_t kSinglePacket = UINT32_MAX;
+  uint32_t packet_frames = 0;
+
+  // A stable, human-readable name such as "Mix/Linear/i16/2-1/44100/Unity/+",
+  // or "Packets/Linear/i16/2-2/44100/48" for packet rate cases.
+  // Results are matched against a baseline by this name, so it must not change
+  // for a given configuration.
+  std::string Label() const;
+};
+
+struct BenchmarkResult {
+  std::string label;
+  // Elapsed time per destination frame, one entry per timed run.
+  std::vector<double> ns_per_frame;
+  // Heap allocations made across all timed runs (expected to be zero).
+  uint64_t allocations;
+};
+
+// MixerBenchmark sweeps every combination of sampler type, source format,
+// channel configuration, rate ratio, gain mode and accumulate, timing Mix().
+// It also times a high packet rate stream mixed one small packet at a time,
+// against the same stream mixed as one span.
+class MixerBenchmark {
+ public:
+  static constexpr uint32_t kDestRate = 48000;
+  static constexpr uint32_t kDefaultNumRuns = 50;
+  static constexpr uint32_t kDefaultDestFrames = 8192;
+
+  struct Options {
+    uint32_t num_runs = kDefaultNumRuns;
+    uint32_t dest_frames = kDefaultDestFrames;
+    // If non-empty, only cases whose label contains this substring are run.
+    std::string filter;
+  };
+
+  explicit MixerBenchmark(Options options) : options_(std::move(options)) {}
+
+  // Returns the full matrix, in a stable order.
+  static std::vector<BenchmarkCase> AllCases();
+
+  // Run each (unfiltered) case, returning one result per case. Cases for which
+  // no mixer can be created are skipped.
+  std::vector<BenchmarkResult> Run();
+
+ private:
+  bool RunCase(const BenchmarkCase& bench_case, BenchmarkResult* result);
+  template <typename SampleType>
+  bool RunCaseTyped(const BenchmarkCase& bench_case, BenchmarkResult* result);
+
+  Options options_;
+};
+
+}  // namespace benchmark
+}  // namespace audio
+}  // namespace media
+
+#endif  // GARNET_BIN_MEDIA_AUDIO_CORE_MIXER_BENCHMARK_MIXER_BENCHMARK_H_
@@ -0,0 +1,151 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "garnet/bin/media/audio_core/mixer/benchmark/results_json.h"
+
+#include <rapidjson/document.h>
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/writer.h>
+#include <map>
+
+#include "lib/fxl/files/file.h"
+#include "lib/fxl/logging.h"
+
+namespace media {
+namespace audio {
+namespace benchmark {
+
+namespace {
+
+const char kLabelKey[] = "label";
+const char kTestSuiteKey[] = "test_suite";
+const char kUnitKey[] = "unit";
+const char kSplitFirstKey[] = "split_first";
+const char kValuesKey[] = "values";
+
+const char kTimeSuffix[] = "/ns_per_frame";
+const char kAllocSuffix[] = "/allocations";
+
+void EncodeResult(rapidjson::Writer<rapidjson::StringBuffer>* writer,
+                  const std::string& label, const char* unit,
+                  const std::vector<double>& values) {
+  writer->StartObject();
+  {
+    writer->Key(kLabelKey);
+    writer->String(label.c_str());
+
+    writer->Key(kTestSuiteKey);
+    writer->String(kTestSuite);
+
+    writer->Key(kUnitKey);
+    writer->String(unit);
+
+    writer->Key(kSplitFirstKey);
+    writer->Bool(false);
+
+    writer->Key(kValuesKey);
+    writer->StartArray();
+    for (auto value : values) {
+      writer->Double(value);
+    }
+    writer->EndArray();
+  }
+  writer->EndObject();
+}
+
+double Mean(const std::vector<double>& values) {
+  if (values.empty()) {
+    return 0.0;
+  }
+  double sum = 0.0;
+  for (auto value : values) {
+    sum += value;
+  }
+  return sum / values.size();
+}
+
+}  // namespace
+
+bool WriteResults(const std::string& output_file_path,
+                  const std::vector<BenchmarkResult>& results) {
+  rapidjson::StringBuffer string_buffer;
+  rapidjson::Writer<rapidjson::StringBuffer> writer(string_buffer);
+
+  writer.StartArray();
+  for (const auto& result : results) {
+    EncodeResult(&writer, result.label + kTimeSuffix, "nanoseconds",
+                 result.ns_per_frame);
+    EncodeResult(&writer, result.label + kAllocSuffix, "count",
+                 {static_cast<double>(result.allocations)});
+  }
+  writer.EndArray();
+
+  std::string encoded = string_buffer.GetString();
+  return files::WriteFile(output_file_path, encoded.data(), encoded.size());
+}
+
+bool CompareToBaseline(const std::string& baseline_file_path,
+                       const std::vector<BenchmarkResult>& results,
+                       double threshold_percent,
+                       std::vector<Regression>* regressions) {
+  FXL_DCHECK(regressions);
+
+  std::string encoded;
+  if (!files::ReadFileToString(baseline_file_path, &encoded)) {
+    FXL_LOG(ERROR) << "Could not read baseline " << baseline_file_path;
+    return false;
+  }
+
+  rapidjson::Document document;
+  document.Parse(encoded.c_str());
+  if (document.HasParseError() || !document.IsArray()) {
+    FXL_LOG(ERROR) << "Could not parse baseline " << baseline_file_path;
+    return false;
+  }
+
+  // Reduce the baseline to one mean per label.
+  std::map<std::string, double> baseline;
+  for (const auto& element : document.GetArray()) {
+    if (!element.IsObject() || !element.HasMember(kLabelKey) ||
+        !element[kLabelKey].IsString() || !element.HasMember(kValuesKey) ||
+        !element[kValuesKey].IsArray()) {
+      FXL_LOG(ERROR) << "Malformed entry in baseline " << baseline_file_path;
+      return false;
+    }
+
+    std::vector<double> values;
+    for (const auto& value : element[kValuesKey].GetArray()) {
+      if (value.IsNumber()) {
+        values.push_back(value.GetDouble());
+      }
+    }
+    baseline[element[kLabelKey].GetString()] = Mean(values);
+  }
+
+  const double limit = 1.0 + threshold_percent / 100.0;
+  for (const auto& result : results) {
+    auto time_iter = baseline.find(result.label + kTimeSuffix);
+    if (time_iter != baseline.end()) {
+      double current = Mean(result.ns_per_frame);
+      if (current > time_iter->second * limit) {
+        regressions->push_back({time_iter->first, time_iter->second, current});
+      }
+    }
+
+    auto alloc_iter = baseline.find(result.label + kAllocSuffix);
+    if (alloc_iter != baseline.end()) {
+      double current = static_cast<double>(result.allocations);
+      if (current > alloc_iter->second) {
+        regressions->push_back(
+            {alloc_iter->first, alloc_iter->second, current});
+      }
+    }
+  }
+
+  return true;
+}
+
+}  // namespace benchmark
+}  // namespace audio
+}  // namespace media
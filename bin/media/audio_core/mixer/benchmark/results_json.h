@@ -0,0 +1,46 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef GARNET_BIN_MEDIA_AUDIO_CORE_MIXER_BENCHMARK_RESULTS_JSON_H_
+#define GARNET_BIN_MEDIA_AUDIO_CORE_MIXER_BENCHMARK_RESULTS_JSON_H_
+
+#include <string>
+#include <vector>
+
+#include "garnet/bin/media/audio_core/mixer/benchmark/mixer_benchmark.h"
+
+namespace media {
+namespace audio {
+namespace benchmark {
+
+// Name under which results are reported to the performance dashboard.
+constexpr char kTestSuite[] = "fuchsia.audio.mixer";
+
+// Writes results in the perf results schema accepted by catapult_converter:
+// for each case, "<label>/ns_per_frame" (unit "nanoseconds", one value per run)
+// and "<label>/allocations" (unit "count"). Returns false on I/O failure.
+bool WriteResults(const std::string& output_file_path,
+                  const std::vector<BenchmarkResult>& results);
+
+// A case whose mean ns_per_frame grew by more than the allowed percentage, or
+// which allocated where the baseline did not.
+struct Regression {
+  std::string label;
+  double baseline_value;
+  double current_value;
+};
+
+// Reads a file previously produced by WriteResults and compares it against the
+// current results. Cases present in only one of the two are ignored. Returns
+// false if the baseline could not be read or parsed.
+bool CompareToBaseline(const std::string& baseline_file_path,
+                       const std::vector<BenchmarkResult>& results,
+                       double threshold_percent,
+                       std::vector<Regression>* regressions);
+
+}  // namespace benchmark
+}  // namespace audio
+}  // namespace media
+
+#endif  // GARNET_BIN_MEDIA_AUDIO_CORE_MIXER_BENCHMARK_RESULTS_JSON_H_
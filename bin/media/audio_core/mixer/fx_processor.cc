@@ -4,12 +4,24 @@
 
 #include "garnet/bin/media/audio_core/mixer/fx_processor.h"
 
+#include <algorithm>
+#include <cstring>
+
 #include "garnet/bin/media/audio_core/mixer/fx_loader.h"
 #include "lib/fxl/logging.h"
 
 namespace media {
 namespace audio {
 
+FxProcessor::FxProcessor(FxLoader* loader, uint32_t frame_rate,
+                         uint32_t max_block_frames)
+    : fx_loader_(loader),
+      frame_rate_(frame_rate),
+      max_block_frames_(std::max(max_block_frames, 1u)) {
+  // A zero block size would keep Process from ever making progress.
+  FXL_DCHECK(max_block_frames > 0);
+}
+
 // If any instances remain, remove and delete them before we leave.
 FxProcessor::~FxProcessor() {
   while (!fx_chain_.empty()) {
@@ -30,8 +42,17 @@ fx_token_t FxProcessor::CreateFx(uint32_t effect_id, uint16_t channels_in,
     return fx_token;
   }
 
+  // Cache the channelization now, so Process need not query it each time.
+  fuchsia_audio_dfx_parameters fx_params;
+  if (fx_loader_->FxGetParameters(fx_token, &fx_params) != ZX_OK) {
+    fx_loader_->DeleteFx(fx_token);
+    return FUCHSIA_AUDIO_DFX_INVALID_TOKEN;
+  }
+
   // If we successfully create but can't insert, delete before returning error.
-  if (InsertFx(fx_token, position) != ZX_OK) {
+  FxInstance instance = {fx_token, fx_params.channels_in,
+                         fx_params.channels_out};
+  if (InsertFx(instance, position) != ZX_OK) {
     fx_loader_->DeleteFx(fx_token);
     return FUCHSIA_AUDIO_DFX_INVALID_TOKEN;
   }
@@ -47,7 +68,15 @@ fx_token_t FxProcessor::GetFxAt(uint16_t position) {
     return FUCHSIA_AUDIO_DFX_INVALID_TOKEN;
   }
 
-  return fx_chain_[position];
+  return fx_chain_[position].token;
+}
+
+uint16_t FxProcessor::channels_in() const {
+  return fx_chain_.empty() ? 0 : fx_chain_.front().channels_in;
+}
+
+uint16_t FxProcessor::channels_out() const {
+  return fx_chain_.empty() ? 0 : fx_chain_.back().channels_out;
 }
 
 // Move the specified instance to a new position in the FX chain.
@@ -56,11 +85,12 @@ zx_status_t FxProcessor::ReorderFx(fx_token_t fx_token, uint8_t new_position) {
   if (new_position >= fx_chain_.size()) {
     return ZX_ERR_OUT_OF_RANGE;
   }
-  if (RemoveFx(fx_token) != ZX_OK) {
+  FxInstance instance;
+  if (RemoveFx(fx_token, &instance) != ZX_OK) {
     return ZX_ERR_NOT_FOUND;
   }
 
-  return InsertFx(fx_token, new_position);
+  return InsertFx(instance, new_position);
 }
 
 // Remove and delete the specified instance.
@@ -89,20 +119,56 @@ zx_status_t FxProcessor::ProcessInPlace(uint32_t num_frames,
   if (audio_buff_in_out == nullptr) {
     return ZX_ERR_INVALID_ARGS;
   }
+  ApplyPendingControlChanges();
   if (num_frames == 0) {
     return ZX_OK;
   }
 
-  for (auto fx_token : fx_chain_) {
-    if (fx_token == FUCHSIA_AUDIO_DFX_INVALID_TOKEN) {
+  for (const auto& instance : fx_chain_) {
+    if (instance.token == FUCHSIA_AUDIO_DFX_INVALID_TOKEN) {
       return ZX_ERR_INTERNAL;
     }
 
+    zx_status_t ret_val = fx_loader_->FxProcessInPlace(
+        instance.token, num_frames, audio_buff_in_out);
+    if (ret_val != ZX_OK) {
+      return ret_val;
+    }
+  }
+
+  return ZX_OK;
+}
+
+// For this FX chain, run audio_buff_in through each instance in sequence,
+// leaving the result in audio_buff_out. Per spec, fail if either buffer is
+// nullptr (even if num_frames is 0). Larger requests are split into blocks of
+// max_block_frames_, so the scratch buffers never need to grow at runtime.
+zx_status_t FxProcessor::Process(uint32_t num_frames,
+                                 const float* audio_buff_in,
+                                 float* audio_buff_out) {
+  if (audio_buff_in == nullptr || audio_buff_out == nullptr) {
+    return ZX_ERR_INVALID_ARGS;
+  }
+  if (fx_chain_.empty() || !chain_channels_valid_) {
+    return ZX_ERR_BAD_STATE;
+  }
+
+  ApplyPendingControlChanges();
+
+  const uint32_t chans_in = channels_in();
+  const uint32_t chans_out = channels_out();
+  while (num_frames > 0) {
+    uint32_t block_frames = std::min(num_frames, max_block_frames_);
+
     zx_status_t ret_val =
-        fx_loader_->FxProcessInPlace(fx_token, num_frames, audio_buff_in_out);
+        ProcessBlock(block_frames, audio_buff_in, audio_buff_out);
     if (ret_val != ZX_OK) {
       return ret_val;
     }
+
+    audio_buff_in += block_frames * chans_in;
+    audio_buff_out += block_frames * chans_out;
+    num_frames -= block_frames;
   }
 
   return ZX_OK;
@@ -112,12 +178,12 @@ zx_status_t FxProcessor::ProcessInPlace(uint32_t num_frames,
 // If any instance fails, exit without calling the others.
 // TODO(mpuryear): Because Flush is a cleanup, do we Flush ALL even on error?
 zx_status_t FxProcessor::Flush() {
-  for (auto fx_token : fx_chain_) {
-    if (fx_token == FUCHSIA_AUDIO_DFX_INVALID_TOKEN) {
+  for (const auto& instance : fx_chain_) {
+    if (instance.token == FUCHSIA_AUDIO_DFX_INVALID_TOKEN) {
       return ZX_ERR_INTERNAL;
     }
 
-    zx_status_t ret_val = fx_loader_->FxFlush(fx_token);
+    zx_status_t ret_val = fx_loader_->FxFlush(instance.token);
     if (ret_val != ZX_OK) {
       return ret_val;
     }
@@ -126,32 +192,152 @@ zx_status_t FxProcessor::Flush() {
   return ZX_OK;
 }
 
+// Called by the (single) API thread. We only publish the change here; the
+// processing thread picks it up in ApplyPendingControlChanges.
+zx_status_t FxProcessor::SetControlValue(fx_token_t fx_token,
+                                         uint16_t ctrl_num, float val) {
+  if (fx_token == FUCHSIA_AUDIO_DFX_INVALID_TOKEN) {
+    return ZX_ERR_INVALID_ARGS;
+  }
+
+  uint32_t write = ctrl_write_.load(std::memory_order_relaxed);
+  uint32_t read = ctrl_read_.load(std::memory_order_acquire);
+  if (write - read >= kMaxPendingControlChanges) {
+    return ZX_ERR_SHOULD_WAIT;
+  }
+
+  ctrl_queue_[write % kMaxPendingControlChanges] = {fx_token, ctrl_num, val};
+  ctrl_write_.store(write + 1, std::memory_order_release);
+  return ZX_OK;
+}
+
 //
 // Private internal methods
 //
 
 // Insert an already-created effect instance at the specified position.
 // If position is out-of-range, return an error (don't clamp).
-zx_status_t FxProcessor::InsertFx(fx_token_t fx_token, uint8_t position) {
-  if (fx_token == FUCHSIA_AUDIO_DFX_INVALID_TOKEN) {
+zx_status_t FxProcessor::InsertFx(const FxInstance& instance,
+                                  uint8_t position) {
+  if (instance.token == FUCHSIA_AUDIO_DFX_INVALID_TOKEN) {
     return ZX_ERR_INVALID_ARGS;
   }
   if (position > fx_chain_.size()) {
     return ZX_ERR_OUT_OF_RANGE;
   }
 
-  fx_chain_.insert(fx_chain_.begin() + position, fx_token);
+  fx_chain_.insert(fx_chain_.begin() + position, instance);
+  UpdateChainConfig();
   return ZX_OK;
 }
 
 // Remove an existing effect instance from the FX chain.
-zx_status_t FxProcessor::RemoveFx(fx_token_t fx_token) {
-  auto iter = std::find(fx_chain_.begin(), fx_chain_.end(), fx_token);
+zx_status_t FxProcessor::RemoveFx(fx_token_t fx_token, FxInstance* removed) {
+  auto iter = std::find_if(
+      fx_chain_.begin(), fx_chain_.end(),
+      [fx_token](const FxInstance& inst) { return inst.token == fx_token; });
   if (iter == fx_chain_.end()) {
     return ZX_ERR_NOT_FOUND;
   }
 
+  if (removed != nullptr) {
+    *removed = *iter;
+  }
   fx_chain_.erase(iter);
+  UpdateChainConfig();
+  return ZX_OK;
+}
+
+// Adjacent instances must agree on channelization. While the chain is being
+// assembled this may temporarily not be so; Process fails until it is fixed.
+// Each scratch buffer must hold one block of the widest intermediate output.
+void FxProcessor::UpdateChainConfig() {
+  chain_channels_valid_ = true;
+  uint32_t max_chans = 0;
+  for (size_t idx = 0; idx < fx_chain_.size(); ++idx) {
+    if (idx > 0 &&
+        fx_chain_[idx].channels_in != fx_chain_[idx - 1].channels_out) {
+      chain_channels_valid_ = false;
+    }
+    max_chans = std::max<uint32_t>(max_chans, fx_chain_[idx].channels_out);
+  }
+
+  size_t buff_samples = static_cast<size_t>(max_chans) * max_block_frames_;
+  for (auto& buff : scratch_buffs_) {
+    buff = (buff_samples ? std::make_unique<float[]>(buff_samples) : nullptr);
+  }
+}
+
+// Called on the processing thread. Changes for instances that have since left
+// the chain are dropped.
+void FxProcessor::ApplyPendingControlChanges() {
+  uint32_t read = ctrl_read_.load(std::memory_order_relaxed);
+  uint32_t write = ctrl_write_.load(std::memory_order_acquire);
+
+  for (; read != write; ++read) {
+    const ControlChange& change = ctrl_queue_[read % kMaxPendingControlChanges];
+    auto iter = std::find_if(fx_chain_.begin(), fx_chain_.end(),
+                             [&change](const FxInstance& inst) {
+                               return inst.token == change.token;
+                             });
+    if (iter == fx_chain_.end()) {
+      continue;
+    }
+
+    zx_status_t ret_val = fx_loader_->FxSetControlValue(
+        change.token, change.ctrl_num, change.val);
+    if (ret_val != ZX_OK) {
+      FXL_LOG(WARNING) << "Could not apply control " << change.ctrl_num
+                       << " value " << change.val << " (res: " << ret_val
+                       << ")";
+    }
+  }
+
+  ctrl_read_.store(read, std::memory_order_release);
+}
+
+// Channel-preserving instances process in place, within whichever writable
+// buffer currently holds the signal. Channel-changing instances process from
+// one buffer into the other. The final instance always writes audio_buff_out.
+zx_status_t FxProcessor::ProcessBlock(uint32_t num_frames,
+                                      const float* audio_buff_in,
+                                      float* audio_buff_out) {
+  const float* src = audio_buff_in;
+  int src_scratch = -1;  // index of scratch buff holding src, or -1 if none
+
+  for (size_t idx = 0; idx < fx_chain_.size(); ++idx) {
+    const FxInstance& instance = fx_chain_[idx];
+    if (instance.token == FUCHSIA_AUDIO_DFX_INVALID_TOKEN) {
+      return ZX_ERR_INTERNAL;
+    }
+
+    bool last = (idx == fx_chain_.size() - 1);
+    int dst_scratch = last ? -1 : (src_scratch == 0 ? 1 : 0);
+    zx_status_t ret_val;
+
+    if (instance.channels_in == instance.channels_out) {
+      if (!last && src_scratch >= 0) {
+        dst_scratch = src_scratch;
+      }
+      float* dst = last ? audio_buff_out : scratch_buffs_[dst_scratch].get();
+      if (dst != src) {
+        std::memmove(dst, src,
+                     num_frames * instance.channels_in * sizeof(float));
+      }
+      ret_val = fx_loader_->FxProcessInPlace(instance.token, num_frames, dst);
+      src = dst;
+    } else {
+      float* dst = last ? audio_buff_out : scratch_buffs_[dst_scratch].get();
+      ret_val = fx_loader_->FxProcess(instance.token, num_frames, src, dst);
+      src = dst;
+    }
+
+    if (ret_val != ZX_OK) {
+      return ret_val;
+    }
+    src_scratch = dst_scratch;
+  }
+
   return ZX_OK;
 }
 
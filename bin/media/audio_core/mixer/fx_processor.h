@@ -6,6 +6,8 @@
 #define GARNET_BIN_MEDIA_AUDIO_SERVER_MIXER_FX_PROCESSOR_H_
 
 #include <zircon/types.h>
+#include <atomic>
+#include <memory>
 #include <vector>
 
 #include "garnet/bin/media/audio_core/mixer/fx_loader.h"
@@ -20,12 +22,23 @@ namespace audio {
 //
 // Internally, FxProcessor maintains a vector of effect instances. They all
 // originate from the same .SO library (hence share a single FxLoader) and run
-// at the same frame rate. This class is designed to be used synchronously and
-// is not explicitly multi-thread-safe.
+// at the same frame rate. Changes to the chain itself (create, reorder, delete)
+// must be synchronized with processing by the caller. The one exception is
+// SetControlValue, which may be called from a single API thread while another
+// (mix) thread calls Process/ProcessInPlace; new values are handed over through
+// a lock-free queue and applied at the start of the next Process call.
 class FxProcessor {
  public:
-  FxProcessor(FxLoader* loader, uint32_t frame_rate)
-      : fx_loader_(loader), frame_rate_(frame_rate) {}
+  // Out-of-place processing is performed in blocks of at most this many frames,
+  // using scratch buffers sized accordingly when the chain is (re)configured.
+  static constexpr uint32_t kDefaultMaxBlockFrames = 1024;
+
+  // Number of control changes that can be pending between Process calls.
+  static constexpr uint32_t kMaxPendingControlChanges = 32;
+
+  // |max_block_frames| must be non-zero; it is clamped to at least 1.
+  FxProcessor(FxLoader* loader, uint32_t frame_rate,
+              uint32_t max_block_frames = kDefaultMaxBlockFrames);
   ~FxProcessor();
 
   // This maps to the corresponding Create ABI call, inserting it at [position].
@@ -49,36 +62,87 @@ class FxProcessor {
   // This removes instance from the chain and directly calls the DeleteFx ABI.
   zx_status_t DeleteFx(fx_token_t fx_token);
 
+  // Returns the channel count expected by the first instance in the chain, and
+  // produced by the last instance in the chain. Both are 0 if chain is empty.
+  uint16_t channels_in() const;
+  uint16_t channels_out() const;
+
   // This maps directly to the corresponding ABI call, for each instance.
   zx_status_t ProcessInPlace(uint32_t num_frames, float* audio_buff_in_out);
 
+  // Process num_frames from audio_buff_in (channels_in() per frame) into
+  // audio_buff_out (channels_out() per frame). Unlike ProcessInPlace, instances
+  // in the chain may change the channel count; intermediate results ping-pong
+  // between preallocated scratch buffers, so this makes no allocations. Returns
+  // ZX_ERR_BAD_STATE if the chain is empty or adjacent instances disagree on
+  // channel count. The input and output buffers must not overlap.
+  zx_status_t Process(uint32_t num_frames, const float* audio_buff_in,
+                      float* audio_buff_out);
+
   // This maps directly to the corresponding ABI call, for each instance.
   zx_status_t Flush();
 
+  // Queue a control change for this instance, to be applied by the thread that
+  // calls Process/ProcessInPlace, before it next processes audio. This never
+  // blocks; it returns ZX_ERR_SHOULD_WAIT if too many changes are pending.
+  // Only one thread may call this at a time.
+  zx_status_t SetControlValue(fx_token_t fx_token, uint16_t ctrl_num,
+                              float val);
+
   //
-  // Not yet implemented -- these five map directly to corresponding ABI calls.
+  // Not yet implemented -- these three map directly to corresponding ABI calls.
   //
   // zx_status_t GetParameters(fx_token_t token,fuchsia_audio_dfx_parameters*
   //    params);
-  // zx_status_t Process(uint32_t num_frames,const float* audio_buff_in,float*
-  //    audio_buff_out);
   // zx_status_t GetControlValue(fx_token_t token, uint16_t ctrl_num, float*
   //    val_out);
-  // zx_status_t SetControlValue(fx_token_t token, uint16_t ctrl_num, float
-  //    val);
   // zx_status_t Reset(fx_token_t token);
 
  private:
+  struct FxInstance {
+    fx_token_t token;
+    uint16_t channels_in;
+    uint16_t channels_out;
+  };
+
+  struct ControlChange {
+    fx_token_t token;
+    uint16_t ctrl_num;
+    float val;
+  };
+
   // Used internally, this inserts an already-created instance into the chain.
-  zx_status_t InsertFx(fx_token_t fx_token, uint8_t position);
+  zx_status_t InsertFx(const FxInstance& instance, uint8_t position);
 
   // Used internally, this removes an already-created instance from the chain.
-  zx_status_t RemoveFx(fx_token_t fx_token);
+  zx_status_t RemoveFx(fx_token_t fx_token, FxInstance* removed = nullptr);
+
+  // Recompute channel compatibility and resize scratch buffers. Called only
+  // when the chain changes, so that Process never allocates.
+  void UpdateChainConfig();
+
+  // Drain the control-change queue, applying each change to its instance.
+  void ApplyPendingControlChanges();
+
+  // Run one block of at most max_block_frames_ frames through the chain.
+  zx_status_t ProcessBlock(uint32_t num_frames, const float* audio_buff_in,
+                           float* audio_buff_out);
 
   ::media::audio::FxLoader* fx_loader_;
   uint32_t frame_rate_;
+  uint32_t max_block_frames_;
+
+  std::vector<FxInstance> fx_chain_;
+  bool chain_channels_valid_ = true;
+
+  // Two ping-pong buffers, each of max_block_frames_ * (widest stage output).
+  std::unique_ptr<float[]> scratch_buffs_[2];
 
-  std::vector<fx_token_t> fx_chain_;
+  // Single-producer, single-consumer ring of pending control changes. The
+  // producer owns ctrl_write_, the consumer owns ctrl_read_.
+  ControlChange ctrl_queue_[kMaxPendingControlChanges];
+  std::atomic<uint32_t> ctrl_write_{0};
+  std::atomic<uint32_t> ctrl_read_{0};
 };
 
 }  // namespace audio
@@ -0,0 +1,51 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef GARNET_BIN_MEDIA_AUDIO_CORE_RING_BUFFER_MIX_H_
+#define GARNET_BIN_MEDIA_AUDIO_CORE_RING_BUFFER_MIX_H_
+
+#include <stdint.h>
+
+#include "garnet/bin/media/audio_core/audio_driver.h"
+#include "garnet/bin/media/audio_core/mixer/mixer.h"
+#include "lib/media/timeline/timeline_function.h"
+
+namespace media {
+namespace audio {
+
+// Helpers for sampling from a driver ring buffer (an AudioInput, or the
+// loopback of an AudioOutput) into a float accumulation buffer. These are used
+// both by AudioCapturerImpl directly and by SharedCaptureStage.
+
+// Recompute the source and destination transformations in |info| if either the
+// destination frame timeline (identified by |dest_trans_gen_id|) or the ring
+// buffer (identified by rb_snap.gen_id) has changed since the last call.
+void UpdateRingBufferTransformation(
+    Bookkeeping* info, const AudioDriver::RingBufferSnapshot& rb_snap,
+    const TimelineFunction& dest_frames_to_clock_mono,
+    uint32_t dest_trans_gen_id);
+
+// The run of destination frames produced by MixFromRingBuffer, relative to its
+// |dest_frame|.
+struct MixedFrames {
+  uint32_t offset = 0;
+  uint32_t frames = 0;
+};
+
+// Mix the |mix_frames| destination frames starting at |dest_frame| from the
+// currently-safe region of the ring buffer into |buf|, using info->mixer.
+// |info| must already have been updated by UpdateRingBufferTransformation.
+// Frames before the returned run are no longer in the safe region and frames
+// after it are not yet in it; those are left untouched in |buf|. If none of
+// the frames are in the safe region any more, the run is empty and starts at
+// |mix_frames|.
+MixedFrames MixFromRingBuffer(const AudioDriver::RingBufferSnapshot& rb_snap,
+                       Bookkeeping* info, int64_t dest_frame,
+                       uint32_t mix_frames, uint32_t dest_channels, float* buf,
+                       bool accumulate);
+
+}  // namespace audio
+}  // namespace media
+
+#endif  // GARNET_BIN_MEDIA_AUDIO_CORE_RING_BUFFER_MIX_H_
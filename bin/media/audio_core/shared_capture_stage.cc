@@ -0,0 +1,185 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "garnet/bin/media/audio_core/shared_capture_stage.h"
+
+#include <fbl/auto_lock.h>
+#include <zircon/syscalls.h>
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#include "garnet/bin/media/audio_core/audio_driver.h"
+#include "garnet/bin/media/audio_core/ring_buffer_mix.h"
+#include "lib/fxl/logging.h"
+#include "lib/media/timeline/timeline_rate.h"
+
+namespace media {
+namespace audio {
+namespace {
+
+// The largest read (in time) a capturer may ask a stage for. This must be at
+// least as long as the largest job a capturer will ever ask for.
+constexpr zx_duration_t kMaxReadDuration = ZX_MSEC(50);
+
+// Capturers of the same stage can only be as far apart as the ring buffer's
+// safe region is long (at most 220 mSec for an AudioInput); frames older than
+// that are gone for everyone. Retaining that much converted audio, plus a full
+// read, keeps a lagging capturer from evicting a leading one's frames and vice
+// versa.
+constexpr zx_duration_t kCacheDuration = ZX_MSEC(250) + kMaxReadDuration;
+
+struct RegistryEntry {
+  const AudioDevice* device;
+  uint32_t channels;
+  uint32_t frames_per_second;
+  std::weak_ptr<SharedCaptureStage> stage;
+};
+
+fbl::Mutex registry_lock;
+std::vector<RegistryEntry> registry FXL_GUARDED_BY(registry_lock);
+
+}  // namespace
+
+// static
+std::shared_ptr<SharedCaptureStage> SharedCaptureStage::Get(
+    const fbl::RefPtr<AudioDevice>& device, uint32_t channels,
+    uint32_t frames_per_second) {
+  FXL_DCHECK(device != nullptr);
+  fbl::AutoLock lock(&registry_lock);
+
+  // Prune the stages which no longer have any users while looking for a match.
+  // A stage holds a reference to its device, so the device pointer of a live
+  // entry can never be re-used by a different device.
+  std::shared_ptr<SharedCaptureStage> ret;
+  for (auto iter = registry.begin(); iter != registry.end();) {
+    auto stage = iter->stage.lock();
+    if (stage == nullptr) {
+      iter = registry.erase(iter);
+      continue;
+    }
+
+    if ((iter->device == device.get()) && (iter->channels == channels) &&
+        (iter->frames_per_second == frames_per_second)) {
+      ret = std::move(stage);
+    }
+    ++iter;
+  }
+
+  if (ret != nullptr) {
+    return ret;
+  }
+
+  const auto& driver = device->driver();
+  if (driver == nullptr) {
+    return nullptr;
+  }
+
+  fuchsia::media::AudioStreamTypePtr source_format =
+      driver->GetSourceFormat();
+  if (!source_format) {
+    return nullptr;
+  }
+
+  fuchsia::media::AudioStreamType dest_format;
+  dest_format.sample_format = fuchsia::media::AudioSampleFormat::FLOAT;
+  dest_format.channels = channels;
+  dest_format.frames_per_second = frames_per_second;
+
+  std::unique_ptr<Bookkeeping> info(new Bookkeeping());
+  info->mixer = Mixer::Select(*source_format, dest_format);
+  if (info->mixer == nullptr) {
+    return nullptr;
+  }
+
+  TimelineRate frames_per_nsec(frames_per_second, ZX_SEC(1));
+  int64_t cache_frames = frames_per_nsec.Scale(kCacheDuration);
+  int64_t max_read_frames = frames_per_nsec.Scale(kMaxReadDuration);
+  FXL_DCHECK(max_read_frames > 0);
+  FXL_DCHECK(cache_frames > max_read_frames);
+  FXL_DCHECK(cache_frames <= std::numeric_limits<uint32_t>::max());
+
+  ret.reset(new SharedCaptureStage(device, channels, frames_per_second,
+                                   static_cast<uint32_t>(cache_frames),
+                                   static_cast<uint32_t>(max_read_frames),
+                                   std::move(info)));
+  registry.push_back({device.get(), channels, frames_per_second, ret});
+  return ret;
+}
+
+SharedCaptureStage::SharedCaptureStage(fbl::RefPtr<AudioDevice> device,
+                                       uint32_t channels,
+                                       uint32_t frames_per_second,
+                                       uint32_t cache_frames,
+                                       uint32_t max_read_frames,
+                                       std::unique_ptr<Bookkeeping> info)
+    : device_(std::move(device)),
+      channels_(channels),
+      frames_per_second_(frames_per_second),
+      max_read_frames_(max_read_frames),
+      frames_to_clock_mono_(zx_clock_get(ZX_CLOCK_MONOTONIC), 0,
+                            TimelineRate(ZX_SEC(1), frames_per_second)),
+      info_(std::move(info)),
+      cache_(channels, cache_frames,
+             // The cache only converts from within Read, under lock_.
+             [this](int64_t frame, uint32_t frames, float* buf)
+                 FXL_NO_THREAD_SAFETY_ANALYSIS {
+                   return Convert(frame, frames, buf);
+                 }) {
+  FXL_DCHECK(frames_to_clock_mono_.invertable());
+}
+
+bool SharedCaptureStage::Read(int64_t frame, uint32_t frames,
+                              Gain::AScale scale, float* dest,
+                              bool accumulate) {
+  FXL_DCHECK(frame >= 0);
+  FXL_DCHECK(frames <= max_read_frames());
+  FXL_DCHECK(dest != nullptr);
+
+  const auto& driver = device_->driver();
+  if (driver == nullptr) {
+    return false;
+  }
+
+  AudioDriver::RingBufferSnapshot rb_snap;
+  driver->SnapshotRingBuffer(&rb_snap);
+  if ((rb_snap.ring_buffer == nullptr) ||
+      (!rb_snap.clock_mono_to_ring_pos_bytes.invertable())) {
+    return false;
+  }
+
+  fbl::AutoLock lock(&lock_);
+  UpdateRingBufferTransformation(info_.get(), rb_snap, frames_to_clock_mono_,
+                                 frames_to_clock_mono_gen_.get());
+
+  rb_snap_ = &rb_snap;
+  cache_.Read(frame, frames, scale, dest, accumulate);
+  rb_snap_ = nullptr;
+
+  return true;
+}
+
+CaptureFrameCache::Converted SharedCaptureStage::Convert(int64_t frame,
+                                                         uint32_t frames,
+                                                         float* buf) {
+  FXL_DCHECK(rb_snap_ != nullptr);
+
+  // The mixer's filter carries state from one job to the next, which is only
+  // valid if this job picks up where the last one left off.
+  if (frame != next_convert_frame_) {
+    info_->mixer->Reset();
+  }
+
+  MixedFrames mixed = MixFromRingBuffer(*rb_snap_, info_.get(), frame, frames,
+                                        channels_, buf, false);
+  next_convert_frame_ = frame + mixed.offset + mixed.frames;
+
+  CaptureFrameCache::Converted converted;
+  converted.offset = mixed.offset;
+  converted.frames = mixed.frames;
+  return converted;
+}
+
+}  // namespace audio
+}  // namespace media
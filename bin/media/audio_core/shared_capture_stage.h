@@ -0,0 +1,105 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef GARNET_BIN_MEDIA_AUDIO_CORE_SHARED_CAPTURE_STAGE_H_
+#define GARNET_BIN_MEDIA_AUDIO_CORE_SHARED_CAPTURE_STAGE_H_
+
+#include <fbl/mutex.h>
+#include <fbl/ref_ptr.h>
+#include <stdint.h>
+
+#include <memory>
+
+#include "garnet/bin/media/audio_core/audio_device.h"
+#include "garnet/bin/media/audio_core/capture_frame_cache.h"
+#include "garnet/bin/media/audio_core/mixer/gain.h"
+#include "garnet/bin/media/audio_core/mixer/mixer.h"
+#include "garnet/bin/media/audio_core/utils.h"
+#include "lib/fxl/synchronization/thread_annotations.h"
+#include "lib/media/timeline/timeline_function.h"
+
+namespace media {
+namespace audio {
+
+// A SharedCaptureStage performs the resample/downmix of a device's ring buffer
+// into float frames at a given channel count and frame rate exactly once, no
+// matter how many capturers are consuming that conversion.
+//
+// Each stage owns a frame grid (a fixed frames-to-clock-monotonic
+// transformation) and a CaptureFrameCache of recently converted frames,
+// indexed by stage frame number. Capturers whose own frame timelines are
+// aligned to the stage's grid simply copy (and gain scale) frames out of the
+// cache; the first capturer to ask for a frame which has not been converted yet
+// does the work on behalf of everyone else. The cache is long enough to cover
+// capturers which are as far apart as the ring buffer's safe region is long.
+//
+// Stages are shared between capturers through the registry maintained by Get,
+// and are destroyed when the last capturer releases its reference.
+class SharedCaptureStage {
+ public:
+  // Fetch (creating if needed) the stage which converts |device|'s ring buffer
+  // to float frames with |channels| channels at |frames_per_second|. Returns
+  // nullptr if |device| has no driver or no configured format, or if no mixer
+  // exists for the conversion.
+  static std::shared_ptr<SharedCaptureStage> Get(
+      const fbl::RefPtr<AudioDevice>& device, uint32_t channels,
+      uint32_t frames_per_second);
+
+  const fbl::RefPtr<AudioDevice>& device() const { return device_; }
+  uint32_t channels() const { return channels_; }
+  uint32_t frames_per_second() const { return frames_per_second_; }
+
+  // The transformation from stage frame numbers to clock monotonic. This never
+  // changes over the lifetime of the stage.
+  const TimelineFunction& frames_to_clock_mono() const {
+    return frames_to_clock_mono_;
+  }
+
+  // The maximum number of frames which may be fetched in a single call to Read.
+  uint32_t max_read_frames() const { return max_read_frames_; }
+
+  // Produce the |frames| converted frames starting at stage frame |frame| into
+  // |dest|, scaling by |scale| and either accumulating into or overwriting what
+  // is already there. Frames which cannot be sampled from the ring buffer
+  // (because they are no longer, or are not yet, in the safe region) are
+  // produced as silence, which is not cached. Returns false if the device's
+  // ring buffer is not currently running, in which case |dest| is left
+  // untouched.
+  bool Read(int64_t frame, uint32_t frames, Gain::AScale scale, float* dest,
+            bool accumulate) FXL_LOCKS_EXCLUDED(lock_);
+
+ private:
+  SharedCaptureStage(fbl::RefPtr<AudioDevice> device, uint32_t channels,
+                     uint32_t frames_per_second, uint32_t cache_frames,
+                     uint32_t max_read_frames,
+                     std::unique_ptr<Bookkeeping> info);
+
+  // Convert |frames| frames starting at stage frame |frame| from the ring
+  // buffer of |rb_snap_| into |buf|, on behalf of |cache_|.
+  CaptureFrameCache::Converted Convert(int64_t frame, uint32_t frames,
+                                       float* buf)
+      FXL_EXCLUSIVE_LOCKS_REQUIRED(lock_);
+
+  const fbl::RefPtr<AudioDevice> device_;
+  const uint32_t channels_;
+  const uint32_t frames_per_second_;
+  const uint32_t max_read_frames_;
+  const TimelineFunction frames_to_clock_mono_;
+  const GenerationId frames_to_clock_mono_gen_;
+
+  fbl::Mutex lock_;
+  std::unique_ptr<Bookkeeping> info_ FXL_GUARDED_BY(lock_);
+  CaptureFrameCache cache_ FXL_GUARDED_BY(lock_);
+
+  // The ring buffer snapshot of the Read in progress, and the frame which the
+  // mixer's filter state leads up to.
+  const AudioDriver::RingBufferSnapshot* rb_snap_ FXL_GUARDED_BY(lock_) =
+      nullptr;
+  int64_t next_convert_frame_ FXL_GUARDED_BY(lock_) = -1;
+};
+
+}  // namespace audio
+}  // namespace media
+
+#endif  // GARNET_BIN_MEDIA_AUDIO_CORE_SHARED_CAPTURE_STAGE_H_
@@ -6,6 +6,7 @@
 
 #include <fbl/auto_lock.h>
 #include <lib/fit/defer.h>
+#include <algorithm>
 #include <limits>
 
 #include "garnet/bin/media/audio_core/audio_link.h"
@@ -22,8 +23,9 @@ namespace audio {
 static constexpr fxl::TimeDelta kMaxTrimPeriod =
     fxl::TimeDelta::FromMilliseconds(10);
 
-StandardOutputBase::StandardOutputBase(AudioDeviceManager* manager)
-    : AudioOutput(manager) {
+StandardOutputBase::StandardOutputBase(
+    AudioDeviceManager* manager, const MixScheduler::Config& sched_config)
+    : AudioOutput(manager), mix_scheduler_(sched_config) {
   next_sched_time_ = fxl::TimePoint::Now();
   next_sched_time_known_ = true;
   source_link_refs_.reserve(16u);
@@ -70,6 +72,8 @@ void StandardOutputBase::Process() {
   // Just trim the queues and move on.
   FXL_DCHECK(next_sched_time_known_);
   if (now >= next_sched_time_) {
+    zx_duration_t wakeup_latency = (now - next_sched_time_).ToNanoseconds();
+
     // Clear the flag. If the implementation does not set it during the cycle by
     // calling SetNextSchedTime, we consider it an error and shut down.
     next_sched_time_known_ = false;
@@ -112,6 +116,9 @@ void StandardOutputBase::Process() {
       }
 
     } while (FinishMixJob(cur_mix_job_));
+
+    mix_scheduler_.OnCycle(
+        wakeup_latency, (fxl::TimePoint::Now() - now).ToNanoseconds());
   }
 
   if (!next_sched_time_known_) {
@@ -248,21 +255,21 @@ void StandardOutputBase::ForeachLink(TaskType task_type) {
     UpdateSourceTrans(audio_renderer, info);
 
     bool setup_done = false;
-    fbl::RefPtr<AudioPacketRef> pkt_ref;
+    AudioLinkPacketSource::PacketSpan span;
 
-    bool release_audio_renderer_packet;
+    size_t release_count;
     while (true) {
-      release_audio_renderer_packet = false;
+      release_count = 0;
       // Try to grab the packet queue's front. If it has been flushed since the
       // last time we grabbed it, reset our mixer's internal filter state.
       bool was_flushed;
-      pkt_ref = packet_link->LockPendingQueueFront(&was_flushed);
+      bool have_span = packet_link->LockPendingQueueFront(&span, &was_flushed);
       if (was_flushed) {
         info->mixer->Reset();
       }
 
       // If the queue is empty, then we are done.
-      if (!pkt_ref) {
+      if (!have_span) {
         break;
       }
 
@@ -278,33 +285,40 @@ void StandardOutputBase::ForeachLink(TaskType task_type) {
         }
       }
 
-      // Now process the packet which is at the front of the renderer's queue.
-      // If the packet has been entirely consumed, pop it off the front and
-      // proceed to the next one. Otherwise, we are finished.
-      release_audio_renderer_packet =
-          (task_type == TaskType::Mix)
-              ? ProcessMix(audio_renderer, info, pkt_ref)
-              : ProcessTrim(audio_renderer, info, pkt_ref);
+      // Now process the span of packets at the front of the renderer's queue.
+      // If the span has been entirely consumed, pop all of its packets off the
+      // front and proceed to the next span. Otherwise, release only the
+      // packets we are finished with, and we are done.
+      bool consumed = (task_type == TaskType::Mix)
+                          ? ProcessMix(audio_renderer, info, span)
+                          : ProcessTrim(audio_renderer, info, span);
+      if (consumed) {
+        release_count = span.packet_count;
+      } else if (span.packet_count > 1) {
+        int64_t threshold = (task_type == TaskType::Mix)
+                                ? MixReleaseThreshold(*info)
+                                : trim_threshold_;
+        release_count = packet_link->CountLockedPacketsEndingBy(threshold);
+        release_count = std::min(release_count, span.packet_count);
+      }
 
       // If we have mixed enough output frames, we are done with this mix,
-      // regardless of what we should now do with the renderer packet.
+      // regardless of what we should now do with the renderer packets.
       if ((task_type == TaskType::Mix) &&
           (cur_mix_job_.frames_produced == cur_mix_job_.buf_frames)) {
         break;
       }
-      // If we still need more output, but could not complete this renderer
-      // packet (we're paused, or packet is in the future), then we are done.
-      if (!release_audio_renderer_packet) {
+      // If we still need more output, but could not complete this span
+      // (we're paused, or it extends into the future), then we are done.
+      if (!consumed) {
         break;
       }
-      // We did consume this entire renderer packet, and we should keep mixing.
-      pkt_ref.reset();
-      packet_link->UnlockPendingQueueFront(release_audio_renderer_packet);
+      // We did consume this entire span, and we should keep mixing.
+      packet_link->UnlockPendingQueueFront(release_count);
     }
 
-    // Unlock queue (completing packet if needed) and proceed to next renderer.
-    pkt_ref.reset();
-    packet_link->UnlockPendingQueueFront(release_audio_renderer_packet);
+    // Unlock queue (completing packets if needed) and proceed to next renderer.
+    packet_link->UnlockPendingQueueFront(release_count);
 
     // Note: there is no point in doing this for Trim tasks, but it doesn't hurt
     // anything, and its easier than adding another function to ForeachLink to
@@ -326,12 +340,12 @@ bool StandardOutputBase::SetupMix(
 
 bool StandardOutputBase::ProcessMix(
     const fbl::RefPtr<AudioRendererImpl>& audio_renderer, Bookkeeping* info,
-    const fbl::RefPtr<AudioPacketRef>& packet) {
+    const AudioLinkPacketSource::PacketSpan& span) {
   // Bookkeeping should contain: the rechannel matrix (eventually).
 
   // Sanity check our parameters.
   FXL_DCHECK(info);
-  FXL_DCHECK(packet);
+  FXL_DCHECK(span.packet_count > 0);
 
   // We had better have a valid job, or why are we here?
   FXL_DCHECK(cur_mix_job_.buf_frames);
@@ -366,14 +380,14 @@ bool StandardOutputBase::ProcessMix(
       first_sample_ftf +
       info->dest_frames_to_frac_source_frames.rate().Scale(frames_left - 1);
 
-  // If packet has no frames, there's no need to mix it; it may be skipped.
-  if (packet->end_pts() == packet->start_pts()) {
+  // If the span has no frames, there's no need to mix it; it may be skipped.
+  if (span.end_pts == span.start_pts) {
     return true;
   }
 
   // Figure out the PTS of the final frame of audio in our input packet.
-  FXL_DCHECK((packet->end_pts() - packet->start_pts()) >= Mixer::FRAC_ONE);
-  int64_t final_pts = packet->end_pts() - Mixer::FRAC_ONE;
+  FXL_DCHECK((span.end_pts - span.start_pts) >= Mixer::FRAC_ONE);
+  int64_t final_pts = span.end_pts - Mixer::FRAC_ONE;
 
   // If the PTS of the final frame of audio in our input is before the negative
   // window edge of our filter centered at our first sampling point, then this
@@ -385,25 +399,25 @@ bool StandardOutputBase::ProcessMix(
   // If the PTS of the first frame of audio in our input is after the positive
   // window edge of our filter centered at our final sampling point, then this
   // packet is entirely in the future and should be held.
-  if (packet->start_pts() > (final_sample_ftf + mixer.pos_filter_width())) {
+  if (span.start_pts > (final_sample_ftf + mixer.pos_filter_width())) {
     return false;
   }
 
   // Evidently this input packet intersects our mixer's filter. Compute where
   // (in the output buffer) our first output sample will land, and where (in the
   // input packet) we should start sampling the input.
-  int64_t input_offset_64 = first_sample_ftf - packet->start_pts();
+  int64_t input_offset_64 = first_sample_ftf - span.start_pts;
   int64_t output_offset_64 = 0;
   int64_t first_sample_pos_window_edge =
       first_sample_ftf + mixer.pos_filter_width();
 
   // If the packet's first frame comes after the filter window's positive edge,
   // then we should skip some output frames before starting to produce data.
-  if (packet->start_pts() > first_sample_pos_window_edge) {
+  if (span.start_pts > first_sample_pos_window_edge) {
     const TimelineRate& dest_to_src =
         info->dest_frames_to_frac_source_frames.rate();
     output_offset_64 = dest_to_src.Inverse().Scale(
-        packet->start_pts() - first_sample_pos_window_edge + Mixer::FRAC_ONE -
+        span.start_pts - first_sample_pos_window_edge + Mixer::FRAC_ONE -
         1);
     input_offset_64 += dest_to_src.Scale(output_offset_64);
   }
@@ -417,11 +431,11 @@ bool StandardOutputBase::ProcessMix(
   int32_t frac_input_offset = static_cast<int32_t>(input_offset_64);
 
   // Looks like we are ready to go. Mix.
-  FXL_DCHECK(packet->frac_frame_len() <=
+  FXL_DCHECK(span.frac_frame_len <=
              static_cast<uint32_t>(std::numeric_limits<int32_t>::max()));
 
   bool consumed_source = false;
-  if (frac_input_offset < static_cast<int32_t>(packet->frac_frame_len())) {
+  if (frac_input_offset < static_cast<int32_t>(span.frac_frame_len)) {
     // When calling Mix(), we communicate the resampling rate with three
     // parameters. We augment step_size with rate_modulo and denominator
     // arguments that capture the remaining rate component that cannot be
@@ -447,15 +461,15 @@ bool StandardOutputBase::ProcessMix(
     // TODO(mpuryear): integrate bookkeeping into the Mixer itself (MTWN-129).
 
     consumed_source =
-        info->mixer->Mix(buf, frames_left, &output_offset, packet->payload(),
-                         packet->frac_frame_len(), &frac_input_offset,
+        info->mixer->Mix(buf, frames_left, &output_offset, span.payload,
+                         span.frac_frame_len, &frac_input_offset,
                          cur_mix_job_.accumulate, info);
     FXL_DCHECK(output_offset <= frames_left);
   }
 
   if (consumed_source) {
     FXL_DCHECK(frac_input_offset + info->mixer->pos_filter_width() >=
-               packet->frac_frame_len());
+               span.frac_frame_len);
   }
 
   cur_mix_job_.frames_produced += output_offset;
@@ -484,17 +498,32 @@ bool StandardOutputBase::SetupTrim(
 
 bool StandardOutputBase::ProcessTrim(
     const fbl::RefPtr<AudioRendererImpl>& audio_renderer, Bookkeeping* info,
-    const fbl::RefPtr<AudioPacketRef>& pkt_ref) {
-  FXL_DCHECK(pkt_ref);
+    const AudioLinkPacketSource::PacketSpan& span) {
+  FXL_DCHECK(span.packet_count > 0);
 
-  // If the presentation end of this packet is in the future, stop trimming.
-  if (pkt_ref->end_pts() > trim_threshold_) {
+  // If the presentation end of this span is in the future, stop trimming.
+  if (span.end_pts > trim_threshold_) {
     return false;
   }
 
   return true;
 }
 
+int64_t StandardOutputBase::MixReleaseThreshold(const Bookkeeping& info) const {
+  // If we are paused, we are not moving through the source at all.
+  if (!info.dest_frames_to_frac_source_frames.subject_delta()) {
+    return std::numeric_limits<int64_t>::min();
+  }
+
+  // ProcessMix skips any packet whose final frame is before the negative edge
+  // of the filter window centered at the next sampling point. Release exactly
+  // the packets it would skip next time.
+  int64_t next_sample_ftf = info.dest_frames_to_frac_source_frames(
+      cur_mix_job_.start_pts_of + cur_mix_job_.frames_produced);
+  int64_t neg_window_edge = next_sample_ftf - info.mixer->neg_filter_width();
+  return neg_window_edge + Mixer::FRAC_ONE - 1;
+}
+
 void StandardOutputBase::UpdateSourceTrans(
     const fbl::RefPtr<AudioRendererImpl>& audio_renderer, Bookkeeping* bk) {
   FXL_DCHECK(audio_renderer != nullptr);
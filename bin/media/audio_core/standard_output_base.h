@@ -11,6 +11,7 @@
 #include "garnet/bin/media/audio_core/audio_link.h"
 #include "garnet/bin/media/audio_core/audio_link_packet_source.h"
 #include "garnet/bin/media/audio_core/audio_output.h"
+#include "garnet/bin/media/audio_core/mix_scheduler.h"
 #include "garnet/bin/media/audio_core/mixer/constants.h"
 #include "garnet/bin/media/audio_core/mixer/gain.h"
 #include "garnet/bin/media/audio_core/mixer/mixer.h"
@@ -51,7 +52,8 @@ class StandardOutputBase : public AudioOutput {
                          Bookkeeping* bk);
   void UpdateDestTrans(const MixJob& job, Bookkeeping* bk);
 
-  explicit StandardOutputBase(AudioDeviceManager* manager);
+  StandardOutputBase(AudioDeviceManager* manager,
+                     const MixScheduler::Config& sched_config);
 
   zx_status_t Init() override;
 
@@ -81,6 +83,10 @@ class StandardOutputBase : public AudioOutput {
   // Timer used to schedule periodic mixing.
   fbl::RefPtr<::dispatcher::Timer> mix_timer_;
 
+  // Measures each wakeup/mix cycle run by Process, and tunes the lead time and
+  // period used by our implementation.
+  MixScheduler mix_scheduler_;
+
  private:
   enum class TaskType { Mix, Trim };
 
@@ -91,7 +97,8 @@ class StandardOutputBase : public AudioOutput {
                 Bookkeeping* info)
       FXL_EXCLUSIVE_LOCKS_REQUIRED(mix_domain_->token());
   bool ProcessMix(const fbl::RefPtr<AudioRendererImpl>& audio_renderer,
-                  Bookkeeping* info, const fbl::RefPtr<AudioPacketRef>& pkt_ref)
+                  Bookkeeping* info,
+                  const AudioLinkPacketSource::PacketSpan& span)
       FXL_EXCLUSIVE_LOCKS_REQUIRED(mix_domain_->token());
 
   bool SetupTrim(const fbl::RefPtr<AudioRendererImpl>& audio_renderer,
@@ -99,7 +106,12 @@ class StandardOutputBase : public AudioOutput {
       FXL_EXCLUSIVE_LOCKS_REQUIRED(mix_domain_->token());
   bool ProcessTrim(const fbl::RefPtr<AudioRendererImpl>& audio_renderer,
                    Bookkeeping* info,
-                   const fbl::RefPtr<AudioPacketRef>& pkt_ref)
+                   const AudioLinkPacketSource::PacketSpan& span)
+      FXL_EXCLUSIVE_LOCKS_REQUIRED(mix_domain_->token());
+
+  // When a span could only be partially consumed, the presentation time at or
+  // before which its packets are no longer needed.
+  int64_t MixReleaseThreshold(const Bookkeeping& info) const
       FXL_EXCLUSIVE_LOCKS_REQUIRED(mix_domain_->token());
 
   fxl::TimePoint next_sched_time_;
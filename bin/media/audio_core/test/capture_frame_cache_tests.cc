@@ -0,0 +1,249 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "garnet/bin/media/audio_core/capture_frame_cache.h"
+
+#include <algorithm>
+#include <limits>
+#include <map>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace media {
+namespace audio {
+namespace test {
+namespace {
+
+constexpr uint32_t kChannels = 2;
+constexpr uint32_t kCapacityFrames = 480;
+
+// The value which the fake ring buffer holds for |channel| of |frame|. Never
+// zero, so that silence is recognizable.
+float SampleValue(int64_t frame, uint32_t channel) {
+  return static_cast<float>(frame * kChannels + channel + 1);
+}
+
+// Stands in for a SharedCaptureStage's ring buffer. Frames in the safe region
+// [oldest, newest) convert to SampleValue(); older frames are gone and newer
+// frames have not been captured yet. Counts how often each frame is converted.
+class FakeRingBuffer {
+ public:
+  void set_safe_region(int64_t oldest, int64_t newest) {
+    oldest_ = oldest;
+    newest_ = newest;
+  }
+
+  CaptureFrameCache::ConvertFunc GetConvertFunc() {
+    return [this](int64_t frame, uint32_t frames, float* buf) {
+      CaptureFrameCache::Converted converted;
+      int64_t first = std::max(frame, oldest_);
+      int64_t last = std::min(frame + frames, newest_);
+      if (first >= frame + frames) {
+        converted.offset = frames;
+        return converted;
+      }
+      if (last <= first) {
+        return converted;
+      }
+
+      converted.offset = static_cast<uint32_t>(first - frame);
+      converted.frames = static_cast<uint32_t>(last - first);
+      for (int64_t f = first; f < last; ++f) {
+        for (uint32_t c = 0; c < kChannels; ++c) {
+          buf[(f - frame) * kChannels + c] = SampleValue(f, c);
+        }
+        ++conversions_[f];
+      }
+      return converted;
+    };
+  }
+
+  // The number of times |frame| has been converted.
+  uint32_t conversions(int64_t frame) const {
+    auto iter = conversions_.find(frame);
+    return (iter == conversions_.end()) ? 0 : iter->second;
+  }
+
+  // The largest number of times any frame has been converted.
+  uint32_t max_conversions() const {
+    uint32_t max = 0;
+    for (const auto& entry : conversions_) {
+      max = std::max(max, entry.second);
+    }
+    return max;
+  }
+
+ private:
+  int64_t oldest_ = 0;
+  int64_t newest_ = std::numeric_limits<int64_t>::max();
+  std::map<int64_t, uint32_t> conversions_;
+};
+
+// Reads |frames| frames starting at |frame| from |cache| at unity gain.
+std::vector<float> Read(CaptureFrameCache* cache, int64_t frame,
+                        uint32_t frames) {
+  std::vector<float> dest(frames * kChannels, -1.0f);
+  cache->Read(frame, frames, Gain::kUnityScale, dest.data(), false);
+  return dest;
+}
+
+// Expects |dest| to hold the ring buffer's frames starting at |frame|, except
+// for the frames in [silent_start, silent_end), which are silence.
+void ExpectFrames(const std::vector<float>& dest, int64_t frame,
+                  int64_t silent_start = 0, int64_t silent_end = 0) {
+  for (size_t i = 0; i < dest.size(); ++i) {
+    int64_t f = frame + static_cast<int64_t>(i / kChannels);
+    uint32_t c = i % kChannels;
+    float expected =
+        (f >= silent_start && f < silent_end) ? 0.0f : SampleValue(f, c);
+    ASSERT_EQ(expected, dest[i]) << "frame " << f << " channel " << c;
+  }
+}
+
+TEST(CaptureFrameCache, ReadersShareConversion) {
+  FakeRingBuffer ring_buffer;
+  CaptureFrameCache cache(kChannels, kCapacityFrames,
+                          ring_buffer.GetConvertFunc());
+
+  // Three capturers aligned to the same frames, each reading them in jobs of
+  // its own size, convert each frame only once.
+  constexpr uint32_t kRoundFrames = 96;
+  const uint32_t job_frames[3] = {96, 48, 32};
+  int64_t pos[3] = {0, 0, 0};
+  for (int round = 0; round < 50; ++round) {
+    for (int i = 0; i < 3; ++i) {
+      for (uint32_t done = 0; done < kRoundFrames; done += job_frames[i]) {
+        ExpectFrames(Read(&cache, pos[i], job_frames[i]), pos[i]);
+        pos[i] += job_frames[i];
+      }
+    }
+  }
+
+  EXPECT_EQ(1u, ring_buffer.max_conversions());
+  EXPECT_EQ(1u, ring_buffer.conversions(0));
+  EXPECT_EQ(1u, ring_buffer.conversions(50 * kRoundFrames - 1));
+}
+
+TEST(CaptureFrameCache, ScaleAndAccumulate) {
+  FakeRingBuffer ring_buffer;
+  CaptureFrameCache cache(kChannels, kCapacityFrames,
+                          ring_buffer.GetConvertFunc());
+
+  std::vector<float> dest(4 * kChannels, 1.0f);
+  cache.Read(10, 4, 0.5f, dest.data(), true);
+  for (size_t i = 0; i < dest.size(); ++i) {
+    EXPECT_EQ(1.0f + SampleValue(10 + i / kChannels, i % kChannels) * 0.5f,
+              dest[i]);
+  }
+
+  cache.Read(10, 4, 0.5f, dest.data(), false);
+  for (size_t i = 0; i < dest.size(); ++i) {
+    EXPECT_EQ(SampleValue(10 + i / kChannels, i % kChannels) * 0.5f, dest[i]);
+  }
+  EXPECT_EQ(1u, ring_buffer.max_conversions());
+}
+
+// Frames which are not captured yet are silence for the read which asked for
+// them, but a later read of the same frames gets the captured audio.
+TEST(CaptureFrameCache, FutureSilenceNotCached) {
+  FakeRingBuffer ring_buffer;
+  CaptureFrameCache cache(kChannels, kCapacityFrames,
+                          ring_buffer.GetConvertFunc());
+
+  ring_buffer.set_safe_region(0, 30);
+  ExpectFrames(Read(&cache, 0, 48), 0, 30, 48);
+  EXPECT_EQ(30, cache.end());
+
+  // Accumulating reads leave the missing frames alone.
+  std::vector<float> dest(48 * kChannels, 0.0f);
+  cache.Read(0, 48, Gain::kUnityScale, dest.data(), true);
+  ExpectFrames(dest, 0, 30, 48);
+
+  ring_buffer.set_safe_region(0, 100);
+  ExpectFrames(Read(&cache, 0, 48), 0);
+  EXPECT_EQ(48, cache.end());
+  EXPECT_EQ(1u, ring_buffer.max_conversions());
+}
+
+// Frames which have left the safe region are silence and are not cached; the
+// cached run starts over after them.
+TEST(CaptureFrameCache, PastSilenceNotCached) {
+  FakeRingBuffer ring_buffer;
+  CaptureFrameCache cache(kChannels, kCapacityFrames,
+                          ring_buffer.GetConvertFunc());
+
+  ring_buffer.set_safe_region(20, 100);
+  ExpectFrames(Read(&cache, 0, 48), 0, 0, 20);
+  EXPECT_EQ(20, cache.start());
+  EXPECT_EQ(48, cache.end());
+
+  // Entirely gone.
+  ring_buffer.set_safe_region(200, 300);
+  ExpectFrames(Read(&cache, 100, 48), 100, 100, 148);
+  EXPECT_EQ(cache.start(), cache.end());
+
+  // Reads pick up again once frames are available.
+  ExpectFrames(Read(&cache, 200, 48), 200);
+  EXPECT_EQ(200, cache.start());
+  EXPECT_EQ(248, cache.end());
+}
+
+// Capturers which are far apart (but within the cache's capacity) take turns
+// without evicting each other's frames; every frame is converted once.
+TEST(CaptureFrameCache, SkewedReadersDoNotThrash) {
+  FakeRingBuffer ring_buffer;
+  CaptureFrameCache cache(kChannels, kCapacityFrames,
+                          ring_buffer.GetConvertFunc());
+
+  constexpr uint32_t kJobFrames = 48;
+  constexpr int64_t kSkewFrames = kCapacityFrames - 2 * kJobFrames;
+  int64_t leading = kSkewFrames;
+  int64_t lagging = 0;
+  for (int round = 0; round < 40; ++round) {
+    ExpectFrames(Read(&cache, leading, kJobFrames), leading);
+    ExpectFrames(Read(&cache, lagging, kJobFrames), lagging);
+    leading += kJobFrames;
+    lagging += kJobFrames;
+  }
+
+  EXPECT_EQ(1u, ring_buffer.max_conversions());
+  EXPECT_EQ(1u, ring_buffer.conversions(0));
+  EXPECT_EQ(1u, ring_buffer.conversions(leading - 1));
+}
+
+// A read which is further ahead than the cache can hold starts over, rather
+// than converting frames which would be evicted before anyone reads them.
+TEST(CaptureFrameCache, FarAheadReadStartsOver) {
+  FakeRingBuffer ring_buffer;
+  CaptureFrameCache cache(kChannels, kCapacityFrames,
+                          ring_buffer.GetConvertFunc());
+
+  ExpectFrames(Read(&cache, 0, 48), 0);
+  ExpectFrames(Read(&cache, 10 * kCapacityFrames, 48), 10 * kCapacityFrames);
+  EXPECT_EQ(10 * kCapacityFrames, cache.start());
+  EXPECT_EQ(0u, ring_buffer.conversions(kCapacityFrames));
+
+  // The frames before the new run are gone from the cache, and are not
+  // converted again out of order.
+  ExpectFrames(Read(&cache, 0, 48), 0, 0, 48);
+  EXPECT_EQ(1u, ring_buffer.max_conversions());
+}
+
+// Reads which wrap around the end of the cache's storage.
+TEST(CaptureFrameCache, ReadWraps) {
+  FakeRingBuffer ring_buffer;
+  CaptureFrameCache cache(kChannels, kCapacityFrames,
+                          ring_buffer.GetConvertFunc());
+
+  for (int64_t frame = 0; frame < 4 * kCapacityFrames; frame += 100) {
+    ExpectFrames(Read(&cache, frame, 100), frame);
+  }
+  EXPECT_EQ(1u, ring_buffer.max_conversions());
+}
+
+}  // namespace
+}  // namespace test
+}  // namespace audio
+}  // namespace media
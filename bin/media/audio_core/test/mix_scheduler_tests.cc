@@ -0,0 +1,191 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "garnet/bin/media/audio_core/mix_scheduler.h"
+
+#include "gtest/gtest.h"
+
+namespace media {
+namespace audio {
+namespace test {
+namespace {
+
+// The bounds which DriverOutput schedules within.
+MixScheduler::Config TestConfig() {
+  MixScheduler::Config config;
+  config.min_lead = ZX_MSEC(5);
+  config.max_lead = ZX_MSEC(30);
+  config.min_period = ZX_MSEC(2);
+  config.max_period = ZX_MSEC(10);
+  config.safety_margin = ZX_MSEC(1);
+  config.window_cycles = 10;
+  return config;
+}
+
+// Report a full window of cycles which all wake up |latency| late and take
+// |duration| to mix.
+void RunWindow(MixScheduler* sched, zx_duration_t latency,
+               zx_duration_t duration) {
+  for (uint32_t i = 0; i < TestConfig().window_cycles; ++i) {
+    sched->OnCycle(latency, duration);
+  }
+}
+
+// Run windows of quick cycles until the scheduler stops adjusting.
+void Settle(MixScheduler* sched) {
+  for (int i = 0; i < 200; ++i) {
+    RunWindow(sched, ZX_USEC(100), ZX_USEC(100));
+  }
+}
+
+TEST(LatencyHistogram, Buckets) {
+  LatencyHistogram hist;
+  hist.Add(0);
+  hist.Add(ZX_NSEC(999));
+  hist.Add(ZX_USEC(1));
+  hist.Add(ZX_USEC(3));
+  hist.Add(ZX_USEC(4));
+  hist.Add(ZX_SEC(100));
+
+  EXPECT_EQ(6u, hist.count());
+  EXPECT_EQ(ZX_SEC(100), hist.max());
+  EXPECT_EQ(2u, hist.buckets()[0]);
+  EXPECT_EQ(1u, hist.buckets()[1]);
+  EXPECT_EQ(1u, hist.buckets()[2]);
+  EXPECT_EQ(1u, hist.buckets()[3]);
+  EXPECT_EQ(1u, hist.buckets()[LatencyHistogram::kNumBuckets - 1]);
+
+  hist.Reset();
+  EXPECT_EQ(0u, hist.count());
+  EXPECT_EQ(0, hist.max());
+  EXPECT_EQ(0u, hist.buckets()[0]);
+}
+
+TEST(LatencyHistogram, Percentile) {
+  LatencyHistogram hist;
+  EXPECT_EQ(0, hist.Percentile(99));
+
+  // 98 samples of 10 uSec (in the [8, 16) uSec bucket) and 2 of 1 mSec.
+  for (int i = 0; i < 98; ++i) {
+    hist.Add(ZX_USEC(10));
+  }
+  hist.Add(ZX_MSEC(1));
+  hist.Add(ZX_MSEC(1));
+
+  EXPECT_EQ(ZX_USEC(16), hist.Percentile(50));
+  EXPECT_EQ(ZX_USEC(16), hist.Percentile(98));
+
+  // Bucket limits are capped by the largest sample.
+  EXPECT_EQ(ZX_MSEC(1), hist.Percentile(99));
+  EXPECT_EQ(ZX_MSEC(1), hist.Percentile(100));
+}
+
+TEST(MixScheduler, StartsConservative) {
+  MixScheduler sched(TestConfig());
+  EXPECT_EQ(ZX_MSEC(30), sched.lead());
+  EXPECT_EQ(ZX_MSEC(10), sched.period());
+}
+
+TEST(MixScheduler, FixedConfigNeverAdjusts) {
+  MixScheduler sched(MixScheduler::FixedConfig(ZX_MSEC(20), ZX_MSEC(5)));
+  RunWindow(&sched, ZX_USEC(100), ZX_USEC(100));
+  sched.OnUnderflow();
+  RunWindow(&sched, ZX_MSEC(50), ZX_MSEC(50));
+
+  EXPECT_EQ(ZX_MSEC(20), sched.lead());
+  EXPECT_EQ(ZX_MSEC(5), sched.period());
+
+  auto stats = sched.GetStats();
+  EXPECT_EQ(2u * TestConfig().window_cycles, stats.cycles);
+  EXPECT_EQ(1u, stats.underflows);
+  EXPECT_EQ(0u, stats.adjustments);
+}
+
+TEST(MixScheduler, StepsDownGradually) {
+  MixScheduler sched(TestConfig());
+
+  // The low water mark drops by at most 0.5 mSec per window.
+  RunWindow(&sched, ZX_USEC(100), ZX_USEC(100));
+  EXPECT_EQ(ZX_USEC(19500), sched.lead() - sched.period());
+
+  // Until the lead and period bottom out.
+  Settle(&sched);
+  EXPECT_EQ(ZX_MSEC(5), sched.lead());
+  EXPECT_EQ(ZX_MSEC(2), sched.period());
+  EXPECT_GT(sched.GetStats().headroom, 0);
+}
+
+TEST(MixScheduler, IncreasesImmediately) {
+  MixScheduler sched(TestConfig());
+  Settle(&sched);
+
+  // A single window of slow wakeups raises the low water mark to cover them,
+  // plus the safety margin.
+  RunWindow(&sched, ZX_MSEC(4), ZX_MSEC(1));
+  EXPECT_EQ(ZX_MSEC(6), sched.lead() - sched.period());
+  EXPECT_EQ(ZX_MSEC(3), sched.period());
+  EXPECT_EQ(ZX_MSEC(9), sched.lead());
+}
+
+// An underflow doubles the low water mark without waking up more often.
+TEST(MixScheduler, UnderflowRaisesLowWater) {
+  MixScheduler sched(TestConfig());
+  Settle(&sched);
+  ASSERT_EQ(ZX_MSEC(3), sched.lead() - sched.period());
+
+  sched.OnUnderflow();
+  EXPECT_EQ(ZX_MSEC(6), sched.lead() - sched.period());
+  EXPECT_EQ(ZX_MSEC(3), sched.period());
+  EXPECT_EQ(1u, sched.GetStats().underflows);
+
+  sched.OnUnderflow();
+  EXPECT_EQ(ZX_MSEC(12), sched.lead() - sched.period());
+  EXPECT_EQ(ZX_MSEC(6), sched.period());
+}
+
+// Once the maximum lead time is reached, an underflow must not buy low water
+// by shrinking the period.
+TEST(MixScheduler, UnderflowAtMaxLeadKeepsPeriod) {
+  MixScheduler sched(TestConfig());
+  sched.OnUnderflow();
+  EXPECT_EQ(ZX_MSEC(30), sched.lead());
+  EXPECT_EQ(ZX_MSEC(10), sched.period());
+
+  MixScheduler settled(TestConfig());
+  Settle(&settled);
+  for (int i = 0; i < 10; ++i) {
+    zx_duration_t period = settled.period();
+    settled.OnUnderflow();
+    EXPECT_GE(settled.period(), period);
+    EXPECT_LE(settled.lead(), ZX_MSEC(30));
+  }
+  EXPECT_EQ(ZX_MSEC(30), settled.lead());
+  EXPECT_EQ(ZX_MSEC(10), settled.period());
+}
+
+// After an underflow, the low water mark is held for 30 windows before it
+// starts to come back down.
+TEST(MixScheduler, HoldThenRecoverAfterUnderflow) {
+  MixScheduler sched(TestConfig());
+  Settle(&sched);
+  sched.OnUnderflow();
+  const zx_duration_t held = sched.lead() - sched.period();
+
+  for (int i = 0; i < 30; ++i) {
+    RunWindow(&sched, ZX_USEC(100), ZX_USEC(100));
+    ASSERT_EQ(held, sched.lead() - sched.period()) << "window " << i;
+  }
+
+  RunWindow(&sched, ZX_USEC(100), ZX_USEC(100));
+  EXPECT_EQ(held - ZX_USEC(500), sched.lead() - sched.period());
+
+  Settle(&sched);
+  EXPECT_EQ(ZX_MSEC(5), sched.lead());
+  EXPECT_EQ(ZX_MSEC(2), sched.period());
+}
+
+}  // namespace
+}  // namespace test
+}  // namespace audio
+}  // namespace media
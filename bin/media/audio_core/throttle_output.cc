@@ -14,8 +14,12 @@ namespace audio {
 static constexpr fxl::TimeDelta TRIM_PERIOD =
     fxl::TimeDelta::FromMilliseconds(10);
 
+// The throttle output never mixes, so there is nothing for the scheduler to
+// tune. We still let it gather wakeup statistics for us.
 ThrottleOutput::ThrottleOutput(AudioDeviceManager* manager)
-    : StandardOutputBase(manager) {}
+    : StandardOutputBase(
+          manager, MixScheduler::FixedConfig((TRIM_PERIOD * 2).ToNanoseconds(),
+                                             TRIM_PERIOD.ToNanoseconds())) {}
 
 ThrottleOutput::~ThrottleOutput() {}
 
@@ -89,7 +89,9 @@ class Builder {
   Builder(const StreamType& in_type,
           const std::vector<std::unique_ptr<StreamTypeSet>>& out_type_sets,
           Graph* graph, DecoderFactory* decoder_factory, OutputRef output,
-          fit::function<void(OutputRef, std::unique_ptr<StreamType>)> callback);
+          fit::function<void(OutputRef, std::unique_ptr<StreamType>,
+                             std::shared_ptr<Decoder>)>
+              callback);
 
   ~Builder() = default;
 
@@ -117,14 +119,19 @@ class Builder {
   DecoderFactory* decoder_factory_;
   OutputRef output_;
   const OutputRef original_output_;
-  const fit::function<void(OutputRef, std::unique_ptr<StreamType>)> callback_;
+  std::shared_ptr<Decoder> decoder_;
+  const fit::function<void(OutputRef, std::unique_ptr<StreamType>,
+                           std::shared_ptr<Decoder>)>
+      callback_;
 };
 
 Builder::Builder(
     const StreamType& in_type,
     const std::vector<std::unique_ptr<StreamTypeSet>>& out_type_sets,
     Graph* graph, DecoderFactory* decoder_factory, OutputRef output,
-    fit::function<void(OutputRef, std::unique_ptr<StreamType>)> callback)
+    fit::function<void(OutputRef, std::unique_ptr<StreamType>,
+                       std::shared_ptr<Decoder>)>
+        callback)
     : type_(in_type.Clone()),
       out_type_sets_(out_type_sets),
       graph_(graph),
@@ -158,13 +165,13 @@ void Builder::Build() {
 }
 
 void Builder::Succeed() {
-  callback_(output_, type_->Clone());
+  callback_(output_, type_->Clone(), std::move(decoder_));
   delete this;
 }
 
 void Builder::Fail() {
   graph_->RemoveNodesConnectedToOutput(original_output_);
-  callback_(original_output_, nullptr);
+  callback_(original_output_, nullptr, nullptr);
   delete this;
 }
 
@@ -218,6 +225,7 @@ void Builder::AddDecoder() {
         output_ =
             graph_->ConnectOutputToNode(output_, graph_->Add(decoder)).output();
         type_ = decoder->output_stream_type();
+        decoder_ = std::move(decoder);
 
         Build();
       });
@@ -281,7 +289,9 @@ void BuildConversionPipeline(
     const StreamType& in_type,
     const std::vector<std::unique_ptr<StreamTypeSet>>& out_type_sets,
     Graph* graph, DecoderFactory* decoder_factory, OutputRef output,
-    fit::function<void(OutputRef, std::unique_ptr<StreamType>)> callback) {
+    fit::function<void(OutputRef, std::unique_ptr<StreamType>,
+                       std::shared_ptr<Decoder>)>
+        callback) {
   FXL_DCHECK(graph);
   FXL_DCHECK(decoder_factory);
   FXL_DCHECK(output);
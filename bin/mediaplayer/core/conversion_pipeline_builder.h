@@ -16,14 +16,17 @@ namespace media_player {
 
 // Attempts to add transforms to the given pipeline to convert in_type to a
 // type compatible with out_type_sets. If it succeeds, the function calls back
-// with the OutputRef for the end of the pipeline and the new stream type. If it
-// fails, the function calls back with the original OutputRef and a null
-// stream type pointer.
+// with the OutputRef for the end of the pipeline, the new stream type and the
+// decoder in the pipeline, if one was added. If it fails, the function calls
+// back with the original OutputRef, a null stream type pointer and a null
+// decoder.
 void BuildConversionPipeline(
     const StreamType& in_type,
     const std::vector<std::unique_ptr<StreamTypeSet>>& out_type_sets,
     Graph* graph, DecoderFactory* decoder_factory, OutputRef output,
-    fit::function<void(OutputRef, std::unique_ptr<StreamType>)> callback);
+    fit::function<void(OutputRef, std::unique_ptr<StreamType>,
+                       std::shared_ptr<Decoder>)>
+        callback);
 
 }  // namespace media_player
 
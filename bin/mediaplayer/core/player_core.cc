@@ -6,7 +6,9 @@
 
 #include <lib/async/cpp/task.h>
 #include <lib/async/dispatcher.h>
+#include <algorithm>
 #include <queue>
+#include <sstream>
 #include <unordered_set>
 #include "garnet/bin/mediaplayer/graph/formatting.h"
 #include "garnet/bin/mediaplayer/util/callback_joiner.h"
@@ -128,7 +130,7 @@ void PlayerCore::SetTimelineFunction(media::TimelineFunction timeline_function,
 
   int64_t reference_time = timeline_function.reference_time();
   if (reference_time == fuchsia::media::NO_TIMESTAMP) {
-    reference_time = media::Timeline::local_now() + kMinimumLeadTime;
+    reference_time = media::Timeline::local_now() + min_lead_time();
   }
 
   int64_t subject_time = timeline_function.subject_time();
@@ -189,6 +191,18 @@ bool PlayerCore::end_of_stream() const {
   return result;
 }
 
+int64_t PlayerCore::output_delay() const {
+  int64_t result = 0;
+
+  for (auto& stream : streams_) {
+    if (stream.sink_segment_ && stream.sink_segment_->connected()) {
+      result = std::max(result, stream.sink_segment_->output_delay());
+    }
+  }
+
+  return result;
+}
+
 int64_t PlayerCore::duration_ns() const {
   if (source_segment_) {
     return source_segment_->duration_ns();
@@ -370,19 +384,45 @@ void PlayerCore::ConnectStream(Stream* stream) {
       });
 }
 
-void PlayerCore::Dump(std::ostream& os) const {
-  std::queue<NodeRef> backlog;
+std::vector<PlayerCore::StageMetricsEntry> PlayerCore::GetStageMetrics()
+    const {
+  std::vector<StageMetricsEntry> result;
+
+  VisitNodes([&result](NodeRef node, const std::string& segment) {
+    FXL_DCHECK(node.metrics());
+    result.push_back({segment, node.GetGenericNode()->label(),
+                      node.metrics()->snapshot()});
+  });
+
+  return result;
+}
+
+void PlayerCore::ResetStageMetrics() {
+  VisitNodes([](NodeRef node, const std::string& segment) {
+    FXL_DCHECK(node.metrics());
+    node.metrics()->Reset();
+  });
+}
+
+void PlayerCore::VisitNodes(
+    fit::function<void(NodeRef node, const std::string& segment)> visitor)
+    const {
+  if (!source_node()) {
+    return;
+  }
+
+  std::queue<std::pair<NodeRef, std::string>> backlog;
   std::unordered_set<GenericNode*> visited;
 
-  backlog.push(source_node());
+  backlog.emplace(source_node(), "source");
   visited.insert(source_node().GetGenericNode());
 
   while (!backlog.empty()) {
-    NodeRef node = backlog.front();
+    NodeRef node = backlog.front().first;
+    std::string segment = std::move(backlog.front().second);
     backlog.pop();
 
-    os << fostr::NewLine << fostr::NewLine;
-    node.GetGenericNode()->Dump(os);
+    visitor(node, segment);
 
     for (size_t output_index = 0; output_index < node.output_count();
          ++output_index) {
@@ -397,10 +437,56 @@ void PlayerCore::Dump(std::ostream& os) const {
         continue;
       }
 
-      backlog.push(downstream);
+      // Crossing a stream's output takes us from the source segment into a
+      // sink segment.
+      std::string downstream_segment = segment;
+      for (auto& stream : streams_) {
+        if (stream.output_ == output && stream.stream_type_) {
+          std::ostringstream os;
+          os << stream.stream_type_->medium() << " sink";
+          downstream_segment = os.str();
+          break;
+        }
+      }
+
+      backlog.emplace(downstream, std::move(downstream_segment));
       visited.insert(downstream_generic_node);
     }
   }
 }
 
+void PlayerCore::Dump(std::ostream& os) const {
+  VisitNodes([&os](NodeRef node, const std::string& segment) {
+    os << fostr::NewLine << fostr::NewLine;
+    node.GetGenericNode()->Dump(os);
+  });
+
+  std::vector<StageMetricsEntry> metrics = GetStageMetrics();
+  if (metrics.empty()) {
+    return;
+  }
+
+  os << fostr::NewLine << fostr::NewLine << "stage metrics:" << fostr::Indent;
+
+  const StageMetricsEntry* busiest = nullptr;
+  for (auto& entry : metrics) {
+    const StageMetrics::Snapshot& snapshot = entry.snapshot_;
+    os << fostr::NewLine << entry.segment_ << " / " << entry.stage_ << ": busy "
+       << static_cast<int>(snapshot.busy_fraction() * 100.0 + 0.5)
+       << "%, input wait " << AsNs(snapshot.input_wait_.mean())
+       << ", output wait " << AsNs(snapshot.output_wait_.mean())
+       << ", payload wait " << AsNs(snapshot.payload_wait_.mean())
+       << ", max queue " << snapshot.max_queue_depth();
+    if (busiest == nullptr || busiest->snapshot_.busy_fraction() <
+                                  entry.snapshot_.busy_fraction()) {
+      busiest = &entry;
+    }
+  }
+
+  FXL_DCHECK(busiest);
+  os << fostr::NewLine << "busiest stage:  " << busiest->segment_ << " / "
+     << busiest->stage_;
+  os << fostr::Outdent;
+}
+
 }  // namespace media_player
@@ -5,6 +5,7 @@
 #ifndef GARNET_BIN_MEDIAPLAYER_CORE_PLAYER_CORE_H_
 #define GARNET_BIN_MEDIAPLAYER_CORE_PLAYER_CORE_H_
 
+#include <string>
 #include <unordered_map>
 #include <vector>
 
@@ -15,6 +16,7 @@
 #include "garnet/bin/mediaplayer/core/source_segment.h"
 #include "garnet/bin/mediaplayer/graph/graph.h"
 #include "garnet/bin/mediaplayer/graph/metadata.h"
+#include "garnet/bin/mediaplayer/graph/stages/stage_metrics.h"
 #include "lib/media/timeline/timeline.h"
 #include "lib/media/timeline/timeline_function.h"
 
@@ -100,6 +102,14 @@ class PlayerCore {
   // Indicates whether the player has reached end of stream.
   bool end_of_stream() const;
 
+  // Returns the largest output delay, in nanoseconds, of the connected sink
+  // segments. A timeline started less than this far in the future may present
+  // late frames.
+  int64_t output_delay() const;
+
+  // Returns the minimum lead time, in nanoseconds, for starting the timeline.
+  int64_t min_lead_time() const { return kMinimumLeadTime + output_delay(); }
+
   // Returns the duration of the content in nanoseconds or 0 if the duration is
   // currently unknown.
   int64_t duration_ns() const;
@@ -124,6 +134,24 @@ class PlayerCore {
     return source_segment_ ? source_segment_->source_node() : NodeRef();
   }
 
+  // Performance counters for one stage in the graph.
+  struct StageMetricsEntry {
+    // "source" for stages belonging to the source segment, otherwise the
+    // medium of the sink segment, e.g. "video sink".
+    std::string segment_;
+    std::string stage_;
+    StageMetrics::Snapshot snapshot_;
+  };
+
+  // Returns performance counters for every stage in the graph, in upstream to
+  // downstream order. The segment that limits a stream is usually the one
+  // containing the stage with the highest |busy_fraction|.
+  std::vector<StageMetricsEntry> GetStageMetrics() const;
+
+  // Discards the performance counters accumulated so far by all the stages
+  // in the graph.
+  void ResetStageMetrics();
+
   // Generates an introspection report.
   void Dump(std::ostream& os) const;
 
@@ -174,6 +202,12 @@ class PlayerCore {
   // Connects the specified stream.
   void ConnectStream(Stream* stream);
 
+  // Calls |visitor| for each node reachable from the source node, upstream
+  // nodes first, along with the label of the segment the node belongs to.
+  void VisitNodes(
+      fit::function<void(NodeRef node, const std::string& segment)> visitor)
+      const;
+
   Graph graph_;
   async_dispatcher_t* dispatcher_;
   fit::closure update_callback_;
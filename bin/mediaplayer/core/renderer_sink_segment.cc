@@ -54,7 +54,10 @@ void RendererSinkSegment::Connect(const StreamType& type, OutputRef output,
       output,
       [this, callback = std::move(callback),
        is_audio = type.medium() == StreamType::Medium::kAudio](
-          OutputRef output, std::unique_ptr<StreamType> stream_type) {
+          OutputRef output, std::unique_ptr<StreamType> stream_type,
+          std::shared_ptr<Decoder> decoder) {
+        decoder_ = std::move(decoder);
+
         if (!stream_type) {
           ReportProblem(
               is_audio
@@ -84,6 +87,7 @@ void RendererSinkSegment::Disconnect() {
   graph().RemoveNodesConnectedToInput(renderer_node_.input());
 
   connected_output_ = nullptr;
+  decoder_ = nullptr;
 }
 
 void RendererSinkSegment::Prime(fit::closure callback) {
@@ -44,9 +44,14 @@ class RendererSinkSegment : public SinkSegment {
 
   bool end_of_stream() const override { return renderer_->end_of_stream(); }
 
+  int64_t output_delay() const override {
+    return decoder_ ? decoder_->output_delay() : 0;
+  }
+
  private:
   std::shared_ptr<Renderer> renderer_;
   DecoderFactory* decoder_factory_;
+  std::shared_ptr<Decoder> decoder_;
   NodeRef renderer_node_;
   OutputRef connected_output_;
 };
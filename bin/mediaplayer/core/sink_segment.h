@@ -54,6 +54,10 @@ class SinkSegment : public Segment {
 
   // Indicates whether this sink segment has reached end of stream.
   virtual bool end_of_stream() const = 0;
+
+  // Returns the time, in nanoseconds, by which the segment's decoder (if any)
+  // delays its output.
+  virtual int64_t output_delay() const { return 0; }
 };
 
 }  // namespace media_player
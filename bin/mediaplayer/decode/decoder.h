@@ -21,6 +21,12 @@ class Decoder : public AsyncNode {
 
   // Returns the type of the stream the decoder will produce.
   virtual std::unique_ptr<StreamType> output_stream_type() const = 0;
+
+  // Returns the time, in nanoseconds of presentation time, by which the
+  // decoder holds back its output (e.g. for reordering or multi-threaded
+  // decoding). This may change as decoding progresses and may be called from
+  // any thread.
+  virtual int64_t output_delay() const { return 0; }
 };
 
 // Abstract base class for |Decoder| factories.
@@ -160,9 +160,12 @@ void SoftwareDecoder::HandleInputPacketOnWorker(PacketPtr input) {
     }
   }
 
+  int64_t duration = media::Timeline::local_now() - start_time;
+  stage()->ReportProcessing(duration);
+
   {
     std::lock_guard<std::mutex> locker(decode_duration_mutex_);
-    decode_duration_.AddSample(media::Timeline::local_now() - start_time);
+    decode_duration_.AddSample(duration);
   }
 
   PostTaskToMainThread([this]() { WorkerDoneWithInputPacket(); });
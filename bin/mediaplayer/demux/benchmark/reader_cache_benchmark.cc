@@ -0,0 +1,281 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Replays seek-heavy access patterns against ReaderCache, backed by an
+// upstream reader which produces data instantly, and reports the time and the
+// number of heap allocations per read.
+
+#include <lib/async-loop/cpp/loop.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "garnet/bin/mediaplayer/demux/reader_cache.h"
+#include "lib/fxl/command_line.h"
+#include "lib/fxl/logging.h"
+
+namespace {
+
+std::atomic<uint64_t> allocation_count{0};
+
+void* CountedAlloc(size_t size) {
+  allocation_count.fetch_add(1, std::memory_order_relaxed);
+  void* ptr = malloc(size ? size : 1);
+  if (ptr == nullptr) {
+    abort();
+  }
+  return ptr;
+}
+
+}  // namespace
+
+void* operator new(size_t size) { return CountedAlloc(size); }
+void* operator new[](size_t size) { return CountedAlloc(size); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+  return CountedAlloc(size);
+}
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+  return CountedAlloc(size);
+}
+void operator delete(void* ptr) noexcept { free(ptr); }
+void operator delete[](void* ptr) noexcept { free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { free(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { free(ptr); }
+
+namespace media_player {
+namespace {
+
+constexpr size_t kAssetSize = 512 * 1024 * 1024;
+constexpr size_t kReadSize = 32 * 1024;
+constexpr size_t kReadsPerRun = 64;
+constexpr size_t kRuns = 256;
+
+// A reader which completes each read as soon as it's pumped, without posting
+// anything to the dispatcher, so the benchmark measures only ReaderCache.
+class InstantReader : public Reader {
+ public:
+  void Describe(DescribeCallback callback) override {
+    callback(Result::kOk, kAssetSize, true);
+  }
+
+  void ReadAt(size_t position, uint8_t* buffer, size_t bytes_to_read,
+              ReadAtCallback callback) override {
+    FXL_DCHECK(!pending_callback_);
+    pending_bytes_ = std::min(bytes_to_read, kAssetSize - position);
+    memset(buffer, static_cast<uint8_t>(position), pending_bytes_);
+    pending_callback_ = std::move(callback);
+  }
+
+  // Completes the pending read, if any. Returns false if there was none.
+  bool Pump() {
+    if (!pending_callback_) {
+      return false;
+    }
+
+    ReadAtCallback callback = std::move(pending_callback_);
+    pending_callback_ = nullptr;
+    bytes_read_ += pending_bytes_;
+    callback(Result::kOk, pending_bytes_);
+    return true;
+  }
+
+  size_t bytes_read() const { return bytes_read_; }
+
+ private:
+  ReadAtCallback pending_callback_;
+  size_t pending_bytes_ = 0;
+  size_t bytes_read_ = 0;
+};
+
+struct Pattern {
+  const char* name;
+  // Returns the start position of run |run|, given the end of the previous
+  // run.
+  size_t (*next_run)(size_t run, size_t previous_end, std::mt19937* random);
+};
+
+const Pattern kPatterns[] = {
+    {"Sequential",
+     [](size_t run, size_t previous_end, std::mt19937* random) {
+       return previous_end;
+     }},
+    {"SkipForward",
+     [](size_t run, size_t previous_end, std::mt19937* random) {
+       return previous_end + 8 * 1024 * 1024;
+     }},
+    {"ScrubBack",
+     [](size_t run, size_t previous_end, std::mt19937* random) {
+       size_t back = 6 * 1024 * 1024;
+       return run == 0 ? kAssetSize / 2
+                       : (previous_end > back ? previous_end - back : 0);
+     }},
+    {"Random",
+     [](size_t run, size_t previous_end, std::mt19937* random) {
+       return static_cast<size_t>((*random)() % (kAssetSize / kReadSize)) *
+              kReadSize;
+     }},
+    {"Alternating",
+     [](size_t run, size_t previous_end, std::mt19937* random) {
+       // Bounce between two playheads, as when seeking back and forth between
+       // two points of interest.
+       if (run == 0) {
+         return kAssetSize / 2;
+       }
+       return (run % 2) ? previous_end - kAssetSize / 4
+                        : previous_end + kAssetSize / 4;
+     }},
+};
+
+// Builds the list of read positions for a pattern up front, so building it
+// doesn't count against the cache.
+std::vector<size_t> ReadPositions(const Pattern& pattern) {
+  std::mt19937 random(0x5eed);
+  std::vector<size_t> positions;
+  positions.reserve(kRuns * kReadsPerRun);
+  size_t end = 0;
+  for (size_t run = 0; run < kRuns; ++run) {
+    size_t position = pattern.next_run(run, end, &random);
+    if (position + kReadsPerRun * kReadSize > kAssetSize) {
+      position = 0;
+    }
+
+    for (size_t read = 0; read < kReadsPerRun; ++read) {
+      positions.push_back(position);
+      position += kReadSize;
+    }
+
+    end = position;
+  }
+
+  return positions;
+}
+
+std::string Label(const Pattern& pattern, bool no_copy) {
+  return std::string(pattern.name) + (no_copy ? "/NoCopy" : "/Copy");
+}
+
+struct BenchmarkResult {
+  std::string label;
+  double ns_per_read;
+  double allocations_per_read;
+  double upstream_bytes_per_read;
+};
+
+BenchmarkResult RunPattern(const Pattern& pattern, bool no_copy, size_t chunk_size) {
+  std::vector<size_t> positions = ReadPositions(pattern);
+  std::vector<uint8_t> dest(kReadSize);
+
+  async::Loop loop(&kAsyncLoopConfigAttachToThread);
+  auto upstream = std::make_shared<InstantReader>();
+  auto cache = ReaderCache::Create(upstream);
+  cache->SetCacheOptions(16 * 1024 * 1024, 4 * 1024 * 1024, chunk_size);
+
+  // Let the initial load finish before timing anything.
+  loop.RunUntilIdle();
+  while (upstream->Pump()) {
+  }
+
+  size_t upstream_bytes_before = upstream->bytes_read();
+  uint64_t allocations_before = allocation_count.load();
+  auto start_time = std::chrono::steady_clock::now();
+
+  for (size_t position : positions) {
+    size_t remaining = kReadSize;
+    while (remaining != 0) {
+      bool done = false;
+      size_t bytes_read = 0;
+      if (no_copy) {
+        cache->ReadAtNoCopy(position, remaining,
+                            [&done, &bytes_read](Result result,
+                                                 const uint8_t* data,
+                                                 size_t size) {
+                              FXL_CHECK(result == Result::kOk);
+                              bytes_read = size;
+                              done = true;
+                            });
+      } else {
+        cache->ReadAt(position, dest.data(), remaining,
+                      [&done, &bytes_read](Result result, size_t size) {
+                        FXL_CHECK(result == Result::kOk);
+                        bytes_read = size;
+                        done = true;
+                      });
+      }
+
+      while (!done) {
+        loop.RunUntilIdle();
+        if (!done) {
+          bool pumped = upstream->Pump();
+          FXL_CHECK(pumped) << "Read stalled";
+        }
+      }
+
+      FXL_CHECK(bytes_read != 0);
+      position += bytes_read;
+      remaining -= bytes_read;
+    }
+  }
+
+  auto elapsed = std::chrono::steady_clock::now() - start_time;
+  uint64_t allocations = allocation_count.load() - allocations_before;
+
+  BenchmarkResult result;
+  result.label = Label(pattern, no_copy);
+  result.ns_per_read =
+      static_cast<double>(
+          std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed)
+              .count()) /
+      positions.size();
+  result.allocations_per_read =
+      static_cast<double>(allocations) / positions.size();
+  result.upstream_bytes_per_read =
+      static_cast<double>(upstream->bytes_read() - upstream_bytes_before) /
+      positions.size();
+  return result;
+}
+
+}  // namespace
+}  // namespace media_player
+
+int main(int argc, char** argv) {
+  auto command_line = fxl::CommandLineFromArgcArgv(argc, argv);
+  std::string filter;
+  command_line.GetOptionValue("filter", &filter);
+
+  size_t chunk_size = 1024 * 1024;
+  std::string value;
+  if (command_line.GetOptionValue("chunk", &value)) {
+    chunk_size = strtoul(value.c_str(), nullptr, 0);
+  }
+
+  if (command_line.HasOption("help") || chunk_size == 0) {
+    printf("Usage: %s [--filter=<substring>] [--chunk=<bytes>]\n", argv[0]);
+    return 0;
+  }
+
+  printf("%-24s %12s %12s %14s\n", "Case", "ns/read", "Allocs/read",
+         "Upstream/read");
+  for (const auto& pattern : media_player::kPatterns) {
+    for (bool no_copy : {false, true}) {
+      if (!filter.empty() && media_player::Label(pattern, no_copy)
+                                     .find(filter) == std::string::npos) {
+        continue;
+      }
+
+      auto result = media_player::RunPattern(pattern, no_copy, chunk_size);
+      printf("%-24s %12.0f %12.2f %14.0f\n", result.label.c_str(),
+             result.ns_per_read, result.allocations_per_read,
+             result.upstream_bytes_per_read);
+    }
+  }
+
+  return 0;
+}
@@ -5,7 +5,9 @@
 #ifndef GARNET_BIN_MEDIAPLAYER_DEMUX_HTTP_READER_H_
 #define GARNET_BIN_MEDIAPLAYER_DEMUX_HTTP_READER_H_
 
+#include <memory>
 #include <string>
+#include <vector>
 
 #include <fuchsia/net/oldhttp/cpp/fidl.h>
 #include <lib/async/cpp/wait.h>
@@ -17,8 +19,16 @@
 namespace media_player {
 
 // Reads from a file on behalf of a demux.
+//
+// If the server accepts range requests, HttpReader will serve up to
+// kMaxConnections reads concurrently, each over its own connection and each
+// requesting only the range being read. Otherwise, reads are served one at a
+// time, sequentially from the start of the content.
 class HttpReader : public Reader {
  public:
+  // The maximum number of connections used for concurrent reads.
+  static constexpr size_t kMaxConnections = 4;
+
   static std::shared_ptr<HttpReader> Create(
       component::StartupContext* startup_context, const std::string& url,
     fidl::VectorPtr<fuchsia::net::oldhttp::HttpHeader> headers);
@@ -35,39 +45,54 @@ class HttpReader : public Reader {
   void ReadAt(size_t position, uint8_t* buffer, size_t bytes_to_read,
               ReadAtCallback callback) override;
 
- private:
-  // Reads from an open |socket_|.
-  void ReadFromSocket();
-
-  // Completes a pending ReadAt.
-  void CompleteReadAt(Result result, size_t bytes_read);
-
-  // Fails the pending ReadAt.
-  void FailReadAt(zx_status_t status);
+  // Returns kMaxConnections if the server accepts range requests, 1 otherwise.
+  size_t MaxConcurrentReads() override;
 
-  // Fails the pending ReadAt.
-  void FailReadAt(Result result);
-
-  // Performs an HTTP load and reads from the resulting socket.
-  void LoadAndReadFromSocket();
+ private:
+  // A URL loader and the socket from its most recent load, along with the
+  // parameters of the ReadAt it's serving, if any.
+  struct Connection {
+    ::fuchsia::net::oldhttp::URLLoaderPtr url_loader;
+    zx::socket socket;
+    std::unique_ptr<async::Wait> waiter;
+    size_t socket_position = kUnknownSize;
+    bool busy = false;
+
+    // Pending ReadAt parameters.
+    size_t read_at_position;
+    uint8_t* read_at_buffer;
+    size_t read_at_bytes_to_read;
+    size_t read_at_bytes_remaining;
+    ReadAtCallback read_at_callback;
+  };
+
+  // Returns an idle connection, creating one if there's none to spare.
+  Connection* GetConnection();
+
+  // Reads from the open socket of |connection|.
+  void ReadFromSocket(Connection* connection);
+
+  // Completes the pending ReadAt on |connection|.
+  void CompleteReadAt(Connection* connection, Result result,
+                      size_t bytes_read);
+
+  // Fails the pending ReadAt on |connection|.
+  void FailReadAt(Connection* connection, zx_status_t status);
+
+  // Fails the pending ReadAt on |connection|.
+  void FailReadAt(Connection* connection, Result result);
+
+  // Performs an HTTP load on |connection| and reads from the resulting socket.
+  void LoadAndReadFromSocket(Connection* connection);
 
   std::string url_;
   fidl::VectorPtr<fuchsia::net::oldhttp::HttpHeader> headers_;
-  ::fuchsia::net::oldhttp::URLLoaderPtr url_loader_;
+  ::fuchsia::net::oldhttp::HttpServicePtr network_service_;
+  std::vector<std::unique_ptr<Connection>> connections_;
   Result result_ = Result::kOk;
   uint64_t size_ = kUnknownSize;
   bool can_seek_ = false;
-  zx::socket socket_;
-  std::unique_ptr<async::Wait> waiter_;
-  size_t socket_position_ = kUnknownSize;
   Incident ready_;
-
-  // Pending ReadAt parameters.
-  size_t read_at_position_;
-  uint8_t* read_at_buffer_;
-  size_t read_at_bytes_to_read_;
-  size_t read_at_bytes_remaining_;
-  ReadAtCallback read_at_callback_;
 };
 
 }  // namespace media_player
@@ -35,6 +35,10 @@ class Reader {
   // callback.
   virtual void ReadAt(size_t position, uint8_t* buffer, size_t bytes_to_read,
                       ReadAtCallback callback) = 0;
+
+  // Returns the number of ReadAt calls that may be pending at once. ReadAt
+  // must not be called while this many calls have yet to call back.
+  virtual size_t MaxConcurrentReads() { return 1; }
 };
 
 }  // namespace media_player
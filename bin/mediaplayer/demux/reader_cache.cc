@@ -4,11 +4,34 @@
 
 #include "garnet/bin/mediaplayer/demux/reader_cache.h"
 
+#include <algorithm>
+
 #include "lib/async/cpp/task.h"
+#include "lib/async/cpp/time.h"
 #include "lib/async/default.h"
 #include "lib/fxl/logging.h"
 
 namespace media_player {
+namespace {
+
+// The minimum period over which the consumption rate is measured.
+constexpr zx::duration kRateWindow = zx::sec(1);
+
+// How much we read ahead beyond what's needed to cover two fetch durations at
+// the consumption rate.
+constexpr zx::duration kReadaheadMargin = zx::sec(2);
+
+// The least we ever read ahead, in chunks.
+constexpr size_t kMinReadaheadChunks = 4;
+
+// Updates the exponentially-weighted moving average |average| with |sample|.
+// An |average| of zero means there have been no samples yet.
+template <typename T>
+T Smooth(T average, T sample) {
+  return average == T() ? sample : (average * 3 + sample) / 4;
+}
+
+}  // namespace
 
 // static
 std::shared_ptr<ReaderCache> ReaderCache::Create(
@@ -23,8 +46,10 @@ ReaderCache::ReaderCache(std::shared_ptr<Reader> upstream_reader)
                                                      bool can_seek) {
     upstream_size_ = size;
     upstream_can_seek_ = can_seek;
+    upstream_max_reads_ = upstream_reader->MaxConcurrentReads();
+    FXL_DCHECK(upstream_max_reads_ > 0);
     last_result_ = result;
-    buffer_.Initialize(size);
+    buffer_.Initialize(size, chunk_size_);
 
     async::PostTask(dispatcher_, [this]() { MaybeStartLoadForPosition(0); });
 
@@ -47,22 +72,19 @@ void ReaderCache::ReadAt(size_t position, uint8_t* buffer, size_t bytes_to_read,
 
   describe_is_complete_.When([this, position, buffer, bytes_to_read,
                               callback = std::move(callback)]() mutable {
-    FXL_DCHECK(position < upstream_size_);
-
-    size_t bytes_read = buffer_.ReadRange(position, bytes_to_read, buffer);
-
-    MaybeStartLoadForPosition(position);
+    UpdateConsumptionRate(position, bytes_to_read);
+    ContinueReadAt(position, buffer, bytes_to_read, std::move(callback));
+  });
+}
 
-    size_t remaining_bytes = upstream_size_ - position;
-    if ((bytes_read == bytes_to_read) || (bytes_read == remaining_bytes)) {
-      callback(Result::kOk, bytes_read);
-      return;
-    }
+void ReaderCache::ReadAtNoCopy(size_t position, size_t bytes_to_read,
+                               ReadAtNoCopyCallback callback) {
+  FXL_DCHECK(bytes_to_read > 0);
 
-    load_is_complete_.When([this, position, buffer, bytes_to_read,
-                            callback = std::move(callback)]() mutable {
-      ReadAt(position, buffer, bytes_to_read, std::move(callback));
-    });
+  describe_is_complete_.When([this, position, bytes_to_read,
+                              callback = std::move(callback)]() mutable {
+    UpdateConsumptionRate(position, bytes_to_read);
+    ContinueReadAtNoCopy(position, bytes_to_read, std::move(callback));
   });
 }
 
@@ -73,67 +95,265 @@ void ReaderCache::SetCacheOptions(size_t capacity, size_t max_backtrack,
   chunk_size_ = chunk_size;
 }
 
-void ReaderCache::MaybeStartLoadForPosition(size_t position) {
-  std::pair<size_t, size_t> cache_range = CalculateCacheRange(position);
-  load_position_ = cache_range.first;
+void ReaderCache::SetMaxFetchesInFlight(size_t max_fetches_in_flight) {
+  FXL_DCHECK(max_fetches_in_flight > 0);
+  max_fetches_in_flight_ = max_fetches_in_flight;
+}
+
+size_t ReaderCache::readahead() const {
+  FXL_DCHECK(capacity_ > max_backtrack_);
+  size_t max_readahead = capacity_ - max_backtrack_;
+
+  double aggregate_throughput =
+      fetch_throughput_ * std::min(max_fetches_in_flight_, upstream_max_reads_);
+  if (consumption_rate_ == 0.0 || aggregate_throughput <= consumption_rate_) {
+    return max_readahead;
+  }
 
-  if (load_in_progress_) {
+  zx::duration cover = fetch_duration_ * 2 + kReadaheadMargin;
+  size_t readahead =
+      static_cast<size_t>(consumption_rate_ * cover.get() / zx::sec(1).get());
+  return std::min(std::max(readahead, kMinReadaheadChunks * chunk_size_),
+                  max_readahead);
+}
+
+void ReaderCache::ContinueReadAt(size_t position, uint8_t* buffer,
+                                 size_t bytes_to_read,
+                                 ReadAtCallback callback) {
+  FXL_DCHECK(position < upstream_size_);
+
+  size_t bytes_read = buffer_.ReadRange(position, bytes_to_read, buffer);
+
+  MaybeStartLoadForPosition(position);
+
+  size_t remaining_bytes = upstream_size_ - position;
+  if ((bytes_read == bytes_to_read) || (bytes_read == remaining_bytes)) {
+    callback(Result::kOk, bytes_read);
     return;
   }
 
-  std::vector<SparseByteBuffer::Hole> holes_in_cache =
-      buffer_.FindOrCreateHolesInRange(cache_range.first, cache_range.second);
+  if (fetches_in_flight_.empty()) {
+    // Nothing on the way will help (the read extends past the cache range), so
+    // settle for what we have.
+    callback(bytes_read == 0 ? last_result_ : Result::kOk, bytes_read);
+    return;
+  }
+
+  fetch_is_complete_.When([this, position, buffer, bytes_to_read,
+                           callback = std::move(callback)]() mutable {
+    if (last_result_ != Result::kOk) {
+      callback(last_result_, 0);
+      return;
+    }
+
+    // The retry may have to wait for another fetch, so it mustn't run until
+    // this fetch's consequences are done and fetch_is_complete_ is reset.
+    async::PostTask(dispatcher_, [this, position, buffer, bytes_to_read,
+                                  callback = std::move(callback)]() mutable {
+      ContinueReadAt(position, buffer, bytes_to_read, std::move(callback));
+    });
+  });
+}
 
-  if (holes_in_cache.empty()) {
+void ReaderCache::ContinueReadAtNoCopy(size_t position, size_t bytes_to_read,
+                                       ReadAtNoCopyCallback callback) {
+  FXL_DCHECK(position < upstream_size_);
+
+  // Starting a load may evict, so do it first.
+  MaybeStartLoadForPosition(position);
+
+  size_t bytes_available;
+  const uint8_t* data = buffer_.ReadInPlace(position, &bytes_available);
+  if (data != nullptr) {
+    callback(Result::kOk, data, std::min(bytes_available, bytes_to_read));
     return;
   }
 
-  load_in_progress_ = true;
-  size_t bytes_needed = 0;
-  for (auto& hole : holes_in_cache) {
-    bytes_needed += hole.size();
+  if (fetches_in_flight_.empty()) {
+    callback(last_result_, nullptr, 0);
+    return;
   }
 
-  buffer_.CleanUpExcept(bytes_needed, cache_range.first, cache_range.second);
-  holes_in_cache =
-      buffer_.FindOrCreateHolesInRange(cache_range.first, cache_range.second);
+  fetch_is_complete_.When([this, position, bytes_to_read,
+                           callback = std::move(callback)]() mutable {
+    if (last_result_ != Result::kOk) {
+      callback(last_result_, nullptr, 0);
+      return;
+    }
 
-  FillHoles(holes_in_cache, cache_range.first, [this, cache_range]() {
-    load_in_progress_ = false;
-    load_is_complete_.Occur();
-    load_is_complete_.Reset();
+    async::PostTask(dispatcher_, [this, position, bytes_to_read,
+                                  callback = std::move(callback)]() mutable {
+      ContinueReadAtNoCopy(position, bytes_to_read, std::move(callback));
+    });
   });
 }
 
-void ReaderCache::FillHoles(std::vector<SparseByteBuffer::Hole> holes,
-                            size_t load_position, fit::closure callback) {
-  std::vector<uint8_t> buffer(holes.back().size());
-  upstream_reader_->ReadAt(
-      holes.back().position(), buffer.data(), holes.back().size(),
-      [this, holes, load_position, buffer = std::move(buffer),
-       callback = std::move(callback)](Result result,
-                                       size_t bytes_read) mutable {
-        last_result_ = result;
-        if (result != Result::kOk) {
-          FXL_LOG(ERROR) << "ReadAt failed!";
-        }
-        buffer_.Fill(holes.back(), std::move(buffer));
+void ReaderCache::UpdateConsumptionRate(size_t position,
+                                        size_t bytes_to_read) {
+  zx::time now = async::Now(dispatcher_);
 
-        holes.pop_back();
-        if (holes.empty()) {
-          callback();
-          return;
+  if (position != next_read_position_ || rate_window_start_ == zx::time()) {
+    // This isn't a continuation of the previous read, so start a new window.
+    rate_window_start_ = now;
+    rate_window_bytes_ = 0;
+  }
+
+  next_read_position_ = position + bytes_to_read;
+  rate_window_bytes_ += bytes_to_read;
+
+  zx::duration elapsed = now - rate_window_start_;
+  if (elapsed >= kRateWindow) {
+    consumption_rate_ = Smooth(
+        consumption_rate_,
+        static_cast<double>(rate_window_bytes_) * zx::sec(1).get() /
+            elapsed.get());
+    rate_window_start_ = now;
+    rate_window_bytes_ = 0;
+  }
+}
+
+void ReaderCache::MaybeStartLoadForPosition(size_t position) {
+  std::pair<size_t, size_t> cache_range = CalculateCacheRange(position);
+
+  if (cache_range != queued_range_ ||
+      (fetch_queue_.empty() && fetches_in_flight_.empty())) {
+    queued_range_ = cache_range;
+    fetch_queue_.clear();
+
+    if (fetches_in_flight_.empty() && buffer_.block_size() != chunk_size_) {
+      // The chunk size has changed. Start over with slabs of the new size.
+      buffer_.Initialize(upstream_size_, chunk_size_);
+    }
+
+    // Fetches go straight into the buffer's slabs, so they're sized to the
+    // slabs we have. If fetches were in flight when the chunk size changed,
+    // that's the old chunk size until the next time the queue is rebuilt.
+    size_t fetch_size = buffer_.block_size();
+
+    std::vector<SparseByteBuffer::Hole> holes_in_cache =
+        buffer_.FindOrCreateHolesInRange(cache_range.first,
+                                         cache_range.second);
+
+    size_t bytes_needed = 0;
+    for (auto& hole : holes_in_cache) {
+      bytes_needed += hole.size();
+    }
+
+    // Make room for the new chunks, if we need to, by evicting chunks outside
+    // the cache range.
+    size_t bytes_in_use = buffer_.bytes_in_use();
+    if (bytes_needed != 0 && bytes_in_use + bytes_needed > capacity_) {
+      buffer_.EvictExcept(bytes_in_use + bytes_needed - capacity_,
+                          cache_range.first, cache_range.second);
+      holes_in_cache = buffer_.FindOrCreateHolesInRange(cache_range.first,
+                                                        cache_range.second);
+    }
+
+    // Fetch each hole one chunk at a time, so the reads go straight into the
+    // buffer's slabs. Chunks from the one containing |position| onward are
+    // fetched first, in order, followed by chunks behind |position|, nearest
+    // first.
+    size_t position_chunk = position - (position % fetch_size);
+    std::vector<std::pair<size_t, size_t>> behind;
+    for (auto& hole : holes_in_cache) {
+      size_t hole_end = hole.position() + hole.size();
+      size_t range_start = hole.position();
+      while (range_start < hole_end) {
+        size_t chunk_end = range_start - (range_start % fetch_size) +
+                           fetch_size;
+        std::pair<size_t, size_t> range(
+            range_start, std::min(hole_end, chunk_end) - range_start);
+        range_start += range.second;
+
+        if (IsFetching(range)) {
+          continue;
         }
 
-        if (load_position != load_position_) {
-          FXL_LOG(INFO) << "Abandoning load for " << load_position
-                        << " to load " << load_position_;
-          callback();
-          return;
+        if (range.first >= position_chunk) {
+          fetch_queue_.push_back(range);
+        } else {
+          behind.push_back(range);
         }
+      }
+    }
+
+    fetch_queue_.insert(fetch_queue_.end(), behind.rbegin(), behind.rend());
+  }
+
+  StartFetches();
+}
+
+void ReaderCache::StartFetches() {
+  size_t max_in_flight = std::min(max_fetches_in_flight_, upstream_max_reads_);
+
+  while (fetches_in_flight_.size() < max_in_flight && !fetch_queue_.empty()) {
+    std::pair<size_t, size_t> range = fetch_queue_.front();
+    fetch_queue_.pop_front();
+    fetches_in_flight_.push_back(range);
+
+    zx::time start_time = async::Now(dispatcher_);
+    upstream_reader_->ReadAt(
+        range.first, buffer_.PrepareFill(range.first, range.second),
+        range.second,
+        [this, range, start_time](Result result, size_t bytes_read) {
+          OnFetchComplete(range, start_time, result, bytes_read);
+        });
+  }
+}
+
+void ReaderCache::OnFetchComplete(std::pair<size_t, size_t> range,
+                                  zx::time start_time, Result result,
+                                  size_t bytes_read) {
+  auto iter =
+      std::find(fetches_in_flight_.begin(), fetches_in_flight_.end(), range);
+  FXL_DCHECK(iter != fetches_in_flight_.end());
+  fetches_in_flight_.erase(iter);
+
+  last_result_ = result;
+  if (result != Result::kOk) {
+    FXL_LOG(ERROR) << "ReadAt failed!";
+    bytes_read = 0;
+  }
+
+  bytes_read = std::min(bytes_read, range.second);
+  if (bytes_read == 0) {
+    buffer_.CancelFill(range.first);
+  } else {
+    buffer_.CommitFill(range.first, bytes_read);
+
+    zx::duration elapsed = async::Now(dispatcher_) - start_time;
+    fetch_duration_ = Smooth(fetch_duration_, elapsed);
+    if (elapsed > zx::duration()) {
+      fetch_throughput_ =
+          Smooth(fetch_throughput_, static_cast<double>(bytes_read) *
+                                        zx::sec(1).get() / elapsed.get());
+    }
+  }
+
+  if (result != Result::kOk) {
+    // Stop fetching. The next read will try again.
+    fetch_queue_.clear();
+  } else if (bytes_read != 0 && bytes_read < range.second) {
+    // Short read. Fetch the rest of the range next.
+    fetch_queue_.emplace_front(range.first + bytes_read,
+                               range.second - bytes_read);
+  }
+
+  fetch_is_complete_.Occur();
+  fetch_is_complete_.Reset();
+
+  StartFetches();
+}
+
+bool ReaderCache::IsFetching(std::pair<size_t, size_t> range) const {
+  for (auto& fetch : fetches_in_flight_) {
+    if (range.first < fetch.first + fetch.second &&
+        fetch.first < range.first + range.second) {
+      return true;
+    }
+  }
 
-        FillHoles(holes, load_position, std::move(callback));
-      });
+  return false;
 }
 
 std::pair<size_t, size_t> ReaderCache::CalculateCacheRange(size_t position) {
@@ -144,9 +364,10 @@ std::pair<size_t, size_t> ReaderCache::CalculateCacheRange(size_t position) {
   size_t chunk_position = position - (position % chunk_size_);
   size_t cache_start =
       chunk_position > max_backtrack_ ? chunk_position - max_backtrack_ : 0;
+  size_t cache_end =
+      std::min(chunk_position + readahead(), upstream_size_);
 
-  return {cache_start,
-          std::min(capacity_ - max_backtrack_, upstream_size_ - cache_start)};
+  return {cache_start, cache_end - cache_start};
 }
 
 }  // namespace media_player
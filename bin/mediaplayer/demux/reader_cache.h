@@ -5,7 +5,12 @@
 #ifndef GARNET_BIN_MEDIAPLAYER_DEMUX_READER_CACHE_H_
 #define GARNET_BIN_MEDIAPLAYER_DEMUX_READER_CACHE_H_
 
+#include <lib/zx/time.h>
+
+#include <deque>
 #include <memory>
+#include <utility>
+#include <vector>
 
 #include "garnet/bin/mediaplayer/demux/reader.h"
 #include "garnet/bin/mediaplayer/demux/sparse_byte_buffer.h"
@@ -20,14 +25,24 @@ namespace media_player {
 //
 // ReaderCache is backed by a SparseByteBuffer which tracks holes (spans of the
 // asset that haven't been read) and regions (spans of the asset that have been
-// read). See SparseByteBuffer for details.
+// read), storing regions in a pool of chunk-sized slabs. Upstream reads go
+// directly into the slabs. See SparseByteBuffer for details.
 //
 // ReaderCache will serve ReadAt requests from its in-memory cache, and maintain
 // its cache asynchronously using the upstream reader on a schedule determined
-// by the cache options (see SetCacheOptions).
+// by the cache options (see SetCacheOptions). Holes are fetched a chunk at a
+// time, with several chunk fetches in flight at once if the upstream reader
+// allows it (see SetMaxFetchesInFlight), which hides the per-request latency of
+// readers like HttpReader.
 class ReaderCache : public Reader,
                     public std::enable_shared_from_this<ReaderCache> {
  public:
+  using ReadAtNoCopyCallback = fit::function<void(
+      Result result, const uint8_t* data, size_t bytes_read)>;
+
+  // The default maximum number of chunk fetches in flight upstream at once.
+  static constexpr size_t kDefaultMaxFetchesInFlight = 4;
+
   static std::shared_ptr<ReaderCache> Create(
       std::shared_ptr<Reader> upstream_reader);
 
@@ -41,6 +56,14 @@ class ReaderCache : public Reader,
   void ReadAt(size_t position, uint8_t* buffer, size_t bytes_to_read,
               ReadAtCallback callback) override;
 
+  // Like ReadAt, but rather than copying the requested bytes, passes |callback|
+  // a pointer to them in the cache. The pointer is valid only for the duration
+  // of the callback. Fewer than |bytes_to_read| bytes are produced if the range
+  // extends past the end of a cache chunk, so ranges which sit in one chunk are
+  // never copied.
+  void ReadAtNoCopy(size_t position, size_t bytes_to_read,
+                    ReadAtNoCopyCallback callback);
+
   // Configures the ReaderCache to respect the given memory budget.
   //   |capacity| is the amount of memory ReaderCache is allowed to use for
   //              caching the upstream Reader's content.
@@ -48,28 +71,58 @@ class ReaderCache : public Reader,
   //                   will maintain _behind_ the ReadAt point (for skipping
   //                   back).
   //   |chunk_size| is the size of read chunks ReaderCache will use when reading
-  //                from upstream.
+  //                from upstream, and of the slabs in which it caches them.
+  //                Changing the chunk size drops the cache when the next load
+  //                starts with no fetches in flight. Until then, fetches use
+  //                the old chunk size.
   void SetCacheOptions(size_t capacity, size_t max_backtrack,
                        size_t chunk_size);
 
+  // Sets the maximum number of chunk fetches that may be in flight upstream at
+  // once. The upstream reader's MaxConcurrentReads limit also applies.
+  void SetMaxFetchesInFlight(size_t max_fetches_in_flight);
+
+  // Returns the number of bytes ReaderCache currently tries to keep loaded
+  // ahead of the read position. This is sized to cover a couple of fetch
+  // durations plus a margin at the measured consumption rate. Until that rate
+  // is known, or if upstream can't keep up with it, this is as much as the
+  // cache options allow.
+  size_t readahead() const;
+
  private:
-  // Loads if
-  //   1. No load is in progress already.
-  //   2. There are holes in the desired cache range for this position which
-  //      require filling.
-  // Starts a load from the upstream Reader into our buffer over the given
-  // range.
-  //   1. If requested, clean up memory outside the desired range to pay for the
-  //      new allocations.
-  //   2. Makes async calls for the upstream Reader to fill all the holes in the
-  //      desired cache range.
-  //   3. Running any ReadAt call queued on this reload.
+  // Fetches the holes in the desired cache range for |position|.
+  //   1. If the desired range has changed, replaces the queue of chunks to
+  //      fetch with the holes in the new range, nearest |position| first.
+  //      Chunks queued for the old range are dropped, so a seek doesn't wait
+  //      behind stale prefetches. Chunks already in flight are allowed to
+  //      complete.
+  //   2. If needed, evicts chunks outside the desired range to keep within the
+  //      memory budget.
+  //   3. Starts as many queued fetches as the in-flight limit allows.
   void MaybeStartLoadForPosition(size_t position);
 
-  // Makes async calls to the upstream Reader to fill the given holes in our
-  // underlying buffer. Calls callback on completion.
-  void FillHoles(std::vector<SparseByteBuffer::Hole> holes,
-                 size_t load_position, fit::closure callback);
+  // Starts queued fetches until the queue is empty or the in-flight limit is
+  // reached.
+  void StartFetches();
+
+  // Handles completion of the upstream read for |range|, which was started at
+  // |start_time|.
+  void OnFetchComplete(std::pair<size_t, size_t> range, zx::time start_time,
+                       Result result, size_t bytes_read);
+
+  // Returns true if |range| overlaps a fetch that's in flight.
+  bool IsFetching(std::pair<size_t, size_t> range) const;
+
+  // Services a ReadAt, ReadAtNoCopy respectively, once the upstream reader is
+  // described. These are also used to retry after a fetch completes.
+  void ContinueReadAt(size_t position, uint8_t* buffer, size_t bytes_to_read,
+                      ReadAtCallback callback);
+  void ContinueReadAtNoCopy(size_t position, size_t bytes_to_read,
+                            ReadAtNoCopyCallback callback);
+
+  // Updates the measured rate at which the asset is consumed, given a new
+  // request to read |bytes_to_read| bytes at |position|.
+  void UpdateConsumptionRate(size_t position, size_t bytes_to_read);
 
   // Calculates the desired cache range according to our cache options around
   // the requested read position.
@@ -80,7 +133,8 @@ class ReaderCache : public Reader,
   Result last_result_;
 
   Incident describe_is_complete_;
-  Incident load_is_complete_;
+  // Occurs (and is immediately reset) each time a fetch completes.
+  Incident fetch_is_complete_;
 
   // These values are stable after |describe_is_complete_|.
   std::shared_ptr<Reader> upstream_reader_;
@@ -94,8 +148,23 @@ class ReaderCache : public Reader,
 
   async_dispatcher_t* dispatcher_;
 
-  bool load_in_progress_ = false;
-  size_t load_position_;
+  size_t max_fetches_in_flight_ = kDefaultMaxFetchesInFlight;
+  size_t upstream_max_reads_ = 1;
+  std::vector<std::pair<size_t, size_t>> fetches_in_flight_;
+  std::deque<std::pair<size_t, size_t>> fetch_queue_;
+  // The cache range |fetch_queue_| was built for.
+  std::pair<size_t, size_t> queued_range_{0, 0};
+
+  // Consumption measurement. Sequential reads are counted over windows of at
+  // least kRateWindow, and the per-window rates are smoothed.
+  size_t next_read_position_ = 0;
+  zx::time rate_window_start_;
+  size_t rate_window_bytes_ = 0;
+  double consumption_rate_ = 0.0;  // bytes per second
+
+  // Smoothed duration and throughput of individual fetches.
+  zx::duration fetch_duration_;
+  double fetch_throughput_ = 0.0;  // bytes per second
 };
 
 }  // namespace media_player
@@ -3,6 +3,7 @@
 // found in the LICENSE file.
 
 #include <algorithm>
+#include <cstring>
 #include <iterator>
 
 #include "garnet/bin/mediaplayer/demux/sparse_byte_buffer.h"
@@ -22,8 +23,7 @@ SparseByteBuffer::Hole::~Hole() {}
 
 SparseByteBuffer::Region::Region() {}
 
-SparseByteBuffer::Region::Region(
-    std::map<size_t, std::vector<uint8_t>>::iterator iter)
+SparseByteBuffer::Region::Region(std::map<size_t, RegionData>::iterator iter)
     : iter_(iter) {}
 
 SparseByteBuffer::Region::Region(const Region& other) : iter_(other.iter_) {}
@@ -34,12 +34,32 @@ SparseByteBuffer::SparseByteBuffer() {}
 
 SparseByteBuffer::~SparseByteBuffer() {}
 
-void SparseByteBuffer::Initialize(size_t size) {
+SparseByteBuffer::SparseByteBuffer(SparseByteBuffer&& other) = default;
+
+SparseByteBuffer& SparseByteBuffer::operator=(SparseByteBuffer&& other) =
+    default;
+
+void SparseByteBuffer::Initialize(size_t size, size_t block_size) {
+  FXL_DCHECK(block_size > 0u);
+
   holes_.clear();
   regions_.clear();
   size_ = size;
   // Create one hole spanning the entire buffer.
   holes_[0] = size_;
+
+  live_slabs_.clear();
+  free_slabs_.clear();
+  if (block_size != block_size_) {
+    slabs_.clear();
+    block_size_ = block_size;
+  }
+
+  for (auto& slab : slabs_) {
+    slab->refs = 0;
+    slab->pending_fills = 0;
+    free_slabs_.push_back(slab.get());
+  }
 }
 
 size_t SparseByteBuffer::ReadRange(size_t start, size_t size,
@@ -50,16 +70,25 @@ size_t SparseByteBuffer::ReadRange(size_t start, size_t size,
   size_t copied = 0;
   size_t end = start + size;
 
-  RegionsIter iter = regions_.lower_bound(start);
-  if (iter != regions_.begin()) {
-    --iter;
+  // Find the region containing |start|, if there is one.
+  RegionsIter iter = regions_.upper_bound(start);
+  if (iter == regions_.begin()) {
+    return 0;
   }
 
+  --iter;
+  if (iter->first + iter->second.size <= start) {
+    return 0;
+  }
+
+  // Copy out of each region in turn until we reach the end of the range or a
+  // hole. Each region lies within one slab, so this is a scatter-copy from
+  // however many slabs the range spans.
   size_t last_region_end = iter->first;
   while (iter != regions_.end() && iter->first == last_region_end &&
          iter->first < end) {
     size_t region_start = iter->first;
-    size_t region_end = iter->first + iter->second.size();
+    size_t region_end = iter->first + iter->second.size;
 
     if (region_end > start) {
       size_t offset_in_dest = region_start > start ? region_start - start : 0;
@@ -67,8 +96,9 @@ size_t SparseByteBuffer::ReadRange(size_t start, size_t size,
       size_t bytes_to_copy =
           std::min(region_end, end) - region_start - offset_in_source;
       std::memcpy(dest_buffer + offset_in_dest,
-                  iter->second.data() + offset_in_source, bytes_to_copy);
+                  iter->second.data + offset_in_source, bytes_to_copy);
       copied += bytes_to_copy;
+      iter->second.slab->last_use = ++use_clock_;
     }
 
     last_region_end = region_end;
@@ -78,6 +108,33 @@ size_t SparseByteBuffer::ReadRange(size_t start, size_t size,
   return copied;
 }
 
+const uint8_t* SparseByteBuffer::ReadInPlace(size_t position,
+                                             size_t* size_out) {
+  FXL_DCHECK(position < size_);
+  FXL_DCHECK(size_out != nullptr);
+
+  Region region = FindRegionContaining(position, null_region());
+  if (region == null_region()) {
+    *size_out = 0;
+    return nullptr;
+  }
+
+  // Regions which abut each other in the same block are contiguous in the
+  // block's slab, so extend the result through them.
+  Slab* slab = region.iter_->second.slab;
+  size_t end = region.position() + region.size();
+  for (RegionsIter iter = std::next(region.iter_);
+       iter != regions_.end() && iter->first == end &&
+       iter->second.slab == slab;
+       ++iter) {
+    end += iter->second.size;
+  }
+
+  slab->last_use = ++use_clock_;
+  *size_out = end - position;
+  return region.data() + (position - region.position());
+}
+
 SparseByteBuffer::Region SparseByteBuffer::FindRegionContaining(size_t position,
                                                                 Region hint) {
   FXL_DCHECK(size_ > 0u);
@@ -86,24 +143,28 @@ SparseByteBuffer::Region SparseByteBuffer::FindRegionContaining(size_t position,
   RegionsIter iter = hint.iter_;
 
   if (iter != regions_.end() && iter->first <= position) {
-    if (iter->first + iter->second.size() <= position) {
+    if (iter->first + iter->second.size <= position) {
       // iter is too close to the front. See if the next region is correct.
       ++iter;
       if (iter != regions_.end() && iter->first <= position &&
-          position < iter->first + iter->second.size()) {
+          position < iter->first + iter->second.size) {
         return Region(iter);
       }
-    } else if (position < iter->first + iter->second.size()) {
+    } else if (position < iter->first + iter->second.size) {
       return Region(iter);
     }
   }
 
   iter = regions_.lower_bound(position);
-  if (iter != regions_.begin() &&
-      (iter == regions_.end() || iter->first > position)) {
+  if (iter == regions_.end() || iter->first > position) {
+    if (iter == regions_.begin()) {
+      // All regions (if any) start after position.
+      return null_region();
+    }
+
     --iter;
     FXL_DCHECK(iter->first <= position);
-    if (iter->first + iter->second.size() <= position) {
+    if (iter->first + iter->second.size <= position) {
       iter = regions_.end();
     }
   }
@@ -211,39 +272,96 @@ SparseByteBuffer::Hole SparseByteBuffer::Fill(Hole hole,
   FXL_DCHECK(buffer.size() != 0);
   FXL_DCHECK(buffer.size() <= hole.size());
 
-  HolesIter holes_iter = hole.iter_;
+  size_t position = hole.position();
+  const uint8_t* source = buffer.data();
+  size_t remaining = buffer.size();
+
+  while (remaining != 0) {
+    size_t size =
+        std::min(remaining, block_size_ - (position % block_size_));
+    std::memcpy(PrepareFill(position, size), source, size);
+    hole = CommitFill(position, size);
+    position += size;
+    source += size;
+    remaining -= size;
+  }
 
-  size_t buffer_size = buffer.size();
-  size_t position = holes_iter->first;
+  return hole;
+}
+
+uint8_t* SparseByteBuffer::PrepareFill(size_t position, size_t size) {
+  FXL_DCHECK(position < size_);
+  FXL_DCHECK(size != 0);
+  FXL_DCHECK(size <= size_ - position);
+  FXL_DCHECK(size <= block_size_ - (position % block_size_))
+      << "Fill straddles a block boundary";
+  FXL_DCHECK(FindRegionContaining(position, null_region()) == null_region());
+
+  Slab* slab = AcquireSlab(position / block_size_);
+  ++slab->refs;
+  ++slab->pending_fills;
+  return slab->data.get() + (position % block_size_);
+}
+
+SparseByteBuffer::Hole SparseByteBuffer::CommitFill(size_t position,
+                                                    size_t size) {
+  FXL_DCHECK(size != 0);
+  FXL_DCHECK(size <= block_size_ - (position % block_size_));
+
+  Slab* slab = FindSlab(position / block_size_);
+  FXL_DCHECK(slab != nullptr);
+  FXL_DCHECK(slab->pending_fills != 0);
+  FXL_DCHECK(slab->refs != 0);
+
+  // The pending fill's reference becomes the region's.
+  --slab->pending_fills;
+  slab->last_use = ++use_clock_;
+  auto result = regions_.emplace(
+      position,
+      RegionData{size, slab->data.get() + (position % block_size_), slab});
+  FXL_DCHECK(result.second);
+
+  return RemoveFromHoles(FindOrCreateHole(position, null_hole()).iter_, size);
+}
+
+void SparseByteBuffer::CancelFill(size_t position) {
+  Slab* slab = FindSlab(position / block_size_);
+  FXL_DCHECK(slab != nullptr);
+  FXL_DCHECK(slab->pending_fills != 0);
+
+  --slab->pending_fills;
+  ReleaseSlab(slab);
+}
 
-  regions_.emplace(std::make_pair(position, std::move(buffer)));
+SparseByteBuffer::Hole SparseByteBuffer::RemoveFromHoles(HolesIter holes_iter,
+                                                         size_t size) {
+  size_t position = holes_iter->first;
 
-  // Remove the region from holes_.
-  while (buffer_size != 0) {
+  while (size != 0) {
     FXL_DCHECK(holes_iter != holes_.end());
     FXL_DCHECK(holes_iter->first == position);
 
-    if (buffer_size < holes_iter->second) {
+    if (size < holes_iter->second) {
       // We've filled part of *holes_iter. Insert a hole after it to
       // represent the remainder.
       HolesIter hint = holes_iter;
-      holes_.insert(
-          ++hint, std::pair<size_t, size_t>(holes_iter->first + buffer_size,
-                                            holes_iter->second - buffer_size));
+      holes_.insert(++hint,
+                    std::pair<size_t, size_t>(holes_iter->first + size,
+                                              holes_iter->second - size));
 
       // When we've erased holes_iter, we'll have accounted for the entire
       // filled region.
-      position += buffer_size;
-      buffer_size = 0;
+      position += size;
+      size = 0;
     } else {
       // Calculate where we'll be when we've erased holes_iter.
       position += holes_iter->second;
-      buffer_size -= holes_iter->second;
+      size -= holes_iter->second;
     }
 
     holes_iter = holes_.erase(holes_iter);
     if (holes_iter == holes_.end()) {
-      FXL_DCHECK(buffer_size == 0);
+      FXL_DCHECK(size == 0);
       holes_iter = holes_.begin();
     }
   }
@@ -293,20 +411,72 @@ size_t SparseByteBuffer::CleanUpExcept(size_t goal, size_t protected_start,
         protected_end < candidate_end ? candidate_end - protected_end : 0;
     size_t shrink_amount = std::min({to_free, candidate.size(), excess_after});
     bool last_region = iter == regions_.begin();
+    // Step back before shrinking, which may free (and erase) the candidate.
+    if (!last_region) {
+      --iter;
+    }
     ShrinkRegionBack(candidate, shrink_amount);
     to_free -= shrink_amount;
 
     if (last_region) {
       break;
     };
-
-    --iter;
   }
 
   FXL_DCHECK(goal >= to_free);
   return goal - to_free;
 }
 
+size_t SparseByteBuffer::EvictExcept(size_t goal, size_t protected_start,
+                                     size_t protected_size) {
+  FXL_DCHECK(protected_start < size_);
+
+  size_t protected_end = protected_start + protected_size;
+
+  eviction_candidates_.clear();
+  for (Slab* slab : live_slabs_) {
+    size_t block_start = slab->block * block_size_;
+    size_t block_end = block_start + block_size_;
+    if (slab->pending_fills == 0 &&
+        (block_end <= protected_start || block_start >= protected_end)) {
+      eviction_candidates_.push_back(slab);
+    }
+  }
+
+  // Behind the protected range first, then least recently used first.
+  std::sort(eviction_candidates_.begin(), eviction_candidates_.end(),
+            [this, protected_start](Slab* a, Slab* b) {
+              bool a_behind = a->block * block_size_ < protected_start;
+              bool b_behind = b->block * block_size_ < protected_start;
+              if (a_behind != b_behind) {
+                return a_behind;
+              }
+              return a->last_use < b->last_use;
+            });
+
+  size_t freed = 0;
+  for (Slab* slab : eviction_candidates_) {
+    if (freed >= goal) {
+      break;
+    }
+
+    // Freeing the last region in the block returns the slab to the pool.
+    size_t block_start = slab->block * block_size_;
+    size_t block_end = block_start + block_size_;
+    RegionsIter iter = regions_.lower_bound(block_start);
+    while (iter != regions_.end() && iter->first < block_end) {
+      Region region(iter);
+      ++iter;
+      Free(region);
+    }
+
+    freed += block_size_;
+  }
+
+  eviction_candidates_.clear();
+  return freed;
+}
+
 SparseByteBuffer::Region SparseByteBuffer::ShrinkRegionFront(
     Region region, size_t shrink_amount) {
   FXL_DCHECK(region != null_region());
@@ -331,12 +501,13 @@ SparseByteBuffer::Region SparseByteBuffer::ShrinkRegionFront(
     holes_.emplace(region.position(), shrink_amount);
   }
 
+  // The region's bytes stay where they are in its slab.
   size_t region_pos = region.position() + shrink_amount;
-  std::vector<uint8_t> buffer;
-  std::copy_n(region.iter_->second.begin() + shrink_amount,
-              region.size() - shrink_amount, std::back_inserter(buffer));
+  RegionData data = region.iter_->second;
+  data.size -= shrink_amount;
+  data.data += shrink_amount;
   regions_.erase(region.iter_);
-  auto result = regions_.emplace(region_pos, buffer);
+  auto result = regions_.emplace(region_pos, data);
   FXL_DCHECK(result.second);
 
   return Region(result.first);
@@ -364,7 +535,7 @@ SparseByteBuffer::Region SparseByteBuffer::ShrinkRegionBack(
 
   holes_.emplace(region.position() + region.size() - shrink_amount,
                  shrink_amount + hole_addendum);
-  region.iter_->second.resize(region.size() - shrink_amount);
+  region.iter_->second.size -= shrink_amount;
 
   return region;
 }
@@ -383,6 +554,7 @@ SparseByteBuffer::Hole SparseByteBuffer::Free(Region region) {
   size_t hole_position = region.position();
   size_t hole_size = region.size();
 
+  ReleaseSlab(region.iter_->second.slab);
   regions_.erase(region.iter_);
 
   if (hole_after != null_hole() &&
@@ -404,6 +576,56 @@ SparseByteBuffer::Hole SparseByteBuffer::Free(Region region) {
   return new_hole;
 }
 
+SparseByteBuffer::Slab* SparseByteBuffer::AcquireSlab(size_t block) {
+  auto iter = std::lower_bound(
+      live_slabs_.begin(), live_slabs_.end(), block,
+      [](const Slab* slab, size_t block) { return slab->block < block; });
+  if (iter != live_slabs_.end() && (*iter)->block == block) {
+    return *iter;
+  }
+
+  Slab* slab;
+  if (free_slabs_.empty()) {
+    slabs_.emplace_back(new Slab());
+    slab = slabs_.back().get();
+    slab->data.reset(new uint8_t[block_size_]);
+  } else {
+    slab = free_slabs_.back();
+    free_slabs_.pop_back();
+  }
+
+  FXL_DCHECK(slab->refs == 0);
+  FXL_DCHECK(slab->pending_fills == 0);
+  slab->block = block;
+  slab->last_use = ++use_clock_;
+  live_slabs_.insert(iter, slab);
+  return slab;
+}
+
+void SparseByteBuffer::ReleaseSlab(Slab* slab) {
+  FXL_DCHECK(slab != nullptr);
+  FXL_DCHECK(slab->refs != 0);
+
+  if (--slab->refs != 0) {
+    return;
+  }
+
+  auto iter = std::lower_bound(
+      live_slabs_.begin(), live_slabs_.end(), slab->block,
+      [](const Slab* slab, size_t block) { return slab->block < block; });
+  FXL_DCHECK(iter != live_slabs_.end() && *iter == slab);
+  live_slabs_.erase(iter);
+  free_slabs_.push_back(slab);
+}
+
+SparseByteBuffer::Slab* SparseByteBuffer::FindSlab(size_t block) {
+  auto iter = std::lower_bound(
+      live_slabs_.begin(), live_slabs_.end(), block,
+      [](const Slab* slab, size_t block) { return slab->block < block; });
+  return (iter != live_slabs_.end() && (*iter)->block == block) ? *iter
+                                                                 : nullptr;
+}
+
 bool operator==(const SparseByteBuffer::Hole& a,
                 const SparseByteBuffer::Hole& b) {
   return a.iter_ == b.iter_;
@@ -5,13 +5,51 @@
 #ifndef GARNET_BIN_MEDIAPLAYER_DEMUX_SPARSE_BYTE_BUFFER_H_
 #define GARNET_BIN_MEDIAPLAYER_DEMUX_SPARSE_BYTE_BUFFER_H_
 
+#include <stdint.h>
+
 #include <map>
+#include <memory>
 #include <vector>
 
 namespace media_player {
 
+// SparseByteBuffer caches parts of a byte stream of a given size. The spans of
+// the stream which have been cached are described by regions, and the spans
+// which haven't by holes.
+//
+// Storage for regions is provided by a pool of fixed-size slabs. The stream is
+// divided into aligned blocks of the slab size, and each block which contains
+// any regions is backed by one slab, in which the byte at stream position p is
+// stored at offset p % block_size(). Regions never straddle block boundaries,
+// so a region's data is always contiguous, and adjacent regions in the same
+// block are contiguous with each other. Slabs are returned to the pool, not to
+// the heap, when the last region in their block is freed, so a buffer whose
+// contents change continuously (as a cache's do) stops allocating once the
+// pool has grown to the buffer's working set.
 class SparseByteBuffer {
+ private:
+  struct Slab {
+    std::unique_ptr<uint8_t[]> data;
+    // The block this slab currently backs.
+    size_t block = 0;
+    // The number of regions in the block, plus the number of pending fills.
+    uint32_t refs = 0;
+    // The number of pending fills (see PrepareFill).
+    uint32_t pending_fills = 0;
+    // The value of the buffer's use clock when this block was last read from
+    // or filled.
+    uint64_t last_use = 0;
+  };
+
+  struct RegionData {
+    size_t size;
+    uint8_t* data;
+    Slab* slab;
+  };
+
  public:
+  static constexpr size_t kDefaultBlockSize = 64 * 1024;
+
   struct Hole {
     Hole();
     Hole(const Hole& other);
@@ -36,13 +74,13 @@ class SparseByteBuffer {
     ~Region();
 
     size_t position() { return iter_->first; }
-    size_t size() { return iter_->second.size(); }
-    uint8_t* data() { return iter_->second.data(); }
+    size_t size() { return iter_->second.size; }
+    uint8_t* data() { return iter_->second.data; }
 
    private:
-    explicit Region(std::map<size_t, std::vector<uint8_t>>::iterator iter);
+    explicit Region(std::map<size_t, RegionData>::iterator iter);
 
-    std::map<size_t, std::vector<uint8_t>>::iterator iter_;
+    std::map<size_t, RegionData>::iterator iter_;
 
     friend bool operator==(const Region& a, const Region& b);
     friend bool operator!=(const Region& a, const Region& b);
@@ -53,12 +91,26 @@ class SparseByteBuffer {
 
   ~SparseByteBuffer();
 
+  SparseByteBuffer(SparseByteBuffer&& other);
+
+  SparseByteBuffer& operator=(SparseByteBuffer&& other);
+
   Hole null_hole() { return Hole(holes_.end()); }
 
   Region null_region() { return Region(regions_.end()); }
 
-  // Initialized the buffer.
-  void Initialize(size_t size);
+  // Initializes the buffer, freeing all regions. Slabs already in the pool are
+  // retained if |block_size| is unchanged.
+  void Initialize(size_t size, size_t block_size = kDefaultBlockSize);
+
+  // The size of the blocks into which the buffer is divided, and of its slabs.
+  size_t block_size() const { return block_size_; }
+
+  // The amount of slab memory currently backing regions or pending fills.
+  size_t bytes_in_use() const { return live_slabs_.size() * block_size_; }
+
+  // The amount of slab memory held in the pool, in use or not.
+  size_t bytes_allocated() const { return slabs_.size() * block_size_; }
 
   // Reads a range of data from the SparseBuffer, which may span multiple
   // regions. Reading will begin at |start| in the SparseBuffer and stop when
@@ -71,6 +123,13 @@ class SparseByteBuffer {
   // respectively.
   size_t ReadRange(size_t start, size_t size, uint8_t* dest_buffer);
 
+  // Returns a pointer to the cached bytes at |position| without copying them,
+  // or nullptr if |position| falls in a hole. |*size_out| is set to the number
+  // of contiguous bytes available at the returned pointer, which never extends
+  // past the end of the block containing |position|. The pointer remains valid
+  // until the regions containing those bytes are shrunk or freed.
+  const uint8_t* ReadInPlace(size_t position, size_t* size_out);
+
   // Finds a region containing the specified position. This method will check
   // hint and its successor, if they're valid, before doing a search.
   Region FindRegionContaining(size_t position, Region hint);
@@ -92,8 +151,20 @@ class SparseByteBuffer {
   // the first hole that follows the new region in the wraparound sense. If
   // this sparse buffer is completely filled (there are no holes), this method
   // return null_hole().
+  // If |buffer| straddles block boundaries, one region is created for each
+  // block.
   Hole Fill(Hole hole, std::vector<uint8_t>&& buffer);
 
+  // Fills without an intermediate buffer. PrepareFill returns the storage for
+  // the |size| bytes at |position|, which must be in a hole and must not
+  // straddle a block boundary. The block's slab is retained (and won't be
+  // evicted) until CommitFill creates a region from the first |size| bytes
+  // written there (|size| may be smaller than the prepared size), or
+  // CancelFill abandons the fill. CommitFill returns the same hole as Fill.
+  uint8_t* PrepareFill(size_t position, size_t size);
+  Hole CommitFill(size_t position, size_t size);
+  void CancelFill(size_t position);
+
   // Frees and shrinks regions outside the protected range until |goal| bytes
   // have been freed from the buffer or nothing remains to free. Returns the
   // bytes actually freed.
@@ -105,8 +176,17 @@ class SparseByteBuffer {
   size_t CleanUpExcept(size_t goal, size_t protected_start,
                        size_t protected_size);
 
+  // Frees whole blocks which lie entirely outside the protected range, and
+  // which have no pending fills, until their slabs account for at least |goal|
+  // bytes or nothing remains to free. Returns the slab bytes actually freed.
+  //
+  // Blocks behind the protected range are freed before blocks beyond it, and
+  // within each group, least recently used blocks are freed first.
+  size_t EvictExcept(size_t goal, size_t protected_start,
+                     size_t protected_size);
+
   // Shrinks the front of a region (e.g. shrinking [{1, 2, 3}] by 1 yields
-  // [hole, {2, 3}]). This may require a copy. Returns an updated Region handle.
+  // [hole, {2, 3}]). Returns an updated Region handle.
   // The handle is equal to null_region() if the region was shrunk by its whole
   // size and therefore freed.
   Region ShrinkRegionFront(Region region, size_t shrink_amount);
@@ -122,11 +202,33 @@ class SparseByteBuffer {
 
  private:
   using HolesIter = std::map<size_t, size_t>::iterator;
-  using RegionsIter = std::map<size_t, std::vector<uint8_t>>::iterator;
+  using RegionsIter = std::map<size_t, RegionData>::iterator;
+
+  // Returns the live slab backing |block|, taking one from the pool (or
+  // allocating one) if there is none. The slab's reference count is not
+  // changed.
+  Slab* AcquireSlab(size_t block);
+
+  // Drops a reference to |slab|, returning it to the pool if it was the last.
+  void ReleaseSlab(Slab* slab);
+
+  // Returns the live slab backing |block|, or nullptr.
+  Slab* FindSlab(size_t block);
+
+  // Removes |size| bytes starting at the start of |holes_iter| from holes_,
+  // returning the first hole after them in the wraparound sense.
+  Hole RemoveFromHoles(HolesIter holes_iter, size_t size);
 
   size_t size_ = 0u;
-  std::map<size_t, size_t> holes_;                  // Hole sizes by position.
-  std::map<size_t, std::vector<uint8_t>> regions_;  // Buffers by position.
+  size_t block_size_ = kDefaultBlockSize;
+  std::map<size_t, size_t> holes_;        // Hole sizes by position.
+  std::map<size_t, RegionData> regions_;  // Region data by position.
+
+  std::vector<std::unique_ptr<Slab>> slabs_;  // All slabs in the pool.
+  std::vector<Slab*> free_slabs_;             // Slabs backing no block.
+  std::vector<Slab*> live_slabs_;             // Other slabs, by block.
+  std::vector<Slab*> eviction_candidates_;    // Scratch for EvictExcept.
+  uint64_t use_clock_ = 0;
 };
 
 bool operator==(const SparseByteBuffer::Hole& a,
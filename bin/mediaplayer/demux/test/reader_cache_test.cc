@@ -0,0 +1,254 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "garnet/bin/mediaplayer/demux/reader_cache.h"
+
+#include <lib/async/cpp/task.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "lib/gtest/test_loop_fixture.h"
+
+namespace media_player {
+namespace {
+
+constexpr size_t kAssetSize = 64 * 1024 * 1024;
+constexpr size_t kCapacity = 16 * 1024 * 1024;
+constexpr size_t kMaxBacktrack = 4 * 1024 * 1024;
+constexpr size_t kChunkSize = 256 * 1024;
+constexpr size_t kReadSize = 32 * 1024;
+
+uint8_t ByteForPosition(size_t position) {
+  return static_cast<uint8_t>(position ^ (position >> 8) ^ (position >> 16) ^
+                              (position >> 24));
+}
+
+// Stands in for HttpReader over a slow link. Each read completes after a fixed
+// latency plus the time it takes to transfer the data at a fixed rate.
+class LatentReader : public Reader {
+ public:
+  LatentReader(async_dispatcher_t* dispatcher, zx::duration latency,
+               size_t bytes_per_second, size_t max_concurrent_reads)
+      : dispatcher_(dispatcher),
+        latency_(latency),
+        bytes_per_second_(bytes_per_second),
+        max_concurrent_reads_(max_concurrent_reads) {}
+
+  // The time it takes to complete a read of |size| bytes.
+  zx::duration ReadDuration(size_t size) const {
+    return latency_ + zx::sec(1) * size / bytes_per_second_;
+  }
+
+  size_t max_reads_in_flight() const { return max_reads_in_flight_; }
+
+  size_t bytes_read() const { return bytes_read_; }
+
+  size_t max_read_end() const { return max_read_end_; }
+
+  // The positions and sizes of the reads issued so far, in order.
+  const std::vector<size_t>& read_positions() const { return read_positions_; }
+  const std::vector<size_t>& read_sizes() const { return read_sizes_; }
+
+  // Reader implementation.
+  void Describe(DescribeCallback callback) override {
+    callback(Result::kOk, kAssetSize, true);
+  }
+
+  void ReadAt(size_t position, uint8_t* buffer, size_t bytes_to_read,
+              ReadAtCallback callback) override {
+    EXPECT_LT(reads_in_flight_, max_concurrent_reads_);
+    ++reads_in_flight_;
+    max_reads_in_flight_ = std::max(max_reads_in_flight_, reads_in_flight_);
+    read_positions_.push_back(position);
+    read_sizes_.push_back(bytes_to_read);
+
+    size_t size = std::min(bytes_to_read, kAssetSize - position);
+    max_read_end_ = std::max(max_read_end_, position + size);
+
+    async::PostDelayedTask(
+        dispatcher_,
+        [this, position, buffer, size, callback = std::move(callback)]() {
+          for (size_t i = 0; i < size; ++i) {
+            buffer[i] = ByteForPosition(position + i);
+          }
+
+          --reads_in_flight_;
+          bytes_read_ += size;
+          callback(Result::kOk, size);
+        },
+        ReadDuration(size));
+  }
+
+  size_t MaxConcurrentReads() override { return max_concurrent_reads_; }
+
+ private:
+  async_dispatcher_t* dispatcher_;
+  zx::duration latency_;
+  size_t bytes_per_second_;
+  size_t max_concurrent_reads_;
+  size_t reads_in_flight_ = 0;
+  size_t max_reads_in_flight_ = 0;
+  size_t bytes_read_ = 0;
+  size_t max_read_end_ = 0;
+  std::vector<size_t> read_positions_;
+  std::vector<size_t> read_sizes_;
+};
+
+class ReaderCacheTest : public ::gtest::TestLoopFixture {
+ protected:
+  void CreateCache(zx::duration latency, size_t bytes_per_second,
+                   size_t max_concurrent_reads) {
+    upstream_ = std::make_shared<LatentReader>(
+        dispatcher(), latency, bytes_per_second, max_concurrent_reads);
+    under_test_ = ReaderCache::Create(upstream_);
+    under_test_->SetCacheOptions(kCapacity, kMaxBacktrack, kChunkSize);
+  }
+
+  // Starts a read of kReadSize bytes at |position|, setting |*done| when it
+  // completes successfully with the expected contents.
+  void StartRead(size_t position, bool* done) {
+    *done = false;
+    under_test_->ReadAt(position, buffer_, kReadSize,
+                        [this, position, done](Result result,
+                                               size_t bytes_read) {
+                          EXPECT_EQ(Result::kOk, result);
+                          EXPECT_EQ(kReadSize, bytes_read);
+                          for (size_t i = 0; i < bytes_read; ++i) {
+                            EXPECT_EQ(ByteForPosition(position + i),
+                                      buffer_[i]);
+                          }
+                          *done = true;
+                        });
+  }
+
+  std::shared_ptr<LatentReader> upstream_;
+  std::shared_ptr<ReaderCache> under_test_;
+  uint8_t buffer_[kReadSize];
+};
+
+// Tests that chunks are fetched concurrently, up to the configured limit.
+TEST_F(ReaderCacheTest, FetchesInParallel) {
+  CreateCache(zx::msec(100), 10 * 1024 * 1024, 8);
+  under_test_->SetMaxFetchesInFlight(4);
+
+  bool done;
+  StartRead(0, &done);
+  RunLoopFor(upstream_->ReadDuration(kChunkSize));
+  EXPECT_TRUE(done);
+  EXPECT_EQ(4u, upstream_->max_reads_in_flight());
+
+  // The rest of the cache range loads at four times the rate of a single
+  // connection.
+  RunLoopFor(upstream_->ReadDuration(kChunkSize) *
+             ((kCapacity - kMaxBacktrack) / kChunkSize / 4));
+  EXPECT_EQ(kCapacity - kMaxBacktrack, upstream_->bytes_read());
+}
+
+// Tests that the upstream reader's limit on concurrent reads is respected.
+TEST_F(ReaderCacheTest, RespectsUpstreamLimit) {
+  CreateCache(zx::msec(100), 10 * 1024 * 1024, 1);
+
+  bool done;
+  StartRead(kChunkSize * 3, &done);
+  RunLoopFor(zx::sec(5));
+  EXPECT_TRUE(done);
+  EXPECT_EQ(1u, upstream_->max_reads_in_flight());
+}
+
+// Tests that a seek drops the prefetches queued for the old position, so the
+// read at the seek target waits for at most the fetches already in flight.
+TEST_F(ReaderCacheTest, SeekPreemptsPrefetch) {
+  CreateCache(zx::msec(200), 10 * 1024 * 1024, 4);
+  zx::duration fetch_duration = upstream_->ReadDuration(kChunkSize);
+
+  bool done;
+  StartRead(0, &done);
+  RunLoopFor(fetch_duration + zx::msec(50));
+  EXPECT_TRUE(done);
+
+  constexpr size_t kSeekPosition = 48 * 1024 * 1024;
+  size_t reads_before_seek = upstream_->read_positions().size();
+  StartRead(kSeekPosition, &done);
+  RunLoopFor(fetch_duration * 2);
+  EXPECT_TRUE(done);
+
+  // The first fetch issued after the seek is for the seek target, and every
+  // one after that is for the new cache range.
+  const std::vector<size_t>& positions = upstream_->read_positions();
+  ASSERT_LT(reads_before_seek, positions.size());
+  EXPECT_EQ(kSeekPosition, positions[reads_before_seek]);
+  for (size_t i = reads_before_seek; i < positions.size(); ++i) {
+    EXPECT_LE(kSeekPosition - kMaxBacktrack, positions[i]);
+  }
+}
+
+// Tests that changing the chunk size while fetches are in flight doesn't
+// produce fetches larger than the cache's current slabs, and that the new
+// chunk size takes effect once those fetches are done.
+TEST_F(ReaderCacheTest, ChunkSizeChangeWhileFetching) {
+  CreateCache(zx::msec(200), 10 * 1024 * 1024, 4);
+  zx::duration fetch_duration = upstream_->ReadDuration(kChunkSize);
+
+  bool done;
+  StartRead(0, &done);
+  RunLoopFor(fetch_duration + zx::msec(50));
+  EXPECT_TRUE(done);
+
+  // Prefetches are in flight. Seeking rebuilds the fetch queue.
+  constexpr size_t kNewChunkSize = kChunkSize * 4;
+  under_test_->SetCacheOptions(kCapacity, kMaxBacktrack, kNewChunkSize);
+  size_t reads_before_seek = upstream_->read_sizes().size();
+  StartRead(48 * 1024 * 1024, &done);
+  RunLoopFor(zx::sec(10));
+  EXPECT_TRUE(done);
+
+  const std::vector<size_t>& sizes = upstream_->read_sizes();
+  ASSERT_LT(reads_before_seek, sizes.size());
+  for (size_t i = reads_before_seek; i < sizes.size(); ++i) {
+    EXPECT_GE(kChunkSize, sizes[i]);
+  }
+
+  // With nothing in flight, the next load starts over with the new chunk
+  // size.
+  size_t reads_before_reload = sizes.size();
+  StartRead(8 * 1024 * 1024, &done);
+  RunLoopFor(upstream_->ReadDuration(kNewChunkSize) + zx::msec(50));
+  EXPECT_TRUE(done);
+  ASSERT_LT(reads_before_reload, sizes.size());
+  EXPECT_EQ(kNewChunkSize, sizes[reads_before_reload]);
+}
+
+// Tests that readahead shrinks to suit a consumer that reads more slowly than
+// upstream can deliver.
+TEST_F(ReaderCacheTest, ReadaheadAdapts) {
+  CreateCache(zx::msec(50), 10 * 1024 * 1024, 4);
+  EXPECT_EQ(kCapacity - kMaxBacktrack, under_test_->readahead());
+
+  // Consume 3.2MB/s for ten seconds.
+  size_t position = 0;
+  for (size_t i = 0; i < 1000; ++i) {
+    bool done;
+    StartRead(position, &done);
+    RunLoopFor(zx::msec(10));
+    while (!done) {
+      RunLoopFor(zx::msec(10));
+    }
+
+    position += kReadSize;
+  }
+
+  // Readahead covers a couple of fetch durations plus a margin of a couple of
+  // seconds at the consumption rate, which is about 7MB.
+  size_t readahead = under_test_->readahead();
+  EXPECT_LT(readahead, kCapacity - kMaxBacktrack);
+  EXPECT_LT(5u * 1024 * 1024, readahead);
+
+  // Nothing has been fetched beyond the readahead.
+  EXPECT_GE(position + readahead + 2 * kChunkSize, upstream_->max_read_end());
+}
+
+}  // namespace
+}  // namespace media_player
@@ -166,6 +166,23 @@ TEST(SparseByteBufferTest, ReadRange) {
     EXPECT_EQ(copied, 25u);
     EXPECT_EQ(dest_buffer, CreateBuffer(25, 25));
   }
+
+  {
+    // Read range starting at a region which follows a gap.
+    SparseByteBuffer under_test = BufferWithRegions({{0, 50}, {100, 50}});
+    std::vector<uint8_t> dest_buffer(50);
+    size_t copied = under_test.ReadRange(100, 50, dest_buffer.data());
+    EXPECT_EQ(copied, 50u);
+    EXPECT_EQ(dest_buffer, CreateBuffer(100, 50));
+  }
+
+  {
+    // Read range starting in a gap.
+    SparseByteBuffer under_test = BufferWithRegions({{0, 50}, {100, 50}});
+    std::vector<uint8_t> dest_buffer(50);
+    size_t copied = under_test.ReadRange(75, 50, dest_buffer.data());
+    EXPECT_EQ(copied, 0u);
+  }
 }
 
 // Creates a second hole.
@@ -545,5 +562,162 @@ TEST(SparseByteBufferTest, ShrinkRegionBack) {
   }
 }
 
+// Verifies that Fill splits regions at block boundaries.
+TEST(SparseByteBufferTest, FillAcrossBlocks) {
+  SparseByteBuffer under_test;
+  under_test.Initialize(kSize, 256);
+
+  SparseByteBuffer::Hole hole =
+      under_test.FindOrCreateHole(100, under_test.null_hole());
+  ExpectHole(&under_test, 700, kSize - 700,
+             under_test.Fill(hole, CreateBuffer(100, 600)));
+
+  ExpectRegion(
+      &under_test, 100, 156,
+      under_test.FindRegionContaining(100, under_test.null_region()));
+  ExpectRegion(
+      &under_test, 256, 256,
+      under_test.FindRegionContaining(300, under_test.null_region()));
+  ExpectRegion(
+      &under_test, 512, 188,
+      under_test.FindRegionContaining(699, under_test.null_region()));
+  EXPECT_EQ(3u * 256u, under_test.bytes_in_use());
+
+  // Reads are served across the blocks.
+  std::vector<uint8_t> dest_buffer(600, 0);
+  EXPECT_EQ(600u, under_test.ReadRange(100, 600, dest_buffer.data()));
+  EXPECT_EQ(dest_buffer, CreateBuffer(100, 600));
+}
+
+TEST(SparseByteBufferTest, ReadInPlace) {
+  SparseByteBuffer under_test = BufferWithRegions({{0, 100}, {100, 100}});
+  size_t size;
+
+  // Abutting regions in the same block are returned together.
+  const uint8_t* data = under_test.ReadInPlace(50, &size);
+  EXPECT_NE(nullptr, data);
+  EXPECT_EQ(150u, size);
+  EXPECT_EQ(std::vector<uint8_t>(data, data + size), CreateBuffer(50, 150));
+
+  // Nothing is returned for a hole, including one before the first region.
+  EXPECT_EQ(nullptr, under_test.ReadInPlace(200, &size));
+  EXPECT_EQ(0u, size);
+  under_test = BufferWithRegions({{100, 100}});
+  EXPECT_EQ(nullptr, under_test.ReadInPlace(50, &size));
+  ExpectNullRegion(&under_test, under_test.FindRegionContaining(
+                                    50, under_test.null_region()));
+
+  // Results stop at the end of the block.
+  under_test.Initialize(kSize, 100);
+  FillRegion(&under_test, 0, 300);
+  data = under_test.ReadInPlace(150, &size);
+  EXPECT_NE(nullptr, data);
+  EXPECT_EQ(50u, size);
+  EXPECT_EQ(std::vector<uint8_t>(data, data + size), CreateBuffer(150, 50));
+}
+
+// Verifies that slabs are returned to the pool and reused.
+TEST(SparseByteBufferTest, SlabsReused) {
+  SparseByteBuffer under_test;
+  under_test.Initialize(kSize, 100);
+
+  FillRegion(&under_test, 0, 100);
+  EXPECT_EQ(100u, under_test.bytes_in_use());
+  EXPECT_EQ(100u, under_test.bytes_allocated());
+
+  under_test.Free(
+      under_test.FindRegionContaining(0, under_test.null_region()));
+  EXPECT_EQ(0u, under_test.bytes_in_use());
+  EXPECT_EQ(100u, under_test.bytes_allocated());
+
+  FillRegion(&under_test, 500, 100);
+  ExpectRegion(
+      &under_test, 500, 100,
+      under_test.FindRegionContaining(500, under_test.null_region()));
+  EXPECT_EQ(100u, under_test.bytes_in_use());
+  EXPECT_EQ(100u, under_test.bytes_allocated());
+
+  // Shrinking a region doesn't release its slab, but freeing the last region
+  // in a block does.
+  FillRegion(&under_test, 600, 50);
+  FillRegion(&under_test, 650, 50);
+  EXPECT_EQ(200u, under_test.bytes_in_use());
+  under_test.ShrinkRegionBack(
+      under_test.FindRegionContaining(600, under_test.null_region()), 10);
+  EXPECT_EQ(200u, under_test.bytes_in_use());
+  under_test.Free(
+      under_test.FindRegionContaining(600, under_test.null_region()));
+  EXPECT_EQ(200u, under_test.bytes_in_use());
+  under_test.Free(
+      under_test.FindRegionContaining(650, under_test.null_region()));
+  EXPECT_EQ(100u, under_test.bytes_in_use());
+  EXPECT_EQ(200u, under_test.bytes_allocated());
+}
+
+TEST(SparseByteBufferTest, PrepareCommitFill) {
+  SparseByteBuffer under_test;
+  under_test.Initialize(kSize, 100);
+
+  // Commit fewer bytes than were prepared.
+  uint8_t* dest = under_test.PrepareFill(10, 50);
+  std::vector<uint8_t> source = CreateBuffer(10, 50);
+  std::copy(source.begin(), source.end(), dest);
+  ExpectHole(&under_test, 30, kSize - 30, under_test.CommitFill(10, 20));
+  ExpectRegion(&under_test, 10, 20,
+               under_test.FindRegionContaining(10, under_test.null_region()));
+  ExpectHole(&under_test, 0, 10, under_test.FindHoleContaining(0));
+
+  // Blocks with pending fills aren't evicted.
+  under_test.PrepareFill(500, 10);
+  EXPECT_EQ(200u, under_test.bytes_in_use());
+  EXPECT_EQ(0u, under_test.EvictExcept(kSize, 0, 10));
+  EXPECT_EQ(200u, under_test.bytes_in_use());
+
+  // Cancelling a fill releases its slab.
+  under_test.CancelFill(500);
+  EXPECT_EQ(100u, under_test.bytes_in_use());
+  ExpectHole(&under_test, 30, kSize - 30, under_test.FindHoleContaining(500));
+}
+
+TEST(SparseByteBufferTest, EvictExcept) {
+  SparseByteBuffer under_test;
+  under_test.Initialize(kSize, 100);
+  FillRegion(&under_test, 0, kSize);
+
+  // Make block 8 the most recently used.
+  std::vector<uint8_t> dest_buffer(10);
+  under_test.ReadRange(800, 10, dest_buffer.data());
+
+  // Blocks behind the protected range go first, least recently used first.
+  EXPECT_EQ(300u, under_test.EvictExcept(300, 400, 200));
+  ExpectHole(&under_test, 0, 300, under_test.FindHoleContaining(0));
+  ExpectRegion(
+      &under_test, 300, 100,
+      under_test.FindRegionContaining(300, under_test.null_region()));
+
+  // Then blocks beyond it.
+  EXPECT_EQ(200u, under_test.EvictExcept(200, 400, 200));
+  ExpectHole(&under_test, 0, 400, under_test.FindHoleContaining(0));
+  ExpectHole(&under_test, 600, 100, under_test.FindHoleContaining(600));
+  ExpectRegion(
+      &under_test, 700, 100,
+      under_test.FindRegionContaining(700, under_test.null_region()));
+
+  // Block 8 is the last to go, and the protected range is never evicted.
+  EXPECT_EQ(200u, under_test.EvictExcept(200, 400, 200));
+  ExpectRegion(
+      &under_test, 800, 100,
+      under_test.FindRegionContaining(800, under_test.null_region()));
+  EXPECT_EQ(100u, under_test.EvictExcept(kSize, 400, 200));
+  EXPECT_EQ(200u, under_test.bytes_in_use());
+  ExpectRegion(
+      &under_test, 400, 100,
+      under_test.FindRegionContaining(400, under_test.null_region()));
+  ExpectRegion(
+      &under_test, 500, 100,
+      under_test.FindRegionContaining(500, under_test.null_region()));
+  ExpectHole(&under_test, 600, kSize - 600, under_test.FindHoleContaining(600));
+}
+
 }  // namespace
 }  // namespace media_player
@@ -6,6 +6,7 @@
 
 #include <lib/async/cpp/task.h>
 #include <trace/event.h>
+#include <cstring>
 #include "garnet/bin/mediaplayer/ffmpeg/av_codec_context.h"
 #include "garnet/bin/mediaplayer/graph/formatting.h"
 #include "lib/fxl/logging.h"
@@ -195,8 +196,36 @@ int FfmpegDecoderBase::SendPacket(const PacketPtr& input) {
     av_packet.flags |= AV_PKT_FLAG_KEY;
   }
 
+  // ffmpeg copies the payload of a packet that isn't reference-counted. If
+  // the payload buffer has room for the padding ffmpeg requires, we wrap it
+  // in an |AVBuffer| so ffmpeg references it instead.
+  if (input->size() != 0) {
+    if (input->payload_buffer()->size() >=
+        input->size() + AV_INPUT_BUFFER_PADDING_SIZE) {
+      memset(av_packet.data + av_packet.size, 0, AV_INPUT_BUFFER_PADDING_SIZE);
+      void* opaque = CopyRefPtrToOpaque(input->payload_buffer());
+      av_packet.buf =
+          av_buffer_create(av_packet.data, av_packet.size,
+                           ReleaseBufferForAvFrame, opaque,
+                           AV_BUFFER_FLAG_READONLY);
+      if (!av_packet.buf) {
+        ReleaseOpaqueRefPtr<PayloadBuffer>(opaque);
+      }
+    }
+
+    if (av_packet.buf) {
+      input_bytes_referenced_ += input->size();
+    } else {
+      input_bytes_copied_ += input->size();
+    }
+  }
+
   int result = avcodec_send_packet(av_codec_context_.get(), &av_packet);
 
+  // Drop our reference to the |AVBuffer|, if there is one. ffmpeg holds its
+  // own reference for as long as it needs the payload.
+  av_packet_unref(&av_packet);
+
   if (result != 0) {
     FXL_DLOG(ERROR) << "avcodec_send_packet failed " << result;
   }
@@ -255,6 +284,10 @@ void FfmpegDecoderBase::Dump(std::ostream& os) const {
   os << fostr::Indent;
   os << fostr::NewLine << "next pts:          " << AsNs(next_pts_) << "@"
      << pts_rate_;
+  os << fostr::NewLine << "input referenced:  " << input_bytes_referenced_
+     << " bytes";
+  os << fostr::NewLine << "input copied:      " << input_bytes_copied_
+     << " bytes";
   os << fostr::Outdent;
 }
 
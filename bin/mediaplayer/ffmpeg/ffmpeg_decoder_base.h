@@ -5,6 +5,7 @@
 #ifndef GARNET_BIN_MEDIAPLAYER_FFMPEG_FFMPEG_DECODER_BASE_H_
 #define GARNET_BIN_MEDIAPLAYER_FFMPEG_FFMPEG_DECODER_BASE_H_
 
+#include <atomic>
 #include <limits>
 
 #include <lib/async-loop/cpp/loop.h>
@@ -79,7 +80,8 @@ class FfmpegDecoderBase : public SoftwareDecoder {
   static int AllocateBufferForAvFrame(AVCodecContext* av_codec_context,
                                       AVFrame* av_frame, int flags);
 
-  // Callback used by the ffmpeg decoder to release a buffer.
+  // Callback used by the ffmpeg decoder to release a buffer created from a
+  // |PayloadBuffer|, either for a frame or for an input packet.
   static void ReleaseBufferForAvFrame(void* opaque, uint8_t* buffer);
 
   // Sends |input| to the ffmpeg decoder and returns the result of
@@ -93,6 +95,11 @@ class FfmpegDecoderBase : public SoftwareDecoder {
   ffmpeg::AvFramePtr av_frame_ptr_;
   int64_t next_pts_ = Packet::kUnknownPts;
   media::TimelineRate pts_rate_;
+
+  // Input payload bytes passed to ffmpeg by reference and by copy,
+  // respectively. These are written on the worker thread and read by |Dump|.
+  std::atomic_uint64_t input_bytes_referenced_{0};
+  std::atomic_uint64_t input_bytes_copied_{0};
 };
 
 }  // namespace media_player
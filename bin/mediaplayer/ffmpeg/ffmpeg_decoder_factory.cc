@@ -16,7 +16,10 @@ std::unique_ptr<DecoderFactory> FfmpegDecoderFactory::Create(
   return std::make_unique<FfmpegDecoderFactory>();
 }
 
-FfmpegDecoderFactory::FfmpegDecoderFactory() {}
+FfmpegDecoderFactory::FfmpegDecoderFactory(
+    FfmpegVideoDecoder::Threading video_threading, int video_thread_count)
+    : video_threading_(video_threading),
+      video_thread_count_(video_thread_count) {}
 
 FfmpegDecoderFactory::~FfmpegDecoderFactory() {}
 
@@ -39,6 +42,13 @@ void FfmpegDecoderFactory::CreateDecoder(
     return;
   }
 
+  // Threading must be configured before the codec is opened. Audio decoding
+  // is cheap enough that we leave it on the decoder's worker thread.
+  if (av_codec_context->codec_type == AVMEDIA_TYPE_VIDEO) {
+    FfmpegVideoDecoder::ConfigureThreading(
+        av_codec_context.get(), video_threading_, video_thread_count_);
+  }
+
   int r = avcodec_open2(av_codec_context.get(), ffmpeg_decoder, nullptr);
   if (r < 0) {
     FXL_LOG(ERROR) << "couldn't open the decoder " << r;
@@ -8,6 +8,7 @@
 #include <memory>
 
 #include "garnet/bin/mediaplayer/decode/decoder.h"
+#include "garnet/bin/mediaplayer/ffmpeg/ffmpeg_video_decoder.h"
 
 namespace media_player {
 
@@ -18,13 +19,23 @@ class FfmpegDecoderFactory : public DecoderFactory {
   static std::unique_ptr<DecoderFactory> Create(
       component::StartupContext* startup_context);
 
-  FfmpegDecoderFactory();
+  // Creates a factory whose video decoders use |video_threading| with
+  // |video_thread_count| threads. A thread count of zero selects a count based
+  // on the number of CPUs.
+  FfmpegDecoderFactory(
+      FfmpegVideoDecoder::Threading video_threading =
+          FfmpegVideoDecoder::Threading::kFrame,
+      int video_thread_count = 0);
 
   ~FfmpegDecoderFactory() override;
 
   void CreateDecoder(
       const StreamType& stream_type,
       fit::function<void(std::shared_ptr<Decoder>)> callback) override;
+
+ private:
+  FfmpegVideoDecoder::Threading video_threading_;
+  int video_thread_count_;
 };
 
 }  // namespace media_player
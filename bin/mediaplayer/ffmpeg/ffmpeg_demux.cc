@@ -356,9 +356,7 @@ PacketPtr FfmpegDemuxImpl::PullPacket(size_t* stream_index_out) {
   }
 
   ffmpeg::AvPacketPtr av_packet = ffmpeg::AvPacket::Create();
-
-  av_packet->data = nullptr;
-  av_packet->size = 0;
+  FXL_DCHECK(av_packet);
 
   if (av_read_frame(format_context_.get(), av_packet.get()) < 0) {
     // End of stream. Start producing end-of-stream packets for all the streams.
@@ -380,12 +378,18 @@ PacketPtr FfmpegDemuxImpl::PullPacket(size_t* stream_index_out) {
   fbl::RefPtr<PayloadBuffer> payload_buffer;
   uint64_t size = av_packet->size;
   if (size != 0) {
+    // |av_read_frame| reads the packet into a reference-counted |AVBuffer|
+    // followed by |AV_INPUT_BUFFER_PADDING_SIZE| zeroed bytes. The payload
+    // buffer covers the padding too, which allows ffmpeg decoders to reference
+    // the payload rather than copying it. See |FfmpegDecoderBase::SendPacket|.
+    //
     // The recycler used here just holds a captured reference to the |AVPacket|
     // so the memory underlying the |AVPacket| and the |PayloadBuffer| is not
     // deleted/recycled. This doesn't prevent the demux from generating more
     // |AVPackets|.
+    FXL_DCHECK(av_packet->buf);
     payload_buffer = PayloadBuffer::Create(
-        size, av_packet->data,
+        size + AV_INPUT_BUFFER_PADDING_SIZE, av_packet->data,
         [av_packet = std::move(av_packet)](PayloadBuffer* payload_buffer) {
           // The deallocation happens when |av_packet|
           // goes out of scope. The |PayloadBuffer|
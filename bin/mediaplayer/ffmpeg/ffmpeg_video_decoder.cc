@@ -5,8 +5,10 @@
 #include "garnet/bin/mediaplayer/ffmpeg/ffmpeg_video_decoder.h"
 
 #include <lib/sync/completion.h>
+#include <zircon/syscalls.h>
 #include <algorithm>
 #include "garnet/bin/mediaplayer/ffmpeg/ffmpeg_formatting.h"
+#include "garnet/bin/mediaplayer/graph/formatting.h"
 #include "lib/fxl/logging.h"
 #include "lib/media/timeline/timeline.h"
 #include "lib/media/timeline/timeline_rate.h"
@@ -17,10 +19,48 @@ extern "C" {
 namespace media_player {
 namespace {
 
+// The number of output payloads we allow when decoding on a single thread.
+// Each additional decode thread holds one more.
 constexpr uint32_t kOutputMaxPayloadCount = 6;
 
+// The most threads we'll ask ffmpeg to use when choosing the count based on
+// the number of CPUs. Beyond this, frame threading adds delay and memory
+// without improving throughput much.
+constexpr int kMaxAutoThreadCount = 4;
+
 }  // namespace
 
+// static
+void FfmpegVideoDecoder::ConfigureThreading(AVCodecContext* av_codec_context,
+                                            Threading threading,
+                                            int thread_count) {
+  FXL_DCHECK(av_codec_context);
+  FXL_DCHECK(thread_count >= 0);
+
+  if (thread_count == 0) {
+    thread_count = std::min(static_cast<int>(zx_system_get_num_cpus()),
+                            kMaxAutoThreadCount);
+  }
+
+  switch (threading) {
+    case Threading::kNone:
+      av_codec_context->thread_count = 1;
+      av_codec_context->thread_type = 0;
+      return;
+    case Threading::kSlice:
+      av_codec_context->thread_type = FF_THREAD_SLICE;
+      break;
+    case Threading::kFrame:
+      av_codec_context->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+      break;
+  }
+
+  av_codec_context->thread_count = thread_count;
+
+  // |AllocateBufferForAvFrame| may be called on any of the decode threads.
+  av_codec_context->thread_safe_callbacks = 1;
+}
+
 // static
 std::shared_ptr<Decoder> FfmpegVideoDecoder::Create(
     AvCodecContextPtr av_codec_context) {
@@ -31,13 +71,18 @@ FfmpegVideoDecoder::FfmpegVideoDecoder(AvCodecContextPtr av_codec_context)
     : FfmpegDecoderBase(std::move(av_codec_context)) {
   FXL_DCHECK(context());
 
-  // Turn on multi-proc decoding by allowing the decoder to use three threads
-  // (the calling thread and the two specified here). FF_THREAD_FRAME means
-  // that threads are assigned an entire frame.
-  // TODO(dalesat): Consider using FF_THREAD_SLICE.
-  context()->thread_count = 2;
-  context()->thread_type = FF_THREAD_FRAME;
+  // Threading is configured by |ConfigureThreading| before the codec is
+  // opened. Here, we find out what ffmpeg actually decided to do.
+  thread_count_ = std::max(context()->thread_count, 1);
+  frame_threading_ = (context()->active_thread_type & FF_THREAD_FRAME) != 0;
 
+  // With frame threading, each decode thread may hold a frame it's working
+  // on, so we need that many more output payloads.
+  output_max_payload_count_ =
+      kOutputMaxPayloadCount +
+      (frame_threading_ ? static_cast<uint32_t>(thread_count_ - 1) : 0);
+
+  std::lock_guard<std::mutex> locker(mutex_);
   frame_layout_.Update(*context());
 }
 
@@ -50,9 +95,10 @@ void FfmpegVideoDecoder::ConfigureConnectors() {
   stage()->ConfigureInputToUseLocalMemory(0,   // max_aggregate_payload_size
                                           2);  // max_payload_count
 
+  std::lock_guard<std::mutex> locker(mutex_);
   if (has_size()) {
     configured_output_buffer_size_ = frame_layout_.buffer_size();
-    stage()->ConfigureOutputToUseLocalMemory(0, kOutputMaxPayloadCount,
+    stage()->ConfigureOutputToUseLocalMemory(0, output_max_payload_count_,
                                              configured_output_buffer_size_);
   } else {
     stage()->ConfigureOutputDeferred();
@@ -72,12 +118,46 @@ void FfmpegVideoDecoder::OnNewInputPacket(const PacketPtr& packet) {
   // We put the pts here so it can be recovered later in CreateOutputPacket.
   // Ffmpeg deals with the frame ordering issues.
   context()->reordered_opaque = packet->pts();
+
+  UpdateOutputDelay(packet->pts());
+}
+
+void FfmpegVideoDecoder::UpdateOutputDelay(int64_t pts) {
+  // Packets arrive in decode order, so the differences between successive
+  // pts values may be larger than a frame or even negative. The smallest
+  // positive difference is the frame interval.
+  if (last_input_pts_ != Packet::kUnknownPts && pts > last_input_pts_) {
+    int64_t interval = pts - last_input_pts_;
+    if (min_frame_interval_ == 0 || interval < min_frame_interval_) {
+      min_frame_interval_ = interval;
+    }
+  }
+
+  last_input_pts_ = pts;
+
+  if (min_frame_interval_ == 0) {
+    return;
+  }
+
+  // The codec holds back |has_b_frames| frames for reordering, and frame
+  // threading holds back one more frame for each additional thread.
+  int64_t delay_frames = context()->has_b_frames;
+  if (frame_threading_) {
+    delay_frames += thread_count_ - 1;
+  }
+
+  output_delay_ = (media::TimelineRate::NsPerSecond / pts_rate())
+                      .Scale(delay_frames * min_frame_interval_);
 }
 
 int FfmpegVideoDecoder::BuildAVFrame(const AVCodecContext& av_codec_context,
                                      AVFrame* av_frame) {
   FXL_DCHECK(av_frame);
 
+  // This may be called on multiple decode threads at once, so we hold the
+  // lock while we update the layout and copy what we need from it.
+  std::unique_lock<std::mutex> locker(mutex_);
+
   if (frame_layout_.Update(av_codec_context)) {
     revised_stream_type_ = AvCodecContext::GetStreamType(av_codec_context);
   }
@@ -130,25 +210,33 @@ int FfmpegVideoDecoder::BuildAVFrame(const AVCodecContext& av_codec_context,
     configured_output_buffer_size_ = buffer_size;
 
     // We need to configure the output, but that has to happen on the graph
-    // thread. Do that and block until it's done.
+    // thread. Do that and block until it's done. Other decode threads wait
+    // on the lock, because they can't allocate buffers of the new size until
+    // this is done.
     sync_completion completion;
     stage()->PostTask([this, buffer_size, &completion]() {
       stage()->ConfigureOutputToUseLocalMemory(
-          0,                       // max_aggregate_payload_size
-          kOutputMaxPayloadCount,  // max_payload_count
-          buffer_size);            // max_payload_size
+          0,                          // max_aggregate_payload_size
+          output_max_payload_count_,  // max_payload_count
+          buffer_size);               // max_payload_size
       sync_completion_signal(&completion);
     });
 
     sync_completion_wait(&completion, ZX_TIME_INFINITE);
   }
 
+  std::vector<uint32_t> line_stride = frame_layout_.line_stride();
+  std::vector<uint32_t> plane_offset = frame_layout_.plane_offset();
+  locker.unlock();
+
+  // The payload manager is thread-safe, so we allocate and clear the buffer
+  // without holding the lock.
   fbl::RefPtr<PayloadBuffer> payload_buffer =
-      stage()->AllocatePayloadBuffer(frame_layout_.buffer_size());
+      stage()->AllocatePayloadBuffer(buffer_size);
 
   if (!payload_buffer) {
     FXL_LOG(ERROR) << "failed to allocate payload buffer of size "
-                   << frame_layout_.buffer_size();
+                   << buffer_size;
     return -1;
   }
 
@@ -158,15 +246,14 @@ int FfmpegVideoDecoder::BuildAVFrame(const AVCodecContext& av_codec_context,
   FXL_DCHECK(PayloadBuffer::kByteAlignment >= kFrameBufferAlign);
 
   // Decoders require a zeroed buffer.
-  std::memset(payload_buffer->data(), 0, frame_layout_.buffer_size());
+  std::memset(payload_buffer->data(), 0, buffer_size);
 
-  FXL_DCHECK(frame_layout_.line_stride().size() ==
-             frame_layout_.plane_offset().size());
+  FXL_DCHECK(line_stride.size() == plane_offset.size());
 
-  for (size_t plane = 0; plane < frame_layout_.plane_offset().size(); ++plane) {
+  for (size_t plane = 0; plane < plane_offset.size(); ++plane) {
     av_frame->data[plane] = reinterpret_cast<uint8_t*>(payload_buffer->data()) +
-                            frame_layout_.plane_offset()[plane];
-    av_frame->linesize[plane] = frame_layout_.line_stride()[plane];
+                            plane_offset[plane];
+    av_frame->linesize[plane] = line_stride[plane];
   }
 
   // TODO(dalesat): Do we need to attach colorspace info to the packet?
@@ -190,6 +277,8 @@ PacketPtr FfmpegVideoDecoder::CreateOutputPacket(
   // Recover the pts deposited in Decode.
   set_next_pts(av_frame.reordered_opaque);
 
+  std::lock_guard<std::mutex> locker(mutex_);
+
   PacketPtr packet = Packet::Create(
       av_frame.reordered_opaque, pts_rate(), av_frame.key_frame, false,
       frame_layout_.buffer_size(), std::move(payload_buffer));
@@ -201,6 +290,16 @@ PacketPtr FfmpegVideoDecoder::CreateOutputPacket(
   return packet;
 }
 
+void FfmpegVideoDecoder::Dump(std::ostream& os) const {
+  FfmpegDecoderBase::Dump(os);
+
+  os << fostr::Indent;
+  os << fostr::NewLine << "decode threads:    " << thread_count_
+     << (frame_threading_ ? " (frame)" : thread_count_ > 1 ? " (slice)" : "");
+  os << fostr::NewLine << "output delay:      " << AsNs(output_delay_.load());
+  os << fostr::Outdent;
+}
+
 const char* FfmpegVideoDecoder::label() const { return "video_decoder"; }
 
 }  // namespace media_player
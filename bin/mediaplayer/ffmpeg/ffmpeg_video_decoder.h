@@ -5,8 +5,12 @@
 #ifndef GARNET_BIN_MEDIAPLAYER_FFMPEG_FFMPEG_VIDEO_DECODER_H_
 #define GARNET_BIN_MEDIAPLAYER_FFMPEG_FFMPEG_VIDEO_DECODER_H_
 
+#include <atomic>
+#include <mutex>
+
 #include "garnet/bin/mediaplayer/ffmpeg/ffmpeg_decoder_base.h"
 #include "garnet/bin/mediaplayer/ffmpeg/ffmpeg_video_frame_layout.h"
+#include "lib/fxl/synchronization/thread_annotations.h"
 #include "lib/media/timeline/timeline_rate.h"
 
 namespace media_player {
@@ -14,15 +18,38 @@ namespace media_player {
 // Decoder implementation employing and ffmpeg video decoder.
 class FfmpegVideoDecoder : public FfmpegDecoderBase {
  public:
+  // Ways in which ffmpeg may spread decoding across multiple threads.
+  enum class Threading {
+    // Decode entirely on the decoder's worker thread.
+    kNone,
+    // Decode the slices of each frame in parallel. This adds no delay.
+    kSlice,
+    // Decode successive frames in parallel, which delays output by one frame
+    // per additional thread. Codecs that don't support frame threading use
+    // slice threading instead.
+    kFrame
+  };
+
+  // Configures threading for |av_codec_context|, which must not have been
+  // opened yet. A |thread_count| of zero selects a count based on the number
+  // of CPUs.
+  static void ConfigureThreading(AVCodecContext* av_codec_context,
+                                 Threading threading, int thread_count);
+
   static std::shared_ptr<Decoder> Create(AvCodecContextPtr av_codec_context);
 
   FfmpegVideoDecoder(AvCodecContextPtr av_codec_context);
 
   ~FfmpegVideoDecoder() override;
 
+  // Decoder implementation.
+  int64_t output_delay() const override { return output_delay_; }
+
   // AsyncNode implementation.
   void ConfigureConnectors() override;
 
+  void Dump(std::ostream& os) const override;
+
  protected:
   // FfmpegDecoderBase overrides.
   void OnNewInputPacket(const PacketPtr& packet) override;
@@ -42,19 +69,36 @@ class FfmpegVideoDecoder : public FfmpegDecoderBase {
   static const int kFrameBufferAlign = 32;
 
   // Indicates whether the decoder has a non-zero coded size.
-  bool has_size() const {
+  bool has_size() const FXL_EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
     return coded_size_.width() != 0 && coded_size_.height() != 0;
   }
 
-  FfmpegVideoFrameLayout frame_layout_;
-  std::unique_ptr<StreamType> revised_stream_type_;
+  // Updates |output_delay_| based on the pts of a new input packet.
+  void UpdateOutputDelay(int64_t pts);
+
+  // How ffmpeg actually decided to thread decoding and the resulting limit on
+  // output payloads. These are established when the decoder is constructed.
+  int thread_count_;
+  bool frame_threading_;
+  uint32_t output_max_payload_count_;
+
+  // |BuildAVFrame| is called on ffmpeg's decode threads when frame threading
+  // is enabled, so the state it shares is guarded by |mutex_|.
+  mutable std::mutex mutex_;
+  FfmpegVideoFrameLayout frame_layout_ FXL_GUARDED_BY(mutex_);
+  std::unique_ptr<StreamType> revised_stream_type_ FXL_GUARDED_BY(mutex_);
 
   // TODO(dalesat): For investigation only...remove these three fields.
-  bool first_frame_ = true;
-  AVColorSpace colorspace_;
-  VideoStreamType::Extent coded_size_;
-  
-  size_t configured_output_buffer_size_ = 0;
+  bool first_frame_ FXL_GUARDED_BY(mutex_) = true;
+  AVColorSpace colorspace_ FXL_GUARDED_BY(mutex_);
+  VideoStreamType::Extent coded_size_ FXL_GUARDED_BY(mutex_);
+
+  size_t configured_output_buffer_size_ FXL_GUARDED_BY(mutex_) = 0;
+
+  // Output delay state, updated on the worker thread.
+  int64_t last_input_pts_ = Packet::kUnknownPts;
+  int64_t min_frame_interval_ = 0;
+  std::atomic<int64_t> output_delay_{0};
 };
 
 }  // namespace media_player
@@ -0,0 +1,213 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Allocates and releases payload buffers the way a stage and its downstream
+// neighbor do, with a fixed number of payloads in flight, and reports the
+// time per allocate/release cycle. The 'Malloc' cases allocate every buffer
+// from the system, which is what LocalMemoryPayloadAllocator used to do. The
+// 'Pooled' cases use LocalMemoryPayloadAllocator via a PayloadManager. The
+// 'Threaded' cases release buffers on a second thread, as happens when a
+// renderer releases payloads allocated by a decoder.
+
+#include <stdio.h>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include <lib/zx/handle.h>
+
+#include "garnet/bin/mediaplayer/graph/payloads/payload_manager.h"
+#include "lib/fxl/command_line.h"
+#include "lib/fxl/logging.h"
+
+namespace media_player {
+namespace {
+
+constexpr size_t kCyclesPerCase = 20000;
+constexpr size_t kPageSize = 4096;
+
+struct Case {
+  const char* name;
+  uint64_t payload_size;
+  size_t payloads_in_flight;
+};
+
+const Case kCases[] = {
+    // 10ms of 48kHz stereo 16-bit audio.
+    {"Audio", 1920, 4},
+    // Slices of compressed video.
+    {"Slice", 16 * 1024, 8},
+    // 1080p I420 frames.
+    {"Frame", 1920 * 1080 * 3 / 2, 8},
+};
+
+// Touches every page of |payload_buffer|, as a producer filling it would. This
+// exposes the cost of faulting in fresh memory from the system.
+void Touch(const fbl::RefPtr<PayloadBuffer>& payload_buffer) {
+  uint8_t* data = reinterpret_cast<uint8_t*>(payload_buffer->data());
+  for (uint64_t offset = 0; offset < payload_buffer->size();
+       offset += kPageSize) {
+    data[offset] = static_cast<uint8_t>(offset);
+  }
+}
+
+// Releases payload buffers on a separate thread.
+class Releaser {
+ public:
+  Releaser() : thread_([this]() { Run(); }) {}
+
+  ~Releaser() {
+    {
+      std::lock_guard<std::mutex> locker(mutex_);
+      done_ = true;
+    }
+
+    condition_variable_.notify_one();
+    thread_.join();
+  }
+
+  void Release(fbl::RefPtr<PayloadBuffer> payload_buffer) {
+    {
+      std::lock_guard<std::mutex> locker(mutex_);
+      queue_.push_back(std::move(payload_buffer));
+    }
+
+    condition_variable_.notify_one();
+  }
+
+ private:
+  void Run() {
+    std::unique_lock<std::mutex> locker(mutex_);
+    while (true) {
+      condition_variable_.wait(locker,
+                               [this]() { return done_ || !queue_.empty(); });
+      if (queue_.empty()) {
+        return;
+      }
+
+      fbl::RefPtr<PayloadBuffer> payload_buffer = std::move(queue_.front());
+      queue_.pop_front();
+      locker.unlock();
+      payload_buffer = nullptr;
+      locker.lock();
+    }
+  }
+
+  std::mutex mutex_;
+  std::condition_variable condition_variable_;
+  std::deque<fbl::RefPtr<PayloadBuffer>> queue_;
+  bool done_ = false;
+  std::thread thread_;
+};
+
+// Runs |test_case|, allocating buffers using |allocate| and returning the
+// nanoseconds per cycle.
+template <typename Allocate>
+double Run(const Case& test_case, bool threaded, Allocate allocate) {
+  std::deque<fbl::RefPtr<PayloadBuffer>> in_flight;
+  std::unique_ptr<Releaser> releaser;
+  if (threaded) {
+    releaser = std::make_unique<Releaser>();
+  }
+
+  auto start_time = std::chrono::steady_clock::now();
+
+  for (size_t cycle = 0; cycle < kCyclesPerCase; ++cycle) {
+    fbl::RefPtr<PayloadBuffer> payload_buffer =
+        allocate(test_case.payload_size);
+    FXL_CHECK(payload_buffer);
+    Touch(payload_buffer);
+    in_flight.push_back(std::move(payload_buffer));
+
+    if (in_flight.size() > test_case.payloads_in_flight) {
+      if (releaser) {
+        releaser->Release(std::move(in_flight.front()));
+      }
+
+      in_flight.pop_front();
+    }
+  }
+
+  in_flight.clear();
+  releaser.reset();
+
+  auto elapsed = std::chrono::steady_clock::now() - start_time;
+  return static_cast<double>(
+             std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed)
+                 .count()) /
+         kCyclesPerCase;
+}
+
+double RunMalloc(const Case& test_case, bool threaded) {
+  return Run(test_case, threaded, [](uint64_t size) {
+    return PayloadBuffer::CreateWithMalloc(size);
+  });
+}
+
+double RunPooled(const Case& test_case, bool threaded,
+                 std::string* dump_out) {
+  PayloadConfig config;
+  config.mode_ = PayloadMode::kUsesLocalMemory;
+  config.max_payload_count_ = test_case.payloads_in_flight;
+  config.max_payload_size_ = test_case.payload_size;
+
+  PayloadManager payload_manager;
+  payload_manager.ApplyOutputConfiguration(config, zx::handle());
+  payload_manager.ApplyInputConfiguration(config, zx::handle(), nullptr);
+  FXL_CHECK(payload_manager.ready());
+
+  double result = Run(test_case, threaded, [&payload_manager](uint64_t size) {
+    return payload_manager.AllocatePayloadBufferForOutput(size);
+  });
+
+  std::ostringstream os;
+  payload_manager.Dump(os);
+  *dump_out = os.str();
+
+  return result;
+}
+
+}  // namespace
+}  // namespace media_player
+
+int main(int argc, char** argv) {
+  auto command_line = fxl::CommandLineFromArgcArgv(argc, argv);
+  std::string filter;
+  command_line.GetOptionValue("filter", &filter);
+  bool dump = command_line.HasOption("dump");
+
+  if (command_line.HasOption("help")) {
+    printf("Usage: %s [--filter=<substring>] [--dump]\n", argv[0]);
+    return 0;
+  }
+
+  printf("%-24s %12s %12s %8s\n", "Case", "Malloc ns", "Pooled ns",
+         "Speedup");
+  for (const auto& test_case : media_player::kCases) {
+    for (bool threaded : {false, true}) {
+      std::string label =
+          std::string(test_case.name) + (threaded ? "/Threaded" : "");
+      if (!filter.empty() && label.find(filter) == std::string::npos) {
+        continue;
+      }
+
+      std::string pooled_dump;
+      double malloc_ns = media_player::RunMalloc(test_case, threaded);
+      double pooled_ns =
+          media_player::RunPooled(test_case, threaded, &pooled_dump);
+      printf("%-24s %12.0f %12.0f %7.1fx\n", label.c_str(), malloc_ns,
+             pooled_ns, malloc_ns / pooled_ns);
+
+      if (dump) {
+        printf("%s\n", pooled_dump.c_str());
+      }
+    }
+  }
+
+  return 0;
+}
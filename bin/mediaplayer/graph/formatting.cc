@@ -301,6 +301,38 @@ std::ostream& operator<<(std::ostream& os, const StageImpl& value) {
   return os << *value.GetGenericNode();
 }
 
+std::ostream& operator<<(std::ostream& os, const DurationStats& value) {
+  if (value.count_ == 0) {
+    return os << "<none>";
+  }
+
+  return os << value.count_ << " mean " << AsNs(value.mean()) << " max "
+            << AsNs(value.max_);
+}
+
+std::ostream& operator<<(std::ostream& os,
+                         const StageMetrics::Snapshot& value) {
+  os << fostr::Indent;
+  os << fostr::NewLine << "elapsed:        " << AsNs(value.elapsed_);
+  os << fostr::NewLine << "busy:           "
+     << static_cast<int>(value.busy_fraction() * 100.0 + 0.5) << "%";
+  os << fostr::NewLine << "input wait:     " << value.input_wait_;
+  os << fostr::NewLine << "processing:     " << value.processing_;
+  os << fostr::NewLine << "output wait:    " << value.output_wait_;
+  os << fostr::NewLine << "payload wait:   " << value.payload_wait_;
+  if (value.payload_failures_ != 0) {
+    os << fostr::NewLine << "payload failed: " << value.payload_failures_;
+  }
+
+  for (size_t i = 0; i < value.output_queues_.size(); ++i) {
+    const StageMetrics::OutputQueue& queue = value.output_queues_[i];
+    os << fostr::NewLine << "output " << i << " queue: " << queue.depth_
+       << " (max " << queue.max_depth_ << ")";
+  }
+
+  return os << fostr::Outdent;
+}
+
 std::ostream& operator<<(std::ostream& os, const Input& value) {
   FXL_DCHECK(value.stage());
 
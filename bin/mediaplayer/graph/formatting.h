@@ -47,6 +47,9 @@ std::ostream& operator<<(std::ostream& os, media::TimelineRate value);
 std::ostream& operator<<(std::ostream& os, media::TimelineFunction value);
 std::ostream& operator<<(std::ostream& os, const GenericNode& value);
 std::ostream& operator<<(std::ostream& os, const StageImpl& value);
+std::ostream& operator<<(std::ostream& os, const DurationStats& value);
+std::ostream& operator<<(std::ostream& os,
+                         const StageMetrics::Snapshot& value);
 std::ostream& operator<<(std::ostream& os, const Input& value);
 std::ostream& operator<<(std::ostream& os, const Output& value);
 std::ostream& operator<<(std::ostream& os, const StreamType& value);
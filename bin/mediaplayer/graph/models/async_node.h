@@ -316,6 +316,14 @@ class AsyncNodeStage : public Stage {
   //
   // This method may be called on an arbitrary thread.
   virtual void PutOutputPacket(PacketPtr packet, size_t output_index = 0) = 0;
+
+  // Reports |duration| nanoseconds spent processing packets outside of the
+  // node's |PutInputPacket| and |RequestOutputPacket| methods, on a worker
+  // thread for example. Time spent in those methods is measured by the stage
+  // and shouldn't be reported.
+  //
+  // This method may be called on an arbitrary thread.
+  virtual void ReportProcessing(int64_t duration) = 0;
 };
 
 // Node model for async nodes. This model is intended to replace all other
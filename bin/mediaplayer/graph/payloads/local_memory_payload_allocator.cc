@@ -4,23 +4,175 @@
 
 #include "garnet/bin/mediaplayer/graph/payloads/local_memory_payload_allocator.h"
 
+#include <algorithm>
+#include <cstdlib>
+
 #include <fbl/ref_ptr.h>
+#include "garnet/bin/mediaplayer/graph/formatting.h"
 #include "garnet/bin/mediaplayer/graph/payloads/payload_buffer.h"
 
 namespace media_player {
+namespace {
+
+// Returns the base-2 log of the largest power of two less than |value|, which
+// must be greater than 1.
+uint32_t Log2Below(uint64_t value) {
+  FXL_DCHECK(value > 1);
+  return 63 - __builtin_clzll(value - 1);
+}
+
+}  // namespace
 
 // static
 fbl::RefPtr<LocalMemoryPayloadAllocator> LocalMemoryPayloadAllocator::Create() {
   return fbl::MakeRefCounted<LocalMemoryPayloadAllocator>();
 }
 
+LocalMemoryPayloadAllocator::~LocalMemoryPayloadAllocator() {
+  std::lock_guard<std::mutex> locker(mutex_);
+  FXL_DCHECK(stats_.outstanding_buffers == 0);
+
+  for (auto& free_list : free_lists_) {
+    for (void* block : free_list) {
+      std::free(block);
+    }
+  }
+}
+
+// static
+uint64_t LocalMemoryPayloadAllocator::SizeClass(uint64_t size) {
+  uint64_t aligned_size = PayloadBuffer::AlignUp(size);
+  if (aligned_size <= kMinClassSize) {
+    return kMinClassSize;
+  }
+
+  if (aligned_size > kMaxClassSize) {
+    return aligned_size;
+  }
+
+  // |aligned_size| is in (2^n, 2^(n+1)]. Round it up to the next multiple of
+  // 2^n / |kClassesPerDoubling|.
+  uint64_t step = (1ull << Log2Below(aligned_size)) / kClassesPerDoubling;
+  return (aligned_size + step - 1) & ~(step - 1);
+}
+
+// static
+size_t LocalMemoryPayloadAllocator::ClassIndex(uint64_t class_size) {
+  FXL_DCHECK(class_size == SizeClass(class_size));
+  FXL_DCHECK(class_size <= kMaxClassSize);
+
+  if (class_size <= kMinClassSize) {
+    return 0;
+  }
+
+  uint32_t log2 = Log2Below(class_size);
+  uint64_t step = (1ull << log2) / kClassesPerDoubling;
+  size_t index = (log2 - kMinClassSizeLog2) * kClassesPerDoubling +
+                 (class_size - (1ull << log2)) / step;
+  FXL_DCHECK(index < kClassCount);
+  return index;
+}
+
+LocalMemoryPayloadAllocator::Stats LocalMemoryPayloadAllocator::stats() const {
+  std::lock_guard<std::mutex> locker(mutex_);
+  return stats_;
+}
+
 void LocalMemoryPayloadAllocator::Dump(std::ostream& os) const {
-  os << "no report (not tracking allocations)";
+  Stats stats = this->stats();
+
+  os << fostr::Indent;
+  os << fostr::NewLine << "pool allocations:    " << stats.pool_allocations;
+  os << fostr::NewLine << "system allocations:  " << stats.system_allocations;
+  os << fostr::NewLine << "failed allocations:  " << stats.failed_allocations;
+  os << fostr::NewLine << "recycled:            " << stats.recycled;
+  os << fostr::NewLine << "released to system:  " << stats.released_to_system;
+  os << fostr::NewLine << "outstanding buffers: " << stats.outstanding_buffers;
+  os << fostr::NewLine << "outstanding bytes:   " << stats.outstanding_bytes;
+  os << fostr::NewLine << "peak outstanding:    "
+     << stats.peak_outstanding_bytes;
+  os << fostr::NewLine << "cached bytes:        " << stats.cached_bytes;
+  os << fostr::Outdent;
 }
 
 fbl::RefPtr<PayloadBuffer> LocalMemoryPayloadAllocator::AllocatePayloadBuffer(
     uint64_t size) {
-  return PayloadBuffer::CreateWithMalloc(size);
+  FXL_DCHECK(size > 0);
+
+  uint64_t class_size = SizeClass(size);
+  void* data = nullptr;
+
+  {
+    std::lock_guard<std::mutex> locker(mutex_);
+    if (class_size <= kMaxClassSize) {
+      std::vector<void*>& free_list = free_lists_[ClassIndex(class_size)];
+      if (!free_list.empty()) {
+        data = free_list.back();
+        free_list.pop_back();
+        stats_.cached_bytes -= class_size;
+        ++stats_.pool_allocations;
+        OnAllocated(class_size);
+      }
+    }
+  }
+
+  if (data == nullptr) {
+    // |aligned_alloc| requires the size to be a multiple of the alignment,
+    // which all size classes are.
+    data = aligned_alloc(PayloadBuffer::kByteAlignment, class_size);
+
+    std::lock_guard<std::mutex> locker(mutex_);
+    if (data == nullptr) {
+      ++stats_.failed_allocations;
+      return nullptr;
+    }
+
+    ++stats_.system_allocations;
+    OnAllocated(class_size);
+  }
+
+  // The recycler holds a reference to this allocator, so the allocator
+  // outlives all the buffers it allocates.
+  return PayloadBuffer::Create(
+      size, data,
+      [self = fbl::RefPtr<LocalMemoryPayloadAllocator>(this),
+       class_size](PayloadBuffer* payload_buffer) {
+        self->Recycle(payload_buffer, class_size);
+        // The |PayloadBuffer| deletes itself.
+      });
+}
+
+void LocalMemoryPayloadAllocator::OnAllocated(uint64_t class_size) {
+  ++stats_.outstanding_buffers;
+  stats_.outstanding_bytes += class_size;
+  stats_.peak_outstanding_bytes =
+      std::max(stats_.peak_outstanding_bytes, stats_.outstanding_bytes);
+}
+
+void LocalMemoryPayloadAllocator::Recycle(PayloadBuffer* payload_buffer,
+                                          uint64_t class_size) {
+  FXL_DCHECK(payload_buffer);
+
+  void* data = payload_buffer->data();
+
+  {
+    std::lock_guard<std::mutex> locker(mutex_);
+    FXL_DCHECK(stats_.outstanding_buffers != 0);
+    --stats_.outstanding_buffers;
+    stats_.outstanding_bytes -= class_size;
+
+    if (class_size <= kMaxClassSize &&
+        stats_.cached_bytes + class_size <= kMaxCachedBytes) {
+      free_lists_[ClassIndex(class_size)].push_back(data);
+      stats_.cached_bytes += class_size;
+      ++stats_.recycled;
+      return;
+    }
+
+    ++stats_.released_to_system;
+  }
+
+  std::free(data);
 }
 
 }  // namespace media_player
@@ -7,26 +7,103 @@
 
 #include "garnet/bin/mediaplayer/graph/payloads/payload_allocator.h"
 
+#include <array>
+#include <mutex>
+#include <vector>
+
 #include <fbl/ref_counted.h>
 #include <fbl/ref_ptr.h>
 
+#include "lib/fxl/synchronization/thread_annotations.h"
+
 namespace media_player {
 
+// Allocates payload buffers from process memory.
+//
+// Memory is handed out in size classes, four per doubling of size. When a
+// payload buffer is released, its memory goes onto a free list for its size
+// class rather than back to the system, so a stage producing a steady stream
+// of similarly-sized payloads stops touching the system allocator after the
+// first few. Each connector has its own allocator, so the free lists act as a
+// per-stage cache. Up to |kMaxCachedBytes| of free memory is retained.
+//
+// Allocation and recycling may occur on any thread.
 class LocalMemoryPayloadAllocator
     : public PayloadAllocator,
       public fbl::RefCounted<LocalMemoryPayloadAllocator> {
  public:
+  // Payloads no larger than this share the smallest size class.
+  static constexpr uint32_t kMinClassSizeLog2 = 8;
+  static constexpr uint64_t kMinClassSize = 1ull << kMinClassSizeLog2;
+
+  // Payloads larger than this are allocated from and returned to the system
+  // directly.
+  static constexpr uint32_t kMaxClassSizeLog2 = 26;
+  static constexpr uint64_t kMaxClassSize = 1ull << kMaxClassSizeLog2;
+
+  static constexpr size_t kClassesPerDoubling = 4;
+
+  // One class for everything up to |kMinClassSize| and |kClassesPerDoubling|
+  // for each doubling after that, up to |kMaxClassSize|.
+  static constexpr size_t kClassCount =
+      1 + kClassesPerDoubling * (kMaxClassSizeLog2 - kMinClassSizeLog2);
+
+  // The maximum number of bytes retained on the free lists.
+  static constexpr uint64_t kMaxCachedBytes = 32 * 1024 * 1024;
+
+  struct Stats {
+    // Allocations satisfied from the free lists.
+    uint64_t pool_allocations = 0;
+    // Allocations that went to the system allocator.
+    uint64_t system_allocations = 0;
+    // Failed allocations.
+    uint64_t failed_allocations = 0;
+    // Buffers whose memory went onto a free list when released.
+    uint64_t recycled = 0;
+    // Buffers whose memory went back to the system when released.
+    uint64_t released_to_system = 0;
+    uint64_t outstanding_buffers = 0;
+    uint64_t outstanding_bytes = 0;
+    uint64_t peak_outstanding_bytes = 0;
+    uint64_t cached_bytes = 0;
+  };
+
   static fbl::RefPtr<LocalMemoryPayloadAllocator> Create();
 
   LocalMemoryPayloadAllocator() = default;
 
-  ~LocalMemoryPayloadAllocator() override = default;
+  ~LocalMemoryPayloadAllocator() override;
+
+  // Returns the size of the memory block used for a payload of |size| bytes.
+  static uint64_t SizeClass(uint64_t size);
+
+  // Returns the index of the free list for blocks of |class_size| bytes,
+  // which must be a value returned by |SizeClass| no larger than
+  // |kMaxClassSize|.
+  static size_t ClassIndex(uint64_t class_size);
+
+  // Returns a snapshot of this allocator's statistics.
+  Stats stats() const;
 
   // Dumps this |LocalMemoryPayloadAllocator|'s state to |os|.
   void Dump(std::ostream& os) const;
 
   // PayloadAllocator implementation.
   fbl::RefPtr<PayloadBuffer> AllocatePayloadBuffer(uint64_t size) override;
+
+ private:
+  // Updates stats for a successful allocation of a |class_size| block.
+  void OnAllocated(uint64_t class_size) FXL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // Takes back the memory for |payload_buffer|, which was allocated in a
+  // block of |class_size| bytes.
+  void Recycle(PayloadBuffer* payload_buffer, uint64_t class_size)
+      FXL_LOCKS_EXCLUDED(mutex_);
+
+  mutable std::mutex mutex_;
+  std::array<std::vector<void*>, kClassCount> free_lists_
+      FXL_GUARDED_BY(mutex_);
+  Stats stats_ FXL_GUARDED_BY(mutex_);
 };
 
 }  // namespace media_player
@@ -113,29 +113,37 @@ bool PayloadManager::ready() const {
 
 fbl::RefPtr<PayloadBuffer> PayloadManager::AllocatePayloadBufferForOutput(
     uint64_t size) const {
-  std::lock_guard<std::mutex> locker(mutex_);
-  FXL_DCHECK(ready_locked());
-  FXL_DCHECK(output_.config_.mode_ != PayloadMode::kProvidesLocalMemory);
+  fbl::RefPtr<LocalMemoryPayloadAllocator> local_memory_allocator;
 
-  PayloadAllocator* allocator = output_.payload_allocator();
+  {
+    std::lock_guard<std::mutex> locker(mutex_);
+    FXL_DCHECK(ready_locked());
+    FXL_DCHECK(output_.config_.mode_ != PayloadMode::kProvidesLocalMemory);
 
-  if (allocate_callback_ && allocator == nullptr) {
-    // The input side has provided a callback to do the actual allocation.
-    // We know this applies to allocation for output rather than for copies,
-    // because there is no allocator associated with the output (|allocator| is
-    // null).
-    return AllocateUsingAllocateCallback(size);
-  }
+    PayloadAllocator* allocator = output_.payload_allocator();
 
-  // If there is no allocator associated with the output, the output is sharing
-  // the allocator associated with the input.
-  if (allocator == nullptr) {
-    allocator = input_.payload_allocator();
-  }
+    if (allocate_callback_ && allocator == nullptr) {
+      // The input side has provided a callback to do the actual allocation.
+      // We know this applies to allocation for output rather than for copies,
+      // because there is no allocator associated with the output (|allocator|
+      // is null).
+      return AllocateUsingAllocateCallback(size);
+    }
 
-  FXL_DCHECK(allocator);
+    // If there is no allocator associated with the output, the output is
+    // sharing the allocator associated with the input.
+    const Connector& connector = allocator ? output_ : input_;
+    if (!connector.local_memory_allocator_) {
+      FXL_DCHECK(connector.payload_allocator());
+      return connector.payload_allocator()->AllocatePayloadBuffer(size);
+    }
+
+    local_memory_allocator = connector.local_memory_allocator_;
+  }
 
-  return allocator->AllocatePayloadBuffer(size);
+  // Local memory allocators do their own locking, and the reference we hold
+  // keeps this one alive, so we don't need to hold |mutex_| while allocating.
+  return local_memory_allocator->AllocatePayloadBuffer(size);
 }
 
 PayloadVmos& PayloadManager::input_vmos() const {
@@ -195,32 +203,46 @@ bool PayloadManager::MaybeAllocatePayloadBufferForCopy(
     uint64_t size, fbl::RefPtr<PayloadBuffer>* payload_buffer_out) const {
   FXL_DCHECK(payload_buffer_out || (size == 0));
 
-  std::lock_guard<std::mutex> locker(mutex_);
-  FXL_DCHECK(ready_locked());
+  fbl::RefPtr<LocalMemoryPayloadAllocator> local_memory_allocator;
 
-  if (!copy_) {
-    // Don't need to copy.
-    return false;
-  }
+  {
+    std::lock_guard<std::mutex> locker(mutex_);
+    FXL_DCHECK(ready_locked());
+
+    if (!copy_) {
+      // Don't need to copy.
+      return false;
+    }
 
-  FXL_DCHECK(input_.payload_allocator());
+    FXL_DCHECK(input_.payload_allocator());
 
-  if (size == 0) {
-    // Need to copy, but the size is zero, so we don't need a destination
-    // buffer.
-    *payload_buffer_out = nullptr;
-    return true;
-  }
+    if (size == 0) {
+      // Need to copy, but the size is zero, so we don't need a destination
+      // buffer.
+      *payload_buffer_out = nullptr;
+      return true;
+    }
+
+    if (allocate_callback_) {
+      // The input side has provided a callback to do the actual allocation.
+      // We'll use that.
+      *payload_buffer_out = AllocateUsingAllocateCallback(size);
+      return true;
+    }
+
+    if (!input_.local_memory_allocator_) {
+      // Allocate from the input's allocator.
+      *payload_buffer_out =
+          input_.payload_allocator()->AllocatePayloadBuffer(size);
+      return true;
+    }
 
-  if (allocate_callback_) {
-    // The input side has provided a callback to do the actual allocation.
-    // We'll use that.
-    *payload_buffer_out = AllocateUsingAllocateCallback(size);
-    return true;
+    local_memory_allocator = input_.local_memory_allocator_;
   }
 
-  // Allocate from the input's allocator.
-  *payload_buffer_out = input_.payload_allocator()->AllocatePayloadBuffer(size);
+  // As in |AllocatePayloadBufferForOutput|, we allocate local memory without
+  // holding |mutex_|.
+  *payload_buffer_out = local_memory_allocator->AllocatePayloadBuffer(size);
   return true;
 }
 
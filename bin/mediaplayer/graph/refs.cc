@@ -49,6 +49,10 @@ GenericNode* NodeRef::GetGenericNode() {
   return stage_ ? stage_->GetGenericNode() : nullptr;
 }
 
+StageMetrics* NodeRef::metrics() const {
+  return stage_ ? &stage_->metrics() : nullptr;
+}
+
 NodeRef InputRef::node() const {
   return input_ ? NodeRef(input_->stage()) : NodeRef();
 }
@@ -17,6 +17,7 @@ class Engine;
 class InputRef;
 class OutputRef;
 class GenericNode;
+class StageMetrics;
 
 // Opaque Stage pointer used for graph building.
 class NodeRef {
@@ -54,6 +55,9 @@ class NodeRef {
   // Gets the actual node referenced by this |NodeRef|.
   GenericNode* GetGenericNode();
 
+  // Gets the performance counters for the referenced node.
+  StageMetrics* metrics() const;
+
   bool operator==(const NodeRef& other) const { return stage_ == other.stage_; }
   bool operator!=(const NodeRef& other) const { return stage_ != other.stage_; }
 
@@ -4,7 +4,10 @@
 
 #include "garnet/bin/mediaplayer/graph/stages/async_node_stage.h"
 
+#include <trace/event.h>
+
 #include "garnet/bin/mediaplayer/graph/formatting.h"
+#include "lib/media/timeline/timeline.h"
 
 namespace media_player {
 namespace {
@@ -87,6 +90,8 @@ void AsyncNodeStageImpl::Dump(std::ostream& os) const {
       DumpOutputDetail(os, output);
     }
   }
+
+  os << fostr::NewLine << "metrics:        " << metrics().snapshot();
 }
 
 void AsyncNodeStageImpl::DumpInputDetail(std::ostream& os,
@@ -131,8 +136,8 @@ void AsyncNodeStageImpl::DumpOutputDetail(std::ostream& os,
   if (!packets.empty()) {
     os << fostr::NewLine << "queued packets:" << fostr::Indent;
 
-    for (auto& packet : packets) {
-      os << fostr::NewLine << packet;
+    for (auto& queued_packet : packets) {
+      os << fostr::NewLine << queued_packet.packet_;
     }
 
     os << fostr::Outdent;
@@ -193,9 +198,14 @@ void AsyncNodeStageImpl::Update() {
   FXL_DCHECK_CREATION_THREAD_IS_CURRENT(thread_checker_);
   FXL_DCHECK(node_);
 
+  // Only the time spent in the node's callbacks counts as processing. Time
+  // spent waiting for downstream demand doesn't.
   for (auto& input : inputs_) {
     if (input.packet()) {
+      TRACE_DURATION("motown", "PutInputPacket", "stage", node_->label());
+      int64_t start_time = media::Timeline::local_now();
       node_->PutInputPacket(input.TakePacket(false), input.index());
+      metrics().AddProcessing(media::Timeline::local_now() - start_time);
     }
   }
 
@@ -217,7 +227,10 @@ void AsyncNodeStageImpl::Update() {
   }
 
   if (request_packet) {
+    TRACE_DURATION("motown", "RequestOutputPacket", "stage", node_->label());
+    int64_t start_time = media::Timeline::local_now();
     node_->RequestOutputPacket();
+    metrics().AddProcessing(media::Timeline::local_now() - start_time);
   }
 }
 
@@ -233,7 +246,7 @@ bool AsyncNodeStageImpl::MaybeTakePacketForOutput(const Output& output,
   bool request_packet = false;
 
   std::lock_guard<std::mutex> locker(packets_per_output_mutex_);
-  std::deque<PacketPtr>& packets = packets_per_output_[output.index()];
+  std::deque<QueuedPacket>& packets = packets_per_output_[output.index()];
 
   if (packets.empty()) {
     // The output needs a packet and has no packets queued. Request another
@@ -241,8 +254,11 @@ bool AsyncNodeStageImpl::MaybeTakePacketForOutput(const Output& output,
     request_packet = true;
   } else {
     // The output has demand and packets queued.
-    *packet_out = std::move(packets.front());
+    *packet_out = std::move(packets.front().packet_);
+    int64_t queued_time = packets.front().time_;
     packets.pop_front();
+    metrics().AddOutputWait(media::Timeline::local_now() - queued_time,
+                            output.index(), packets.size());
   }
 
   return request_packet;
@@ -274,6 +290,8 @@ void AsyncNodeStageImpl::FlushOutput(size_t output_index,
       while (!packets.empty()) {
         packets.pop_front();
       }
+
+      metrics().OnQueueDepthChanged(output_index, 0);
     }
 
     PostTask(std::move(callback));
@@ -518,7 +536,17 @@ fbl::RefPtr<PayloadBuffer> AsyncNodeStageImpl::AllocatePayloadBuffer(
   FXL_DCHECK(output.connected());
   FXL_DCHECK(output.mate()->payload_manager().ready());
 
-  return output.mate()->payload_manager().AllocatePayloadBufferForOutput(size);
+  TRACE_DURATION("motown", "AllocatePayloadBuffer", "stage", node_->label(),
+                 "size", size);
+  int64_t start_time = media::Timeline::local_now();
+
+  fbl::RefPtr<PayloadBuffer> payload_buffer =
+      output.mate()->payload_manager().AllocatePayloadBufferForOutput(size);
+
+  metrics().AddPayloadWait(media::Timeline::local_now() - start_time,
+                           !!payload_buffer);
+
+  return payload_buffer;
 }
 
 const PayloadVmos& AsyncNodeStageImpl::UseOutputVmos(
@@ -558,12 +586,22 @@ void AsyncNodeStageImpl::PutOutputPacket(PacketPtr packet,
   // packet.
   if (outputs_[output_index].connected()) {
     std::lock_guard<std::mutex> locker(packets_per_output_mutex_);
-    packets_per_output_[output_index].push_back(std::move(packet));
+    auto& packets = packets_per_output_[output_index];
+    packets.push_back({std::move(packet), media::Timeline::local_now()});
+    metrics().OnQueueDepthChanged(output_index, packets.size());
+    TRACE_COUNTER("motown", "OutputQueueDepth",
+                  reinterpret_cast<uint64_t>(&outputs_[output_index]),
+                  "depth", static_cast<uint64_t>(packets.size()));
   }
 
   NeedsUpdate();
 }
 
+void AsyncNodeStageImpl::ReportProcessing(int64_t duration) {
+  // This method runs on an arbitrary thread.
+  metrics().AddProcessing(duration);
+}
+
 void AsyncNodeStageImpl::EnsureInput(size_t input_index) {
   FXL_DCHECK_CREATION_THREAD_IS_CURRENT(thread_checker_);
 
@@ -111,6 +111,8 @@ class AsyncNodeStageImpl : public AsyncNodeStage, public StageImpl {
 
   void PutOutputPacket(PacketPtr packet, size_t output_index = 0) override;
 
+  void ReportProcessing(int64_t duration) override;
+
   // Takes a packet from the queue for |output| if that queue isn't empty and
   // the output needs a packet. Returns true if and only if the queue is empty
   // and the output needs a packet.
@@ -134,8 +136,14 @@ class AsyncNodeStageImpl : public AsyncNodeStage, public StageImpl {
   std::vector<Input> inputs_;
   std::vector<Output> outputs_;
 
+  // A packet queued for an output and the time at which it was queued.
+  struct QueuedPacket {
+    PacketPtr packet_;
+    int64_t time_;
+  };
+
   mutable std::mutex packets_per_output_mutex_;
-  std::vector<std::deque<PacketPtr>> packets_per_output_
+  std::vector<std::deque<QueuedPacket>> packets_per_output_
       FXL_GUARDED_BY(packets_per_output_mutex_);
 };
 
@@ -6,7 +6,10 @@
 
 #include "garnet/bin/mediaplayer/graph/stages/input.h"
 
+#include <trace/event.h>
+
 #include "garnet/bin/mediaplayer/graph/stages/stage_impl.h"
+#include "lib/media/timeline/timeline.h"
 
 namespace media_player {
 namespace {
@@ -34,14 +37,18 @@ PacketPtr CopyPacket(const Packet& original,
 }  // namespace
 
 Input::Input(StageImpl* stage, size_t index)
-    : stage_(stage), index_(index), state_(State::kRefusesPacket) {
+    : stage_(stage),
+      index_(index),
+      state_(State::kRefusesPacket),
+      request_time_(0) {
   FXL_DCHECK(stage_);
 }
 
 Input::Input(Input&& input)
     : stage_(input.stage()),
       index_(input.index()),
-      state_(input.state_.load()) {
+      state_(input.state_.load()),
+      request_time_(input.request_time_.load()) {
   // We can't move an input that's connected, has a packet or is configured.
   // TODO(dalesat): Make |Input| non-movable.
   FXL_DCHECK(input.mate() == nullptr);
@@ -65,6 +72,14 @@ void Input::PutPacket(PacketPtr packet) {
   FXL_DCHECK(packet);
   FXL_DCHECK(needs_packet());
 
+  int64_t request_time = request_time_.exchange(0);
+  if (request_time != 0) {
+    stage_->metrics().AddInputWait(media::Timeline::local_now() -
+                                   request_time);
+    TRACE_ASYNC_END("motown", "WaitForInput",
+                    reinterpret_cast<uint64_t>(this));
+  }
+
   std::atomic_store(&packet_, packet);
   state_.store(State::kHasPacket);
   stage_->NeedsUpdate();
@@ -77,6 +92,7 @@ PacketPtr Input::TakePacket(bool request_another) {
   PacketPtr packet = std::atomic_exchange(&packet_, no_packet);
 
   if (request_another) {
+    OnPacketRequested();
     state_.store(State::kNeedsPacket);
     mate_->stage()->NeedsUpdate();
   } else {
@@ -122,10 +138,26 @@ void Input::RequestPacket() {
 
   State expected = State::kRefusesPacket;
   if (state_.compare_exchange_strong(expected, State::kNeedsPacket)) {
+    OnPacketRequested();
     mate_->stage()->NeedsUpdate();
   }
 }
 
-void Input::Flush() { TakePacket(false); }
+void Input::Flush() {
+  TakePacket(false);
+
+  // The wait for a flushed packet doesn't count.
+  if (request_time_.exchange(0) != 0) {
+    TRACE_ASYNC_END("motown", "WaitForInput",
+                    reinterpret_cast<uint64_t>(this));
+  }
+}
+
+void Input::OnPacketRequested() {
+  request_time_.store(media::Timeline::local_now());
+  TRACE_ASYNC_BEGIN("motown", "WaitForInput", reinterpret_cast<uint64_t>(this),
+                    "stage", stage_->GetGenericNode()->label(), "input",
+                    static_cast<uint64_t>(index_));
+}
 
 }  // namespace media_player
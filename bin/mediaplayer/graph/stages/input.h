@@ -76,6 +76,9 @@ class Input {
  private:
   enum class State { kNeedsPacket, kRefusesPacket, kHasPacket };
 
+  // Records that this input has started needing a packet.
+  void OnPacketRequested();
+
   StageImpl* stage_;
   size_t index_;
   Output* mate_ = nullptr;
@@ -83,6 +86,10 @@ class Input {
   std::atomic<State> state_;
   PayloadConfig payload_config_;
   PayloadManager payload_manager_;
+
+  // The time at which this input last started needing a packet or zero if
+  // it doesn't need one.
+  std::atomic<int64_t> request_time_;
 };
 
 }  // namespace media_player
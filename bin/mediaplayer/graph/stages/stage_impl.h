@@ -18,6 +18,7 @@
 #include "garnet/bin/mediaplayer/graph/payloads/payload_allocator.h"
 #include "garnet/bin/mediaplayer/graph/stages/input.h"
 #include "garnet/bin/mediaplayer/graph/stages/output.h"
+#include "garnet/bin/mediaplayer/graph/stages/stage_metrics.h"
 #include "lib/fxl/synchronization/thread_annotations.h"
 
 namespace media_player {
@@ -111,6 +112,10 @@ class StageImpl : public std::enable_shared_from_this<StageImpl> {
 
   void PostTask(fit::closure task);
 
+  // Returns the performance counters for this stage.
+  StageMetrics& metrics() { return metrics_; }
+  const StageMetrics& metrics() const { return metrics_; }
+
  protected:
   // Updates packet supply and demand.
   virtual void Update() = 0;
@@ -131,6 +136,8 @@ class StageImpl : public std::enable_shared_from_this<StageImpl> {
 
   async_dispatcher_t* dispatcher_;
 
+  StageMetrics metrics_;
+
   // Used for ensuring the stage is properly updated. This value is zero
   // initially, indicating that there's no need to update the stage. When the
   // stage needs updating, the counter is incremented. A transition from 0 to
@@ -0,0 +1,97 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "garnet/bin/mediaplayer/graph/stages/stage_metrics.h"
+
+#include <algorithm>
+
+#include "lib/media/timeline/timeline.h"
+
+namespace media_player {
+
+double StageMetrics::Snapshot::busy_fraction() const {
+  if (elapsed_ <= 0) {
+    return 0.0;
+  }
+
+  return static_cast<double>(processing_.total_ + payload_wait_.total_) /
+         elapsed_;
+}
+
+size_t StageMetrics::Snapshot::max_queue_depth() const {
+  size_t result = 0;
+  for (auto& queue : output_queues_) {
+    result = std::max(result, queue.max_depth_);
+  }
+
+  return result;
+}
+
+StageMetrics::StageMetrics() : start_time_(media::Timeline::local_now()) {}
+
+StageMetrics::~StageMetrics() {}
+
+void StageMetrics::AddInputWait(int64_t duration) {
+  std::lock_guard<std::mutex> locker(mutex_);
+  snapshot_.input_wait_.Add(duration);
+}
+
+void StageMetrics::AddProcessing(int64_t duration) {
+  std::lock_guard<std::mutex> locker(mutex_);
+  snapshot_.processing_.Add(duration);
+}
+
+void StageMetrics::OnQueueDepthChanged(size_t output_index,
+                                       size_t queue_depth) {
+  std::lock_guard<std::mutex> locker(mutex_);
+  OutputQueue& queue = output_queue(output_index);
+  queue.depth_ = queue_depth;
+  queue.max_depth_ = std::max(queue.max_depth_, queue_depth);
+}
+
+void StageMetrics::AddOutputWait(int64_t duration, size_t output_index,
+                                 size_t queue_depth) {
+  std::lock_guard<std::mutex> locker(mutex_);
+  snapshot_.output_wait_.Add(duration);
+  output_queue(output_index).depth_ = queue_depth;
+}
+
+void StageMetrics::AddPayloadWait(int64_t duration, bool succeeded) {
+  std::lock_guard<std::mutex> locker(mutex_);
+  snapshot_.payload_wait_.Add(duration);
+  if (!succeeded) {
+    ++snapshot_.payload_failures_;
+  }
+}
+
+StageMetrics::Snapshot StageMetrics::snapshot() const {
+  std::lock_guard<std::mutex> locker(mutex_);
+  Snapshot result = snapshot_;
+  result.elapsed_ = media::Timeline::local_now() - start_time_;
+  return result;
+}
+
+void StageMetrics::Reset() {
+  std::lock_guard<std::mutex> locker(mutex_);
+  std::vector<OutputQueue> output_queues = std::move(snapshot_.output_queues_);
+  snapshot_ = Snapshot();
+
+  // Packets queued now are still queued.
+  for (auto& queue : output_queues) {
+    queue.max_depth_ = queue.depth_;
+  }
+
+  snapshot_.output_queues_ = std::move(output_queues);
+  start_time_ = media::Timeline::local_now();
+}
+
+StageMetrics::OutputQueue& StageMetrics::output_queue(size_t output_index) {
+  if (snapshot_.output_queues_.size() <= output_index) {
+    snapshot_.output_queues_.resize(output_index + 1);
+  }
+
+  return snapshot_.output_queues_[output_index];
+}
+
+}  // namespace media_player
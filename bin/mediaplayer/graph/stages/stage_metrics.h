@@ -0,0 +1,114 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef GARNET_BIN_MEDIAPLAYER_GRAPH_STAGES_STAGE_METRICS_H_
+#define GARNET_BIN_MEDIAPLAYER_GRAPH_STAGES_STAGE_METRICS_H_
+
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+#include "lib/fxl/synchronization/thread_annotations.h"
+
+namespace media_player {
+
+// Accumulates durations in nanoseconds.
+struct DurationStats {
+  void Add(int64_t duration) {
+    ++count_;
+    total_ += duration;
+    if (max_ < duration) {
+      max_ = duration;
+    }
+  }
+
+  int64_t mean() const { return count_ == 0 ? 0 : total_ / count_; }
+
+  uint64_t count_ = 0;
+  int64_t total_ = 0;
+  int64_t max_ = 0;
+};
+
+// Performance counters for a stage. Inputs record how long they wait for
+// packets, the stage records how long its node spends doing work, outputs
+// record how deep their queues get and how long packets wait in them, and
+// payload allocation is timed. All methods are thread-safe.
+//
+// A stage that is the bottleneck for a stream has a high |busy_fraction|, and
+// its downstream neighbor spends most of its time waiting for input.
+class StageMetrics {
+ public:
+  // Current and maximum number of packets queued at an output.
+  struct OutputQueue {
+    size_t depth_ = 0;
+    size_t max_depth_ = 0;
+  };
+
+  struct Snapshot {
+    // Fraction of |elapsed_| spent processing packets or waiting for payload
+    // memory.
+    double busy_fraction() const;
+
+    // The largest |max_depth_| of any output queue.
+    size_t max_queue_depth() const;
+
+    // Time covered by this snapshot.
+    int64_t elapsed_ = 0;
+    // From an input requesting a packet to receiving one.
+    DurationStats input_wait_;
+    // Time spent in the node's work: in its packet callbacks on the graph
+    // thread, plus any time it reports for work done on its own threads.
+    // Time spent waiting for downstream demand isn't included.
+    DurationStats processing_;
+    // From a packet being queued at an output to its delivery downstream.
+    DurationStats output_wait_;
+    // Time spent in payload buffer allocation.
+    DurationStats payload_wait_;
+    uint64_t payload_failures_ = 0;
+    // Output queues by output index.
+    std::vector<OutputQueue> output_queues_;
+  };
+
+  StageMetrics();
+
+  ~StageMetrics();
+
+  // Records the time an input waited for a packet.
+  void AddInputWait(int64_t duration);
+
+  // Records time spent doing the stage's work.
+  void AddProcessing(int64_t duration);
+
+  // Records that the number of packets queued at the specified output has
+  // changed to |queue_depth| due to queueing or flushing.
+  void OnQueueDepthChanged(size_t output_index, size_t queue_depth);
+
+  // Records the time a packet waited in the specified output's queue, leaving
+  // |queue_depth| packets queued.
+  void AddOutputWait(int64_t duration, size_t output_index,
+                     size_t queue_depth);
+
+  // Records the time taken by a payload buffer allocation.
+  void AddPayloadWait(int64_t duration, bool succeeded);
+
+  // Returns the metrics accumulated since construction or the last |Reset|.
+  Snapshot snapshot() const;
+
+  // Discards accumulated metrics.
+  void Reset();
+
+ private:
+  // Returns the queue for the specified output, adding it if needed.
+  OutputQueue& output_queue(size_t output_index)
+      FXL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  mutable std::mutex mutex_;
+  int64_t start_time_ FXL_GUARDED_BY(mutex_);
+  Snapshot snapshot_ FXL_GUARDED_BY(mutex_);
+};
+
+}  // namespace media_player
+
+#endif  // GARNET_BIN_MEDIAPLAYER_GRAPH_STAGES_STAGE_METRICS_H_
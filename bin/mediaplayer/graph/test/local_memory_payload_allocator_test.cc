@@ -0,0 +1,111 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "garnet/bin/mediaplayer/graph/payloads/local_memory_payload_allocator.h"
+
+#include "garnet/bin/mediaplayer/graph/payloads/payload_buffer.h"
+#include "gtest/gtest.h"
+
+namespace media_player {
+namespace {
+
+using Allocator = LocalMemoryPayloadAllocator;
+
+// Tests that everything up to the minimum class size shares the first class.
+TEST(LocalMemoryPayloadAllocatorTest, SmallestClass) {
+  EXPECT_EQ(Allocator::kMinClassSize, Allocator::SizeClass(0));
+  EXPECT_EQ(Allocator::kMinClassSize, Allocator::SizeClass(1));
+  EXPECT_EQ(Allocator::kMinClassSize,
+            Allocator::SizeClass(Allocator::kMinClassSize));
+  EXPECT_EQ(0u, Allocator::ClassIndex(Allocator::kMinClassSize));
+
+  // One past the smallest class rounds up to the next one, a quarter of the
+  // way to the next doubling.
+  EXPECT_EQ(Allocator::kMinClassSize * 5 / 4,
+            Allocator::SizeClass(Allocator::kMinClassSize + 1));
+  EXPECT_EQ(1u, Allocator::ClassIndex(Allocator::kMinClassSize * 5 / 4));
+}
+
+// Tests sizes at and just past class boundaries in the middle of the range.
+TEST(LocalMemoryPayloadAllocatorTest, ClassBoundaries) {
+  EXPECT_EQ(1024u, Allocator::SizeClass(1000));
+  EXPECT_EQ(1024u, Allocator::SizeClass(1024));
+  EXPECT_EQ(1280u, Allocator::SizeClass(1025));
+  EXPECT_EQ(1280u, Allocator::SizeClass(1280));
+  EXPECT_EQ(1536u, Allocator::SizeClass(1281));
+  EXPECT_EQ(2048u, Allocator::SizeClass(1793));
+  EXPECT_EQ(2560u, Allocator::SizeClass(2049));
+
+  EXPECT_EQ(8u, Allocator::ClassIndex(1024));
+  EXPECT_EQ(9u, Allocator::ClassIndex(1280));
+  EXPECT_EQ(12u, Allocator::ClassIndex(2048));
+  EXPECT_EQ(13u, Allocator::ClassIndex(2560));
+}
+
+// Tests that the classes are contiguous: each class size is its own class, one
+// byte past it is the next class, and the indices run from 0 to
+// kClassCount - 1 without gaps.
+TEST(LocalMemoryPayloadAllocatorTest, EveryClass) {
+  size_t count = 1;
+  for (uint64_t class_size = Allocator::kMinClassSize;
+       class_size < Allocator::kMaxClassSize; ++count) {
+    EXPECT_EQ(class_size, Allocator::SizeClass(class_size));
+    EXPECT_EQ(class_size, Allocator::SizeClass(class_size - 1));
+
+    uint64_t next = Allocator::SizeClass(class_size + 1);
+    EXPECT_LT(class_size, next);
+    EXPECT_EQ(Allocator::ClassIndex(class_size) + 1,
+              Allocator::ClassIndex(next));
+
+    // No class wastes more than a quarter of the block.
+    EXPECT_GE((class_size + 1) * 5 / 4 + PayloadBuffer::kByteAlignment, next);
+
+    class_size = next;
+  }
+
+  EXPECT_EQ(Allocator::kClassCount, count);
+}
+
+// Tests the largest class, and that sizes past it are only aligned.
+TEST(LocalMemoryPayloadAllocatorTest, LargestClass) {
+  EXPECT_EQ(Allocator::kMaxClassSize,
+            Allocator::SizeClass(Allocator::kMaxClassSize));
+  EXPECT_EQ(Allocator::kClassCount - 1,
+            Allocator::ClassIndex(Allocator::kMaxClassSize));
+
+  EXPECT_EQ(Allocator::kMaxClassSize + PayloadBuffer::kByteAlignment,
+            Allocator::SizeClass(Allocator::kMaxClassSize + 1));
+  EXPECT_EQ(Allocator::kMaxClassSize * 3,
+            Allocator::SizeClass(Allocator::kMaxClassSize * 3));
+}
+
+// Tests that a released buffer's memory is reused for a payload in the same
+// class.
+TEST(LocalMemoryPayloadAllocatorTest, Recycles) {
+  fbl::RefPtr<Allocator> allocator = Allocator::Create();
+
+  fbl::RefPtr<PayloadBuffer> buffer = allocator->AllocatePayloadBuffer(1000);
+  ASSERT_TRUE(buffer);
+  void* data = buffer->data();
+  buffer = nullptr;
+
+  buffer = allocator->AllocatePayloadBuffer(1024);
+  ASSERT_TRUE(buffer);
+  EXPECT_EQ(data, buffer->data());
+
+  // The next class up gets a new block.
+  fbl::RefPtr<PayloadBuffer> other = allocator->AllocatePayloadBuffer(1025);
+  ASSERT_TRUE(other);
+
+  Allocator::Stats stats = allocator->stats();
+  EXPECT_EQ(1u, stats.pool_allocations);
+  EXPECT_EQ(2u, stats.system_allocations);
+  EXPECT_EQ(1u, stats.recycled);
+  EXPECT_EQ(2u, stats.outstanding_buffers);
+  EXPECT_EQ(1024u + 1280u, stats.outstanding_bytes);
+  EXPECT_EQ(0u, stats.cached_bytes);
+}
+
+}  // namespace
+}  // namespace media_player
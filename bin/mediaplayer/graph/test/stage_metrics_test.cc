@@ -0,0 +1,185 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "garnet/bin/mediaplayer/graph/stages/stage_metrics.h"
+
+#include <lib/zx/time.h>
+
+#include "garnet/bin/mediaplayer/graph/graph.h"
+#include "garnet/bin/mediaplayer/graph/models/async_node.h"
+#include "gtest/gtest.h"
+#include "lib/gtest/test_loop_fixture.h"
+
+namespace media_player {
+namespace {
+
+// Tests that busy_fraction counts processing and payload allocation, but not
+// time spent waiting for input or in output queues.
+TEST(StageMetricsTest, BusyFraction) {
+  StageMetrics::Snapshot snapshot;
+  EXPECT_EQ(0.0, snapshot.busy_fraction());
+
+  snapshot.elapsed_ = 1000;
+  snapshot.processing_.Add(200);
+  snapshot.payload_wait_.Add(50);
+  snapshot.input_wait_.Add(500);
+  snapshot.output_wait_.Add(700);
+  EXPECT_EQ(0.25, snapshot.busy_fraction());
+}
+
+// Tests that queue depth is tracked separately for each output.
+TEST(StageMetricsTest, QueueDepthPerOutput) {
+  StageMetrics metrics;
+  metrics.OnQueueDepthChanged(0, 1);
+  metrics.OnQueueDepthChanged(0, 3);
+  metrics.OnQueueDepthChanged(2, 1);
+  metrics.AddOutputWait(10, 0, 2);
+
+  StageMetrics::Snapshot snapshot = metrics.snapshot();
+  ASSERT_EQ(3u, snapshot.output_queues_.size());
+  EXPECT_EQ(2u, snapshot.output_queues_[0].depth_);
+  EXPECT_EQ(3u, snapshot.output_queues_[0].max_depth_);
+  EXPECT_EQ(0u, snapshot.output_queues_[1].depth_);
+  EXPECT_EQ(0u, snapshot.output_queues_[1].max_depth_);
+  EXPECT_EQ(1u, snapshot.output_queues_[2].depth_);
+  EXPECT_EQ(1u, snapshot.output_queues_[2].max_depth_);
+  EXPECT_EQ(3u, snapshot.max_queue_depth());
+  EXPECT_EQ(1u, snapshot.output_wait_.count_);
+}
+
+// Tests that Reset discards the counters but not the packets still queued.
+TEST(StageMetricsTest, Reset) {
+  StageMetrics metrics;
+  metrics.AddInputWait(100);
+  metrics.AddProcessing(200);
+  metrics.AddPayloadWait(300, false);
+  metrics.OnQueueDepthChanged(0, 4);
+  metrics.AddOutputWait(10, 0, 2);
+
+  metrics.Reset();
+
+  StageMetrics::Snapshot snapshot = metrics.snapshot();
+  EXPECT_EQ(0u, snapshot.input_wait_.count_);
+  EXPECT_EQ(0u, snapshot.processing_.count_);
+  EXPECT_EQ(0u, snapshot.payload_wait_.count_);
+  EXPECT_EQ(0u, snapshot.payload_failures_);
+  EXPECT_EQ(0u, snapshot.output_wait_.count_);
+  ASSERT_EQ(1u, snapshot.output_queues_.size());
+  EXPECT_EQ(2u, snapshot.output_queues_[0].depth_);
+  EXPECT_EQ(2u, snapshot.output_queues_[0].max_depth_);
+}
+
+// Produces a packet with no payload whenever one is requested.
+class TestSource : public AsyncNode {
+ public:
+  const char* label() const override { return "TestSource"; }
+
+  void ConfigureConnectors() override {
+    stage()->ConfigureOutputToProvideLocalMemory();
+  }
+
+  void FlushOutput(size_t output_index, fit::closure callback) override {
+    callback();
+  }
+
+  void RequestOutputPacket() override {
+    stage()->PutOutputPacket(Packet::Create(pts_++, media::TimelineRate(1, 1),
+                                            true, false, 0, nullptr));
+  }
+
+ private:
+  int64_t pts_ = 0;
+};
+
+// Passes packets through, requesting input only when its output needs a
+// packet.
+class TestTransform : public AsyncNode {
+ public:
+  const char* label() const override { return "TestTransform"; }
+
+  void ConfigureConnectors() override {
+    stage()->ConfigureInputToUseLocalMemory(1,    // max_aggregate_payload_size
+                                            0);   // max_payload_count
+    stage()->ConfigureOutputToUseLocalMemory(1,   // max_aggregate_payload_size
+                                             0,   // max_payload_count
+                                             0);  // max_payload_size
+  }
+
+  void FlushInput(bool hold_frame, size_t input_index,
+                  fit::closure callback) override {
+    callback();
+  }
+
+  void FlushOutput(size_t output_index, fit::closure callback) override {
+    callback();
+  }
+
+  void PutInputPacket(PacketPtr packet, size_t input_index) override {
+    stage()->PutOutputPacket(std::move(packet));
+  }
+
+  void RequestOutputPacket() override { stage()->RequestInputPacket(); }
+};
+
+// Takes one packet each time |Request| is called.
+class TestSink : public AsyncNode {
+ public:
+  const char* label() const override { return "TestSink"; }
+
+  size_t packets_received() const { return packets_received_; }
+
+  void Request() { stage()->RequestInputPacket(); }
+
+  void ConfigureConnectors() override {
+    stage()->ConfigureInputToUseLocalMemory(1,   // max_aggregate_payload_size
+                                            0);  // max_payload_count
+  }
+
+  void FlushInput(bool hold_frame, size_t input_index,
+                  fit::closure callback) override {
+    callback();
+  }
+
+  void PutInputPacket(PacketPtr packet, size_t input_index) override {
+    ++packets_received_;
+  }
+
+ private:
+  size_t packets_received_ = 0;
+};
+
+class StageMetricsGraphTest : public ::gtest::TestLoopFixture {};
+
+// Tests that a stage that can't proceed because its downstream neighbor isn't
+// asking for packets isn't counted as busy during the wait.
+TEST_F(StageMetricsGraphTest, BackpressureIsNotProcessing) {
+  Graph graph(dispatcher());
+  auto source = std::make_shared<TestSource>();
+  auto transform = std::make_shared<TestTransform>();
+  auto sink = std::make_shared<TestSink>();
+  NodeRef transform_node = graph.Add(transform);
+  graph.ConnectNodes(graph.Add(source), transform_node);
+  graph.ConnectNodes(transform_node, graph.Add(sink));
+  RunLoopUntilIdle();
+
+  sink->Request();
+  RunLoopUntilIdle();
+  EXPECT_EQ(1u, sink->packets_received());
+
+  // The sink holds up the stream for a while.
+  constexpr zx::duration kStall = zx::msec(50);
+  zx::nanosleep(zx::deadline_after(kStall));
+
+  sink->Request();
+  RunLoopUntilIdle();
+  EXPECT_EQ(2u, sink->packets_received());
+
+  StageMetrics::Snapshot snapshot = transform_node.metrics()->snapshot();
+  EXPECT_NE(0u, snapshot.processing_.count_);
+  EXPECT_GT(kStall.get() / 2, snapshot.processing_.total_);
+  EXPECT_GT(kStall.get() / 2, snapshot.processing_.max_);
+}
+
+}  // namespace
+}  // namespace media_player
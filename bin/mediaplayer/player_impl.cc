@@ -300,7 +300,8 @@ void PlayerImpl::Update() {
           state_ = State::kWaiting;
           waiting_reason_ = "for renderers to start progressing";
           SetTimelineFunction(
-              1.0f, media::Timeline::local_now() + kMinimumLeadTime, [this]() {
+              1.0f, media::Timeline::local_now() + core_.min_lead_time(),
+              [this]() {
                 state_ = State::kPlaying;
                 Update();
               });
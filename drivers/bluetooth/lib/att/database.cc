@@ -14,17 +14,20 @@ namespace btlib {
 namespace att {
 namespace {
 
-bool StartLessThan(const AttributeGrouping& grp, const Handle handle) {
-  return grp.start_handle() < handle;
+template <typename GroupingIter>
+bool StartLessThan(const GroupingIter& grp, const Handle handle) {
+  return grp->start_handle() < handle;
 }
 
-bool EndLessThan(const AttributeGrouping& grp, const Handle handle) {
-  return grp.end_handle() < handle;
+template <typename GroupingIter>
+bool EndLessThan(const GroupingIter& grp, const Handle handle) {
+  return grp->end_handle() < handle;
 }
 
 }  // namespace
 
 Database::Iterator::Iterator(GroupingList* list,
+                             const GroupingIndex& index,
                              Handle start,
                              Handle end,
                              const common::UUID* type,
@@ -40,8 +43,11 @@ Database::Iterator::Iterator(GroupingList* list,
   // If we were asked to iterate over groupings only, then look strictly within
   // the range. Otherwise we allow the first grouping to partially overlap the
   // range.
-  grp_iter_ = std::lower_bound(list->begin(), grp_end_, start_,
-                               grp_only_ ? StartLessThan : EndLessThan);
+  auto pos = std::lower_bound(
+      index.begin(), index.end(), start_,
+      grp_only_ ? StartLessThan<GroupingList::iterator>
+                : EndLessThan<GroupingList::iterator>);
+  grp_iter_ = pos == index.end() ? grp_end_ : *pos;
 
   if (AtEnd())
     return;
@@ -147,68 +153,69 @@ Database::Iterator Database::GetIterator(Handle start,
   ZX_DEBUG_ASSERT(end <= range_end_);
   ZX_DEBUG_ASSERT(start <= end);
 
-  return Iterator(&groupings_, start, end, type, groups_only);
+  return Iterator(&groupings_, index_, start, end, type, groups_only);
 }
 
 AttributeGrouping* Database::NewGrouping(const common::UUID& group_type,
                                          size_t attr_count,
                                          const common::ByteBuffer& decl_value) {
-  // This method looks for a |pos| before which to insert the new grouping.
+  // This method looks for an |index_pos| before which to insert the new
+  // grouping.
   Handle start_handle;
-  decltype(groupings_)::iterator pos;
+  size_t index_pos;
 
   if (groupings_.empty()) {
     if (range_end_ - range_start_ < attr_count)
       return nullptr;
 
     start_handle = range_start_;
-    pos = groupings_.end();
+    index_pos = 0u;
   } else if (groupings_.front().start_handle() - range_start_ > attr_count) {
     // There is room at the head of the list.
     start_handle = range_start_;
-    pos = groupings_.begin();
+    index_pos = 0u;
   } else if (range_end_ - groupings_.back().end_handle() > attr_count) {
     // There is room at the tail end of the list.
     start_handle = groupings_.back().end_handle() + 1;
-    pos = groupings_.end();
+    index_pos = index_.size();
   } else {
     // Linearly search for a gap that fits the new grouping.
     // TODO(armansito): This is suboptimal for long running cases where the
     // database is fragmented. Think about using a better algorithm.
-
-    auto prev = groupings_.begin();
-    pos = prev;
-    pos++;
-
-    for (; pos != groupings_.end(); ++pos, ++prev) {
-      size_t next_avail = pos->start_handle() - prev->end_handle() - 1;
+    for (index_pos = 1u; index_pos < index_.size(); ++index_pos) {
+      size_t next_avail = index_[index_pos]->start_handle() -
+                          index_[index_pos - 1]->end_handle() - 1;
       if (attr_count < next_avail)
         break;
     }
 
-    if (pos == groupings_.end()) {
+    if (index_pos == index_.size()) {
       bt_log(TRACE, "att", "attribute database is out of space!");
       return nullptr;
     }
 
-    start_handle = prev->end_handle() + 1;
+    start_handle = index_[index_pos - 1]->end_handle() + 1;
   }
 
+  auto pos =
+      index_pos == index_.size() ? groupings_.end() : index_[index_pos];
   auto iter =
       groupings_.emplace(pos, group_type, start_handle, attr_count, decl_value);
   ZX_DEBUG_ASSERT(iter != groupings_.end());
+  index_.insert(index_.begin() + index_pos, iter);
 
   return &*iter;
 }
 
 bool Database::RemoveGrouping(Handle start_handle) {
-  auto iter = std::lower_bound(groupings_.begin(), groupings_.end(),
-                               start_handle, StartLessThan);
+  auto pos = std::lower_bound(index_.begin(), index_.end(), start_handle,
+                              StartLessThan<GroupingList::iterator>);
 
-  if (iter == groupings_.end() || iter->start_handle() != start_handle)
+  if (pos == index_.end() || (*pos)->start_handle() != start_handle)
     return false;
 
-  groupings_.erase(iter);
+  groupings_.erase(*pos);
+  index_.erase(pos);
   return true;
 }
 
@@ -217,11 +224,12 @@ const Attribute* Database::FindAttribute(Handle handle) {
     return nullptr;
 
   // Do a binary search to find the grouping that this handle is in.
-  auto iter = std::lower_bound(groupings_.begin(), groupings_.end(), handle,
-                               EndLessThan);
-  if (iter == groupings_.end() || iter->start_handle() > handle)
+  auto pos = std::lower_bound(index_.begin(), index_.end(), handle,
+                              EndLessThan<GroupingList::iterator>);
+  if (pos == index_.end() || (*pos)->start_handle() > handle)
     return nullptr;
 
+  auto iter = *pos;
   if (!iter->active() || !iter->complete())
     return nullptr;
 
@@ -7,6 +7,7 @@
 
 #include <list>
 #include <memory>
+#include <vector>
 
 #include "garnet/drivers/bluetooth/lib/att/att.h"
 #include "garnet/drivers/bluetooth/lib/att/attribute.h"
@@ -34,6 +35,7 @@ namespace att {
 // methods must be called on the same thread.
 class Database final : public fxl::RefCountedThreadSafe<Database> {
   using GroupingList = std::list<AttributeGrouping>;
+  using GroupingIndex = std::vector<GroupingList::iterator>;
 
  public:
   // This type allows iteration over the attributes in a database. An iterator
@@ -65,6 +67,7 @@ class Database final : public fxl::RefCountedThreadSafe<Database> {
 
     friend class Database;
     Iterator(GroupingList* list,
+             const GroupingIndex& index,
              Handle start,
              Handle end,
              const common::UUID* type,
@@ -145,11 +148,14 @@ class Database final : public fxl::RefCountedThreadSafe<Database> {
   // non-overlapping handle range. Successive groupings don't necessarily
   // represent contiguous handle ranges as any grouping can be removed.
   //
-  // Note: This uses a std::list because fbl::lower_bound doesn't work with a
-  // common::LinkedList (aka fbl::DoublyLinkedList). This is only marginally
-  // less space efficient.
+  // Groupings live in a std::list so that their addresses (which attributes
+  // and callers hold on to) remain stable as others are added and removed.
   GroupingList groupings_;
 
+  // An iterator to each element of |groupings_|, in the same order. Handle
+  // lookups binary search this rather than walking the list.
+  GroupingIndex index_;
+
   FXL_DISALLOW_COPY_AND_ASSIGN(Database);
 };
 
@@ -203,6 +203,53 @@ TEST(ATT_DatabaseTest, FindAttributeIndexIntoGrouping) {
   EXPECT_EQ(attr, db->FindAttribute(grp->end_handle()));
 }
 
+TEST(ATT_DatabaseTest, FindAttributeAfterRemovingFromMiddle) {
+  constexpr size_t kGroupingCount = 1000;
+  auto db = Database::Create();
+
+  // Each grouping holds a declaration and one attribute.
+  std::vector<AttributeGrouping*> groupings;
+  for (size_t i = 0; i < kGroupingCount; i++) {
+    auto* grp = db->NewGrouping(kTestType1, 1, kTestValue1);
+    ASSERT_TRUE(grp);
+    grp->AddAttribute(kTestType2, AccessRequirements(), AccessRequirements());
+    grp->set_active(true);
+    groupings.push_back(grp);
+  }
+
+  // Remove every other grouping.
+  for (size_t i = 0; i < kGroupingCount; i += 2) {
+    EXPECT_TRUE(db->RemoveGrouping(groupings[i]->start_handle()));
+  }
+  EXPECT_EQ(kGroupingCount / 2, db->groupings().size());
+
+  for (size_t i = 0; i < kGroupingCount; i++) {
+    const Handle start = kHandleMin + 2 * i;
+    if (i % 2 == 0) {
+      EXPECT_EQ(nullptr, db->FindAttribute(start));
+      EXPECT_EQ(nullptr, db->FindAttribute(start + 1));
+    } else {
+      EXPECT_EQ(&groupings[i]->attributes()[0], db->FindAttribute(start));
+      EXPECT_EQ(&groupings[i]->attributes()[1], db->FindAttribute(start + 1));
+    }
+  }
+
+  // The freed handles get reused, in order.
+  auto* grp = db->NewGrouping(kTestType3, 1, kTestValue1);
+  ASSERT_TRUE(grp);
+  EXPECT_EQ(kHandleMin, grp->start_handle());
+
+  auto iter = db->GetIterator(kHandleMin, kHandleMax, &kTestType1, true);
+  Handle last = kInvalidHandle;
+  size_t count = 0;
+  for (; !iter.AtEnd(); iter.Advance()) {
+    EXPECT_LT(last, iter.get()->handle());
+    last = iter.get()->handle();
+    count++;
+  }
+  EXPECT_EQ(kGroupingCount / 2, count);
+}
+
 TEST(ATT_DatabaseTest, IteratorEmpty) {
   auto db = Database::Create(kTestRangeStart, kTestRangeEnd);
   auto iter = db->GetIterator(kTestRangeStart, kTestRangeEnd);
@@ -6,10 +6,13 @@
 #define GARNET_DRIVERS_BLUETOOTH_LIB_COMMON_TEST_HELPERS_H_
 
 #include <algorithm>
+#include <cstdarg>
+#include <cstdio>
 #include <iostream>
 
 #include "garnet/drivers/bluetooth/lib/common/byte_buffer.h"
 
+#include "lib/fxl/compiler_specific.h"
 #include "lib/fxl/strings/string_printf.h"
 
 namespace btlib {
@@ -57,6 +60,21 @@ bool ContainersEqual(const Container1& expected, const uint8_t* actual_bytes,
                          actual_bytes + actual_num_bytes);
 }
 
+// Toggle to true to print the tables of results from the benchmark tests.
+constexpr bool kPrintBenchmarkResults = false;
+
+// Prints a line of benchmark results, if kPrintBenchmarkResults is set.
+inline void PrintBenchmarkResult(const char* format, ...)
+    FXL_PRINTF_FORMAT(1, 2);
+inline void PrintBenchmarkResult(const char* format, ...) {
+  if (!kPrintBenchmarkResults)
+    return;
+  va_list args;
+  va_start(args, format);
+  std::vprintf(format, args);
+  va_end(args);
+}
+
 // Returns a managed pointer to a heap allocated MutableByteBuffer.
 template <typename... T>
 common::MutableByteBufferPtr NewBuffer(T... bytes) {
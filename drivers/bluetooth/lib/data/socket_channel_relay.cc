@@ -254,7 +254,7 @@ void SocketChannelRelay::ServiceSocketWriteQueue() {
     ZX_DEBUG_ASSERT(socket_write_queue_.front().length());
 
     const l2cap::SDU& sdu = socket_write_queue_.front();
-    const bool read_success = l2cap::PDU::Reader(&sdu).ReadNext(
+    const bool read_success = l2cap::SDU::Reader(&sdu).ReadNext(
         sdu.length(), [&](const common::ByteBuffer& pdu) {
           size_t n_bytes_written = 0;
           write_res =
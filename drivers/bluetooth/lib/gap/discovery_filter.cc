@@ -68,9 +68,16 @@ bool DiscoveryFilter::MatchLowEnergyResult(
   if (advertising_data.size() && !reader.is_valid())
     return false;
 
+  // Stop reading fields as soon as they've satisfied every filter (which is
+  // immediately if none of the filters depend on them).
+  auto fields_ok = [&] {
+    return flags_ok && service_uuids_ok && name_ok && manufacturer_ok &&
+           pathloss_ok;
+  };
+
   DataType type;
   common::BufferView data;
-  while (reader.GetNextField(&type, &data)) {
+  while (!fields_ok() && reader.GetNextField(&type, &data)) {
     switch (type) {
       case DataType::kFlags: {
         if (flags_ok)
@@ -4,6 +4,8 @@
 
 #include "remote_device.h"
 
+#include <string.h>
+
 #include <zircon/assert.h>
 
 #include "garnet/drivers/bluetooth/lib/gap/advertising_data.h"
@@ -52,6 +54,18 @@ void RemoteDevice::LowEnergyData::SetAdvertisingData(
 
   bool notify_listeners = dev_->SetRssiInternal(rssi);
 
+  // Devices repeat the same advertisement many times a second; there's nothing
+  // to update unless it changed.
+  if (adv.size() == adv_data_len_ &&
+      (!adv_data_len_ ||
+       !memcmp(adv.data(), adv_data_buffer_.data(), adv_data_len_))) {
+    if (notify_listeners) {
+      dev_->UpdateExpiry();
+      dev_->NotifyListeners();
+    }
+    return;
+  }
+
   // Update the advertising data
   // TODO(armansito): Validate that the advertising data is not malformed?
   if (adv_data_buffer_.size() < adv.size()) {
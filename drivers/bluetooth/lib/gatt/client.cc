@@ -4,6 +4,11 @@
 
 #include "client.h"
 
+#include <deque>
+#include <vector>
+
+#include <lib/async/cpp/task.h>
+#include <lib/async/default.h>
 #include <zircon/assert.h>
 
 #include "garnet/drivers/bluetooth/lib/common/log.h"
@@ -22,6 +27,12 @@ using common::HostError;
 namespace gatt {
 namespace {
 
+// Descriptor discovery requests are coalesced if at most this many attributes
+// lie between their ranges. This covers the declarations and values of two
+// characteristics without descriptors, which cost 4 octets each in a Find
+// Information response and so much less than a round trip of their own.
+constexpr size_t kMaxDescriptorBatchGap = 4;
+
 common::MutableByteBufferPtr NewPDU(size_t param_size) {
   auto pdu = common::NewSlabBuffer(sizeof(att::Header) + param_size);
   if (!pdu) {
@@ -481,6 +492,77 @@ class Impl final : public Client {
     ZX_DEBUG_ASSERT(desc_callback);
     ZX_DEBUG_ASSERT(status_callback);
 
+    pending_desc_reqs_.push_back({range_start, range_end,
+                                  std::move(desc_callback),
+                                  std::move(status_callback)});
+
+    // Give the caller a chance to make more requests before the procedure
+    // starts so that they can share it.
+    if (desc_batch_.empty() && pending_desc_reqs_.size() == 1u) {
+      async::PostTask(async_get_default_dispatcher(),
+                      [self = weak_ptr_factory_.GetWeakPtr(), this] {
+                        if (self) {
+                          StartDescriptorDiscovery();
+                        }
+                      });
+    }
+  }
+
+  // Starts a descriptor discovery procedure for the longest run of pending
+  // requests whose ranges follow each other closely.
+  void StartDescriptorDiscovery() {
+    if (!desc_batch_.empty() || pending_desc_reqs_.empty())
+      return;
+
+    desc_batch_.push_back(std::move(pending_desc_reqs_.front()));
+    pending_desc_reqs_.pop_front();
+    while (!pending_desc_reqs_.empty()) {
+      const auto& next = pending_desc_reqs_.front();
+      const att::Handle prev_end = desc_batch_.back().range_end;
+      if (next.range_start <= prev_end ||
+          next.range_start - prev_end - 1u > kMaxDescriptorBatchGap) {
+        break;
+      }
+      desc_batch_.push_back(std::move(pending_desc_reqs_.front()));
+      pending_desc_reqs_.pop_front();
+    }
+
+    // Route each descriptor to the request whose range holds it. Both are
+    // sorted by handle.
+    auto desc_cb = [this, next_req = size_t(0u)](
+                       const DescriptorData& desc) mutable {
+      while (next_req < desc_batch_.size() &&
+             desc_batch_[next_req].range_end < desc.handle) {
+        next_req++;
+      }
+      if (next_req < desc_batch_.size() &&
+          desc_batch_[next_req].range_start <= desc.handle) {
+        desc_batch_[next_req].desc_callback(desc);
+      }
+    };
+
+    auto status_cb = [this](att::Status status) {
+      auto batch = std::move(desc_batch_);
+      desc_batch_.clear();
+      for (auto& req : batch) {
+        req.status_callback(status);
+      }
+
+      // Requests made while this procedure was in progress are due now.
+      StartDescriptorDiscovery();
+    };
+
+    bt_log(SPEW, "gatt", "discovering descriptors of %zu ranges at once",
+           desc_batch_.size());
+    DiscoverDescriptorsInternal(desc_batch_.front().range_start,
+                                desc_batch_.back().range_end,
+                                std::move(desc_cb), std::move(status_cb));
+  }
+
+  void DiscoverDescriptorsInternal(att::Handle range_start,
+                                   att::Handle range_end,
+                                   DescriptorCallback desc_callback,
+                                   StatusCallback status_callback) {
     auto pdu = NewPDU(sizeof(att::FindInformationRequestParams));
     if (!pdu) {
       status_callback(att::Status(HostError::kOutOfMemory));
@@ -539,8 +621,8 @@ class Impl final : public Client {
       }
 
       // Request the next batch.
-      DiscoverDescriptors(last_handle + 1, range_end, std::move(desc_cb),
-                          std::move(res_cb));
+      DiscoverDescriptorsInternal(last_handle + 1, range_end,
+                                  std::move(desc_cb), std::move(res_cb));
     });
 
     auto error_cb =
@@ -591,6 +673,83 @@ class Impl final : public Client {
     }
   }
 
+  void ReadByTypeRequest(const common::UUID& type,
+                         att::Handle range_start,
+                         att::Handle range_end,
+                         ReadByTypeCallback callback) override {
+    ZX_DEBUG_ASSERT(range_start <= range_end);
+    ZX_DEBUG_ASSERT(callback);
+
+    const size_t type_size = type.CompactSize(false /* allow_32bit */);
+    auto pdu = NewPDU(2 * sizeof(att::Handle) + type_size);
+    if (!pdu) {
+      callback(att::Status(HostError::kOutOfMemory), att::kInvalidHandle,
+               BufferView());
+      return;
+    }
+
+    att::PacketWriter writer(att::kReadByTypeRequest, pdu.get());
+    auto params = writer.mutable_payload_data();
+    params.WriteObj(htole16(range_start), 0);
+    params.WriteObj(htole16(range_end), sizeof(att::Handle));
+    auto type_view = params.mutable_view(2 * sizeof(att::Handle));
+    type.ToBytes(&type_view, false /* allow_32bit */);
+
+    auto rsp_cb = BindCallback([this, range_start, range_end,
+                                callback = callback.share()](
+                                   const att::PacketReader& rsp) {
+      ZX_DEBUG_ASSERT(rsp.opcode() == att::kReadByTypeResponse);
+
+      if (rsp.payload_size() < sizeof(att::ReadByTypeResponseParams)) {
+        bt_log(TRACE, "gatt", "received malformed Read By Type response");
+        att_->ShutDown();
+        callback(att::Status(HostError::kPacketMalformed), att::kInvalidHandle,
+                 BufferView());
+        return;
+      }
+
+      const auto& rsp_params = rsp.payload<att::ReadByTypeResponseParams>();
+      const size_t entry_length = rsp_params.length;
+      if (entry_length < sizeof(att::AttributeData) ||
+          entry_length > rsp.payload_size() - 1) {
+        bt_log(TRACE, "gatt", "invalid attribute data length");
+        att_->ShutDown();
+        callback(att::Status(HostError::kPacketMalformed), att::kInvalidHandle,
+                 BufferView());
+        return;
+      }
+
+      const auto& entry = rsp_params.attribute_data_list[0];
+      const att::Handle handle = le16toh(entry.handle);
+      if (handle < range_start || handle > range_end) {
+        bt_log(TRACE, "gatt",
+               "attribute handle out of range (handle: %#.4x, "
+               "range: %#.4x - %#.4x)",
+               handle, range_start, range_end);
+        callback(att::Status(HostError::kPacketMalformed), att::kInvalidHandle,
+                 BufferView());
+        return;
+      }
+
+      callback(att::Status(), handle,
+               BufferView(entry.value, entry_length - sizeof(att::Handle)));
+    });
+
+    auto error_cb =
+        BindErrorCallback([this, callback = callback.share()](
+                              att::Status status, att::Handle handle) {
+          bt_log(TRACE, "gatt", "read by type request failed: %s",
+                 status.ToString().c_str());
+          callback(status, att::kInvalidHandle, BufferView());
+        });
+
+    if (!att_->StartTransaction(std::move(pdu), std::move(rsp_cb),
+                                std::move(error_cb))) {
+      callback(att::Status(HostError::kPacketMalformed), att::kInvalidHandle,
+               BufferView());
+    }
+  }
+
   void ReadBlobRequest(att::Handle handle, uint16_t offset,
                        ReadCallback callback) override {
     auto pdu = NewPDU(sizeof(att::ReadBlobRequestParams));
@@ -729,6 +888,20 @@ class Impl final : public Client {
   att::Bearer::HandlerId not_handler_id_;
   att::Bearer::HandlerId ind_handler_id_;
   NotificationCallback notification_handler_;
+
+  // A request made with DiscoverDescriptors().
+  struct DescriptorRequest {
+    att::Handle range_start;
+    att::Handle range_end;
+    DescriptorCallback desc_callback;
+    StatusCallback status_callback;
+  };
+
+  // Descriptor discovery requests that wait for the current procedure (if any)
+  // to finish, and the requests served by the current procedure.
+  std::deque<DescriptorRequest> pending_desc_reqs_;
+  std::vector<DescriptorRequest> desc_batch_;
+
   fxl::WeakPtrFactory<Client> weak_ptr_factory_;
 
   FXL_DISALLOW_COPY_AND_ASSIGN(Impl);
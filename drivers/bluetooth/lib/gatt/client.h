@@ -79,6 +79,12 @@ class Client {
 
   // Performs the "Discover All Characteristic Descriptors" procedure defined in
   // Vol 3, Part G, 4.7.1.
+  //
+  // Requests that are made back-to-back (e.g. for each characteristic of a
+  // service) are coalesced into a single procedure over the handles that they
+  // span, so that one Find Information response can carry the descriptors of
+  // several characteristics. The declarations and values of characteristics
+  // that lie between the requested ranges are not reported.
   using DescriptorCallback = fit::function<void(const DescriptorData&)>;
   virtual void DiscoverDescriptors(att::Handle range_start,
                                    att::Handle range_end,
@@ -95,6 +101,20 @@ class Client {
       fit::function<void(att::Status, const common::ByteBuffer&)>;
   virtual void ReadRequest(att::Handle handle, ReadCallback callback) = 0;
 
+  // Performs the "Read Using Characteristic UUID" procedure defined in v5.0,
+  // Vol 3, Part G, 4.8.2 and reports the handle and value of the first
+  // attribute of the given |type| within the handle range. This takes a single
+  // ATT Read By Type request, e.g. to read the Database Hash characteristic
+  // without discovering the Generic Attribute service.
+  //
+  // Returns an invalid handle and an empty buffer if the status is an error.
+  using ReadByTypeCallback = fit::function<
+      void(att::Status, att::Handle, const common::ByteBuffer&)>;
+  virtual void ReadByTypeRequest(const common::UUID& type,
+                                 att::Handle range_start,
+                                 att::Handle range_end,
+                                 ReadByTypeCallback callback) = 0;
+
   // Sends an ATT Read Blob request with the requested attribute |handle| and
   // returns the result value in |callback|. This can be called multiple times
   // to read the value of a characteristic that is larger than the ATT_MTU.
@@ -4,6 +4,8 @@
 
 #include "client.h"
 
+#include <vector>
+
 #include "garnet/drivers/bluetooth/lib/common/test_helpers.h"
 #include "garnet/drivers/bluetooth/lib/l2cap/fake_channel_test.h"
 #include "lib/fxl/macros.h"
@@ -1558,6 +1560,89 @@ TEST_F(GATT_ClientTest, DescriptorDiscoveryHandlesNotIncreasing) {
   EXPECT_EQ(HostError::kPacketMalformed, status.error());
 }
 
+// Descriptor discovery requests that are made back-to-back share a procedure.
+TEST_F(GATT_ClientTest, DescriptorDiscoveryCoalescesRequests) {
+  // Characteristic 1: declaration 0x0002, value 0x0003, descriptor 0x0004.
+  // Characteristic 2: declaration 0x0005, value 0x0006, descriptors 0x0007 and
+  // 0x0008.
+  std::vector<DescriptorData> descrs1, descrs2;
+  att::Status status1(HostError::kFailed), status2(HostError::kFailed);
+  async::PostTask(dispatcher(), [&, this] {
+    client()->DiscoverDescriptors(
+        0x0004, 0x0004,
+        [&descrs1](const DescriptorData& desc) { descrs1.push_back(desc); },
+        [&status1](att::Status status) { status1 = status; });
+    client()->DiscoverDescriptors(
+        0x0007, 0x0008,
+        [&descrs2](const DescriptorData& desc) { descrs2.push_back(desc); },
+        [&status2](att::Status status) { status2 = status; });
+  });
+
+  // A single request spans both ranges.
+  ASSERT_TRUE(ExpectFindInformation(0x0004, 0x0008));
+  fake_chan()->Receive(common::CreateStaticByteBuffer(
+      0x05,        // opcode: find information response
+      0x01,        // format: 16-bit. Data length must be 4
+      0x04, 0x00,  // handle: 0x0004
+      0x02, 0x29,  // uuid: client characteristic configuration
+      0x05, 0x00,  // handle: 0x0005
+      0x03, 0x28,  // uuid: characteristic declaration
+      0x06, 0x00,  // handle: 0x0006
+      0xAD, 0xDE,  // uuid: characteristic value 0xDEAD
+      0x07, 0x00,  // handle: 0x0007
+      0x02, 0x29,  // uuid: client characteristic configuration
+      0x08, 0x00,  // handle: 0x0008
+      0x01, 0x29   // uuid: characteristic user description
+      ));
+
+  RunLoopUntilIdle();
+
+  EXPECT_TRUE(status1);
+  EXPECT_TRUE(status2);
+  ASSERT_EQ(1u, descrs1.size());
+  EXPECT_EQ(0x0004, descrs1[0].handle);
+  EXPECT_EQ(types::kClientCharacteristicConfig, descrs1[0].type);
+  ASSERT_EQ(2u, descrs2.size());
+  EXPECT_EQ(0x0007, descrs2[0].handle);
+  EXPECT_EQ(types::kClientCharacteristicConfig, descrs2[0].type);
+  EXPECT_EQ(0x0008, descrs2[1].handle);
+  EXPECT_EQ(types::kCharacteristicUserDescription, descrs2[1].type);
+}
+
+// Descriptor discovery requests for distant ranges get a procedure each.
+TEST_F(GATT_ClientTest, DescriptorDiscoveryDoesNotCoalesceDistantRanges) {
+  att::Status status1(HostError::kFailed), status2(HostError::kFailed);
+  async::PostTask(dispatcher(), [&, this] {
+    client()->DiscoverDescriptors(
+        0x0002, 0x0002, NopDescCallback,
+        [&status1](att::Status status) { status1 = status; });
+    client()->DiscoverDescriptors(
+        0x0020, 0x0020, NopDescCallback,
+        [&status2](att::Status status) { status2 = status; });
+  });
+
+  ASSERT_TRUE(ExpectFindInformation(0x0002, 0x0002));
+  fake_chan()->Receive(common::CreateStaticByteBuffer(
+      0x05,        // opcode: find information response
+      0x01,        // format: 16-bit. Data length must be 4
+      0x02, 0x00,  // handle: 0x0002
+      0xEF, 0xBE   // uuid
+      ));
+
+  ASSERT_TRUE(ExpectFindInformation(0x0020, 0x0020));
+  EXPECT_TRUE(status1);
+  fake_chan()->Receive(common::CreateStaticByteBuffer(
+      0x01,        // opcode: error response
+      0x04,        // request: find information
+      0x20, 0x00,  // handle: 0x0020
+      0x0A         // error: Attribute Not Found
+      ));
+
+  RunLoopUntilIdle();
+
+  EXPECT_TRUE(status2);
+}
+
 TEST_F(GATT_ClientTest, WriteRequestMalformedResponse) {
   const auto kValue = common::CreateStaticByteBuffer('f', 'o', 'o');
   const auto kHandle = 0x0001;
@@ -1818,6 +1903,115 @@ TEST_F(GATT_ClientTest, ReadRequestError) {
   EXPECT_FALSE(fake_chan()->link_error());
 }
 
+TEST_F(GATT_ClientTest, ReadByTypeRequestSuccess) {
+  const auto kExpectedRequest = common::CreateStaticByteBuffer(
+      0x08,        // opcode: read by type request
+      0x01, 0x00,  // start handle: 0x0001
+      0xFF, 0xFF,  // end handle: 0xFFFF
+      0x2A, 0x2B   // type: database hash (0x2B2A)
+  );
+
+  // clang-format off
+  const auto kExpectedResponse = common::CreateStaticByteBuffer(
+      0x09,        // opcode: read by type response
+      0x12,        // length: 18 (handle + 16 octet value)
+      0x10, 0x00,  // handle: 0x0010
+      0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15  // value
+  );
+  // clang-format on
+
+  att::Status status(HostError::kFailed);
+  att::Handle handle = att::kInvalidHandle;
+  auto cb = [&](att::Status cb_status, att::Handle cb_handle,
+                const ByteBuffer& value) {
+    status = cb_status;
+    handle = cb_handle;
+    EXPECT_TRUE(common::ContainersEqual(kExpectedResponse.view(4), value));
+  };
+
+  // Initiate the request in a loop task, as Expect() below blocks
+  async::PostTask(dispatcher(), [&, this] {
+    client()->ReadByTypeRequest(types::kDatabaseHashCharacteristic,
+                                att::kHandleMin, att::kHandleMax, cb);
+  });
+
+  ASSERT_TRUE(Expect(kExpectedRequest));
+
+  fake_chan()->Receive(kExpectedResponse);
+
+  RunLoopUntilIdle();
+
+  EXPECT_TRUE(status);
+  EXPECT_EQ(0x0010, handle);
+  EXPECT_FALSE(fake_chan()->link_error());
+}
+
+TEST_F(GATT_ClientTest, ReadByTypeRequestError) {
+  att::Status status;
+  auto cb = [&](att::Status cb_status, att::Handle handle,
+                const ByteBuffer& value) {
+    status = cb_status;
+
+    // Handle and value should be empty due to the error.
+    EXPECT_EQ(att::kInvalidHandle, handle);
+    EXPECT_EQ(0u, value.size());
+  };
+
+  async::PostTask(dispatcher(), [&, this] {
+    client()->ReadByTypeRequest(types::kDatabaseHashCharacteristic,
+                                att::kHandleMin, att::kHandleMax, cb);
+  });
+
+  ASSERT_TRUE(Expect(common::CreateStaticByteBuffer(
+      0x08,        // opcode: read by type request
+      0x01, 0x00,  // start handle: 0x0001
+      0xFF, 0xFF,  // end handle: 0xFFFF
+      0x2A, 0x2B   // type: database hash (0x2B2A)
+      )));
+
+  fake_chan()->Receive(common::CreateStaticByteBuffer(
+      0x01,        // opcode: error response
+      0x08,        // request: read by type
+      0x01, 0x00,  // handle: 0x0001
+      0x0A         // error: Attribute Not Found
+      ));
+
+  RunLoopUntilIdle();
+
+  EXPECT_TRUE(status.is_protocol_error());
+  EXPECT_EQ(att::ErrorCode::kAttributeNotFound, status.protocol_error());
+  EXPECT_FALSE(fake_chan()->link_error());
+}
+
+TEST_F(GATT_ClientTest, ReadByTypeRequestMalformedResponse) {
+  att::Status status;
+  auto cb = [&](att::Status cb_status, att::Handle, const ByteBuffer&) {
+    status = cb_status;
+  };
+
+  async::PostTask(dispatcher(), [&, this] {
+    client()->ReadByTypeRequest(types::kDatabaseHashCharacteristic,
+                                att::kHandleMin, att::kHandleMax, cb);
+  });
+
+  ASSERT_TRUE(Expect(common::CreateStaticByteBuffer(
+      0x08,        // opcode: read by type request
+      0x01, 0x00,  // start handle: 0x0001
+      0xFF, 0xFF,  // end handle: 0xFFFF
+      0x2A, 0x2B   // type: database hash (0x2B2A)
+      )));
+
+  fake_chan()->Receive(common::CreateStaticByteBuffer(
+      0x09,  // opcode: read by type response
+      0x04,  // length: 4 (longer than the data list)
+      0x10, 0x00));
+
+  RunLoopUntilIdle();
+
+  EXPECT_EQ(HostError::kPacketMalformed, status.error());
+  EXPECT_TRUE(fake_chan()->link_error());
+}
+
 TEST_F(GATT_ClientTest, ReadBlobRequestEmptyResponse) {
   constexpr att::Handle kHandle = 1;
   constexpr uint16_t kOffset = 5;
@@ -1989,6 +2183,130 @@ TEST_F(GATT_ClientTest, Indication) {
   EXPECT_TRUE(called);
 }
 
+// Counts the Find Information round trips that it takes to discover the
+// descriptors of a service whose characteristics have a Client Characteristic
+// Configuration descriptor each. This compares discovering them one
+// characteristic at a time with requesting them all at once, which lets the
+// client coalesce the requests.
+TEST_F(GATT_ClientTest, DescriptorDiscoveryRoundTrips) {
+  constexpr uint16_t kMtus[] = {att::kLEMinMTU, 185, 517};
+  constexpr size_t kCharacteristicCounts[] = {4, 16};
+  constexpr uint16_t kValueUuid = 0xDEAD;
+
+  // Characteristic |i| has its declaration at 2 + 3 * |i|, its value at the
+  // next handle and its CCC descriptor after that.
+  auto attribute_type = [](att::Handle handle) -> uint16_t {
+    switch ((handle - 2) % 3) {
+      case 0:
+        return types::kCharacteristicDeclaration16;
+      case 1:
+        return kValueUuid;
+      default:
+        return types::kClientCharacteristicConfig16;
+    }
+  };
+
+  common::PrintBenchmarkResult(
+      "mtu,characteristics,sequential_round_trips,batched_round_trips\n");
+  for (uint16_t mtu : kMtus) {
+    for (size_t chrc_count : kCharacteristicCounts) {
+      const att::Handle last_handle = 1 + 3 * chrc_count;
+      att()->set_mtu(mtu);
+
+      // Answer each Find Information request with as many attributes of the
+      // service as fit in the MTU.
+      size_t round_trips = 0;
+      fake_chan()->SetSendCallback(
+          [&](auto packet) {
+            ASSERT_EQ(att::kFindInformationRequest, (*packet)[0]);
+            round_trips++;
+
+            const auto& params = packet->view(1)
+                                     .template As<
+                                         att::FindInformationRequestParams>();
+            const att::Handle start = le16toh(params.start_handle);
+            const att::Handle end =
+                std::min(le16toh(params.end_handle), last_handle);
+
+            common::DynamicByteBuffer rsp(mtu);
+            rsp[0] = att::kFindInformationResponse;
+            rsp[1] = static_cast<uint8_t>(att::UUIDType::k16Bit);
+            size_t rsp_size = 2;
+            for (att::Handle handle = start;
+                 handle <= end && rsp_size + 4 <= mtu; handle++) {
+              rsp.WriteObj(htole16(handle), rsp_size);
+              rsp.WriteObj(htole16(attribute_type(handle)), rsp_size + 2);
+              rsp_size += 4;
+            }
+
+            if (rsp_size == 2) {
+              fake_chan()->Receive(common::CreateStaticByteBuffer(
+                  0x01,  // opcode: error response
+                  0x04,  // request: find information
+                  LowerBits(start), UpperBits(start),
+                  0x0A  // error: Attribute Not Found
+                  ));
+            } else {
+              fake_chan()->Receive(rsp.view(0, rsp_size));
+            }
+          },
+          dispatcher());
+
+      std::vector<size_t> descriptor_counts(chrc_count);
+      size_t completed = 0;
+      auto discover = [&](size_t i, att::StatusCallback status_cb) {
+        const att::Handle ccc_handle = 4 + 3 * i;
+        client()->DiscoverDescriptors(
+            ccc_handle, ccc_handle,
+            [&descriptor_counts, i, ccc_handle](const DescriptorData& desc) {
+              EXPECT_EQ(ccc_handle, desc.handle);
+              EXPECT_EQ(types::kClientCharacteristicConfig, desc.type);
+              descriptor_counts[i]++;
+            },
+            std::move(status_cb));
+      };
+
+      // One characteristic at a time, as each request waits for the previous
+      // one to complete.
+      round_trips = 0;
+      fit::function<void(size_t)> discover_from = [&](size_t i) {
+        discover(i, [&, i](att::Status status) {
+          EXPECT_TRUE(status);
+          completed++;
+          if (i + 1 < chrc_count) {
+            discover_from(i + 1);
+          }
+        });
+      };
+      discover_from(0);
+      RunLoopUntilIdle();
+      const size_t sequential_round_trips = round_trips;
+      EXPECT_EQ(chrc_count, completed);
+      EXPECT_EQ(std::vector<size_t>(chrc_count, 1u), descriptor_counts);
+
+      // All characteristics at once.
+      round_trips = 0;
+      completed = 0;
+      descriptor_counts.assign(chrc_count, 0u);
+      for (size_t i = 0; i < chrc_count; i++) {
+        discover(i, [&](att::Status status) {
+          EXPECT_TRUE(status);
+          completed++;
+        });
+      }
+      RunLoopUntilIdle();
+      const size_t batched_round_trips = round_trips;
+      EXPECT_EQ(chrc_count, completed);
+      EXPECT_EQ(std::vector<size_t>(chrc_count, 1u), descriptor_counts);
+
+      common::PrintBenchmarkResult("%u,%zu,%zu,%zu\n", mtu, chrc_count,
+                                   sequential_round_trips, batched_round_trips);
+      EXPECT_EQ(chrc_count, sequential_round_trips);
+      EXPECT_LT(batched_round_trips, sequential_round_trips);
+    }
+  }
+}
+
 }  // namespace
 }  // namespace gatt
 }  // namespace btlib
@@ -20,16 +20,18 @@ Connection::Connection(const std::string& peer_id,
                        fxl::RefPtr<att::Bearer> att_bearer,
                        fxl::RefPtr<att::Database> local_db,
                        RemoteServiceWatcher svc_watcher,
-                       async_dispatcher_t* gatt_dispatcher)
+                       async_dispatcher_t* gatt_dispatcher,
+                       DatabaseCache* remote_db_cache)
     : att_(att_bearer) {
   ZX_DEBUG_ASSERT(att_bearer);
   ZX_DEBUG_ASSERT(local_db);
   ZX_DEBUG_ASSERT(svc_watcher);
   ZX_DEBUG_ASSERT(gatt_dispatcher);
+  ZX_DEBUG_ASSERT(remote_db_cache);
 
   server_ = std::make_unique<gatt::Server>(peer_id, local_db, att_);
   remote_service_manager_ = std::make_unique<RemoteServiceManager>(
-      gatt::Client::Create(att_), gatt_dispatcher);
+      gatt::Client::Create(att_), gatt_dispatcher, remote_db_cache);
   remote_service_manager_->set_service_watcher(std::move(svc_watcher));
 }
 
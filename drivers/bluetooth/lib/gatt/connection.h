@@ -41,11 +41,14 @@ class Connection final {
   // |peer_id| is the 128-bit UUID that identifies the peer device.
   // |local_db| is the local attribute database that the GATT server will
   // operate on. |att_chan| must correspond to an open L2CAP Attribute channel.
+  // |remote_db_cache| holds what was discovered of the peer's database over
+  // previous connections and must outlive this object.
   Connection(const std::string& peer_id,
              fxl::RefPtr<att::Bearer> att_bearer,
              fxl::RefPtr<att::Database> local_db,
              RemoteServiceWatcher svc_watcher,
-             async_dispatcher_t* gatt_dispatcher);
+             async_dispatcher_t* gatt_dispatcher,
+             DatabaseCache* remote_db_cache);
   ~Connection() = default;
 
   Connection() = default;
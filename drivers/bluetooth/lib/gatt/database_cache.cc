@@ -0,0 +1,59 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "database_cache.h"
+
+#include <algorithm>
+
+namespace btlib {
+namespace gatt {
+namespace internal {
+
+DatabaseCache::Service::Service(const ServiceData& info) : info(info) {}
+
+void DatabaseCache::Reset(const DatabaseHash& hash) {
+  Clear();
+  valid_ = true;
+  hash_ = hash;
+}
+
+void DatabaseCache::Clear() {
+  valid_ = false;
+  services_.clear();
+}
+
+void DatabaseCache::AddService(const ServiceData& info) {
+  if (!valid_)
+    return;
+
+  // Don't cache a database whose services overlap.
+  if (!services_.empty() &&
+      services_.back().info.range_end >= info.range_start) {
+    Clear();
+    return;
+  }
+
+  services_.emplace_back(info);
+}
+
+void DatabaseCache::SetCharacteristics(
+    att::Handle service_handle,
+    std::vector<CharacteristicData> characteristics,
+    std::vector<DescriptorData> descriptors) {
+  auto iter = std::lower_bound(
+      services_.begin(), services_.end(), service_handle,
+      [](const Service& service, att::Handle handle) {
+        return service.info.range_start < handle;
+      });
+  if (iter == services_.end() || iter->info.range_start != service_handle)
+    return;
+
+  iter->characteristics_discovered = true;
+  iter->characteristics = std::move(characteristics);
+  iter->descriptors = std::move(descriptors);
+}
+
+}  // namespace internal
+}  // namespace gatt
+}  // namespace btlib
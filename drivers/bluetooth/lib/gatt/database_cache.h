@@ -0,0 +1,83 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef GARNET_DRIVERS_BLUETOOTH_LIB_GATT_DATABASE_CACHE_H_
+#define GARNET_DRIVERS_BLUETOOTH_LIB_GATT_DATABASE_CACHE_H_
+
+#include <vector>
+
+#include "garnet/drivers/bluetooth/lib/common/uint128.h"
+#include "garnet/drivers/bluetooth/lib/gatt/gatt_defs.h"
+
+#include "lib/fxl/macros.h"
+
+namespace btlib {
+namespace gatt {
+namespace internal {
+
+// The value of a peer's Database Hash characteristic (v5.1, Vol 3, Part G,
+// 7.3), which changes whenever the peer's attribute database does.
+using DatabaseHash = common::UInt128;
+
+// Holds what a RemoteServiceManager has discovered of a peer's attribute
+// database, so that discovery can be skipped when the peer reconnects. The
+// contents are only valid for the database that has the Database Hash that
+// they were discovered under. GATT keeps one cache for each peer identity.
+//
+// THREAD SAFETY:
+//
+// This class is NOT thread safe. It must be created, used, and destroyed on
+// the GATT thread.
+class DatabaseCache final {
+ public:
+  // A primary service and, once they have been discovered, its
+  // characteristics and all of their descriptors.
+  struct Service {
+    explicit Service(const ServiceData& info);
+
+    ServiceData info;
+    bool characteristics_discovered = false;
+    std::vector<CharacteristicData> characteristics;
+    std::vector<DescriptorData> descriptors;
+  };
+
+  DatabaseCache() = default;
+
+  // Returns true if this holds the database that has the given |hash|.
+  bool Matches(const DatabaseHash& hash) const {
+    return valid_ && hash_ == hash;
+  }
+
+  // Discards the cached database and starts caching the one with |hash|.
+  void Reset(const DatabaseHash& hash);
+
+  // Discards the cached database.
+  void Clear();
+
+  // The cached services, sorted by handle.
+  const std::vector<Service>& services() const { return services_; }
+
+  // Adds a service that follows all services added so far. Does nothing if
+  // this holds no database.
+  void AddService(const ServiceData& info);
+
+  // Records the characteristics and descriptors of the service that starts at
+  // |service_handle|. Does nothing if there is no such service.
+  void SetCharacteristics(att::Handle service_handle,
+                          std::vector<CharacteristicData> characteristics,
+                          std::vector<DescriptorData> descriptors);
+
+ private:
+  bool valid_ = false;
+  DatabaseHash hash_;
+  std::vector<Service> services_;
+
+  FXL_DISALLOW_COPY_AND_ASSIGN(DatabaseCache);
+};
+
+}  // namespace internal
+}  // namespace gatt
+}  // namespace btlib
+
+#endif  // GARNET_DRIVERS_BLUETOOTH_LIB_GATT_DATABASE_CACHE_H_
@@ -36,6 +36,8 @@ void FakeClient::ExchangeMTU(MTUCallback callback) {
 
 void FakeClient::DiscoverPrimaryServices(ServiceCallback svc_callback,
                                          StatusCallback status_callback) {
+  service_discovery_count_++;
+
   async::PostTask(dispatcher_, [this, svc_callback = std::move(svc_callback),
                                 status_callback = std::move(status_callback)] {
     for (const auto& svc : services_) {
@@ -97,6 +99,16 @@ void FakeClient::ReadRequest(att::Handle handle, ReadCallback callback) {
   }
 }
 
+void FakeClient::ReadByTypeRequest(const common::UUID& type,
+                                   att::Handle range_start,
+                                   att::Handle range_end,
+                                   ReadByTypeCallback callback) {
+  if (read_by_type_request_callback_) {
+    read_by_type_request_callback_(type, range_start, range_end,
+                                   std::move(callback));
+  }
+}
+
 void FakeClient::ReadBlobRequest(att::Handle handle, uint16_t offset,
                                  ReadCallback callback) {
   if (read_blob_request_callback_) {
@@ -65,6 +65,7 @@ class FakeClient final : public Client {
     return last_desc_discovery_end_handle_;
   }
 
+  size_t service_discovery_count() const { return service_discovery_count_; }
   size_t chrc_discovery_count() const { return chrc_discovery_count_; }
   size_t desc_discovery_count() const { return desc_discovery_count_; }
 
@@ -74,6 +75,14 @@ class FakeClient final : public Client {
     read_request_callback_ = std::move(callback);
   }
 
+  // Sets a callback which will run when ReadByTypeRequest gets called.
+  using ReadByTypeRequestCallback =
+      fit::function<void(const common::UUID&, att::Handle range_start,
+                         att::Handle range_end, ReadByTypeCallback)>;
+  void set_read_by_type_request_callback(ReadByTypeRequestCallback callback) {
+    read_by_type_request_callback_ = std::move(callback);
+  }
+
   // Sets a callback which will run when ReadBlobRequest gets called.
   using ReadBlobRequestCallback =
       fit::function<void(att::Handle, uint16_t offset, ReadCallback)>;
@@ -115,6 +124,10 @@ class FakeClient final : public Client {
                            DescriptorCallback desc_callback,
                            att::StatusCallback status_callback) override;
   void ReadRequest(att::Handle handle, ReadCallback callback) override;
+  void ReadByTypeRequest(const common::UUID& type,
+                         att::Handle range_start,
+                         att::Handle range_end,
+                         ReadByTypeCallback callback) override;
   void ReadBlobRequest(att::Handle handle, uint16_t offset,
                        ReadCallback callback) override;
   void WriteRequest(att::Handle handle,
@@ -133,6 +146,7 @@ class FakeClient final : public Client {
 
   // Data used for DiscoveryPrimaryServices().
   std::vector<ServiceData> services_;
+  size_t service_discovery_count_ = 0;
 
   // Fake status values to return for GATT procedures.
   att::Status exchange_mtu_status_;
@@ -155,6 +169,7 @@ class FakeClient final : public Client {
   size_t desc_discovery_count_ = 0;
 
   ReadRequestCallback read_request_callback_;
+  ReadByTypeRequestCallback read_by_type_request_callback_;
   ReadBlobRequestCallback read_blob_request_callback_;
   WriteRequestCallback write_request_callback_;
   WriteWithoutResponseCallback write_without_rsp_callback_;
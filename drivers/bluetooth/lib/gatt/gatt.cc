@@ -4,6 +4,7 @@
 
 #include "gatt.h"
 
+#include <list>
 #include <unordered_map>
 
 #include <zircon/assert.h>
@@ -16,6 +17,7 @@
 
 #include "client.h"
 #include "connection.h"
+#include "database_cache.h"
 #include "remote_service.h"
 #include "server.h"
 
@@ -23,6 +25,11 @@ namespace btlib {
 namespace gatt {
 namespace {
 
+// The number of peers that are not connected for which the remote attribute
+// database is kept cached. Caches of the peers that connected least recently
+// are evicted first.
+constexpr size_t kMaxRemoteDbCaches = 16;
+
 class Impl final : public GATT, common::TaskDomain<Impl, GATT> {
   using TaskDomainBase = common::TaskDomain<Impl, GATT>;
 
@@ -71,6 +78,8 @@ class Impl final : public GATT, common::TaskDomain<Impl, GATT> {
 
     initialized_ = false;
     connections_.clear();
+    remote_db_caches_.clear();
+    remote_db_cache_order_.clear();
     gatt_service_ = nullptr;
     local_services_ = nullptr;
     remote_service_callbacks_.clear();
@@ -102,7 +111,8 @@ class Impl final : public GATT, common::TaskDomain<Impl, GATT> {
           internal::Connection(peer_id, att_bearer, local_services_->database(),
                                std::bind(&Impl::OnServiceAdded, this, peer_id,
                                          std::placeholders::_1),
-                               dispatcher());
+                               dispatcher(), RemoteDbCache(peer_id));
+      EvictRemoteDbCaches();
     });
   }
 
@@ -259,6 +269,33 @@ class Impl final : public GATT, common::TaskDomain<Impl, GATT> {
     }
   }
 
+  // Returns the cache of the remote attribute database of |peer_id|, creating
+  // it if needed, and marks it as the most recently used.
+  internal::DatabaseCache* RemoteDbCache(const std::string& peer_id) {
+    remote_db_cache_order_.remove(peer_id);
+    remote_db_cache_order_.push_front(peer_id);
+    return &remote_db_caches_[peer_id];
+  }
+
+  // Drops the least recently used remote database caches until no more than
+  // kMaxRemoteDbCaches are held for peers that are not connected. Connected
+  // peers' caches are in use and never dropped.
+  void EvictRemoteDbCaches() {
+    const size_t max_size = connections_.size() + kMaxRemoteDbCaches;
+    auto iter = remote_db_cache_order_.end();
+    while (remote_db_caches_.size() > max_size &&
+           iter != remote_db_cache_order_.begin()) {
+      --iter;
+      if (connections_.count(*iter)) {
+        continue;
+      }
+      bt_log(TRACE, "gatt", "evicting cached database of peer: %s",
+             iter->c_str());
+      remote_db_caches_.erase(*iter);
+      iter = remote_db_cache_order_.erase(iter);
+    }
+  }
+
   // NOTE: The following objects MUST be initialized, accessed, and destroyed on
   // the GATT thread. They are not thread safe.
   bool initialized_;
@@ -274,6 +311,13 @@ class Impl final : public GATT, common::TaskDomain<Impl, GATT> {
   // Contains the state of all GATT profile connections and their services.
   std::unordered_map<std::string, internal::Connection> connections_;
 
+  // The remote attribute databases discovered over past and present
+  // connections, by peer identifier. Bounded by EvictRemoteDbCaches().
+  std::unordered_map<std::string, internal::DatabaseCache> remote_db_caches_;
+
+  // The peers in |remote_db_caches_|, most recently connected first.
+  std::list<std::string> remote_db_cache_order_;
+
   // All registered remote service handlers.
   struct RemoteServiceHandler {
     RemoteServiceHandler(RemoteServiceWatcher watcher, async_dispatcher_t* dispatcher)
@@ -26,6 +26,7 @@ constexpr uint16_t kCharacteristicFormat16 = 0x2904;
 constexpr uint16_t kCharacteristicAggregateFormat16 = 0x2905;
 constexpr uint16_t kGenericAttributeService16 = 0x1801;
 constexpr uint16_t kServiceChangedCharacteristic16 = 0x2a05;
+constexpr uint16_t kDatabaseHashCharacteristic16 = 0x2b2a;
 
 constexpr common::UUID kPrimaryService(kPrimaryService16);
 constexpr common::UUID kSecondaryService(kSecondaryService16);
@@ -48,6 +49,8 @@ constexpr ::btlib::common::UUID kGenericAttributeService(
     kGenericAttributeService16);
 constexpr ::btlib::common::UUID kServiceChangedCharacteristic(
     kServiceChangedCharacteristic16);
+constexpr ::btlib::common::UUID kDatabaseHashCharacteristic(
+    kDatabaseHashCharacteristic16);
 
 }  // namespace types
 
@@ -138,21 +138,9 @@ void RemoteCharacteristic::DiscoverDescriptors(att::Handle range_end,
     if (self->discovery_error_)
       return;
 
-    if (desc.type == types::kClientCharacteristicConfig) {
-      if (self->ccc_handle_ != att::kInvalidHandle) {
-        bt_log(TRACE, "gatt",
-               "characteristic has more than one CCC descriptor!");
-        self->discovery_error_ = true;
-        return;
-      }
-      self->ccc_handle_ = desc.handle;
+    if (!self->AddDescriptor(desc)) {
+      self->discovery_error_ = true;
     }
-
-    // See comments about "ID scheme" in remote_characteristics.h
-    ZX_DEBUG_ASSERT(self->descriptors_.size() <=
-                    std::numeric_limits<uint16_t>::max());
-    IdType id = (self->id_ << 16) | self->descriptors_.size();
-    self->descriptors_.push_back(Descriptor(id, desc));
   };
 
   auto status_cb = [self, cb = std::move(callback)](att::Status status) {
@@ -177,6 +165,24 @@ void RemoteCharacteristic::DiscoverDescriptors(att::Handle range_end,
                                std::move(desc_cb), std::move(status_cb));
 }
 
+bool RemoteCharacteristic::AddDescriptor(const DescriptorData& desc) {
+  ZX_DEBUG_ASSERT(thread_checker_.IsCreationThreadCurrent());
+
+  if (desc.type == types::kClientCharacteristicConfig) {
+    if (ccc_handle_ != att::kInvalidHandle) {
+      bt_log(TRACE, "gatt", "characteristic has more than one CCC descriptor!");
+      return false;
+    }
+    ccc_handle_ = desc.handle;
+  }
+
+  // See comments about "ID scheme" in remote_characteristics.h
+  ZX_DEBUG_ASSERT(descriptors_.size() <= std::numeric_limits<uint16_t>::max());
+  IdType id = (id_ << 16) | descriptors_.size();
+  descriptors_.push_back(Descriptor(id, desc));
+  return true;
+}
+
 void RemoteCharacteristic::EnableNotifications(
     ValueCallback value_callback, NotifyStatusCallback status_callback,
     async_dispatcher_t* dispatcher) {
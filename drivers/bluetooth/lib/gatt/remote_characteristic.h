@@ -114,6 +114,11 @@ class RemoteCharacteristic final {
   // outlives the discovery procedure.
   void DiscoverDescriptors(att::Handle range_end, att::StatusCallback callback);
 
+  // Adds |desc| to the descriptors of this characteristic, as if it had been
+  // discovered. Returns false if |desc| is a second Client Characteristic
+  // Configuration descriptor.
+  bool AddDescriptor(const DescriptorData& desc);
+
   // (See RemoteService::NotifyCharacteristic in remote_service.h).
   void EnableNotifications(ValueCallback value_callback,
                            NotifyStatusCallback status_callback,
@@ -396,6 +396,36 @@ void RemoteService::StartDescriptorDiscovery() {
   }
 }
 
+void RemoteService::RestoreCharacteristics(
+    const std::vector<CharacteristicData>& characteristics,
+    const std::vector<DescriptorData>& descriptors) {
+  ZX_DEBUG_ASSERT(IsOnGattThread());
+  ZX_DEBUG_ASSERT(characteristics_.empty());
+  ZX_DEBUG_ASSERT(pending_discov_reqs_.empty());
+
+  // Add all characteristics before their descriptors, as moving a
+  // RemoteCharacteristic (e.g. while |characteristics_| grows) drops them.
+  for (const auto& chrc : characteristics) {
+    IdType id = characteristics_.size();
+    characteristics_.emplace_back(client_, id, chrc);
+  }
+
+  // Each descriptor belongs to the last characteristic that precedes it.
+  size_t index = 0u;
+  for (const auto& desc : descriptors) {
+    while (index + 1 < characteristics_.size() &&
+           characteristics_[index + 1].info().handle < desc.handle) {
+      index++;
+    }
+    if (index < characteristics_.size() &&
+        characteristics_[index].info().value_handle < desc.handle) {
+      characteristics_[index].AddDescriptor(desc);
+    }
+  }
+
+  remaining_descriptor_requests_ = 0u;
+}
+
 bool RemoteService::IsOnGattThread() const {
   return async_get_default_dispatcher() == gatt_dispatcher_;
 }
@@ -447,6 +477,10 @@ void RemoteService::CompleteCharacteristicDiscovery(att::Status status) {
   ZX_DEBUG_ASSERT(!pending_discov_reqs_.empty());
   ZX_DEBUG_ASSERT(!status || remaining_descriptor_requests_ == 0u);
 
+  if (status && discovery_handler_) {
+    discovery_handler_();
+  }
+
   auto pending = std::move(pending_discov_reqs_);
   for (auto& req : pending) {
     ReportCharacteristics(status, std::move(req.callback), req.dispatcher);
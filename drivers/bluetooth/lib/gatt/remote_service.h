@@ -177,6 +177,19 @@ class RemoteService : public fbl::RefCounted<RemoteService> {
   common::HostError GetCharacteristic(IdType id,
                                       RemoteCharacteristic** out_char);
 
+  // Fills in the characteristics of this service and their |descriptors| as
+  // if they had been discovered. Called by RemoteServiceManager with the
+  // contents of its database cache, before characteristic discovery starts.
+  void RestoreCharacteristics(
+      const std::vector<CharacteristicData>& characteristics,
+      const std::vector<DescriptorData>& descriptors);
+
+  // Assigns a handler that runs on the GATT thread each time characteristic
+  // discovery succeeds. Used by RemoteServiceManager to cache the results.
+  void set_discovery_handler(fit::closure handler) {
+    discovery_handler_ = std::move(handler);
+  }
+
   // Called immediately after characteristic discovery to initiate descriptor
   // discovery.
   void StartDescriptorDiscovery() __TA_EXCLUDES(mtx_);
@@ -235,6 +248,10 @@ class RemoteService : public fbl::RefCounted<RemoteService> {
   // discovery completes.
   RemoteCharacteristicList characteristics_;
 
+  // Called when characteristic discovery succeeds. Accessed only on the GATT
+  // dispatcher.
+  fit::closure discovery_handler_;
+
   // The number of pending characteristic descriptor discoveries.
   // Characteristics get marked as ready when this number reaches 0.
   size_t remaining_descriptor_requests_;
@@ -46,9 +46,11 @@ void RemoteServiceManager::ServiceListRequest::Complete(
 }
 
 RemoteServiceManager::RemoteServiceManager(std::unique_ptr<Client> client,
-                                           async_dispatcher_t* gatt_dispatcher)
+                                           async_dispatcher_t* gatt_dispatcher,
+                                           DatabaseCache* cache)
     : gatt_dispatcher_(gatt_dispatcher),
       client_(std::move(client)),
+      cache_(cache),
       initialized_(false),
       weak_ptr_factory_(this) {
   ZX_DEBUG_ASSERT(gatt_dispatcher_);
@@ -108,45 +110,148 @@ void RemoteServiceManager::Initialize(att::StatusCallback cb) {
       return;
     }
 
-    auto svc_cb = [self](const ServiceData& service_data) {
-      if (!self)
-        return;
+    if (self->cache_) {
+      self->ReadDatabaseHash(std::move(init_cb));
+    } else {
+      self->DiscoverServices(std::move(init_cb));
+    }
+  });
+}
 
-      auto svc = fbl::AdoptRef(new RemoteService(
-          service_data, self->client_->AsWeakPtr(), self->gatt_dispatcher_));
-      if (!svc) {
-        bt_log(TRACE, "gatt", "failed to allocate RemoteService");
-        return;
-      }
+void RemoteServiceManager::ReadDatabaseHash(att::StatusCallback callback) {
+  auto self = weak_ptr_factory_.GetWeakPtr();
+  auto hash_cb = [self, cb = std::move(callback)](
+                     att::Status status, att::Handle,
+                     const common::ByteBuffer& value) mutable {
+    if (!self) {
+      cb(att::Status(HostError::kFailed));
+      return;
+    }
 
-      self->services_[svc->handle()] = svc;
-    };
+    // The Database Hash is optional (v5.1, Vol 3, Part G, 7.3). Without it
+    // there is no telling whether the cached database is still current.
+    if (!status || value.size() != sizeof(DatabaseHash)) {
+      bt_log(TRACE, "gatt", "no database hash; not caching services");
+      self->cache_->Clear();
+      self->DiscoverServices(std::move(cb));
+      return;
+    }
 
-    auto status_cb = [self, init_cb = std::move(init_cb)](att::Status status) {
-      if (!self) {
-        init_cb(att::Status(HostError::kFailed));
-        return;
-      }
+    DatabaseHash hash;
+    common::MutableBufferView(hash.data(), hash.size()).Write(value);
+    if (!self->cache_->Matches(hash)) {
+      bt_log(TRACE, "gatt", "database hash changed; discovering services");
+      self->cache_->Reset(hash);
+      self->DiscoverServices(std::move(cb));
+      return;
+    }
+
+    bt_log(TRACE, "gatt", "database hash unchanged; using cached services");
+    self->RestoreServices();
+    cb(att::Status());
+  };
+
+  client_->ReadByTypeRequest(types::kDatabaseHashCharacteristic,
+                             att::kHandleMin, att::kHandleMax,
+                             std::move(hash_cb));
+}
+
+void RemoteServiceManager::DiscoverServices(att::StatusCallback callback) {
+  auto self = weak_ptr_factory_.GetWeakPtr();
+  auto svc_cb = [self](const ServiceData& service_data) {
+    if (!self)
+      return;
+
+    self->AddService(service_data);
+    if (self->cache_) {
+      self->cache_->AddService(service_data);
+    }
+  };
+
+  auto status_cb = [self, cb = std::move(callback)](att::Status status) {
+    if (!self) {
+      cb(att::Status(HostError::kFailed));
+      return;
+    }
 
-      // Service discovery support is mandatory for servers (v5.0, Vol 3,
-      // Part G, 4.2).
-      if (bt_is_error(status, TRACE, "gatt", "failed to discover services")) {
-        ;
-        // Clear services that were buffered so far.
-        self->ClearServices();
-      } else if (self->svc_watcher_) {
-        // Notify all discovered services here.
-        for (auto& iter : self->services_) {
-          self->svc_watcher_(iter.second);
-        }
+    // Service discovery support is mandatory for servers (v5.0, Vol 3,
+    // Part G, 4.2).
+    if (bt_is_error(status, TRACE, "gatt", "failed to discover services")) {
+      // Clear services that were buffered so far.
+      self->ClearServices();
+      if (self->cache_) {
+        self->cache_->Clear();
+      }
+    } else if (self->svc_watcher_) {
+      // Notify all discovered services here.
+      for (auto& iter : self->services_) {
+        self->svc_watcher_(iter.second);
       }
+    }
 
-      init_cb(status);
-    };
+    cb(status);
+  };
 
-    self->client_->DiscoverPrimaryServices(std::move(svc_cb),
-                                           std::move(status_cb));
-  });
+  client_->DiscoverPrimaryServices(std::move(svc_cb), std::move(status_cb));
+}
+
+fbl::RefPtr<RemoteService> RemoteServiceManager::AddService(
+    const ServiceData& service_data) {
+  auto svc = fbl::AdoptRef(
+      new RemoteService(service_data, client_->AsWeakPtr(), gatt_dispatcher_));
+  if (!svc) {
+    bt_log(TRACE, "gatt", "failed to allocate RemoteService");
+    return nullptr;
+  }
+
+  if (cache_) {
+    svc->set_discovery_handler(
+        [self = weak_ptr_factory_.GetWeakPtr(), handle = svc->handle()] {
+          if (self) {
+            self->CacheCharacteristics(handle);
+          }
+        });
+  }
+
+  services_[svc->handle()] = svc;
+  return svc;
+}
+
+void RemoteServiceManager::RestoreServices() {
+  ZX_DEBUG_ASSERT(cache_);
+  ZX_DEBUG_ASSERT(services_.empty());
+
+  for (const auto& cached : cache_->services()) {
+    auto svc = AddService(cached.info);
+    if (svc && cached.characteristics_discovered) {
+      svc->RestoreCharacteristics(cached.characteristics, cached.descriptors);
+    }
+  }
+
+  if (svc_watcher_) {
+    for (auto& iter : services_) {
+      svc_watcher_(iter.second);
+    }
+  }
+}
+
+void RemoteServiceManager::CacheCharacteristics(att::Handle handle) {
+  ZX_DEBUG_ASSERT(cache_);
+
+  auto svc = FindService(handle);
+  if (!svc)
+    return;
+
+  std::vector<CharacteristicData> characteristics;
+  std::vector<DescriptorData> descriptors;
+  for (const auto& chrc : svc->characteristics_) {
+    characteristics.push_back(chrc.info());
+    for (const auto& desc : chrc.descriptors()) {
+      descriptors.push_back(desc.info());
+    }
+  }
+  cache_->SetCharacteristics(handle, std::move(characteristics),
+                             std::move(descriptors));
 }
 
 void RemoteServiceManager::ListServices(const std::vector<common::UUID>& uuids,
@@ -14,6 +14,7 @@
 #include <zircon/assert.h>
 
 #include "garnet/drivers/bluetooth/lib/att/status.h"
+#include "garnet/drivers/bluetooth/lib/gatt/database_cache.h"
 #include "garnet/drivers/bluetooth/lib/gatt/gatt.h"
 #include "garnet/drivers/bluetooth/lib/gatt/remote_service.h"
 
@@ -38,8 +39,13 @@ namespace internal {
 // specific thread.
 class RemoteServiceManager final {
  public:
+  // If a |cache| is provided, Initialize() reads the peer's Database Hash and
+  // restores the services from |cache| instead of discovering them if it holds
+  // the database with that hash. Otherwise |cache| is refilled with what gets
+  // discovered. |cache| must outlive this object.
   RemoteServiceManager(std::unique_ptr<Client> client,
-                       async_dispatcher_t* gatt_dispatcher);
+                       async_dispatcher_t* gatt_dispatcher,
+                       DatabaseCache* cache = nullptr);
   ~RemoteServiceManager();
 
   // Adds a handler to be notified when a new service is added.
@@ -49,7 +55,8 @@ class RemoteServiceManager final {
   }
 
   // Initiates the Exchange MTU procedure followed by primary service
-  // discovery. |callback| is called to notify the result of the procedure.
+  // discovery, which is skipped if the services are cached. |callback| is
+  // called to notify the result of the procedure.
   void Initialize(att::StatusCallback callback);
 
   // Returns a vector containing discovered services that match any of the given
@@ -87,6 +94,23 @@ class RemoteServiceManager final {
     FXL_DISALLOW_COPY_AND_ASSIGN(ServiceListRequest);
   };
 
+  // Reads the peer's Database Hash and then either restores the services from
+  // |cache_| or discovers them.
+  void ReadDatabaseHash(att::StatusCallback callback);
+
+  // Performs primary service discovery.
+  void DiscoverServices(att::StatusCallback callback);
+
+  // Creates a RemoteService for |service_data| and adds it to |services_|.
+  fbl::RefPtr<RemoteService> AddService(const ServiceData& service_data);
+
+  // Creates the services held in |cache_|.
+  void RestoreServices();
+
+  // Records the characteristics of the service that starts at |handle| in
+  // |cache_|.
+  void CacheCharacteristics(att::Handle handle);
+
   // Shuts down and cleans up all services.
   void ClearServices();
 
@@ -97,6 +121,9 @@ class RemoteServiceManager final {
   async_dispatcher_t* gatt_dispatcher_;
   std::unique_ptr<Client> client_;
 
+  // The discovered database of the peer, if it is being cached. May be null.
+  DatabaseCache* cache_;
+
   bool initialized_;
   RemoteServiceWatcher svc_watcher_;
 
@@ -125,6 +125,74 @@ class GATT_RemoteServiceManagerTest : public ::gtest::TestLoopFixture {
     return service;
   }
 
+  // Creates a RemoteServiceManager that caches into |cache|, for a peer that
+  // has one service with a notifiable characteristic. The peer reports |hash|
+  // as its Database Hash, or has no Database Hash if |hash| is null. The fake
+  // client of the new manager is returned in |out_client|.
+  std::unique_ptr<RemoteServiceManager> CreateCachingManager(
+      DatabaseCache* cache, const DatabaseHash* hash,
+      testing::FakeClient** out_client) {
+    auto client = std::make_unique<testing::FakeClient>(dispatcher());
+    client->set_primary_services({ServiceData(1, 4, kTestServiceUuid1)});
+    client->set_characteristics(
+        {CharacteristicData(Property::kNotify, 2, 3, kTestUuid3)});
+    client->set_descriptors(
+        {DescriptorData(4, types::kClientCharacteristicConfig)});
+    client->set_read_by_type_request_callback(
+        [has_hash = !!hash, hash = hash ? *hash : DatabaseHash()](
+            const common::UUID& type, att::Handle, att::Handle,
+            auto callback) {
+          EXPECT_EQ(types::kDatabaseHashCharacteristic, type);
+          if (!has_hash) {
+            callback(att::Status(att::ErrorCode::kAttributeNotFound),
+                     att::kInvalidHandle, BufferView());
+            return;
+          }
+          callback(att::Status(), 0x0010, BufferView(hash.data(), hash.size()));
+        });
+
+    *out_client = client.get();
+    return std::make_unique<RemoteServiceManager>(std::move(client),
+                                                  dispatcher(), cache);
+  }
+
+  // Initializes |mgr| and returns the service it reports.
+  fbl::RefPtr<RemoteService> InitializeCachingManager(
+      RemoteServiceManager* mgr) {
+    att::Status status(HostError::kFailed);
+    mgr->Initialize([&status](att::Status cb_status) { status = cb_status; });
+
+    ServiceList services;
+    mgr->ListServices(std::vector<common::UUID>(),
+                      [&services](auto status, ServiceList cb_services) {
+                        services = std::move(cb_services);
+                      });
+
+    RunLoopUntilIdle();
+
+    EXPECT_TRUE(status);
+    ZX_DEBUG_ASSERT(services.size() == 1u);
+    return services[0];
+  }
+
+  // Discovers the characteristics of |service| and expects the characteristic
+  // and descriptor of a peer made by CreateCachingManager().
+  void ExpectCachingPeerCharacteristics(fbl::RefPtr<RemoteService> service) {
+    att::Status status(HostError::kFailed);
+    service->DiscoverCharacteristics(
+        [&status](att::Status cb_status, const auto& chrcs) {
+          status = cb_status;
+          ASSERT_EQ(1u, chrcs.size());
+          EXPECT_EQ(CharacteristicData(Property::kNotify, 2, 3, kTestUuid3),
+                    chrcs[0].info());
+          ASSERT_EQ(1u, chrcs[0].descriptors().size());
+          EXPECT_EQ(DescriptorData(4, types::kClientCharacteristicConfig),
+                    chrcs[0].descriptors()[0].info());
+        });
+    RunLoopUntilIdle();
+    EXPECT_TRUE(status);
+  }
+
   void EnableNotifications(
       fbl::RefPtr<RemoteService> service, IdType chr_id,
       att::Status* out_status, IdType* out_id,
@@ -1916,6 +1984,103 @@ TEST_F(GATT_RemoteServiceManagerTest, DisableNotificationsManyHandlers) {
   EXPECT_EQ(1, ccc_write_count);
 }
 
+constexpr DatabaseHash kTestDatabaseHash1 = {{0, 1, 2, 3, 4, 5, 6, 7, 8, 9,
+                                              10, 11, 12, 13, 14, 15}};
+constexpr DatabaseHash kTestDatabaseHash2 = {{15, 14, 13, 12, 11, 10, 9, 8, 7,
+                                              6, 5, 4, 3, 2, 1, 0}};
+
+TEST_F(GATT_RemoteServiceManagerTest, DatabaseCacheFilledOnFirstConnection) {
+  DatabaseCache cache;
+  testing::FakeClient* client;
+  auto mgr = CreateCachingManager(&cache, &kTestDatabaseHash1, &client);
+  auto service = InitializeCachingManager(mgr.get());
+  EXPECT_EQ(1u, client->service_discovery_count());
+
+  ASSERT_EQ(1u, cache.services().size());
+  EXPECT_FALSE(cache.services()[0].characteristics_discovered);
+
+  ExpectCachingPeerCharacteristics(service);
+  EXPECT_EQ(1u, client->chrc_discovery_count());
+  EXPECT_EQ(1u, client->desc_discovery_count());
+
+  EXPECT_TRUE(cache.Matches(kTestDatabaseHash1));
+  ASSERT_EQ(1u, cache.services().size());
+  const auto& cached = cache.services()[0];
+  EXPECT_EQ(service->handle(), cached.info.range_start);
+  EXPECT_TRUE(cached.characteristics_discovered);
+  EXPECT_EQ(1u, cached.characteristics.size());
+  EXPECT_EQ(1u, cached.descriptors.size());
+}
+
+TEST_F(GATT_RemoteServiceManagerTest, DatabaseCacheSkipsDiscoveryOnReconnect) {
+  DatabaseCache cache;
+  testing::FakeClient* client;
+  auto mgr = CreateCachingManager(&cache, &kTestDatabaseHash1, &client);
+  ExpectCachingPeerCharacteristics(InitializeCachingManager(mgr.get()));
+  mgr = nullptr;
+
+  // The peer reconnects with the same database.
+  mgr = CreateCachingManager(&cache, &kTestDatabaseHash1, &client);
+  auto service = InitializeCachingManager(mgr.get());
+  EXPECT_EQ(0u, client->service_discovery_count());
+  EXPECT_EQ(kTestServiceUuid1, service->uuid());
+
+  ExpectCachingPeerCharacteristics(service);
+  EXPECT_EQ(0u, client->chrc_discovery_count());
+  EXPECT_EQ(0u, client->desc_discovery_count());
+
+  // The restored CCC descriptor is used to enable notifications.
+  att::Handle ccc_handle = att::kInvalidHandle;
+  client->set_write_request_callback(
+      [&](att::Handle handle, const auto&, auto status_callback) {
+        ccc_handle = handle;
+        status_callback(att::Status());
+      });
+
+  att::Status status(HostError::kFailed);
+  IdType id;
+  EnableNotifications(service, 0, &status, &id);
+  EXPECT_TRUE(status);
+  EXPECT_EQ(4u, ccc_handle);
+}
+
+TEST_F(GATT_RemoteServiceManagerTest, DatabaseCacheDiscardedOnHashChange) {
+  DatabaseCache cache;
+  testing::FakeClient* client;
+  auto mgr = CreateCachingManager(&cache, &kTestDatabaseHash1, &client);
+  ExpectCachingPeerCharacteristics(InitializeCachingManager(mgr.get()));
+  mgr = nullptr;
+
+  // The peer reconnects with a different database.
+  mgr = CreateCachingManager(&cache, &kTestDatabaseHash2, &client);
+  auto service = InitializeCachingManager(mgr.get());
+  EXPECT_EQ(1u, client->service_discovery_count());
+  EXPECT_TRUE(cache.Matches(kTestDatabaseHash2));
+  ASSERT_EQ(1u, cache.services().size());
+  EXPECT_FALSE(cache.services()[0].characteristics_discovered);
+
+  ExpectCachingPeerCharacteristics(service);
+  EXPECT_EQ(1u, client->chrc_discovery_count());
+  EXPECT_EQ(1u, client->desc_discovery_count());
+}
+
+TEST_F(GATT_RemoteServiceManagerTest, DatabaseCacheNotUsedWithoutHash) {
+  DatabaseCache cache;
+  testing::FakeClient* client;
+  auto mgr = CreateCachingManager(&cache, nullptr, &client);
+  ExpectCachingPeerCharacteristics(InitializeCachingManager(mgr.get()));
+  EXPECT_EQ(1u, client->service_discovery_count());
+  EXPECT_TRUE(cache.services().empty());
+  mgr = nullptr;
+
+  // Without a Database Hash the services are discovered on every connection.
+  mgr = CreateCachingManager(&cache, nullptr, &client);
+  ExpectCachingPeerCharacteristics(InitializeCachingManager(mgr.get()));
+  EXPECT_EQ(1u, client->service_discovery_count());
+  EXPECT_EQ(1u, client->chrc_discovery_count());
+  EXPECT_TRUE(cache.services().empty());
+}
+
 }  // namespace
 }  // namespace internal
 }  // namespace gatt
@@ -0,0 +1,190 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Measures how ATT request handling scales with the size of the attribute
+// database, by driving requests through a gatt::Server and att::Bearer over a
+// FakeChannel. Handle lookups should stay logarithmic in the number of
+// groupings, so the cost per request should barely grow across database sizes.
+
+#include <chrono>
+
+#include "garnet/drivers/bluetooth/lib/att/database.h"
+#include "garnet/drivers/bluetooth/lib/common/test_helpers.h"
+#include "garnet/drivers/bluetooth/lib/gatt/gatt_defs.h"
+#include "garnet/drivers/bluetooth/lib/gatt/server.h"
+#include "garnet/drivers/bluetooth/lib/l2cap/fake_channel_test.h"
+#include "lib/fxl/macros.h"
+
+namespace btlib {
+namespace gatt {
+namespace {
+
+constexpr char kTestDeviceId[] = "11223344-1122-1122-1122-112233445566";
+constexpr common::UUID kTestType16((uint16_t)0xBEEF);
+
+// Attributes in each service, following its declaration.
+constexpr size_t kAttrsPerService = 8;
+constexpr size_t kRequestCount = 2000;
+
+const auto kTestValue = common::CreateStaticByteBuffer('f', 'o', 'o');
+const auto kServiceDeclValue = common::CreateStaticByteBuffer(0xEF, 0xBE);
+
+class GATT_ServerBenchmarkTest : public l2cap::testing::FakeChannelTest {
+ public:
+  GATT_ServerBenchmarkTest() = default;
+  ~GATT_ServerBenchmarkTest() override = default;
+
+ protected:
+  void SetUp() override {
+    db_ = att::Database::Create();
+
+    ChannelOptions options(l2cap::kATTChannelId);
+    auto fake_chan = CreateFakeChannel(options);
+    att_ = att::Bearer::Create(std::move(fake_chan));
+    server_ = std::make_unique<Server>(kTestDeviceId, db_, att_);
+  }
+
+  void TearDown() override {
+    server_ = nullptr;
+    att_ = nullptr;
+    db_ = nullptr;
+  }
+
+  // Adds |service_count| services to the database, then removes every other
+  // one so that lookups have to skip over the gaps.
+  void Populate(size_t service_count) {
+    std::vector<att::Handle> starts;
+    for (size_t i = 0; i < service_count; i++) {
+      auto* grp = db_->NewGrouping(types::kPrimaryService, kAttrsPerService,
+                                   kServiceDeclValue);
+      ASSERT_TRUE(grp);
+      for (size_t j = 0; j < kAttrsPerService; j++) {
+        grp->AddAttribute(kTestType16,
+                          att::AccessRequirements(false, false, false),
+                          att::AccessRequirements())
+            ->SetValue(kTestValue);
+      }
+      grp->set_active(true);
+      starts.push_back(grp->start_handle());
+    }
+    for (size_t i = 0; i < starts.size(); i += 2) {
+      ASSERT_TRUE(db_->RemoveGrouping(starts[i]));
+    }
+  }
+
+  // Handles of the attributes in the database, spread evenly over it.
+  std::vector<att::Handle> SampleHandles() const {
+    std::vector<att::Handle> handles;
+    for (const auto& grp : db_->groupings()) {
+      for (const auto& attr : grp.attributes()) {
+        handles.push_back(attr.handle());
+      }
+    }
+    std::vector<att::Handle> sample;
+    for (size_t i = 0; i < kRequestCount; i++) {
+      sample.push_back(handles[(i * 7919) % handles.size()]);
+    }
+    return sample;
+  }
+
+  // Sends each of |requests| in turn (ATT allows one outstanding request) and
+  // returns the mean time to answer one, in nanoseconds. Fails the test unless
+  // each was answered with |response_opcode|.
+  double Run(const std::vector<common::DynamicByteBuffer>& requests,
+             att::OpCode response_opcode) {
+    size_t responses = 0;
+    fake_chan()->SetSendCallback(
+        [&](auto packet) {
+          if ((*packet)[0] == response_opcode)
+            responses++;
+        },
+        dispatcher());
+
+    const auto start = std::chrono::steady_clock::now();
+    for (const auto& request : requests) {
+      fake_chan()->Receive(request);
+      RunLoopUntilIdle();
+    }
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+
+    EXPECT_EQ(requests.size(), responses);
+    return std::chrono::duration<double, std::nano>(elapsed).count() /
+           requests.size();
+  }
+
+  att::Database* db() const { return db_.get(); }
+
+ private:
+  fxl::RefPtr<att::Database> db_;
+  fxl::RefPtr<att::Bearer> att_;
+  std::unique_ptr<Server> server_;
+
+  FXL_DISALLOW_COPY_AND_ASSIGN(GATT_ServerBenchmarkTest);
+};
+
+std::vector<common::DynamicByteBuffer> ReadRequests(
+    const std::vector<att::Handle>& handles) {
+  std::vector<common::DynamicByteBuffer> requests;
+  for (att::Handle handle : handles) {
+    requests.emplace_back(common::CreateStaticByteBuffer(
+        att::kReadRequest, handle & 0xFF, handle >> 8));
+  }
+  return requests;
+}
+
+std::vector<common::DynamicByteBuffer> FindInformationRequests(
+    const std::vector<att::Handle>& handles) {
+  std::vector<common::DynamicByteBuffer> requests;
+  for (att::Handle handle : handles) {
+    const att::Handle end = handle + kAttrsPerService;
+    requests.emplace_back(common::CreateStaticByteBuffer(
+        att::kFindInformationRequest, handle & 0xFF, handle >> 8, end & 0xFF,
+        end >> 8));
+  }
+  return requests;
+}
+
+std::vector<common::DynamicByteBuffer> ReadByTypeRequests(
+    const std::vector<att::Handle>& handles) {
+  std::vector<common::DynamicByteBuffer> requests;
+  for (att::Handle handle : handles) {
+    const att::Handle end = handle + kAttrsPerService;
+    requests.emplace_back(common::CreateStaticByteBuffer(
+        att::kReadByTypeRequest, handle & 0xFF, handle >> 8, end & 0xFF,
+        end >> 8, 0xEF, 0xBE));
+  }
+  return requests;
+}
+
+TEST_F(GATT_ServerBenchmarkTest, RequestsScaleWithDatabaseSize) {
+  // The largest size nearly exhausts the 16-bit handle space.
+  constexpr size_t kServiceCounts[] = {16, 256, 1024, 7000};
+
+  common::PrintBenchmarkResult(
+      "services,attributes,read_ns,find_information_ns,read_by_type_ns\n");
+  size_t populated = 0;
+  for (size_t service_count : kServiceCounts) {
+    // Grow the database to the next size.
+    Populate(service_count - populated);
+    populated = service_count;
+
+    size_t attributes = 0;
+    for (const auto& grp : db()->groupings()) {
+      attributes += grp.attributes().size();
+    }
+    const auto handles = SampleHandles();
+    const double read_ns = Run(ReadRequests(handles), att::kReadResponse);
+    const double find_information_ns =
+        Run(FindInformationRequests(handles), att::kFindInformationResponse);
+    const double read_by_type_ns =
+        Run(ReadByTypeRequests(handles), att::kReadByTypeResponse);
+    common::PrintBenchmarkResult("%zu,%zu,%.0f,%.0f,%.0f\n",
+                                 db()->groupings().size(), attributes, read_ns,
+                                 find_information_ns, read_by_type_ns);
+  }
+}
+
+}  // namespace
+}  // namespace gatt
+}  // namespace btlib
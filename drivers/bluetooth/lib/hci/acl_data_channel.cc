@@ -115,7 +115,9 @@ void ACLDataChannel::ShutDown() {
 
   {
     std::lock_guard<std::mutex> lock(send_mutex_);
-    send_queue_.clear();
+    link_queues_.clear();
+    bredr_active_links_.clear();
+    le_active_links_.clear();
   }
 
   io_dispatcher_ = nullptr;
@@ -131,7 +133,8 @@ void ACLDataChannel::SetDataRxHandler(DataReceivedCallback rx_callback,
 }
 
 bool ACLDataChannel::SendPacket(ACLDataPacketPtr data_packet,
-                                Connection::LinkType ll_type) {
+                                Connection::LinkType ll_type,
+                                PacketPriority priority) {
   if (!is_initialized_) {
     bt_log(TRACE, "hci", "cannot send packets while uninitialized");
     return false;
@@ -146,7 +149,7 @@ bool ACLDataChannel::SendPacket(ACLDataPacketPtr data_packet,
 
   std::lock_guard<std::mutex> lock(send_mutex_);
 
-  send_queue_.emplace_back(QueuedDataPacket(ll_type, std::move(data_packet)));
+  EnqueuePacketLocked(std::move(data_packet), ll_type, priority);
 
   TrySendNextQueuedPacketsLocked();
 
@@ -154,7 +157,8 @@ bool ACLDataChannel::SendPacket(ACLDataPacketPtr data_packet,
 }
 
 bool ACLDataChannel::SendPackets(common::LinkedList<ACLDataPacket> packets,
-                                 Connection::LinkType ll_type) {
+                                 Connection::LinkType ll_type,
+                                 PacketPriority priority) {
   if (!is_initialized_) {
     bt_log(TRACE, "hci", "cannot send packets while uninitialized");
     return false;
@@ -176,7 +180,7 @@ bool ACLDataChannel::SendPackets(common::LinkedList<ACLDataPacket> packets,
   std::lock_guard<std::mutex> lock(send_mutex_);
 
   while (!packets.is_empty()) {
-    send_queue_.emplace_back(QueuedDataPacket(ll_type, packets.pop_front()));
+    EnqueuePacketLocked(packets.pop_front(), ll_type, priority);
   }
 
   TrySendNextQueuedPacketsLocked();
@@ -186,11 +190,20 @@ bool ACLDataChannel::SendPackets(common::LinkedList<ACLDataPacket> packets,
 
 bool ACLDataChannel::ClearLinkState(hci::ConnectionHandle handle) {
   std::lock_guard<std::mutex> lock(send_mutex_);
+
+  // Drop the packets that are still queued for the link.
+  auto queue_iter = link_queues_.find(handle);
+  const bool had_queued_packets = queue_iter != link_queues_.end();
+  if (had_queued_packets) {
+    GetActiveLinksLocked(queue_iter->second.ll_type).remove(handle);
+    link_queues_.erase(queue_iter);
+  }
+
   auto iter = pending_links_.find(handle);
   if (iter == pending_links_.end()) {
     bt_log(TRACE, "hci", "no pending packets on connection (handle: %#.4x)",
            handle);
-    return false;
+    return had_queued_packets;
   }
 
   const PendingPacketData& data = iter->second;
@@ -284,72 +297,128 @@ void ACLDataChannel::TrySendNextQueuedPacketsLocked() {
   if (!is_initialized_)
     return;
 
-  size_t avail_bredr_packets = GetNumFreeBREDRPacketsLocked();
-  size_t avail_le_packets = GetNumFreeLEPacketsLocked();
-
-  // Based on what we know about controller buffer availability, we process
-  // packets that are currently in |send_queue_|. The packets that can be sent
-  // are added to |to_send|. Packets that cannot be sent remain in
-  // |send_queue_|.
-  DataPacketQueue to_send;
-  for (auto iter = send_queue_.begin(); iter != send_queue_.end();) {
-    if (!avail_bredr_packets && !avail_le_packets)
-      break;
-
-    if (send_queue_.front().ll_type == Connection::LinkType::kACL &&
-        avail_bredr_packets) {
-      --avail_bredr_packets;
-    } else if (send_queue_.front().ll_type == Connection::LinkType::kLE &&
-               avail_le_packets) {
-      --avail_le_packets;
-    } else {
-      // Cannot send packet yet, so skip it.
-      ++iter;
-      continue;
-    }
+  // If the controller has no dedicated LE buffer then LE links are served from
+  // |bredr_active_links_| and |le_active_links_| is empty.
+  const size_t bredr_packets_sent = SendQueuedPacketsLocked(
+      &bredr_active_links_, GetNumFreeBREDRPacketsLocked());
+  const size_t le_packets_sent =
+      SendQueuedPacketsLocked(&le_active_links_, GetNumFreeLEPacketsLocked());
+
+  IncrementTotalNumPacketsLocked(bredr_packets_sent);
+  IncrementLETotalNumPacketsLocked(le_packets_sent);
+}
 
-    to_send.push_back(std::move(*iter));
-    send_queue_.erase(iter++);
+common::LinkedList<ACLDataPacket>* ACLDataChannel::LinkQueue::Next() {
+  if (!low_priority.is_empty() &&
+      low_priority.front().packet_boundary_flag() ==
+          ACLPacketBoundaryFlag::kContinuingFragment) {
+    return &low_priority;
   }
+  if (!high_priority.is_empty())
+    return &high_priority;
+  if (!low_priority.is_empty())
+    return &low_priority;
+  return nullptr;
+}
 
-  if (to_send.empty())
-    return;
+void ACLDataChannel::EnqueuePacketLocked(ACLDataPacketPtr packet,
+                                         Connection::LinkType ll_type,
+                                         PacketPriority priority) {
+  const ConnectionHandle handle = packet->connection_handle();
+  auto iter = link_queues_.find(handle);
+  if (iter == link_queues_.end()) {
+    iter = link_queues_
+               .emplace(handle, LinkQueue(ll_type, GetBufferMTU(ll_type)))
+               .first;
+    GetActiveLinksLocked(ll_type).push_back(handle);
+  }
 
-  size_t bredr_packets_sent = 0;
-  size_t le_packets_sent = 0;
-  while (!to_send.empty()) {
-    const QueuedDataPacket& packet = to_send.front();
+  LinkQueue& queue = iter->second;
+  if (priority == PacketPriority::kHigh) {
+    queue.high_priority.push_back(std::move(packet));
+  } else {
+    queue.low_priority.push_back(std::move(packet));
+  }
+}
 
-    auto packet_bytes = packet.packet->view().data();
-    zx_status_t status =
-        channel_.write(0, packet_bytes.data(), packet_bytes.size(), nullptr, 0);
-    if (status < 0) {
-      bt_log(ERROR, "hci",
-             "failed to send data packet to HCI driver (%s) - dropping packet",
-             zx_status_get_string(status));
-      to_send.pop_front();
-      continue;
+std::list<ConnectionHandle>& ACLDataChannel::GetActiveLinksLocked(
+    Connection::LinkType ll_type) {
+  if (ll_type == Connection::LinkType::kLE && le_buffer_info_.IsAvailable())
+    return le_active_links_;
+  return bredr_active_links_;
+}
+
+size_t ACLDataChannel::SendQueuedPacketsLocked(
+    std::list<ConnectionHandle>* links, size_t free_packets) {
+  size_t sent = 0;
+  auto send_next = [&](LinkQueue* queue) {
+    auto* from = queue->Next();
+    auto packet = from->pop_front();
+    if (from == &queue->low_priority) {
+      ZX_DEBUG_ASSERT(queue->deficit >= packet->view().payload_size());
+      queue->deficit -= packet->view().payload_size();
     }
+    if (WritePacketLocked(*packet, queue->ll_type))
+      sent++;
+  };
 
-    if (packet.ll_type == Connection::LinkType::kACL) {
-      ++bredr_packets_sent;
-    } else {
-      ++le_packets_sent;
+  // High priority packets are sent first on every link.
+  for (ConnectionHandle handle : *links) {
+    LinkQueue* queue = &link_queues_.find(handle)->second;
+    while (sent < free_packets && queue->Next() == &queue->high_priority) {
+      send_next(queue);
     }
+  }
 
-    auto iter = pending_links_.find(packet.packet->connection_handle());
-    if (iter == pending_links_.end()) {
-      pending_links_[packet.packet->connection_handle()] =
-          PendingPacketData(packet.ll_type);
-    } else {
-      iter->second.count++;
+  // Then the links take turns by deficit round robin: each turn credits a link
+  // with a buffer MTU worth of bytes, which it can spend on packets now or save
+  // for its next turn. Links get an equal share of the bandwidth however large
+  // their packets are.
+  while (!links->empty() && sent < free_packets) {
+    auto iter = link_queues_.find(links->front());
+    ZX_DEBUG_ASSERT(iter != link_queues_.end());
+    LinkQueue* queue = &iter->second;
+
+    common::LinkedList<ACLDataPacket>* next;
+    while (sent < free_packets && (next = queue->Next()) &&
+           (next == &queue->high_priority ||
+            next->front().view().payload_size() <= queue->deficit)) {
+      send_next(queue);
     }
 
-    to_send.pop_front();
+    if (!queue->Next()) {
+      links->pop_front();
+      link_queues_.erase(iter);
+    } else if (sent < free_packets) {
+      // The link has used up its turn.
+      queue->deficit += GetBufferMTU(queue->ll_type);
+      links->splice(links->end(), *links, links->begin());
+    }
   }
 
-  IncrementTotalNumPacketsLocked(bredr_packets_sent);
-  IncrementLETotalNumPacketsLocked(le_packets_sent);
+  return sent;
+}
+
+bool ACLDataChannel::WritePacketLocked(const ACLDataPacket& packet,
+                                       Connection::LinkType ll_type) {
+  auto packet_bytes = packet.view().data();
+  zx_status_t status =
+      channel_.write(0, packet_bytes.data(), packet_bytes.size(), nullptr, 0);
+  if (status < 0) {
+    bt_log(ERROR, "hci",
+           "failed to send data packet to HCI driver (%s) - dropping packet",
+           zx_status_get_string(status));
+    return false;
+  }
+
+  auto iter = pending_links_.find(packet.connection_handle());
+  if (iter == pending_links_.end()) {
+    pending_links_[packet.connection_handle()] = PendingPacketData(ll_type);
+  } else {
+    iter->second.count++;
+  }
+
+  return true;
 }
 
 size_t ACLDataChannel::GetNumFreeBREDRPacketsLocked() const {
@@ -108,13 +108,28 @@ class ACLDataChannel final {
   void SetDataRxHandler(DataReceivedCallback rx_callback,
                         async_dispatcher_t* rx_dispatcher);
 
+  // Priority hint for outbound data. On each link, high priority packets are
+  // sent ahead of low priority ones wherever an L2CAP PDU boundary allows, and
+  // they are not counted against the link's fair share of controller buffers.
+  // Intended for small, latency-sensitive control traffic such as signaling.
+  enum class PacketPriority {
+    kHigh,
+    kLow,
+  };
+
   // Queues the given ACL data packet to be sent to the controller. Returns
   // false if the packet cannot be queued up, e.g. if the size of |data_packet|
   // exceeds the MTU for |ll_type|.
   //
   // |data_packet| is passed by value, meaning that ACLDataChannel will take
   // ownership of it. |data_packet| must represent a valid ACL data packet.
-  bool SendPacket(ACLDataPacketPtr data_packet, Connection::LinkType ll_type);
+  //
+  // Each logical link has its own queue. Links that share a controller buffer
+  // are served by deficit round robin, so that a link with a deep queue cannot
+  // starve the others.
+  bool SendPacket(ACLDataPacketPtr data_packet,
+                  Connection::LinkType ll_type,
+                  PacketPriority priority = PacketPriority::kLow);
 
   // Queues the given list of ACL data packets to be sent to the controller. The
   // behavior is identical to that of SendPacket() with the guarantee that all
@@ -123,17 +138,17 @@ class ACLDataChannel final {
   // Takes ownership of the contents of |packets|. Returns false if |packets|
   // contains an element that exceeds the MTU for |ll_type| or it is empty.
   bool SendPackets(common::LinkedList<ACLDataPacket> packets,
-                   Connection::LinkType ll_type);
+                   Connection::LinkType ll_type,
+                   PacketPriority priority = PacketPriority::kLow);
 
   // Cleans up all outgoing data buffering state related to the logical link
-  // with the given |handle|. This must be called upon disconnection of a link
-  // to ensure that ACL flow-control works correctly.
+  // with the given |handle|, including any packets still queued for it. This
+  // must be called upon disconnection of a link to ensure that ACL flow-control
+  // works correctly.
   //
-  // TODO(armansito): This doesn't fix things for subsequent data packets on
-  // this |handle| (either already queued by ACLDataChannel or waiting to be
-  // sent in an async task). Support enabling/disabling data flow with separate
-  // packet queues for each link so that we can drop packets for closed links.
-  // This is also needed to correctly pause TX data flow during encryption pause
+  // TODO(armansito): This doesn't fix things for data packets on this |handle|
+  // that are waiting to be sent in an async task. The per-link queues could
+  // also be used to correctly pause TX data flow during encryption pause
   // (NET-1169).
   bool ClearLinkState(hci::ConnectionHandle handle);
 
@@ -150,17 +165,24 @@ class ACLDataChannel final {
   const DataBufferInfo& GetLEBufferInfo() const;
 
  private:
-  // Represents a queued ACL data packet.
-  struct QueuedDataPacket {
-    QueuedDataPacket(Connection::LinkType ll_type, ACLDataPacketPtr packet)
-        : ll_type(ll_type), packet(std::move(packet)) {}
+  // The outbound packets queued on a single logical link.
+  struct LinkQueue {
+    LinkQueue(Connection::LinkType ll_type, size_t deficit)
+        : ll_type(ll_type), deficit(deficit) {}
 
-    QueuedDataPacket() = default;
-    QueuedDataPacket(QueuedDataPacket&& other) = default;
-    QueuedDataPacket& operator=(QueuedDataPacket&& other) = default;
+    // Returns the queue holding the next packet to send on this link, or
+    // nullptr if there is none. The continuing fragments of a PDU must follow
+    // its first fragment on the link, so a high priority packet can only be
+    // sent ahead of a low priority PDU that has not been started.
+    common::LinkedList<ACLDataPacket>* Next();
 
     Connection::LinkType ll_type;
-    ACLDataPacketPtr packet;
+    common::LinkedList<ACLDataPacket> high_priority;
+    common::LinkedList<ACLDataPacket> low_priority;
+
+    // The number of low priority payload bytes that this link can still send
+    // in its current turn.
+    size_t deficit;
   };
 
   // Returns the data buffer MTU for the given connection.
@@ -174,6 +196,28 @@ class ACLDataChannel final {
   // any space available.
   void TrySendNextQueuedPacketsLocked() __TA_REQUIRES(send_mutex_);
 
+  // Adds |packet| to the queue of its link.
+  void EnqueuePacketLocked(ACLDataPacketPtr packet,
+                           Connection::LinkType ll_type,
+                           PacketPriority priority) __TA_REQUIRES(send_mutex_);
+
+  // Returns the links with queued packets that are waiting for the controller
+  // buffer that |ll_type| uses.
+  std::list<ConnectionHandle>& GetActiveLinksLocked(
+      Connection::LinkType ll_type) __TA_REQUIRES(send_mutex_);
+
+  // Sends packets queued on |links| until they are all sent or |free_packets|
+  // packets have been sent. Returns the number of packets sent.
+  size_t SendQueuedPacketsLocked(std::list<ConnectionHandle>* links,
+                                 size_t free_packets)
+      __TA_REQUIRES(send_mutex_);
+
+  // Writes |packet| to the HCI driver. Returns false if that failed, in which
+  // case the packet is dropped.
+  bool WritePacketLocked(const ACLDataPacket& packet,
+                         Connection::LinkType ll_type)
+      __TA_REQUIRES(send_mutex_);
+
   // Returns the number of BR/EDR packets for which the controller has available
   // space to buffer.
   size_t GetNumFreeBREDRPacketsLocked() const __TA_REQUIRES(send_mutex_);
@@ -254,17 +298,16 @@ class ACLDataChannel final {
   size_t num_sent_packets_ __TA_GUARDED(send_mutex_);
   size_t le_num_sent_packets_ __TA_GUARDED(send_mutex_);
 
-  // The ACL data packet queue contains the data packets that are waiting to be
-  // sent to the controller.
-  // TODO(armansito): Use priority_queue based on L2CAP channel priority.
-  // TODO(NET-1211): Keep a separate queue for each open connection. Benefits:
-  //   * Helps address the packet-prioritization TODO above.
-  //   * Also: having separate queues, which know their own
-  //     Connection::LinkType, would let us replace std::list<QueuedDataPacket>
-  //     with common::LinkedList<ACLDataPacket> which has a more efficient
-  //     memory layout.
-  using DataPacketQueue = std::list<QueuedDataPacket>;
-  DataPacketQueue send_queue_ __TA_GUARDED(send_mutex_);
+  // The data packets that are waiting to be sent to the controller, queued by
+  // connection handle.
+  std::unordered_map<ConnectionHandle, LinkQueue> link_queues_
+      __TA_GUARDED(send_mutex_);
+
+  // The handles of the links in |link_queues_| that use the BR/EDR and the LE
+  // buffers, in the order that they will be served. All of them use the BR/EDR
+  // buffer if the controller has no dedicated LE buffer.
+  std::list<ConnectionHandle> bredr_active_links_ __TA_GUARDED(send_mutex_);
+  std::list<ConnectionHandle> le_active_links_ __TA_GUARDED(send_mutex_);
 
   // Stores the link type of connections on which we have a pending packet that
   // has been sent to the controller. Entries are removed on the HCI Number Of
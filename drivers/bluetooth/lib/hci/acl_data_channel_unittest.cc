@@ -4,7 +4,9 @@
 
 #include "garnet/drivers/bluetooth/lib/hci/acl_data_channel.h"
 
+#include <algorithm>
 #include <unordered_map>
+#include <vector>
 
 #include <lib/async/cpp/task.h>
 #include <zircon/assert.h>
@@ -614,6 +616,158 @@ TEST_F(HCI_ACLDataChannelTest, ClearLinkState) {
   ASSERT_EQ(3, packet_count);
 }
 
+TEST_F(HCI_ACLDataChannelTest, ClearLinkStateDropsQueuedPackets) {
+  constexpr size_t kMaxMTU = 1024;
+  constexpr size_t kMaxNumPackets = 1;
+  constexpr ConnectionHandle kHandle1 = 1;
+  constexpr ConnectionHandle kHandle2 = 2;
+
+  InitializeACLDataChannel(DataBufferInfo(kMaxMTU, kMaxNumPackets),
+                           DataBufferInfo());
+
+  std::vector<ConnectionHandle> received;
+  test_device()->SetDataCallback(
+      [&](const common::ByteBuffer& bytes) {
+        common::PacketView<hci::ACLDataHeader> packet(
+            &bytes, bytes.size() - sizeof(ACLDataHeader));
+        received.push_back(le16toh(packet.header().handle_and_flags) & 0xFFF);
+      },
+      dispatcher());
+
+  // The first packet fills up the data buffer and the others are queued.
+  for (ConnectionHandle handle : {kHandle1, kHandle1, kHandle2}) {
+    ASSERT_TRUE(acl_data_channel()->SendPacket(
+        ACLDataPacket::New(handle, ACLPacketBoundaryFlag::kFirstNonFlushable,
+                           ACLBroadcastFlag::kPointToPoint, 1),
+        Connection::LinkType::kACL));
+  }
+
+  RunLoopUntilIdle();
+  ASSERT_EQ(1u, received.size());
+
+  // Clearing |kHandle1| frees up its buffer slot and drops its queued packet,
+  // so the packet for |kHandle2| goes out next.
+  EXPECT_TRUE(acl_data_channel()->ClearLinkState(kHandle1));
+  RunLoopUntilIdle();
+  ASSERT_EQ(2u, received.size());
+  EXPECT_EQ(kHandle2, received[1]);
+}
+
+// A link with a deep queue of packets should not hold up the packets of other
+// links that share the controller buffer.
+TEST_F(HCI_ACLDataChannelTest, SendPacketsFairlyAcrossLinks) {
+  constexpr size_t kMaxMTU = 100;
+  constexpr size_t kMaxNumPackets = 4;
+  constexpr size_t kBulkPacketCount = 20;
+  constexpr size_t kInteractivePacketCount = 2;
+  constexpr ConnectionHandle kBulkHandle = 0x0001;
+  constexpr ConnectionHandle kInteractiveHandle = 0x0002;
+
+  InitializeACLDataChannel(DataBufferInfo(kMaxMTU, kMaxNumPackets),
+                           DataBufferInfo());
+
+  std::vector<ConnectionHandle> received;
+  test_device()->SetDataCallback(
+      [&](const common::ByteBuffer& bytes) {
+        common::PacketView<hci::ACLDataHeader> packet(
+            &bytes, bytes.size() - sizeof(ACLDataHeader));
+        received.push_back(le16toh(packet.header().handle_and_flags) & 0xFFF);
+      },
+      dispatcher());
+
+  // A bulk transfer fills up the data buffer and queues up behind it, then a
+  // few small packets are sent on another link.
+  for (size_t i = 0; i < kBulkPacketCount; ++i) {
+    ASSERT_TRUE(acl_data_channel()->SendPacket(
+        ACLDataPacket::New(kBulkHandle,
+                           ACLPacketBoundaryFlag::kFirstNonFlushable,
+                           ACLBroadcastFlag::kPointToPoint, kMaxMTU),
+        Connection::LinkType::kACL));
+  }
+  for (size_t i = 0; i < kInteractivePacketCount; ++i) {
+    ASSERT_TRUE(acl_data_channel()->SendPacket(
+        ACLDataPacket::New(kInteractiveHandle,
+                           ACLPacketBoundaryFlag::kFirstNonFlushable,
+                           ACLBroadcastFlag::kPointToPoint, 10),
+        Connection::LinkType::kACL));
+  }
+
+  RunLoopUntilIdle();
+  ASSERT_EQ(kMaxNumPackets, received.size());
+  EXPECT_EQ(kMaxNumPackets, static_cast<size_t>(std::count(
+                                received.begin(), received.end(), kBulkHandle)));
+
+  // Once the controller has room again, the small packets should go out in the
+  // next batch instead of after the rest of the bulk transfer.
+  test_device()->SendCommandChannelPacket(common::CreateStaticByteBuffer(
+      0x13, 0x05,             // Event header
+      0x01,                   // Number of handles
+      0x01, 0x00, 0x04, 0x00  // 4 packets on handle 0x0001
+      ));
+  RunLoopUntilIdle();
+  ASSERT_EQ(2 * kMaxNumPackets, received.size());
+  EXPECT_EQ(kInteractivePacketCount,
+            static_cast<size_t>(std::count(received.begin() + kMaxNumPackets,
+                                           received.end(),
+                                           kInteractiveHandle)));
+}
+
+// High priority packets should be sent ahead of the low priority packets that
+// are queued on the same link, but never in the middle of a PDU.
+TEST_F(HCI_ACLDataChannelTest, SendHighPriorityPacketsFirst) {
+  constexpr size_t kMaxMTU = 1024;
+  constexpr size_t kMaxNumPackets = 1;
+  constexpr ConnectionHandle kHandle = 0x0001;
+  constexpr uint8_t kHighPriorityId = 0xFF;
+
+  InitializeACLDataChannel(DataBufferInfo(kMaxMTU, kMaxNumPackets),
+                           DataBufferInfo());
+
+  // Acknowledge each packet as soon as it is received, so that they go out one
+  // at a time.
+  std::vector<uint8_t> received;
+  test_device()->SetDataCallback(
+      [&](const common::ByteBuffer& bytes) {
+        common::PacketView<hci::ACLDataHeader> packet(
+            &bytes, bytes.size() - sizeof(ACLDataHeader));
+        received.push_back(packet.payload_bytes()[0]);
+        test_device()->SendCommandChannelPacket(common::CreateStaticByteBuffer(
+            0x13, 0x05,             // Event header
+            0x01,                   // Number of handles
+            0x01, 0x00, 0x01, 0x00  // 1 packet on handle 0x0001
+            ));
+      },
+      dispatcher());
+
+  auto make_packet = [](uint8_t id, ACLPacketBoundaryFlag pbf) {
+    auto packet =
+        ACLDataPacket::New(kHandle, pbf, ACLBroadcastFlag::kPointToPoint, 1);
+    packet->mutable_view()->mutable_payload_bytes()[0] = id;
+    return packet;
+  };
+
+  // Queue three PDUs of two fragments each. The first fragment fills up the
+  // data buffer.
+  for (uint8_t id = 1; id <= 6; id += 2) {
+    common::LinkedList<ACLDataPacket> packets;
+    packets.push_back(
+        make_packet(id, ACLPacketBoundaryFlag::kFirstNonFlushable));
+    packets.push_back(
+        make_packet(id + 1, ACLPacketBoundaryFlag::kContinuingFragment));
+    ASSERT_TRUE(acl_data_channel()->SendPackets(std::move(packets),
+                                                Connection::LinkType::kACL));
+  }
+  ASSERT_TRUE(acl_data_channel()->SendPacket(
+      make_packet(kHighPriorityId, ACLPacketBoundaryFlag::kFirstNonFlushable),
+      Connection::LinkType::kACL, ACLDataChannel::PacketPriority::kHigh));
+
+  RunLoopUntilIdle();
+
+  // The high priority packet waits for the PDU in progress to complete.
+  const std::vector<uint8_t> kExpected = {1, 2, kHighPriorityId, 3, 4, 5, 6};
+  EXPECT_EQ(kExpected, received);
+}
+
 TEST_F(HCI_ACLDataChannelTest, ReceiveData) {
   constexpr size_t kMaxMTU = 5;
   constexpr size_t kMaxNumPackets = 5;
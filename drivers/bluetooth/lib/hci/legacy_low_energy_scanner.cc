@@ -289,7 +289,12 @@ void LegacyLowEnergyScanner::OnAdvertisingReportEvent(
       continue;
     }
 
-    auto iter = pending_results_.emplace(address, PendingScanResult()).first;
+    // Look the device up first: emplace() would build (and then discard) a new
+    // entry for every repeated advertisement.
+    auto iter = pending_results_.find(address);
+    if (iter == pending_results_.end()) {
+      iter = pending_results_.emplace(address, PendingScanResult()).first;
+    }
     auto& pending = iter->second;
 
     // We overwrite the pending result entry with the most recent report, even
@@ -6,13 +6,84 @@
 
 #include <endian.h>
 
+#include <algorithm>
+
 #include <zircon/assert.h>
 
 #include "garnet/drivers/bluetooth/lib/common/log.h"
+#include "garnet/drivers/bluetooth/lib/l2cap/enhanced_retransmission_engine.h"
 
 namespace btlib {
 namespace l2cap {
 namespace internal {
+namespace {
+
+using RfcOption = RetransmissionAndFlowControlOptionPayload;
+
+// Finds the Retransmission and Flow Control option in the configuration
+// |options| and copies it to |out_option|. Returns false if there is none (in
+// which case the sender is asking for Basic mode), or if the options are
+// malformed.
+bool FindRfcOption(const common::ByteBuffer& options, RfcOption* out_option) {
+  size_t offset = 0;
+  while (offset + sizeof(ConfigurationOption) <= options.size()) {
+    const auto& option = options.view(offset).As<ConfigurationOption>();
+    const size_t data_offset = offset + sizeof(ConfigurationOption);
+    if (data_offset + option.length > options.size()) {
+      return false;
+    }
+
+    const auto type = static_cast<ConfigurationOptionType>(
+        option.type & ~kConfigurationOptionHint);
+    if (type == ConfigurationOptionType::kRetransmissionAndFlowControl) {
+      if (option.length != sizeof(RfcOption)) {
+        return false;
+      }
+      *out_option = options.view(data_offset).As<RfcOption>();
+      out_option->retransmission_timeout =
+          le16toh(out_option->retransmission_timeout);
+      out_option->monitor_timeout = le16toh(out_option->monitor_timeout);
+      out_option->mps = le16toh(out_option->mps);
+      return true;
+    }
+    offset = data_offset + option.length;
+  }
+  return false;
+}
+
+// Returns the configuration options payload that carries |option|.
+common::DynamicByteBuffer MakeRfcOptions(const RfcOption& option) {
+  common::DynamicByteBuffer options(sizeof(ConfigurationOption) +
+                                    sizeof(RfcOption));
+  options[0] =
+      static_cast<uint8_t>(ConfigurationOptionType::kRetransmissionAndFlowControl);
+  options[1] = sizeof(RfcOption);
+
+  RfcOption le_option = option;
+  le_option.retransmission_timeout = htole16(option.retransmission_timeout);
+  le_option.monitor_timeout = htole16(option.monitor_timeout);
+  le_option.mps = htole16(option.mps);
+  options.WriteObj(le_option, sizeof(ConfigurationOption));
+  return options;
+}
+
+bool IsSupportedMode(ChannelMode mode) {
+  return mode == ChannelMode::kBasic ||
+         mode == ChannelMode::kEnhancedRetransmission ||
+         mode == ChannelMode::kStreaming;
+}
+
+// Returns true if we can send to the peer using the parameters that it asked
+// for in its Configuration Request.
+bool IsValidRemoteOption(const RfcOption& option) {
+  if (option.mps <= kSduLengthFieldSize) {
+    return false;
+  }
+  return option.mode != ChannelMode::kEnhancedRetransmission ||
+         option.tx_window_size != 0;
+}
+
+}  // namespace
 
 BrEdrDynamicChannelRegistry::BrEdrDynamicChannelRegistry(
     SignalingChannelInterface* sig, DynamicChannelCallback close_cb,
@@ -32,15 +103,32 @@ BrEdrDynamicChannelRegistry::BrEdrDynamicChannelRegistry(
       fit::bind_member(this, &BrEdrDynamicChannelRegistry::OnRxInfoReq));
 }
 
+void BrEdrDynamicChannelRegistry::SetPreferredChannelMode(PSM psm,
+                                                          ChannelMode mode) {
+  ZX_DEBUG_ASSERT(IsSupportedMode(mode));
+  if (mode == ChannelMode::kBasic) {
+    preferred_modes_.erase(psm);
+  } else {
+    preferred_modes_[psm] = mode;
+  }
+}
+
 DynamicChannelPtr BrEdrDynamicChannelRegistry::MakeOutbound(
     PSM psm, ChannelId local_cid) {
-  return BrEdrDynamicChannel::MakeOutbound(this, sig_, psm, local_cid);
+  return BrEdrDynamicChannel::MakeOutbound(this, sig_, psm, local_cid,
+                                           PreferredChannelMode(psm));
 }
 
 DynamicChannelPtr BrEdrDynamicChannelRegistry::MakeInbound(
     PSM psm, ChannelId local_cid, ChannelId remote_cid) {
   return BrEdrDynamicChannel::MakeInbound(this, sig_, psm, local_cid,
-                                          remote_cid);
+                                          remote_cid,
+                                          PreferredChannelMode(psm));
+}
+
+ChannelMode BrEdrDynamicChannelRegistry::PreferredChannelMode(PSM psm) const {
+  auto iter = preferred_modes_.find(psm);
+  return iter == preferred_modes_.end() ? ChannelMode::kBasic : iter->second;
 }
 
 void BrEdrDynamicChannelRegistry::OnRxConnReq(
@@ -121,9 +209,12 @@ void BrEdrDynamicChannelRegistry::OnRxInfoReq(
 
     case InformationType::kExtendedFeaturesSupported: {
       const ExtendedFeatures extended_features =
-          kExtendedFeaturesBitFixedChannels;
+          kExtendedFeaturesBitFixedChannels |
+          kExtendedFeaturesBitEnhancedRetransmission |
+          kExtendedFeaturesBitStreaming;
 
-      // Express support for the Fixed Channel Supported feature
+      // Express support for the Fixed Channel Supported feature and the
+      // Enhanced Retransmission and Streaming modes
       responder->SendExtendedFeaturesSupported(extended_features);
       break;
     }
@@ -147,18 +238,18 @@ void BrEdrDynamicChannelRegistry::OnRxInfoReq(
 
 BrEdrDynamicChannelPtr BrEdrDynamicChannel::MakeOutbound(
     DynamicChannelRegistry* registry,
-    SignalingChannelInterface* signaling_channel, PSM psm,
-    ChannelId local_cid) {
+    SignalingChannelInterface* signaling_channel, PSM psm, ChannelId local_cid,
+    ChannelMode mode) {
   return std::unique_ptr<BrEdrDynamicChannel>(new BrEdrDynamicChannel(
-      registry, signaling_channel, psm, local_cid, kInvalidChannelId));
+      registry, signaling_channel, psm, local_cid, kInvalidChannelId, mode));
 }
 
 BrEdrDynamicChannelPtr BrEdrDynamicChannel::MakeInbound(
     DynamicChannelRegistry* registry,
     SignalingChannelInterface* signaling_channel, PSM psm, ChannelId local_cid,
-    ChannelId remote_cid) {
+    ChannelId remote_cid, ChannelMode mode) {
   auto channel = std::unique_ptr<BrEdrDynamicChannel>(new BrEdrDynamicChannel(
-      registry, signaling_channel, psm, local_cid, remote_cid));
+      registry, signaling_channel, psm, local_cid, remote_cid, mode));
   channel->state_ |= kConnRequested;
   return channel;
 }
@@ -262,18 +353,65 @@ void BrEdrDynamicChannel::OnRxConfigReq(
 
   state_ |= kRemoteConfigReceived;
 
+  RfcOption remote_option = {};
+  if (!FindRfcOption(options, &remote_option)) {
+    remote_option.mode = ChannelMode::kBasic;
+  }
+  const bool usable_mode =
+      remote_option.mode == ChannelMode::kBasic ||
+      (IsSupportedMode(remote_option.mode) &&
+       IsValidRemoteOption(remote_option));
+
+  // Counter-propose our mode once, then switch to the peer's if it insists on
+  // one that we can use.
+  if (usable_mode && remote_option.mode != local_mode_ &&
+      remote_mode_rejected_) {
+    bt_log(TRACE, "l2cap-bredr",
+           "Channel %#.4x: Switching to mode %#.2hhx requested by peer",
+           local_cid(), remote_option.mode);
+    local_mode_ = remote_option.mode;
+
+    // Our own request has to be made again in the new mode. If it is still
+    // awaiting a response, that is done once the response arrives.
+    if (state_ & kLocalConfigAccepted) {
+      state_ &= ~(kLocalConfigSent | kLocalConfigAccepted);
+    }
+  }
+
+  if (!usable_mode || remote_option.mode != local_mode_) {
+    bt_log(TRACE, "l2cap-bredr",
+           "Channel %#.4x: Refusing mode %#.2hhx, proposing %#.2hhx",
+           local_cid(), remote_option.mode, local_mode_);
+    remote_mode_rejected_ = true;
+    responder->Send(remote_cid(), 0x0000,
+                    ConfigurationResult::kUnacceptableParameters,
+                    MakeRfcOptions(LocalModeOption(local_mode_)));
+    return;
+  }
+
   // TODO(NET-1084): Defer accepting config req using a Pending response
   state_ |= kRemoteConfigAccepted;
-  responder->Send(remote_cid(), 0x0000, ConfigurationResult::kSuccess,
-                  common::BufferView());
+  if (local_mode_ == ChannelMode::kBasic) {
+    responder->Send(remote_cid(), 0x0000, ConfigurationResult::kSuccess,
+                    common::BufferView());
+  } else {
+    // Echo the peer's parameters back, adding the time-outs for it to use.
+    remote_config_rfc_ = remote_option;
+    RfcOption response_option = remote_option;
+    if (local_mode_ == ChannelMode::kEnhancedRetransmission) {
+      response_option.retransmission_timeout =
+          kErtmDefaultRetransmissionTimeoutMs;
+      response_option.monitor_timeout = kErtmDefaultMonitorTimeoutMs;
+    }
+    responder->Send(remote_cid(), 0x0000, ConfigurationResult::kSuccess,
+                    MakeRfcOptions(response_option));
+  }
 
   bt_log(SPEW, "l2cap-bredr", "Channel %#.4x: Sent Configuration Response",
          local_cid());
 
-  if (IsOpen()) {
-    set_opened();
-    PassOpenResult();
-  }
+  TrySendLocalConfig();
+  TryCompleteOpen();
 }
 
 void BrEdrDynamicChannel::OnRxDisconReq(
@@ -312,10 +450,16 @@ void BrEdrDynamicChannel::CompleteInboundConnection(
 BrEdrDynamicChannel::BrEdrDynamicChannel(
     DynamicChannelRegistry* registry,
     SignalingChannelInterface* signaling_channel, PSM psm, ChannelId local_cid,
-    ChannelId remote_cid)
+    ChannelId remote_cid, ChannelMode mode)
     : DynamicChannel(registry, psm, local_cid, remote_cid),
       signaling_channel_(signaling_channel),
-      state_(0u) {
+      state_(0u),
+      local_mode_(mode),
+      requested_mode_(mode),
+      remote_mode_rejected_(false),
+      local_mode_rejected_(false),
+      remote_config_rfc_{},
+      local_config_rfc_{} {
   ZX_DEBUG_ASSERT(signaling_channel_);
   ZX_DEBUG_ASSERT(local_cid != kInvalidChannelId);
 }
@@ -342,9 +486,14 @@ void BrEdrDynamicChannel::TrySendLocalConfig() {
     return;
   }
 
+  common::DynamicByteBuffer options;
+  if (local_mode_ != ChannelMode::kBasic) {
+    options = MakeRfcOptions(LocalModeOption(local_mode_));
+  }
+
   BrEdrCommandHandler cmd_handler(signaling_channel_);
   if (!cmd_handler.SendConfigurationRequest(
-          remote_cid(), 0, common::BufferView(),
+          remote_cid(), 0, options,
           fit::bind_member(this, &BrEdrDynamicChannel::OnRxConfigRsp))) {
     bt_log(ERROR, "l2cap-bredr",
            "Channel %#.4x: Failed to send Configuration Request", local_cid());
@@ -356,6 +505,49 @@ void BrEdrDynamicChannel::TrySendLocalConfig() {
          local_cid());
 
   state_ |= kLocalConfigSent;
+  requested_mode_ = local_mode_;
+}
+
+RetransmissionAndFlowControlOptionPayload BrEdrDynamicChannel::LocalModeOption(
+    ChannelMode mode) const {
+  RfcOption option = {};
+  option.mode = mode;
+  if (mode == ChannelMode::kEnhancedRetransmission) {
+    option.tx_window_size = kErtmReceiveWindowSize;
+    option.max_transmit = kErtmDefaultMaxTransmit;
+  }
+  if (mode != ChannelMode::kBasic) {
+    option.mps = kErtmDefaultMPS;
+  }
+  return option;
+}
+
+void BrEdrDynamicChannel::TryCompleteOpen() {
+  if (!IsOpen()) {
+    return;
+  }
+
+  ChannelModeConfig config;
+  if (local_mode_ != ChannelMode::kBasic) {
+    config.mode = local_mode_;
+    config.tx_window_size =
+        std::min(remote_config_rfc_.tx_window_size, kErtmMaxTxWindowSize);
+    config.max_transmit = remote_config_rfc_.max_transmit;
+    config.tx_mps = remote_config_rfc_.mps;
+
+    // The peer gives the time-outs for us to use in its response, if any.
+    config.retransmission_timeout_ms =
+        local_config_rfc_.retransmission_timeout
+            ? local_config_rfc_.retransmission_timeout
+            : kErtmDefaultRetransmissionTimeoutMs;
+    config.monitor_timeout_ms = local_config_rfc_.monitor_timeout
+                                    ? local_config_rfc_.monitor_timeout
+                                    : kErtmDefaultMonitorTimeoutMs;
+  }
+  set_mode_config(config);
+
+  set_opened();
+  PassOpenResult();
 }
 
 bool BrEdrDynamicChannel::OnRxConnRsp(
@@ -461,6 +653,33 @@ bool BrEdrDynamicChannel::OnRxConfigRsp(
     return true;
   }
 
+  if (rsp.local_cid() != local_cid()) {
+    bt_log(ERROR, "l2cap-bredr",
+           "Channel %#.4x: dropping Configuration Response for %#.4x",
+           local_cid(), rsp.local_cid());
+    PassOpenError();
+    return false;
+  }
+
+  RfcOption rsp_option = {};
+  const bool has_rfc_option = FindRfcOption(rsp.options(), &rsp_option);
+
+  // The peer may refuse our mode and propose another in its place, which we
+  // take up once if we support it.
+  if (rsp.result() == ConfigurationResult::kUnacceptableParameters &&
+      has_rfc_option && IsSupportedMode(rsp_option.mode) &&
+      rsp_option.mode != requested_mode_ && !local_mode_rejected_ &&
+      !(state_ & kRemoteConfigAccepted)) {
+    bt_log(TRACE, "l2cap-bredr",
+           "Channel %#.4x: Peer refused mode %#.2hhx, switching to %#.2hhx",
+           local_cid(), requested_mode_, rsp_option.mode);
+    local_mode_rejected_ = true;
+    local_mode_ = rsp_option.mode;
+    state_ &= ~kLocalConfigSent;
+    TrySendLocalConfig();
+    return false;
+  }
+
   if (rsp.result() != ConfigurationResult::kSuccess) {
     bt_log(ERROR, "l2cap-bredr",
            "Channel %#.4x: unsuccessful config reason %#.4hx", local_cid(),
@@ -469,24 +688,22 @@ bool BrEdrDynamicChannel::OnRxConfigRsp(
     return false;
   }
 
-  if (rsp.local_cid() != local_cid()) {
-    bt_log(ERROR, "l2cap-bredr",
-           "Channel %#.4x: dropping Configuration Response for %#.4x",
-           local_cid(), rsp.local_cid());
-    PassOpenError();
+  // Our mode changed to the peer's while this request was outstanding.
+  if (requested_mode_ != local_mode_) {
+    state_ &= ~kLocalConfigSent;
+    TrySendLocalConfig();
     return false;
   }
 
+  if (local_mode_ != ChannelMode::kBasic && has_rfc_option) {
+    local_config_rfc_ = rsp_option;
+  }
   state_ |= kLocalConfigAccepted;
 
   bt_log(SPEW, "l2cap-bredr", "Channel %#.4x: Got Configuration Response",
          local_cid());
 
-  if (IsOpen()) {
-    set_opened();
-    PassOpenResult();
-  }
-
+  TryCompleteOpen();
   return false;
 }
 
@@ -29,12 +29,19 @@ class BrEdrDynamicChannelRegistry final : public DynamicChannelRegistry {
                               ServiceRequestCallback service_request_cb);
   ~BrEdrDynamicChannelRegistry() override = default;
 
+  // Channels subsequently opened for |psm| in either direction request |mode|
+  // during configuration, falling back to the peer's mode if it insists on
+  // another. Channels use Basic mode by default.
+  void SetPreferredChannelMode(PSM psm, ChannelMode mode);
+
  private:
   // DynamicChannelRegistry override
   DynamicChannelPtr MakeOutbound(PSM psm, ChannelId local_cid) override;
   DynamicChannelPtr MakeInbound(PSM psm, ChannelId local_cid,
                                 ChannelId remote_cid) override;
 
+  ChannelMode PreferredChannelMode(PSM psm) const;
+
   // Signaling channel request handlers
   void OnRxConnReq(PSM psm, ChannelId remote_cid,
                    BrEdrCommandHandler::ConnectionResponder* responder);
@@ -47,6 +54,9 @@ class BrEdrDynamicChannelRegistry final : public DynamicChannelRegistry {
                    BrEdrCommandHandler::InformationResponder* responder);
 
   SignalingChannelInterface* const sig_;
+
+  // Modes requested for channels by PSM, if not Basic mode.
+  std::unordered_map<PSM, ChannelMode> preferred_modes_;
 };
 
 class BrEdrDynamicChannel;
@@ -66,15 +76,17 @@ using BrEdrDynamicChannelPtr = std::unique_ptr<BrEdrDynamicChannel>;
 // Must be run only on the L2CAP thread.
 class BrEdrDynamicChannel final : public DynamicChannel {
  public:
+  // |mode| is the channel mode to request during configuration.
   static BrEdrDynamicChannelPtr MakeOutbound(
       DynamicChannelRegistry* registry,
       SignalingChannelInterface* signaling_channel, PSM psm,
-      ChannelId local_cid);
+      ChannelId local_cid, ChannelMode mode = ChannelMode::kBasic);
 
   static BrEdrDynamicChannelPtr MakeInbound(
       DynamicChannelRegistry* registry,
       SignalingChannelInterface* signaling_channel, PSM psm,
-      ChannelId local_cid, ChannelId remote_cid);
+      ChannelId local_cid, ChannelId remote_cid,
+      ChannelMode mode = ChannelMode::kBasic);
 
   // DynamicChannel overrides
   ~BrEdrDynamicChannel() override = default;
@@ -138,7 +150,8 @@ class BrEdrDynamicChannel final : public DynamicChannel {
 
   BrEdrDynamicChannel(DynamicChannelRegistry* registry,
                       SignalingChannelInterface* signaling_channel, PSM psm,
-                      ChannelId local_cid, ChannelId remote_cid);
+                      ChannelId local_cid, ChannelId remote_cid,
+                      ChannelMode mode);
 
   // Deliver the result of channel connection and configuration to the |Open|
   // originator. Can be called multiple times but only the first invocation
@@ -155,6 +168,15 @@ class BrEdrDynamicChannel final : public DynamicChannel {
   // happened.
   void TrySendLocalConfig();
 
+  // Returns the Retransmission and Flow Control option that describes how the
+  // peer should send to us in |mode|.
+  RetransmissionAndFlowControlOptionPayload LocalModeOption(
+      ChannelMode mode) const;
+
+  // Marks the channel open and records the negotiated mode, once both
+  // directions have been configured.
+  void TryCompleteOpen();
+
   // Response handlers for outbound requests
   bool OnRxConnRsp(const BrEdrCommandHandler::ConnectionResponse& rsp);
   bool OnRxConfigRsp(const BrEdrCommandHandler::ConfigurationResponse& rsp);
@@ -165,6 +187,26 @@ class BrEdrDynamicChannel final : public DynamicChannel {
   // closed (i.e. not yet open) channel.
   State state_;
 
+  // The mode requested by our Configuration Request. This starts out as the
+  // preferred mode for the channel's PSM but changes to the peer's mode if the
+  // peer rejects it or insists on another.
+  ChannelMode local_mode_;
+
+  // The mode of our most recent Configuration Request.
+  ChannelMode requested_mode_;
+
+  // Set once a Configuration Request from the peer has been refused for asking
+  // for a mode other than |local_mode_|, and once the peer has done the same to
+  // ours.
+  bool remote_mode_rejected_;
+  bool local_mode_rejected_;
+
+  // The Retransmission and Flow Control options of the accepted Configuration
+  // Request from the peer (which give how we send) and of the peer's response
+  // to ours (which give our time-outs). These are unused in Basic mode.
+  RetransmissionAndFlowControlOptionPayload remote_config_rfc_;
+  RetransmissionAndFlowControlOptionPayload local_config_rfc_;
+
   // This shall be reset to nullptr after invocation to enforce its single-use
   // semantics. See |DynamicChannel::Open| for details.
   fit::closure open_result_cb_;
@@ -256,6 +256,89 @@ const common::ByteBuffer& kInboundOkConfigRsp = common::CreateStaticByteBuffer(
     // Result (Successful)
     0x00, 0x00);
 
+// Configuration messages carrying a Retransmission and Flow Control option
+
+const common::ByteBuffer& kErtmConfigReq = common::CreateStaticByteBuffer(
+    // Destination CID
+    LowerBits(kRemoteCId), UpperBits(kRemoteCId),
+
+    // Flags
+    0x00, 0x00,
+
+    // Retransmission and Flow Control option (Enhanced Retransmission, TxWindow
+    // 32, MaxTransmit 4, no time-outs, MPS 1010)
+    0x04, 0x09, 0x03, 0x20, 0x04, 0x00, 0x00, 0x00, 0x00, 0xf2, 0x03);
+
+const common::ByteBuffer& kOkErtmConfigRsp = common::CreateStaticByteBuffer(
+    // Source CID
+    LowerBits(kLocalCId), UpperBits(kLocalCId),
+
+    // Flags
+    0x00, 0x00,
+
+    // Result (Successful)
+    0x00, 0x00,
+
+    // Retransmission and Flow Control option (Enhanced Retransmission, TxWindow
+    // 32, MaxTransmit 4, Retransmission time-out 1000 ms, Monitor time-out
+    // 5000 ms, MPS 1010)
+    0x04, 0x09, 0x03, 0x20, 0x04, 0xe8, 0x03, 0x88, 0x13, 0xf2, 0x03);
+
+const common::ByteBuffer& kUnacceptableBasicConfigRsp =
+    common::CreateStaticByteBuffer(
+        // Source CID
+        LowerBits(kLocalCId), UpperBits(kLocalCId),
+
+        // Flags
+        0x00, 0x00,
+
+        // Result (Failure - unacceptable parameters)
+        0x01, 0x00,
+
+        // Retransmission and Flow Control option (Basic)
+        0x04, 0x09, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00);
+
+const common::ByteBuffer& kInboundErtmConfigReq =
+    common::CreateStaticByteBuffer(
+        // Destination CID
+        LowerBits(kLocalCId), UpperBits(kLocalCId),
+
+        // Flags
+        0x00, 0x00,
+
+        // Retransmission and Flow Control option (Enhanced Retransmission,
+        // TxWindow 10, MaxTransmit 3, no time-outs, MPS 672)
+        0x04, 0x09, 0x03, 0x0a, 0x03, 0x00, 0x00, 0x00, 0x00, 0xa0, 0x02);
+
+const common::ByteBuffer& kInboundOkErtmConfigRsp =
+    common::CreateStaticByteBuffer(
+        // Source CID
+        LowerBits(kRemoteCId), UpperBits(kRemoteCId),
+
+        // Flags
+        0x00, 0x00,
+
+        // Result (Successful)
+        0x00, 0x00,
+
+        // Retransmission and Flow Control option (the request's, with
+        // Retransmission time-out 2000 ms and Monitor time-out 12000 ms)
+        0x04, 0x09, 0x03, 0x0a, 0x03, 0xd0, 0x07, 0xe0, 0x2e, 0xa0, 0x02);
+
+const common::ByteBuffer& kInboundUnacceptableBasicConfigRsp =
+    common::CreateStaticByteBuffer(
+        // Source CID
+        LowerBits(kRemoteCId), UpperBits(kRemoteCId),
+
+        // Flags
+        0x00, 0x00,
+
+        // Result (Failure - unacceptable parameters)
+        0x01, 0x00,
+
+        // Retransmission and Flow Control option (Basic)
+        0x04, 0x09, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00);
+
 class L2CAP_BrEdrDynamicChannelTest : public ::gtest::TestLoopFixture {
  public:
   L2CAP_BrEdrDynamicChannelTest() = default;
@@ -763,6 +846,118 @@ TEST_F(L2CAP_BrEdrDynamicChannelTest, InboundConnectionInvalidSrcCId) {
   RunLoopUntilIdle();
 }
 
+TEST_F(L2CAP_BrEdrDynamicChannelTest, OpenEnhancedRetransmissionChannel) {
+  sig()->AddOutbound(
+      kConnectionRequest, kConnReq.view(),
+      std::make_pair(SignalingChannel::Status::kSuccess, kOkConnRsp.view()));
+  sig()->AddOutbound(kConfigurationRequest, kErtmConfigReq.view(),
+                     std::make_pair(SignalingChannel::Status::kSuccess,
+                                    kOkErtmConfigRsp.view()));
+  sig()->AddOutbound(
+      kDisconnectionRequest, kDisconReq.view(),
+      std::make_pair(SignalingChannel::Status::kSuccess, kDisconRsp.view()));
+
+  registry()->SetPreferredChannelMode(kPsm,
+                                      ChannelMode::kEnhancedRetransmission);
+
+  int open_cb_count = 0;
+  registry()->OpenOutbound(kPsm, [&open_cb_count](auto chan) {
+    open_cb_count++;
+    ASSERT_TRUE(chan);
+
+    // We send with the peer's parameters and the time-outs it told us to use.
+    const ChannelModeConfig& config = chan->mode_config();
+    EXPECT_EQ(ChannelMode::kEnhancedRetransmission, config.mode);
+    EXPECT_EQ(10u, config.tx_window_size);
+    EXPECT_EQ(3u, config.max_transmit);
+    EXPECT_EQ(1000u, config.retransmission_timeout_ms);
+    EXPECT_EQ(5000u, config.monitor_timeout_ms);
+    EXPECT_EQ(672u, config.tx_mps);
+  });
+
+  RunLoopUntilIdle();
+  EXPECT_EQ(0, open_cb_count);
+
+  sig()->ReceiveExpect(kConfigurationRequest, kInboundErtmConfigReq,
+                       kInboundOkErtmConfigRsp);
+  EXPECT_EQ(1, open_cb_count);
+
+  registry()->CloseChannel(kLocalCId);
+  RunLoopUntilIdle();
+}
+
+TEST_F(L2CAP_BrEdrDynamicChannelTest, FallBackToBasicModeWhenRefusedByPeer) {
+  sig()->AddOutbound(
+      kConnectionRequest, kConnReq.view(),
+      std::make_pair(SignalingChannel::Status::kSuccess, kOkConnRsp.view()));
+  sig()->AddOutbound(kConfigurationRequest, kErtmConfigReq.view(),
+                     std::make_pair(SignalingChannel::Status::kSuccess,
+                                    kUnacceptableBasicConfigRsp.view()));
+  sig()->AddOutbound(
+      kConfigurationRequest, kConfigReq.view(),
+      std::make_pair(SignalingChannel::Status::kSuccess, kOkConfigRsp.view()));
+  sig()->AddOutbound(
+      kDisconnectionRequest, kDisconReq.view(),
+      std::make_pair(SignalingChannel::Status::kSuccess, kDisconRsp.view()));
+
+  registry()->SetPreferredChannelMode(kPsm,
+                                      ChannelMode::kEnhancedRetransmission);
+
+  int open_cb_count = 0;
+  registry()->OpenOutbound(kPsm, [&open_cb_count](auto chan) {
+    open_cb_count++;
+    ASSERT_TRUE(chan);
+    EXPECT_EQ(ChannelMode::kBasic, chan->mode_config().mode);
+  });
+
+  RunLoopUntilIdle();
+
+  sig()->ReceiveExpect(kConfigurationRequest, kInboundConfigReq,
+                       kInboundOkConfigRsp);
+  EXPECT_EQ(1, open_cb_count);
+
+  registry()->CloseChannel(kLocalCId);
+  RunLoopUntilIdle();
+}
+
+TEST_F(L2CAP_BrEdrDynamicChannelTest, SwitchToModeThatPeerInsistsOn) {
+  sig()->AddOutbound(
+      kConnectionRequest, kConnReq.view(),
+      std::make_pair(SignalingChannel::Status::kSuccess, kOkConnRsp.view()));
+  sig()->AddOutbound(
+      kConfigurationRequest, kConfigReq.view(),
+      std::make_pair(SignalingChannel::Status::kSuccess, kOkConfigRsp.view()));
+  sig()->AddOutbound(kConfigurationRequest, kErtmConfigReq.view(),
+                     std::make_pair(SignalingChannel::Status::kSuccess,
+                                    kOkErtmConfigRsp.view()));
+  sig()->AddOutbound(
+      kDisconnectionRequest, kDisconReq.view(),
+      std::make_pair(SignalingChannel::Status::kSuccess, kDisconRsp.view()));
+
+  int open_cb_count = 0;
+  registry()->OpenOutbound(kPsm, [&open_cb_count](auto chan) {
+    open_cb_count++;
+    ASSERT_TRUE(chan);
+    EXPECT_EQ(ChannelMode::kEnhancedRetransmission, chan->mode_config().mode);
+  });
+
+  RunLoopUntilIdle();
+
+  // Our Basic mode is proposed in place of the peer's first request.
+  sig()->ReceiveExpect(kConfigurationRequest, kInboundErtmConfigReq,
+                       kInboundUnacceptableBasicConfigRsp);
+  EXPECT_EQ(0, open_cb_count);
+
+  // Once the peer asks again, both directions are configured for its mode.
+  sig()->ReceiveExpect(kConfigurationRequest, kInboundErtmConfigReq,
+                       kInboundOkErtmConfigRsp);
+  RunLoopUntilIdle();
+  EXPECT_EQ(1, open_cb_count);
+
+  registry()->CloseChannel(kLocalCId);
+  RunLoopUntilIdle();
+}
+
 }  // namespace
 }  // namespace internal
 }  // namespace l2cap
@@ -10,6 +10,7 @@
 #include "garnet/drivers/bluetooth/lib/common/run_or_post.h"
 #include "lib/fxl/strings/string_printf.h"
 
+#include "fragmenter.h"
 #include "logical_link.h"
 
 namespace btlib {
@@ -38,13 +39,69 @@ namespace internal {
 
 ChannelImpl::ChannelImpl(ChannelId id, ChannelId remote_id,
                          fxl::WeakPtr<internal::LogicalLink> link,
-                         std::list<PDU> buffered_pdus)
+                         std::list<PDU> buffered_pdus,
+                         const ChannelModeConfig& mode_config)
     : Channel(id, remote_id, link->type(), link->handle()),
+      mode_(mode_config.mode),
       active_(false),
       dispatcher_(nullptr),
-      link_(link),
-      pending_rx_sdus_(std::move(buffered_pdus)) {
+      link_(link) {
   ZX_DEBUG_ASSERT(link_);
+
+  if (mode_ != ChannelMode::kBasic) {
+    CreateEngine(link, mode_config);
+  }
+
+  // PDUs that were received before this channel was created are handled like
+  // any others, so they are reassembled in modes other than Basic.
+  for (auto& pdu : buffered_pdus) {
+    HandleRxPdu(std::move(pdu));
+  }
+}
+
+void ChannelImpl::CreateEngine(fxl::WeakPtr<internal::LogicalLink> link,
+                               const ChannelModeConfig& mode_config) {
+  const ChannelId id = this->id();
+  const ChannelId remote_id = this->remote_id();
+
+  auto send_frame = [link, remote_id](auto frame) {
+    if (link) {
+      link->SendBasicFrame(remote_id, *frame);
+    }
+  };
+
+  // The engine stops once it reports an error, but it can't be destroyed until
+  // it returns.
+  auto on_error = [this, link] {
+    async::PostTask(link->dispatcher(),
+                    [self = fbl::WrapRefPtr(this), link] {
+                      if (link) {
+                        link->DisconnectChannel(self.get());
+                      }
+                    });
+  };
+
+  if (mode_ == ChannelMode::kLECreditBasedFlowControl) {
+    tx_mtu_ = mode_config.tx_mtu;
+    rx_mtu_ = mode_config.rx_mtu;
+
+    auto send_credits = [link, id](uint16_t credits) {
+      if (link) {
+        link->SendFlowControlCredit(id, credits);
+      }
+    };
+
+    credit_engine_ = std::make_unique<CreditBasedFlowControlEngine>(
+        id, mode_config, std::move(send_frame),
+        [this](SDU sdu) { DeliverSdu(std::move(sdu)); },
+        std::move(send_credits), std::move(on_error));
+    return;
+  }
+
+  engine_ = std::make_unique<EnhancedRetransmissionEngine>(
+      id, remote_id, mode_config, std::move(send_frame),
+      fit::bind_member(this, &ChannelImpl::OnEngineSdu), std::move(on_error),
+      link->dispatcher());
 }
 
 bool ChannelImpl::Activate(RxCallback rx_callback,
@@ -112,6 +169,8 @@ void ChannelImpl::Deactivate() {
     // If |link| is still alive than |this| must be valid since |link| holds a
     // reference to us.
     if (link) {
+      engine_ = nullptr;
+      credit_engine_ = nullptr;
       link->RemoveChannel(this);
     }
   });
@@ -149,6 +208,20 @@ bool ChannelImpl::Send(common::ByteBufferPtr sdu) {
   if (!active_)
     return false;
 
+  if (mode_ != ChannelMode::kBasic) {
+    async::PostTask(link_->dispatcher(), [self = fbl::WrapRefPtr(this),
+                                          link = link_, sdu = std::move(sdu)] {
+      if (!link)
+        return;
+      if (self->engine_) {
+        self->engine_->QueueSdu(*sdu);
+      } else if (self->credit_engine_) {
+        self->credit_engine_->QueueSdu(*sdu);
+      }
+    });
+    return true;
+  }
+
   async::PostTask(link_->dispatcher(),
                   [id = remote_id(), link = link_, sdu = std::move(sdu)] {
                     if (link) {
@@ -163,6 +236,10 @@ void ChannelImpl::OnClosed() {
   async_dispatcher_t* dispatcher;
   fit::closure task;
 
+  // This is called on the link's thread.
+  engine_ = nullptr;
+  credit_engine_ = nullptr;
+
   {
     std::lock_guard<std::mutex> lock(mtx_);
 
@@ -183,13 +260,47 @@ void ChannelImpl::OnClosed() {
 }
 
 void ChannelImpl::HandleRxPdu(PDU&& pdu) {
+  // In Basic mode, SDU == PDU. Otherwise the PDU carries a frame for the
+  // engine, which delivers the SDUs that it reassembles. K-frames are handed
+  // over as they are, as their payloads become part of the SDU without being
+  // copied.
+  if (credit_engine_) {
+    credit_engine_->ProcessPdu(std::move(pdu));
+    return;
+  }
+
+  if (engine_) {
+    common::DynamicByteBuffer frame(pdu.length());
+    pdu.Copy(&frame);
+    engine_->ProcessFrame(frame);
+    return;
+  }
+
+  if (mode_ != ChannelMode::kBasic) {
+    bt_log(TRACE, "l2cap", "Dropping PDU for closed channel %#.4x", id());
+    return;
+  }
+
+  DeliverSdu(SDU(std::move(pdu)));
+}
+
+void ChannelImpl::AddCredits(uint16_t credits) {
+  // Credits only mean something in LE Credit Based Flow Control mode.
+  if (credit_engine_) {
+    credit_engine_->AddCredits(credits);
+  }
+}
+
+void ChannelImpl::OnEngineSdu(common::ByteBufferPtr sdu) {
+  // SDUs are passed to the channel user in the form of a B-frame.
+  DeliverSdu(SDU(Fragmenter(link_handle()).BuildBasicFrame(id(), *sdu)));
+}
+
+void ChannelImpl::DeliverSdu(SDU&& sdu) {
   async_dispatcher_t* dispatcher;
   fit::closure task;
 
   {
-    // TODO(armansito): This is the point where the channel mode implementation
-    // should take over the PDU. Since we only support basic mode: SDU == PDU.
-
     std::lock_guard<std::mutex> lock(mtx_);
 
     // This will only be called on a live link.
@@ -197,13 +308,13 @@ void ChannelImpl::HandleRxPdu(PDU&& pdu) {
 
     // Buffer the packets if the channel hasn't been activated.
     if (!active_) {
-      pending_rx_sdus_.emplace(std::forward<PDU>(pdu));
+      pending_rx_sdus_.emplace(std::forward<SDU>(sdu));
       return;
     }
 
     dispatcher = dispatcher_;
-    task = [func = rx_cb_.share(), pdu = std::move(pdu)]() mutable {
-      func(std::move(pdu));
+    task = [func = rx_cb_.share(), sdu = std::move(sdu)]() mutable {
+      func(std::move(sdu));
     };
 
     ZX_DEBUG_ASSERT(rx_cb_);
@@ -18,6 +18,8 @@
 #include <zircon/compiler.h>
 
 #include "garnet/drivers/bluetooth/lib/hci/connection.h"
+#include "garnet/drivers/bluetooth/lib/l2cap/credit_based_flow_control_engine.h"
+#include "garnet/drivers/bluetooth/lib/l2cap/enhanced_retransmission_engine.h"
 #include "garnet/drivers/bluetooth/lib/l2cap/sdu.h"
 #include "lib/fxl/macros.h"
 #include "lib/fxl/synchronization/thread_checker.h"
@@ -30,7 +32,11 @@ namespace l2cap {
 // be obtained from a ChannelManager.
 //
 // A Channel can operate in one of 6 L2CAP Modes of Operation (see Core Spec
-// v5.0, Vol 3, Part A, Section 2.4). Only Basic Mode is currently supported.
+// v5.0, Vol 3, Part A, Section 2.4). Channels on ACL-U links support Basic
+// Mode, Enhanced Retransmission Mode and Streaming Mode, and the dynamic
+// channels of LE-U links use LE Credit Based Flow Control Mode. The mode is
+// negotiated when the channel is opened and its framing is transparent to the
+// channel user, who sends and receives whole SDUs.
 //
 // USAGE:
 //
@@ -155,9 +161,14 @@ class ChannelImpl : public Channel {
   friend class fbl::RefPtr<ChannelImpl>;
   friend class internal::LogicalLink;
 
+  // Channels in Enhanced Retransmission or Streaming mode (as given by
+  // |mode_config|) exchange I-frames and S-frames with the peer, and channels
+  // in LE Credit Based Flow Control mode exchange K-frames. These are processed
+  // on |link|'s thread.
   ChannelImpl(ChannelId id, ChannelId remote_id,
               fxl::WeakPtr<internal::LogicalLink> link,
-              std::list<PDU> buffered_pdus);
+              std::list<PDU> buffered_pdus,
+              const ChannelModeConfig& mode_config);
   ~ChannelImpl() override = default;
 
   // Called by |link_| to notify us when the channel can no longer process data.
@@ -165,11 +176,27 @@ class ChannelImpl : public Channel {
   // deadlock.
   void OnClosed();
 
+  // Creates the engine that runs on |link|'s thread for a mode other than
+  // Basic.
+  void CreateEngine(fxl::WeakPtr<internal::LogicalLink> link,
+                    const ChannelModeConfig& mode_config);
+
   // Called by |link_| when a PDU targeting this channel has been received.
   // Contents of |pdu| will be moved.
   void HandleRxPdu(PDU&& pdu);
 
-  // TODO(armansito): Add MPS fields when we support segmentation/flow-control.
+  // Passes |sdu| to the channel user, or buffers it if the channel hasn't been
+  // activated.
+  void DeliverSdu(SDU&& sdu);
+
+  // Called by |engine_| with each SDU that it reassembles.
+  void OnEngineSdu(common::ByteBufferPtr sdu);
+
+  // Called by |link_| with credits that the peer has granted to this channel in
+  // LE Credit Based Flow Control mode.
+  void AddCredits(uint16_t credits);
+
+  const ChannelMode mode_;
 
   std::mutex mtx_;
 
@@ -197,6 +224,12 @@ class ChannelImpl : public Channel {
   // (especially in the HCI layer).
   std::queue<SDU, std::list<SDU>> pending_rx_sdus_ __TA_GUARDED(mtx_);
 
+  // Segments outbound SDUs into frames and reassembles inbound ones for
+  // channels that are not in Basic mode. At most one of these exists, depending
+  // on the mode. These are only accessed on the link's thread.
+  std::unique_ptr<EnhancedRetransmissionEngine> engine_;
+  std::unique_ptr<CreditBasedFlowControlEngine> credit_engine_;
+
   FXL_DISALLOW_COPY_AND_ASSIGN(ChannelImpl);
 };
 
@@ -107,6 +107,15 @@ void ChannelManager::OpenChannel(hci::ConnectionHandle handle, PSM psm,
   iter->second->OpenChannel(psm, std::move(cb), dispatcher);
 }
 
+void ChannelManager::SetPreferredChannelMode(PSM psm, ChannelMode mode) {
+  ZX_DEBUG_ASSERT(thread_checker_.IsCreationThreadCurrent());
+
+  channel_modes_[psm] = mode;
+  for (auto& iter : ll_map_) {
+    iter.second->SetPreferredChannelMode(psm, mode);
+  }
+}
+
 bool ChannelManager::RegisterService(PSM psm, ChannelCallback cb,
                                      async_dispatcher_t* dispatcher) {
   ZX_DEBUG_ASSERT(thread_checker_.IsCreationThreadCurrent());
@@ -191,6 +200,9 @@ internal::LogicalLink* ChannelManager::RegisterInternal(
   auto ll = std::make_unique<internal::LogicalLink>(
       handle, ll_type, role, l2cap_dispatcher_, hci_,
       fit::bind_member(this, &ChannelManager::QueryService));
+  for (const auto& mode : channel_modes_) {
+    ll->SetPreferredChannelMode(mode.first, mode.second);
+  }
 
   // Route all pending packets to the link.
   auto pp_iter = pending_packets_.find(handle);
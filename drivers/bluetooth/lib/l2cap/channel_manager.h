@@ -108,11 +108,19 @@ class ChannelManager final {
   fbl::RefPtr<Channel> OpenFixedChannel(hci::ConnectionHandle connection_handle,
                                         ChannelId channel_id);
 
-  // Open an out-bound connection-oriented L2CAP channel.
+  // Open an out-bound connection-oriented L2CAP channel. On LE-U links, this is
+  // an LE credit based channel and |psm| is its LE_PSM.
   void OpenChannel(hci::ConnectionHandle handle, PSM psm, ChannelCallback cb,
                    async_dispatcher_t* dispatcher);
 
-  // Register/Unregister a callback for incoming service connections.
+  // Requests |mode| for the BR/EDR channels that are opened with |psm| from now
+  // on, whether outbound or inbound. Channels fall back to Basic mode when the
+  // peer doesn't support |mode|.
+  void SetPreferredChannelMode(PSM psm, ChannelMode mode);
+
+  // Register/Unregister a callback for incoming service connections. The
+  // service accepts channels on both ACL-U and LE-U links. On the latter, |psm|
+  // is the LE_PSM of LE credit based channels and must be at most 0x00FF.
   bool RegisterService(PSM psm, ChannelCallback cb,
                        async_dispatcher_t* dispatcher);
   void UnregisterService(PSM psm);
@@ -156,6 +164,10 @@ class ChannelManager final {
   using ServiceMap = std::unordered_map<PSM, ChannelCallback>;
   ServiceMap services_;
 
+  // Channel modes requested with SetPreferredChannelMode(), which are applied
+  // to every ACL-U link.
+  std::unordered_map<PSM, ChannelMode> channel_modes_;
+
   fxl::ThreadChecker thread_checker_;
   fxl::WeakPtrFactory<ChannelManager> weak_ptr_factory_;
 
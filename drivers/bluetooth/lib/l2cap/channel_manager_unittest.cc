@@ -4,10 +4,15 @@
 
 #include "channel_manager.h"
 
+#include <endian.h>
+
+#include <chrono>
 #include <memory>
 
 #include "garnet/drivers/bluetooth/lib/common/test_helpers.h"
 #include "garnet/drivers/bluetooth/lib/hci/connection.h"
+#include "garnet/drivers/bluetooth/lib/l2cap/credit_based_flow_control_engine.h"
+#include "garnet/drivers/bluetooth/lib/l2cap/fragmenter.h"
 #include "garnet/drivers/bluetooth/lib/testing/fake_controller_test.h"
 #include "garnet/drivers/bluetooth/lib/testing/test_controller.h"
 #include "lib/fxl/macros.h"
@@ -1287,6 +1292,382 @@ TEST_F(L2CAP_ChannelManagerTest, ACLInboundDynamicChannelLocalDisconnect) {
   EXPECT_FALSE(closed_cb_called);
 }
 
+
+TEST_F(L2CAP_ChannelManagerTest, LEOutboundDynamicChannelLocalDisconnect) {
+  constexpr ChannelId kLocalId = 0x0040;
+  constexpr ChannelId kRemoteId = 0x0047;
+
+  chanmgr()->RegisterLE(kTestHandle1, hci::Connection::Role::kMaster,
+                        [](auto) {}, DoNothing, dispatcher());
+
+  fbl::RefPtr<Channel> channel;
+  auto channel_cb = [&channel](fbl::RefPtr<l2cap::Channel> activated_chan) {
+    channel = std::move(activated_chan);
+  };
+
+  bool closed_cb_called = false;
+  auto closed_cb = [&closed_cb_called] { closed_cb_called = true; };
+
+  std::vector<std::string> sdus;
+  auto rx_cb = [&sdus](const SDU& sdu) {
+    common::StaticByteBuffer<16> buffer;
+    size_t size = sdu.Copy(&buffer);
+    sdus.push_back(buffer.view(0, size).ToString());
+  };
+
+  ActivateOutboundChannel(kTestPsm, std::move(channel_cb), kTestHandle1,
+                          std::move(closed_cb), std::move(rx_cb));
+  RunLoopUntilIdle();
+
+  // clang-format off
+  test_device()->SendACLDataChannelPacket(common::CreateStaticByteBuffer(
+      // ACL data header (handle: 0x0001, length: 18 bytes)
+      0x01, 0x00, 0x12, 0x00,
+
+      // L2CAP B-frame header (length: 14 bytes, channel-id: 0x0005 (LE sig))
+      0x0e, 0x00, 0x05, 0x00,
+
+      // LE Credit Based Connection Response (ID: 1, length: 10,
+      // dst cid: 0x0047, mtu: 100, mps: 23, initial credits: 2,
+      // result: success)
+      0x15, 0x01, 0x0a, 0x00,
+      0x47, 0x00, 0x64, 0x00,
+      0x17, 0x00, 0x02, 0x00,
+      0x00, 0x00));
+  // clang-format on
+
+  RunLoopUntilIdle();
+
+  ASSERT_TRUE(channel);
+  EXPECT_FALSE(closed_cb_called);
+  EXPECT_EQ(kLocalId, channel->id());
+  EXPECT_EQ(kRemoteId, channel->remote_id());
+  EXPECT_EQ(100u, channel->tx_mtu());
+  EXPECT_EQ(kLECreditBasedDefaultMTU, channel->rx_mtu());
+
+  // Test SDU transmission.
+  std::unique_ptr<common::ByteBuffer> received;
+  auto data_cb = [&received](const common::ByteBuffer& bytes) {
+    received = std::make_unique<common::DynamicByteBuffer>(bytes);
+  };
+  test_device()->SetDataCallback(std::move(data_cb), dispatcher());
+
+  EXPECT_TRUE(channel->Send(common::NewBuffer('T', 'e', 's', 't')));
+
+  RunLoopUntilIdle();
+  ASSERT_TRUE(received);
+
+  // The SDU is sent in a K-frame, which begins with the SDU length.
+  auto expected = common::CreateStaticByteBuffer(
+      // ACL data header (handle: 1, length 10)
+      0x01, 0x00, 0x0a, 0x00,
+
+      // L2CAP K-frame: (length: 6, channel-id: 0x0047, SDU length: 4)
+      0x06, 0x00, 0x47, 0x00, 0x04, 0x00, 'T', 'e', 's', 't');
+
+  EXPECT_TRUE(common::ContainersEqual(expected, *received));
+
+  // Test SDU reception.
+  test_device()->SendACLDataChannelPacket(common::CreateStaticByteBuffer(
+      // ACL data header (handle: 0x0001, length: 8 bytes)
+      0x01, 0x00, 0x08, 0x00,
+
+      // L2CAP K-frame: (length: 4, channel-id: 0x0040, SDU length: 2)
+      0x04, 0x00, 0x40, 0x00, 0x02, 0x00, 'H', 'i'));
+
+  RunLoopUntilIdle();
+  ASSERT_EQ(1u, sdus.size());
+  EXPECT_EQ("Hi", sdus[0]);
+
+  // Explicit deactivation should not result in |closed_cb| being called.
+  received = nullptr;
+  channel->Deactivate();
+  RunLoopUntilIdle();
+
+  // clang-format off
+  auto disconn_req = common::CreateStaticByteBuffer(
+      // ACL data header (handle: 1, length 12)
+      0x01, 0x00, 0x0c, 0x00,
+
+      // L2CAP B-frame header (length: 8 bytes, channel-id: 0x0005 (LE sig))
+      0x08, 0x00, 0x05, 0x00,
+
+      // Disconnection Request
+      // (ID: 2, length: 4, dst cid: 0x0047, src cid: 0x0040)
+      0x06, 0x02, 0x04, 0x00,
+      0x47, 0x00, 0x40, 0x00);
+  // clang-format on
+
+  ASSERT_TRUE(received);
+  EXPECT_TRUE(common::ContainersEqual(disconn_req, *received));
+
+  // clang-format off
+  test_device()->SendACLDataChannelPacket(common::CreateStaticByteBuffer(
+      // ACL data header (handle: 0x0001, length: 12 bytes)
+      0x01, 0x00, 0x0c, 0x00,
+
+      // L2CAP B-frame header (length: 8 bytes, channel-id: 0x0005 (LE sig))
+      0x08, 0x00, 0x05, 0x00,
+
+      // Disconnection Response
+      // (ID: 2, length: 4, dst cid: 0x0047, src cid: 0x0040)
+      0x07, 0x02, 0x04, 0x00,
+      0x47, 0x00, 0x40, 0x00));
+  // clang-format on
+
+  RunLoopUntilIdle();
+
+  EXPECT_FALSE(closed_cb_called);
+}
+
+TEST_F(L2CAP_ChannelManagerTest, LEOutboundDynamicChannelRemoteRefused) {
+  chanmgr()->RegisterLE(kTestHandle1, hci::Connection::Role::kMaster,
+                        [](auto) {}, DoNothing, dispatcher());
+
+  bool channel_cb_called = false;
+  auto channel_cb = [&channel_cb_called](fbl::RefPtr<l2cap::Channel> channel) {
+    channel_cb_called = true;
+    EXPECT_FALSE(channel);
+  };
+
+  ActivateOutboundChannel(kTestPsm, std::move(channel_cb));
+
+  // clang-format off
+  test_device()->SendACLDataChannelPacket(common::CreateStaticByteBuffer(
+      // ACL data header (handle: 0x0001, length: 18 bytes)
+      0x01, 0x00, 0x12, 0x00,
+
+      // L2CAP B-frame header (length: 14 bytes, channel-id: 0x0005 (LE sig))
+      0x0e, 0x00, 0x05, 0x00,
+
+      // LE Credit Based Connection Response (ID: 1, length: 10,
+      // dst cid: 0x0000, mtu: 0, mps: 0, initial credits: 0,
+      // result: LE_PSM not supported)
+      0x15, 0x01, 0x0a, 0x00,
+      0x00, 0x00, 0x00, 0x00,
+      0x00, 0x00, 0x00, 0x00,
+      0x02, 0x00));
+  // clang-format on
+
+  RunLoopUntilIdle();
+
+  EXPECT_TRUE(channel_cb_called);
+}
+
+TEST_F(L2CAP_ChannelManagerTest, LEInboundDynamicChannel) {
+  constexpr PSM kLEPsm = 0x0081;
+  constexpr ChannelId kLocalId = 0x0040;
+  constexpr ChannelId kRemoteId = 0x0047;
+
+  chanmgr()->RegisterLE(kTestHandle1, hci::Connection::Role::kSlave,
+                        [](auto) {}, DoNothing, dispatcher());
+
+  fbl::RefPtr<Channel> channel;
+  auto channel_cb = [&channel](fbl::RefPtr<l2cap::Channel> opened_chan) {
+    channel = std::move(opened_chan);
+  };
+  EXPECT_TRUE(
+      chanmgr()->RegisterService(kLEPsm, std::move(channel_cb), dispatcher()));
+
+  std::unique_ptr<common::ByteBuffer> received;
+  auto data_cb = [&received](const common::ByteBuffer& bytes) {
+    received = std::make_unique<common::DynamicByteBuffer>(bytes);
+  };
+  test_device()->SetDataCallback(std::move(data_cb), dispatcher());
+
+  // clang-format off
+  test_device()->SendACLDataChannelPacket(common::CreateStaticByteBuffer(
+      // ACL data header (handle: 0x0001, length: 18 bytes)
+      0x01, 0x00, 0x12, 0x00,
+
+      // L2CAP B-frame header (length: 14 bytes, channel-id: 0x0005 (LE sig))
+      0x0e, 0x00, 0x05, 0x00,
+
+      // LE Credit Based Connection Request (ID: 7, length: 10, le_psm: 0x0081,
+      // src cid: 0x0047, mtu: 100, mps: 23, initial credits: 2)
+      0x14, 0x07, 0x0a, 0x00,
+      0x81, 0x00, 0x47, 0x00,
+      0x64, 0x00, 0x17, 0x00,
+      0x02, 0x00));
+  // clang-format on
+
+  RunLoopUntilIdle();
+
+  ASSERT_TRUE(channel);
+  EXPECT_EQ(kLocalId, channel->id());
+  EXPECT_EQ(kRemoteId, channel->remote_id());
+  EXPECT_EQ(100u, channel->tx_mtu());
+
+  // clang-format off
+  auto expected = common::CreateStaticByteBuffer(
+      // ACL data header (handle: 1, length 18)
+      0x01, 0x00, 0x12, 0x00,
+
+      // L2CAP B-frame header (length: 14 bytes, channel-id: 0x0005 (LE sig))
+      0x0e, 0x00, 0x05, 0x00,
+
+      // LE Credit Based Connection Response (ID: 7, length: 10,
+      // dst cid: 0x0040, mtu: 2048, mps: 247, initial credits: 16,
+      // result: success)
+      0x15, 0x07, 0x0a, 0x00,
+      0x40, 0x00, 0x00, 0x08,
+      0xf7, 0x00, 0x10, 0x00,
+      0x00, 0x00);
+  // clang-format on
+
+  ASSERT_TRUE(received);
+  EXPECT_TRUE(common::ContainersEqual(expected, *received));
+}
+
+// Sends SDUs over an LE credit based channel to a peer that has fewer credits
+// and a smaller MPS than our own and that returns its credits as it reassembles
+// the SDUs. Each K-frame fits in one LE ACL data packet, which is acknowledged
+// by the fake controller as soon as it is received.
+TEST_F(L2CAP_ChannelManagerTest, LEDynamicChannelThroughput) {
+  constexpr size_t kMaxLEDataSize = 27;
+  constexpr size_t kMaxNumPackets = 4;
+  constexpr ChannelId kRemoteId = 0x0047;
+  constexpr uint16_t kPeerMtu = 512;
+  constexpr uint16_t kPeerMps = kMaxLEDataSize - sizeof(BasicHeader);
+  constexpr uint16_t kPeerCredits = 4;
+  constexpr size_t kSduCount = 200;
+  constexpr size_t kSduSize = 100;
+
+  TearDown();
+  SetUp(hci::DataBufferInfo(hci::kMaxACLPayloadSize, kMaxNumPackets),
+        hci::DataBufferInfo(kMaxLEDataSize, kMaxNumPackets));
+
+  chanmgr()->RegisterLE(kTestHandle1, hci::Connection::Role::kMaster,
+                        [](auto) {}, DoNothing, dispatcher());
+
+  fbl::RefPtr<Channel> channel;
+  auto channel_cb = [&channel](fbl::RefPtr<l2cap::Channel> activated_chan) {
+    channel = std::move(activated_chan);
+  };
+  bool closed_cb_called = false;
+  auto closed_cb = [&closed_cb_called] { closed_cb_called = true; };
+  ActivateOutboundChannel(kTestPsm, std::move(channel_cb), kTestHandle1,
+                          std::move(closed_cb));
+  RunLoopUntilIdle();
+
+  // clang-format off
+  test_device()->SendACLDataChannelPacket(common::CreateStaticByteBuffer(
+      // ACL data header (handle: 0x0001, length: 18 bytes)
+      0x01, 0x00, 0x12, 0x00,
+
+      // L2CAP B-frame header (length: 14 bytes, channel-id: 0x0005 (LE sig))
+      0x0e, 0x00, 0x05, 0x00,
+
+      // LE Credit Based Connection Response (ID: 1, length: 10,
+      // dst cid: 0x0047, mtu: 512, mps: 23, initial credits: 4,
+      // result: success)
+      0x15, 0x01, 0x0a, 0x00,
+      0x47, 0x00, 0x00, 0x02,
+      kPeerMps, 0x00, kPeerCredits, 0x00,
+      0x00, 0x00));
+  // clang-format on
+
+  RunLoopUntilIdle();
+  ASSERT_TRUE(channel);
+
+  // The peer reassembles K-frames with its own engine and grants credits back
+  // in LE Flow Control Credit packets.
+  ChannelModeConfig peer_config;
+  peer_config.mode = ChannelMode::kLECreditBasedFlowControl;
+  peer_config.tx_mtu = kLECreditBasedDefaultMTU;
+  peer_config.tx_mps = kLECreditBasedDefaultMPS;
+  peer_config.tx_credits = kLECreditBasedDefaultInitialCredits;
+  peer_config.rx_mtu = kPeerMtu;
+  peer_config.rx_mps = kPeerMps;
+  peer_config.rx_credits = kPeerCredits;
+
+  std::vector<common::DynamicByteBuffer> peer_sdus;
+  size_t credit_packets = 0;
+  bool peer_error = false;
+  uint8_t credit_packet_id = 0;
+  internal::CreditBasedFlowControlEngine peer(
+      kRemoteId, peer_config, [](auto) {},
+      [&peer_sdus](SDU sdu) {
+        common::DynamicByteBuffer buffer(sdu.length());
+        sdu.Copy(&buffer);
+        peer_sdus.push_back(std::move(buffer));
+      },
+      [this, &credit_packets, &credit_packet_id](uint16_t credits) {
+        credit_packets++;
+        // clang-format off
+        test_device()->SendACLDataChannelPacket(common::CreateStaticByteBuffer(
+            // ACL data header (handle: 0x0001, length: 12 bytes)
+            0x01, 0x00, 0x0c, 0x00,
+
+            // L2CAP B-frame header (length: 8 bytes, channel-id: 0x0005)
+            0x08, 0x00, 0x05, 0x00,
+
+            // LE Flow Control Credit (length: 4, cid: 0x0047)
+            kLEFlowControlCredit, ++credit_packet_id, 0x04, 0x00,
+            0x47, 0x00, credits & 0xFF, credits >> 8));
+        // clang-format on
+      },
+      [&peer_error] { peer_error = true; });
+
+  size_t kframes = 0;
+  auto data_cb = [this, &peer, &kframes,
+                  kRemoteId](const common::ByteBuffer& bytes) {
+    ASSERT_LE(sizeof(hci::ACLDataHeader) + sizeof(BasicHeader), bytes.size());
+    const auto pdu = bytes.view(sizeof(hci::ACLDataHeader));
+    const auto& header = pdu.As<BasicHeader>();
+    ASSERT_EQ(kRemoteId, le16toh(header.channel_id));
+    ASSERT_EQ(pdu.size() - sizeof(BasicHeader), le16toh(header.length));
+    kframes++;
+    const auto payload = pdu.view(sizeof(BasicHeader));
+    peer.ProcessPdu(
+        Fragmenter(kTestHandle1).BuildBasicFrame(kRemoteId, payload));
+
+    // clang-format off
+    test_device()->SendCommandChannelPacket(common::CreateStaticByteBuffer(
+        0x13, 0x05,             // Event header
+        0x01,                   // Number of handles
+        0x01, 0x00, 0x01, 0x00  // 1 packet on handle 0x0001
+    ));
+    // clang-format on
+  };
+  test_device()->SetDataCallback(std::move(data_cb), dispatcher());
+
+  const auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < kSduCount; i++) {
+    common::DynamicByteBuffer sdu(kSduSize);
+    sdu.Fill(static_cast<uint8_t>(i));
+    EXPECT_TRUE(channel->Send(
+        std::make_unique<common::DynamicByteBuffer>(std::move(sdu))));
+  }
+  RunLoopUntilIdle();
+  const double elapsed_ms = std::chrono::duration<double, std::milli>(
+                                std::chrono::steady_clock::now() - start)
+                                .count();
+
+  EXPECT_FALSE(closed_cb_called);
+  EXPECT_FALSE(peer_error);
+  ASSERT_EQ(kSduCount, peer_sdus.size());
+  for (size_t i = 0; i < kSduCount; i++) {
+    common::DynamicByteBuffer expected(kSduSize);
+    expected.Fill(static_cast<uint8_t>(i));
+    EXPECT_TRUE(common::ContainersEqual(expected, peer_sdus[i]));
+  }
+
+  // The first K-frame of each SDU carries the SDU length and 21 bytes, and the
+  // rest carry 23 bytes each.
+  constexpr size_t kKFramesPerSdu = 5;
+  EXPECT_EQ(kSduCount * kKFramesPerSdu, kframes);
+
+  // Credits are returned in batches of half of the peer's initial credits.
+  EXPECT_EQ(kframes / (kPeerCredits / 2), credit_packets);
+
+  common::PrintBenchmarkResult(
+      "sdus,sdu_size,kframes,credit_packets,wall_ms,sdus_per_second\n");
+  common::PrintBenchmarkResult("%zu,%zu,%zu,%zu,%.1f,%.0f\n", kSduCount,
+                               kSduSize, kframes, credit_packets, elapsed_ms,
+                               kSduCount * 1000 / elapsed_ms);
+}
+
 }  // namespace
 }  // namespace l2cap
 }  // namespace btlib
@@ -0,0 +1,168 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "credit_based_flow_control_engine.h"
+
+#include <endian.h>
+
+#include <zircon/assert.h>
+
+#include "garnet/drivers/bluetooth/lib/common/log.h"
+
+namespace btlib {
+namespace l2cap {
+namespace internal {
+
+CreditBasedFlowControlEngine::CreditBasedFlowControlEngine(
+    ChannelId local_cid, const ChannelModeConfig& config,
+    SendFrameCallback send_frame_cb, SduCallback sdu_cb,
+    SendCreditsCallback send_credits_cb, ErrorCallback error_cb)
+    : local_cid_(local_cid),
+      tx_mps_(config.tx_mps),
+      rx_mtu_(config.rx_mtu),
+      rx_mps_(config.rx_mps),
+      initial_rx_credits_(config.rx_credits),
+      send_frame_cb_(std::move(send_frame_cb)),
+      sdu_cb_(std::move(sdu_cb)),
+      send_credits_cb_(std::move(send_credits_cb)),
+      error_cb_(std::move(error_cb)),
+      failed_(false),
+      tx_credits_(config.tx_credits),
+      rx_credits_(config.rx_credits),
+      rx_sdu_length_(0u) {
+  ZX_DEBUG_ASSERT(config.mode == ChannelMode::kLECreditBasedFlowControl);
+  ZX_DEBUG_ASSERT(tx_mps_ > kSduLengthFieldSize);
+  ZX_DEBUG_ASSERT(rx_mps_ > kSduLengthFieldSize);
+  ZX_DEBUG_ASSERT(send_frame_cb_);
+  ZX_DEBUG_ASSERT(sdu_cb_);
+  ZX_DEBUG_ASSERT(send_credits_cb_);
+  ZX_DEBUG_ASSERT(error_cb_);
+}
+
+void CreditBasedFlowControlEngine::QueueSdu(const common::ByteBuffer& sdu) {
+  if (failed_)
+    return;
+
+  // The first K-frame carries the SDU length ahead of its first segment, even
+  // when the SDU fits in it entirely.
+  size_t offset = std::min<size_t>(tx_mps_ - kSduLengthFieldSize, sdu.size());
+  common::DynamicByteBuffer first(kSduLengthFieldSize + offset);
+  first.WriteObj(htole16(static_cast<uint16_t>(sdu.size())));
+  first.Write(sdu.view(0, offset), kSduLengthFieldSize);
+  queued_frames_.push_back(std::move(first));
+
+  while (offset < sdu.size()) {
+    const size_t size = std::min<size_t>(tx_mps_, sdu.size() - offset);
+    queued_frames_.push_back(
+        common::DynamicByteBuffer(sdu.view(offset, size)));
+    offset += size;
+  }
+
+  TrySendQueuedFrames();
+}
+
+void CreditBasedFlowControlEngine::ProcessPdu(PDU pdu) {
+  ZX_DEBUG_ASSERT(pdu.is_valid());
+  if (failed_)
+    return;
+
+  // A peer that sends K-frames without credits, or K-frames or SDUs larger than
+  // we can receive, is to be disconnected (see Core Spec v5.0, Vol 3, Part A,
+  // Section 10.1).
+  if (!rx_credits_) {
+    bt_log(TRACE, "l2cap", "Channel %#.4x: K-frame received without credits",
+           local_cid_);
+    SignalError();
+    return;
+  }
+  const size_t frame_size = pdu.length();
+  if (frame_size > rx_mps_) {
+    bt_log(TRACE, "l2cap", "Channel %#.4x: K-frame exceeds MPS (%zu bytes)",
+           local_cid_, frame_size);
+    SignalError();
+    return;
+  }
+  rx_credits_--;
+
+  if (!rx_sdu_.is_valid()) {
+    if (frame_size < kSduLengthFieldSize) {
+      bt_log(TRACE, "l2cap", "Channel %#.4x: first K-frame too short",
+             local_cid_);
+      SignalError();
+      return;
+    }
+    common::StaticByteBuffer<kSduLengthFieldSize> sdu_length_field;
+    pdu.Copy(&sdu_length_field, 0, kSduLengthFieldSize);
+    const size_t sdu_length = le16toh(sdu_length_field.As<uint16_t>());
+    if (sdu_length > rx_mtu_ ||
+        frame_size - kSduLengthFieldSize > sdu_length) {
+      bt_log(TRACE, "l2cap", "Channel %#.4x: bad SDU length %zu", local_cid_,
+             sdu_length);
+      SignalError();
+      return;
+    }
+    rx_sdu_length_ = sdu_length;
+    rx_sdu_.Append(std::move(pdu), kSduLengthFieldSize);
+  } else {
+    if (rx_sdu_.length() + frame_size > rx_sdu_length_) {
+      bt_log(TRACE, "l2cap", "Channel %#.4x: K-frame exceeds SDU length",
+             local_cid_);
+      SignalError();
+      return;
+    }
+    rx_sdu_.Append(std::move(pdu));
+  }
+
+  if (rx_sdu_.length() == rx_sdu_length_) {
+    sdu_cb_(std::move(rx_sdu_));
+    rx_sdu_ = SDU();
+    if (failed_)
+      return;
+  }
+
+  // Returning credits one at a time would cost a signaling packet per K-frame.
+  if (rx_credits_ <= initial_rx_credits_ / 2) {
+    const uint16_t credits = initial_rx_credits_ - rx_credits_;
+    rx_credits_ = initial_rx_credits_;
+    send_credits_cb_(credits);
+  }
+}
+
+void CreditBasedFlowControlEngine::AddCredits(uint16_t credits) {
+  if (failed_)
+    return;
+
+  if (static_cast<uint32_t>(tx_credits_) + credits > kLECreditBasedMaxCredits) {
+    bt_log(TRACE, "l2cap", "Channel %#.4x: credit count overflow",
+           local_cid_);
+    SignalError();
+    return;
+  }
+
+  tx_credits_ += credits;
+  TrySendQueuedFrames();
+}
+
+void CreditBasedFlowControlEngine::TrySendQueuedFrames() {
+  while (!queued_frames_.empty() && tx_credits_) {
+    auto frame = std::make_unique<common::DynamicByteBuffer>(
+        std::move(queued_frames_.front()));
+    queued_frames_.pop_front();
+    tx_credits_--;
+    send_frame_cb_(std::move(frame));
+  }
+}
+
+void CreditBasedFlowControlEngine::SignalError() {
+  if (failed_)
+    return;
+
+  failed_ = true;
+  queued_frames_.clear();
+  error_cb_();
+}
+
+}  // namespace internal
+}  // namespace l2cap
+}  // namespace btlib
@@ -0,0 +1,115 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef GARNET_DRIVERS_BLUETOOTH_LIB_L2CAP_CREDIT_BASED_FLOW_CONTROL_ENGINE_H_
+#define GARNET_DRIVERS_BLUETOOTH_LIB_L2CAP_CREDIT_BASED_FLOW_CONTROL_ENGINE_H_
+
+#include <deque>
+
+#include <lib/fit/function.h>
+
+#include "garnet/drivers/bluetooth/lib/common/byte_buffer.h"
+#include "garnet/drivers/bluetooth/lib/l2cap/l2cap.h"
+#include "garnet/drivers/bluetooth/lib/l2cap/pdu.h"
+#include "garnet/drivers/bluetooth/lib/l2cap/sdu.h"
+#include "lib/fxl/macros.h"
+
+namespace btlib {
+namespace l2cap {
+namespace internal {
+
+// Implements the data transfer procedures of LE Credit Based Flow Control Mode
+// for one channel (see Core Spec v5.0, Vol 3, Part A, Section 10.1). Outbound
+// SDUs are segmented into K-frames of at most the peer's MPS, the first of
+// which carries the SDU length, and inbound K-frames are reassembled into SDUs.
+// Reassembly chains the K-frames' payloads together without copying them.
+//
+// Each K-frame sent uses up one of the credits that the peer has granted us;
+// frames are queued while we have none left. The peer is granted credits back
+// in batches as its K-frames are processed, which is once half of its initial
+// credits have been used up.
+//
+// This class is not thread-safe.
+class CreditBasedFlowControlEngine final {
+ public:
+  // Called with the information payload of each K-frame to send to the peer.
+  using SendFrameCallback = fit::function<void(common::ByteBufferPtr frame)>;
+
+  // Called with each complete SDU received from the peer.
+  using SduCallback = fit::function<void(SDU sdu)>;
+
+  // Called with the number of credits to grant the peer in an LE Flow Control
+  // Credit packet.
+  using SendCreditsCallback = fit::function<void(uint16_t credits)>;
+
+  // Called when the peer violates the protocol, after which the channel should
+  // be disconnected. The engine does nothing more once this has been called.
+  using ErrorCallback = fit::closure;
+
+  // |config.mode| must be kLECreditBasedFlowControl.
+  CreditBasedFlowControlEngine(ChannelId local_cid,
+                               const ChannelModeConfig& config,
+                               SendFrameCallback send_frame_cb,
+                               SduCallback sdu_cb,
+                               SendCreditsCallback send_credits_cb,
+                               ErrorCallback error_cb);
+  ~CreditBasedFlowControlEngine() = default;
+
+  // Segments |sdu| into K-frames and sends as many of them as we have credits
+  // for, queueing the rest.
+  void QueueSdu(const common::ByteBuffer& sdu);
+
+  // Processes a K-frame received from the peer, taking ownership of it.
+  void ProcessPdu(PDU pdu);
+
+  // Adds |credits| granted by the peer and sends the frames that they allow.
+  void AddCredits(uint16_t credits);
+
+  // The number of K-frames that we may still send.
+  uint16_t tx_credits() const { return tx_credits_; }
+
+  // The number of K-frames waiting for credits from the peer.
+  size_t queued_frame_count() const { return queued_frames_.size(); }
+
+ private:
+  // Sends queued K-frames for as long as we have credits.
+  void TrySendQueuedFrames();
+
+  void SignalError();
+
+  const ChannelId local_cid_;
+  const uint16_t tx_mps_;
+  const uint16_t rx_mtu_;
+  const uint16_t rx_mps_;
+  const uint16_t initial_rx_credits_;
+
+  SendFrameCallback send_frame_cb_;
+  SduCallback sdu_cb_;
+  SendCreditsCallback send_credits_cb_;
+  ErrorCallback error_cb_;
+
+  // Set once |error_cb_| has been called.
+  bool failed_;
+
+  // Transmitter state.
+  uint16_t tx_credits_;
+  std::deque<common::DynamicByteBuffer> queued_frames_;
+
+  // Receiver state. |rx_credits_| is the number of K-frames that the peer may
+  // still send.
+  uint16_t rx_credits_;
+
+  // The SDU being reassembled, if |rx_sdu_| is valid, and the length that it
+  // will have once complete.
+  SDU rx_sdu_;
+  size_t rx_sdu_length_;
+
+  FXL_DISALLOW_COPY_AND_ASSIGN(CreditBasedFlowControlEngine);
+};
+
+}  // namespace internal
+}  // namespace l2cap
+}  // namespace btlib
+
+#endif  // GARNET_DRIVERS_BLUETOOTH_LIB_L2CAP_CREDIT_BASED_FLOW_CONTROL_ENGINE_H_
@@ -0,0 +1,341 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "credit_based_flow_control_engine.h"
+
+#include <endian.h>
+
+#include <vector>
+
+#include <lib/async/cpp/task.h>
+
+#include "garnet/drivers/bluetooth/lib/common/test_helpers.h"
+#include "garnet/drivers/bluetooth/lib/l2cap/fragmenter.h"
+#include "lib/gtest/test_loop_fixture.h"
+
+namespace btlib {
+namespace l2cap {
+namespace internal {
+namespace {
+
+constexpr hci::ConnectionHandle kTestHandle = 0x0001;
+constexpr ChannelId kCid0 = 0x0040;
+constexpr ChannelId kCid1 = 0x0041;
+
+// One-way latency of the simulated link.
+constexpr zx::duration kLinkDelay = zx::msec(5);
+
+// Returns the configuration of an end of a channel whose ends both use |mtu|,
+// |mps| and |credits|.
+ChannelModeConfig MakeConfig(uint16_t mtu = 512, uint16_t mps = 64,
+                             uint16_t credits = 8) {
+  ChannelModeConfig config;
+  config.mode = ChannelMode::kLECreditBasedFlowControl;
+  config.tx_mtu = mtu;
+  config.tx_mps = mps;
+  config.tx_credits = credits;
+  config.rx_mtu = mtu;
+  config.rx_mps = mps;
+  config.rx_credits = credits;
+  return config;
+}
+
+common::DynamicByteBuffer MakeSdu(size_t size, uint8_t seed) {
+  common::DynamicByteBuffer sdu(size);
+  for (size_t i = 0; i < size; i++) {
+    sdu[i] = static_cast<uint8_t>(seed + i * 7);
+  }
+  return sdu;
+}
+
+// Returns a K-frame to |cid| with |payload| as its information payload.
+PDU MakeKFrame(ChannelId cid, const common::ByteBuffer& payload) {
+  return Fragmenter(kTestHandle).BuildBasicFrame(cid, payload);
+}
+
+common::DynamicByteBuffer CopySdu(const SDU& sdu) {
+  common::DynamicByteBuffer buffer(sdu.length());
+  sdu.Copy(&buffer);
+  return buffer;
+}
+
+// Connects two engines over a simulated link, which delivers each K-frame and
+// each grant of credits after kLinkDelay.
+class L2CAP_CreditBasedFlowControlEngineTest
+    : public ::gtest::TestLoopFixture {
+ public:
+  L2CAP_CreditBasedFlowControlEngineTest() = default;
+  ~L2CAP_CreditBasedFlowControlEngineTest() override = default;
+
+ protected:
+  void TearDown() override {
+    engine0_ = nullptr;
+    engine1_ = nullptr;
+  }
+
+  // Creates the engines at both ends of the channel and resets the error
+  // count.
+  void Connect(const ChannelModeConfig& config0,
+               const ChannelModeConfig& config1) {
+    errors_ = 0;
+    engine0_ = std::make_unique<CreditBasedFlowControlEngine>(
+        kCid0, config0, [this](auto frame) { Transmit(0, std::move(frame)); },
+        [this](SDU sdu) { sdus0_.push_back(CopySdu(sdu)); },
+        [this](uint16_t credits) { GrantCredits(0, credits); },
+        [this] { errors_++; });
+    engine1_ = std::make_unique<CreditBasedFlowControlEngine>(
+        kCid1, config1, [this](auto frame) { Transmit(1, std::move(frame)); },
+        [this](SDU sdu) {
+          sdus1_.push_back(CopySdu(sdu));
+          last_sdu_time_ = Now();
+        },
+        [this](uint16_t credits) { GrantCredits(1, credits); },
+        [this] { errors_++; });
+  }
+
+  CreditBasedFlowControlEngine* engine0() const { return engine0_.get(); }
+  CreditBasedFlowControlEngine* engine1() const { return engine1_.get(); }
+
+  const std::vector<common::DynamicByteBuffer>& frames0() const {
+    return frames0_;
+  }
+  const std::vector<common::DynamicByteBuffer>& sdus1() const {
+    return sdus1_;
+  }
+  size_t credit_packets() const { return credit_packets_; }
+  size_t errors() const { return errors_; }
+  zx::time last_sdu_time() const { return last_sdu_time_; }
+
+ private:
+  void Transmit(int from, common::ByteBufferPtr frame) {
+    if (from == 0) {
+      frames0_.emplace_back(*frame);
+    }
+    async::PostDelayedTask(
+        dispatcher(),
+        [this, from, frame = std::move(frame)] {
+          auto* to = from == 0 ? engine1_.get() : engine0_.get();
+          if (to)
+            to->ProcessPdu(MakeKFrame(from == 0 ? kCid1 : kCid0, *frame));
+        },
+        kLinkDelay);
+  }
+
+  void GrantCredits(int from, uint16_t credits) {
+    credit_packets_++;
+    async::PostDelayedTask(
+        dispatcher(),
+        [this, from, credits] {
+          auto* to = from == 0 ? engine1_.get() : engine0_.get();
+          if (to)
+            to->AddCredits(credits);
+        },
+        kLinkDelay);
+  }
+
+  std::unique_ptr<CreditBasedFlowControlEngine> engine0_;
+  std::unique_ptr<CreditBasedFlowControlEngine> engine1_;
+  std::vector<common::DynamicByteBuffer> frames0_;
+  std::vector<common::DynamicByteBuffer> sdus0_;
+  std::vector<common::DynamicByteBuffer> sdus1_;
+  size_t credit_packets_ = 0;
+  size_t errors_ = 0;
+  zx::time last_sdu_time_;
+};
+
+TEST_F(L2CAP_CreditBasedFlowControlEngineTest, SegmentSduIntoKFrames) {
+  Connect(MakeConfig(), MakeConfig());
+
+  // 62 bytes fit in the first K-frame beside the SDU length, then 64 per frame.
+  const auto sdu = MakeSdu(150, 1);
+  engine0()->QueueSdu(sdu);
+  ASSERT_EQ(3u, frames0().size());
+  EXPECT_EQ(64u, frames0()[0].size());
+  EXPECT_EQ(150u, le16toh(frames0()[0].As<uint16_t>()));
+  EXPECT_EQ(64u, frames0()[1].size());
+  EXPECT_EQ(24u, frames0()[2].size());
+  EXPECT_EQ(5u, engine0()->tx_credits());
+
+  RunLoopFor(zx::sec(1));
+  ASSERT_EQ(1u, sdus1().size());
+  EXPECT_TRUE(ContainersEqual(sdu, sdus1()[0]));
+  EXPECT_EQ(0u, errors());
+}
+
+TEST_F(L2CAP_CreditBasedFlowControlEngineTest, SmallAndEmptySdus) {
+  Connect(MakeConfig(), MakeConfig());
+
+  engine0()->QueueSdu(MakeSdu(10, 2));
+  engine0()->QueueSdu(common::BufferView());
+  ASSERT_EQ(2u, frames0().size());
+  EXPECT_EQ(12u, frames0()[0].size());
+  EXPECT_EQ(2u, frames0()[1].size());
+
+  RunLoopFor(zx::sec(1));
+  ASSERT_EQ(2u, sdus1().size());
+  EXPECT_TRUE(ContainersEqual(MakeSdu(10, 2), sdus1()[0]));
+  EXPECT_EQ(0u, sdus1()[1].size());
+}
+
+TEST_F(L2CAP_CreditBasedFlowControlEngineTest, ReassembleWithoutCopying) {
+  // Feed the receiver directly so that the K-frames can be inspected.
+  std::vector<SDU> sdus;
+  CreditBasedFlowControlEngine engine(
+      kCid1, MakeConfig(), [](auto) {},
+      [&sdus](SDU sdu) { sdus.push_back(std::move(sdu)); }, [](auto) {},
+      [] { ADD_FAILURE(); });
+
+  // Keep track of where the K-frames' payloads are held.
+  auto kframe0 = MakeKFrame(kCid1, common::CreateStaticByteBuffer(
+                                       // SDU length: 5
+                                       0x05, 0x00,
+                                       // Payload
+                                       'H', 'e'));
+  auto kframe1 =
+      MakeKFrame(kCid1, common::CreateStaticByteBuffer('l', 'l', 'o'));
+  const uint8_t* const payload0 =
+      kframe0.ViewFirstFragment(kframe0.length()).data();
+  const uint8_t* const payload1 =
+      kframe1.ViewFirstFragment(kframe1.length()).data();
+
+  engine.ProcessPdu(std::move(kframe0));
+  EXPECT_TRUE(sdus.empty());
+  engine.ProcessPdu(std::move(kframe1));
+  ASSERT_EQ(1u, sdus.size());
+  EXPECT_EQ(5u, sdus[0].length());
+  EXPECT_EQ(2u, sdus[0].segment_count());
+
+  // The SDU is a view of each K-frame's payload, less the SDU length field.
+  std::vector<const uint8_t*> fragments;
+  sdus[0].ForEachFragment([&fragments](const common::ByteBuffer& data) {
+    fragments.push_back(data.data());
+  });
+  ASSERT_EQ(2u, fragments.size());
+  EXPECT_EQ(payload0 + sizeof(uint16_t), fragments[0]);
+  EXPECT_EQ(payload1, fragments[1]);
+  const auto expected = common::CreateStaticByteBuffer('H', 'e', 'l', 'l', 'o');
+  EXPECT_TRUE(ContainersEqual(expected, CopySdu(sdus[0])));
+}
+
+TEST_F(L2CAP_CreditBasedFlowControlEngineTest, QueueFramesUntilCreditsGranted) {
+  Connect(MakeConfig(512, 64, 4), MakeConfig(512, 64, 4));
+
+  // Eight K-frames, of which only four can be sent before the receiver grants
+  // more credits.
+  engine0()->QueueSdu(MakeSdu(62 + 64 * 7, 3));
+  EXPECT_EQ(4u, frames0().size());
+  EXPECT_EQ(0u, engine0()->tx_credits());
+  EXPECT_EQ(4u, engine0()->queued_frame_count());
+
+  RunLoopFor(zx::sec(1));
+  EXPECT_EQ(8u, frames0().size());
+  EXPECT_EQ(0u, engine0()->queued_frame_count());
+  ASSERT_EQ(1u, sdus1().size());
+  EXPECT_TRUE(ContainersEqual(MakeSdu(62 + 64 * 7, 3), sdus1()[0]));
+
+  // Credits are returned in batches of half of the initial credits.
+  EXPECT_EQ(4u, credit_packets());
+  EXPECT_EQ(4u, engine0()->tx_credits());
+  EXPECT_EQ(0u, errors());
+}
+
+TEST_F(L2CAP_CreditBasedFlowControlEngineTest, FrameWithoutCreditsIsError) {
+  // The sender believes that it has credits that the receiver never granted.
+  auto config1 = MakeConfig();
+  config1.rx_credits = 0;
+  Connect(MakeConfig(), config1);
+
+  engine0()->QueueSdu(MakeSdu(10, 4));
+  RunLoopFor(zx::sec(1));
+  EXPECT_EQ(1u, errors());
+  EXPECT_TRUE(sdus1().empty());
+}
+
+TEST_F(L2CAP_CreditBasedFlowControlEngineTest,
+       OversizedFramesAndSdusAreErrors) {
+  Connect(MakeConfig(), MakeConfig(100, 32));
+
+  // Larger than engine1's MPS.
+  engine1()->ProcessPdu(MakeKFrame(kCid1, MakeSdu(33, 5)));
+  EXPECT_EQ(1u, errors());
+
+  Connect(MakeConfig(), MakeConfig(100, 32));
+
+  // An SDU length larger than engine1's MTU.
+  auto frame = common::CreateStaticByteBuffer(
+      // SDU length: 101
+      0x65, 0x00,
+      // Payload
+      0x01, 0x02);
+  engine1()->ProcessPdu(MakeKFrame(kCid1, frame));
+  EXPECT_EQ(1u, errors());
+
+  Connect(MakeConfig(), MakeConfig(100, 32));
+
+  // A continuation K-frame that overruns the SDU length.
+  frame = common::CreateStaticByteBuffer(
+      // SDU length: 4
+      0x04, 0x00,
+      // Payload
+      0x01, 0x02);
+  engine1()->ProcessPdu(MakeKFrame(kCid1, frame));
+  engine1()->ProcessPdu(
+      MakeKFrame(kCid1, common::CreateStaticByteBuffer(0x03, 0x04, 0x05)));
+  EXPECT_EQ(1u, errors());
+  EXPECT_TRUE(sdus1().empty());
+}
+
+TEST_F(L2CAP_CreditBasedFlowControlEngineTest, CreditOverflowIsError) {
+  Connect(MakeConfig(), MakeConfig());
+
+  engine0()->AddCredits(kLECreditBasedMaxCredits - engine0()->tx_credits());
+  EXPECT_EQ(0u, errors());
+  engine0()->AddCredits(1);
+  EXPECT_EQ(1u, errors());
+}
+
+TEST_F(L2CAP_CreditBasedFlowControlEngineTest, Throughput) {
+  constexpr size_t kSduCount = 500;
+  constexpr size_t kSduSize = 1000;
+  constexpr uint16_t kCredits[] = {2, 8, 32};
+
+  common::PrintBenchmarkResult(
+      "mps,initial_credits,kframes_sent,credit_packets,sdus_delivered,"
+      "simulated_ms,goodput_kbps\n");
+  for (uint16_t mps : {uint16_t{64}, kLECreditBasedDefaultMPS}) {
+    for (uint16_t credits : kCredits) {
+      const auto config = MakeConfig(kSduSize, mps, credits);
+      Connect(config, config);
+      const size_t frames_before = frames0().size();
+      const size_t sdus_before = sdus1().size();
+      const size_t credit_packets_before = credit_packets();
+
+      const zx::time start = Now();
+      for (size_t i = 0; i < kSduCount; i++) {
+        engine0()->QueueSdu(MakeSdu(kSduSize, i));
+      }
+      RunLoopFor(zx::sec(600));
+      const double elapsed_ms = (last_sdu_time() - start).to_msecs();
+      const size_t delivered = sdus1().size() - sdus_before;
+
+      EXPECT_EQ(0u, errors());
+      ASSERT_EQ(kSduCount, delivered);
+      for (size_t i = 0; i < kSduCount; i++) {
+        EXPECT_TRUE(
+            ContainersEqual(MakeSdu(kSduSize, i), sdus1()[sdus_before + i]));
+      }
+
+      common::PrintBenchmarkResult(
+          "%u,%u,%zu,%zu,%zu,%.0f,%.1f\n", mps, credits,
+          frames0().size() - frames_before,
+          credit_packets() - credit_packets_before, delivered, elapsed_ms,
+          delivered * kSduSize * 8 / elapsed_ms);
+    }
+  }
+}
+
+}  // namespace
+}  // namespace internal
+}  // namespace l2cap
+}  // namespace btlib
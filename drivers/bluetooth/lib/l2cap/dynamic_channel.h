@@ -84,6 +84,10 @@ class DynamicChannel {
   // connection completion.
   ChannelId remote_cid() const { return remote_cid_; }
 
+  // The mode of the channel and its parameters, as negotiated during
+  // configuration. Channels are in Basic mode unless configured otherwise.
+  const ChannelModeConfig& mode_config() const { return mode_config_; }
+
   // True if the channel was ever opened (that is, if |IsOpen| was ever true and
   // |Open| provided that result to its caller). Used by DynamicChannelRegistry
   // to track channel closure cleanup.
@@ -104,6 +108,10 @@ class DynamicChannel {
 
   void set_opened() { opened_ = true; }
 
+  void set_mode_config(const ChannelModeConfig& config) {
+    mode_config_ = config;
+  }
+
  private:
   // Must be valid for the duration of this object.
   DynamicChannelRegistry* const registry_;
@@ -112,6 +120,7 @@ class DynamicChannel {
   const ChannelId local_cid_;
   ChannelId remote_cid_;
   bool opened_;
+  ChannelModeConfig mode_config_;
 
   FXL_DISALLOW_COPY_AND_ASSIGN(DynamicChannel);
 };
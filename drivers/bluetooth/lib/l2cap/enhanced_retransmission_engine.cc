@@ -0,0 +1,537 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "enhanced_retransmission_engine.h"
+
+#include <endian.h>
+
+#include <zircon/assert.h>
+
+#include "garnet/drivers/bluetooth/lib/common/log.h"
+
+namespace btlib {
+namespace l2cap {
+namespace internal {
+namespace {
+
+// Returns the distance from sequence number |from| forward to |to|.
+uint8_t SeqDistance(uint8_t from, uint8_t to) {
+  return (to - from) & kSeqNumMask;
+}
+
+uint8_t NextSeq(uint8_t seq) { return (seq + 1) & kSeqNumMask; }
+
+uint8_t GetReqSeq(uint16_t control) {
+  return (control >> kReqSeqShift) & kSeqNumMask;
+}
+
+}  // namespace
+
+uint16_t ComputeFcs(const common::ByteBuffer& data, uint16_t initial) {
+  uint16_t crc = initial;
+  for (uint8_t byte : data) {
+    crc ^= byte;
+    for (int i = 0; i < 8; i++) {
+      // 0xA001 is the generator polynomial with its bits reversed, as the CRC
+      // is computed least significant bit first.
+      crc = (crc & 1) ? (crc >> 1) ^ 0xA001 : (crc >> 1);
+    }
+  }
+  return crc;
+}
+
+EnhancedRetransmissionEngine::EnhancedRetransmissionEngine(
+    ChannelId local_cid, ChannelId remote_cid, const ChannelModeConfig& config,
+    SendFrameCallback send_frame_cb, SduCallback sdu_cb,
+    ErrorCallback error_cb, async_dispatcher_t* dispatcher)
+    : local_cid_(local_cid),
+      remote_cid_(remote_cid),
+      mode_(config.mode),
+      tx_window_size_(config.tx_window_size),
+      max_transmit_(config.max_transmit),
+      retransmission_timeout_(zx::msec(config.retransmission_timeout_ms)),
+      monitor_timeout_(zx::msec(config.monitor_timeout_ms)),
+      tx_mps_(config.tx_mps),
+      send_frame_cb_(std::move(send_frame_cb)),
+      sdu_cb_(std::move(sdu_cb)),
+      error_cb_(std::move(error_cb)),
+      dispatcher_(dispatcher),
+      failed_(false),
+      next_tx_seq_(0),
+      expected_ack_seq_(0),
+      remote_busy_(false),
+      wait_final_(false),
+      poll_count_(0),
+      retransmission_count_(0),
+      expected_tx_seq_(0),
+      ack_pending_(false),
+      rx_sdu_offset_(0),
+      rx_sdu_started_(false) {
+  ZX_DEBUG_ASSERT(mode_ == ChannelMode::kEnhancedRetransmission ||
+                  mode_ == ChannelMode::kStreaming);
+  ZX_DEBUG_ASSERT(is_streaming() || tx_window_size_);
+  ZX_DEBUG_ASSERT(tx_mps_ > kSduLengthFieldSize);
+  ZX_DEBUG_ASSERT(send_frame_cb_);
+  ZX_DEBUG_ASSERT(sdu_cb_);
+  ZX_DEBUG_ASSERT(error_cb_);
+  ZX_DEBUG_ASSERT(dispatcher_);
+}
+
+void EnhancedRetransmissionEngine::QueueSdu(const common::ByteBuffer& sdu) {
+  if (failed_)
+    return;
+
+  if (sdu.size() <= tx_mps_) {
+    queued_frames_.push_back(
+        TxFrame{SegmentationStatus::kUnsegmented, common::DynamicByteBuffer(sdu)});
+  } else {
+    // The start frame carries the SDU length ahead of its first segment.
+    size_t offset = tx_mps_ - kSduLengthFieldSize;
+    common::DynamicByteBuffer start(tx_mps_);
+    start.WriteObj(htole16(static_cast<uint16_t>(sdu.size())));
+    start.Write(sdu.view(0, offset), kSduLengthFieldSize);
+    queued_frames_.push_back(
+        TxFrame{SegmentationStatus::kStart, std::move(start)});
+
+    while (offset < sdu.size()) {
+      const size_t size = std::min<size_t>(tx_mps_, sdu.size() - offset);
+      const auto sar = (offset + size == sdu.size())
+                           ? SegmentationStatus::kEnd
+                           : SegmentationStatus::kContinuation;
+      queued_frames_.push_back(
+          TxFrame{sar, common::DynamicByteBuffer(sdu.view(offset, size))});
+      offset += size;
+    }
+  }
+
+  TrySendQueuedFrames();
+}
+
+void EnhancedRetransmissionEngine::ProcessFrame(
+    const common::ByteBuffer& frame) {
+  if (failed_)
+    return;
+
+  if (frame.size() < kEnhancedControlFieldSize + kFcsSize) {
+    bt_log(TRACE, "l2cap", "Channel %#.4x: dropping short frame (%zu bytes)",
+           local_cid_, frame.size());
+    return;
+  }
+
+  // The FCS covers the Basic L2CAP header, which the peer addressed to us.
+  BasicHeader header;
+  header.length = htole16(frame.size());
+  header.channel_id = htole16(local_cid_);
+  const size_t fcs_offset = frame.size() - kFcsSize;
+  const uint16_t fcs = ComputeFcs(
+      frame.view(0, fcs_offset),
+      ComputeFcs(common::BufferView(&header, sizeof(header))));
+  if (fcs != le16toh(frame.view(fcs_offset).As<uint16_t>())) {
+    bt_log(TRACE, "l2cap", "Channel %#.4x: dropping frame with bad FCS",
+           local_cid_);
+    return;
+  }
+
+  const uint16_t control = le16toh(frame.As<uint16_t>());
+  if (control & kFrameTypeSFrameBit) {
+    // Nothing is acknowledged or retransmitted in Streaming Mode.
+    if (!is_streaming()) {
+      ProcessSFrame(control);
+    }
+    return;
+  }
+
+  ProcessIFrame(control,
+                frame.view(kEnhancedControlFieldSize,
+                           fcs_offset - kEnhancedControlFieldSize));
+
+  // The frame may have acknowledged some of ours, making room for more.
+  if (!is_streaming()) {
+    TrySendQueuedFrames();
+  }
+}
+
+void EnhancedRetransmissionEngine::TrySendQueuedFrames() {
+  while (!failed_ && !queued_frames_.empty()) {
+    if (!is_streaming() && (remote_busy_ || wait_final_ ||
+                            unacked_frames_.size() >= tx_window_size_)) {
+      return;
+    }
+
+    TxFrame frame = std::move(queued_frames_.front());
+    queued_frames_.pop_front();
+    frame.tx_seq = next_tx_seq_;
+    next_tx_seq_ = NextSeq(next_tx_seq_);
+
+    if (is_streaming()) {
+      TransmitIFrame(&frame, false);
+      continue;
+    }
+
+    unacked_frames_.push_back(std::move(frame));
+    if (!TransmitIFrame(&unacked_frames_.back(), false))
+      return;
+    if (!retransmission_task_.is_pending()) {
+      StartRetransmissionTimer();
+    }
+  }
+}
+
+bool EnhancedRetransmissionEngine::TransmitIFrame(TxFrame* frame, bool final) {
+  if (max_transmit_ && frame->transmit_count >= max_transmit_) {
+    bt_log(TRACE, "l2cap",
+           "Channel %#.4x: I-frame %u sent %u times without acknowledgement",
+           local_cid_, frame->tx_seq, frame->transmit_count);
+    SignalError();
+    return false;
+  }
+
+  if (frame->transmit_count) {
+    retransmission_count_++;
+  }
+  frame->transmit_count++;
+
+  // Every I-frame acknowledges the I-frames that we have received so far
+  // (except in Streaming Mode, where ReqSeq is always zero).
+  uint16_t control = (frame->tx_seq << kTxSeqShift) |
+                     (static_cast<uint16_t>(frame->sar) << kSarShift);
+  if (!is_streaming()) {
+    control |= expected_tx_seq_ << kReqSeqShift;
+    ack_pending_ = false;
+  }
+  if (final) {
+    control |= kFinalBit;
+  }
+  SendFrame(control, frame->payload);
+  return true;
+}
+
+void EnhancedRetransmissionEngine::RetransmitUnackedFrames(bool final) {
+  for (auto& frame : unacked_frames_) {
+    if (!TransmitIFrame(&frame, final))
+      return;
+
+    // Only the first frame answers a Poll.
+    final = false;
+  }
+  if (!unacked_frames_.empty()) {
+    StartRetransmissionTimer();
+  }
+}
+
+void EnhancedRetransmissionEngine::SendSFrame(SupervisoryFunction function,
+                                              uint8_t req_seq, bool poll,
+                                              bool final) {
+  uint16_t control = kFrameTypeSFrameBit |
+                     (static_cast<uint16_t>(function)
+                      << kSupervisoryFunctionShift) |
+                     (req_seq << kReqSeqShift);
+  if (poll) {
+    control |= kPollBit;
+  }
+  if (final) {
+    control |= kFinalBit;
+  }
+
+  // Receiver Ready and Reject acknowledge the I-frames received so far.
+  if (function != SupervisoryFunction::kSelectiveReject) {
+    ack_pending_ = false;
+  }
+  SendFrame(control, common::BufferView());
+}
+
+void EnhancedRetransmissionEngine::SendFrame(
+    uint16_t control, const common::ByteBuffer& payload) {
+  const size_t fcs_offset = kEnhancedControlFieldSize + payload.size();
+  auto frame = std::make_unique<common::DynamicByteBuffer>(fcs_offset + kFcsSize);
+  frame->WriteObj(htole16(control));
+  frame->Write(payload, kEnhancedControlFieldSize);
+
+  BasicHeader header;
+  header.length = htole16(frame->size());
+  header.channel_id = htole16(remote_cid_);
+  const uint16_t fcs = ComputeFcs(
+      frame->view(0, fcs_offset),
+      ComputeFcs(common::BufferView(&header, sizeof(header))));
+  frame->WriteObj(htole16(fcs), fcs_offset);
+
+  send_frame_cb_(std::move(frame));
+}
+
+void EnhancedRetransmissionEngine::ProcessIFrame(
+    uint16_t control, const common::ByteBuffer& payload) {
+  const uint8_t tx_seq = (control >> kTxSeqShift) & kSeqNumMask;
+  const auto sar = static_cast<SegmentationStatus>(control >> kSarShift);
+
+  if (is_streaming()) {
+    // Frames that never arrived are not coming, so drop the SDU that they were
+    // part of.
+    if (tx_seq != expected_tx_seq_) {
+      rx_sdu_started_ = false;
+    }
+    expected_tx_seq_ = NextSeq(tx_seq);
+    Reassemble(sar, payload);
+    return;
+  }
+
+  if (!ProcessReqSeq(GetReqSeq(control)))
+    return;
+  if (control & kFinalBit) {
+    ProcessFinal();
+  }
+  if (failed_)
+    return;
+
+  const uint8_t distance = SeqDistance(expected_tx_seq_, tx_seq);
+  if (distance >= kErtmReceiveWindowSize) {
+    // A retransmission of a frame that we've already received, probably
+    // because our acknowledgement was lost. Acknowledge it again.
+    ack_pending_ = true;
+    if (!ack_task_.is_pending()) {
+      ack_task_.Post(dispatcher_);
+    }
+    return;
+  }
+
+  if (distance) {
+    // Hold on to the frame until the ones before it arrive, and ask for each
+    // of those that we haven't asked for yet.
+    out_of_sequence_frames_.emplace(
+        tx_seq, std::make_pair(sar, common::DynamicByteBuffer(payload)));
+    for (uint8_t seq = expected_tx_seq_; seq != tx_seq; seq = NextSeq(seq)) {
+      if (!out_of_sequence_frames_.count(seq) &&
+          selectively_rejected_.insert(seq).second) {
+        SendSFrame(SupervisoryFunction::kSelectiveReject, seq, false, false);
+      }
+    }
+    return;
+  }
+
+  Reassemble(sar, payload);
+  expected_tx_seq_ = NextSeq(expected_tx_seq_);
+  selectively_rejected_.erase(tx_seq);
+
+  // The frame may have filled a gap.
+  for (auto iter = out_of_sequence_frames_.find(expected_tx_seq_);
+       iter != out_of_sequence_frames_.end();
+       iter = out_of_sequence_frames_.find(expected_tx_seq_)) {
+    Reassemble(iter->second.first, iter->second.second);
+    out_of_sequence_frames_.erase(iter);
+    expected_tx_seq_ = NextSeq(expected_tx_seq_);
+  }
+
+  // Acknowledge the frames once the ones that have already arrived have been
+  // processed, so that one acknowledgement covers all of them.
+  ack_pending_ = true;
+  if (!ack_task_.is_pending()) {
+    ack_task_.Post(dispatcher_);
+  }
+}
+
+void EnhancedRetransmissionEngine::ProcessSFrame(uint16_t control) {
+  const auto function = static_cast<SupervisoryFunction>(
+      (control >> kSupervisoryFunctionShift) & 0b11);
+  const uint8_t req_seq = GetReqSeq(control);
+  const bool poll = control & kPollBit;
+  const bool final = control & kFinalBit;
+
+  // A Selective Reject only acknowledges frames if it is a Poll.
+  if (function != SupervisoryFunction::kSelectiveReject || poll) {
+    if (!ProcessReqSeq(req_seq))
+      return;
+  }
+
+  switch (function) {
+    case SupervisoryFunction::kReceiverReady:
+    case SupervisoryFunction::kReceiverNotReady:
+      remote_busy_ = function == SupervisoryFunction::kReceiverNotReady;
+      if (final) {
+        ProcessFinal();
+      } else if (poll) {
+        SendSFrame(SupervisoryFunction::kReceiverReady, expected_tx_seq_,
+                   false, true);
+      }
+      break;
+
+    case SupervisoryFunction::kReject:
+      if (final) {
+        // Answering our Poll already retransmits the unacknowledged frames.
+        ProcessFinal();
+      } else {
+        RetransmitUnackedFrames(false);
+      }
+      break;
+
+    case SupervisoryFunction::kSelectiveReject: {
+      if (final && wait_final_) {
+        wait_final_ = false;
+        poll_count_ = 0;
+        monitor_task_.Cancel();
+      }
+      const uint8_t index = SeqDistance(expected_ack_seq_, req_seq);
+      if (index >= unacked_frames_.size()) {
+        bt_log(TRACE, "l2cap",
+               "Channel %#.4x: ignoring SREJ for frame %u not in flight",
+               local_cid_, req_seq);
+        break;
+      }
+      TransmitIFrame(&unacked_frames_[index], poll);
+      break;
+    }
+  }
+
+  TrySendQueuedFrames();
+}
+
+bool EnhancedRetransmissionEngine::ProcessReqSeq(uint8_t req_seq) {
+  const uint8_t acked = SeqDistance(expected_ack_seq_, req_seq);
+  if (acked > unacked_frames_.size()) {
+    bt_log(TRACE, "l2cap",
+           "Channel %#.4x: invalid ReqSeq %u (expected %u to %u)", local_cid_,
+           req_seq, expected_ack_seq_, next_tx_seq_);
+    SignalError();
+    return false;
+  }
+
+  if (!acked)
+    return true;
+
+  unacked_frames_.erase(unacked_frames_.begin(),
+                        unacked_frames_.begin() + acked);
+  expected_ack_seq_ = req_seq;
+
+  if (unacked_frames_.empty()) {
+    retransmission_task_.Cancel();
+  } else if (!wait_final_) {
+    StartRetransmissionTimer();
+  }
+  return true;
+}
+
+void EnhancedRetransmissionEngine::ProcessFinal() {
+  if (!wait_final_)
+    return;
+
+  // The peer has told us what it has received in response to our Poll, so
+  // resend everything that it has not acknowledged.
+  wait_final_ = false;
+  poll_count_ = 0;
+  monitor_task_.Cancel();
+  RetransmitUnackedFrames(false);
+  TrySendQueuedFrames();
+}
+
+void EnhancedRetransmissionEngine::Reassemble(
+    SegmentationStatus sar, const common::ByteBuffer& payload) {
+  if (sar == SegmentationStatus::kUnsegmented ||
+      sar == SegmentationStatus::kStart) {
+    if (rx_sdu_started_) {
+      bt_log(TRACE, "l2cap", "Channel %#.4x: dropping incomplete SDU",
+             local_cid_);
+      rx_sdu_started_ = false;
+    }
+  } else if (!rx_sdu_started_) {
+    // The rest of an SDU whose start was dropped.
+    return;
+  }
+
+  switch (sar) {
+    case SegmentationStatus::kUnsegmented:
+      sdu_cb_(std::make_unique<common::DynamicByteBuffer>(payload));
+      return;
+
+    case SegmentationStatus::kStart: {
+      if (payload.size() < kSduLengthFieldSize)
+        return;
+      const size_t sdu_length = le16toh(payload.As<uint16_t>());
+      const auto segment = payload.view(kSduLengthFieldSize);
+      if (segment.size() >= sdu_length) {
+        bt_log(TRACE, "l2cap", "Channel %#.4x: bad SDU length %zu",
+               local_cid_, sdu_length);
+        return;
+      }
+      rx_sdu_ = common::DynamicByteBuffer(sdu_length);
+      rx_sdu_.Write(segment);
+      rx_sdu_offset_ = segment.size();
+      rx_sdu_started_ = true;
+      return;
+    }
+
+    case SegmentationStatus::kContinuation:
+    case SegmentationStatus::kEnd: {
+      const size_t end = rx_sdu_offset_ + payload.size();
+      const bool is_end = sar == SegmentationStatus::kEnd;
+      if (is_end ? end != rx_sdu_.size() : end >= rx_sdu_.size()) {
+        bt_log(TRACE, "l2cap",
+               "Channel %#.4x: SDU segments don't add up to its length",
+               local_cid_);
+        rx_sdu_started_ = false;
+        return;
+      }
+      rx_sdu_.Write(payload, rx_sdu_offset_);
+      rx_sdu_offset_ = end;
+      if (is_end) {
+        rx_sdu_started_ = false;
+        sdu_cb_(std::make_unique<common::DynamicByteBuffer>(std::move(rx_sdu_)));
+      }
+      return;
+    }
+  }
+}
+
+void EnhancedRetransmissionEngine::SendPendingAck() {
+  if (failed_ || !ack_pending_)
+    return;
+  SendSFrame(SupervisoryFunction::kReceiverReady, expected_tx_seq_, false,
+             false);
+}
+
+void EnhancedRetransmissionEngine::StartRetransmissionTimer() {
+  retransmission_task_.Cancel();
+  retransmission_task_.PostDelayed(dispatcher_, retransmission_timeout_);
+}
+
+void EnhancedRetransmissionEngine::OnRetransmissionTimeout() {
+  if (failed_ || unacked_frames_.empty())
+    return;
+
+  // Ask the peer what it has received, and stop sending until it answers.
+  wait_final_ = true;
+  poll_count_ = 1;
+  SendSFrame(SupervisoryFunction::kReceiverReady, expected_tx_seq_, true,
+             false);
+  monitor_task_.PostDelayed(dispatcher_, monitor_timeout_);
+}
+
+void EnhancedRetransmissionEngine::OnMonitorTimeout() {
+  if (failed_ || !wait_final_)
+    return;
+
+  if (max_transmit_ && poll_count_ >= max_transmit_) {
+    bt_log(TRACE, "l2cap", "Channel %#.4x: no answer to %u polls", local_cid_,
+           poll_count_);
+    SignalError();
+    return;
+  }
+
+  poll_count_++;
+  SendSFrame(SupervisoryFunction::kReceiverReady, expected_tx_seq_, true,
+             false);
+  monitor_task_.PostDelayed(dispatcher_, monitor_timeout_);
+}
+
+void EnhancedRetransmissionEngine::SignalError() {
+  if (failed_)
+    return;
+
+  failed_ = true;
+  ack_task_.Cancel();
+  retransmission_task_.Cancel();
+  monitor_task_.Cancel();
+  error_cb_();
+}
+
+}  // namespace internal
+}  // namespace l2cap
+}  // namespace btlib
@@ -0,0 +1,203 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef GARNET_DRIVERS_BLUETOOTH_LIB_L2CAP_ENHANCED_RETRANSMISSION_ENGINE_H_
+#define GARNET_DRIVERS_BLUETOOTH_LIB_L2CAP_ENHANCED_RETRANSMISSION_ENGINE_H_
+
+#include <deque>
+#include <map>
+#include <set>
+
+#include <lib/async/cpp/task.h>
+#include <lib/async/dispatcher.h>
+#include <lib/fit/function.h>
+#include <lib/zx/time.h>
+
+#include "garnet/drivers/bluetooth/lib/common/byte_buffer.h"
+#include "garnet/drivers/bluetooth/lib/l2cap/l2cap.h"
+#include "lib/fxl/macros.h"
+
+namespace btlib {
+namespace l2cap {
+namespace internal {
+
+// Computes the Frame Check Sequence (CRC-16 with generator polynomial
+// x^16 + x^15 + x^2 + 1) over |data|, continuing from |initial| (see Core Spec
+// v5.0, Vol 3, Part A, Section 3.3.5).
+uint16_t ComputeFcs(const common::ByteBuffer& data, uint16_t initial = 0);
+
+// The number of I-frames that an EnhancedRetransmissionEngine can receive ahead
+// of the next expected one, to be advertised as our TxWindow size. This is half
+// of the sequence number space so that retransmissions of frames that have
+// already been received can be told apart from new frames.
+constexpr uint8_t kErtmReceiveWindowSize = kSeqNumModulus / 2;
+
+// Implements the data transfer procedures of Enhanced Retransmission Mode and
+// Streaming Mode for one channel (see Core Spec v5.0, Vol 3, Part A, Section
+// 8). Outbound SDUs are segmented into I-frames of at most the peer's MPS and
+// inbound I-frames are reassembled into SDUs. Frames are exchanged as the
+// information payload of B-frames, so they are framed and fragmented (and
+// recombined) over the logical link like any other PDU.
+//
+// In Enhanced Retransmission Mode, up to a window of I-frames is kept in flight
+// until acknowledged. Frames that arrive out of sequence are buffered and the
+// missing ones selectively rejected; a Poll on retransmission time-out recovers
+// from lost frames otherwise. In Streaming Mode, nothing is acknowledged or
+// retransmitted and SDUs with missing segments are dropped.
+//
+// This class is not thread-safe and must be used on the thread of
+// |dispatcher|, which runs its timers.
+class EnhancedRetransmissionEngine final {
+ public:
+  // Called with each frame to send to the peer, in the form of a B-frame
+  // information payload.
+  using SendFrameCallback = fit::function<void(common::ByteBufferPtr frame)>;
+
+  // Called with each complete SDU received from the peer.
+  using SduCallback = fit::function<void(common::ByteBufferPtr sdu)>;
+
+  // Called when the peer stops acknowledging frames or violates the protocol,
+  // after which the channel should be disconnected. The engine does nothing
+  // more once this has been called.
+  using ErrorCallback = fit::closure;
+
+  // |local_cid| and |remote_cid| are the channel identifiers of the ends of the
+  // channel, which are covered by the FCS of each frame. |config.mode| must be
+  // kEnhancedRetransmission or kStreaming.
+  EnhancedRetransmissionEngine(ChannelId local_cid, ChannelId remote_cid,
+                               const ChannelModeConfig& config,
+                               SendFrameCallback send_frame_cb,
+                               SduCallback sdu_cb, ErrorCallback error_cb,
+                               async_dispatcher_t* dispatcher);
+  ~EnhancedRetransmissionEngine() = default;
+
+  // Segments |sdu| into I-frames and sends them, or queues them up to be sent
+  // as the peer acknowledges earlier ones.
+  void QueueSdu(const common::ByteBuffer& sdu);
+
+  // Processes a frame received from the peer. Frames that fail the FCS check
+  // are dropped.
+  void ProcessFrame(const common::ByteBuffer& frame);
+
+  // The number of I-frames that have been sent more than once.
+  size_t retransmission_count() const { return retransmission_count_; }
+
+ private:
+  // An I-frame that has been queued for transmission.
+  struct TxFrame {
+    SegmentationStatus sar;
+
+    // The information payload, including the SDU length of a start frame.
+    common::DynamicByteBuffer payload;
+
+    uint8_t tx_seq = 0;
+    uint8_t transmit_count = 0;
+  };
+
+  bool is_streaming() const { return mode_ == ChannelMode::kStreaming; }
+
+  // Sends queued I-frames for as long as the peer's window allows.
+  void TrySendQueuedFrames();
+
+  // Sends |frame|, or reports an error if it has already been sent the maximum
+  // number of times. Returns false in that case.
+  bool TransmitIFrame(TxFrame* frame, bool final);
+
+  // Retransmits the unacknowledged I-frames, starting with the oldest.
+  void RetransmitUnackedFrames(bool final);
+
+  void SendSFrame(SupervisoryFunction function, uint8_t req_seq, bool poll,
+                  bool final);
+
+  // Sends |control| and |payload| with an FCS appended.
+  void SendFrame(uint16_t control, const common::ByteBuffer& payload);
+
+  void ProcessIFrame(uint16_t control, const common::ByteBuffer& payload);
+  void ProcessSFrame(uint16_t control);
+
+  // Handles the acknowledgement of I-frames up to (but not including)
+  // |req_seq|. Returns false if |req_seq| does not acknowledge any frame that
+  // is in flight.
+  bool ProcessReqSeq(uint8_t req_seq);
+
+  // Handles a frame with the Final bit set in response to our Poll.
+  void ProcessFinal();
+
+  // Adds an in-sequence I-frame payload to the SDU being reassembled.
+  void Reassemble(SegmentationStatus sar, const common::ByteBuffer& payload);
+
+  // Acknowledges the received I-frames unless an outbound frame already has.
+  void SendPendingAck();
+
+  void StartRetransmissionTimer();
+  void OnRetransmissionTimeout();
+  void OnMonitorTimeout();
+  void SignalError();
+
+  const ChannelId local_cid_;
+  const ChannelId remote_cid_;
+  const ChannelMode mode_;
+  const uint8_t tx_window_size_;
+  const uint8_t max_transmit_;
+  const zx::duration retransmission_timeout_;
+  const zx::duration monitor_timeout_;
+  const uint16_t tx_mps_;
+
+  SendFrameCallback send_frame_cb_;
+  SduCallback sdu_cb_;
+  ErrorCallback error_cb_;
+  async_dispatcher_t* const dispatcher_;
+
+  // Set once |error_cb_| has been called.
+  bool failed_;
+
+  // Transmitter state. |unacked_frames_| holds the I-frames with sequence
+  // numbers from |expected_ack_seq_| up to |next_tx_seq_|, and
+  // |queued_frames_| the ones that have not been sent yet.
+  uint8_t next_tx_seq_;
+  uint8_t expected_ack_seq_;
+  std::deque<TxFrame> unacked_frames_;
+  std::deque<TxFrame> queued_frames_;
+  bool remote_busy_;
+
+  // True while waiting for a frame with the Final bit in response to a Poll,
+  // during which no new I-frames are sent. |poll_count_| counts the Polls.
+  bool wait_final_;
+  uint8_t poll_count_;
+  size_t retransmission_count_;
+
+  // Receiver state. Frames received ahead of |expected_tx_seq_| are held in
+  // |out_of_sequence_frames_| until the gap before them is filled, and
+  // |selectively_rejected_| holds the missing sequence numbers that we have
+  // asked the peer for.
+  uint8_t expected_tx_seq_;
+  std::map<uint8_t, std::pair<SegmentationStatus, common::DynamicByteBuffer>>
+      out_of_sequence_frames_;
+  std::set<uint8_t> selectively_rejected_;
+  bool ack_pending_;
+
+  // The SDU being reassembled and the number of bytes received so far.
+  common::DynamicByteBuffer rx_sdu_;
+  size_t rx_sdu_offset_;
+  bool rx_sdu_started_;
+
+  async::TaskClosureMethod<EnhancedRetransmissionEngine,
+                           &EnhancedRetransmissionEngine::SendPendingAck>
+      ack_task_{this};
+  async::TaskClosureMethod<
+      EnhancedRetransmissionEngine,
+      &EnhancedRetransmissionEngine::OnRetransmissionTimeout>
+      retransmission_task_{this};
+  async::TaskClosureMethod<EnhancedRetransmissionEngine,
+                           &EnhancedRetransmissionEngine::OnMonitorTimeout>
+      monitor_task_{this};
+
+  FXL_DISALLOW_COPY_AND_ASSIGN(EnhancedRetransmissionEngine);
+};
+
+}  // namespace internal
+}  // namespace l2cap
+}  // namespace btlib
+
+#endif  // GARNET_DRIVERS_BLUETOOTH_LIB_L2CAP_ENHANCED_RETRANSMISSION_ENGINE_H_
@@ -0,0 +1,416 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "enhanced_retransmission_engine.h"
+
+#include <random>
+#include <vector>
+
+#include <lib/async/cpp/task.h>
+
+#include "garnet/drivers/bluetooth/lib/common/test_helpers.h"
+#include "lib/fxl/arraysize.h"
+#include "lib/gtest/test_loop_fixture.h"
+
+namespace btlib {
+namespace l2cap {
+namespace internal {
+namespace {
+
+constexpr ChannelId kCid0 = 0x0040;
+constexpr ChannelId kCid1 = 0x0041;
+
+// One-way latency of the simulated link.
+constexpr zx::duration kLinkDelay = zx::msec(5);
+
+ChannelModeConfig MakeConfig(ChannelMode mode, uint16_t mps = 64) {
+  ChannelModeConfig config;
+  config.mode = mode;
+  config.tx_window_size = kErtmReceiveWindowSize;
+  config.max_transmit = kErtmDefaultMaxTransmit;
+  config.retransmission_timeout_ms = 200;
+  config.monitor_timeout_ms = 400;
+  config.tx_mps = mps;
+  return config;
+}
+
+common::DynamicByteBuffer MakeSdu(size_t size, uint8_t seed) {
+  common::DynamicByteBuffer sdu(size);
+  for (size_t i = 0; i < size; i++) {
+    sdu[i] = static_cast<uint8_t>(seed + i * 7);
+  }
+  return sdu;
+}
+
+// Connects two engines over a simulated link, which delivers each frame after
+// kLinkDelay unless |drop_frame_| says to drop it.
+class L2CAP_EnhancedRetransmissionEngineTest : public ::gtest::TestLoopFixture {
+ public:
+  L2CAP_EnhancedRetransmissionEngineTest() = default;
+  ~L2CAP_EnhancedRetransmissionEngineTest() override = default;
+
+ protected:
+  void TearDown() override {
+    engine0_ = nullptr;
+    engine1_ = nullptr;
+  }
+
+  // Creates the engines at both ends of the channel, which use |config0| and
+  // |config1| respectively to send.
+  void Connect(const ChannelModeConfig& config0,
+               const ChannelModeConfig& config1) {
+    engine0_ = std::make_unique<EnhancedRetransmissionEngine>(
+        kCid0, kCid1, config0, [this](auto frame) { Transmit(0, std::move(frame)); },
+        [this](auto sdu) { sdus0_.emplace_back(*sdu); },
+        [this] { errors_++; }, dispatcher());
+    engine1_ = std::make_unique<EnhancedRetransmissionEngine>(
+        kCid1, kCid0, config1, [this](auto frame) { Transmit(1, std::move(frame)); },
+        [this](auto sdu) {
+          sdus1_.emplace_back(*sdu);
+          last_sdu_time_ = Now();
+        },
+        [this] { errors_++; }, dispatcher());
+  }
+
+  void set_drop_frame(fit::function<bool(int from, const common::ByteBuffer&)> cb) {
+    drop_frame_ = std::move(cb);
+  }
+
+  EnhancedRetransmissionEngine* engine0() const { return engine0_.get(); }
+  EnhancedRetransmissionEngine* engine1() const { return engine1_.get(); }
+
+  // SDUs received by engine 0 and engine 1.
+  const std::vector<common::DynamicByteBuffer>& sdus0() const { return sdus0_; }
+  const std::vector<common::DynamicByteBuffer>& sdus1() const { return sdus1_; }
+
+  // The time at which engine 1 last received an SDU.
+  zx::time last_sdu_time() const { return last_sdu_time_; }
+
+  size_t frames_sent() const { return frames_sent_; }
+  size_t errors() const { return errors_; }
+
+ private:
+  void Transmit(int from, common::ByteBufferPtr frame) {
+    frames_sent_++;
+    if (drop_frame_ && drop_frame_(from, *frame))
+      return;
+
+    common::DynamicByteBuffer copy(*frame);
+    async::PostDelayedTask(
+        dispatcher(),
+        [this, from, copy = std::move(copy)] {
+          auto* to = from ? engine0_.get() : engine1_.get();
+          if (to) {
+            to->ProcessFrame(copy);
+          }
+        },
+        kLinkDelay);
+  }
+
+  std::unique_ptr<EnhancedRetransmissionEngine> engine0_;
+  std::unique_ptr<EnhancedRetransmissionEngine> engine1_;
+  fit::function<bool(int, const common::ByteBuffer&)> drop_frame_;
+  std::vector<common::DynamicByteBuffer> sdus0_;
+  std::vector<common::DynamicByteBuffer> sdus1_;
+  zx::time last_sdu_time_;
+  size_t frames_sent_ = 0;
+  size_t errors_ = 0;
+
+  FXL_DISALLOW_COPY_AND_ASSIGN(L2CAP_EnhancedRetransmissionEngineTest);
+};
+
+bool IsIFrame(const common::ByteBuffer& frame) {
+  return !(frame[0] & kFrameTypeSFrameBit);
+}
+
+uint8_t TxSeq(const common::ByteBuffer& frame) {
+  return (frame[0] >> kTxSeqShift) & kSeqNumMask;
+}
+
+TEST(L2CAP_ComputeFcsTest, MatchesSpecExamples) {
+  // Core Spec v5.0, Vol 3, Part A, Section 3.3.5: an I-frame with an FCS
+  // followed by an S-frame with an FCS.
+  auto iframe = common::CreateStaticByteBuffer(
+      0x0E, 0x00, 0x40, 0x00, 0x02, 0x00, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05,
+      0x06, 0x07, 0x08, 0x09);
+  EXPECT_EQ(0x6138, ComputeFcs(iframe));
+
+  auto sframe = common::CreateStaticByteBuffer(0x04, 0x00, 0x40, 0x00, 0x01,
+                                               0x01);
+  EXPECT_EQ(0x14D4, ComputeFcs(sframe));
+
+  // Computing the FCS piecewise gives the same result.
+  EXPECT_EQ(0x6138, ComputeFcs(iframe.view(4), ComputeFcs(iframe.view(0, 4))));
+}
+
+TEST_F(L2CAP_EnhancedRetransmissionEngineTest, SendsFramesWithFcs) {
+  std::vector<common::DynamicByteBuffer> frames;
+  auto config = MakeConfig(ChannelMode::kEnhancedRetransmission);
+  EnhancedRetransmissionEngine engine(
+      kCid0, kCid1, config, [&](auto frame) { frames.emplace_back(*frame); },
+      [](auto) {}, [] {}, dispatcher());
+
+  engine.QueueSdu(common::CreateStaticByteBuffer('h', 'i'));
+  ASSERT_EQ(1u, frames.size());
+
+  // Unsegmented I-frame with TxSeq 0 and ReqSeq 0, then its FCS over the Basic
+  // L2CAP header (addressed to the peer) and the frame.
+  auto& frame = frames[0];
+  ASSERT_EQ(6u, frame.size());
+  EXPECT_TRUE(ContainersEqual(common::CreateStaticByteBuffer(0x00, 0x00, 'h', 'i'),
+                              frame.view(0, 4)));
+  auto header = common::CreateStaticByteBuffer(0x06, 0x00, 0x41, 0x00);
+  const uint16_t fcs = ComputeFcs(frame.view(0, 4), ComputeFcs(header));
+  EXPECT_EQ(fcs & 0xFF, frame[4]);
+  EXPECT_EQ(fcs >> 8, frame[5]);
+}
+
+TEST_F(L2CAP_EnhancedRetransmissionEngineTest, DropsFramesWithBadFcs) {
+  Connect(MakeConfig(ChannelMode::kEnhancedRetransmission),
+          MakeConfig(ChannelMode::kEnhancedRetransmission));
+
+  // Corrupt the first transmission of the frame, which is then recovered by a
+  // Poll on retransmission time-out.
+  size_t corrupted = 0;
+  set_drop_frame([&](int from, const common::ByteBuffer& frame) {
+    if (from == 0 && IsIFrame(frame) && !corrupted++) {
+      auto bad = common::DynamicByteBuffer(frame);
+      bad[2] ^= 0xFF;
+      engine1()->ProcessFrame(bad);
+      return true;
+    }
+    return false;
+  });
+
+  engine0()->QueueSdu(common::CreateStaticByteBuffer('h', 'i'));
+  RunLoopUntilIdle();
+  EXPECT_TRUE(sdus1().empty());
+
+  RunLoopFor(zx::sec(1));
+  ASSERT_EQ(1u, sdus1().size());
+  EXPECT_TRUE(ContainersEqual(common::CreateStaticByteBuffer('h', 'i'),
+                              sdus1()[0]));
+  EXPECT_EQ(1u, engine0()->retransmission_count());
+  EXPECT_EQ(0u, errors());
+}
+
+TEST_F(L2CAP_EnhancedRetransmissionEngineTest, SegmentsAndReassemblesSdus) {
+  Connect(MakeConfig(ChannelMode::kEnhancedRetransmission, 16),
+          MakeConfig(ChannelMode::kEnhancedRetransmission, 16));
+
+  // Sizes around the segment boundaries, accounting for the SDU length.
+  const size_t kSizes[] = {1, 16, 17, 30, 31, 100, 1000};
+  for (size_t i = 0; i < arraysize(kSizes); i++) {
+    engine0()->QueueSdu(MakeSdu(kSizes[i], i));
+  }
+  engine1()->QueueSdu(MakeSdu(500, 42));
+  RunLoopFor(zx::sec(1));
+
+  ASSERT_EQ(arraysize(kSizes), sdus1().size());
+  for (size_t i = 0; i < arraysize(kSizes); i++) {
+    EXPECT_TRUE(ContainersEqual(MakeSdu(kSizes[i], i), sdus1()[i]));
+  }
+  ASSERT_EQ(1u, sdus0().size());
+  EXPECT_TRUE(ContainersEqual(MakeSdu(500, 42), sdus0()[0]));
+  EXPECT_EQ(0u, engine0()->retransmission_count());
+  EXPECT_EQ(0u, errors());
+}
+
+TEST_F(L2CAP_EnhancedRetransmissionEngineTest, SelectivelyRejectsLostFrame) {
+  Connect(MakeConfig(ChannelMode::kEnhancedRetransmission),
+          MakeConfig(ChannelMode::kEnhancedRetransmission));
+
+  // Lose the first transmission of the second I-frame.
+  bool dropped = false;
+  set_drop_frame([&](int from, const common::ByteBuffer& frame) {
+    if (from == 0 && IsIFrame(frame) && TxSeq(frame) == 1 && !dropped) {
+      dropped = true;
+      return true;
+    }
+    return false;
+  });
+
+  for (uint8_t i = 0; i < 4; i++) {
+    engine0()->QueueSdu(MakeSdu(10, i));
+  }
+
+  // The frames after the gap are buffered and the missing one is retransmitted
+  // as soon as the SREJ for it arrives, well before the retransmission time-out.
+  RunLoopFor(kLinkDelay + kLinkDelay + kLinkDelay);
+  ASSERT_EQ(4u, sdus1().size());
+  for (uint8_t i = 0; i < 4; i++) {
+    EXPECT_TRUE(ContainersEqual(MakeSdu(10, i), sdus1()[i]));
+  }
+  EXPECT_EQ(1u, engine0()->retransmission_count());
+  EXPECT_EQ(0u, errors());
+}
+
+TEST_F(L2CAP_EnhancedRetransmissionEngineTest, RecoversFromLostAckByPolling) {
+  Connect(MakeConfig(ChannelMode::kEnhancedRetransmission),
+          MakeConfig(ChannelMode::kEnhancedRetransmission));
+
+  // Lose the first acknowledgement.
+  bool dropped = false;
+  set_drop_frame([&](int from, const common::ByteBuffer& frame) {
+    if (from == 1 && !dropped) {
+      dropped = true;
+      return true;
+    }
+    return false;
+  });
+
+  engine0()->QueueSdu(MakeSdu(10, 0));
+  RunLoopFor(zx::sec(1));
+
+  // The Poll is answered with an acknowledgement, so nothing is resent.
+  ASSERT_EQ(1u, sdus1().size());
+  EXPECT_EQ(0u, engine0()->retransmission_count());
+
+  // Frames queued afterwards flow as usual.
+  engine0()->QueueSdu(MakeSdu(10, 1));
+  RunLoopFor(zx::sec(1));
+  ASSERT_EQ(2u, sdus1().size());
+  EXPECT_TRUE(ContainersEqual(MakeSdu(10, 1), sdus1()[1]));
+  EXPECT_EQ(0u, errors());
+}
+
+TEST_F(L2CAP_EnhancedRetransmissionEngineTest, LimitsFramesInFlightToWindow) {
+  auto config = MakeConfig(ChannelMode::kEnhancedRetransmission);
+  config.tx_window_size = 3;
+  Connect(config, config);
+
+  size_t iframes_in_flight = 0;
+  set_drop_frame([&](int from, const common::ByteBuffer& frame) {
+    if (from == 0 && IsIFrame(frame))
+      iframes_in_flight++;
+    return false;
+  });
+
+  for (uint8_t i = 0; i < 10; i++) {
+    engine0()->QueueSdu(MakeSdu(10, i));
+  }
+  EXPECT_EQ(3u, iframes_in_flight);
+
+  RunLoopFor(zx::sec(1));
+  EXPECT_EQ(10u, sdus1().size());
+  EXPECT_EQ(10u, iframes_in_flight);
+  EXPECT_EQ(0u, errors());
+}
+
+TEST_F(L2CAP_EnhancedRetransmissionEngineTest, SignalsErrorWhenPeerIsGone) {
+  Connect(MakeConfig(ChannelMode::kEnhancedRetransmission),
+          MakeConfig(ChannelMode::kEnhancedRetransmission));
+  set_drop_frame([](int, const common::ByteBuffer&) { return true; });
+
+  engine0()->QueueSdu(MakeSdu(10, 0));
+
+  // One retransmission time-out, then a Poll per monitor time-out.
+  RunLoopFor(zx::msec(200 + 400 * (kErtmDefaultMaxTransmit - 1)));
+  EXPECT_EQ(0u, errors());
+  RunLoopFor(zx::msec(400));
+  EXPECT_EQ(1u, errors());
+
+  // Nothing else is sent.
+  const size_t frames = frames_sent();
+  engine0()->QueueSdu(MakeSdu(10, 1));
+  RunLoopFor(zx::sec(10));
+  EXPECT_EQ(frames, frames_sent());
+  EXPECT_EQ(1u, errors());
+}
+
+TEST_F(L2CAP_EnhancedRetransmissionEngineTest, SignalsErrorOnInvalidReqSeq) {
+  std::vector<common::DynamicByteBuffer> frames;
+  size_t errors = 0;
+  auto config = MakeConfig(ChannelMode::kEnhancedRetransmission);
+  EnhancedRetransmissionEngine engine(
+      kCid1, kCid0, config, [&](auto frame) { frames.emplace_back(*frame); },
+      [](auto) {}, [&] { errors++; }, dispatcher());
+
+  // Receiver Ready acknowledging a frame that was never sent.
+  auto rr = common::CreateStaticByteBuffer(0x01, 0x01, 0x00, 0x00);
+  auto header = common::CreateStaticByteBuffer(0x04, 0x00, 0x41, 0x00);
+  const uint16_t fcs = ComputeFcs(rr.view(0, 2), ComputeFcs(header));
+  rr[2] = fcs & 0xFF;
+  rr[3] = fcs >> 8;
+  engine.ProcessFrame(rr);
+  EXPECT_EQ(1u, errors);
+}
+
+TEST_F(L2CAP_EnhancedRetransmissionEngineTest, StreamingDropsIncompleteSdus) {
+  Connect(MakeConfig(ChannelMode::kStreaming, 16),
+          MakeConfig(ChannelMode::kStreaming, 16));
+
+  // Lose the middle segment of the second SDU.
+  set_drop_frame([](int from, const common::ByteBuffer& frame) {
+    return TxSeq(frame) == 3;
+  });
+
+  engine0()->QueueSdu(MakeSdu(40, 0));
+  engine0()->QueueSdu(MakeSdu(40, 1));
+  engine0()->QueueSdu(MakeSdu(40, 2));
+  RunLoopFor(zx::sec(10));
+
+  // Nothing is acknowledged or retransmitted.
+  EXPECT_EQ(9u, frames_sent());
+  ASSERT_EQ(2u, sdus1().size());
+  EXPECT_TRUE(ContainersEqual(MakeSdu(40, 0), sdus1()[0]));
+  EXPECT_TRUE(ContainersEqual(MakeSdu(40, 2), sdus1()[1]));
+  EXPECT_EQ(0u, errors());
+}
+
+// Measures the goodput of a bulk transfer over the simulated link as frames in
+// both directions are lost at random. Every SDU must still arrive, in order.
+TEST_F(L2CAP_EnhancedRetransmissionEngineTest, ThroughputUnderLoss) {
+  constexpr size_t kSduCount = 500;
+  constexpr size_t kSduSize = 300;
+  constexpr double kLossRates[] = {0.0, 0.05, 0.2};
+
+  common::PrintBenchmarkResult(
+      "mode,loss_rate,frames_sent,retransmissions,sdus_delivered,"
+      "simulated_ms,goodput_kbps\n");
+  for (auto mode :
+       {ChannelMode::kEnhancedRetransmission, ChannelMode::kStreaming}) {
+    for (double loss_rate : kLossRates) {
+      // Allow plenty of retransmissions so that lossy runs don't give up.
+      auto config = MakeConfig(mode, 128);
+      config.max_transmit = 20;
+      Connect(config, config);
+      const size_t frames_before = frames_sent();
+      const size_t sdus_before = sdus1().size();
+
+      std::minstd_rand rng(1);
+      std::bernoulli_distribution lose(loss_rate);
+      set_drop_frame(
+          [&](int, const common::ByteBuffer&) { return lose(rng); });
+
+      const zx::time start = Now();
+      for (size_t i = 0; i < kSduCount; i++) {
+        engine0()->QueueSdu(MakeSdu(kSduSize, i));
+      }
+      RunLoopFor(zx::sec(600));
+      const double elapsed_ms = (last_sdu_time() - start).to_msecs();
+      const size_t delivered = sdus1().size() - sdus_before;
+
+      if (mode == ChannelMode::kEnhancedRetransmission) {
+        EXPECT_EQ(0u, errors());
+        ASSERT_EQ(kSduCount, delivered);
+        for (size_t i = 0; i < kSduCount; i++) {
+          EXPECT_TRUE(
+              ContainersEqual(MakeSdu(kSduSize, i), sdus1()[sdus_before + i]));
+        }
+      }
+
+      common::PrintBenchmarkResult(
+          "%s,%.2f,%zu,%zu,%zu,%.0f,%.0f\n",
+          mode == ChannelMode::kStreaming ? "streaming" : "ertm", loss_rate,
+          frames_sent() - frames_before, engine0()->retransmission_count(),
+          delivered, elapsed_ms, delivered * kSduSize * 8 / elapsed_ms);
+    }
+  }
+}
+
+}  // namespace
+}  // namespace internal
+}  // namespace l2cap
+}  // namespace btlib
@@ -82,6 +82,56 @@ constexpr uint16_t kMinLEMTU = 23;
 // The maximum length of a L2CAP B-frame information payload.
 constexpr uint16_t kMaxBasicFramePayloadSize = 65535;
 
+// Channel modes, as carried in the Retransmission and Flow Control option
+// (see Core Spec v5.0, Vol 3, Part A, Section 5.4).
+//
+// LE Credit Based Flow Control mode is used by the connection-oriented channels
+// of LE-U links, which are not configured with that option. Its value is the
+// code of the command that connects such channels.
+enum class ChannelMode : uint8_t {
+  kBasic = 0x00,
+  kRetransmission = 0x01,
+  kFlowControl = 0x02,
+  kEnhancedRetransmission = 0x03,
+  kStreaming = 0x04,
+  kLECreditBasedFlowControl = 0x14,
+};
+
+// Enhanced Control Field of the I-frames and S-frames used in Enhanced
+// Retransmission and Streaming modes (see Core Spec v5.0, Vol 3, Part A,
+// Section 3.3.2). Fields are packed into a little-endian 16-bit word.
+constexpr uint16_t kEnhancedControlFieldSize = 2;
+constexpr uint16_t kFrameTypeSFrameBit = 0x0001;
+constexpr uint16_t kTxSeqShift = 1;
+constexpr uint16_t kSupervisoryFunctionShift = 2;
+constexpr uint16_t kPollBit = 0x0010;
+constexpr uint16_t kFinalBit = 0x0080;
+constexpr uint16_t kReqSeqShift = 8;
+constexpr uint16_t kSarShift = 14;
+constexpr uint8_t kSeqNumMask = 0x3F;
+constexpr uint8_t kSeqNumModulus = 64;
+
+// Segmentation and Reassembly field of an I-frame.
+enum class SegmentationStatus : uint8_t {
+  kUnsegmented = 0b00,
+  kStart = 0b01,
+  kEnd = 0b10,
+  kContinuation = 0b11,
+};
+
+// Supervisory Function field of an S-frame.
+enum class SupervisoryFunction : uint8_t {
+  kReceiverReady = 0b00,
+  kReject = 0b01,
+  kReceiverNotReady = 0b10,
+  kSelectiveReject = 0b11,
+};
+
+// The SDU Length field that follows the control field of a start I-frame, and
+// the Frame Check Sequence that ends every I-frame and S-frame.
+constexpr uint16_t kSduLengthFieldSize = 2;
+constexpr uint16_t kFcsSize = 2;
+
 // Signaling packet formats (Core Spec v5.0, Vol 3, Part A, Section 4):
 
 using CommandCode = uint8_t;
@@ -122,6 +172,69 @@ enum class ConfigurationResult : uint16_t {
   kFlowSpecRejected = 0x0005,
 };
 
+// Configuration option types (see Core Spec v5.0, Vol 3, Part A, Section 5).
+// Options of types with |kConfigurationOptionHint| set may be ignored by the
+// recipient if it does not understand them.
+enum class ConfigurationOptionType : uint8_t {
+  kMTU = 0x01,
+  kFlushTimeout = 0x02,
+  kQoS = 0x03,
+  kRetransmissionAndFlowControl = 0x04,
+  kFCS = 0x05,
+  kExtendedFlowSpecification = 0x06,
+  kExtendedWindowSize = 0x07,
+};
+constexpr uint8_t kConfigurationOptionHint = 0x80;
+
+// Data of the Retransmission and Flow Control option. The time-outs are left
+// zero in a Configuration Request and given by the peer in its Configuration
+// Response.
+struct RetransmissionAndFlowControlOptionPayload {
+  ChannelMode mode;
+  uint8_t tx_window_size;
+  uint8_t max_transmit;
+  uint16_t retransmission_timeout;  // In milliseconds
+  uint16_t monitor_timeout;         // In milliseconds
+  uint16_t mps;                     // Max. PDU payload size
+} __PACKED;
+
+// Values proposed in the Retransmission and Flow Control option for Enhanced
+// Retransmission and Streaming modes.
+constexpr uint8_t kErtmMaxTxWindowSize = 63;
+constexpr uint8_t kErtmDefaultMaxTransmit = 4;
+constexpr uint16_t kErtmDefaultRetransmissionTimeoutMs = 2000;
+constexpr uint16_t kErtmDefaultMonitorTimeoutMs = 12000;
+constexpr uint16_t kErtmDefaultMPS = 1010;
+
+// The parameters of a channel's mode, as negotiated during channel
+// configuration. Basic mode channels use none of the other fields.
+struct ChannelModeConfig {
+  ChannelMode mode = ChannelMode::kBasic;
+
+  // The number of unacknowledged I-frames that the peer can receive.
+  uint8_t tx_window_size = 0;
+
+  // The number of times that an I-frame can be transmitted before the channel
+  // is considered broken, or 0 for no limit.
+  uint8_t max_transmit = 0;
+
+  uint16_t retransmission_timeout_ms = 0;
+  uint16_t monitor_timeout_ms = 0;
+
+  // The largest I-frame or K-frame information payload that the peer can
+  // receive.
+  uint16_t tx_mps = 0;
+
+  // Parameters of LE Credit Based Flow Control mode. Each side gives the
+  // largest SDU and K-frame payload that it can receive, and the number of
+  // K-frames that it can initially receive (i.e. the credits of the sender).
+  uint16_t tx_mtu = 0;
+  uint16_t tx_credits = 0;
+  uint16_t rx_mtu = 0;
+  uint16_t rx_mps = 0;
+  uint16_t rx_credits = 0;
+};
+
 enum class InformationType : uint16_t {
   kConnectionlessMTU = 0x0001,
   kExtendedFeaturesSupported = 0x0002,
@@ -178,6 +291,18 @@ enum class LECreditBasedConnectionResult : uint16_t {
   kUnacceptableParameters = 0x000B,
 };
 
+// Limits of the parameters of LE credit based connection-oriented channels (see
+// Core Spec v5.0, Vol 3, Part A, Section 4.22), and the values that we request.
+// Our MPS lets a K-frame fill a LE-U data packet of the largest size that a
+// controller can support (251 octets).
+constexpr uint16_t kLECreditBasedMinMTU = 23;
+constexpr uint16_t kLECreditBasedMinMPS = 23;
+constexpr uint16_t kLECreditBasedMaxMPS = 65533;
+constexpr uint16_t kLECreditBasedMaxCredits = 65535;
+constexpr uint16_t kLECreditBasedDefaultMTU = 2048;
+constexpr uint16_t kLECreditBasedDefaultMPS = 247;
+constexpr uint16_t kLECreditBasedDefaultInitialCredits = 16;
+
 // Type used for all Protocol and Service Multiplexer (PSM) identifiers,
 // including those dynamically-assigned/-obtained
 using PSM = uint16_t;
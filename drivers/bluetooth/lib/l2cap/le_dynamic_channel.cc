@@ -0,0 +1,401 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "le_dynamic_channel.h"
+
+#include <endian.h>
+
+#include <zircon/assert.h>
+
+#include "garnet/drivers/bluetooth/lib/common/log.h"
+
+namespace btlib {
+namespace l2cap {
+namespace internal {
+namespace {
+
+// LE_PSMs are one octet wide (see Core Spec v5.0, Vol 3, Part A, Section
+// 4.22).
+constexpr PSM kLastLEPSM = 0x00FF;
+
+bool IsValidLEDynamicChannelId(ChannelId id) {
+  return id >= kFirstDynamicChannelId && id <= kLastLEDynamicChannelId;
+}
+
+bool AreValidRemoteParameters(uint16_t mtu, uint16_t mps) {
+  return mtu >= kLECreditBasedMinMTU && mps >= kLECreditBasedMinMPS &&
+         mps <= kLECreditBasedMaxMPS;
+}
+
+void SendConnectionResponse(SignalingChannel::Responder* responder,
+                            ChannelId local_cid,
+                            LECreditBasedConnectionResult result) {
+  LECreditBasedConnectionResponsePayload rsp = {};
+  rsp.result = static_cast<LECreditBasedConnectionResult>(
+      htole16(static_cast<uint16_t>(result)));
+  if (result == LECreditBasedConnectionResult::kSuccess) {
+    rsp.dst_cid = htole16(local_cid);
+    rsp.mtu = htole16(kLECreditBasedDefaultMTU);
+    rsp.mps = htole16(kLECreditBasedDefaultMPS);
+    rsp.initial_credits = htole16(kLECreditBasedDefaultInitialCredits);
+  }
+  responder->Send(common::BufferView(&rsp, sizeof(rsp)));
+}
+
+}  // namespace
+
+LEDynamicChannelRegistry::LEDynamicChannelRegistry(
+    SignalingChannelInterface* sig, DynamicChannelCallback close_cb,
+    ServiceRequestCallback service_request_cb)
+    : DynamicChannelRegistry(kLastLEDynamicChannelId, std::move(close_cb),
+                             std::move(service_request_cb)),
+      sig_(sig) {
+  ZX_DEBUG_ASSERT(sig_);
+  sig_->ServeRequest(
+      kLECreditBasedConnectionRequest,
+      fit::bind_member(this, &LEDynamicChannelRegistry::OnRxConnReq));
+  sig_->ServeRequest(
+      kDisconnectionRequest,
+      fit::bind_member(this, &LEDynamicChannelRegistry::OnRxDisconReq));
+}
+
+DynamicChannelPtr LEDynamicChannelRegistry::MakeOutbound(PSM psm,
+                                                         ChannelId local_cid) {
+  return LEDynamicChannel::MakeOutbound(this, sig_, psm, local_cid);
+}
+
+DynamicChannelPtr LEDynamicChannelRegistry::MakeInbound(PSM psm,
+                                                        ChannelId local_cid,
+                                                        ChannelId remote_cid) {
+  return LEDynamicChannel::MakeInbound(this, sig_, psm, local_cid, remote_cid);
+}
+
+void LEDynamicChannelRegistry::OnRxConnReq(
+    const common::ByteBuffer& req_payload,
+    SignalingChannel::Responder* responder) {
+  if (req_payload.size() != sizeof(LECreditBasedConnectionRequestPayload)) {
+    bt_log(TRACE, "l2cap-le",
+           "Malformed LE Credit Based Connection Request, size %zu",
+           req_payload.size());
+    responder->RejectNotUnderstood();
+    return;
+  }
+
+  const auto& req = req_payload.As<LECreditBasedConnectionRequestPayload>();
+  const PSM psm = le16toh(req.le_psm);
+  const ChannelId remote_cid = le16toh(req.src_cid);
+  const uint16_t mtu = le16toh(req.mtu);
+  const uint16_t mps = le16toh(req.mps);
+  const uint16_t credits = le16toh(req.initial_credits);
+  bt_log(SPEW, "l2cap-le",
+         "Got LE Credit Based Connection Request for LE_PSM %#.4x from channel "
+         "%#.4x",
+         psm, remote_cid);
+
+  if (psm == kInvalidPSM || psm > kLastLEPSM) {
+    SendConnectionResponse(responder, kInvalidChannelId,
+                           LECreditBasedConnectionResult::kPSMNotSupported);
+    return;
+  }
+
+  // TODO(NET-1320): Check if remote ID is already in use and if so, respond
+  // with kSourceCIDAlreadyAllocated
+  if (!IsValidLEDynamicChannelId(remote_cid)) {
+    bt_log(TRACE, "l2cap-le", "Invalid source channel ID %#.4x", remote_cid);
+    SendConnectionResponse(responder, kInvalidChannelId,
+                           LECreditBasedConnectionResult::kInvalidSourceCID);
+    return;
+  }
+
+  if (!AreValidRemoteParameters(mtu, mps)) {
+    bt_log(TRACE, "l2cap-le",
+           "Unacceptable MTU %hu/MPS %hu for channel from %#.4x", mtu, mps,
+           remote_cid);
+    SendConnectionResponse(
+        responder, kInvalidChannelId,
+        LECreditBasedConnectionResult::kUnacceptableParameters);
+    return;
+  }
+
+  // TODO(NET-1437): Respond with the security results when the link does not
+  // meet the requirements of the service.
+  ChannelId local_cid = FindAvailableChannelId();
+  if (local_cid == kInvalidChannelId) {
+    bt_log(TRACE, "l2cap-le",
+           "Out of IDs; rejecting connection for LE_PSM %#.4x from channel "
+           "%#.4x",
+           psm, remote_cid);
+    SendConnectionResponse(responder, kInvalidChannelId,
+                           LECreditBasedConnectionResult::kNoResources);
+    return;
+  }
+
+  auto dyn_chan = RequestService(psm, local_cid, remote_cid);
+  if (!dyn_chan) {
+    bt_log(TRACE, "l2cap-le",
+           "Rejecting connection for unsupported LE_PSM %#.4x from channel "
+           "%#.4x",
+           psm, remote_cid);
+    SendConnectionResponse(responder, kInvalidChannelId,
+                           LECreditBasedConnectionResult::kPSMNotSupported);
+    return;
+  }
+
+  static_cast<LEDynamicChannel*>(dyn_chan)->CompleteInboundConnection(
+      mtu, mps, credits, responder);
+}
+
+void LEDynamicChannelRegistry::OnRxDisconReq(
+    const common::ByteBuffer& req_payload,
+    SignalingChannel::Responder* responder) {
+  if (req_payload.size() != sizeof(DisconnectionRequestPayload)) {
+    bt_log(TRACE, "l2cap-le", "Malformed Disconnection Request, size %zu",
+           req_payload.size());
+    responder->RejectNotUnderstood();
+    return;
+  }
+
+  const auto& req = req_payload.As<DisconnectionRequestPayload>();
+  const ChannelId local_cid = le16toh(req.dst_cid);
+  const ChannelId remote_cid = le16toh(req.src_cid);
+  auto channel = static_cast<LEDynamicChannel*>(FindChannel(local_cid));
+  if (channel == nullptr || channel->remote_cid() != remote_cid) {
+    bt_log(WARN, "l2cap-le",
+           "ID %#.4x not found for Disconnection Request (remote ID %#.4x)",
+           local_cid, remote_cid);
+    responder->RejectInvalidChannelId(local_cid, remote_cid);
+    return;
+  }
+
+  channel->OnRxDisconReq(responder);
+}
+
+LEDynamicChannelPtr LEDynamicChannel::MakeOutbound(
+    DynamicChannelRegistry* registry,
+    SignalingChannelInterface* signaling_channel, PSM psm,
+    ChannelId local_cid) {
+  return std::unique_ptr<LEDynamicChannel>(new LEDynamicChannel(
+      registry, signaling_channel, psm, local_cid, kInvalidChannelId));
+}
+
+LEDynamicChannelPtr LEDynamicChannel::MakeInbound(
+    DynamicChannelRegistry* registry,
+    SignalingChannelInterface* signaling_channel, PSM psm,
+    ChannelId local_cid, ChannelId remote_cid) {
+  auto channel = std::unique_ptr<LEDynamicChannel>(new LEDynamicChannel(
+      registry, signaling_channel, psm, local_cid, remote_cid));
+  channel->conn_requested_ = true;
+  return channel;
+}
+
+void LEDynamicChannel::Open(fit::closure open_result_cb) {
+  open_result_cb_ = std::move(open_result_cb);
+
+  if (conn_requested_) {
+    return;
+  }
+
+  LECreditBasedConnectionRequestPayload req;
+  req.le_psm = htole16(psm());
+  req.src_cid = htole16(local_cid());
+  req.mtu = htole16(kLECreditBasedDefaultMTU);
+  req.mps = htole16(kLECreditBasedDefaultMPS);
+  req.initial_credits = htole16(kLECreditBasedDefaultInitialCredits);
+  if (!signaling_channel_->SendRequest(
+          kLECreditBasedConnectionRequest,
+          common::BufferView(&req, sizeof(req)),
+          fit::bind_member(this, &LEDynamicChannel::OnRxConnRsp))) {
+    bt_log(ERROR, "l2cap-le",
+           "Channel %#.4x: Failed to send LE Credit Based Connection Request",
+           local_cid());
+    PassOpenResult();
+    return;
+  }
+
+  bt_log(SPEW, "l2cap-le",
+         "Channel %#.4x: Sent LE Credit Based Connection Request", local_cid());
+
+  conn_requested_ = true;
+}
+
+void LEDynamicChannel::Disconnect() {
+  ZX_DEBUG_ASSERT(!disconnected_);
+
+  disconnected_ = true;
+
+  // Don't send disconnect request if the peer never responded (also can't,
+  // because we don't have their end's ID).
+  if (remote_cid() == kInvalidChannelId) {
+    return;
+  }
+
+  // This response handler can't hold references to this object, which is about
+  // to be destroyed.
+  //
+  // TODO(NET-1373): Destroying this channel and allowing this channel ID to be
+  // recycled should wait until either this response is received or RTX timeout.
+  auto on_discon_rsp = [local_cid = local_cid()](
+                           SignalingChannel::Status status,
+                           const common::ByteBuffer& rsp_payload) {
+    bt_log(SPEW, "l2cap-le", "Channel %#.4x: Got Disconnection Response",
+           local_cid);
+    return false;
+  };
+
+  DisconnectionRequestPayload req;
+  req.dst_cid = htole16(remote_cid());
+  req.src_cid = htole16(local_cid());
+  if (!signaling_channel_->SendRequest(kDisconnectionRequest,
+                                       common::BufferView(&req, sizeof(req)),
+                                       std::move(on_discon_rsp))) {
+    bt_log(ERROR, "l2cap-le",
+           "Channel %#.4x: Failed to send Disconnection Request", local_cid());
+    return;
+  }
+
+  bt_log(SPEW, "l2cap-le", "Channel %#.4x: Sent Disconnection Request",
+         local_cid());
+}
+
+bool LEDynamicChannel::IsConnected() const {
+  // Remote-initiated channels have remote_cid_ already set.
+  return conn_requested_ && conn_responded_ &&
+         remote_cid() != kInvalidChannelId && !disconnected_;
+}
+
+bool LEDynamicChannel::IsOpen() const {
+  // There is no configuration to wait for, only for the peer's parameters to
+  // be found acceptable.
+  return IsConnected() && opened();
+}
+
+void LEDynamicChannel::OnRxDisconReq(SignalingChannel::Responder* responder) {
+  bt_log(SPEW, "l2cap-le", "Channel %#.4x: Got Disconnection Request",
+         local_cid());
+
+  if (!IsConnected()) {
+    bt_log(WARN, "l2cap-le", "Channel %#.4x: Unexpected Disconnection Request",
+           local_cid());
+  }
+
+  disconnected_ = true;
+
+  DisconnectionResponsePayload rsp;
+  rsp.dst_cid = htole16(local_cid());
+  rsp.src_cid = htole16(remote_cid());
+  responder->Send(common::BufferView(&rsp, sizeof(rsp)));
+  OnDisconnected();
+}
+
+void LEDynamicChannel::CompleteInboundConnection(
+    uint16_t remote_mtu, uint16_t remote_mps, uint16_t remote_credits,
+    SignalingChannel::Responder* responder) {
+  bt_log(TRACE, "l2cap-le",
+         "Channel %#.4x: connected for LE_PSM %#.4x from remote channel %#.4x",
+         local_cid(), psm(), remote_cid());
+
+  SendConnectionResponse(responder, local_cid(),
+                         LECreditBasedConnectionResult::kSuccess);
+  conn_responded_ = true;
+  SetRemoteParameters(remote_mtu, remote_mps, remote_credits);
+  set_opened();
+  PassOpenResult();
+}
+
+LEDynamicChannel::LEDynamicChannel(DynamicChannelRegistry* registry,
+                                   SignalingChannelInterface* signaling_channel,
+                                   PSM psm, ChannelId local_cid,
+                                   ChannelId remote_cid)
+    : DynamicChannel(registry, psm, local_cid, remote_cid),
+      signaling_channel_(signaling_channel),
+      conn_requested_(false),
+      conn_responded_(false),
+      disconnected_(false) {
+  ZX_DEBUG_ASSERT(signaling_channel_);
+  ZX_DEBUG_ASSERT(local_cid != kInvalidChannelId);
+}
+
+void LEDynamicChannel::SetRemoteParameters(uint16_t mtu, uint16_t mps,
+                                           uint16_t credits) {
+  ChannelModeConfig config;
+  config.mode = ChannelMode::kLECreditBasedFlowControl;
+  config.tx_mtu = mtu;
+  config.tx_mps = mps;
+  config.tx_credits = credits;
+  config.rx_mtu = kLECreditBasedDefaultMTU;
+  config.rx_mps = kLECreditBasedDefaultMPS;
+  config.rx_credits = kLECreditBasedDefaultInitialCredits;
+  set_mode_config(config);
+}
+
+void LEDynamicChannel::PassOpenResult() {
+  if (open_result_cb_) {
+    // Guard against use-after-free if this object's owner destroys it while
+    // running |open_result_cb_|.
+    auto cb = std::move(open_result_cb_);
+    cb();
+  }
+}
+
+bool LEDynamicChannel::OnRxConnRsp(SignalingChannel::Status status,
+                                   const common::ByteBuffer& rsp_payload) {
+  if (status != SignalingChannel::Status::kSuccess) {
+    bt_log(ERROR, "l2cap-le",
+           "Channel %#.4x: LE Credit Based Connection Request %s", local_cid(),
+           status == SignalingChannel::Status::kReject ? "rejected"
+                                                       : "timed out");
+    PassOpenResult();
+    return false;
+  }
+
+  if (rsp_payload.size() != sizeof(LECreditBasedConnectionResponsePayload)) {
+    bt_log(ERROR, "l2cap-le",
+           "Channel %#.4x: Malformed LE Credit Based Connection Response, "
+           "size %zu",
+           local_cid(), rsp_payload.size());
+    PassOpenResult();
+    return false;
+  }
+
+  const auto& rsp = rsp_payload.As<LECreditBasedConnectionResponsePayload>();
+  const auto result = static_cast<LECreditBasedConnectionResult>(
+      le16toh(static_cast<uint16_t>(rsp.result)));
+  if (result != LECreditBasedConnectionResult::kSuccess) {
+    bt_log(ERROR, "l2cap-le",
+           "Channel %#.4x: Unsuccessful LE Credit Based Connection Response "
+           "result %#.4hx",
+           local_cid(), static_cast<uint16_t>(result));
+    PassOpenResult();
+    return false;
+  }
+
+  // Channels with an invalid remote ID or parameters are connected all the
+  // same, so that a Disconnection Request tells the peer that we're not using
+  // them.
+  set_remote_cid(le16toh(rsp.dst_cid));
+  conn_responded_ = true;
+  const uint16_t mtu = le16toh(rsp.mtu);
+  const uint16_t mps = le16toh(rsp.mps);
+  if (!IsValidLEDynamicChannelId(remote_cid()) ||
+      !AreValidRemoteParameters(mtu, mps)) {
+    bt_log(ERROR, "l2cap-le",
+           "Channel %#.4x: received LE Credit Based Connection Response with "
+           "invalid channel ID %#.4x or MTU %hu/MPS %hu, disconnecting",
+           local_cid(), remote_cid(), mtu, mps);
+    PassOpenResult();
+    return false;
+  }
+
+  bt_log(SPEW, "l2cap-le", "Channel %#.4x: Got remote channel ID %#.4x",
+         local_cid(), remote_cid());
+
+  SetRemoteParameters(mtu, mps, le16toh(rsp.initial_credits));
+  set_opened();
+  PassOpenResult();
+  return false;
+}
+
+}  // namespace internal
+}  // namespace l2cap
+}  // namespace btlib
@@ -0,0 +1,124 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef GARNET_DRIVERS_BLUETOOTH_LIB_L2CAP_LE_DYNAMIC_CHANNEL_H_
+#define GARNET_DRIVERS_BLUETOOTH_LIB_L2CAP_LE_DYNAMIC_CHANNEL_H_
+
+#include <lib/fit/function.h>
+
+#include "garnet/drivers/bluetooth/lib/l2cap/dynamic_channel_registry.h"
+#include "garnet/drivers/bluetooth/lib/l2cap/l2cap.h"
+#include "garnet/drivers/bluetooth/lib/l2cap/signaling_channel.h"
+
+namespace btlib {
+namespace l2cap {
+namespace internal {
+
+// Implements factories for LE credit based connection-oriented channels and
+// dispatches incoming signaling channel requests to the corresponding channels
+// by local ID.
+//
+// Must be run only on the L2CAP thread.
+class LEDynamicChannelRegistry final : public DynamicChannelRegistry {
+ public:
+  LEDynamicChannelRegistry(SignalingChannelInterface* sig,
+                           DynamicChannelCallback close_cb,
+                           ServiceRequestCallback service_request_cb);
+  ~LEDynamicChannelRegistry() override = default;
+
+ private:
+  // DynamicChannelRegistry override
+  DynamicChannelPtr MakeOutbound(PSM psm, ChannelId local_cid) override;
+  DynamicChannelPtr MakeInbound(PSM psm, ChannelId local_cid,
+                                ChannelId remote_cid) override;
+
+  // Signaling channel request handlers
+  void OnRxConnReq(const common::ByteBuffer& req_payload,
+                   SignalingChannel::Responder* responder);
+  void OnRxDisconReq(const common::ByteBuffer& req_payload,
+                     SignalingChannel::Responder* responder);
+
+  SignalingChannelInterface* const sig_;
+};
+
+class LEDynamicChannel;
+using LEDynamicChannelPtr = std::unique_ptr<LEDynamicChannel>;
+
+// Connects and disconnects LE credit based connection-oriented channels using
+// the LE signaling channel (see Core Spec v5.0, Vol 3, Part A, Sections 4.22
+// to 4.24). These channels need no configuration, so they are open as soon as
+// they are connected, and use LE Credit Based Flow Control mode with the MTU,
+// MPS and initial credits exchanged in the connection request and response.
+// This is intended to be created and owned by LEDynamicChannelRegistry.
+//
+// Must be run only on the L2CAP thread.
+class LEDynamicChannel final : public DynamicChannel {
+ public:
+  static LEDynamicChannelPtr MakeOutbound(
+      DynamicChannelRegistry* registry,
+      SignalingChannelInterface* signaling_channel, PSM psm,
+      ChannelId local_cid);
+
+  static LEDynamicChannelPtr MakeInbound(
+      DynamicChannelRegistry* registry,
+      SignalingChannelInterface* signaling_channel, PSM psm,
+      ChannelId local_cid, ChannelId remote_cid);
+
+  // DynamicChannel overrides
+  ~LEDynamicChannel() override = default;
+
+  void Open(fit::closure open_cb) override;
+
+  // Mark this channel as closed and disconnected. Send a Disconnection Request
+  // to the remote peer if it has given an ID for its endpoint. This object
+  // shall be destroyed after this call returns.
+  void Disconnect() override;
+
+  bool IsConnected() const override;
+  bool IsOpen() const override;
+
+  // Inbound request handler. Request must have a destination channel ID that
+  // matches this instance's |local_cid|.
+  void OnRxDisconReq(SignalingChannel::Responder* responder);
+
+  // Reply with an affirmative connection response, which opens the channel.
+  // |remote_mtu|, |remote_mps| and |remote_credits| are the parameters that the
+  // peer gave in its LE Credit Based Connection Request.
+  void CompleteInboundConnection(uint16_t remote_mtu, uint16_t remote_mps,
+                                 uint16_t remote_credits,
+                                 SignalingChannel::Responder* responder);
+
+ private:
+  LEDynamicChannel(DynamicChannelRegistry* registry,
+                   SignalingChannelInterface* signaling_channel, PSM psm,
+                   ChannelId local_cid, ChannelId remote_cid);
+
+  // Records the parameters that the peer gave for sending to it, alongside our
+  // own for receiving, as the mode of the channel.
+  void SetRemoteParameters(uint16_t mtu, uint16_t mps, uint16_t credits);
+
+  // Deliver the result of channel connection to the |Open| originator. Can be
+  // called multiple times but only the first invocation passes the result.
+  void PassOpenResult();
+
+  // Response handler for the outbound connection request.
+  bool OnRxConnRsp(SignalingChannel::Status status,
+                   const common::ByteBuffer& rsp_payload);
+
+  SignalingChannelInterface* const signaling_channel_;
+
+  bool conn_requested_;
+  bool conn_responded_;
+  bool disconnected_;
+
+  // This shall be reset to nullptr after invocation to enforce its single-use
+  // semantics. See |DynamicChannel::Open| for details.
+  fit::closure open_result_cb_;
+};
+
+}  // namespace internal
+}  // namespace l2cap
+}  // namespace btlib
+
+#endif  // GARNET_DRIVERS_BLUETOOTH_LIB_L2CAP_LE_DYNAMIC_CHANNEL_H_
@@ -0,0 +1,439 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "garnet/drivers/bluetooth/lib/l2cap/le_dynamic_channel.h"
+
+#include "garnet/drivers/bluetooth/lib/common/test_helpers.h"
+#include "garnet/drivers/bluetooth/lib/l2cap/fake_signaling_channel.h"
+#include "lib/gtest/test_loop_fixture.h"
+
+namespace btlib {
+namespace l2cap {
+namespace internal {
+namespace {
+
+using common::LowerBits;
+using common::UpperBits;
+
+constexpr uint16_t kPsm = 0x0080;
+constexpr uint16_t kInvalidPsm = 0x0100;  // LE_PSMs are one octet wide.
+constexpr ChannelId kLocalCId = 0x0040;
+constexpr ChannelId kRemoteCId = 0x0047;
+constexpr ChannelId kBadCId = 0x0080;  // Not an LE dynamic channel.
+
+// Connection Requests
+
+const common::ByteBuffer& kConnReq = common::CreateStaticByteBuffer(
+    // LE_PSM
+    LowerBits(kPsm), UpperBits(kPsm),
+
+    // Source CID
+    LowerBits(kLocalCId), UpperBits(kLocalCId),
+
+    // MTU (2048), MPS (247), Initial Credits (16)
+    0x00, 0x08, 0xf7, 0x00, 0x10, 0x00);
+
+const common::ByteBuffer& kInboundConnReq = common::CreateStaticByteBuffer(
+    // LE_PSM
+    LowerBits(kPsm), UpperBits(kPsm),
+
+    // Source CID
+    LowerBits(kRemoteCId), UpperBits(kRemoteCId),
+
+    // MTU (512), MPS (100), Initial Credits (5)
+    0x00, 0x02, 0x64, 0x00, 0x05, 0x00);
+
+const common::ByteBuffer& kInboundInvalidPsmConnReq =
+    common::CreateStaticByteBuffer(
+        // LE_PSM
+        LowerBits(kInvalidPsm), UpperBits(kInvalidPsm),
+
+        // Source CID
+        LowerBits(kRemoteCId), UpperBits(kRemoteCId),
+
+        // MTU (512), MPS (100), Initial Credits (5)
+        0x00, 0x02, 0x64, 0x00, 0x05, 0x00);
+
+const common::ByteBuffer& kInboundBadCIdConnReq =
+    common::CreateStaticByteBuffer(
+        // LE_PSM
+        LowerBits(kPsm), UpperBits(kPsm),
+
+        // Source CID
+        LowerBits(kBadCId), UpperBits(kBadCId),
+
+        // MTU (512), MPS (100), Initial Credits (5)
+        0x00, 0x02, 0x64, 0x00, 0x05, 0x00);
+
+const common::ByteBuffer& kInboundSmallMpsConnReq =
+    common::CreateStaticByteBuffer(
+        // LE_PSM
+        LowerBits(kPsm), UpperBits(kPsm),
+
+        // Source CID
+        LowerBits(kRemoteCId), UpperBits(kRemoteCId),
+
+        // MTU (512), MPS (22), Initial Credits (5)
+        0x00, 0x02, 0x16, 0x00, 0x05, 0x00);
+
+// Connection Responses
+
+const common::ByteBuffer& kOkConnRsp = common::CreateStaticByteBuffer(
+    // Destination CID
+    LowerBits(kRemoteCId), UpperBits(kRemoteCId),
+
+    // MTU (512), MPS (100), Initial Credits (5)
+    0x00, 0x02, 0x64, 0x00, 0x05, 0x00,
+
+    // Result (Successful)
+    0x00, 0x00);
+
+const common::ByteBuffer& kSmallMpsConnRsp = common::CreateStaticByteBuffer(
+    // Destination CID
+    LowerBits(kRemoteCId), UpperBits(kRemoteCId),
+
+    // MTU (512), MPS (22), Initial Credits (5)
+    0x00, 0x02, 0x16, 0x00, 0x05, 0x00,
+
+    // Result (Successful)
+    0x00, 0x00);
+
+const common::ByteBuffer& kRefusedConnRsp = common::CreateStaticByteBuffer(
+    // Destination CID, MTU, MPS, Initial Credits (all unused)
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+
+    // Result (LE_PSM not supported)
+    0x02, 0x00);
+
+const common::ByteBuffer& kInboundOkConnRsp = common::CreateStaticByteBuffer(
+    // Destination CID
+    LowerBits(kLocalCId), UpperBits(kLocalCId),
+
+    // MTU (2048), MPS (247), Initial Credits (16)
+    0x00, 0x08, 0xf7, 0x00, 0x10, 0x00,
+
+    // Result (Successful)
+    0x00, 0x00);
+
+const common::ByteBuffer& kInboundBadPsmConnRsp =
+    common::CreateStaticByteBuffer(
+        // Destination CID, MTU, MPS, Initial Credits (all unused)
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+
+        // Result (LE_PSM not supported)
+        0x02, 0x00);
+
+const common::ByteBuffer& kInboundBadCIdConnRsp =
+    common::CreateStaticByteBuffer(
+        // Destination CID, MTU, MPS, Initial Credits (all unused)
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+
+        // Result (Invalid Source CID)
+        0x09, 0x00);
+
+const common::ByteBuffer& kInboundUnacceptableConnRsp =
+    common::CreateStaticByteBuffer(
+        // Destination CID, MTU, MPS, Initial Credits (all unused)
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+
+        // Result (Unacceptable parameters)
+        0x0b, 0x00);
+
+// Disconnection Requests
+
+const common::ByteBuffer& kDisconReq = common::CreateStaticByteBuffer(
+    // Destination CID
+    LowerBits(kRemoteCId), UpperBits(kRemoteCId),
+
+    // Source CID
+    LowerBits(kLocalCId), UpperBits(kLocalCId));
+
+const common::ByteBuffer& kInboundDisconReq = common::CreateStaticByteBuffer(
+    // Destination CID
+    LowerBits(kLocalCId), UpperBits(kLocalCId),
+
+    // Source CID
+    LowerBits(kRemoteCId), UpperBits(kRemoteCId));
+
+// Disconnection Responses
+
+const common::ByteBuffer& kInboundDisconRsp = kInboundDisconReq;
+
+const common::ByteBuffer& kDisconRsp = kDisconReq;
+
+class L2CAP_LEDynamicChannelTest : public ::gtest::TestLoopFixture {
+ public:
+  L2CAP_LEDynamicChannelTest() = default;
+  ~L2CAP_LEDynamicChannelTest() override = default;
+
+ protected:
+  // Import types for brevity.
+  using DynamicChannelCallback = DynamicChannelRegistry::DynamicChannelCallback;
+  using ServiceRequestCallback = DynamicChannelRegistry::ServiceRequestCallback;
+
+  // TestLoopFixture overrides
+  void SetUp() override {
+    TestLoopFixture::SetUp();
+    channel_close_cb_ = nullptr;
+    service_request_cb_ = nullptr;
+    signaling_channel_ =
+        std::make_unique<testing::FakeSignalingChannel>(dispatcher());
+    registry_ = std::make_unique<LEDynamicChannelRegistry>(
+        sig(),
+        fit::bind_member(this, &L2CAP_LEDynamicChannelTest::OnChannelClose),
+        fit::bind_member(this, &L2CAP_LEDynamicChannelTest::OnServiceRequest));
+  }
+
+  void TearDown() override {
+    registry_ = nullptr;
+    signaling_channel_ = nullptr;
+    service_request_cb_ = nullptr;
+    channel_close_cb_ = nullptr;
+    TestLoopFixture::TearDown();
+  }
+
+  testing::FakeSignalingChannel* sig() const {
+    return signaling_channel_.get();
+  }
+
+  LEDynamicChannelRegistry* registry() const { return registry_.get(); }
+
+  void set_channel_close_cb(DynamicChannelCallback close_cb) {
+    channel_close_cb_ = std::move(close_cb);
+  }
+
+  void set_service_request_cb(ServiceRequestCallback service_request_cb) {
+    service_request_cb_ = std::move(service_request_cb);
+  }
+
+ private:
+  void OnChannelClose(const DynamicChannel* channel) {
+    if (channel_close_cb_) {
+      channel_close_cb_(channel);
+    }
+  }
+
+  // Default to rejecting all service requests if no test callback is set.
+  DynamicChannelCallback OnServiceRequest(PSM psm) {
+    if (service_request_cb_) {
+      return service_request_cb_(psm);
+    }
+    return nullptr;
+  }
+
+  DynamicChannelCallback channel_close_cb_;
+  ServiceRequestCallback service_request_cb_;
+  std::unique_ptr<testing::FakeSignalingChannel> signaling_channel_;
+  std::unique_ptr<LEDynamicChannelRegistry> registry_;
+
+  FXL_DISALLOW_COPY_AND_ASSIGN(L2CAP_LEDynamicChannelTest);
+};
+
+TEST_F(L2CAP_LEDynamicChannelTest, FailConnectChannel) {
+  sig()->AddOutbound(kLECreditBasedConnectionRequest, kConnReq.view(),
+                     std::make_pair(SignalingChannel::Status::kSuccess,
+                                    kRefusedConnRsp.view()));
+
+  int open_cb_count = 0;
+  registry()->OpenOutbound(kPsm, [&open_cb_count](auto chan) {
+    EXPECT_FALSE(chan);
+    open_cb_count++;
+  });
+
+  RunLoopUntilIdle();
+
+  EXPECT_EQ(1, open_cb_count);
+}
+
+TEST_F(L2CAP_LEDynamicChannelTest, ConnectChannelWithUnacceptableParameters) {
+  sig()->AddOutbound(kLECreditBasedConnectionRequest, kConnReq.view(),
+                     std::make_pair(SignalingChannel::Status::kSuccess,
+                                    kSmallMpsConnRsp.view()));
+
+  // The peer connected its end, so disconnect it.
+  sig()->AddOutbound(
+      kDisconnectionRequest, kDisconReq.view(),
+      std::make_pair(SignalingChannel::Status::kSuccess, kDisconRsp.view()));
+
+  int open_cb_count = 0;
+  registry()->OpenOutbound(kPsm, [&open_cb_count](auto chan) {
+    EXPECT_FALSE(chan);
+    open_cb_count++;
+  });
+
+  RunLoopUntilIdle();
+
+  EXPECT_EQ(1, open_cb_count);
+}
+
+TEST_F(L2CAP_LEDynamicChannelTest, OpenAndLocalCloseChannel) {
+  sig()->AddOutbound(
+      kLECreditBasedConnectionRequest, kConnReq.view(),
+      std::make_pair(SignalingChannel::Status::kSuccess, kOkConnRsp.view()));
+  sig()->AddOutbound(
+      kDisconnectionRequest, kDisconReq.view(),
+      std::make_pair(SignalingChannel::Status::kSuccess, kDisconRsp.view()));
+
+  int open_cb_count = 0;
+  auto open_cb = [&open_cb_count](auto chan) {
+    if (open_cb_count == 0) {
+      ASSERT_TRUE(chan);
+      EXPECT_TRUE(chan->IsOpen());
+      EXPECT_TRUE(chan->IsConnected());
+      EXPECT_EQ(kLocalCId, chan->local_cid());
+      EXPECT_EQ(kRemoteCId, chan->remote_cid());
+
+      const auto& config = chan->mode_config();
+      EXPECT_EQ(ChannelMode::kLECreditBasedFlowControl, config.mode);
+      EXPECT_EQ(512u, config.tx_mtu);
+      EXPECT_EQ(100u, config.tx_mps);
+      EXPECT_EQ(5u, config.tx_credits);
+      EXPECT_EQ(kLECreditBasedDefaultMTU, config.rx_mtu);
+      EXPECT_EQ(kLECreditBasedDefaultMPS, config.rx_mps);
+      EXPECT_EQ(kLECreditBasedDefaultInitialCredits, config.rx_credits);
+    }
+    open_cb_count++;
+  };
+
+  int close_cb_count = 0;
+  set_channel_close_cb([&close_cb_count](auto) { close_cb_count++; });
+
+  registry()->OpenOutbound(kPsm, std::move(open_cb));
+
+  RunLoopUntilIdle();
+
+  EXPECT_EQ(1, open_cb_count);
+
+  registry()->CloseChannel(kLocalCId);
+  RunLoopUntilIdle();
+
+  // Local channel closure shouldn't trigger the close callback.
+  EXPECT_EQ(1, open_cb_count);
+  EXPECT_EQ(0, close_cb_count);
+}
+
+TEST_F(L2CAP_LEDynamicChannelTest, OpenAndRemoteCloseChannel) {
+  sig()->AddOutbound(
+      kLECreditBasedConnectionRequest, kConnReq.view(),
+      std::make_pair(SignalingChannel::Status::kSuccess, kOkConnRsp.view()));
+
+  int open_cb_count = 0;
+  registry()->OpenOutbound(kPsm, [&open_cb_count](auto) { open_cb_count++; });
+
+  int close_cb_count = 0;
+  set_channel_close_cb([&close_cb_count](auto chan) {
+    ASSERT_TRUE(chan);
+    EXPECT_FALSE(chan->IsOpen());
+    EXPECT_EQ(kLocalCId, chan->local_cid());
+    EXPECT_EQ(kRemoteCId, chan->remote_cid());
+    close_cb_count++;
+  });
+
+  RunLoopUntilIdle();
+
+  EXPECT_EQ(1, open_cb_count);
+  EXPECT_EQ(0, close_cb_count);
+
+  sig()->ReceiveExpect(kDisconnectionRequest, kInboundDisconReq,
+                       kInboundDisconRsp);
+
+  // Remote channel closure should trigger the close callback.
+  EXPECT_EQ(1, close_cb_count);
+
+  // The channel no longer exists.
+  sig()->ReceiveExpectRejectInvalidChannelId(
+      kDisconnectionRequest, kInboundDisconReq, kLocalCId, kRemoteCId);
+}
+
+TEST_F(L2CAP_LEDynamicChannelTest, InboundConnectionOk) {
+  sig()->AddOutbound(
+      kDisconnectionRequest, kDisconReq.view(),
+      std::make_pair(SignalingChannel::Status::kSuccess, kDisconRsp.view()));
+
+  int open_cb_count = 0;
+  DynamicChannelCallback open_cb = [&open_cb_count](auto chan) {
+    open_cb_count++;
+    ASSERT_TRUE(chan);
+    EXPECT_TRUE(chan->IsOpen());
+    EXPECT_EQ(kPsm, chan->psm());
+    EXPECT_EQ(kLocalCId, chan->local_cid());
+    EXPECT_EQ(kRemoteCId, chan->remote_cid());
+    EXPECT_EQ(ChannelMode::kLECreditBasedFlowControl, chan->mode_config().mode);
+    EXPECT_EQ(100u, chan->mode_config().tx_mps);
+    EXPECT_EQ(5u, chan->mode_config().tx_credits);
+  };
+
+  int service_request_cb_count = 0;
+  set_service_request_cb(
+      [&service_request_cb_count, open_cb = std::move(open_cb)](
+          PSM psm) mutable -> DynamicChannelCallback {
+        service_request_cb_count++;
+        EXPECT_EQ(kPsm, psm);
+        return open_cb.share();
+      });
+
+  sig()->ReceiveExpect(kLECreditBasedConnectionRequest, kInboundConnReq,
+                       kInboundOkConnRsp);
+  RunLoopUntilIdle();
+
+  EXPECT_EQ(1, service_request_cb_count);
+  EXPECT_EQ(1, open_cb_count);
+
+  registry()->CloseChannel(kLocalCId);
+}
+
+TEST_F(L2CAP_LEDynamicChannelTest, InboundConnectionInvalidPsm) {
+  set_service_request_cb([](PSM psm) -> DynamicChannelCallback {
+    ADD_FAILURE() << "Service requested for invalid LE_PSM";
+    return nullptr;
+  });
+
+  sig()->ReceiveExpect(kLECreditBasedConnectionRequest,
+                       kInboundInvalidPsmConnReq, kInboundBadPsmConnRsp);
+  RunLoopUntilIdle();
+}
+
+TEST_F(L2CAP_LEDynamicChannelTest, InboundConnectionUnsupportedPsm) {
+  int service_request_cb_count = 0;
+  set_service_request_cb(
+      [&service_request_cb_count](PSM psm) -> DynamicChannelCallback {
+        service_request_cb_count++;
+
+        // Reject the service request.
+        return nullptr;
+      });
+
+  sig()->ReceiveExpect(kLECreditBasedConnectionRequest, kInboundConnReq,
+                       kInboundBadPsmConnRsp);
+  RunLoopUntilIdle();
+
+  EXPECT_EQ(1, service_request_cb_count);
+}
+
+TEST_F(L2CAP_LEDynamicChannelTest, InboundConnectionInvalidSrcCId) {
+  set_service_request_cb([](PSM psm) -> DynamicChannelCallback {
+    ADD_FAILURE() << "Service requested for invalid source CID";
+    return nullptr;
+  });
+
+  sig()->ReceiveExpect(kLECreditBasedConnectionRequest, kInboundBadCIdConnReq,
+                       kInboundBadCIdConnRsp);
+  RunLoopUntilIdle();
+}
+
+TEST_F(L2CAP_LEDynamicChannelTest, InboundConnectionUnacceptableParameters) {
+  set_service_request_cb([](PSM psm) -> DynamicChannelCallback {
+    ADD_FAILURE() << "Service requested for unacceptable MPS";
+    return nullptr;
+  });
+
+  sig()->ReceiveExpect(kLECreditBasedConnectionRequest,
+                       kInboundSmallMpsConnReq, kInboundUnacceptableConnRsp);
+  RunLoopUntilIdle();
+}
+
+}  // namespace
+}  // namespace internal
+}  // namespace l2cap
+}  // namespace btlib
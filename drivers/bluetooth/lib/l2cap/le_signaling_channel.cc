@@ -19,17 +19,15 @@ LESignalingChannel::LESignalingChannel(fbl::RefPtr<Channel> chan,
   set_mtu(kMinLEMTU);
 }
 
-bool LESignalingChannel::SendRequest(CommandCode req_code,
-                                     const common::ByteBuffer& payload,
-                                     ResponseHandler cb) {
-  // TODO(NET-1093): Reuse BrEdrSignalingChannel's implementation.
-  bt_log(WARN, "l2cap-le", "sig: SendRequest not implemented yet");
-  return false;
-}
-
-void LESignalingChannel::ServeRequest(CommandCode req_code,
-                                      RequestDelegate cb) {
-  bt_log(WARN, "l2cap-le", "sig: ServeRequest not implemented yet");
+bool LESignalingChannel::SendFlowControlCredit(ChannelId local_cid,
+                                               uint16_t credits) {
+  LEFlowControlCreditParams params;
+  params.cid = htole16(local_cid);
+  params.credits = htole16(credits);
+
+  // This packet has no response, so its identifier doesn't need to be tracked.
+  return SendPacket(kLEFlowControlCredit, GetNextCommandId(),
+                    common::BufferView(&params, sizeof(params)));
 }
 
 void LESignalingChannel::OnConnParamUpdateReceived(
@@ -107,6 +105,21 @@ void LESignalingChannel::OnConnParamUpdateReceived(
   }
 }
 
+void LESignalingChannel::OnFlowControlCreditReceived(
+    const SignalingPacket& packet) {
+  if (packet.payload_size() != sizeof(LEFlowControlCreditParams)) {
+    bt_log(TRACE, "l2cap-le", "sig: malformed flow control credit received");
+    SendCommandReject(packet.header().id, RejectReason::kNotUnderstood,
+                      common::BufferView());
+    return;
+  }
+
+  const auto& params = packet.payload<LEFlowControlCreditParams>();
+  if (flow_control_credit_cb_) {
+    flow_control_credit_cb_(le16toh(params.cid), le16toh(params.credits));
+  }
+}
+
 void LESignalingChannel::DecodeRxUnit(const SDU& sdu,
                                       const SignalingPacketHandler& cb) {
   // "[O]nly one command per C-frame shall be sent over [the LE] Fixed Channel"
@@ -143,7 +156,13 @@ bool LESignalingChannel::HandlePacket(const SignalingPacket& packet) {
     case kConnectionParameterUpdateRequest:
       OnConnParamUpdateReceived(packet);
       return true;
+    case kLEFlowControlCredit:
+      OnFlowControlCreditReceived(packet);
+      return true;
     default:
+      if (HandleRequestOrResponse(packet)) {
+        return true;
+      }
       bt_log(TRACE, "l2cap-le", "sig: unsupported code %#.2x",
              packet.header().code);
       break;
@@ -152,6 +171,19 @@ bool LESignalingChannel::HandlePacket(const SignalingPacket& packet) {
   return false;
 }
 
+bool LESignalingChannel::IsSupportedResponse(CommandCode code) const {
+  switch (code) {
+    case kCommandRejectCode:
+    case kDisconnectionResponse:
+    case kLECreditBasedConnectionResponse:
+      return true;
+  }
+
+  // We never send Connection Parameter Update Requests, so their responses are
+  // unexpected.
+  return false;
+}
+
 }  // namespace internal
 }  // namespace l2cap
 }  // namespace btlib
@@ -21,13 +21,19 @@ class LESignalingChannel final : public SignalingChannel {
   using ConnectionParameterUpdateCallback =
       fit::function<void(const hci::LEPreferredConnectionParameters& params)>;
 
+  // Called with the source CID of the peer's endpoint of a credit based
+  // channel and the number of K-frames that the peer additionally allows us to
+  // send on that channel.
+  using FlowControlCreditCallback =
+      fit::function<void(ChannelId remote_cid, uint16_t credits)>;
+
   LESignalingChannel(fbl::RefPtr<Channel> chan, hci::Connection::Role role);
   ~LESignalingChannel() override = default;
 
-  // SignalingChannelInterface overrides
-  bool SendRequest(CommandCode req_code, const common::ByteBuffer& payload,
-                   ResponseHandler cb) override;
-  void ServeRequest(CommandCode req_code, RequestDelegate cb) override;
+  // Grants the peer |credits| more K-frames on the credit based channel whose
+  // endpoint on this device is |local_cid|. Returns false if the LE Flow
+  // Control Credit packet could not be sent.
+  bool SendFlowControlCredit(ChannelId local_cid, uint16_t credits);
 
   // Sets a |callback| to be invoked when a Connection Parameter Update request
   // is received with the given parameters. LESignalingChannel will
@@ -45,17 +51,29 @@ class LESignalingChannel final : public SignalingChannel {
     dispatcher_ = dispatcher;
   }
 
+  // Sets a |callback| to be invoked when a LE Flow Control Credit packet is
+  // received. Unlike the connection parameter update callback, this runs on
+  // the L2CAP thread when the packet is processed.
+  void set_flow_control_credit_callback(FlowControlCreditCallback callback) {
+    ZX_DEBUG_ASSERT(IsCreationThreadCurrent());
+    flow_control_credit_cb_ = std::move(callback);
+  }
+
  private:
   void OnConnParamUpdateReceived(const SignalingPacket& packet);
+  void OnFlowControlCreditReceived(const SignalingPacket& packet);
 
   // SignalingChannel override
   void DecodeRxUnit(const SDU& sdu, const SignalingPacketHandler& cb) override;
 
   bool HandlePacket(const SignalingPacket& packet) override;
+  bool IsSupportedResponse(CommandCode code) const override;
 
   ConnectionParameterUpdateCallback conn_param_update_cb_;
   async_dispatcher_t* dispatcher_;
 
+  FlowControlCreditCallback flow_control_credit_cb_;
+
   FXL_DISALLOW_COPY_AND_ASSIGN(LESignalingChannel);
 };
 
@@ -354,6 +354,86 @@ TEST_F(L2CAP_LESignalingChannelSlaveTest, ConnParamUpdateReject) {
   EXPECT_TRUE(cb_called);
 }
 
+TEST_F(L2CAP_LESignalingChannelTest, SendFlowControlCredit) {
+  // clang-format off
+  auto expected = common::CreateStaticByteBuffer(
+      // Command header (LE Flow Control Credit, length: 4)
+      0x16, kTestCmdId, 0x04, 0x00,
+
+      // CID: 0x0040, credits: 0x0102
+      0x40, 0x00, 0x02, 0x01);
+  // clang-format on
+
+  bool cb_called = false;
+  auto cb = [&expected, &cb_called](auto packet) {
+    EXPECT_TRUE(common::ContainersEqual(expected, *packet));
+    cb_called = true;
+  };
+  fake_chan()->SetSendCallback(cb, dispatcher());
+
+  EXPECT_TRUE(sig()->SendFlowControlCredit(0x0040, 0x0102));
+
+  RunLoopUntilIdle();
+  EXPECT_TRUE(cb_called);
+}
+
+TEST_F(L2CAP_LESignalingChannelTest, ReceiveFlowControlCredit) {
+  // clang-format off
+  auto cmd = common::CreateStaticByteBuffer(
+      // Command header (LE Flow Control Credit, length: 4)
+      0x16, kTestCmdId, 0x04, 0x00,
+
+      // CID: 0x0047, credits: 0x0102
+      0x47, 0x00, 0x02, 0x01);
+  // clang-format on
+
+  bool send_cb_called = false;
+  auto send_cb = [&send_cb_called](auto) { send_cb_called = true; };
+  fake_chan()->SetSendCallback(send_cb, dispatcher());
+
+  ChannelId remote_cid = 0;
+  uint16_t credits = 0;
+  sig()->set_flow_control_credit_callback(
+      [&remote_cid, &credits](ChannelId cb_remote_cid, uint16_t cb_credits) {
+        remote_cid = cb_remote_cid;
+        credits = cb_credits;
+      });
+
+  fake_chan()->Receive(cmd);
+  RunLoopUntilIdle();
+
+  EXPECT_EQ(0x0047, remote_cid);
+  EXPECT_EQ(0x0102, credits);
+
+  // LE Flow Control Credit packets have no response.
+  EXPECT_FALSE(send_cb_called);
+}
+
+TEST_F(L2CAP_LESignalingChannelTest, FlowControlCreditMalformed) {
+  // clang-format off
+  auto cmd = common::CreateStaticByteBuffer(
+      // Command header (LE Flow Control Credit, length: 2)
+      0x16, kTestCmdId, 0x02, 0x00,
+
+      // CID: 0x0047
+      0x47, 0x00);
+
+  auto expected = common::CreateStaticByteBuffer(
+      // Command header
+      0x01, kTestCmdId, 0x02, 0x00,
+
+      // Reason (Command not understood)
+      0x00, 0x00);
+  // clang-format on
+
+  bool credit_cb_called = false;
+  sig()->set_flow_control_credit_callback(
+      [&credit_cb_called](auto, auto) { credit_cb_called = true; });
+
+  EXPECT_TRUE(ReceiveAndExpect(cmd, expected));
+  EXPECT_FALSE(credit_cb_called);
+}
+
 }  // namespace
 }  // namespace internal
 }  // namespace l2cap
@@ -15,6 +15,7 @@
 #include "bredr_dynamic_channel.h"
 #include "bredr_signaling_channel.h"
 #include "channel.h"
+#include "le_dynamic_channel.h"
 #include "le_signaling_channel.h"
 
 namespace btlib {
@@ -46,6 +47,21 @@ constexpr bool IsValidBREDRFixedChannel(ChannelId id) {
   return false;
 }
 
+// Signaling and security traffic is small and other traffic waits on it, so it
+// is sent ahead of any data that is queued on the link.
+constexpr hci::ACLDataChannel::PacketPriority ChannelPriority(ChannelId id) {
+  switch (id) {
+    case kSignalingChannelId:
+    case kSMPChannelId:
+    case kLESignalingChannelId:
+    case kLESMPChannelId:
+      return hci::ACLDataChannel::PacketPriority::kHigh;
+    default:
+      break;
+  }
+  return hci::ACLDataChannel::PacketPriority::kLow;
+}
+
 }  // namespace
 
 LogicalLink::LogicalLink(hci::ConnectionHandle handle,
@@ -103,8 +119,14 @@ LogicalLink::LogicalLink(hci::ConnectionHandle handle,
 
   // Set up the signaling channel and dynamic channels.
   if (type_ == hci::Connection::LinkType::kLE) {
-    signaling_channel_ = std::make_unique<LESignalingChannel>(
+    auto le_signaling_channel = std::make_unique<LESignalingChannel>(
         OpenFixedChannel(kLESignalingChannelId), role_);
+    le_signaling_channel->set_flow_control_credit_callback(
+        fit::bind_member(this, &LogicalLink::OnFlowControlCredit));
+    signaling_channel_ = std::move(le_signaling_channel);
+    dynamic_registry_ = std::make_unique<LEDynamicChannelRegistry>(
+        signaling_channel_.get(), std::move(on_channel_closed),
+        fit::bind_member(this, &LogicalLink::OnServiceRequest));
   } else {
     signaling_channel_ = std::make_unique<BrEdrSignalingChannel>(
         OpenFixedChannel(kSignalingChannelId), role_);
@@ -142,7 +164,8 @@ fbl::RefPtr<Channel> LogicalLink::OpenFixedChannel(ChannelId id) {
   // A fixed channel's endpoints have the same local and remote identifiers.
   auto chan = fbl::AdoptRef(new ChannelImpl(id /* id */, id /* remote_id */,
                                             weak_ptr_factory_.GetWeakPtr(),
-                                            std::move(pending)));
+                                            std::move(pending),
+                                            ChannelModeConfig()));
   channels_[id] = chan;
 
   return chan;
@@ -152,13 +175,6 @@ void LogicalLink::OpenChannel(PSM psm, ChannelCallback cb,
                               async_dispatcher_t* dispatcher) {
   ZX_DEBUG_ASSERT(thread_checker_.IsCreationThreadCurrent());
 
-  // TODO(NET-1437): Implement channels for LE credit-based connections
-  if (type_ == hci::Connection::LinkType::kLE) {
-    bt_log(WARN, "l2cap", "not opening LE channel for PSM %.4x", psm);
-    CompleteDynamicOpen(nullptr, std::move(cb), dispatcher);
-    return;
-  }
-
   auto create_channel = [self = weak_ptr_factory_.GetWeakPtr(),
                          cb = std::move(cb),
                          dispatcher](const DynamicChannel* dyn_chan) mutable {
@@ -171,6 +187,16 @@ void LogicalLink::OpenChannel(PSM psm, ChannelCallback cb,
   dynamic_registry_->OpenOutbound(psm, std::move(create_channel));
 }
 
+void LogicalLink::SetPreferredChannelMode(PSM psm, ChannelMode mode) {
+  ZX_DEBUG_ASSERT(thread_checker_.IsCreationThreadCurrent());
+
+  if (type_ == hci::Connection::LinkType::kLE)
+    return;
+
+  static_cast<BrEdrDynamicChannelRegistry*>(dynamic_registry_.get())
+      ->SetPreferredChannelMode(psm, mode);
+}
+
 void LogicalLink::HandleRxPacket(hci::ACLDataPacketPtr packet) {
   ZX_DEBUG_ASSERT(thread_checker_.IsCreationThreadCurrent());
   ZX_DEBUG_ASSERT(!recombiner_.ready());
@@ -247,7 +273,8 @@ void LogicalLink::SendBasicFrame(ChannelId id,
   auto fragments = pdu.ReleaseFragments();
 
   ZX_DEBUG_ASSERT(!fragments.is_empty());
-  hci_->acl_data_channel()->SendPackets(std::move(fragments), type_);
+  hci_->acl_data_channel()->SendPackets(std::move(fragments), type_,
+                                        ChannelPriority(id));
 }
 
 void LogicalLink::set_error_callback(fit::closure callback,
@@ -290,11 +317,24 @@ void LogicalLink::RemoveChannel(Channel* chan) {
 
   // Disconnect the channel if it's a dynamic channel. This path is for local-
   // initiated closures and does not invoke callbacks back to the channel user.
-  // TODO(armansito): Change this if statement into an assert when a registry
-  // gets created for LE channels.
-  if (dynamic_registry_) {
-    dynamic_registry_->CloseChannel(id);
-  }
+  ZX_DEBUG_ASSERT(dynamic_registry_);
+  dynamic_registry_->CloseChannel(id);
+}
+
+void LogicalLink::DisconnectChannel(Channel* chan) {
+  ZX_DEBUG_ASSERT(thread_checker_.IsCreationThreadCurrent());
+  ZX_DEBUG_ASSERT(chan);
+
+  auto iter = channels_.find(chan->id());
+  if (iter == channels_.end() || iter->second.get() != chan)
+    return;
+
+  bt_log(TRACE, "l2cap", "Link %#.4x: Disconnecting channel %#.4x", handle_,
+         chan->id());
+
+  fbl::RefPtr<ChannelImpl> channel = iter->second;
+  RemoveChannel(chan);
+  channel->OnClosed();
 }
 
 void LogicalLink::SignalError() {
@@ -306,6 +346,35 @@ void LogicalLink::SignalError() {
   }
 }
 
+void LogicalLink::SendFlowControlCredit(ChannelId local_cid,
+                                        uint16_t credits) {
+  ZX_DEBUG_ASSERT(thread_checker_.IsCreationThreadCurrent());
+  ZX_DEBUG_ASSERT(type_ == hci::Connection::LinkType::kLE);
+
+  if (!le_signaling_channel()->SendFlowControlCredit(local_cid, credits)) {
+    bt_log(ERROR, "l2cap", "Link %#.4x: Failed to send credits for %#.4x",
+           handle_, local_cid);
+  }
+}
+
+void LogicalLink::OnFlowControlCredit(ChannelId remote_cid,
+                                      uint16_t credits) {
+  ZX_DEBUG_ASSERT(thread_checker_.IsCreationThreadCurrent());
+
+  // Credits are addressed by the peer's endpoint, so look for the dynamic
+  // channel that leads to it.
+  for (auto& iter : channels_) {
+    if (iter.first >= kFirstDynamicChannelId &&
+        iter.second->remote_id() == remote_cid) {
+      iter.second->AddCredits(credits);
+      return;
+    }
+  }
+
+  bt_log(TRACE, "l2cap", "Link %#.4x: Ignoring credits for unknown %#.4x",
+         handle_, remote_cid);
+}
+
 void LogicalLink::Close() {
   ZX_DEBUG_ASSERT(thread_checker_.IsCreationThreadCurrent());
 
@@ -355,8 +424,9 @@ void LogicalLink::CompleteDynamicOpen(const DynamicChannel* dyn_chan,
          "Link %#.4x: Channel opened with ID %#.4x (remote ID %#.4x)", handle_,
          local_cid, remote_cid);
 
-  auto chan = fbl::AdoptRef(new ChannelImpl(
-      local_cid, remote_cid, weak_ptr_factory_.GetWeakPtr(), {}));
+  auto chan = fbl::AdoptRef(
+      new ChannelImpl(local_cid, remote_cid, weak_ptr_factory_.GetWeakPtr(),
+                      {}, dyn_chan->mode_config()));
   channels_[local_cid] = chan;
   async::PostTask(dispatcher, std::bind(std::move(open_cb), std::move(chan)));
 }
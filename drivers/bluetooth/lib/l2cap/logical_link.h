@@ -64,6 +64,12 @@ class LogicalLink final {
 
   void OpenChannel(PSM psm, ChannelCallback cb, async_dispatcher_t* dispatcher);
 
+  // Requests |mode| for the dynamic channels that are opened with |psm| from
+  // now on. Channels fall back to Basic mode if the peer doesn't support it.
+  // Has no effect on LE-U links, whose dynamic channels always use LE Credit
+  // Based Flow Control mode.
+  void SetPreferredChannelMode(PSM psm, ChannelMode mode);
+
   // Takes ownership of |packet| for PDU processing and routes it to its target
   // channel. This must be called on the HCI I/O thread.
   void HandleRxPacket(hci::ACLDataPacketPtr packet);
@@ -99,9 +105,21 @@ class LogicalLink final {
   // link.
   void RemoveChannel(Channel* chan);
 
+  // Called when the channel mode implementation of |chan| fails. Disconnects
+  // the channel and notifies its user that it has closed.
+  void DisconnectChannel(Channel* chan);
+
   // Called by ChannelImpl::SignalLinkError().
   void SignalError();
 
+  // Called by ChannelImpl to grant the peer |credits| more K-frames on the
+  // channel with |local_cid|. Must only be called on LE-U links.
+  void SendFlowControlCredit(ChannelId local_cid, uint16_t credits);
+
+  // Passes the credits that the peer has granted to the channel whose remote
+  // endpoint is |remote_cid|.
+  void OnFlowControlCredit(ChannelId remote_cid, uint16_t credits);
+
   // Notifies and closes all open channels on this link. Called by the
   // destructor.
   void Close();
@@ -127,6 +127,7 @@ class PDU final {
   friend class Reader;
   friend class Fragmenter;
   friend class Recombiner;
+  friend class SDU;
 
   // Methods accessed by friends.
   const BasicHeader& basic_header() const;
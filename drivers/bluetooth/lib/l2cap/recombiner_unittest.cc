@@ -3,10 +3,18 @@
 // found in the LICENSE file.
 
 #include "recombiner.h"
+
+#include <chrono>
+#include <vector>
+
+#include "credit_based_flow_control_engine.h"
+#include "fragmenter.h"
 #include "pdu.h"
+#include "sdu.h"
 
 #include "gtest/gtest.h"
 
+#include "garnet/drivers/bluetooth/lib/common/test_helpers.h"
 #include "garnet/drivers/bluetooth/lib/hci/hci.h"
 #include "garnet/drivers/bluetooth/lib/hci/packet.h"
 
@@ -455,6 +463,208 @@ TEST(L2CAP_RecombinerTest, DropPartial) {
   EXPECT_EQ(4u, pdu.length());
 }
 
+// How the receive path benchmark below consumes each SDU.
+enum class SduConsumer {
+  // Reads the ACL data fragments in place with SDU::ForEachFragment().
+  kScatter,
+
+  // Reads the whole SDU at once with SDU::Reader, which linearizes it if it
+  // spans more than one fragment.
+  kReader,
+
+  // Copies the SDU into a buffer of its own, like the receive path did before
+  // SDUs kept their ACL data packets.
+  kCopy,
+};
+
+const char* SduConsumerName(SduConsumer consumer) {
+  switch (consumer) {
+    case SduConsumer::kScatter:
+      return "scatter";
+    case SduConsumer::kReader:
+      return "reader";
+    case SduConsumer::kCopy:
+      return "copy";
+  }
+  return "";
+}
+
+// Tallies what the receive path benchmark hands to consumers.
+struct ReceiveStats {
+  // Payloads of the ACL data packets that carry the SDU being received.
+  std::vector<common::BufferView> acl_payloads;
+  size_t next_payload = 0u;
+
+  size_t acl_packets = 0u;
+  size_t copies = 0u;
+  size_t copied_bytes = 0u;
+  size_t received_bytes = 0u;
+  std::chrono::steady_clock::duration elapsed{};
+
+  // Forgets the ACL data packets of the previous SDU.
+  void StartSdu() {
+    acl_payloads.clear();
+    next_payload = 0u;
+  }
+
+  // Moves the fragments of |pdu| into |recombiner| and records where their
+  // payloads are.
+  void AddFragments(PDU pdu, Recombiner* recombiner) {
+    auto fragments = pdu.ReleaseFragments();
+    while (!fragments.is_empty()) {
+      auto packet = fragments.pop_front();
+      acl_payloads.push_back(packet->view().payload_data());
+      acl_packets++;
+      EXPECT_TRUE(recombiner->AddFragment(std::move(packet)));
+    }
+  }
+
+  // Counts |data| as received. Data that does not lie within an ACL data
+  // packet must have been copied out of one. Fragments are received in order,
+  // so the search resumes from the last packet that held data.
+  void Receive(const common::ByteBuffer& data) {
+    received_bytes += data.size();
+    for (size_t i = next_payload; i < acl_payloads.size(); i++) {
+      const auto& payload = acl_payloads[i];
+      if (data.data() >= payload.data() &&
+          data.data() + data.size() <= payload.data() + payload.size()) {
+        next_payload = i;
+        return;
+      }
+    }
+    copies++;
+    copied_bytes += data.size();
+  }
+
+  void Consume(const SDU& sdu, SduConsumer consumer) {
+    switch (consumer) {
+      case SduConsumer::kScatter:
+        sdu.ForEachFragment(
+            [this](const common::ByteBuffer& data) { Receive(data); });
+        break;
+      case SduConsumer::kReader:
+        EXPECT_TRUE(SDU::Reader(&sdu).ReadNext(
+            sdu.length(),
+            [this](const common::ByteBuffer& data) { Receive(data); }));
+        break;
+      case SduConsumer::kCopy: {
+        common::DynamicByteBuffer buffer(sdu.length());
+        sdu.Copy(&buffer);
+        Receive(buffer);
+        break;
+      }
+    }
+  }
+
+  void Print(const char* mode, size_t fragment_size) const {
+    const double kb = received_bytes / 1024.0;
+    common::PrintBenchmarkResult(
+        "%s,%zu,%.2f,%.2f,%.1f,%.0f\n", mode, fragment_size,
+        acl_packets / kb, copies / kb, copied_bytes / kb,
+        std::chrono::duration<double, std::nano>(elapsed).count() / kb);
+  }
+};
+
+// Measures the copies and allocations made to deliver SDUs received in ACL
+// data packets of various sizes. The slab-allocated ACL data packets are the
+// only allocations that the zero-copy path makes, so bytes received outside of
+// them are copies into buffers of their own.
+TEST(L2CAP_RecombinerTest, ReceivePathBenchmark) {
+  constexpr size_t kSduCount = 200;
+  constexpr size_t kSduSize = 2000;
+  constexpr hci::ConnectionHandle kHandle = 0x0001;
+  constexpr ChannelId kChannelId = 0x0040;
+  constexpr size_t kFragmentSizes[] = {27, 251, 1021};
+
+  common::DynamicByteBuffer sdu_data(kSduSize);
+  for (size_t i = 0; i < sdu_data.size(); i++) {
+    sdu_data[i] = static_cast<uint8_t>(i);
+  }
+
+  common::PrintBenchmarkResult(
+      "mode,fragment_size,acl_packets_per_kb,copies_per_kb,"
+      "copied_bytes_per_kb,ns_per_kb\n");
+  for (size_t fragment_size : kFragmentSizes) {
+    // Basic mode, where each SDU is the payload of one B-frame.
+    for (auto consumer :
+         {SduConsumer::kScatter, SduConsumer::kReader, SduConsumer::kCopy}) {
+      ReceiveStats stats;
+      Recombiner recombiner;
+      for (size_t i = 0; i < kSduCount; i++) {
+        auto pdu = Fragmenter(kHandle, fragment_size)
+                       .BuildBasicFrame(kChannelId, sdu_data);
+        stats.StartSdu();
+
+        const auto start = std::chrono::steady_clock::now();
+        stats.AddFragments(std::move(pdu), &recombiner);
+        PDU rx_pdu;
+        ASSERT_TRUE(recombiner.Release(&rx_pdu));
+        SDU sdu(std::move(rx_pdu));
+        stats.Consume(sdu, consumer);
+        stats.elapsed += std::chrono::steady_clock::now() - start;
+      }
+      stats.Print(SduConsumerName(consumer), fragment_size);
+
+      EXPECT_EQ(kSduCount * kSduSize, stats.received_bytes);
+      if (consumer == SduConsumer::kScatter) {
+        EXPECT_EQ(0u, stats.copies);
+      } else {
+        EXPECT_EQ(kSduCount, stats.copies);
+      }
+    }
+
+    // LE Credit Based Flow Control mode, where each K-frame fits in one ACL
+    // data packet and each SDU spans several K-frames.
+    ChannelModeConfig config;
+    config.mode = ChannelMode::kLECreditBasedFlowControl;
+    config.tx_mtu = config.rx_mtu = kSduSize;
+    config.tx_mps = config.rx_mps = fragment_size - sizeof(BasicHeader);
+    config.tx_credits = config.rx_credits = kLECreditBasedMaxCredits;
+
+    std::vector<PDU> k_frames;
+    internal::CreditBasedFlowControlEngine tx_engine(
+        kChannelId, config,
+        [&](auto frame) {
+          k_frames.push_back(Fragmenter(kHandle, fragment_size)
+                                 .BuildBasicFrame(kChannelId, *frame));
+        },
+        [](auto) {}, [](auto) {}, [] { ADD_FAILURE(); });
+
+    ReceiveStats stats;
+    Recombiner recombiner;
+    size_t sdus_received = 0;
+    internal::CreditBasedFlowControlEngine rx_engine(
+        kChannelId, config, [](auto) {},
+        [&](SDU sdu) {
+          EXPECT_EQ(kSduSize, sdu.length());
+          stats.Consume(sdu, SduConsumer::kScatter);
+          sdus_received++;
+        },
+        [](auto) {}, [] { ADD_FAILURE(); });
+
+    for (size_t i = 0; i < kSduCount; i++) {
+      k_frames.clear();
+      tx_engine.QueueSdu(sdu_data);
+      tx_engine.AddCredits(k_frames.size());
+      stats.StartSdu();
+
+      const auto start = std::chrono::steady_clock::now();
+      for (auto& k_frame : k_frames) {
+        stats.AddFragments(std::move(k_frame), &recombiner);
+        PDU rx_pdu;
+        ASSERT_TRUE(recombiner.Release(&rx_pdu));
+        rx_engine.ProcessPdu(std::move(rx_pdu));
+      }
+      stats.elapsed += std::chrono::steady_clock::now() - start;
+    }
+    stats.Print("le_coc_scatter", fragment_size);
+
+    EXPECT_EQ(kSduCount, sdus_received);
+    EXPECT_EQ(kSduCount * kSduSize, stats.received_bytes);
+    EXPECT_EQ(0u, stats.copies);
+  }
+}
+
 }  // namespace
 }  // namespace l2cap
 }  // namespace btlib
@@ -0,0 +1,202 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "sdu.h"
+
+#include <zircon/assert.h>
+
+#include <algorithm>
+
+namespace btlib {
+namespace l2cap {
+namespace {
+
+// Reads that cross fragment boundaries and fit in this many bytes are copied
+// into a buffer on the stack rather than the heap.
+constexpr size_t kMaxStackReadSize = 1024;
+
+}  // namespace
+
+SDU::Reader::Reader(const SDU* sdu) : offset_(0u), sdu_(sdu) {
+  ZX_DEBUG_ASSERT(sdu_);
+  ZX_DEBUG_ASSERT(sdu_->is_valid());
+
+  cursor_ = sdu_->CursorAt(0u);
+}
+
+bool SDU::Reader::ReadNext(size_t size, const ReadFunc& func) {
+  ZX_DEBUG_ASSERT(func);
+
+  if (!size || offset_ + size > sdu_->length())
+    return false;
+
+  offset_ += size;
+
+  // Return a view to avoid copying if the read lies within a single fragment.
+  Cursor start = cursor_;
+  size_t view_count = 0u;
+  common::BufferView first_view;
+  sdu_->VisitRange(&cursor_, size,
+                   [&view_count, &first_view](const common::ByteBuffer& data) {
+                     if (!view_count++) {
+                       first_view = data.view();
+                     }
+                   });
+  if (view_count == 1u) {
+    func(first_view);
+    return true;
+  }
+
+  // Copy the read from where it started.
+  auto copy = [this, &start, size](common::MutableByteBuffer* buffer) {
+    size_t offset = 0u;
+    sdu_->VisitRange(&start, size,
+                     [buffer, &offset](const common::ByteBuffer& data) {
+                       buffer->Write(data, offset);
+                       offset += data.size();
+                     });
+  };
+
+  if (size <= kMaxStackReadSize) {
+    common::StaticByteBuffer<kMaxStackReadSize> buffer;
+    copy(&buffer);
+    func(buffer.view(0, size));
+    return true;
+  }
+
+  common::DynamicByteBuffer buffer(size);
+  copy(&buffer);
+  func(buffer);
+  return true;
+}
+
+SDU::SDU() : length_(0u) {}
+
+SDU::SDU(PDU&& pdu) : length_(0u) { Append(std::move(pdu)); }
+
+SDU::SDU(SDU&& other)
+    : head_(std::move(other.head_)),
+      tail_(std::move(other.tail_)),
+      length_(other.length_) {
+  other.tail_.clear();
+  other.length_ = 0u;
+}
+
+SDU& SDU::operator=(SDU&& other) {
+  head_ = std::move(other.head_);
+  tail_ = std::move(other.tail_);
+  length_ = other.length_;
+  other.tail_.clear();
+  other.length_ = 0u;
+  return *this;
+}
+
+size_t SDU::segment_count() const {
+  return is_valid() ? tail_.size() + 1 : 0u;
+}
+
+void SDU::Append(PDU&& pdu, size_t offset) {
+  ZX_DEBUG_ASSERT(pdu.is_valid());
+  ZX_DEBUG_ASSERT(offset <= pdu.length());
+
+  Segment segment;
+  segment.offset = offset;
+  segment.size = pdu.length() - offset;
+  segment.pdu = std::move(pdu);
+  length_ += segment.size;
+
+  if (!is_valid()) {
+    head_ = std::move(segment);
+  } else {
+    tail_.push_back(std::move(segment));
+  }
+}
+
+void SDU::ForEachFragment(const FragmentFunc& func) const {
+  Cursor cursor = CursorAt(0u);
+  VisitRange(&cursor, length_, func);
+}
+
+size_t SDU::Copy(common::MutableByteBuffer* out_buffer, size_t pos,
+                 size_t size) const {
+  ZX_DEBUG_ASSERT(out_buffer);
+  ZX_DEBUG_ASSERT(pos <= length_);
+
+  const size_t copy_size = std::min(size, length_ - pos);
+  ZX_DEBUG_ASSERT(out_buffer->size() >= copy_size);
+
+  size_t offset = 0u;
+  Cursor cursor = CursorAt(pos);
+  VisitRange(&cursor, copy_size,
+             [out_buffer, &offset](const common::ByteBuffer& data) {
+               out_buffer->Write(data, offset);
+               offset += data.size();
+             });
+  ZX_DEBUG_ASSERT(offset == copy_size);
+  return offset;
+}
+
+const SDU::Segment& SDU::segment(size_t index) const {
+  ZX_DEBUG_ASSERT(index < segment_count());
+  return index ? tail_[index - 1] : head_;
+}
+
+SDU::Cursor SDU::SegmentCursor(size_t index, size_t pos) const {
+  const Segment& seg = segment(index);
+  ZX_DEBUG_ASSERT(pos <= seg.size);
+
+  // Find the fragment within the PDU's frame, which starts with the Basic
+  // L2CAP header ahead of the information payload.
+  Cursor cursor;
+  cursor.segment = index;
+  cursor.segment_remaining = seg.size - pos;
+  cursor.fragment = seg.pdu.fragments_.begin();
+  cursor.fragment_offset = sizeof(BasicHeader) + seg.offset + pos;
+  while (cursor.fragment_offset > cursor.fragment->view().payload_size()) {
+    cursor.fragment_offset -= cursor.fragment->view().payload_size();
+    ++cursor.fragment;
+  }
+  return cursor;
+}
+
+SDU::Cursor SDU::CursorAt(size_t pos) const {
+  ZX_DEBUG_ASSERT(pos <= length_);
+
+  size_t index = 0u;
+  while (index + 1 < segment_count() && pos >= segment(index).size) {
+    pos -= segment(index).size;
+    index++;
+  }
+  return SegmentCursor(index, pos);
+}
+
+void SDU::VisitRange(Cursor* cursor, size_t size,
+                     const FragmentFunc& func) const {
+  ZX_DEBUG_ASSERT(cursor);
+
+  while (size) {
+    if (!cursor->segment_remaining) {
+      *cursor = SegmentCursor(cursor->segment + 1, 0u);
+      continue;
+    }
+
+    const auto payload = cursor->fragment->view().payload_data();
+    if (cursor->fragment_offset == payload.size()) {
+      ++cursor->fragment;
+      cursor->fragment_offset = 0u;
+      continue;
+    }
+
+    const size_t view_size =
+        std::min({payload.size() - cursor->fragment_offset,
+                  cursor->segment_remaining, size});
+    func(payload.view(cursor->fragment_offset, view_size));
+    cursor->fragment_offset += view_size;
+    cursor->segment_remaining -= view_size;
+    size -= view_size;
+  }
+}
+
+}  // namespace l2cap
+}  // namespace btlib
@@ -5,14 +5,138 @@
 #ifndef GARNET_DRIVERS_BLUETOOTH_LIB_L2CAP_SDU_H_
 #define GARNET_DRIVERS_BLUETOOTH_LIB_L2CAP_SDU_H_
 
+#include <limits>
+#include <vector>
+
+#include <lib/fit/function.h>
+
+#include "garnet/drivers/bluetooth/lib/common/byte_buffer.h"
 #include "garnet/drivers/bluetooth/lib/l2cap/pdu.h"
+#include "lib/fxl/macros.h"
 
 namespace btlib {
 namespace l2cap {
 
-// TODO(armansito): For now we only support basic mode in which 1 SDU = 1 PDU.
-// Revisit once we support other modes.
-using SDU = PDU;
+// Represents a L2CAP SDU (service data unit), which is what a channel delivers
+// to its user. An SDU is a chain of segments, each of which is a window onto
+// the information payload of a PDU. In Basic mode an SDU is the payload of a
+// single B-frame, while in LE Credit Based Flow Control mode it spans one or
+// more K-frames less their SDU length field.
+//
+// The SDU owns the ACL data packets that carried its PDUs, as received from
+// the controller. These can be read in place as a scatter list with
+// ForEachFragment(). Only Copy() and a Reader read that crosses a fragment
+// boundary copy the payload into contiguous memory.
+//
+// Like a PDU, an SDU is move-only.
+//
+// THREAD-SAFETY:
+//
+// This class is not thread-safe. External locking should be provided if an
+// instance will be accessed on multiple threads.
+class SDU final {
+ public:
+  using FragmentFunc = fit::function<void(const common::ByteBuffer& data)>;
+
+  // Allows sequential access to the payload. See below.
+  class Reader;
+
+  // An SDU with no segments is invalid, which is the default-constructed state.
+  SDU();
+
+  // Constructs an SDU of the entire information payload of |pdu|.
+  explicit SDU(PDU&& pdu);
+
+  ~SDU() = default;
+
+  // Allow move operations.
+  SDU(SDU&& other);
+  SDU& operator=(SDU&& other);
+
+  // An SDU is valid once it has a segment, even if that segment is empty.
+  bool is_valid() const { return head_.pdu.is_valid(); }
+
+  // The number of payload bytes in this SDU.
+  size_t length() const { return length_; }
+
+  // The number of PDUs whose payloads make up this SDU.
+  size_t segment_count() const;
+
+  // Appends the information payload of |pdu| from |offset| onwards to this
+  // SDU. The first segment of an invalid SDU makes it valid.
+  void Append(PDU&& pdu, size_t offset = 0u);
+
+  // Calls |func| with a view of each ACL data fragment's share of this SDU, in
+  // order, without copying. Empty shares are skipped.
+  void ForEachFragment(const FragmentFunc& func) const;
+
+  // Copies up to |size| bytes of this SDU starting at offset |pos| into
+  // |out_buffer|, which should be sufficiently large. Returns the number of
+  // bytes copied.
+  size_t Copy(common::MutableByteBuffer* out_buffer, size_t pos = 0,
+              size_t size = std::numeric_limits<std::size_t>::max()) const;
+
+ private:
+  // A window onto the information payload of |pdu|.
+  struct Segment {
+    PDU pdu;
+    size_t offset = 0u;
+    size_t size = 0u;
+  };
+
+  // A position within this SDU, as the segment and ACL data fragment that hold
+  // it. |fragment_offset| is relative to the start of the fragment's payload.
+  struct Cursor {
+    size_t segment;
+    size_t segment_remaining;
+    PDU::FragmentList::const_iterator fragment;
+    size_t fragment_offset;
+  };
+
+  const Segment& segment(size_t index) const;
+
+  // Returns a cursor at |pos| bytes into the segment at |index|.
+  Cursor SegmentCursor(size_t index, size_t pos) const;
+
+  // Returns a cursor at |pos| bytes into this SDU.
+  Cursor CursorAt(size_t pos) const;
+
+  // Calls |func| with views of the fragments that hold the |size| bytes
+  // starting at |cursor|, and advances |cursor| past them.
+  void VisitRange(Cursor* cursor, size_t size, const FragmentFunc& func) const;
+
+  // Most SDUs have a single segment, which is kept inline so that wrapping a
+  // PDU doesn't allocate. The rest of the segments, if any, follow in |tail_|.
+  Segment head_;
+  std::vector<Segment> tail_;
+  size_t length_;
+
+  FXL_DISALLOW_COPY_AND_ASSIGN(SDU);
+};
+
+// Reader allows sequential access to the payload of an SDU. A read that lies
+// within a single ACL data fragment is passed as a view into that fragment.
+// Larger reads are copied into a buffer, which is only allocated dynamically
+// if it doesn't fit on the stack. Like PDU::Reader, it keeps its place in the
+// SDU, so each read starts where the last one ended.
+//
+// A Reader is valid as long as the underlying SDU is valid and isn't appended
+// to. As with PDU::Reader, the ReadFunc may invalidate the SDU so long as it
+// makes no further reference to the SDU, the ByteBuffer, or the Reader.
+class SDU::Reader final {
+ public:
+  explicit Reader(const SDU* sdu);
+
+  // Calls |func| with the next segment of data with the given |size|. Returns
+  // false if less than |size| bytes remain in the SDU or if |size| is 0.
+  using ReadFunc = fit::function<void(const common::ByteBuffer& data)>;
+  bool ReadNext(size_t size, const ReadFunc& func);
+
+ private:
+  size_t offset_;
+  const SDU* sdu_;
+  SDU::Cursor cursor_;
+};
 
 }  // namespace l2cap
 }  // namespace btlib
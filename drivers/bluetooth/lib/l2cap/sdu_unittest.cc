@@ -0,0 +1,198 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "sdu.h"
+
+#include <vector>
+
+#include "fragmenter.h"
+
+#include "gtest/gtest.h"
+
+#include "garnet/drivers/bluetooth/lib/common/test_helpers.h"
+
+namespace btlib {
+namespace l2cap {
+namespace {
+
+using common::CreateStaticByteBuffer;
+
+constexpr hci::ConnectionHandle kConnectionHandle = 0x0001;
+constexpr ChannelId kChannelId = 0x0040;
+
+// Returns a B-frame carrying |payload| in ACL data fragments of at most
+// |max_fragment_size| bytes.
+PDU MakePdu(const common::ByteBuffer& payload,
+            uint16_t max_fragment_size = hci::kMaxACLPayloadSize) {
+  return Fragmenter(kConnectionHandle, max_fragment_size)
+      .BuildBasicFrame(kChannelId, payload);
+}
+
+// Returns the views that |sdu| passes to ForEachFragment(), as strings.
+std::vector<std::string> Fragments(const SDU& sdu) {
+  std::vector<std::string> fragments;
+  sdu.ForEachFragment([&fragments](const common::ByteBuffer& data) {
+    fragments.push_back(data.ToString());
+  });
+  return fragments;
+}
+
+TEST(L2CAP_SduTest, DefaultIsInvalid) {
+  SDU sdu;
+  EXPECT_FALSE(sdu.is_valid());
+  EXPECT_EQ(0u, sdu.length());
+  EXPECT_EQ(0u, sdu.segment_count());
+}
+
+TEST(L2CAP_SduTest, EmptyPdu) {
+  SDU sdu(MakePdu(common::BufferView()));
+  EXPECT_TRUE(sdu.is_valid());
+  EXPECT_EQ(0u, sdu.length());
+  EXPECT_EQ(1u, sdu.segment_count());
+  EXPECT_TRUE(Fragments(sdu).empty());
+  EXPECT_FALSE(SDU::Reader(&sdu).ReadNext(1, [](const auto&) {}));
+}
+
+TEST(L2CAP_SduTest, Move) {
+  SDU sdu(MakePdu(CreateStaticByteBuffer('T', 'e', 's', 't')));
+  EXPECT_EQ(4u, sdu.length());
+
+  SDU move_cted(std::move(sdu));
+  EXPECT_FALSE(sdu.is_valid());
+  EXPECT_EQ(0u, sdu.length());
+  EXPECT_TRUE(move_cted.is_valid());
+  EXPECT_EQ(4u, move_cted.length());
+
+  SDU move_assigned;
+  move_assigned = std::move(move_cted);
+  EXPECT_FALSE(move_cted.is_valid());
+  EXPECT_TRUE(move_assigned.is_valid());
+  EXPECT_EQ(4u, move_assigned.length());
+}
+
+TEST(L2CAP_SduTest, FragmentsOfPdu) {
+  // The first ACL data fragment holds the Basic L2CAP header and 'T', 'e'. The
+  // rest hold up to 6 bytes each.
+  const auto payload =
+      CreateStaticByteBuffer('T', 'e', 's', 't', ' ', 'f', 'r', 'a', 'g');
+  SDU sdu(MakePdu(payload, 6));
+  EXPECT_EQ(payload.size(), sdu.length());
+  EXPECT_EQ(1u, sdu.segment_count());
+
+  const std::vector<std::string> expected = {"Te", "st fra", "g"};
+  EXPECT_EQ(expected, Fragments(sdu));
+
+  common::DynamicByteBuffer copy(sdu.length());
+  EXPECT_EQ(payload.size(), sdu.Copy(&copy));
+  EXPECT_TRUE(common::ContainersEqual(payload, copy));
+
+  common::StaticByteBuffer<4> partial;
+  EXPECT_EQ(4u, sdu.Copy(&partial, 3, 4));
+  EXPECT_EQ("t fr", partial.ToString());
+}
+
+TEST(L2CAP_SduTest, AppendSegments) {
+  SDU sdu;
+  sdu.Append(MakePdu(CreateStaticByteBuffer(0x07, 0x00, 'S', 'e', 'g')), 2);
+  sdu.Append(MakePdu(CreateStaticByteBuffer('m', 'e', 'n', 't', 's'), 6));
+  EXPECT_TRUE(sdu.is_valid());
+  EXPECT_EQ(8u, sdu.length());
+  EXPECT_EQ(2u, sdu.segment_count());
+
+  const std::vector<std::string> expected = {"Seg", "me", "nts"};
+  EXPECT_EQ(expected, Fragments(sdu));
+
+  common::StaticByteBuffer<8> copy;
+  EXPECT_EQ(8u, sdu.Copy(&copy));
+  EXPECT_EQ("Segments", copy.ToString());
+
+  common::StaticByteBuffer<3> partial;
+  EXPECT_EQ(3u, sdu.Copy(&partial, 2, 3));
+  EXPECT_EQ("gme", partial.ToString());
+}
+
+TEST(L2CAP_SduTest, ReaderViewsAndCopies) {
+  SDU sdu;
+  sdu.Append(MakePdu(CreateStaticByteBuffer('a', 'b', 'c')));
+  sdu.Append(MakePdu(CreateStaticByteBuffer('d', 'e', 'f', 'g')));
+
+  // Reads within a fragment are views into it, while reads that cross
+  // fragments are copied.
+  const uint8_t* first_fragment = nullptr;
+  sdu.ForEachFragment([&first_fragment](const common::ByteBuffer& data) {
+    if (!first_fragment)
+      first_fragment = data.data();
+  });
+
+  SDU::Reader reader(&sdu);
+  EXPECT_TRUE(reader.ReadNext(2, [first_fragment](const auto& data) {
+    EXPECT_EQ("ab", data.ToString());
+    EXPECT_EQ(first_fragment, data.data());
+  }));
+  EXPECT_TRUE(reader.ReadNext(3, [first_fragment](const auto& data) {
+    EXPECT_EQ("cde", data.ToString());
+    EXPECT_NE(first_fragment + 2, data.data());
+  }));
+  EXPECT_FALSE(reader.ReadNext(3, [](const auto&) { ADD_FAILURE(); }));
+  EXPECT_TRUE(reader.ReadNext(2, [](const auto& data) {
+    EXPECT_EQ("fg", data.ToString());
+  }));
+  EXPECT_FALSE(reader.ReadNext(1, [](const auto&) { ADD_FAILURE(); }));
+}
+
+TEST(L2CAP_SduTest, ReaderLargeReadAcrossFragments) {
+  // Larger than what is copied onto the stack.
+  common::DynamicByteBuffer payload(4000);
+  for (size_t i = 0; i < payload.size(); i++) {
+    payload[i] = static_cast<uint8_t>(i);
+  }
+  SDU sdu(MakePdu(payload, 251));
+
+  bool read = false;
+  EXPECT_TRUE(SDU::Reader(&sdu).ReadNext(
+      sdu.length(), [&payload, &read](const common::ByteBuffer& data) {
+        EXPECT_TRUE(common::ContainersEqual(payload, data));
+        read = true;
+      }));
+  EXPECT_TRUE(read);
+}
+
+// Reads an SDU of many multi-fragment segments in pieces that straddle both
+// fragment and segment boundaries.
+TEST(L2CAP_SduTest, ReaderSmallReadsAcrossSegments) {
+  constexpr size_t kSegmentCount = 50;
+  constexpr size_t kSegmentSize = 10;
+  common::DynamicByteBuffer payload(kSegmentCount * kSegmentSize);
+  for (size_t i = 0; i < payload.size(); i++) {
+    payload[i] = static_cast<uint8_t>(i);
+  }
+
+  SDU sdu;
+  for (size_t i = 0; i < kSegmentCount; i++) {
+    sdu.Append(MakePdu(payload.view(i * kSegmentSize, kSegmentSize), 6));
+  }
+  ASSERT_EQ(kSegmentCount, sdu.segment_count());
+
+  for (size_t read_size : {1u, 3u, 7u, 25u}) {
+    SDU::Reader reader(&sdu);
+    common::DynamicByteBuffer read(payload.size());
+    size_t offset = 0u;
+    while (offset + read_size <= payload.size()) {
+      EXPECT_TRUE(reader.ReadNext(
+          read_size, [&read, &offset](const common::ByteBuffer& data) {
+            read.Write(data, offset);
+            offset += data.size();
+          }));
+    }
+    EXPECT_FALSE(reader.ReadNext(read_size, [](const auto&) { ADD_FAILURE(); }))
+        << "read size: " << read_size;
+    EXPECT_TRUE(common::ContainersEqual(payload.view(0, offset),
+                                        read.view(0, offset)))
+        << "read size: " << read_size;
+  }
+}
+
+}  // namespace
+}  // namespace l2cap
+}  // namespace btlib
@@ -47,6 +47,25 @@ SignalingChannel::~SignalingChannel() {
   ZX_DEBUG_ASSERT(IsCreationThreadCurrent());
 }
 
+bool SignalingChannel::SendRequest(CommandCode req_code,
+                                   const common::ByteBuffer& payload,
+                                   ResponseHandler cb) {
+  ZX_DEBUG_ASSERT(cb);
+  const CommandId id = EnqueueResponse(req_code + 1, std::move(cb));
+  if (id == kInvalidCommandId) {
+    return false;
+  }
+
+  return SendPacket(req_code, id, payload);
+}
+
+void SignalingChannel::ServeRequest(CommandCode req_code,
+                                    RequestDelegate cb) {
+  ZX_DEBUG_ASSERT(!IsSupportedResponse(req_code));
+  ZX_DEBUG_ASSERT(cb);
+  inbound_handlers_[req_code] = std::move(cb);
+}
+
 SignalingChannel::ResponderImpl::ResponderImpl(SignalingChannel* sig,
                                                CommandCode code, CommandId id)
     : sig_(sig), code_(code), id_(id) {
@@ -142,6 +161,86 @@ CommandId SignalingChannel::GetNextCommandId() {
   return cmd;
 }
 
+bool SignalingChannel::HandleRequestOrResponse(const SignalingPacket& packet) {
+  if (IsSupportedResponse(packet.header().code)) {
+    OnRxResponse(packet);
+    return true;
+  }
+
+  // Handle request commands from remote.
+  const auto iter = inbound_handlers_.find(packet.header().code);
+  if (iter != inbound_handlers_.end()) {
+    ResponderImpl responder(this, packet.header().code + 1, packet.header().id);
+    iter->second(packet.payload_data(), &responder);
+    return true;
+  }
+
+  return false;
+}
+
+CommandId SignalingChannel::EnqueueResponse(CommandCode expected_code,
+                                            ResponseHandler cb) {
+  ZX_DEBUG_ASSERT(IsSupportedResponse(expected_code));
+
+  // Command identifiers for pending requests are assumed to be unique across
+  // all types of requests and reused by order of least recent use. See v5.0
+  // Vol 3, Part A Section 4.
+  //
+  // Uniqueness across different command types: "Within each signaling channel a
+  // different Identifier shall be used for each successive command"
+  // Reuse order: "the Identifier may be recycled if all other Identifiers have
+  // subsequently been used"
+  const CommandId initial_id = GetNextCommandId();
+  CommandId id;
+  for (id = initial_id; IsCommandPending(id);) {
+    id = GetNextCommandId();
+
+    if (id == initial_id) {
+      bt_log(ERROR, "l2cap",
+             "sig: all valid command IDs in use for "
+             "pending requests; can't queue expected response command %#.2x",
+             expected_code);
+      return kInvalidCommandId;
+    }
+  }
+
+  pending_commands_[id] = std::make_pair(expected_code, std::move(cb));
+  return id;
+}
+
+bool SignalingChannel::IsCommandPending(CommandId id) const {
+  return pending_commands_.find(id) != pending_commands_.end();
+}
+
+void SignalingChannel::OnRxResponse(const SignalingPacket& packet) {
+  auto iter = pending_commands_.find(packet.header().id);
+  if (iter == pending_commands_.end()) {
+    bt_log(SPEW, "l2cap", "sig: ignoring unexpected response, id %#.2x",
+           packet.header().id);
+    SendCommandReject(packet.header().id, RejectReason::kNotUnderstood,
+                      common::BufferView());
+    return;
+  }
+
+  Status status;
+  if (packet.header().code == iter->second.first) {
+    status = Status::kSuccess;
+  } else if (packet.header().code == kCommandRejectCode) {
+    status = Status::kReject;
+  } else {
+    bt_log(ERROR, "l2cap", "sig: response (id %#.2x) has unexpected code %#.2x",
+           packet.header().id, packet.header().code);
+    SendCommandReject(packet.header().id, RejectReason::kNotUnderstood,
+                      common::BufferView());
+    return;
+  }
+
+  ResponseHandler& handler = iter->second.second;
+  if (!handler(status, packet.payload_data())) {
+    pending_commands_.erase(iter);
+  }
+}
+
 void SignalingChannel::OnChannelClosed() {
   ZX_DEBUG_ASSERT(IsCreationThreadCurrent());
   ZX_DEBUG_ASSERT(is_open());
@@ -6,6 +6,7 @@
 #define GARNET_DRIVERS_BLUETOOTH_LIB_L2CAP_SIGNALING_CHANNEL_H_
 
 #include <memory>
+#include <unordered_map>
 
 #include "garnet/drivers/bluetooth/lib/common/byte_buffer.h"
 #include "garnet/drivers/bluetooth/lib/common/packet_view.h"
@@ -106,6 +107,11 @@ class SignalingChannel : public SignalingChannelInterface {
   uint16_t mtu() const { return mtu_; }
   void set_mtu(uint16_t mtu) { mtu_ = mtu; }
 
+  // SignalingChannelInterface overrides
+  bool SendRequest(CommandCode req_code, const common::ByteBuffer& payload,
+                   ResponseHandler cb) override;
+  void ServeRequest(CommandCode req_code, RequestDelegate cb) override;
+
  protected:
   // Implementation for responding to a request that binds the request's
   // identifier and the response's code so that the client's |Send| invocation
@@ -145,6 +151,15 @@ class SignalingChannel : public SignalingChannelInterface {
   // while this is running. SendPacket() can be called safely from this method.
   virtual bool HandlePacket(const SignalingPacket& packet) = 0;
 
+  // True if the code is for a response-type signaling command that is
+  // supported on this kind of link.
+  virtual bool IsSupportedResponse(CommandCode code) const = 0;
+
+  // Routes |packet| to the handler of the pending request that it responds to,
+  // or to the delegate registered for its code with ServeRequest(). Returns
+  // false if it is neither a supported response nor a served request.
+  bool HandleRequestOrResponse(const SignalingPacket& packet);
+
   // Sends out a command reject packet with the given parameters.
   bool SendCommandReject(uint8_t identifier, RejectReason reason,
                          const common::ByteBuffer& data);
@@ -179,6 +194,26 @@ class SignalingChannel : public SignalingChannelInterface {
   common::ByteBufferPtr BuildPacket(CommandCode code, uint8_t identifier,
                                     const common::ByteBuffer& data);
 
+  // Register a callback that will be invoked when a response-type command
+  // packet (specified by |expected_code|) is received. Returns the identifier
+  // to be included in the header of the outgoing request packet (or
+  // kInvalidCommandId if all valid command identifiers are pending responses).
+  // If the signaling channel receives a Command Reject that matches the same
+  // identifier, the rejection packet will be forwarded to the callback instead.
+  // |handler| will be run on the L2CAP thread.
+  //
+  // TODO(xow): Add function to cancel a queued response.
+  CommandId EnqueueResponse(CommandCode expected_code, ResponseHandler cb);
+
+  // True if an outbound request-type command has registered a callback for its
+  // response matching a particular |id|.
+  bool IsCommandPending(CommandId id) const;
+
+  // Called when a response-type command packet is received. Sends a Command
+  // Reject if no ResponseHandler was registered for inbound packet's command
+  // code and identifier.
+  void OnRxResponse(const SignalingPacket& packet);
+
   // Channel callbacks:
   void OnChannelClosed();
   void OnRxBFrame(const SDU& sdu);
@@ -197,6 +232,13 @@ class SignalingChannel : public SignalingChannelInterface {
   uint16_t mtu_;
   uint8_t next_cmd_id_;
 
+  // Stores response handlers for requests that have been sent.
+  std::unordered_map<CommandId, std::pair<CommandCode, ResponseHandler>>
+      pending_commands_;
+
+  // Stores handlers for incoming request packets.
+  std::unordered_map<CommandCode, RequestDelegate> inbound_handlers_;
+
   fxl::WeakPtrFactory<SignalingChannel> weak_ptr_factory_;
 
   FXL_DISALLOW_COPY_AND_ASSIGN(SignalingChannel);
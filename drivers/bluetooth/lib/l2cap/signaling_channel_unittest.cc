@@ -40,13 +40,6 @@ class TestSignalingChannel : public SignalingChannel {
   using SignalingChannel::ResponderImpl;
 
  private:
-  // SignalingChannelInterface overrides
-  bool SendRequest(CommandCode req_code, const common::ByteBuffer& payload,
-                   ResponseHandler cb) override {
-    return false;
-  }
-  void ServeRequest(CommandCode req_code, RequestDelegate cb) override {}
-
   // SignalingChannel overrides
   void DecodeRxUnit(const SDU& sdu, const SignalingPacketHandler& cb) override {
     SDU::Reader sdu_reader(&sdu);
@@ -66,6 +59,8 @@ class TestSignalingChannel : public SignalingChannel {
     return true;
   }
 
+  bool IsSupportedResponse(CommandCode code) const override { return false; }
+
   PacketCallback packet_cb_;
 
   FXL_DISALLOW_COPY_AND_ASSIGN(TestSignalingChannel);
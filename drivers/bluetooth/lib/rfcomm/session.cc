@@ -234,7 +234,7 @@ void Session::OpenRemoteChannel(ServerChannel server_channel,
 }
 
 void Session::RxCallback(const l2cap::SDU& sdu) {
-  l2cap::PDU::Reader reader(&sdu);
+  l2cap::SDU::Reader reader(&sdu);
   reader.ReadNext(sdu.length(), [&](const common::ByteBuffer& buffer) {
     auto frame = Frame::Parse(credit_based_flow_, OppositeRole(role_), buffer);
     if (!frame) {
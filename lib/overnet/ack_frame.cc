@@ -8,19 +8,29 @@
 
 namespace overnet {
 
+// Each nack range is encoded relative to the low end of the previous range
+// (or ack_to_seq for the first range) as varint(offset << 1 | has_run),
+// followed by varint(high - low) if has_run is set. Runs of consecutive nacks
+// therefore cost the same as a single nack.
+
 AckFrame::Writer::Writer(const AckFrame* ack_frame)
     : ack_frame_(ack_frame),
       ack_to_seq_length_(varint::WireSizeFor(ack_frame_->ack_to_seq_)),
       ack_delay_us_length_(varint::WireSizeFor(ack_frame_->ack_delay_us_)) {
   wire_length_ = ack_to_seq_length_ + ack_delay_us_length_;
-  nack_length_.reserve(ack_frame_->nack_seqs_.size());
+  nack_length_.reserve(2 * ack_frame_->nack_ranges_.size());
   uint64_t base = ack_frame_->ack_to_seq_;
-  for (auto n : ack_frame_->nack_seqs_) {
-    auto enc = base - n;
-    auto l = varint::WireSizeFor(enc);
+  for (const auto& r : ack_frame_->nack_ranges_) {
+    const uint64_t run = r.high - r.low;
+    auto l = varint::WireSizeFor(((base - r.high) << 1) | (run != 0));
     wire_length_ += l;
     nack_length_.push_back(l);
-    base = n;
+    if (run != 0) {
+      l = varint::WireSizeFor(run);
+      wire_length_ += l;
+      nack_length_.push_back(l);
+    }
+    base = r.low;
   }
 }
 
@@ -29,11 +39,14 @@ uint8_t* AckFrame::Writer::Write(uint8_t* out) const {
   p = varint::Write(ack_frame_->ack_to_seq_, ack_to_seq_length_, p);
   p = varint::Write(ack_frame_->ack_delay_us_, ack_delay_us_length_, p);
   uint64_t base = ack_frame_->ack_to_seq_;
-  for (size_t i = 0; i < nack_length_.size(); i++) {
-    auto n = ack_frame_->nack_seqs_[i];
-    auto enc = base - n;
-    p = varint::Write(enc, nack_length_[i], p);
-    base = n;
+  auto length = nack_length_.begin();
+  for (const auto& r : ack_frame_->nack_ranges_) {
+    const uint64_t run = r.high - r.low;
+    p = varint::Write(((base - r.high) << 1) | (run != 0), *length++, p);
+    if (run != 0) {
+      p = varint::Write(run, *length++, p);
+    }
+    base = r.low;
   }
   assert(p == out + wire_length_);
   return p;
@@ -59,18 +72,33 @@ StatusOr<AckFrame> AckFrame::Parse(Slice slice) {
   AckFrame frame(ack_to_seq, ack_delay_us);
   uint64_t base = ack_to_seq;
   while (bytes != end) {
-    uint64_t offset;
-    if (!varint::Read(&bytes, end, &offset)) {
+    uint64_t header;
+    if (!varint::Read(&bytes, end, &header)) {
       return StatusOr<AckFrame>(StatusCode::INVALID_ARGUMENT,
                                 "Failed to read nack offset from ack frame");
     }
-    if (offset >= base) {
+    const uint64_t offset = header >> 1;
+    // Only the first range may start at base (ack_to_seq itself may be
+    // nacked); subsequent ranges must leave a gap after the previous one.
+    if (offset >= base || (offset < 2 && !frame.nack_ranges_.empty())) {
       return StatusOr<AckFrame>(StatusCode::INVALID_ARGUMENT,
                                 "Failed to read nack");
     }
-    const uint64_t seq = base - offset;
-    frame.AddNack(seq);
-    base = seq;
+    const uint64_t high = base - offset;
+    uint64_t run = 0;
+    if (header & 1) {
+      if (!varint::Read(&bytes, end, &run)) {
+        return StatusOr<AckFrame>(StatusCode::INVALID_ARGUMENT,
+                                  "Failed to read nack run from ack frame");
+      }
+      if (run == 0 || run >= high) {
+        return StatusOr<AckFrame>(StatusCode::INVALID_ARGUMENT,
+                                  "Failed to read nack run");
+      }
+    }
+    const uint64_t low = high - run;
+    frame.nack_ranges_.push_back(NackRange{high, low});
+    base = low;
   }
   return StatusOr<AckFrame>(std::move(frame));
 }
@@ -78,8 +106,12 @@ StatusOr<AckFrame> AckFrame::Parse(Slice slice) {
 std::ostream& operator<<(std::ostream& out, const AckFrame& ack_frame) {
   out << "ACK{to:" << ack_frame.ack_to_seq()
       << ", delay:" << ack_frame.ack_delay_us() << "us, nack=[";
-  for (auto n : ack_frame.nack_seqs()) {
-    out << n << ",";
+  for (const auto& r : ack_frame.nack_ranges()) {
+    if (r.high == r.low) {
+      out << r.high << ",";
+    } else {
+      out << r.high << "-" << r.low << ",";
+    }
   }
   return out << "]}";
 }
@@ -14,6 +14,18 @@ namespace overnet {
 
 class AckFrame {
  public:
+  // An inclusive run of nacked sequence numbers: [low, high].
+  struct NackRange {
+    uint64_t high;
+    uint64_t low;
+
+    uint64_t size() const { return high - low + 1; }
+
+    friend bool operator==(const NackRange& a, const NackRange& b) {
+      return a.high == b.high && a.low == b.low;
+    }
+  };
+
   class Writer {
    public:
     explicit Writer(const AckFrame* ack_frame);
@@ -48,34 +60,43 @@ class AckFrame {
   AckFrame(AckFrame&& other)
       : ack_to_seq_(other.ack_to_seq_),
         ack_delay_us_(other.ack_delay_us_),
-        nack_seqs_(std::move(other.nack_seqs_)) {}
+        nack_ranges_(std::move(other.nack_ranges_)) {}
 
   AckFrame& operator=(AckFrame&& other) {
     ack_to_seq_ = other.ack_to_seq_;
     ack_delay_us_ = other.ack_delay_us_;
-    nack_seqs_ = std::move(other.nack_seqs_);
+    nack_ranges_ = std::move(other.nack_ranges_);
     return *this;
   }
 
-  void AddNack(uint64_t seq) {
+  // Nacks must be added in descending order.
+  void AddNack(uint64_t seq) { AddNackRange(seq, seq); }
+
+  void AddNackRange(uint64_t high, uint64_t low) {
     assert(ack_to_seq_ > 0);
-    assert(seq <= ack_to_seq_);
-    if (!nack_seqs_.empty()) {
-      assert(seq < nack_seqs_.back());
+    assert(low > 0);
+    assert(low <= high);
+    assert(high <= ack_to_seq_);
+    if (!nack_ranges_.empty()) {
+      assert(high < nack_ranges_.back().low);
+      if (high + 1 == nack_ranges_.back().low) {
+        nack_ranges_.back().low = low;
+        return;
+      }
     }
-    nack_seqs_.push_back(seq);
+    nack_ranges_.push_back(NackRange{high, low});
   }
 
   static StatusOr<AckFrame> Parse(Slice slice);
 
   friend bool operator==(const AckFrame& a, const AckFrame& b) {
-    return std::tie(a.ack_to_seq_, a.ack_delay_us_, a.nack_seqs_) ==
-           std::tie(b.ack_to_seq_, b.ack_delay_us_, b.nack_seqs_);
+    return std::tie(a.ack_to_seq_, a.ack_delay_us_, a.nack_ranges_) ==
+           std::tie(b.ack_to_seq_, b.ack_delay_us_, b.nack_ranges_);
   }
 
   uint64_t ack_to_seq() const { return ack_to_seq_; }
   uint64_t ack_delay_us() const { return ack_delay_us_; }
-  const std::vector<uint64_t>& nack_seqs() const { return nack_seqs_; }
+  const std::vector<NackRange>& nack_ranges() const { return nack_ranges_; }
 
  private:
   // All messages with sequence number prior to ack_to_seq_ are implicitly
@@ -84,10 +105,11 @@ class AckFrame {
   // How long between receiving ack_delay_seq_ and generating this data
   // structure.
   uint64_t ack_delay_us_;
-  // All messages contained in nack_seqs_ need to be resent.
-  // NOTE: it's assumed that nack_seqs_ is in-order and all value are greater
-  // than or equal to ack_to_seq_.
-  std::vector<uint64_t> nack_seqs_;
+  // All messages contained in nack_ranges_ need to be resent.
+  // NOTE: it's assumed that nack_ranges_ is in descending order, that ranges
+  // are disjoint and non-adjacent, and that all values are less than or equal
+  // to ack_to_seq_.
+  std::vector<NackRange> nack_ranges_;
 };
 
 std::ostream& operator<<(std::ostream& out, const AckFrame& ack_frame);
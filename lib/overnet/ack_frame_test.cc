@@ -33,7 +33,7 @@ TEST(AckFrame, NoNack) {
 TEST(AckFrame, OneNack) {
   AckFrame h(5, 10);
   h.AddNack(2);
-  RoundTrip(h, {5, 10, 3});
+  RoundTrip(h, {5, 10, 6});
 }
 
 TEST(AckFrame, ThreeNacks) {
@@ -41,7 +41,41 @@ TEST(AckFrame, ThreeNacks) {
   h.AddNack(4);
   h.AddNack(3);
   h.AddNack(2);
-  RoundTrip(h, {5, 42, 1, 1, 1});
+  EXPECT_EQ(1u, h.nack_ranges().size());
+  RoundTrip(h, {5, 42, 3, 2});
+}
+
+TEST(AckFrame, NackRanges) {
+  AckFrame h(20, 1);
+  h.AddNack(19);
+  h.AddNack(18);
+  h.AddNack(15);
+  h.AddNackRange(10, 8);
+  EXPECT_EQ(3u, h.nack_ranges().size());
+  RoundTrip(h, {20, 1, 3, 1, 6, 11, 2});
+}
+
+TEST(AckFrame, NackAckToSeq) {
+  AckFrame h(3, 0, {3, 2, 1});
+  RoundTrip(h, {3, 0, 1, 2});
+}
+
+void ExpectParseFailure(const std::vector<uint8_t>& bytes) {
+  auto p = AckFrame::Parse(Slice::FromCopiedBuffer(bytes.data(), bytes.size()));
+  EXPECT_TRUE(p.is_error());
+}
+
+TEST(AckFrame, RejectsBadNacks) {
+  // Nack of sequence zero.
+  ExpectParseFailure({5, 0, 10});
+  // Run extending to sequence zero.
+  ExpectParseFailure({5, 0, 3, 4});
+  // Zero length run.
+  ExpectParseFailure({5, 0, 3, 0});
+  // Second range adjacent to the first.
+  ExpectParseFailure({5, 0, 2, 2});
+  // Truncated run.
+  ExpectParseFailure({5, 0, 3});
 }
 
 }  // namespace ack_frame_test
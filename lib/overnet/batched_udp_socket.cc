@@ -0,0 +1,224 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "batched_udp_socket.h"
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <algorithm>
+#include <sstream>
+
+namespace overnet {
+
+std::ostream& operator<<(std::ostream& out, UdpAddr addr) {
+  char dst[512];
+  switch (addr.addr.sa_family) {
+    case AF_INET:
+      inet_ntop(AF_INET, &addr.ipv4.sin_addr, dst, sizeof(dst));
+      return out << dst << ":" << ntohs(addr.ipv4.sin_port);
+    case AF_INET6:
+      inet_ntop(AF_INET6, &addr.ipv6.sin6_addr, dst, sizeof(dst));
+      return out << dst << ":" << ntohs(addr.ipv6.sin6_port);
+    default:
+      return out << "<<unknown address family " << addr.addr.sa_family << ">>";
+  }
+}
+
+static Status StatusFromErrno(const std::string& why) {
+  int err = errno;
+  std::ostringstream msg;
+  msg << why << ", errno=" << err;
+  return Status(StatusCode::UNKNOWN, msg.str());
+}
+
+static bool WouldBlock(int err) { return err == EAGAIN || err == EWOULDBLOCK; }
+
+// The socket is ipv6 only: ipv4 destinations become ipv4-mapped addresses.
+static UdpAddr ToIpv6(UdpAddr addr) {
+  if (addr.addr.sa_family != AF_INET) {
+    return addr;
+  }
+  UdpAddr addr6;
+  memset(&addr6, 0, sizeof(addr6));
+  addr6.ipv6.sin6_family = AF_INET6;
+  addr6.ipv6.sin6_port = addr.ipv4.sin_port;
+  uint8_t* addr6_addr_bytes = reinterpret_cast<uint8_t*>(&addr6.ipv6.sin6_addr);
+  addr6_addr_bytes[10] = 0xff;
+  addr6_addr_bytes[11] = 0xff;
+  memcpy(addr6_addr_bytes + 12, &addr.ipv4.sin_addr, 4);
+  return addr6;
+}
+
+BatchedUdpSocket::~BatchedUdpSocket() {
+  if (fd_ != -1) {
+    close(fd_);
+  }
+}
+
+Status BatchedUdpSocket::Open(uint16_t port) {
+  assert(fd_ == -1);
+  fd_ = socket(AF_INET6, SOCK_DGRAM, 0);
+  if (fd_ == -1) {
+    return StatusFromErrno("Failed to create socket");
+  }
+  int flags = fcntl(fd_, F_GETFL, 0);
+  if (flags == -1 || fcntl(fd_, F_SETFL, flags | O_NONBLOCK) == -1) {
+    return StatusFromErrno("Failed to make socket non-blocking");
+  }
+  int one = 1;
+  if (setsockopt(fd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) < 0) {
+    return StatusFromErrno("Failed to set socket option SO_REUSEADDR");
+  }
+  // Leave room for whole bursts in the kernel. This is best effort: kernels
+  // clamp these to their configured maximums, and may not support them at all.
+  int buffer_size = kSocketBufferSize;
+  setsockopt(fd_, SOL_SOCKET, SO_RCVBUF, &buffer_size, sizeof(buffer_size));
+  setsockopt(fd_, SOL_SOCKET, SO_SNDBUF, &buffer_size, sizeof(buffer_size));
+
+  sockaddr_in6 addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin6_family = AF_INET6;
+  addr.sin6_addr = in6addr_any;
+  addr.sin6_port = htons(port);
+  if (bind(fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+    return StatusFromErrno("Failed to bind() to in6addr_any");
+  }
+  socklen_t len = sizeof(addr);
+  if (getsockname(fd_, reinterpret_cast<sockaddr*>(&addr), &len) < 0) {
+    return StatusFromErrno("Failed to getsockname() for new socket");
+  }
+  port_ = ntohs(addr.sin6_port);
+  return Status::Ok();
+}
+
+Status BatchedUdpSocket::SendTo(UdpAddr dest, const Slice* slices,
+                                size_t count) {
+  dest = ToIpv6(dest);
+  size_t sent = 0;
+  while (sent != count) {
+#ifdef __linux__
+    if (count - sent > 1) {
+      const size_t batch = std::min(count - sent, kMaxBatch);
+      mmsghdr msgs[kMaxBatch];
+      iovec iovs[kMaxBatch];
+      memset(msgs, 0, sizeof(mmsghdr) * batch);
+      for (size_t i = 0; i < batch; i++) {
+        const Slice& slice = slices[sent + i];
+        iovs[i].iov_base = const_cast<uint8_t*>(slice.begin());
+        iovs[i].iov_len = slice.length();
+        msgs[i].msg_hdr.msg_name = &dest.addr;
+        msgs[i].msg_hdr.msg_namelen = sizeof(dest.ipv6);
+        msgs[i].msg_hdr.msg_iov = &iovs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+      }
+      stats_.send_calls++;
+      int r = sendmmsg(fd_, msgs, batch, 0);
+      if (r <= 0) {
+        if (r < 0 && WouldBlock(errno)) {
+          return Status::Ok();
+        }
+        return StatusFromErrno("sendmmsg failed");
+      }
+      for (int i = 0; i < r; i++) {
+        stats_.bytes_sent += msgs[i].msg_len;
+      }
+      stats_.datagrams_sent += r;
+      sent += r;
+      continue;
+    }
+#endif
+    const Slice& slice = slices[sent];
+    stats_.send_calls++;
+    ssize_t r = sendto(fd_, slice.begin(), slice.length(), 0, &dest.addr,
+                       sizeof(dest.ipv6));
+    if (r < 0) {
+      if (WouldBlock(errno)) {
+        return Status::Ok();
+      }
+      return StatusFromErrno("sendto failed");
+    }
+    stats_.bytes_sent += r;
+    stats_.datagrams_sent++;
+    sent++;
+  }
+  return Status::Ok();
+}
+
+StatusOr<size_t> BatchedUdpSocket::ReceiveBatch(uint32_t mss,
+                                                std::vector<Slice>* buffers,
+                                                std::vector<UdpAddr>* sources) {
+  auto new_buffer = [mss] {
+    return Slice::WithInitializer(mss, [](uint8_t*) {});
+  };
+#ifdef __linux__
+  // Buffers that weren't filled last time are kept for the next call.
+  if (spare_mss_ != mss) {
+    spare_buffers_.clear();
+    spare_mss_ = mss;
+  }
+  while (spare_buffers_.size() < kMaxBatch) {
+    spare_buffers_.emplace_back(new_buffer());
+  }
+  UdpAddr source_addrs[kMaxBatch];
+  mmsghdr msgs[kMaxBatch];
+  iovec iovs[kMaxBatch];
+  memset(msgs, 0, sizeof(msgs));
+  for (size_t i = 0; i < kMaxBatch; i++) {
+    iovs[i].iov_base = const_cast<uint8_t*>(spare_buffers_[i].begin());
+    iovs[i].iov_len = mss;
+    msgs[i].msg_hdr.msg_name = &source_addrs[i].addr;
+    msgs[i].msg_hdr.msg_namelen = sizeof(UdpAddr);
+    msgs[i].msg_hdr.msg_iov = &iovs[i];
+    msgs[i].msg_hdr.msg_iovlen = 1;
+  }
+  stats_.receive_calls++;
+  int r = recvmmsg(fd_, msgs, kMaxBatch, MSG_DONTWAIT, nullptr);
+  if (r < 0) {
+    if (WouldBlock(errno)) {
+      return size_t(0);
+    }
+    return StatusFromErrno("recvmmsg failed");
+  }
+  const size_t received = r;
+  for (size_t i = 0; i < received; i++) {
+    Slice& buffer = spare_buffers_[i];
+    buffer.TrimEnd(buffer.length() - msgs[i].msg_len);
+    stats_.bytes_received += msgs[i].msg_len;
+    buffers->emplace_back(std::move(buffer));
+    sources->emplace_back(source_addrs[i]);
+  }
+  spare_buffers_.erase(spare_buffers_.begin(),
+                       spare_buffers_.begin() + received);
+#else
+  size_t received = 0;
+  while (received < kMaxBatch) {
+    Slice buffer = new_buffer();
+    UdpAddr source;
+    socklen_t source_length = sizeof(source);
+    stats_.receive_calls++;
+    ssize_t r = recvfrom(fd_, const_cast<uint8_t*>(buffer.begin()), mss,
+                         MSG_DONTWAIT, &source.addr, &source_length);
+    if (r < 0) {
+      if (WouldBlock(errno)) {
+        break;
+      }
+      if (received == 0) {
+        return StatusFromErrno("recvfrom failed");
+      }
+      break;
+    }
+    buffer.TrimEnd(buffer.length() - r);
+    stats_.bytes_received += r;
+    buffers->emplace_back(std::move(buffer));
+    sources->emplace_back(source);
+    received++;
+  }
+#endif
+  stats_.datagrams_received += received;
+  return received;
+}
+
+}  // namespace overnet
@@ -0,0 +1,134 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <iostream>
+#include <vector>
+#include "slice.h"
+#include "status.h"
+
+namespace overnet {
+
+union UdpAddr {
+  sockaddr_in ipv4;
+  sockaddr_in6 ipv6;
+  sockaddr addr;
+};
+
+std::ostream& operator<<(std::ostream& out, UdpAddr addr);
+
+class HashUdpAddr {
+ public:
+  size_t operator()(const UdpAddr& addr) const {
+    size_t out = 0;
+    auto add_value = [&out](auto x) {
+      const char* p = reinterpret_cast<const char*>(&x);
+      const char* end = reinterpret_cast<const char*>(1 + &x);
+      while (p != end) {
+        out = 257 * out + *p++;
+      }
+    };
+    switch (addr.addr.sa_family) {
+      case AF_INET:
+        add_value(addr.ipv4.sin_addr);
+        add_value(addr.ipv4.sin_port);
+        break;
+      case AF_INET6:
+        add_value(addr.ipv6.sin6_addr);
+        add_value(addr.ipv6.sin6_port);
+        break;
+    }
+    return out;
+  }
+};
+
+class EqUdpAddr {
+ public:
+  bool operator()(const UdpAddr& a, const UdpAddr& b) const {
+    if (a.addr.sa_family == b.addr.sa_family) {
+      switch (a.addr.sa_family) {
+        case AF_INET:
+          return a.ipv4.sin_port == b.ipv4.sin_port &&
+                 0 == memcmp(&a.ipv4.sin_addr, &b.ipv4.sin_addr,
+                             sizeof(a.ipv4.sin_addr));
+        case AF_INET6:
+          return a.ipv6.sin6_port == b.ipv6.sin6_port &&
+                 0 == memcmp(&a.ipv6.sin6_addr, &b.ipv6.sin6_addr,
+                             sizeof(a.ipv6.sin6_addr));
+      }
+    }
+    return false;
+  }
+};
+
+// A non-blocking ipv6 UDP socket that sends and receives datagrams in
+// batches: with sendmmsg/recvmmsg where they're available (Linux), and one
+// datagram per call otherwise.
+class BatchedUdpSocket {
+ public:
+  // Most datagrams passed to the kernel in one call.
+  static constexpr size_t kMaxBatch = 64;
+  // Requested kernel send and receive buffer sizes.
+  static constexpr int kSocketBufferSize = 1024 * 1024;
+
+  struct Stats {
+    uint64_t send_calls = 0;
+    uint64_t datagrams_sent = 0;
+    uint64_t bytes_sent = 0;
+    uint64_t receive_calls = 0;
+    uint64_t datagrams_received = 0;
+    uint64_t bytes_received = 0;
+  };
+
+  BatchedUdpSocket() = default;
+  ~BatchedUdpSocket();
+  BatchedUdpSocket(const BatchedUdpSocket&) = delete;
+  BatchedUdpSocket& operator=(const BatchedUdpSocket&) = delete;
+
+  // Creates the socket and binds it to |port| (zero to pick one) on
+  // in6addr_any.
+  Status Open(uint16_t port = 0);
+
+  int fd() const { return fd_; }
+  uint16_t port() const { return port_; }
+  const Stats& stats() const { return stats_; }
+
+  // Sends each of |slices| as a datagram to |dest|, in order. Datagrams the
+  // kernel won't take right now are dropped, as UDP would anyway.
+  Status SendTo(UdpAddr dest, const Slice* slices, size_t count);
+
+  // Receives up to kMaxBatch datagrams of at most |mss| bytes without
+  // blocking, calling |on_datagram(UdpAddr source, Slice datagram)| for each.
+  // Returns the number of datagrams received.
+  template <class F>
+  StatusOr<size_t> Receive(uint32_t mss, F on_datagram) {
+    std::vector<Slice> buffers;
+    std::vector<UdpAddr> sources;
+    auto received = ReceiveBatch(mss, &buffers, &sources);
+    if (received.is_error()) {
+      return received;
+    }
+    for (size_t i = 0; i < *received.get(); i++) {
+      on_datagram(sources[i], std::move(buffers[i]));
+    }
+    return received;
+  }
+
+ private:
+  StatusOr<size_t> ReceiveBatch(uint32_t mss, std::vector<Slice>* buffers,
+                                std::vector<UdpAddr>* sources);
+
+  int fd_ = -1;
+  uint16_t port_ = 0;
+  Stats stats_;
+  std::vector<Slice> spare_buffers_;
+  uint32_t spare_mss_ = 0;
+};
+
+}  // namespace overnet
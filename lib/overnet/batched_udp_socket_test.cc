@@ -0,0 +1,288 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Batched UDP sends over loopback. The benchmark runs two routers, each with a
+// PacketNub on a BatchedUdpSocket, and sends messages between them with a
+// stand-in for packet loss, reporting packets per send syscall and CPU time per
+// MB delivered with and without batching.
+
+#include "batched_udp_socket.h"
+#include <sys/resource.h>
+#include <memory>
+#include "benchmark_summary.h"
+#include "gtest/gtest.h"
+#include "packet_nub.h"
+#include "test_timer.h"
+
+namespace overnet {
+namespace batched_udp_socket_test {
+
+static constexpr uint32_t kMSS = 1500;
+static const TimeDelta kOneWayDelay = TimeDelta::FromMicroseconds(500);
+
+UdpAddr Loopback(uint16_t port) {
+  UdpAddr addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.ipv6.sin6_family = AF_INET6;
+  addr.ipv6.sin6_addr = in6addr_loopback;
+  addr.ipv6.sin6_port = htons(port);
+  return addr;
+}
+
+TEST(BatchedUdpSocket, SendAndReceiveBatch) {
+  BatchedUdpSocket a;
+  BatchedUdpSocket b;
+  ASSERT_TRUE(a.Open().is_ok());
+  ASSERT_TRUE(b.Open().is_ok());
+
+  std::vector<Slice> sent;
+  for (int i = 0; i < 100; i++) {
+    sent.emplace_back(Slice::RepeatedChar(100 + i, 'a' + i % 26));
+  }
+  ASSERT_TRUE(a.SendTo(Loopback(b.port()), sent.data(), sent.size()).is_ok());
+  EXPECT_EQ(100u, a.stats().datagrams_sent);
+#ifdef __linux__
+  EXPECT_EQ(2u, a.stats().send_calls);
+#endif
+
+  std::vector<Slice> received;
+  while (received.size() < sent.size()) {
+    auto status = b.Receive(kMSS, [&](UdpAddr source, Slice datagram) {
+      EXPECT_EQ(a.port(), ntohs(source.ipv6.sin6_port));
+      received.emplace_back(std::move(datagram));
+    });
+    ASSERT_TRUE(status.is_ok());
+    ASSERT_NE(0u, *status.get());
+  }
+  EXPECT_EQ(sent, received);
+#ifdef __linux__
+  EXPECT_EQ(2u, b.stats().receive_calls);
+#endif
+  auto status = b.Receive(kMSS, [](UdpAddr, Slice) {});
+  ASSERT_TRUE(status.is_ok());
+  EXPECT_EQ(0u, *status.get());
+}
+
+using NubBase = PacketNub<UdpAddr, kMSS, HashUdpAddr, EqUdpAddr>;
+
+// A nub on a loopback socket. Every |drop_every|th datagram is dropped instead
+// of being sent, standing in for a lossy network, and received datagrams are
+// delayed by kOneWayDelay.
+class LoopbackNub final : public NubBase {
+ public:
+  LoopbackNub(TestTimer* timer, Router* router, bool batched,
+              TimeDelta pacing_quantum, uint64_t drop_every)
+      : NubBase(timer, TraceSink(), router->node_id(), pacing_quantum),
+        timer_(timer),
+        router_(router),
+        batched_(batched),
+        drop_every_(drop_every) {
+    auto status = socket_.Open();
+    EXPECT_TRUE(status.is_ok()) << status;
+  }
+
+  const BatchedUdpSocket& socket() const { return socket_; }
+  void set_peer(LoopbackNub* peer) { peer_ = peer; }
+
+  void SendTo(UdpAddr addr, Slice slice) override { Send(addr, &slice, 1); }
+
+  void SendBurstTo(UdpAddr addr, std::vector<Slice> slices) override {
+    if (!batched_) {
+      NubBase::SendBurstTo(addr, std::move(slices));
+      return;
+    }
+    Send(addr, slices.data(), slices.size());
+  }
+
+  Router* GetRouter() override { return router_; }
+
+  void Publish(LinkPtr<> link) override {
+    router_->RegisterLink(std::move(link));
+  }
+
+  // Receives whatever has arrived, returning false if nothing had. Each batch
+  // of datagrams is processed together (and corked, if batching).
+  bool Poll() {
+    auto batch = std::make_shared<std::vector<std::pair<UdpAddr, Slice>>>();
+    auto status = socket_.Receive(kMSS, [batch](UdpAddr source, Slice slice) {
+      batch->emplace_back(source, std::move(slice));
+    });
+    EXPECT_TRUE(status.is_ok());
+    if (batch->empty()) {
+      return false;
+    }
+    timer_->At(timer_->Now() + kOneWayDelay, [this, batch]() {
+      if (batched_) {
+        Cork();
+      }
+      for (auto& datagram : *batch) {
+        Process(timer_->Now(), datagram.first, std::move(datagram.second));
+      }
+      if (batched_) {
+        Uncork();
+      }
+    });
+    return true;
+  }
+
+ private:
+  void Send(UdpAddr addr, Slice* slices, size_t count) {
+    size_t kept = 0;
+    for (size_t i = 0; i < count; i++) {
+      if (++datagrams_ % drop_every_ == 0) {
+        continue;
+      }
+      if (kept != i) {
+        slices[kept] = std::move(slices[i]);
+      }
+      kept++;
+    }
+    // Drain the peer's socket after each batch so that bursts don't overflow
+    // its receive buffer while simulated time stands still.
+    for (size_t i = 0; i < kept; i += BatchedUdpSocket::kMaxBatch) {
+      auto status = socket_.SendTo(
+          addr, slices + i, std::min(kept - i, BatchedUdpSocket::kMaxBatch));
+      EXPECT_TRUE(status.is_ok()) << status;
+      if (peer_ != nullptr) {
+        peer_->Poll();
+      }
+    }
+  }
+
+  TestTimer* const timer_;
+  Router* const router_;
+  const bool batched_;
+  const uint64_t drop_every_;
+  uint64_t datagrams_ = 0;
+  LoopbackNub* peer_ = nullptr;
+  BatchedUdpSocket socket_;
+};
+
+class CountingStream final : public Router::StreamHandler {
+ public:
+  void Close(Callback<void> quiesced) override {}
+  void HandleMessage(SeqNum seq, TimeStamp received, Slice data) override {
+    received_++;
+    bytes_ += data.length();
+    last_received_ = received;
+  }
+
+  uint64_t received_ = 0;
+  uint64_t bytes_ = 0;
+  TimeStamp last_received_ = TimeStamp::Epoch();
+};
+
+double CpuSeconds() {
+  rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+         (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+struct RunResult {
+  uint64_t received;
+  uint64_t bytes;
+  uint64_t send_calls;
+  uint64_t datagrams_sent;
+  TimeDelta elapsed;
+  double cpu_seconds;
+};
+
+// Sends |messages| messages of |message_size| bytes from one nub to another.
+RunResult RunLoopback(bool batched, TimeDelta pacing_quantum, uint64_t drop_every,
+              uint64_t messages, size_t message_size) {
+  TestTimer timer;
+  // Nubs must outlive the links their routers hold.
+  std::unique_ptr<LoopbackNub> nub_a;
+  std::unique_ptr<LoopbackNub> nub_b;
+  Router router_a(&timer, TraceSink(), NodeId(1), false);
+  Router router_b(&timer, TraceSink(), NodeId(2), false);
+  nub_a.reset(
+      new LoopbackNub(&timer, &router_a, batched, pacing_quantum, drop_every));
+  nub_b.reset(
+      new LoopbackNub(&timer, &router_b, batched, pacing_quantum, drop_every));
+  nub_a->set_peer(nub_b.get());
+  nub_b->set_peer(nub_a.get());
+  auto pump = [&]() {
+    bool a = nub_a->Poll();
+    bool b = nub_b->Poll();
+    if (!a && !b) {
+      return timer.StepUntilNextEvent();
+    }
+    return true;
+  };
+
+  nub_a->Initiate(Loopback(nub_b->socket().port()), router_b.node_id());
+  while (!router_a.HasRouteTo(router_b.node_id()) && pump()) {
+  }
+  EXPECT_TRUE(router_a.HasRouteTo(router_b.node_id()));
+
+  CountingStream stream;
+  EXPECT_TRUE(
+      router_b.RegisterStream(router_a.node_id(), StreamId(1), &stream).is_ok());
+
+  const auto sent_before = nub_a->socket().stats();
+  const TimeStamp start = timer.Now();
+  const double cpu_before = CpuSeconds();
+  for (uint64_t i = 0; i < messages; i++) {
+    router_a.Forward(Message{
+        std::move(RoutableMessage(router_a.node_id())
+                      .AddDestination(router_b.node_id(), StreamId(1),
+                                      SeqNum(i + 1, messages))),
+        ForwardingPayloadFactory(Slice::RepeatedChar(message_size, 'x')),
+        timer.Now()});
+  }
+  const TimeStamp deadline = start + TimeDelta::FromSeconds(60);
+  while (stream.received_ < messages && timer.Now() < deadline && pump()) {
+  }
+  const double cpu_seconds = CpuSeconds() - cpu_before;
+  const auto& sent_after = nub_a->socket().stats();
+
+  RunResult result{stream.received_, stream.bytes_,
+                   sent_after.send_calls - sent_before.send_calls,
+                   sent_after.datagrams_sent - sent_before.datagrams_sent,
+                   stream.last_received_ - start, cpu_seconds};
+
+  EXPECT_TRUE(
+      router_b.UnregisterStream(router_a.node_id(), StreamId(1), &stream)
+          .is_ok());
+  router_a.Close(Callback<void>::Ignored());
+  router_b.Close(Callback<void>::Ignored());
+  while (timer.StepUntilNextEvent()) {
+  }
+  return result;
+}
+
+TEST(BatchedUdpSocket, LoopbackThroughput) {
+  static constexpr uint64_t kMessages = 4000;
+  static constexpr size_t kMessageSize = 1000;
+  static constexpr uint64_t kDropEvery = 50;
+  BenchmarkSummary writer;
+  auto run = [&](const char* name, bool batched, TimeDelta quantum) {
+    auto result =
+        RunLoopback(batched, quantum, kDropEvery, kMessages, kMessageSize);
+    // Routed messages aren't retransmitted, so each dropped datagram loses the
+    // message it carried.
+    EXPECT_GE(result.received, kMessages - 2 * kMessages / kDropEvery);
+    writer.Put("mode", name)
+        .Put("quantum_us", quantum.as_us())
+        .Put("elapsed_ms", result.elapsed.as_us() / 1000.0)
+        .Put("send_calls", result.send_calls)
+        .Put("packets_per_call",
+             static_cast<double>(result.datagrams_sent) /
+                 std::max(uint64_t(1), result.send_calls))
+        .Put("cpu_ms_per_mb", 1e3 * result.cpu_seconds /
+                                  (result.bytes / (1024.0 * 1024.0)));
+    writer.EndRow();
+    return result;
+  };
+  auto unbatched = run("unbatched", false, TimeDelta::Zero());
+  run("batched", true, TimeDelta::Zero());
+  run("batched", true, TimeDelta::FromMicroseconds(250));
+  auto batched = run("batched", true, TimeDelta::FromMilliseconds(1));
+  EXPECT_LT(4 * batched.send_calls, unbatched.send_calls);
+}
+
+}  // namespace batched_udp_socket_test
+}  // namespace overnet
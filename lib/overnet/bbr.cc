@@ -220,12 +220,35 @@ void BBR::QueuedPacketReady() {
   queued_packet_.Take()(Status::Ok());
 }
 
+void BBR::ExpediteTransmit() {
+  ValidateState();
+  if (queued_packet_) {
+    OVERNET_TRACE(DEBUG, trace_sink_)
+        << "ExpediteTransmit: bytes_in_flight=" << bytes_in_flight_
+        << " cwnd=" << cwnd_bytes_;
+    QueuedPacketReady();
+  }
+  ValidateState();
+}
+
 void BBR::CancelRequestTransmit() {
   ValidateState();
   queued_packet_.Reset();
   ValidateState();
 }
 
+void BBR::CancelTransmit() {
+  ValidateState();
+  assert(packets_in_flight_ > 0);
+  assert(bytes_in_flight_ >= mss_);
+  packets_in_flight_--;
+  bytes_in_flight_ -= mss_;
+  if (bytes_in_flight_ < cwnd_bytes_ && queued_packet_) {
+    QueuedPacketReady();
+  }
+  ValidateState();
+}
+
 BBR::SentPacket BBR::ScheduleTransmit(TimeStamp* overall_send_time,
                                       OutgoingPacket packet) {
   assert(overall_send_time != nullptr);
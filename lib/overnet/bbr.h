@@ -42,6 +42,13 @@ class BBR {
 
   void RequestTransmit(StatusCallback ready);
   void CancelRequestTransmit();
+  // Grants a pending RequestTransmit even if the congestion window is full.
+  // Used only for pure acks, which the peer may need before it can open our
+  // window; data must wait for the window to open.
+  void ExpediteTransmit();
+  // Releases what a granted transmit reserved, for a packet that was
+  // abandoned before it could be scheduled.
+  void CancelTransmit();
   SentPacket ScheduleTransmit(TimeStamp* send_time, OutgoingPacket packet);
   void OnAck(const Ack& ack);
 
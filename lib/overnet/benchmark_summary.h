@@ -0,0 +1,26 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <iostream>
+#include "csv_writer.h"
+
+#pragma once
+
+namespace overnet {
+
+// Toggle to true to print a summary table of each benchmark run
+static constexpr bool kPrintBenchmarkSummaries = false;
+
+// Collects one row per benchmark run, and prints them to stdout as CSV when it
+// goes out of scope if kPrintBenchmarkSummaries is set.
+class BenchmarkSummary : public CsvWriter {
+ public:
+  ~BenchmarkSummary() {
+    if (kPrintBenchmarkSummaries) {
+      Flush(std::cout);
+    }
+  }
+};
+
+}  // namespace overnet
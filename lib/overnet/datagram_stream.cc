@@ -28,7 +28,8 @@ Slice MessageFragment::Write(uint64_t desired_prefix) const {
             p = varint::Write(message_, message_length, p);
             p = varint::Write(chunk.offset, chunk_offset_length, p);
             assert(p == bytes + message_length + chunk_offset_length + 1);
-          });
+          },
+          desired_prefix);
     }
     case Type::MessageAbort:
     case Type::StreamEnd: {
@@ -362,10 +363,13 @@ void DatagramStream::MaybeContinueReceive() {
 
 void DatagramStream::SendPacket(SeqNum seq, LazySlice data,
                                 Callback<void> done) {
+  const bool unordered =
+      reliability_and_ordering_ == ReliabilityAndOrdering::ReliableUnordered ||
+      reliability_and_ordering_ == ReliabilityAndOrdering::UnreliableUnordered;
   router_->Forward(
       Message{std::move(RoutableMessage(router_->node_id())
                             .AddDestination(peer_, stream_id_, seq)),
-              std::move(data), timer_->Now()});
+              std::move(data), timer_->Now(), unordered});
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -449,10 +453,13 @@ void DatagramStream::SendOp::Push(Slice item) {
 void DatagramStream::SendOp::SendChunk(Chunk chunk) {
   OVERNET_TRACE(DEBUG, trace_sink_)
       << "SendChunk: ofs=" << chunk.offset << " len=" << chunk.slice.length();
-  auto on_ack = MakeAckCallback(chunk);
+  // Formatting may split the chunk to fit the packet: only what was actually
+  // sent should be sent again if the packet is lost.
+  auto sent = std::make_shared<Chunk>(chunk);
+  auto on_ack = MakeAckCallback(sent);
   stream_->packet_protocol_.Send(
-      [self = OutstandingOp(this),
-       chunk = std::move(chunk)](auto args) mutable {
+      [self = OutstandingOp(this), chunk = std::move(chunk),
+       sent = std::move(sent)](auto args) mutable {
         OVERNET_TRACE(DEBUG, self->trace_sink_)
             << "SendChunk::format: ofs=" << chunk.offset
             << " len=" << chunk.slice.length()
@@ -468,6 +475,7 @@ void DatagramStream::SendOp::SendChunk(Chunk chunk) {
           Chunk first = chunk.TakeUntilSliceOffset(take_len);
           self->SendChunk(std::move(chunk));
           chunk = std::move(first);
+          *sent = chunk;
         }
         return MessageFragment(self->message_id_, std::move(chunk))
             .Write(args.desired_prefix);
@@ -476,12 +484,12 @@ void DatagramStream::SendOp::SendChunk(Chunk chunk) {
 }
 
 PacketProtocol::SendCallback DatagramStream::SendOp::MakeAckCallback(
-    const Chunk& chunk) {
+    std::shared_ptr<const Chunk> chunk) {
   switch (stream_->reliability_and_ordering_) {
     case ReliabilityAndOrdering::ReliableOrdered:
     case ReliabilityAndOrdering::ReliableUnordered:
       return [chunk, self = OutstandingOp(this)](const Status& status) mutable {
-        self->CompleteReliable(status, std::move(chunk));
+        self->CompleteReliable(status, *chunk);
       };
     case ReliabilityAndOrdering::UnreliableOrdered:
     case ReliabilityAndOrdering::UnreliableUnordered:
@@ -491,7 +499,7 @@ PacketProtocol::SendCallback DatagramStream::SendOp::MakeAckCallback(
     case ReliabilityAndOrdering::TailReliable:
       return [chunk, self = OutstandingOp(this)](const Status& status) mutable {
         if (self->message_id_ + 1 == self->stream_->next_message_id_) {
-          self->CompleteReliable(status, std::move(chunk));
+          self->CompleteReliable(status, *chunk);
         } else {
           self->CompleteUnreliable(status);
         }
@@ -4,6 +4,7 @@
 
 #pragma once
 
+#include <memory>
 #include <queue>  // TODO(ctiller): switch to a short queue (inlined 1-2 elems, linked list)
 #include "ack_frame.h"
 #include "internal_list.h"
@@ -203,7 +204,8 @@ class DatagramStream : private Router::StreamHandler,
       }
     }
 
-    PacketProtocol::SendCallback MakeAckCallback(const Chunk& chunk);
+    PacketProtocol::SendCallback MakeAckCallback(
+        std::shared_ptr<const Chunk> chunk);
 
     class OutstandingOp {
      public:
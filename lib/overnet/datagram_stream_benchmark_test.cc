@@ -0,0 +1,243 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// End to end DatagramStream performance over emulated networks: many streams
+// share a chain of routers connected by NetworkEmulator links, starting at a
+// steady rate, and we report goodput, message latency percentiles and how
+// fairly the streams shared the path.
+//
+// Each stream carries a single message spanning many packets: a receiving
+// DatagramStream doesn't yet retire messages once they've been read, so a
+// ReliableOrdered stream only ever delivers its first.
+
+#include <algorithm>
+#include <memory>
+#include "benchmark_summary.h"
+#include "datagram_stream.h"
+#include "gtest/gtest.h"
+#include "network_emulator.h"
+
+namespace overnet {
+namespace datagram_stream_benchmark_test {
+
+static constexpr uint64_t kMessageSize = 32 * 1024;
+// Fraction of the path's bandwidth offered by all streams together.
+static constexpr double kOfferedLoad = 0.1;
+
+struct Scenario {
+  const char* name;
+  int hops;
+  int streams;
+  NetworkConditions conditions;
+};
+
+struct RunResult {
+  TimeDelta elapsed = TimeDelta::Zero();
+  uint64_t delivered = 0;
+  // Per stream, from its message being sent until it was received in full
+  // (infinite if it never was).
+  std::vector<TimeDelta> latencies;
+  NetworkEmulator::Stats network;
+  // Whether every stream finished closing.
+  bool quiesced = false;
+};
+
+// Closes |streams|, stepping time until they've all quiesced. Returns false if
+// some never did.
+bool CloseStreams(TestTimer* timer, std::vector<DatagramStream*> streams) {
+  size_t open_streams = streams.size();
+  for (auto* stream : streams) {
+    stream->Close(Status::Cancelled(),
+                  Callback<void>(ALLOCATED_CALLBACK, [stream, &open_streams]() {
+                    delete stream;
+                    open_streams--;
+                  }));
+  }
+  const TimeStamp deadline = timer->Now() + TimeDelta::FromSeconds(60);
+  while (open_streams != 0 && timer->Now() < deadline &&
+         timer->StepUntilNextEvent()) {
+  }
+  return open_streams == 0;
+}
+
+RunResult Simulate(const Scenario& scenario, uint64_t seed) {
+  TestTimer timer;
+  std::vector<std::unique_ptr<Router>> routers;
+  for (int i = 0; i <= scenario.hops; i++) {
+    routers.emplace_back(new Router(&timer, TraceSink(), NodeId(i + 1), false));
+  }
+  NetworkEmulator network(&timer, seed);
+  for (int i = 0; i < scenario.hops; i++) {
+    network.Connect(routers[i].get(), routers[i + 1].get(),
+                    scenario.conditions);
+  }
+  EXPECT_TRUE(network.ShareRoutes()) << scenario.name;
+  Router* sender = routers.front().get();
+  Router* receiver = routers.back().get();
+
+  RunResult result;
+  result.latencies.resize(scenario.streams, TimeDelta::PositiveInf());
+  std::vector<DatagramStream*> send_streams;
+  std::vector<DatagramStream*> recv_streams;
+  std::vector<std::unique_ptr<DatagramStream::ReceiveOp>> receive_ops;
+  // Streams start in turn, so that together they offer kOfferedLoad of the
+  // path's bandwidth.
+  const TimeDelta interval = scenario.conditions.bandwidth.SendTimeForBytes(
+      static_cast<uint64_t>(kMessageSize / kOfferedLoad));
+  const TimeStamp start = timer.Now();
+  for (int i = 0; i < scenario.streams; i++) {
+    auto* send_stream = new DatagramStream(
+        sender, TraceSink(), receiver->node_id(),
+        ReliabilityAndOrdering::ReliableOrdered, StreamId(i + 1));
+    auto* recv_stream = new DatagramStream(
+        receiver, TraceSink(), sender->node_id(),
+        ReliabilityAndOrdering::ReliableOrdered, StreamId(i + 1));
+    send_streams.push_back(send_stream);
+    recv_streams.push_back(recv_stream);
+
+    const TimeStamp sent = start + i * interval;
+    receive_ops.emplace_back(new DatagramStream::ReceiveOp(recv_stream));
+    receive_ops.back()->PullAll(StatusOrCallback<std::vector<Slice>>(
+        ALLOCATED_CALLBACK, [&timer, &result, i, start,
+                             sent](const StatusOr<std::vector<Slice>>& status) {
+          if (status.is_error()) {
+            return;
+          }
+          EXPECT_EQ(kMessageSize,
+                    Slice::Join(status->begin(), status->end()).length());
+          result.delivered++;
+          result.latencies[i] = timer.Now() - sent;
+          result.elapsed = std::max(result.elapsed, timer.Now() - start);
+        }));
+    timer.At(sent, [send_stream]() {
+      auto* op = new DatagramStream::SendOp(send_stream, kMessageSize);
+      op->Push(Slice::RepeatedChar(kMessageSize, 'x'));
+      op->Close(Status::Ok(), [op]() { delete op; });
+    });
+  }
+
+  const TimeStamp deadline = start + TimeDelta::FromSeconds(60);
+  while (result.delivered < uint64_t(scenario.streams) &&
+         timer.Now() < deadline && timer.StepUntilNextEvent()) {
+  }
+  result.network = network.stats();
+
+  // Closing a stream exchanges messages with its peer, so keep time moving
+  // until they're gone before tearing down the network. Senders go first: a
+  // receiver told of that closes without waiting on the network.
+  for (auto& op : receive_ops) {
+    op->Close(Status::Cancelled());
+  }
+  const bool senders_closed = CloseStreams(&timer, std::move(send_streams));
+  const bool receivers_closed = CloseStreams(&timer, std::move(recv_streams));
+  result.quiesced = senders_closed && receivers_closed;
+  receive_ops.clear();
+  network.Disconnect();
+  for (auto& router : routers) {
+    router->Close(Callback<void>::Ignored());
+  }
+  while (timer.StepUntilNextEvent()) {
+  }
+  return result;
+}
+
+// Latency percentile of the messages that arrived.
+TimeDelta Percentile(std::vector<TimeDelta> latencies, double p) {
+  latencies.erase(std::remove(latencies.begin(), latencies.end(),
+                              TimeDelta::PositiveInf()),
+                  latencies.end());
+  if (latencies.empty()) {
+    return TimeDelta::Zero();
+  }
+  const size_t n = std::min(latencies.size() - 1,
+                            static_cast<size_t>(p * latencies.size()));
+  std::nth_element(latencies.begin(), latencies.begin() + n, latencies.end());
+  return latencies[n];
+}
+
+// Jain's fairness index of per stream goodput: 1 when every stream did equally
+// well, 1/n when one stream had the path to itself.
+double JainFairness(const std::vector<TimeDelta>& latencies) {
+  double sum = 0;
+  double sum_squares = 0;
+  for (auto latency : latencies) {
+    if (latency == TimeDelta::PositiveInf()) {
+      continue;
+    }
+    const double goodput =
+        1.0 / std::max(int64_t(1), latency.as_us());
+    sum += goodput;
+    sum_squares += goodput * goodput;
+  }
+  if (sum_squares == 0) {
+    return 0;
+  }
+  return sum * sum / (latencies.size() * sum_squares);
+}
+
+TEST(DatagramStreamBenchmark, EmulatedNetworks) {
+  NetworkConditions clean;
+  clean.bandwidth = Bandwidth::FromKilobitsPerSecond(20000);
+  clean.delay = TimeDelta::FromMilliseconds(5);
+  NetworkConditions lossy = clean;
+  lossy.loss = 0.01;
+  NetworkConditions reordering = clean;
+  reordering.jitter = TimeDelta::FromMilliseconds(2);
+  reordering.reorder = 0.02;
+
+  const Scenario scenarios[] = {
+      {"clean", 1, 1, clean},       {"clean", 1, 16, clean},
+      {"clean", 3, 1, clean},       {"clean", 3, 16, clean},
+      {"clean", 3, 64, clean},      {"loss", 1, 16, lossy},
+      {"loss", 3, 16, lossy},       {"reorder", 1, 16, reordering},
+      {"reorder", 3, 16, reordering},
+  };
+
+  BenchmarkSummary writer;
+  for (const auto& scenario : scenarios) {
+    RunResult r = Simulate(scenario, 1);
+    const double mbps = 8.0 * r.delivered * kMessageSize /
+                        std::max(int64_t(1), r.elapsed.as_us());
+    writer.Put("scenario", scenario.name)
+        .Put("hops", scenario.hops)
+        .Put("streams", scenario.streams)
+        .Put("delivered", r.delivered)
+        .Put("goodput_mbps", mbps)
+        .Put("fairness", JainFairness(r.latencies))
+        .Put("p50_ms", Percentile(r.latencies, 0.5).as_us() / 1000.0)
+        .Put("p90_ms", Percentile(r.latencies, 0.9).as_us() / 1000.0)
+        .Put("p99_ms", Percentile(r.latencies, 0.99).as_us() / 1000.0)
+        .Put("packets_sent", r.network.packets_sent)
+        .Put("packets_lost", r.network.packets_lost)
+        .Put("packets_reordered", r.network.packets_reordered)
+        .Put("queue_drops", r.network.packets_queue_dropped)
+        .Put("quiesced", r.quiesced);
+    writer.EndRow();
+    // A packet that arrives after a later one has been acknowledged is dropped
+    // as lost at each hop, so reordering paths may stall streams for a
+    // retransmission timeout or more: those runs are reported, not checked.
+    if (scenario.conditions.reorder == 0 &&
+        scenario.conditions.jitter == TimeDelta::Zero()) {
+      EXPECT_EQ(uint64_t(scenario.streams), r.delivered) << scenario.name;
+      EXPECT_TRUE(r.quiesced) << scenario.name;
+    }
+  }
+}
+
+TEST(DatagramStreamBenchmark, Reproducible) {
+  NetworkConditions conditions;
+  conditions.bandwidth = Bandwidth::FromKilobitsPerSecond(20000);
+  conditions.loss = 0.01;
+  conditions.jitter = TimeDelta::FromMilliseconds(2);
+  conditions.reorder = 0.02;
+  const Scenario scenario{"reproducible", 2, 4, conditions};
+  auto a = Simulate(scenario, 7);
+  auto b = Simulate(scenario, 7);
+  EXPECT_EQ(a.latencies, b.latencies);
+  EXPECT_EQ(a.quiesced, b.quiesced);
+  EXPECT_EQ(a.network.packets_sent, b.network.packets_sent);
+}
+
+}  // namespace datagram_stream_benchmark_test
+}  // namespace overnet
@@ -3,6 +3,7 @@
 // found in the LICENSE file.
 
 #include "linearizer.h"
+#include <algorithm>
 
 namespace overnet {
 
@@ -27,11 +28,119 @@ Linearizer::~Linearizer() {
   }
 }
 
+Linearizer::Window::Window(uint64_t start, uint64_t end)
+    : start_(start),
+      buffer_(Slice::WithInitializer(end - start, [](uint8_t*) {})),
+      received_((end - start + 63) / 64) {}
+
+bool Linearizer::Window::Write(const Chunk& chunk) {
+  assert(chunk.offset >= start_);
+  assert(chunk.offset + chunk.slice.length() <= end());
+  // Bytes that have been read share this buffer, but are never written again.
+  uint8_t* const bytes = const_cast<uint8_t*>(buffer_.begin());
+  const uint64_t chunk_end = chunk.offset + chunk.slice.length();
+  uint64_t pos = chunk.offset;
+  while (pos < chunk_end) {
+    const uint64_t bit = pos - start_;
+    const bool received = (received_[bit / 64] >> (bit % 64)) & 1;
+    const uint64_t run_end = RunEnd(pos, chunk_end, received);
+    const uint8_t* src = chunk.slice.begin() + (pos - chunk.offset);
+    if (received) {
+      if (0 != memcmp(bytes + bit, src, run_end - pos)) {
+        return false;
+      }
+    } else {
+      memcpy(bytes + bit, src, run_end - pos);
+      MarkReceived(pos, run_end);
+    }
+    pos = run_end;
+  }
+  return true;
+}
+
+Slice Linearizer::Window::Read(uint64_t offset, uint64_t length) const {
+  assert(offset >= start_);
+  assert(offset + length <= end());
+  Slice out = buffer_.FromOffset(offset - start_);
+  out.TrimEnd(out.length() - length);
+  return out;
+}
+
+uint64_t Linearizer::Window::RunEnd(uint64_t from, uint64_t to,
+                                    bool received) const {
+  uint64_t bit = from - start_;
+  const uint64_t last = to - start_;
+  while (bit < last) {
+    // Set bits are those whose state differs from |received|.
+    uint64_t differ = received_[bit / 64];
+    if (received) {
+      differ = ~differ;
+    }
+    differ >>= bit % 64;
+    if (differ != 0) {
+      return start_ + std::min(last, bit + __builtin_ctzll(differ));
+    }
+    bit = (bit / 64 + 1) * 64;
+  }
+  return to;
+}
+
+void Linearizer::Window::MarkReceived(uint64_t from, uint64_t to) {
+  uint64_t bit = from - start_;
+  const uint64_t last = to - start_;
+  while (bit < last) {
+    const uint64_t word_end = std::min(last, (bit / 64 + 1) * 64);
+    const uint64_t count = word_end - bit;
+    const uint64_t mask = count == 64 ? ~uint64_t(0) : (uint64_t(1) << count) - 1;
+    received_[bit / 64] |= mask << (bit % 64);
+    bit = word_end;
+  }
+}
+
+bool Linearizer::HasPending() const {
+  return !pending_push_.empty() ||
+         (window_ && window_->AnyReceived(offset_, window_->end()));
+}
+
+Optional<Slice> Linearizer::TakeReady() {
+  if (window_) {
+    const uint64_t length = window_->ReceivedFrom(offset_);
+    if (length == 0) {
+      return Nothing;
+    }
+    Slice slice = window_->Read(offset_, length);
+    offset_ += length;
+    return slice;
+  }
+  auto it = pending_push_.begin();
+  if (it == pending_push_.end() || it->first != offset_) {
+    return Nothing;
+  }
+  Slice slice = std::move(it->second);
+  pending_push_.erase(it);
+  offset_ += slice.length();
+  return slice;
+}
+
+void Linearizer::DropPending() {
+  pending_push_.clear();
+  window_.Reset();
+}
+
 void Linearizer::ValidateInternals() const {
 #ifndef NDEBUG
   // If closed, nothing should be pending
   if (read_mode_ == ReadMode::Closed) {
     assert(pending_push_.empty());
+    assert(!window_);
+  }
+  // The window replaces the pending map, and covers the rest of the message.
+  if (window_) {
+    assert(pending_push_.empty());
+    assert(length_ && window_->end() == *length_);
+    if (window_->ReceivedFrom(offset_) != 0) {
+      assert(read_mode_ == ReadMode::Idle);
+    }
   }
   // No pending read callback if the next thing is ready.
   if ((!pending_push_.empty() && pending_push_.begin()->first == offset_)) {
@@ -61,7 +170,7 @@ void Linearizer::Close(const Status& status) {
 void Linearizer::Close(const Status& status, Callback<void> quiesced) {
   OVERNET_TRACE(DEBUG, trace_sink_)
       << "Close " << status << " mode=" << read_mode_;
-  if (status.is_ok() && !pending_push_.empty()) {
+  if (status.is_ok() && HasPending()) {
     Close(Status(StatusCode::CANCELLED, "Gaps existed at close time"));
     return;
   }
@@ -70,12 +179,12 @@ void Linearizer::Close(const Status& status, Callback<void> quiesced) {
       break;
     case ReadMode::Idle:
       IdleToClosed(status);
-      pending_push_.clear();
+      DropPending();
       break;
     case ReadMode::ReadSlice: {
       auto push = std::move(ReadSliceToIdle().done);
       IdleToClosed(status);
-      pending_push_.clear();
+      DropPending();
       if (status.is_ok()) {
         push(Nothing);
       } else {
@@ -85,7 +194,7 @@ void Linearizer::Close(const Status& status, Callback<void> quiesced) {
     case ReadMode::ReadAll: {
       auto rd = ReadAllToIdle();
       IdleToClosed(status);
-      pending_push_.clear();
+      DropPending();
       if (status.is_ok()) {
         rd.done(std::move(rd.building));
       } else {
@@ -151,10 +260,28 @@ void Linearizer::Push(Chunk chunk) {
     length_ = chunk_end;
   }
 
-  // Fast path: already a pending read ready, this chunk is at the head of what
-  // we're waiting for, and overlaps with nothing.
-  if (read_mode_ == ReadMode::ReadSlice && chunk_start == offset_ &&
-      (pending_push_.empty() || pending_push_.begin()->first > chunk_end)) {
+  // Fast paths: already a pending read ready, this chunk is at the head of
+  // what we're waiting for, and overlaps with nothing.
+  const bool at_head =
+      chunk_start == offset_ &&
+      (window_ ? !window_->AnyReceived(chunk_start, chunk_end)
+               : (pending_push_.empty() ||
+                  pending_push_.begin()->first > chunk_end));
+  if (read_mode_ == ReadMode::ReadAll && at_head) {
+    OVERNET_TRACE(DEBUG, trace_sink_) << "Push: fast-path read-all";
+    offset_ += chunk.slice.length();
+    read_data_.read_all.building.emplace_back(std::move(chunk.slice));
+    if (length_) {
+      assert(offset_ <= *length_);
+      if (offset_ == *length_) {
+        Close(Status::Ok());
+        return;
+      }
+    }
+    ContinueReadAll();
+    return;
+  }
+  if (read_mode_ == ReadMode::ReadSlice && at_head) {
     OVERNET_TRACE(DEBUG, trace_sink_) << "Push: fast-path";
     offset_ += chunk.slice.length();
     auto push = std::move(ReadSliceToIdle().done);
@@ -182,11 +309,29 @@ void Linearizer::Push(Chunk chunk) {
     }
   }
 
-  // Slow path: we first integrate this chunk into pending_push_, and then see
-  // if we can trigger any completions.
+  // Slow path: we first integrate this chunk into pending_push_ (or the window
+  // once the message length is known), and then see if we can trigger any
+  // completions.
   // We break out the integration into a separate function since it has many
   // exit conditions, and we've got some common checks to do once it's finished.
-  if (pending_push_.empty()) {
+  if (length_ && !window_ && pending_push_.size() >= kMinPendingForWindow) {
+    // Everything from here to the end of the message is within our buffering
+    // limits (the end of message chunk was), so reassemble it in place.
+    OVERNET_TRACE(DEBUG, trace_sink_)
+        << "Push: open window start=" << offset_ << " end=" << *length_;
+    window_.Reset(offset_, *length_);
+    // Pending chunks never overlap, so these writes can't conflict.
+    for (auto& el : pending_push_) {
+      window_->Write(Chunk{el.first, false, std::move(el.second)});
+    }
+    pending_push_.clear();
+  }
+  if (window_) {
+    if (!window_->Write(chunk)) {
+      Close(Status(StatusCode::DATA_LOSS,
+                   "Linearizer received different bytes for the same span"));
+    }
+  } else if (pending_push_.empty()) {
     OVERNET_TRACE(DEBUG, trace_sink_) << "Push: first pending";
     pending_push_.emplace(chunk.offset, std::move(chunk.slice));
   } else {
@@ -331,19 +476,15 @@ void Linearizer::Pull(StatusOrCallback<Optional<Slice>> push) {
       abort();
     case ReadMode::Idle: {
       // Check to see if there's data already available.
-      auto it = pending_push_.begin();
-      if (it != pending_push_.end() && it->first == offset_) {
+      if (auto slice = TakeReady()) {
         // There is!
-        Slice slice = std::move(it->second);
-        pending_push_.erase(it);
-        offset_ += slice.length();
         if (length_) {
           assert(offset_ <= *length_);
           if (offset_ == *length_) {
             Close(Status::Ok());
           }
         }
-        push(std::move(slice));
+        push(std::move(*slice));
       } else {
         // There's not, signal that we can take some.
         // Note that this will cancel any pending Pull().
@@ -377,17 +518,11 @@ void Linearizer::PullAll(StatusOrCallback<std::vector<Slice>> push) {
 void Linearizer::ContinueReadAll() {
   for (;;) {
     assert(read_mode_ == ReadMode::ReadAll);
-    auto it = pending_push_.begin();
-    if (it == pending_push_.end()) {
-      return;
-    }
-    if (it->first != offset_) {
+    auto slice = TakeReady();
+    if (!slice) {
       return;
     }
-    auto slice = std::move(it->second);
-    pending_push_.erase(it);
-    offset_ += slice.length();
-    read_data_.read_all.building.emplace_back(std::move(slice));
+    read_data_.read_all.building.emplace_back(std::move(*slice));
     if (length_) {
       assert(offset_ <= *length_);
       if (offset_ == *length_) {
@@ -5,6 +5,7 @@
 #pragma once
 
 #include <map>
+#include <vector>
 #include "optional.h"
 #include "sink.h"
 #include "slice.h"
@@ -27,14 +28,57 @@ class Linearizer final : public Sink<Chunk>, public Source<Slice> {
   void Close(const Status& status) override;
 
  private:
+  // Reassembly buffer for the rest of a message of known length: bytes are
+  // copied into place as they arrive, and a bitmap records which have.
+  class Window {
+   public:
+    Window(uint64_t start, uint64_t end);
+
+    uint64_t end() const { return start_ + buffer_.length(); }
+
+    // Copies in the bytes of |chunk|, which must lie within the window.
+    // Returns false if any of them differ from bytes received before.
+    bool Write(const Chunk& chunk);
+    // Number of received bytes from |offset| up to the next gap.
+    uint64_t ReceivedFrom(uint64_t offset) const {
+      return RunEnd(offset, end(), true) - offset;
+    }
+    bool AnyReceived(uint64_t from, uint64_t to) const {
+      return RunEnd(from, to, false) != to;
+    }
+    // Shares (rather than copies) received bytes with the caller.
+    Slice Read(uint64_t offset, uint64_t length) const;
+
+   private:
+    // First offset in [from, to) whose received state isn't |received|, or
+    // |to| if there's none.
+    uint64_t RunEnd(uint64_t from, uint64_t to, bool received) const;
+    void MarkReceived(uint64_t from, uint64_t to);
+
+    const uint64_t start_;
+    Slice buffer_;
+    std::vector<uint64_t> received_;
+  };
+
+  // A little reordering is cheaper to track in pending_push_ than to copy into
+  // a window: only open one once this many chunks are out of order.
+  static constexpr size_t kMinPendingForWindow = 16;
+
   void IntegratePush(Chunk chunk);
   void ValidateInternals() const;
+  bool HasPending() const;
+  // Returns the received bytes at offset_, if there are any.
+  Optional<Slice> TakeReady();
+  void DropPending();
 
   const uint64_t max_buffer_;
   const TraceSink trace_sink_;
   uint64_t offset_ = 0;
   Optional<uint64_t> length_;
+  // Out of order bytes are kept in pending_push_ until the message length is
+  // known, and in window_ after that (pending_push_ is then empty).
   std::map<uint64_t, Slice> pending_push_;
+  Optional<Window> window_;
 
   enum class ReadMode {
     Closed,
@@ -0,0 +1,129 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Reassembly cost of Linearizer as chunks of a message arrive out of order.
+// Whether the end of message chunk arrives first or last decides whether the
+// message is reassembled in its preallocated window or in the pending map.
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include "benchmark_summary.h"
+#include "gtest/gtest.h"
+#include "linearizer.h"
+
+namespace overnet {
+namespace linearizer_benchmark_test {
+
+static constexpr uint64_t kMaxBuffer = 1024 * 1024;
+static constexpr uint64_t kChunkSize = 1400;
+
+struct Scenario {
+  uint64_t message_size;
+  // Chunks are shuffled within runs of this many (1 for in order delivery).
+  size_t reorder;
+  // Probability that a chunk is delivered twice.
+  double duplicate;
+  bool end_of_message_first;
+};
+
+std::vector<Chunk> MakeChunks(const Scenario& scenario, const Slice& message,
+                              uint64_t seed) {
+  std::vector<Chunk> chunks;
+  for (uint64_t offset = 0; offset < scenario.message_size;
+       offset += kChunkSize) {
+    const uint64_t end =
+        std::min(scenario.message_size, offset + uint64_t(kChunkSize));
+    chunks.emplace_back(Chunk{offset, end == scenario.message_size,
+                              message.FromOffset(offset)});
+    chunks.back().slice.TrimEnd(scenario.message_size - end);
+  }
+  std::mt19937_64 rng(seed);
+  for (size_t i = 0; i < chunks.size(); i += scenario.reorder) {
+    std::shuffle(chunks.begin() + i,
+                 chunks.begin() + std::min(chunks.size(), i + scenario.reorder),
+                 rng);
+  }
+  std::vector<Chunk> out;
+  std::uniform_real_distribution<double> uniform(0.0, 1.0);
+  for (const auto& chunk : chunks) {
+    out.push_back(chunk);
+    if (uniform(rng) < scenario.duplicate) {
+      out.push_back(chunk);
+    }
+  }
+  auto eom = std::find_if(out.begin(), out.end(), [](const Chunk& chunk) {
+    return chunk.end_of_message;
+  });
+  Chunk end_of_message = *eom;
+  out.erase(eom);
+  out.insert(scenario.end_of_message_first ? out.begin() : out.end(),
+             end_of_message);
+  return out;
+}
+
+// Pushes |chunks| through a Linearizer with a PullAll outstanding, as a
+// DatagramStream receiver does, returning what was read.
+Slice Reassemble(const std::vector<Chunk>& chunks) {
+  Linearizer linearizer(kMaxBuffer, TraceSink());
+  Slice result;
+  linearizer.PullAll(StatusOrCallback<std::vector<Slice>>(
+      [&result](const StatusOr<std::vector<Slice>>& status) {
+        EXPECT_TRUE(status.is_ok()) << status.AsStatus();
+        if (status.is_ok()) {
+          result = Slice::Join(status->begin(), status->end());
+        }
+      }));
+  for (const auto& chunk : chunks) {
+    linearizer.Push(chunk);
+  }
+  return result;
+}
+
+TEST(LinearizerBenchmark, OutOfOrderReassembly) {
+  using Clock = std::chrono::steady_clock;
+  auto us_since = [](Clock::time_point start) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() -
+                                                                 start)
+        .count();
+  };
+
+  BenchmarkSummary writer;
+  for (uint64_t message_size : {16 * 1024, 256 * 1024, 1024 * 1024}) {
+    const Slice message = Slice::WithInitializer(message_size, [=](uint8_t* p) {
+      for (uint64_t i = 0; i < message_size; i++) {
+        p[i] = static_cast<uint8_t>(i * 7 + (i >> 8));
+      }
+    });
+    for (size_t reorder : {1, 8, 64, 1024}) {
+      for (double duplicate : {0.0, 0.1}) {
+        for (bool end_of_message_first : {false, true}) {
+          const Scenario scenario{message_size, reorder, duplicate,
+                                  end_of_message_first};
+          const int repeats = std::max(1, int(8 * 1024 * 1024 / message_size));
+          int64_t elapsed_us = 0;
+          for (int i = 0; i < repeats; i++) {
+            const auto chunks = MakeChunks(scenario, message, i);
+            const auto start = Clock::now();
+            const Slice result = Reassemble(chunks);
+            elapsed_us += us_since(start);
+            ASSERT_EQ(message, result);
+          }
+          const double mb_per_second =
+              double(message_size) * repeats / std::max(int64_t(1), elapsed_us);
+          writer.Put("message_size", message_size)
+              .Put("reorder", reorder)
+              .Put("duplicate", duplicate)
+              .Put("end_of_message_first", end_of_message_first)
+              .Put("us_per_message", double(elapsed_us) / repeats)
+              .Put("mb_per_second", mb_per_second);
+          writer.EndRow();
+        }
+      }
+    }
+  }
+}
+
+}  // namespace linearizer_benchmark_test
+}  // namespace overnet
@@ -296,6 +296,84 @@ TEST(Linearizer, Push012_Push1_Pull0) {
   linearizer.Pull(cb.NewPull());
 }
 
+// Once the end of message is known and enough chunks are out of order, they're
+// reassembled into one buffer, and the contiguous prefix is delivered as a
+// single slice.
+static constexpr uint64_t kReassembled = 20;
+
+static const char* ReassembledString() {
+  return "abcdefghijklmnopqrst";
+}
+
+// Pushes the end of message at kReassembled - 1, then every byte before it back
+// to (but not including) offset |stop|.
+static void PushEndThenBackwardsTo(Linearizer* linearizer, uint64_t stop) {
+  for (uint64_t i = kReassembled; i-- > stop;) {
+    linearizer->Push(Chunk{
+        i, i == kReassembled - 1,
+        Slice::FromCopiedBuffer(ReassembledString() + i, 1)});
+  }
+}
+
+TEST(Linearizer, PushEndBackwards_Pull) {
+  StrictMock<MockCallbacks> cb;
+  Linearizer linearizer(128, TraceSink());
+
+  PushEndThenBackwardsTo(&linearizer, 0);
+
+  EXPECT_CALL(
+      cb, PullDone(Property(
+              &StatusOr<Optional<Slice>>::get,
+              Pointee(Pointee(Slice::FromStaticString(ReassembledString()))))));
+  linearizer.Pull(cb.NewPull());
+}
+
+TEST(Linearizer, PushEndBackwards_Pull_Push0_Pull) {
+  StrictMock<MockCallbacks> cb;
+  Linearizer linearizer(128, TraceSink());
+
+  PushEndThenBackwardsTo(&linearizer, 1);
+  linearizer.Pull(cb.NewPull());
+  Mock::VerifyAndClearExpectations(&cb);
+
+  EXPECT_CALL(
+      cb, PullDone(Property(&StatusOr<Optional<Slice>>::get,
+                            Pointee(Pointee(Slice::FromStaticString("a"))))));
+  linearizer.Push(Chunk{0, false, Slice::FromStaticString("a")});
+  Mock::VerifyAndClearExpectations(&cb);
+
+  EXPECT_CALL(cb,
+              PullDone(Property(&StatusOr<Optional<Slice>>::get,
+                                Pointee(Pointee(Slice::FromStaticString(
+                                    ReassembledString() + 1))))));
+  linearizer.Pull(cb.NewPull());
+}
+
+TEST(Linearizer, PushEndBackwards_PushBad_Pull) {
+  StrictMock<MockCallbacks> cb;
+  Linearizer linearizer(128, TraceSink());
+
+  PushEndThenBackwardsTo(&linearizer, 1);
+  linearizer.Push(Chunk{4, false, Slice::FromStaticString("xyz")});
+  Mock::VerifyAndClearExpectations(&cb);
+
+  EXPECT_CALL(cb, PullDone(Property(&StatusOr<Optional<Slice>>::code,
+                                    StatusCode::DATA_LOSS)));
+  linearizer.Pull(cb.NewPull());
+}
+
+TEST(Linearizer, PushEndBackwards_Close) {
+  StrictMock<MockCallbacks> cb;
+  Linearizer linearizer(128, TraceSink());
+
+  PushEndThenBackwardsTo(&linearizer, 1);
+  linearizer.Close(Status::Ok());
+
+  EXPECT_CALL(cb, PullDone(Property(&StatusOr<Optional<Slice>>::code,
+                                    StatusCode::CANCELLED)));
+  linearizer.Pull(cb.NewPull());
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // Fuzzer found failures
 //
@@ -0,0 +1,165 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "network_emulator.h"
+#include <stdlib.h>
+#include <algorithm>
+
+namespace overnet {
+
+struct NetworkEmulator::Wire {
+  NetworkEmulator* emulator;
+  const NetworkConditions conditions;
+  EmulatedLink* ends[2] = {nullptr, nullptr};
+  // When each end's queue will have drained.
+  TimeStamp drained[2] = {TimeStamp::Epoch(), TimeStamp::Epoch()};
+};
+
+class NetworkEmulator::EmulatedLink final : public PacketLink {
+ public:
+  EmulatedLink(Router* router, NodeId peer, std::shared_ptr<Wire> wire,
+               int end)
+      : PacketLink(router, TraceSink(), peer, wire->conditions.mss),
+        wire_(wire),
+        end_(end) {
+    wire_->ends[end_] = this;
+  }
+
+  ~EmulatedLink() {
+    if (wire_->ends[end_] == this) {
+      wire_->ends[end_] = nullptr;
+    }
+  }
+
+  void Emit(Slice packet) override {
+    if (wire_->emulator != nullptr) {
+      wire_->emulator->Send(wire_, end_, std::move(packet));
+    }
+  }
+
+ private:
+  const std::shared_ptr<Wire> wire_;
+  const int end_;
+};
+
+NetworkEmulator::NetworkEmulator(TestTimer* timer, uint64_t seed)
+    : timer_(timer), rng_(seed) {
+  // BBR draws its initial ProbeBW phase from rand(): seed that too, or runs
+  // with the same seed could diverge once a link leaves startup.
+  srand(seed);
+}
+
+NetworkEmulator::~NetworkEmulator() {
+  for (auto& wire : wires_) {
+    wire->emulator = nullptr;
+  }
+}
+
+void NetworkEmulator::Connect(Router* a, Router* b,
+                              const NetworkConditions& conditions) {
+  for (Router* router : {a, b}) {
+    if (std::find(routers_.begin(), routers_.end(), router) == routers_.end()) {
+      routers_.push_back(router);
+    }
+  }
+  auto wire = std::make_shared<Wire>(Wire{this, conditions});
+  wires_.push_back(wire);
+  a->RegisterLink(MakeLink<EmulatedLink>(a, b->node_id(), wire, 0));
+  b->RegisterLink(MakeLink<EmulatedLink>(b, a->node_id(), wire, 1));
+}
+
+bool NetworkEmulator::ShareRoutes() {
+  std::vector<NodeMetrics> node_metrics;
+  for (Router* router : routers_) {
+    node_metrics.emplace_back(router->node_id(), node_metrics_version_);
+  }
+  node_metrics_version_++;
+  std::vector<LinkMetrics> link_metrics;
+  for (const auto& wire : wires_) {
+    for (EmulatedLink* link : wire->ends) {
+      if (link != nullptr) {
+        link_metrics.emplace_back(link->GetLinkMetrics());
+      }
+    }
+  }
+  for (Router* router : routers_) {
+    router->UpdateRoutingTable(node_metrics, link_metrics);
+  }
+
+  auto all_routed = [this] {
+    for (Router* from : routers_) {
+      for (Router* to : routers_) {
+        if (!from->HasRouteTo(to->node_id())) {
+          return false;
+        }
+      }
+    }
+    return true;
+  };
+  const TimeStamp deadline = timer_->Now() + TimeDelta::FromSeconds(10);
+  while (!all_routed()) {
+    if (timer_->Now() > deadline) {
+      return false;
+    }
+    for (Router* router : routers_) {
+      router->BlockUntilNoBackgroundUpdatesProcessing();
+    }
+    timer_->Step(TimeDelta::FromMilliseconds(1).as_us());
+  }
+  return true;
+}
+
+void NetworkEmulator::Disconnect() {
+  for (auto& wire : wires_) {
+    wire->emulator = nullptr;
+    wire->ends[0] = wire->ends[1] = nullptr;
+  }
+}
+
+void NetworkEmulator::Send(const std::shared_ptr<Wire>& wire, int from_end,
+                           Slice packet) {
+  const NetworkConditions& conditions = wire->conditions;
+  const TimeStamp now = timer_->Now();
+  stats_.packets_sent++;
+  stats_.bytes_sent += packet.length();
+
+  // Tail drop once the bottleneck queue is full.
+  TimeStamp& drained = wire->drained[from_end];
+  const TimeStamp start = std::max(now, drained);
+  if (conditions.bandwidth.BytesSentForTime(start - now) + packet.length() >
+      conditions.queue_bytes) {
+    stats_.packets_queue_dropped++;
+    return;
+  }
+  drained = start + conditions.bandwidth.SendTimeForBytes(packet.length());
+
+  std::uniform_real_distribution<double> uniform(0.0, 1.0);
+  if (uniform(rng_) < conditions.loss) {
+    stats_.packets_lost++;
+    return;
+  }
+  TimeStamp arrival = drained + conditions.delay;
+  if (conditions.jitter.as_us() > 0) {
+    arrival = arrival + TimeDelta::FromMicroseconds(
+                            std::uniform_int_distribution<int64_t>(
+                                0, conditions.jitter.as_us() - 1)(rng_));
+  }
+  if (uniform(rng_) < conditions.reorder) {
+    stats_.packets_reordered++;
+    arrival = arrival + conditions.reorder_delay;
+  }
+
+  timer_->At(arrival, [this, wire, to = 1 - from_end,
+                       packet = std::move(packet)]() {
+    if (wire->emulator == nullptr) {
+      return;
+    }
+    if (EmulatedLink* link = wire->ends[to]) {
+      stats_.packets_delivered++;
+      link->Process(timer_->Now(), packet);
+    }
+  });
+}
+
+}  // namespace overnet
@@ -0,0 +1,83 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <memory>
+#include <random>
+#include <vector>
+#include "bandwidth.h"
+#include "packet_link.h"
+#include "router.h"
+#include "test_timer.h"
+
+namespace overnet {
+
+// How an emulated link treats the packets sent over it (in each direction).
+struct NetworkConditions {
+  // Rate packets drain from the sender's queue.
+  Bandwidth bandwidth = Bandwidth::FromKilobitsPerSecond(100000);
+  // Bytes that may be waiting to drain before further packets are dropped.
+  uint64_t queue_bytes = 256 * 1024;
+  // Propagation delay.
+  TimeDelta delay = TimeDelta::FromMilliseconds(5);
+  // Each packet is delayed by up to this much more, uniformly at random.
+  TimeDelta jitter = TimeDelta::Zero();
+  // Probability that a packet is lost.
+  double loss = 0;
+  // Probability that a packet is held back by reorder_delay, letting later
+  // packets overtake it.
+  double reorder = 0;
+  TimeDelta reorder_delay = TimeDelta::FromMilliseconds(10);
+  uint32_t mss = 1500;
+};
+
+// Connects routers with PacketLinks over emulated links, on a TestTimer. Loss,
+// jitter and reordering are drawn from one seeded generator, so given the
+// same seed and the same sequence of sends a run is exactly reproducible.
+class NetworkEmulator {
+ public:
+  struct Stats {
+    uint64_t packets_sent = 0;
+    uint64_t bytes_sent = 0;
+    uint64_t packets_lost = 0;
+    uint64_t packets_queue_dropped = 0;
+    uint64_t packets_reordered = 0;
+    uint64_t packets_delivered = 0;
+  };
+
+  NetworkEmulator(TestTimer* timer, uint64_t seed);
+  ~NetworkEmulator();
+  NetworkEmulator(const NetworkEmulator&) = delete;
+  NetworkEmulator& operator=(const NetworkEmulator&) = delete;
+
+  // Registers a link in each direction between |a| and |b|.
+  void Connect(Router* a, Router* b, const NetworkConditions& conditions);
+
+  // Tells every connected router about every node and link, standing in for
+  // routing gossip, and steps time until each router has a route to every
+  // other. Returns false if that didn't happen.
+  bool ShareRoutes();
+
+  // Drops every link's end so that nothing more is delivered; routers may then
+  // be closed in any order.
+  void Disconnect();
+
+  const Stats& stats() const { return stats_; }
+
+ private:
+  class EmulatedLink;
+  struct Wire;
+
+  void Send(const std::shared_ptr<Wire>& wire, int from_end, Slice packet);
+
+  TestTimer* const timer_;
+  std::mt19937_64 rng_;
+  std::vector<Router*> routers_;
+  std::vector<std::shared_ptr<Wire>> wires_;
+  uint64_t node_metrics_version_ = 1;
+  Stats stats_;
+};
+
+}  // namespace overnet
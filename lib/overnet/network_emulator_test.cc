@@ -0,0 +1,127 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "network_emulator.h"
+#include "gtest/gtest.h"
+
+namespace overnet {
+namespace network_emulator_test {
+
+class RecordingStream final : public Router::StreamHandler {
+ public:
+  void Close(Callback<void> quiesced) override {}
+  void HandleMessage(SeqNum seq, TimeStamp received, Slice data) override {
+    received_.push_back(received);
+  }
+
+  std::vector<TimeStamp> received_;
+};
+
+struct RunResult {
+  NetworkEmulator::Stats stats;
+  std::vector<TimeStamp> received;
+  TimeStamp sent = TimeStamp::Epoch();
+};
+
+// Sends |messages| single packet messages from one router to another,
+// |spacing| apart, over a link with |conditions|.
+RunResult SendMessages(const NetworkConditions& conditions, uint64_t seed,
+                       uint64_t messages, TimeDelta spacing) {
+  TestTimer timer;
+  Router a(&timer, TraceSink(), NodeId(1), false);
+  Router b(&timer, TraceSink(), NodeId(2), false);
+  NetworkEmulator emulator(&timer, seed);
+  emulator.Connect(&a, &b, conditions);
+  EXPECT_TRUE(emulator.ShareRoutes());
+
+  RecordingStream stream;
+  EXPECT_TRUE(b.RegisterStream(a.node_id(), StreamId(1), &stream).is_ok());
+  RunResult result;
+  result.sent = timer.Now();
+  for (uint64_t i = 0; i < messages; i++) {
+    a.Forward(Message{
+        std::move(RoutableMessage(a.node_id())
+                      .AddDestination(b.node_id(), StreamId(1),
+                                      SeqNum(i + 1, messages))),
+        ForwardingPayloadFactory(Slice::RepeatedChar(100, 'x')), timer.Now()});
+    timer.Step(spacing.as_us());
+  }
+  while (timer.StepUntilNextEvent() &&
+         timer.Now() < result.sent + TimeDelta::FromSeconds(10)) {
+  }
+  result.stats = emulator.stats();
+  result.received = stream.received_;
+
+  EXPECT_TRUE(b.UnregisterStream(a.node_id(), StreamId(1), &stream).is_ok());
+  emulator.Disconnect();
+  a.Close(Callback<void>::Ignored());
+  b.Close(Callback<void>::Ignored());
+  return result;
+}
+
+TEST(NetworkEmulator, DelaysByPropagationAndSerialization) {
+  NetworkConditions conditions;
+  conditions.bandwidth = Bandwidth::FromKilobitsPerSecond(1000);
+  conditions.delay = TimeDelta::FromMilliseconds(20);
+  auto result = SendMessages(conditions, 1, 1, TimeDelta::Zero());
+  ASSERT_EQ(1u, result.received.size());
+  const TimeDelta latency = result.received[0] - result.sent;
+  // A ~110 byte packet takes ~0.9ms to serialize at 1Mbps.
+  EXPECT_GE(latency, TimeDelta::FromMilliseconds(20));
+  EXPECT_LE(latency, TimeDelta::FromMilliseconds(22));
+}
+
+TEST(NetworkEmulator, Loss) {
+  NetworkConditions conditions;
+  conditions.loss = 0.2;
+  auto result =
+      SendMessages(conditions, 1, 1000, TimeDelta::FromMilliseconds(10));
+  EXPECT_GT(result.stats.packets_lost, 0u);
+  const double lost = static_cast<double>(result.stats.packets_lost) /
+                      result.stats.packets_sent;
+  EXPECT_GT(lost, 0.15);
+  EXPECT_LT(lost, 0.25);
+  // Messages aren't retransmitted by the router.
+  EXPECT_LT(result.received.size(), 900u);
+}
+
+TEST(NetworkEmulator, QueueDrops) {
+  NetworkConditions conditions;
+  conditions.bandwidth = Bandwidth::FromKilobitsPerSecond(100);
+  conditions.queue_bytes = 2000;
+  auto result = SendMessages(conditions, 1, 100, TimeDelta::Zero());
+  EXPECT_GT(result.stats.packets_queue_dropped, 0u);
+}
+
+TEST(NetworkEmulator, Reorders) {
+  NetworkConditions conditions;
+  conditions.reorder = 0.1;
+  conditions.jitter = TimeDelta::FromMilliseconds(2);
+  auto result =
+      SendMessages(conditions, 1, 1000, TimeDelta::FromMilliseconds(1));
+  const double reordered = static_cast<double>(result.stats.packets_reordered) /
+                           result.stats.packets_sent;
+  EXPECT_GT(reordered, 0.05);
+  EXPECT_LT(reordered, 0.15);
+}
+
+TEST(NetworkEmulator, Deterministic) {
+  NetworkConditions conditions;
+  conditions.loss = 0.05;
+  conditions.reorder = 0.05;
+  conditions.jitter = TimeDelta::FromMilliseconds(3);
+  auto run1 =
+      SendMessages(conditions, 42, 500, TimeDelta::FromMilliseconds(1));
+  auto run2 =
+      SendMessages(conditions, 42, 500, TimeDelta::FromMilliseconds(1));
+  auto run3 =
+      SendMessages(conditions, 43, 500, TimeDelta::FromMilliseconds(1));
+  EXPECT_EQ(run1.received, run2.received);
+  EXPECT_EQ(run1.stats.packets_lost, run2.stats.packets_lost);
+  EXPECT_EQ(run1.stats.packets_reordered, run2.stats.packets_reordered);
+  EXPECT_NE(run1.received, run3.received);
+}
+
+}  // namespace network_emulator_test
+}  // namespace overnet
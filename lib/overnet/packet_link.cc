@@ -4,6 +4,7 @@
 
 #include "packet_link.h"
 #include <iostream>
+#include <limits>
 #include <sstream>
 
 namespace overnet {
@@ -14,7 +15,7 @@ static uint64_t GenerateLabel() {
 }
 
 PacketLink::PacketLink(Router* router, TraceSink trace_sink, NodeId peer,
-                       uint32_t mss)
+                       uint32_t mss, TimeDelta pacing_quantum)
     : router_(router),
       timer_(router->timer()),
       trace_sink_(trace_sink.Decorate([this](const std::string& msg) {
@@ -24,15 +25,24 @@ PacketLink::PacketLink(Router* router, TraceSink trace_sink, NodeId peer,
       })),
       peer_(peer),
       label_(GenerateLabel()),
-      protocol_{router_->timer(), this, trace_sink_, mss} {}
+      pacing_quantum_(pacing_quantum),
+      protocol_{router_->timer(), this, trace_sink_, mss, [] {
+                  PacketProtocol::Options options;
+                  options.max_burst_packets = kMaxBurstPackets;
+                  return options;
+                }()} {}
 
 void PacketLink::Close(Callback<void> quiesced) {
   stashed_.Reset();
   while (!outgoing_.empty()) {
     outgoing_.pop();
   }
-  if (emitting_) {
-    emitting_->timeout.Cancel();
+  emit_timeout_.Reset();
+  // Completing a send may let the protocol hand us another packet: drop those
+  // too, so that the protocol can quiesce.
+  while (!emitting_.empty()) {
+    decltype(emitting_) emitting;
+    emitting.swap(emitting_);
   }
   protocol_.Close(std::move(quiesced));
 }
@@ -52,7 +62,7 @@ LinkMetrics PacketLink::GetLinkMetrics() {
   LinkMetrics m(router_->node_id(), peer_, metrics_version_++, label_);
   m.set_bw_link(protocol_.BottleneckBandwidth());
   m.set_rtt(protocol_.RoundTripTime());
-  m.set_mss(std::max(8u, protocol_.mss()) - 8);
+  m.set_mss(ForwardingMSS());
   return m;
 }
 
@@ -86,7 +96,8 @@ Slice PacketLink::BuildPacket(LazySliceArgs args) {
   auto add_serialized_msg = [&remaining_length, this](
                                 const RoutableMessage& wire,
                                 Slice payload) -> bool {
-    auto serialized = wire.Write(router_->node_id(), peer_, std::move(payload));
+    auto serialized = wire.Write(router_->node_id(), peer_,
+                                 SliceChain(std::move(payload)));
     const auto serialized_length = serialized.length();
     const auto length_length = varint::WireSizeFor(serialized_length);
     const auto segment_length = length_length + serialized_length;
@@ -96,10 +107,11 @@ Slice PacketLink::BuildPacket(LazySliceArgs args) {
     if (segment_length > remaining_length) {
       return false;
     }
-    send_slices_.push_back(serialized.WithPrefix(
-        length_length, [length_length, serialized_length](uint8_t* p) {
-          varint::Write(serialized_length, length_length, p);
-        }));
+    serialized.AddPrefix(length_length,
+                         [length_length, serialized_length](uint8_t* p) {
+                           varint::Write(serialized_length, length_length, p);
+                         });
+    send_chain_.Append(std::move(serialized));
     remaining_length -= segment_length;
     return true;
   };
@@ -121,10 +133,19 @@ Slice PacketLink::BuildPacket(LazySliceArgs args) {
     }
   }
   while (!outgoing_.empty() && remaining_length > kMinMSS) {
-    // Ensure there's space with the routing header included.
+    // Ensure there's space with the routing header included. A message that
+    // our peer will forward on can't be trimmed by later hops, which may have
+    // less space than this packet: size it for the mss we advertise instead.
+    const RoutableMessage& header = outgoing_.front().header;
+    auto space = remaining_length;
+    for (const auto& dst : header.destinations()) {
+      if (dst.dst() != peer_) {
+        space = std::min<size_t>(space, ForwardingMSS());
+        break;
+      }
+    }
     Optional<size_t> max_len_before_prefix =
-        outgoing_.front().header.MaxPayloadLength(router_->node_id(), peer_,
-                                                  remaining_length);
+        header.MaxPayloadLength(router_->node_id(), peer_, space);
     if (!max_len_before_prefix.has_value() || *max_len_before_prefix <= 1) {
       break;
     }
@@ -136,7 +157,7 @@ Slice PacketLink::BuildPacket(LazySliceArgs args) {
     // Serialize it.
     auto payload = msg.make_payload(
         LazySliceArgs{0, static_cast<uint32_t>(max_len),
-                      args.has_other_content || !send_slices_.empty(),
+                      args.has_other_content || !send_chain_.empty(),
                       args.delay_until_time});
     OVERNET_TRACE(DEBUG, trace_sink_)
         << "delay -> " << (*args.delay_until_time - timer_->Now());
@@ -150,15 +171,17 @@ Slice PacketLink::BuildPacket(LazySliceArgs args) {
     }
   }
 
-  Slice send = Slice::Join(send_slices_.begin(), send_slices_.end(),
-                           args.desired_prefix + SeqNum::kMaxWireLength);
-  send_slices_.clear();
+  // This is the one place the packet's contents are copied: headers and
+  // payloads are gathered into a single buffer with room for the protocol and
+  // link headers.
+  Slice send =
+      send_chain_.Flatten(args.desired_prefix + SeqNum::kMaxWireLength);
+  send_chain_ = SliceChain();
 
   return send;
 }
 
 void PacketLink::SendPacket(SeqNum seq, LazySlice data, Callback<void> done) {
-  assert(!emitting_);
   const auto prefix_length = 1 + seq.wire_length();
   const TimeStamp now = timer_->Now();
   TimeStamp send_time = now;
@@ -169,17 +192,68 @@ void PacketLink::SendPacket(SeqNum seq, LazySlice data, Callback<void> done) {
     seq.Write(p);
   });
   OVERNET_TRACE(DEBUG, trace_sink_)
-      << "StartEmit " << send_slice << " delay=" << (send_time - now);
-  emitting_.Reset(timer_, send_time, std::move(send_slice), std::move(done),
-                  [this](const Status& status) {
-                    OVERNET_TRACE(DEBUG, trace_sink_)
-                        << "Emit status=" << status;
-                    if (status.is_ok()) {
-                      Emit(std::move(emitting_->slice));
-                    }
-                    auto cb = std::move(emitting_->done);
-                    emitting_.Reset();
-                  });
+      << "StartEmit " << send_slice << " delay=" << (send_time - now)
+      << " queued=" << emitting_.size();
+  if (!emitting_.empty() && send_time < emitting_.back().when) {
+    send_time = emitting_.back().when;
+  }
+  emitting_.emplace_back(
+      Emitting{send_time, std::move(send_slice), std::move(done)});
+  EmitReady();
+}
+
+// Emits every packet whose send time falls in the current pacing slot as one
+// burst, then waits for the next slot with packets in it. Completing a send
+// lets the protocol hand over its next packet, which joins the burst if it's
+// due in the same slot: this is what turns queued messages into a burst.
+void PacketLink::EmitReady() {
+  if (in_emit_ready_ || emit_timeout_.has_value()) {
+    return;
+  }
+  in_emit_ready_ = true;
+  const TimeStamp slot = SlotStart(timer_->Now());
+  std::vector<Slice> burst;
+  while (!emitting_.empty() && SlotStart(emitting_.front().when) <= slot) {
+    Emitting emitting = std::move(emitting_.front());
+    emitting_.pop_front();
+    burst.emplace_back(std::move(emitting.slice));
+    emitting.done();
+  }
+  if (!burst.empty()) {
+    EmitBurst(std::move(burst));
+  }
+  in_emit_ready_ = false;
+  if (emitting_.empty()) {
+    return;
+  }
+  emit_timeout_.Reset(timer_, SlotStart(emitting_.front().when),
+                      [this](const Status& status) {
+                        OVERNET_TRACE(DEBUG, trace_sink_)
+                            << "Emit status=" << status;
+                        if (status.is_error()) {
+                          return;
+                        }
+                        emit_timeout_.Reset();
+                        EmitReady();
+                      });
+}
+
+void PacketLink::EmitBurst(std::vector<Slice> packets) {
+  for (auto& packet : packets) {
+    Emit(std::move(packet));
+  }
+}
+
+// Rounds |when| down to the start of its pacing slot.
+TimeStamp PacketLink::SlotStart(TimeStamp when) const {
+  const int64_t quantum = pacing_quantum_.as_us();
+  const int64_t us = when.after_epoch().as_us();
+  if (quantum <= 0 || us <= 0 ||
+      us == std::numeric_limits<int64_t>::max()) {
+    return when;
+  }
+  return TimeStamp::AfterEpoch(
+      TimeDelta::FromMicroseconds(us - us % quantum));
 }
 
 void PacketLink::Process(TimeStamp received, Slice packet) {
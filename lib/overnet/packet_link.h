@@ -4,7 +4,9 @@
 
 #pragma once
 
+#include <deque>
 #include <queue>
+#include <vector>
 #include "packet_protocol.h"
 #include "router.h"
 #include "trace.h"
@@ -13,11 +15,21 @@ namespace overnet {
 
 class PacketLink : public Link, private PacketProtocol::PacketSender {
  public:
-  PacketLink(Router* router, TraceSink trace_sink, NodeId peer, uint32_t mss);
+  // Number of packets the link lets its PacketProtocol queue up for emission
+  // at once.
+  static constexpr size_t kMaxBurstPackets = 4;
+
+  // Packets are released in bursts: every packet whose paced send time falls
+  // in the current |pacing_quantum| wide slot is emitted together.
+  PacketLink(Router* router, TraceSink trace_sink, NodeId peer, uint32_t mss,
+             TimeDelta pacing_quantum = TimeDelta::Zero());
   void Close(Callback<void> quiesced) override final;
   void Forward(Message message) override final;
   void Process(TimeStamp received, Slice packet);
   virtual void Emit(Slice packet) = 0;
+  // Emits a burst of packets, in order. Links that can send several packets
+  // more cheaply than one at a time (e.g. with sendmmsg) should override this.
+  virtual void EmitBurst(std::vector<Slice> packets);
   LinkMetrics GetLinkMetrics() override final;
 
  private:
@@ -26,31 +38,34 @@ class PacketLink : public Link, private PacketProtocol::PacketSender {
                   Callback<void> done) override final;
   Status ProcessBody(TimeStamp received, Slice packet);
   Slice BuildPacket(LazySliceArgs args);
+  // Space left for a routed message in any packet without other content.
+  uint32_t ForwardingMSS() const { return std::max(8u, protocol_.mss()) - 8; }
+  void EmitReady();
+  TimeStamp SlotStart(TimeStamp when) const;
 
   Router* const router_;
   Timer* const timer_;
   const TraceSink trace_sink_;
   const NodeId peer_;
   const uint64_t label_;
+  const TimeDelta pacing_quantum_;
   uint64_t metrics_version_ = 1;
   PacketProtocol protocol_;
   bool sending_ = false;
   Optional<MessageWithPayload> stashed_;
 
   // data for a send
-  std::vector<Slice> send_slices_;
+  SliceChain send_chain_;
 
+  // Packets waiting for their (paced) send time, in send time order.
   struct Emitting {
-    Emitting(Timer* timer, TimeStamp when, Slice slice, Callback<void> done,
-             StatusCallback timer_cb)
-        : slice(std::move(slice)),
-          done(std::move(done)),
-          timeout(timer, when, std::move(timer_cb)) {}
+    TimeStamp when;
     Slice slice;
     Callback<void> done;
-    Timeout timeout;
   };
-  Optional<Emitting> emitting_;
+  std::deque<Emitting> emitting_;
+  Optional<Timeout> emit_timeout_;
+  bool in_emit_ready_ = false;
 
   std::queue<Message> outgoing_;
 };
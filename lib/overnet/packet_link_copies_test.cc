@@ -0,0 +1,143 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Counts the bytes copied by framing for each message sent between routers
+// over PacketLinks: once when a message is sent to a neighbor, and again when
+// it's forwarded through an intermediate node.
+
+#include <memory>
+#include "benchmark_summary.h"
+#include "gtest/gtest.h"
+#include "packet_link.h"
+#include "test_timer.h"
+
+namespace overnet {
+namespace packet_link_copies_test {
+
+static constexpr uint32_t kMSS = 1500;
+static constexpr uint64_t kMessages = 1000;
+static const TimeDelta kLinkDelay = TimeDelta::FromMilliseconds(1);
+
+// Connects two PacketLinks, delivering packets after kLinkDelay.
+struct Wire {
+  PacketLink* ends[2] = {nullptr, nullptr};
+};
+
+class WiredLink final : public PacketLink {
+ public:
+  WiredLink(Router* router, NodeId peer, std::shared_ptr<Wire> wire, int end)
+      : PacketLink(router, TraceSink(), peer, kMSS),
+        timer_(router->timer()),
+        wire_(wire),
+        end_(end) {
+    wire_->ends[end_] = this;
+  }
+
+  ~WiredLink() { wire_->ends[end_] = nullptr; }
+
+  void Emit(Slice packet) override {
+    timer_->At(timer_->Now() + kLinkDelay,
+               [timer = timer_, wire = wire_, peer = 1 - end_, packet]() {
+                 if (PacketLink* link = wire->ends[peer]) {
+                   link->Process(timer->Now(), packet);
+                 }
+               });
+  }
+
+ private:
+  Timer* const timer_;
+  const std::shared_ptr<Wire> wire_;
+  const int end_;
+};
+
+void Connect(Router* a, Router* b) {
+  auto wire = std::make_shared<Wire>();
+  a->RegisterLink(MakeLink<WiredLink>(a, b->node_id(), wire, 0));
+  b->RegisterLink(MakeLink<WiredLink>(b, a->node_id(), wire, 1));
+}
+
+class CountingStream final : public Router::StreamHandler {
+ public:
+  void Close(Callback<void> quiesced) override {}
+  void HandleMessage(SeqNum seq, TimeStamp received, Slice data) override {
+    received_++;
+  }
+
+  uint64_t received_ = 0;
+};
+
+// Sends kMessages messages of |message_size| bytes from the first of a chain of
+// |nodes| routers to the last, returning the bytes copied per message.
+double BytesCopiedPerMessage(int nodes, size_t message_size) {
+  TestTimer timer;
+  std::vector<std::unique_ptr<Router>> routers;
+  for (int i = 0; i < nodes; i++) {
+    routers.emplace_back(new Router(&timer, TraceSink(), NodeId(i + 1), false));
+  }
+  for (int i = 1; i < nodes; i++) {
+    Connect(routers[i - 1].get(), routers[i].get());
+  }
+  // Tell each node about the links beyond its neighbors.
+  for (int i = 0; i < nodes; i++) {
+    std::vector<NodeMetrics> node_metrics;
+    std::vector<LinkMetrics> link_metrics;
+    for (int j = 0; j < nodes; j++) {
+      node_metrics.emplace_back(NodeId(j + 1), 1);
+      if (j + 1 < nodes) {
+        link_metrics.emplace_back(NodeId(j + 1), NodeId(j + 2), 1, 1000 + j);
+      }
+    }
+    routers[i]->UpdateRoutingTable(std::move(node_metrics),
+                                   std::move(link_metrics));
+  }
+  Router* const src = routers.front().get();
+  Router* const dst = routers.back().get();
+  while (!src->HasRouteTo(dst->node_id())) {
+    timer.StepUntilNextEvent();
+  }
+
+  CountingStream stream;
+  EXPECT_TRUE(dst->RegisterStream(src->node_id(), StreamId(1), &stream).is_ok());
+
+  const uint64_t copied_before = Slice::BytesCopied();
+  for (uint64_t i = 0; i < kMessages; i++) {
+    src->Forward(Message{
+        std::move(RoutableMessage(src->node_id())
+                      .AddDestination(dst->node_id(), StreamId(1),
+                                      SeqNum(i + 1, kMessages))),
+        ForwardingPayloadFactory(Slice::RepeatedChar(message_size, 'x')),
+        timer.Now()});
+  }
+  while (stream.received_ < kMessages && timer.StepUntilNextEvent()) {
+  }
+  const uint64_t copied = Slice::BytesCopied() - copied_before;
+  EXPECT_EQ(kMessages, stream.received_);
+
+  EXPECT_TRUE(dst->UnregisterStream(src->node_id(), StreamId(1), &stream)
+                  .is_ok());
+  for (auto& router : routers) {
+    router->Close(Callback<void>::Ignored());
+  }
+  while (timer.StepUntilNextEvent()) {
+  }
+  return static_cast<double>(copied) / kMessages;
+}
+
+TEST(PacketLinkCopies, BytesCopiedPerMessage) {
+  BenchmarkSummary writer;
+  for (size_t message_size : {64, 256, 1024}) {
+    const double one_hop = BytesCopiedPerMessage(2, message_size);
+    const double two_hops = BytesCopiedPerMessage(3, message_size);
+    const double forwarded = two_hops - one_hop;
+    writer.Put("message_size", message_size)
+        .Put("copied_sent", one_hop)
+        .Put("copied_forwarded", forwarded)
+        .Put("copies_sent", one_hop / message_size)
+        .Put("copies_forwarded", forwarded / message_size);
+    writer.EndRow();
+  }
+}
+
+}  // namespace packet_link_copies_test
+}  // namespace overnet
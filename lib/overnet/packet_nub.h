@@ -5,6 +5,7 @@
 #pragma once
 
 #include <random>
+#include <vector>
 #include "node_id.h"
 #include "packet_link.h"
 #include "slice.h"
@@ -20,16 +21,26 @@ class PacketNub {
   static constexpr size_t kHelloSize = 256;
   static constexpr uint64_t kAnnounceResendMillis = 1000;
 
-  PacketNub(Timer* timer, TraceSink trace_sink, NodeId node)
+  // |pacing_quantum| is passed to each link's PacketLink: see there.
+  PacketNub(Timer* timer, TraceSink trace_sink, NodeId node,
+            TimeDelta pacing_quantum = TimeDelta::Zero())
       : timer_(timer),
         trace_sink_(trace_sink.Decorate([this](const std::string& msg) {
           std::ostringstream out;
           out << "Nub[" << this << "] " << msg;
           return out.str();
         })),
-        local_node_(node) {}
+        local_node_(node),
+        pacing_quantum_(pacing_quantum) {}
 
   virtual void SendTo(Address dest, Slice slice) = 0;
+  // Sends a burst of packets from one link. Nubs that can send several
+  // datagrams in one operation should override this.
+  virtual void SendBurstTo(Address dest, std::vector<Slice> slices) {
+    for (auto& slice : slices) {
+      SendTo(dest, std::move(slice));
+    }
+  }
   virtual Router* GetRouter() = 0;
   virtual void Publish(LinkPtr<> link) = 0;
 
@@ -136,6 +147,23 @@ class PacketNub {
     }
   }
 
+  // While corked, packets emitted by links are held, then sent as one burst
+  // per link when uncorked. Wrapping the processing of a batch of received
+  // packets in Cork/Uncork lets the acks and replies they cause go out
+  // together.
+  void Cork() { corked_++; }
+  void Uncork() {
+    assert(corked_ > 0);
+    if (--corked_ > 0) {
+      return;
+    }
+    auto corked_sends = std::move(corked_sends_);
+    corked_sends_.clear();
+    for (auto& sends : corked_sends) {
+      SendBurst(sends.first, std::move(sends.second));
+    }
+  }
+
   void Initiate(Address peer, NodeId node) {
     Link* link = link_for(peer);
     OVERNET_TRACE(DEBUG, link->trace_sink) << "Initiate";
@@ -162,7 +190,7 @@ class PacketNub {
                 out << "addr:" << address << " " << message;
                 return out.str();
               }),
-              peer, kMSS),
+              peer, kMSS, nub->pacing_quantum_),
           nub_(nub),
           address_(address) {}
 
@@ -174,13 +202,39 @@ class PacketNub {
       nub_->links_.erase(it);
     }
 
-    void Emit(Slice packet) { nub_->SendTo(address_, std::move(packet)); }
+    void Emit(Slice packet) {
+      std::vector<Slice> packets;
+      packets.emplace_back(std::move(packet));
+      EmitBurst(std::move(packets));
+    }
+    void EmitBurst(std::vector<Slice> packets) {
+      nub_->SendBurst(address_, std::move(packets));
+    }
 
    private:
     PacketNub* const nub_;
     const Address address_;
   };
 
+  void SendBurst(Address address, std::vector<Slice> packets) {
+    if (corked_ > 0) {
+      EqAddress eq;
+      for (auto& sends : corked_sends_) {
+        if (eq(sends.first, address)) {
+          for (auto& packet : packets) {
+            sends.second.emplace_back(std::move(packet));
+          }
+          return;
+        }
+      }
+      corked_sends_.emplace_back(address, std::move(packets));
+    } else if (packets.size() == 1) {
+      SendTo(address, std::move(packets.front()));
+    } else {
+      SendBurstTo(address, std::move(packets));
+    }
+  }
+
   static constexpr bool AllZeros(const uint8_t* begin, const uint8_t* end) {
     for (const uint8_t* p = begin; p != end; ++p) {
       if (*p != 0)
@@ -345,6 +399,9 @@ class PacketNub {
   Timer* const timer_;
   const TraceSink trace_sink_;
   const NodeId local_node_;
+  const TimeDelta pacing_quantum_;
+  int corked_ = 0;
+  std::vector<std::pair<Address, std::vector<Slice>>> corked_sends_;
   std::unordered_map<Address, Link, HashAddress, EqAddress> links_;
   std::mt19937_64 rng_;
 };
@@ -46,7 +46,8 @@ void PacketProtocol::Send(LazySlice make_payload, SendCallback on_ack) {
   OVERNET_TRACE(DEBUG, trace_sink_)
       << "Send state=" << static_cast<int>(state_)
       << " qsize=" << queued_.size() << " outstanding=" << outstanding_.size()
-      << " sending=" << sending_.has_value();
+      << " sending=" << sending_.has_value()
+      << " at_sender=" << packets_at_sender_;
   if (state_ != State::READY) {
     // Discard result, forcing callbacks to be made
     return;
@@ -55,7 +56,10 @@ void PacketProtocol::Send(LazySlice make_payload, SendCallback on_ack) {
 }
 
 void PacketProtocol::MaybeSendSlice(QueuedPacket&& packet) {
-  if (!queued_.empty() || sending_) {
+  // Sends made while a packet is being generated are queued, and picked up by
+  // ContinueSending once the sender has taken that packet.
+  if (!queued_.empty() || sending_ || transmitting_ ||
+      packets_at_sender_ >= options_.max_burst_packets) {
     queued_.emplace_back(std::forward<QueuedPacket>(packet));
     return;
   }
@@ -92,14 +96,17 @@ void PacketProtocol::TransmitPacket() {
   outstanding_.emplace_back(
       OutstandingPacket{max_seen_, Nothing, std::move(sending_->on_ack)});
   auto send_fn = std::move(sending_->payload_factory);
+  sending_.Reset();
   send_fn.AddMutator([seq_idx, self = OutstandingOp<kTransmitPacket>(this)](
                          auto payload, LazySliceArgs args) {
     OVERNET_TRACE(DEBUG, self->trace_sink_) << "GeneratePacket seq=" << seq_idx;
     const auto outstanding_idx = seq_idx - self->send_tip_;
-    if (outstanding_idx >= self->outstanding_.size())
-      return Slice();
-    if (self->outstanding_[outstanding_idx].on_ack.empty())
+    if (outstanding_idx >= self->outstanding_.size() ||
+        self->outstanding_[outstanding_idx].on_ack.empty()) {
+      // Nacked before we got to send it: give back its congestion window.
+      self->outgoing_bbr_.CancelTransmit();
       return Slice();
+    }
     auto slice = self->GeneratePacket(std::move(payload), args);
     assert(!self->outstanding_[outstanding_idx].bbr_sent_packet.has_value());
     self->outstanding_[outstanding_idx].bbr_sent_packet =
@@ -108,11 +115,17 @@ void PacketProtocol::TransmitPacket() {
             BBR::OutgoingPacket{seq_idx, slice.length()});
     return slice;
   });
+  ++packets_at_sender_;
+  transmitting_ = true;
   packet_sender_->SendPacket(seq_num, std::move(send_fn),
                              [self = OutstandingOp<kStartNext>(this)]() {
-                               self->sending_.Reset();
+                               --self->packets_at_sender_;
                                self->ContinueSending();
                              });
+  transmitting_ = false;
+  // Keep filling the burst (or pick up where a synchronous completion left
+  // off).
+  ContinueSending();
 }
 
 Slice PacketProtocol::GeneratePacket(LazySlice payload, LazySliceArgs args) {
@@ -122,9 +135,14 @@ Slice PacketProtocol::GeneratePacket(LazySlice payload, LazySliceArgs args) {
     const uint8_t ack_length_length =
         varint::WireSizeFor(ack_writer.wire_length());
     const uint64_t prefix_length = ack_length_length + ack_writer.wire_length();
+    stats_.acks_sent++;
+    stats_.ack_bytes_sent += prefix_length;
     auto payload_slice = payload(LazySliceArgs{
         args.desired_prefix + prefix_length, args.max_length - prefix_length,
         true, args.delay_until_time});
+    if (payload_slice.length() == 0) {
+      stats_.pure_acks_sent++;
+    }
     return payload_slice.WithPrefix(
         prefix_length, [&ack_writer, ack_length_length](uint8_t* p) {
           ack_writer.Write(
@@ -167,20 +185,23 @@ Status PacketProtocol::HandleAck(const AckFrame& ack) {
     recv_tip_ = new_recv_tip;
   }
   // Fail any nacked packets.
-  for (auto nack_seq : ack.nack_seqs()) {
-    if (nack_seq < send_tip_) {
+  for (const auto& nack : ack.nack_ranges()) {
+    if (nack.high < send_tip_) {
       continue;
     }
-    if (nack_seq >= send_tip_ + outstanding_.size()) {
+    if (nack.high >= send_tip_ + outstanding_.size()) {
       return Status(StatusCode::INVALID_ARGUMENT, "Nack past sending sequence");
     }
-    OutstandingPacket& pkt = outstanding_[nack_seq - send_tip_];
-    auto cb = std::move(pkt.on_ack);
-    if (!cb.empty()) {
-      nacks.emplace_back(std::move(cb));
-    }
-    if (pkt.bbr_sent_packet.has_value()) {
-      bbr_ack.nacked_packets.push_back(*pkt.bbr_sent_packet);
+    const uint64_t low = std::max(nack.low, send_tip_);
+    for (uint64_t nack_seq = nack.high; nack_seq >= low; nack_seq--) {
+      OutstandingPacket& pkt = outstanding_[nack_seq - send_tip_];
+      auto cb = std::move(pkt.on_ack);
+      if (!cb.empty()) {
+        nacks.emplace_back(std::move(cb));
+      }
+      if (pkt.bbr_sent_packet.has_value()) {
+        bbr_ack.nacked_packets.push_back(*pkt.bbr_sent_packet);
+      }
     }
   }
   // Clear out outstanding packet references, propagating acks.
@@ -198,8 +219,11 @@ Status PacketProtocol::HandleAck(const AckFrame& ack) {
   }
   outgoing_bbr_.OnAck(bbr_ack);
 
+  // A nacked packet may be sent again, unless we're closing.
+  const Status& nack_status =
+      state_ == State::READY ? Status::Unavailable() : Status::Cancelled();
   for (auto& cb : nacks) {
-    cb(Status::Cancelled());
+    cb(nack_status);
   }
   for (auto& cb : acks) {
     cb(Status::Ok());
@@ -212,7 +236,9 @@ Status PacketProtocol::HandleAck(const AckFrame& ack) {
 }
 
 void PacketProtocol::ContinueSending() {
-  while (!queued_.empty() && !sending_ && state_ == State::READY) {
+  while (!queued_.empty() && !sending_ && !transmitting_ &&
+         packets_at_sender_ < options_.max_burst_packets &&
+         state_ == State::READY) {
     QueuedPacket p = std::move(queued_.front());
     queued_.pop_front();
     SendSlice(std::move(p));
@@ -314,8 +340,7 @@ PacketProtocol::ProcessedPacket PacketProtocol::Process(TimeStamp received,
   if (suppress_ack) {
     OVERNET_TRACE(DEBUG, trace_sink_) << "ack suppressed";
   } else {
-    if (seq_idx >= kMaxUnackedReceives &&
-        max_acked_ <= seq_idx - kMaxUnackedReceives) {
+    if (seq_idx >= max_acked_ + options_.max_unacked_receives) {
       ack = ProcessedPacket::Ack::FORCE;
     } else {
       ack = ProcessedPacket::Ack::SCHEDULE;
@@ -333,8 +358,16 @@ PacketProtocol::ProcessedPacket PacketProtocol::Process(TimeStamp received,
           .Then([&slice]() -> StatusType { return slice; }));
 }  // namespace overnet
 
+// An ack is needed while the peer may not have seen one covering max_seen_.
 bool PacketProtocol::AckIsNeeded() const { return max_seen_ > recv_tip_; }
 
+// A pure ack is worth sending immediately once enough packets have arrived
+// since the last one, or once the ack delay has elapsed.
+bool PacketProtocol::AckIsDue() const {
+  return max_seen_ >= max_acked_ + options_.max_unacked_receives ||
+         last_ack_send_ + AckDelay() <= timer_->Now();
+}
+
 Optional<AckFrame> PacketProtocol::GenerateAck() {
   OVERNET_TRACE(DEBUG, trace_sink_)
       << "GenerateAck: max_seen=" << max_seen_ << " recv_tip=" << recv_tip_
@@ -342,12 +375,14 @@ Optional<AckFrame> PacketProtocol::GenerateAck() {
   if (!AckIsNeeded()) {
     return Nothing;
   }
-  if (last_ack_send_ + QuarterRTT() > timer_->Now()) {
-    MaybeScheduleAck();
+  const auto now = timer_->Now();
+  // New information always rides along; otherwise the previous ack is only
+  // repeated (in case it was lost) once per ack delay.
+  if (max_seen_ == max_acked_ && last_ack_send_ + AckDelay() > now) {
     return Nothing;
   }
-  const auto now = timer_->Now();
   last_ack_send_ = now;
+  max_acked_ = max_seen_;
   assert(max_seen_time_ <= now);
   AckFrame ack(max_seen_, (now - max_seen_time_).as_us());
   if (max_seen_ >= 1) {
@@ -382,10 +417,14 @@ TimeDelta PacketProtocol::QuarterRTT() const {
   return est / 4;
 }
 
+TimeDelta PacketProtocol::AckDelay() const {
+  return std::min(QuarterRTT(), options_.max_ack_delay);
+}
+
 void PacketProtocol::MaybeScheduleAck() {
   if (!ack_scheduler_.has_value()) {
     ack_scheduler_.Reset(
-        timer_, timer_->Now() + QuarterRTT(),
+        timer_, timer_->Now() + AckDelay(),
         [self = OutstandingOp<kMaybeScheduleAck>(this)](const Status& status) {
           if (status.is_error())
             return;
@@ -399,24 +438,51 @@ void PacketProtocol::MaybeSendAck() {
   OVERNET_TRACE(DEBUG, trace_sink_)
       << "MaybeSendAck: max_seen=" << max_seen_ << " recv_tip=" << recv_tip_
       << " n=" << (max_seen_ - recv_tip_) << " last_ack_send=" << last_ack_send_
-      << " 1/4-rtt=" << QuarterRTT() << " now=" << timer_->Now()
-      << " sending=" << (sending_ ? "true" : "false");
-  if (AckIsNeeded()) {
+      << " max_acked=" << max_acked_ << " ack_delay=" << AckDelay()
+      << " now=" << timer_->Now() << " sending=" << Sending();
+  // Pure acks are only sent for packets no ack has covered yet, and that the
+  // peer doesn't already know we've seen: acks that were already sent are
+  // repeated by piggybacking on data.
+  if (!AckIsNeeded() || max_seen_ <= max_acked_) {
+    return;
+  }
+  if (packets_at_sender_ > 0) {
+    // Packets at the sender are generated lazily, and may yet carry this ack:
+    // check again once they're done.
+    ack_after_sending_ = true;
+  } else if (!AckIsDue()) {
+    MaybeScheduleAck();
+  } else if (state_ != State::READY) {
+    return;
+  } else if (!sending_) {
+    MaybeSendSlice(PureAck());
     if (sending_) {
-      ack_after_sending_ = true;
-    } else if (last_ack_send_ + QuarterRTT() > timer_->Now()) {
-      MaybeScheduleAck();
-    } else {
-      Send([](auto) { return Slice(); },
-           [self = OutstandingOp<kMaybeSendAck>(this)](const Status& status) {
-             if (status.is_error() && self->state_ == State::READY) {
-               self->MaybeScheduleAck();
-             }
-           });
+      // The pure ack is waiting for the congestion window, which may in turn
+      // be waiting for the peer to hear this ack: send it now.
+      outgoing_bbr_.ExpediteTransmit();
     }
+  } else {
+    // The next data packet is waiting for the congestion window, which may in
+    // turn be waiting for the peer to hear this ack. Only the ack may skip the
+    // window: put the data packet back at the head of the queue, and let a
+    // pure ack take its place in the pending transmit. The data packet
+    // requests the window again once the ack has been handed to the sender.
+    queued_.emplace_front(sending_.Take());
+    sending_.Reset(PureAck());
+    outgoing_bbr_.ExpediteTransmit();
   }
 }
 
+PacketProtocol::QueuedPacket PacketProtocol::PureAck() {
+  return QueuedPacket{
+      [](auto) { return Slice(); },
+      [self = OutstandingOp<kMaybeSendAck>(this)](const Status& status) {
+        if (status.is_error() && self->state_ == State::READY) {
+          self->MaybeScheduleAck();
+        }
+      }};
+}
+
 void PacketProtocol::KeepAlive() {
   last_keepalive_event_ = timer_->Now();
   OVERNET_TRACE(DEBUG, trace_sink_) << "KeepAlive " << last_keepalive_event_
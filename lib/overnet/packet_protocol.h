@@ -34,8 +34,27 @@ class PacketProtocol {
 
   static constexpr size_t kMaxUnackedReceives = 3;
 
+  struct Options {
+    // Maximum number of packets that may be handed to the PacketSender before
+    // the first of them completes. With a value greater than one, queued sends
+    // are drained back to back (as far as congestion control allows) into a
+    // burst that the sender can emit together.
+    size_t max_burst_packets = 1;
+    // Force an acknowledgement once this many packets have been received since
+    // the last one was sent.
+    uint64_t max_unacked_receives = kMaxUnackedReceives;
+    // Upper bound on how long an acknowledgement may be held back waiting for
+    // outgoing data to piggyback on. Acks are otherwise delayed by up to a
+    // quarter of the round trip time.
+    TimeDelta max_ack_delay = TimeDelta::PositiveInf();
+  };
+
   PacketProtocol(Timer* timer, PacketSender* packet_sender,
                  TraceSink trace_sink, uint64_t mss)
+      : PacketProtocol(timer, packet_sender, trace_sink, mss, Options()) {}
+
+  PacketProtocol(Timer* timer, PacketSender* packet_sender,
+                 TraceSink trace_sink, uint64_t mss, Options options)
       : timer_(timer),
         packet_sender_(packet_sender),
         trace_sink_(trace_sink.Decorate([this](const std::string& msg) {
@@ -44,7 +63,11 @@ class PacketProtocol {
           return out.str();
         })),
         mss_(mss),
-        outgoing_bbr_(timer_, trace_sink_, mss_, Nothing) {}
+        options_(options),
+        outgoing_bbr_(timer_, trace_sink_, mss_, Nothing) {
+    assert(options_.max_burst_packets > 0);
+    assert(options_.max_unacked_receives > 0);
+  }
 
   void Close(Callback<void> quiesced);
 
@@ -64,6 +87,17 @@ class PacketProtocol {
 
   TimeDelta RoundTripTime() { return outgoing_bbr_.rtt(); }
 
+  struct Stats {
+    // Packets carrying an acknowledgement, and how many of those carried
+    // nothing else.
+    uint64_t acks_sent = 0;
+    uint64_t pure_acks_sent = 0;
+    // Total bytes of ack frames (including their length prefix) sent.
+    uint64_t ack_bytes_sent = 0;
+  };
+
+  const Stats& stats() const { return stats_; }
+
  private:
   // Placing an OutstandingOp on a PacketProtocol object prevents it from
   // quiescing
@@ -143,10 +177,14 @@ class PacketProtocol {
   };
 
   bool AckIsNeeded() const;
+  bool AckIsDue() const;
+  bool Sending() const { return sending_ || packets_at_sender_ > 0; }
   TimeDelta QuarterRTT() const;
+  TimeDelta AckDelay() const;
   void MaybeForceAck();
   void MaybeScheduleAck();
   void MaybeSendAck();
+  QueuedPacket PureAck();
   void MaybeSendSlice(QueuedPacket&& packet);
   void SendSlice(QueuedPacket&& packet);
   void TransmitPacket();
@@ -180,6 +218,7 @@ class PacketProtocol {
   PacketSender* const packet_sender_;
   const TraceSink trace_sink_;
   const uint64_t mss_;
+  const Options options_;
 
   enum class State { READY, CLOSING, CLOSED };
 
@@ -193,11 +232,16 @@ class PacketProtocol {
   uint64_t send_tip_ = 1;
   std::deque<OutstandingPacket> outstanding_;
   std::deque<QueuedPacket> queued_;
+  // Packet waiting for congestion control to allow its transmission.
   Optional<QueuedPacket> sending_;
+  // Packets handed to packet_sender_ that have not completed.
+  size_t packets_at_sender_ = 0;
+  bool transmitting_ = false;
 
   uint64_t recv_tip_ = 0;
   uint64_t max_seen_ = 0;
   TimeStamp max_seen_time_ = TimeStamp::Epoch();
+  // Highest sequence number covered by an ack we've sent.
   uint64_t max_acked_ = 0;
   uint64_t max_outstanding_size_ = 0;
 
@@ -214,6 +258,8 @@ class PacketProtocol {
 
   int outstanding_ops_ = 0;
 
+  Stats stats_;
+
   Optional<Timeout> ack_scheduler_;
   Optional<Timeout> rto_scheduler_;
 };
@@ -22,8 +22,11 @@ class PacketProtocolFuzzer {
           [this](const Status& status) {
             if (done_)
               return;
-            if (!status.is_ok() && status.code() != StatusCode::CANCELLED) {
-              std::cerr << "Expected each send to be ok or cancelled, got: "
+            // Nacked packets report UNAVAILABLE, so that they can be resent.
+            if (!status.is_ok() && status.code() != StatusCode::UNAVAILABLE &&
+                status.code() != StatusCode::CANCELLED) {
+              std::cerr << "Expected each send to be ok, unavailable or "
+                           "cancelled, got: "
                         << status << "\n";
               abort();
             }
@@ -60,18 +60,31 @@ Slice RoutableMessage::Write(NodeId writer, NodeId target,
   HeaderInfo hinf;
   // Serialize the message.
   return payload.WithPrefix(
-      HeaderLength(writer, target, &hinf), [this, &hinf](uint8_t* data) {
-        uint8_t* p = data;
-        p = varint::Write(hinf.flags, hinf.flags_length, p);
-        if (!hinf.is_local)
-          p = src_.Write(p);
-        for (size_t i = 0; i < dsts_.size(); i++) {
-          if (!hinf.is_local)
-            p = dsts_[i].dst().Write(p);
-          p = dsts_[i].stream_id().Write(hinf.stream_id_len[i], p);
-          p = dsts_[i].seq().Write(p);
-        }
-      });
+      HeaderLength(writer, target, &hinf),
+      [this, &hinf](uint8_t* data) { WriteHeader(hinf, data); });
+}
+
+SliceChain RoutableMessage::Write(NodeId writer, NodeId target,
+                                  SliceChain payload) const {
+  HeaderInfo hinf;
+  payload.AddPrefix(
+      HeaderLength(writer, target, &hinf),
+      [this, &hinf](uint8_t* data) { WriteHeader(hinf, data); });
+  return payload;
+}
+
+uint8_t* RoutableMessage::WriteHeader(const HeaderInfo& hinf,
+                                      uint8_t* p) const {
+  p = varint::Write(hinf.flags, hinf.flags_length, p);
+  if (!hinf.is_local)
+    p = src_.Write(p);
+  for (size_t i = 0; i < dsts_.size(); i++) {
+    if (!hinf.is_local)
+      p = dsts_[i].dst().Write(p);
+    p = dsts_[i].stream_id().Write(hinf.stream_id_len[i], p);
+    p = dsts_[i].seq().Write(p);
+  }
+  return p;
 }
 
 StatusOr<MessageWithPayload> RoutableMessage::Parse(Slice data, NodeId reader,
@@ -10,6 +10,7 @@
 #include "optional.h"
 #include "seq_num.h"
 #include "slice.h"
+#include "slice_chain.h"
 #include "status.h"
 #include "stream_id.h"
 #include "varint.h"
@@ -75,6 +76,9 @@ class RoutableMessage {
   static StatusOr<MessageWithPayload> Parse(Slice source, NodeId reader,
                                             NodeId writer);
   Slice Write(NodeId writer, NodeId target, Slice payload) const;
+  // As above, but prefixes the header to a chain rather than copying the
+  // payload.
+  SliceChain Write(NodeId writer, NodeId target, SliceChain payload) const;
 
   RoutableMessage& AddDestination(NodeId peer, StreamId stream, SeqNum seq) {
     dsts_.emplace_back(peer, stream, seq);
@@ -115,6 +119,7 @@ class RoutableMessage {
   };
 
   size_t HeaderLength(NodeId writer, NodeId target, HeaderInfo* hinf) const;
+  uint8_t* WriteHeader(const HeaderInfo& hinf, uint8_t* p) const;
 };
 
 struct MessageWithPayload {
@@ -3,12 +3,17 @@
 // found in the LICENSE file.
 
 #include "router.h"
+#include <cmath>
 #include <iostream>
 
 namespace overnet {
 
 static constexpr TimeDelta kPollLinkChangeTimeout =
     TimeDelta::FromMilliseconds(100);
+// How often to pass fresh metrics (bandwidth and rtt estimates) for our links
+// to the routing table while forwarding.
+static constexpr TimeDelta kLinkMetricsRefreshInterval =
+    TimeDelta::FromSeconds(1);
 
 Router::~Router() { shutting_down_ = true; }
 
@@ -65,6 +70,7 @@ void Router::Forward(Message message) {
     return;
   }
   assert(!message.make_payload.empty());
+  MaybeRefreshLinkMetrics();
   // There are three primary cases we care about here, that can be discriminated
   // based on the destination count of the message:
   // 1. If there are zero destinations, this is a malformed message (fail).
@@ -90,7 +96,8 @@ void Router::Forward(Message message) {
                            message.make_payload(LazySliceArgs{
                                0, std::numeric_limits<uint32_t>::max()}));
       } else {
-        link_holder(dst.dst())->Forward(std::move(message));
+        link_holder(dst.dst())
+            ->Forward(std::move(message), spread_unordered_messages_);
       }
     } break;
     default: {
@@ -139,9 +146,11 @@ void Router::Forward(Message message) {
             message.received));
       }
       for (auto& lh : disconnected_holders) {
-        lh.second->Forward(Message::SimpleForwarder(
-            message.header.WithDestinations({lh.first}), payload,
-            message.received));
+        lh.second->Forward(
+            Message::SimpleForwarder(
+                message.header.WithDestinations({lh.first}), payload,
+                message.received),
+            spread_unordered_messages_);
       }
       if (handle_locally.has_value()) {
         handle_locally->second->HandleMessage(
@@ -172,7 +181,8 @@ void Router::MaybeStartPollingLinkChanges() {
                 // Clear routing information for now unreachable links.
                 for (auto& lnk : links_) {
                   if (selected_links.count(lnk.first) == 0) {
-                    lnk.second.SetLink(nullptr, 0);
+                    lnk.second.SetLink(nullptr, 0, {},
+                                       spread_unordered_messages_);
                   }
                 }
                 // Set routing information for other links.
@@ -181,9 +191,22 @@ void Router::MaybeStartPollingLinkChanges() {
                       << "Select: " << sl.first << " " << sl.second.link_id
                       << " (route_mss=" << sl.second.route_mss << ")";
                   auto it = owned_links_.find(sl.second.link_id);
+                  std::vector<LinkHolder::Path> multipath;
+                  for (const auto& path_link : sl.second.multipath) {
+                    auto path_it = owned_links_.find(path_link.link_id);
+                    if (path_it != owned_links_.end()) {
+                      multipath.emplace_back(
+                          LinkHolder::Path{path_it->second.get(),
+                                           path_link.link_id, path_link.share});
+                    }
+                  }
+                  if (multipath.size() < 2) {
+                    multipath.clear();
+                  }
                   link_holder(sl.first)->SetLink(
                       it == owned_links_.end() ? nullptr : it->second.get(),
-                      sl.second.route_mss);
+                      sl.second.route_mss, std::move(multipath),
+                      spread_unordered_messages_);
                 }
                 MaybeStartFlushingOldEntries();
               });
@@ -206,6 +229,20 @@ void Router::MaybeStartFlushingOldEntries() {
                                  });
 }
 
+void Router::MaybeRefreshLinkMetrics() {
+  const auto now = timer_->Now();
+  if (owned_links_.empty() ||
+      now - last_link_metrics_refresh_ < kLinkMetricsRefreshInterval) {
+    return;
+  }
+  last_link_metrics_refresh_ = now;
+  std::vector<LinkMetrics> link_metrics;
+  for (const auto& link : owned_links_) {
+    link_metrics.emplace_back(link.second->GetLinkMetrics());
+  }
+  UpdateRoutingTable({}, std::move(link_metrics), false);
+}
+
 Status Router::RegisterStream(NodeId peer, StreamId stream_id,
                               StreamHandler* stream_handler) {
   OVERNET_TRACE(DEBUG, trace_sink_) << "RegisterStream: " << peer << "/"
@@ -262,22 +299,83 @@ Status Router::StreamHolder::ClearHandler(StreamHandler* handler) {
   return Status::Ok();
 }
 
-void Router::LinkHolder::Forward(Message message) {
+void Router::LinkHolder::Forward(Message message, bool spread_unordered) {
   if (link_ == nullptr) {
     OVERNET_TRACE(DEBUG, trace_sink_) << "Queue: " << message.header;
     pending_.emplace_back(std::move(message));
   } else {
-    link_->Forward(std::move(message));
+    ChooseLink(message, spread_unordered)->Forward(std::move(message));
   }
 }
 
-void Router::LinkHolder::SetLink(Link* link, uint32_t path_mss) {
+void Router::LinkHolder::SetLink(Link* link, uint32_t path_mss,
+                                 std::vector<Path> multipath,
+                                 bool spread_unordered) {
   link_ = link;
+  path_mss_ = path_mss;
+  multipath_ = std::move(multipath);
+  round_robin_credit_.assign(multipath_.size(), 0);
+  if (link_ == nullptr) {
+    return;
+  }
   std::vector<Message> pending;
   pending.swap(pending_);
   for (auto& p : pending) {
-    link_->Forward(std::move(p));
+    ChooseLink(p, spread_unordered)->Forward(std::move(p));
+  }
+}
+
+static uint64_t MixBits(uint64_t x) {
+  // splitmix64 finalizer
+  x ^= x >> 30;
+  x *= 0xbf58476d1ce4e5b9ull;
+  x ^= x >> 27;
+  x *= 0x94d049bb133111ebull;
+  x ^= x >> 31;
+  return x;
+}
+
+Link* Router::LinkHolder::ChooseLink(const Message& message,
+                                     bool spread_unordered) {
+  if (multipath_.empty()) {
+    return link_;
+  }
+
+  if (message.unordered && spread_unordered) {
+    // Smooth weighted round robin: interleaves links in proportion to their
+    // shares.
+    int64_t total = 0;
+    size_t best = 0;
+    for (size_t i = 0; i < multipath_.size(); i++) {
+      round_robin_credit_[i] += multipath_[i].share;
+      total += multipath_[i].share;
+      if (round_robin_credit_[i] > round_robin_credit_[best]) {
+        best = i;
+      }
+    }
+    round_robin_credit_[best] -= total;
+    return multipath_[best].link;
+  }
+
+  // Weighted rendezvous hashing on the stream: each stream sticks to one link
+  // (so its messages stay in order), streams are spread in proportion to link
+  // shares, and few streams move when shares change.
+  const auto& dst = message.header.destinations()[0];
+  const uint64_t stream_hash =
+      MixBits(message.header.src().Hash() ^ MixBits(dst.stream_id().Hash()));
+  Link* best_link = link_;
+  double best_score = 0;
+  for (const auto& path : multipath_) {
+    const uint64_t hash = MixBits(stream_hash ^ path.link_id);
+    // Uniform in (0, 1).
+    const double u = (static_cast<double>(hash >> 11) + 0.5) / (1ull << 53);
+    const double score = -static_cast<double>(path.share) / std::log(u);
+    if (score > best_score) {
+      best_score = score;
+      best_link = path.link;
+    }
   }
+  return best_link;
 }
 
 }  // namespace overnet
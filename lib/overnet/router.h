@@ -50,6 +50,9 @@ struct Message final {
   RoutableMessage header;
   LazySlice make_payload;
   TimeStamp received;
+  // Set if this message may be delivered out of order with respect to other
+  // messages on its stream, allowing it to take any of several paths.
+  bool unordered = false;
 
   static Message SimpleForwarder(RoutableMessage msg, Slice payload,
                                  TimeStamp received) {
@@ -120,6 +123,13 @@ class Router final {
     routing_table_.BlockUntilNoBackgroundUpdatesProcessing();
   }
 
+  // When there are several links to a destination's next hop, each stream is
+  // assigned one of them in proportion to their capacity. If this is set,
+  // messages marked unordered are instead spread across all of them.
+  void set_spread_unordered_messages(bool spread) {
+    spread_unordered_messages_ = spread;
+  }
+
   // Return true if this router believes a route exists to a particular node.
   bool HasRouteTo(NodeId node_id) {
     return node_id == node_id_ || link_holder(node_id)->link() != nullptr;
@@ -138,6 +148,7 @@ class Router final {
 
   void MaybeStartPollingLinkChanges();
   void MaybeStartFlushingOldEntries();
+  void MaybeRefreshLinkMetrics();
 
   void CloseLinks(Callback<void> quiesced);
   void CloseStreams(Callback<void> quiesced);
@@ -173,16 +184,30 @@ class Router final {
                 out << "Link[" << this << ";to=" << target << "] " << msg;
                 return out.str();
               })) {}
-    void Forward(Message message);
-    void SetLink(Link* link, uint32_t path_mss);
+    struct Path {
+      Link* link;
+      uint64_t link_id;
+      uint32_t share;
+    };
+
+    void Forward(Message message, bool spread_unordered);
+    void SetLink(Link* link, uint32_t path_mss, std::vector<Path> multipath,
+                 bool spread_unordered);
     Link* link() { return link_; }
     uint32_t path_mss() { return path_mss_; }
 
    private:
+    Link* ChooseLink(const Message& message, bool spread_unordered);
+
     const TraceSink trace_sink_;
     Link* link_ = nullptr;
     uint32_t path_mss_ = std::numeric_limits<uint32_t>::max();
     std::vector<Message> pending_;
+    // Links to share traffic over, if there are several.
+    std::vector<Path> multipath_;
+    // Smooth weighted round robin state for unordered messages, indexed like
+    // multipath_.
+    std::vector<int64_t> round_robin_credit_;
   };
 
   LinkHolder* link_holder(NodeId node_id) {
@@ -199,6 +224,8 @@ class Router final {
   typedef router_impl::LocalStreamId LocalStreamId;
 
   bool shutting_down_ = false;
+  bool spread_unordered_messages_ = false;
+  TimeStamp last_link_metrics_refresh_{TimeStamp::Epoch()};
   std::unordered_map<uint64_t, LinkPtr<>> owned_links_;
 
   std::unordered_map<LocalStreamId, StreamHolder> streams_;
@@ -0,0 +1,205 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Aggregate throughput of multipath forwarding: one router sends a batch of
+// messages on several streams to another over one or more simulated parallel
+// links, and we report how long it takes for everything to arrive.
+
+#include "benchmark_summary.h"
+#include "gtest/gtest.h"
+#include "router.h"
+#include "test_timer.h"
+
+namespace overnet {
+namespace router_multipath_test {
+
+static const NodeId kSender(1);
+static const NodeId kReceiver(2);
+static constexpr uint64_t kMessageSize = 1000;
+static constexpr uint64_t kMessagesPerRun = 4096;
+
+struct LinkSpec {
+  const char* name;
+  Bandwidth bandwidth;
+  TimeDelta rtt;
+};
+
+static const LinkSpec kUsb{"usb", Bandwidth::FromKilobitsPerSecond(100000),
+                           TimeDelta::FromMilliseconds(2)};
+static const LinkSpec kWlan{"wlan", Bandwidth::FromKilobitsPerSecond(50000),
+                            TimeDelta::FromMilliseconds(3)};
+
+// One way link with a fixed bandwidth and propagation delay, which reports
+// those as its metrics (standing in for BBR's estimates).
+class SimulatedLink final : public Link {
+ public:
+  SimulatedLink(TestTimer* timer, Router* peer, LinkSpec spec, uint64_t label)
+      : timer_(timer), peer_(peer), spec_(spec), label_(label) {}
+
+  void Close(Callback<void> quiesced) override { quiesced(); }
+
+  void Forward(Message message) override {
+    auto payload = message.make_payload(
+        LazySliceArgs{0, std::numeric_limits<uint32_t>::max()});
+    bytes_ += payload.length();
+    const auto start = std::max(timer_->Now(), free_at_);
+    free_at_ = start + spec_.bandwidth.SendTimeForBytes(payload.length());
+    auto header = std::make_shared<RoutableMessage>(std::move(message.header));
+    timer_->At(free_at_ + spec_.rtt / 2,
+               [this, header, payload = std::move(payload)]() {
+                 peer_->Forward(Message::SimpleForwarder(
+                     std::move(*header), payload, timer_->Now()));
+               });
+  }
+
+  LinkMetrics GetLinkMetrics() override {
+    LinkMetrics m(kSender, kReceiver, ++version_, label_);
+    m.set_bw_link(spec_.bandwidth);
+    m.set_rtt(spec_.rtt);
+    return m;
+  }
+
+  uint64_t bytes() const { return bytes_; }
+
+ private:
+  TestTimer* const timer_;
+  Router* const peer_;
+  const LinkSpec spec_;
+  const uint64_t label_;
+  uint64_t version_ = 0;
+  TimeStamp free_at_{TimeStamp::Epoch()};
+  uint64_t bytes_ = 0;
+};
+
+// Counts messages arriving on a stream, and checks they arrive in order.
+class CountingStream final : public Router::StreamHandler {
+ public:
+  void Close(Callback<void> quiesced) override {}
+  void HandleMessage(SeqNum seq, TimeStamp received, Slice data) override {
+    const auto n = seq.ReconstructFromZero_TestOnly();
+    if (n < last_seq_) {
+      reordered_++;
+    }
+    last_seq_ = n;
+    received_++;
+    last_received_ = received;
+  }
+
+  uint64_t received_ = 0;
+  uint64_t reordered_ = 0;
+  uint64_t last_seq_ = 0;
+  TimeStamp last_received_{TimeStamp::Epoch()};
+};
+
+struct RunResult {
+  TimeDelta elapsed;
+  uint64_t delivered;
+  uint64_t reordered;
+  std::vector<uint64_t> link_bytes;
+};
+
+RunResult Simulate(std::vector<LinkSpec> links, int streams,
+                   bool unordered_spreading) {
+  TestTimer timer;
+  Router sender(&timer, TraceSink(), kSender, false);
+  Router receiver(&timer, TraceSink(), kReceiver, false);
+  sender.set_spread_unordered_messages(unordered_spreading);
+
+  std::vector<CountingStream> counters(streams);
+  for (int i = 0; i < streams; i++) {
+    EXPECT_TRUE(
+        receiver.RegisterStream(kSender, StreamId(i + 1), &counters[i])
+            .is_ok());
+  }
+  std::vector<SimulatedLink*> sim_links;
+  for (const auto& spec : links) {
+    auto link = MakeLink<SimulatedLink>(&timer, &receiver, spec,
+                                        sim_links.size() + 1);
+    sim_links.push_back(link.get());
+    sender.RegisterLink(std::move(link));
+  }
+  // Let routes settle.
+  timer.Step(TimeDelta::FromSeconds(1).as_us());
+  EXPECT_TRUE(sender.HasRouteTo(kReceiver));
+
+  const auto start = timer.Now();
+  for (uint64_t i = 0; i < kMessagesPerRun; i++) {
+    const int stream = i % streams;
+    Message message{
+        std::move(RoutableMessage(kSender).AddDestination(
+            kReceiver, StreamId(stream + 1),
+            SeqNum(i / streams + 1, kMessagesPerRun))),
+        [](auto args) {
+          return Slice::WithInitializerAndPrefix(
+              kMessageSize, args.desired_prefix,
+              [](uint8_t* p) { memset(p, 'x', kMessageSize); });
+        },
+        timer.Now(), unordered_spreading};
+    sender.Forward(std::move(message));
+  }
+  while (timer.StepUntilNextEvent()) {
+  }
+
+  RunResult result{TimeDelta::Zero(), 0, 0, {}};
+  for (const auto& counter : counters) {
+    result.delivered += counter.received_;
+    result.reordered += counter.reordered_;
+    result.elapsed = std::max(result.elapsed, counter.last_received_ - start);
+  }
+  for (auto* link : sim_links) {
+    result.link_bytes.push_back(link->bytes());
+  }
+  return result;
+}
+
+TEST(RouterMultipath, AggregateThroughput) {
+  struct Scenario {
+    const char* name;
+    std::vector<LinkSpec> links;
+    int streams;
+    bool unordered_spreading;
+  };
+  const Scenario scenarios[] = {
+      {"usb", {kUsb}, 32, false},
+      {"usb+wlan/streams", {kUsb, kWlan}, 32, false},
+      {"usb+wlan/unordered", {kUsb, kWlan}, 1, true},
+  };
+
+  BenchmarkSummary writer;
+  double single_path_mbps = 0;
+  for (const auto& scenario : scenarios) {
+    const RunResult r = Simulate(scenario.links, scenario.streams,
+                                 scenario.unordered_spreading);
+    EXPECT_EQ(kMessagesPerRun, r.delivered) << scenario.name;
+    if (!scenario.unordered_spreading) {
+      // Each stream stays on one link.
+      EXPECT_EQ(0u, r.reordered) << scenario.name;
+    }
+
+    const double mbps = 8.0 * r.delivered * kMessageSize / r.elapsed.as_us();
+    if (scenario.links.size() == 1) {
+      single_path_mbps = mbps;
+    } else {
+      for (auto bytes : r.link_bytes) {
+        EXPECT_GT(bytes, 0u) << scenario.name;
+      }
+      EXPECT_GT(mbps, 1.2 * single_path_mbps) << scenario.name;
+    }
+
+    writer.Put("scenario", scenario.name)
+        .Put("streams", scenario.streams)
+        .Put("elapsed", r.elapsed)
+        .Put("delivered", r.delivered)
+        .Put("mbps", mbps)
+        .Put("reordered", r.reordered);
+    for (size_t i = 0; i < scenario.links.size(); i++) {
+      writer.Put(std::string(scenario.links[i].name) + "_bytes",
+                 r.link_bytes[i]);
+    }
+    writer.EndRow();
+  }
+}
+
+}  // namespace router_multipath_test
+}  // namespace overnet
@@ -3,6 +3,8 @@
 // found in the LICENSE file.
 
 #include "routing_table.h"
+#include <algorithm>
+#include <cassert>
 #include <iostream>
 
 using overnet::routing_table_impl::FullLinkLabel;
@@ -24,14 +26,17 @@ void MoveInto(std::vector<T>* from, std::vector<T>* to) {
 
 }  // namespace
 
+// If more than this fraction of links change in one update, routes are
+// recomputed from scratch rather than repaired.
+static constexpr size_t kFullUpdateLinkFraction = 4;
+
 RoutingTable::~RoutingTable() {
   std::unique_lock<std::mutex> lock(mu_);
-  if (processing_changes_) {
-    std::thread pending_processing = std::move(*processing_changes_);
-    processing_changes_.Reset();
+  if (worker_) {
+    stopping_ = true;
     cv_.notify_all();
     lock.unlock();
-    pending_processing.join();
+    worker_->join();
   }
 
   for (auto& n : node_metrics_) {
@@ -46,71 +51,92 @@ void RoutingTable::Update(std::vector<NodeMetrics> node_metrics,
     return;
   std::unique_lock<std::mutex> lock(mu_);
   last_update_ = timer_->Now();
-  const bool was_empty = change_log_.Empty() && !flush_requested_;
   if (flush_old_nodes)
     flush_requested_ = true;
   MoveInto(&node_metrics, &change_log_.node_metrics);
   MoveInto(&link_metrics, &change_log_.link_metrics);
-  if (!was_empty)
-    return;
-  if (processing_changes_)
-    return;
-  auto process_changes = [this, changes = std::move(change_log_),
-                          flush = flush_requested_,
-                          now = last_update_]() mutable {
-    while (true) {
-      ApplyChanges(now, changes, flush);
-      SelectedLinks new_selected_links = BuildForwardingTable();
-
-      // Publish changes. If change-log has grown, restart update.
-      std::lock_guard<std::mutex> lock(mu_);
-      if (selected_links_ != new_selected_links) {
-        selected_links_.swap(new_selected_links);
-        selected_links_version_++;
-      }
-      if (!processing_changes_) {
-        // Indicates that the owning RoutingTable instance is in its destruction
-        // sequence.
-        cv_.notify_all();
-        return;
-      } else if (change_log_.Empty() && !flush_requested_) {
-        processing_changes_->detach();
-        processing_changes_.Reset();
-        cv_.notify_all();
-        return;
-      } else {
-        changes = std::move(change_log_);
-        change_log_.Clear();
-        flush = flush_requested_;
-        flush_requested_ = false;
-        now = last_update_;
-      }
-    }
-  };
   if (allow_threading_) {
-    processing_changes_.Reset(std::move(process_changes));
+    if (!worker_) {
+      worker_.Reset([this]() { RunWorker(); });
+    }
     cv_.notify_all();
+    return;
   }
-  flush_requested_ = false;
+  Metrics changes = std::move(change_log_);
   change_log_.Clear();
-  if (!allow_threading_) {
+  const bool flush = flush_requested_;
+  flush_requested_ = false;
+  processing_ = true;
+  lock.unlock();
+  ProcessChanges(last_update_, changes, flush);
+}
+
+void RoutingTable::RunWorker() {
+  std::unique_lock<std::mutex> lock(mu_);
+  while (true) {
+    cv_.wait(lock, [this]() -> bool { return stopping_ || !Idle(); });
+    if (stopping_) {
+      return;
+    }
+    // Take everything queued so far and process it as one batch.
+    Metrics changes = std::move(change_log_);
+    change_log_.Clear();
+    const bool flush = flush_requested_;
+    flush_requested_ = false;
+    const TimeStamp now = last_update_;
+    processing_ = true;
     lock.unlock();
-    process_changes();
+    ProcessChanges(now, changes, flush);
+    lock.lock();
   }
 }
 
+void RoutingTable::ProcessChanges(TimeStamp now, const Metrics& changes,
+                                  bool flush) {
+  ApplyChanges(now, changes, flush);
+  UpdateRoutes();
+
+  // Publish changes.
+  std::lock_guard<std::mutex> lock(mu_);
+  if (!route_changes_.empty()) {
+    for (const auto& change : route_changes_) {
+      if (change.link.has_value()) {
+        selected_links_[change.node] = *change.link;
+      } else {
+        selected_links_.erase(change.node);
+      }
+    }
+    route_changes_.clear();
+    selected_links_version_++;
+  }
+  processing_ = false;
+  cv_.notify_all();
+}
+
 void RoutingTable::ApplyChanges(TimeStamp now, const Metrics& changes,
                                 bool flush) {
   // Update all metrics from changelogs.
   for (const auto& m : changes.node_metrics) {
     auto it = node_metrics_.find(m.node_id());
     if (it == node_metrics_.end()) {
-      node_metrics_.emplace(std::piecewise_construct,
-                            std::forward_as_tuple(m.node_id()),
-                            std::forward_as_tuple(now, m));
+      Node* node = &node_metrics_
+                        .emplace(std::piecewise_construct,
+                                 std::forward_as_tuple(m.node_id()),
+                                 std::forward_as_tuple(now, m))
+                        .first->second;
+      node->index = nodes_.size();
+      nodes_.push_back(node);
+      graph_changed_ = true;
     } else if (m.version() > it->second.metrics.version()) {
+      const bool forwarding_time_changed =
+          m.forwarding_time() != it->second.metrics.forwarding_time();
       it->second.metrics = m;
       it->second.last_updated = now;
+      if (forwarding_time_changed) {
+        for (auto link : it->second.outgoing_links) {
+          MarkDirty(link);
+        }
+      }
     }
   }
   for (const auto& m : changes.link_metrics) {
@@ -142,12 +168,19 @@ void RoutingTable::ApplyChanges(TimeStamp now, const Metrics& changes,
     if (it == link_metrics_.end()) {
       it = link_metrics_
                .emplace(std::piecewise_construct, std::forward_as_tuple(key),
-                        std::forward_as_tuple(now, m, &to_node->second))
+                        std::forward_as_tuple(now, m, &from_node->second,
+                                              &to_node->second))
                .first;
       from_node->second.outgoing_links.PushBack(&it->second);
+      MarkDirty(&it->second);
+      graph_changed_ = true;
     } else if (m.version() > it->second.metrics.version()) {
+      if (m.version() == METRIC_VERSION_TOMBSTONE) {
+        graph_changed_ = true;
+      }
       it->second.metrics = m;
       it->second.last_updated = now;
+      MarkDirty(&it->second);
     } else {
       report_drop("old version");
     }
@@ -155,19 +188,50 @@ void RoutingTable::ApplyChanges(TimeStamp now, const Metrics& changes,
 
   // Remove anything old if we've been asked to.
   if (flush) {
-    for (auto it = node_metrics_.begin(); it != node_metrics_.end();) {
-      if (it->first == root_node_)
-        continue;
-      if (it->second.last_updated >= now + EntryExpiry()) {
-        RemoveOutgoingLinks(it->second);
-        it = node_metrics_.erase(it);
-      } else {
-        ++it;
+    bool any_expired = false;
+    for (auto& n : node_metrics_) {
+      if (n.first != root_node_ &&
+          now - n.second.last_updated >= EntryExpiry()) {
+        n.second.expired = true;
+        any_expired = true;
       }
     }
+    if (any_expired) {
+      for (auto it = link_metrics_.begin(); it != link_metrics_.end();) {
+        Link* link = &it->second;
+        link->dirty = false;
+        if (link->from_node->expired || link->to_node->expired) {
+          link->from_node->outgoing_links.Remove(link);
+          it = link_metrics_.erase(it);
+        } else {
+          ++it;
+        }
+      }
+      for (auto it = node_metrics_.begin(); it != node_metrics_.end();) {
+        if (it->second.expired) {
+          if (it->second.selected.has_value()) {
+            removed_node_ids_.push_back(it->first);
+          }
+          it = node_metrics_.erase(it);
+        } else {
+          ++it;
+        }
+      }
+      // Routes are recomputed from scratch, so per-link changes don't matter.
+      dirty_links_.clear();
+      graph_changed_ = true;
+      nodes_removed_ = true;
+    }
   }
 }
 
+void RoutingTable::MarkDirty(Link* link) {
+  if (link->dirty)
+    return;
+  link->dirty = true;
+  dirty_links_.push_back(link);
+}
+
 void RoutingTable::RemoveOutgoingLinks(Node& node) {
   while (Link* link = node.outgoing_links.PopFront()) {
     link_metrics_.erase(FullLinkLabel{link->metrics.from(), link->metrics.to(),
@@ -175,70 +239,342 @@ void RoutingTable::RemoveOutgoingLinks(Node& node) {
   }
 }
 
-RoutingTable::SelectedLinks RoutingTable::BuildForwardingTable() {
-  auto node_it = node_metrics_.find(root_node_);
-  if (node_it == node_metrics_.end()) {
-    return SelectedLinks();  // Root node as yet unknown.
+static bool Routable(const LinkMetrics& m) {
+  return m.version() != METRIC_VERSION_TOMBSTONE;
+}
+
+static TimeDelta Weight(const NodeMetrics& from, const LinkMetrics& link) {
+  // For now we order by RTT.
+  return from.forwarding_time() + link.rtt();
+}
+
+void RoutingTable::RebuildGraph() {
+  if (nodes_removed_) {
+    nodes_.clear();
+    for (auto& n : node_metrics_) {
+      n.second.index = nodes_.size();
+      nodes_.push_back(&n.second);
+    }
+  }
+
+  const uint32_t num_nodes = nodes_.size();
+  out_offsets_.assign(num_nodes + 1, 0);
+  in_offsets_.assign(num_nodes + 1, 0);
+  for (Node* node : nodes_) {
+    for (auto link : node->outgoing_links) {
+      link->routable = Routable(link->metrics);
+      if (!link->routable)
+        continue;
+      link->weight = Weight(node->metrics, link->metrics);
+      out_offsets_[node->index + 1]++;
+      in_offsets_[link->to_node->index + 1]++;
+    }
+  }
+  for (uint32_t i = 0; i < num_nodes; i++) {
+    out_offsets_[i + 1] += out_offsets_[i];
+    in_offsets_[i + 1] += in_offsets_[i];
   }
 
-  ++path_finding_run_;
-  node_it->second.last_path_finding_run = path_finding_run_;
-  node_it->second.best_rtt = TimeDelta::Zero();
-  node_it->second.mss = std::numeric_limits<uint32_t>::max();
-  InternalList<Node, &Node::path_finding_node> todo;
+  out_edges_.resize(out_offsets_[num_nodes]);
+  in_edges_.resize(in_offsets_[num_nodes]);
+  std::vector<uint32_t> in_fill(in_offsets_.begin(), in_offsets_.end() - 1);
+  for (Node* node : nodes_) {
+    uint32_t out_fill = out_offsets_[node->index];
+    for (auto link : node->outgoing_links) {
+      if (!link->routable)
+        continue;
+      const uint32_t to = link->to_node->index;
+      link->out_edge = out_fill++;
+      link->in_edge = in_fill[to]++;
+      out_edges_[link->out_edge] = Edge{to, link->weight, link};
+      in_edges_[link->in_edge] = Edge{node->index, link->weight, link};
+    }
+  }
+}
 
-  auto enqueue = [&todo](Node* node) {
-    if (node->queued)
-      return;
-    node->queued = true;
-    todo.PushBack(node);
+void RoutingTable::UpdateRoutes() {
+  // Note the old weight of each changed link before bringing the graph up to
+  // date, so that the shortest path tree can be repaired.
+  struct LinkChange {
+    Link* link;
+    bool was_routable;
+    TimeDelta old_weight;
   };
+  std::vector<LinkChange> link_changes;
+  link_changes.reserve(dirty_links_.size());
+  for (Link* link : dirty_links_) {
+    link->dirty = false;
+    link_changes.emplace_back(LinkChange{link, link->routable, link->weight});
+    link->routable = Routable(link->metrics);
+    link->weight = Weight(link->from_node->metrics, link->metrics);
+    if (link->routable && !graph_changed_) {
+      out_edges_[link->out_edge].weight = link->weight;
+      in_edges_[link->in_edge].weight = link->weight;
+    }
+  }
+  dirty_links_.clear();
 
-  enqueue(&node_it->second);
+  if (graph_changed_) {
+    RebuildGraph();
+    graph_changed_ = false;
+  }
+  if (nodes_removed_) {
+    routes_valid_ = false;
+    nodes_removed_ = false;
+  }
+  routes_.resize(nodes_.size());
+
+  auto root_it = node_metrics_.find(root_node_);
+  root_index_ =
+      root_it == node_metrics_.end() ? kNoNode : root_it->second.index;
 
-  while (!todo.Empty()) {
-    Node* src = todo.PopFront();
-    src->queued = false;
-    for (auto link : src->outgoing_links) {
-      if (link->metrics.version() == METRIC_VERSION_TOMBSTONE)
+  uint64_t nodes_visited = 0;
+  bool full = false;
+  if (root_index_ == kNoNode) {
+    // Root node as yet unknown: nothing is reachable.
+    for (auto& route : routes_) {
+      route = Route();
+    }
+    routes_valid_ = false;
+  } else if (!routes_valid_ || link_changes.size() * kFullUpdateLinkFraction >
+                                   out_edges_.size()) {
+    nodes_visited = FullRoutes();
+    routes_valid_ = true;
+    full = true;
+  } else if (!link_changes.empty()) {
+    // Nodes whose path from the root got longer (or was removed) lose their
+    // route, along with everything routed through them.
+    const uint64_t affected_mark = ++mark_;
+    std::vector<uint32_t>& affected = scratch_;
+    affected.clear();
+    for (const auto& change : link_changes) {
+      Link* link = change.link;
+      const uint32_t to = link->to_node->index;
+      if (!change.was_routable || routes_[to].link != link ||
+          routes_[to].mark == affected_mark) {
+        continue;
+      }
+      if (link->routable && link->weight <= change.old_weight) {
+        continue;
+      }
+      size_t pos = affected.size();
+      routes_[to].mark = affected_mark;
+      affected.push_back(to);
+      while (pos < affected.size()) {
+        const uint32_t n = affected[pos++];
+        for (uint32_t e = out_offsets_[n]; e < out_offsets_[n + 1]; e++) {
+          const Edge& edge = out_edges_[e];
+          Route& child = routes_[edge.node];
+          if (child.mark != affected_mark && child.link == edge.link) {
+            child.mark = affected_mark;
+            affected.push_back(edge.node);
+          }
+        }
+      }
+    }
+    for (uint32_t n : affected) {
+      routes_[n].reached = false;
+      routes_[n].link = nullptr;
+    }
+
+    // Reconnect affected nodes via their best remaining neighbor, then let
+    // improvements propagate from there and from any links that got shorter
+    // or were added.
+    queue_.clear();
+    for (uint32_t n : affected) {
+      for (uint32_t e = in_offsets_[n]; e < in_offsets_[n + 1]; e++) {
+        const Edge& edge = in_edges_[e];
+        if (routes_[edge.node].reached) {
+          Relax(edge.node, Edge{n, edge.weight, edge.link});
+        }
+      }
+    }
+    for (const auto& change : link_changes) {
+      Link* link = change.link;
+      if (!link->routable) {
         continue;
-      TimeDelta rtt =
-          src->best_rtt + src->metrics.forwarding_time() + link->metrics.rtt();
-      Node* dst = link->to_node;
-      // For now we order by RTT.
-      if (dst->last_path_finding_run != path_finding_run_ ||
-          dst->best_rtt > rtt) {
-        dst->last_path_finding_run = path_finding_run_;
-        dst->best_rtt = rtt;
-        dst->best_from = src;
-        dst->best_link = link;
-        dst->mss = std::min(src->mss, link->metrics.mss());
-        enqueue(dst);
+      }
+      if (change.was_routable && link->weight >= change.old_weight) {
+        continue;
+      }
+      const uint32_t from = link->from_node->index;
+      if (routes_[from].reached) {
+        Relax(from, Edge{link->to_node->index, link->weight, link});
       }
     }
+    nodes_visited = RunQueue();
   }
 
-  SelectedLinks selected_links;
+  // Find the first hop for each reachable node, and collect the nodes whose
+  // selected link changed.
+  const uint64_t resolved_mark = ++mark_;
+  for (const auto& node_id : removed_node_ids_) {
+    route_changes_.emplace_back(RouteChange{node_id, Nothing});
+  }
+  removed_node_ids_.clear();
+  for (uint32_t i = 0; i < nodes_.size(); i++) {
+    Optional<SelectedLink> selected;
+    if (i != root_index_ && routes_[i].reached) {
+      selected = SelectFirstHop(FirstHop(i, resolved_mark), resolved_mark);
+    }
+    Node* node = nodes_[i];
+    if (selected != node->selected) {
+      node->selected = selected;
+      route_changes_.emplace_back(
+          RouteChange{node->metrics.node_id(), selected});
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(mu_);
+  if (full) {
+    stats_.full_updates++;
+  } else if (routes_valid_) {
+    stats_.incremental_updates++;
+  }
+  stats_.nodes_visited += nodes_visited;
+}
+
+uint64_t RoutingTable::FullRoutes() {
+  for (auto& route : routes_) {
+    route.reached = false;
+    route.from = kNoNode;
+    route.link = nullptr;
+  }
+  Route& root = routes_[root_index_];
+  root.reached = true;
+  root.rtt = TimeDelta::Zero();
+  queue_.clear();
+  queue_.push_back(QueuedNode{root.rtt, root_index_});
+  return RunQueue();
+}
 
-  for (node_it = node_metrics_.begin(); node_it != node_metrics_.end();
-       ++node_it) {
-    if (node_it->second.last_path_finding_run != path_finding_run_) {
-      continue;  // Unreachable
+void RoutingTable::Relax(uint32_t from, const Edge& edge) {
+  const TimeDelta rtt = routes_[from].rtt + edge.weight;
+  Route& route = routes_[edge.node];
+  if (route.reached && route.rtt <= rtt) {
+    return;
+  }
+  route.reached = true;
+  route.rtt = rtt;
+  route.from = from;
+  route.link = edge.link;
+  queue_.push_back(QueuedNode{rtt, edge.node});
+  std::push_heap(queue_.begin(), queue_.end(), QueuedLater);
+}
+
+uint64_t RoutingTable::RunQueue() {
+  uint64_t visited = 0;
+  while (!queue_.empty()) {
+    std::pop_heap(queue_.begin(), queue_.end(), QueuedLater);
+    const QueuedNode queued = queue_.back();
+    queue_.pop_back();
+    if (queued.rtt != routes_[queued.node].rtt) {
+      continue;  // Superseded by a shorter path.
     }
-    if (node_it->first == root_node_) {
-      continue;
+    visited++;
+    const uint32_t from = queued.node;
+    for (uint32_t e = out_offsets_[from]; e < out_offsets_[from + 1]; e++) {
+      Relax(from, out_edges_[e]);
     }
-    Node* n = &node_it->second;
-    while (n->best_from->metrics.node_id() != root_node_) {
-      n = n->best_from;
+  }
+  return visited;
+}
+
+RoutingTable::Link* RoutingTable::FirstHop(uint32_t node,
+                                           uint64_t resolved_mark) {
+  // Walk up the tree until reaching a node whose first hop is known, then
+  // record it for every node along the way.
+  std::vector<uint32_t>& path = scratch_;
+  path.clear();
+  Link* first_hop;
+  while (true) {
+    Route& route = routes_[node];
+    if (route.mark == resolved_mark) {
+      first_hop = route.first_hop;
+      break;
+    }
+    if (route.from == root_index_) {
+      first_hop = route.link;
+      route.mark = resolved_mark;
+      route.first_hop = first_hop;
+      break;
     }
-    Link* link = n->best_link;
-    assert(link->metrics.from() == root_node_);
-    selected_links[node_it->first] =
-        SelectedLink{link->metrics.link_label(), n->mss};
+    path.push_back(node);
+    node = route.from;
+  }
+  for (uint32_t n : path) {
+    routes_[n].mark = resolved_mark;
+    routes_[n].first_hop = first_hop;
   }
+  return first_hop;
+}
 
-  return selected_links;
+// Capacity of a link for the purposes of sharing traffic between parallel
+// links: spare bandwidth as estimated by the sender, or if any link lacks an
+// estimate, the inverse of rtt.
+static uint64_t Capacity(const LinkMetrics& m, bool use_bandwidth) {
+  if (use_bandwidth) {
+    return m.bw_link().bits_per_second() - m.bw_used().bits_per_second();
+  }
+  if (m.rtt() == TimeDelta::PositiveInf() || m.rtt().as_us() <= 0) {
+    return 1;
+  }
+  return 1000000000 / m.rtt().as_us() + 1;
+}
+
+const RoutingTable::SelectedLink& RoutingTable::SelectFirstHop(
+    Link* first_hop, uint64_t resolved_mark) {
+  assert(first_hop->metrics.from() == root_node_);
+  SelectedLink& selected = first_hop->selected;
+  if (first_hop->selected_mark == resolved_mark) {
+    return selected;
+  }
+  first_hop->selected_mark = resolved_mark;
+  selected.link_id = first_hop->metrics.link_label();
+  selected.route_mss = first_hop->metrics.mss();
+  selected.multipath.clear();
+
+  // Gather parallel links whose rtt is within 50% of the best of them.
+  std::vector<Link*> parallel;
+  TimeDelta best_rtt = TimeDelta::PositiveInf();
+  const uint32_t to = first_hop->to_node->index;
+  for (uint32_t e = out_offsets_[root_index_];
+       e < out_offsets_[root_index_ + 1]; e++) {
+    const Edge& edge = out_edges_[e];
+    if (edge.node == to) {
+      parallel.push_back(edge.link);
+      best_rtt = std::min(best_rtt, edge.link->metrics.rtt());
+    }
+  }
+  const TimeDelta max_rtt = best_rtt + best_rtt / 2;
+  parallel.erase(std::remove_if(parallel.begin(), parallel.end(),
+                                [max_rtt](Link* link) {
+                                  return link->metrics.rtt() > max_rtt;
+                                }),
+                 parallel.end());
+  if (parallel.size() < 2) {
+    return selected;
+  }
+
+  bool use_bandwidth = true;
+  for (Link* link : parallel) {
+    if (link->metrics.bw_link() <= link->metrics.bw_used()) {
+      use_bandwidth = false;
+    }
+  }
+  uint64_t total_capacity = 0;
+  for (Link* link : parallel) {
+    total_capacity += Capacity(link->metrics, use_bandwidth);
+  }
+  for (Link* link : parallel) {
+    const uint64_t capacity = Capacity(link->metrics, use_bandwidth);
+    const uint32_t share = std::max(
+        uint64_t(1), (kMultipathShares * capacity + total_capacity / 2) /
+                         total_capacity);
+    selected.multipath.push_back(PathLink{link->metrics.link_label(), share});
+    selected.route_mss = std::min(selected.route_mss, link->metrics.mss());
+  }
+  return selected;
 }
 
 }  // namespace overnet
@@ -127,12 +127,32 @@ class RoutingTable {
 
   static constexpr TimeDelta EntryExpiry() { return TimeDelta::FromMinutes(5); }
 
+  // One of several links to a next hop, and its share of the traffic (out of
+  // kMultipathShares).
+  struct PathLink {
+    uint64_t link_id;
+    uint32_t share;
+
+    bool operator==(const PathLink& other) const {
+      return link_id == other.link_id && share == other.share;
+    }
+  };
+  static constexpr uint32_t kMultipathShares = 16;
+
   struct SelectedLink {
     uint64_t link_id;
     uint32_t route_mss;
-
-    bool operator==(SelectedLink other) const {
-      return link_id == other.link_id && route_mss == other.route_mss;
+    // If there are several links of similar cost to the next hop (e.g. USB and
+    // WLAN between the same two devices), traffic may be spread across all of
+    // them. Empty otherwise.
+    std::vector<PathLink> multipath;
+
+    bool operator==(const SelectedLink& other) const {
+      return link_id == other.link_id && route_mss == other.route_mss &&
+             multipath == other.multipath;
+    }
+    bool operator!=(const SelectedLink& other) const {
+      return !operator==(other);
     }
   };
   using SelectedLinks = std::unordered_map<NodeId, SelectedLink>;
@@ -151,14 +171,26 @@ class RoutingTable {
       published_links_version_ = selected_links_version_;
       f(selected_links_);
     }
-    const bool done = !processing_changes_.has_value();
+    const bool done = Idle();
     mu_.unlock();
     return done;
   }
 
   void BlockUntilNoBackgroundUpdatesProcessing() {
     std::unique_lock<std::mutex> lock(mu_);
-    cv_.wait(lock, [this]() -> bool { return !processing_changes_; });
+    cv_.wait(lock, [this]() -> bool { return Idle(); });
+  }
+
+  // Counters describing how routes have been recomputed.
+  struct Stats {
+    uint64_t full_updates = 0;
+    uint64_t incremental_updates = 0;
+    // Nodes whose distance from the root was recomputed.
+    uint64_t nodes_visited = 0;
+  };
+  Stats stats() {
+    std::lock_guard<std::mutex> lock(mu_);
+    return stats_;
   }
 
  private:
@@ -179,25 +211,55 @@ class RoutingTable {
   const bool allow_threading_;
   bool flush_requested_ = false;
 
+  // Returns true if there are no queued changes and none being processed.
+  // Requires mu_.
+  bool Idle() const {
+    return !processing_ && change_log_.Empty() && !flush_requested_;
+  }
+
+  void RunWorker();
+  void ProcessChanges(TimeStamp now, const Metrics& changes, bool flush);
   void ApplyChanges(TimeStamp now, const Metrics& changes, bool flush);
-  SelectedLinks BuildForwardingTable();
+  void UpdateRoutes();
 
   TimeStamp last_update_{TimeStamp::Epoch()};
-  uint64_t path_finding_run_ = 0;
 
   std::mutex mu_;
   std::condition_variable cv_;
-  Optional<std::thread> processing_changes_;
+  // Worker thread processing changes when allow_threading_ is set. Started by
+  // the first Update() and runs until destruction.
+  Optional<std::thread> worker_;
+  bool stopping_ = false;
+  bool processing_ = false;
+  Stats stats_;
+
+  // Everything below is only touched by whichever thread is processing changes.
 
   struct Node;
 
   struct Link {
-    Link(TimeStamp now, LinkMetrics initial_metrics, Node* to)
-        : metrics(initial_metrics), last_updated(now), to_node(to) {}
+    Link(TimeStamp now, LinkMetrics initial_metrics, Node* from, Node* to)
+        : metrics(initial_metrics),
+          last_updated(now),
+          from_node(from),
+          to_node(to) {}
     LinkMetrics metrics;
     TimeStamp last_updated;
     InternalListNode<Link> outgoing_link;
+    Node* const from_node;
     Node* const to_node;
+
+    // Graph state as of the last route update.
+    bool dirty = false;
+    bool routable = false;
+    TimeDelta weight{TimeDelta::PositiveInf()};
+    uint32_t out_edge;
+    uint32_t in_edge;
+
+    // Selection for destinations using this link as their first hop, cached
+    // for one route update.
+    uint64_t selected_mark = 0;
+    SelectedLink selected;
   };
 
   struct Node {
@@ -207,21 +269,82 @@ class RoutingTable {
     TimeStamp last_updated;
     InternalList<Link, &Link::outgoing_link> outgoing_links;
 
-    // Path finding temporary state.
-    uint64_t last_path_finding_run = 0;
-    TimeDelta best_rtt{TimeDelta::Zero()};
-    Node* best_from;
-    Link* best_link;
-    uint32_t mss;
-    bool queued = false;
-    InternalListNode<Node> path_finding_node;
+    uint32_t index;
+    bool expired = false;
+    // Route last published for this node.
+    Optional<SelectedLink> selected;
   };
 
   void RemoveOutgoingLinks(Node& node);
+  void MarkDirty(Link* link);
 
   std::unordered_map<NodeId, Node> node_metrics_;
   std::unordered_map<routing_table_impl::FullLinkLabel, Link> link_metrics_;
 
+  // Changes applied since the last route update.
+  std::vector<Link*> dirty_links_;
+  bool graph_changed_ = false;
+  bool nodes_removed_ = false;
+  std::vector<NodeId> removed_node_ids_;
+
+  // Compact adjacency representation of routable links: the edges leaving
+  // (entering) node i are out_edges_[out_offsets_[i]..out_offsets_[i+1]) (and
+  // likewise for in_edges_). Rebuilt when links are added or removed; weights
+  // are updated in place.
+  struct Edge {
+    uint32_t node;
+    TimeDelta weight{TimeDelta::PositiveInf()};
+    Link* link;
+  };
+  std::vector<Node*> nodes_;
+  std::vector<uint32_t> out_offsets_;
+  std::vector<Edge> out_edges_;
+  std::vector<uint32_t> in_offsets_;
+  std::vector<Edge> in_edges_;
+
+  void RebuildGraph();
+
+  // Shortest path tree, indexed like nodes_.
+  static constexpr uint32_t kNoNode = ~uint32_t(0);
+  struct Route {
+    bool reached = false;
+    TimeDelta rtt{TimeDelta::PositiveInf()};
+    uint32_t from = kNoNode;
+    Link* link = nullptr;
+    // Scratch state for route updates.
+    uint64_t mark = 0;
+    Link* first_hop = nullptr;
+  };
+  std::vector<Route> routes_;
+  uint32_t root_index_ = kNoNode;
+  bool routes_valid_ = false;
+  uint64_t mark_ = 0;
+
+  // Path finding priority queue, a min-heap on rtt.
+  struct QueuedNode {
+    TimeDelta rtt;
+    uint32_t node;
+  };
+  static bool QueuedLater(const QueuedNode& a, const QueuedNode& b) {
+    return a.rtt > b.rtt;
+  }
+  std::vector<QueuedNode> queue_;
+  std::vector<uint32_t> scratch_;
+
+  // Returns the number of nodes visited.
+  uint64_t FullRoutes();
+  uint64_t IncrementalRoutes();
+  void Relax(uint32_t from, const Edge& edge);
+  uint64_t RunQueue();
+  Link* FirstHop(uint32_t node, uint64_t resolved_mark);
+  const SelectedLink& SelectFirstHop(Link* first_hop, uint64_t resolved_mark);
+
+  struct RouteChange {
+    NodeId node;
+    Optional<SelectedLink> link;
+  };
+  std::vector<RouteChange> route_changes_;
+
   uint64_t selected_links_version_ = 0;
   SelectedLinks selected_links_;
   uint64_t published_links_version_ = 0;
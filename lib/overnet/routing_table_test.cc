@@ -0,0 +1,253 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "routing_table.h"
+#include <chrono>
+#include <random>
+#include "benchmark_summary.h"
+#include "gtest/gtest.h"
+#include "test_timer.h"
+
+namespace overnet {
+namespace routing_table_test {
+
+static const NodeId kRoot(1);
+
+// Latest metrics for a randomly generated mesh of nodes, from which updates are
+// drawn.
+class Mesh {
+ public:
+  Mesh(size_t num_nodes, size_t links_per_node, uint64_t max_rtt_us,
+       uint64_t seed)
+      : rng_(seed), max_rtt_us_(max_rtt_us) {
+    for (size_t i = 0; i < num_nodes; i++) {
+      NodeMetrics m(NodeId(i + 1), 1);
+      m.set_forwarding_time(TimeDelta::FromMicroseconds(100));
+      nodes_.push_back(m);
+    }
+    // A ring keeps everything connected, random chords keep paths short.
+    for (size_t i = 0; i < num_nodes; i++) {
+      AddBidirectionalLink(i, (i + 1) % num_nodes);
+      for (size_t j = 1; j < links_per_node / 2; j++) {
+        AddBidirectionalLink(i, RandomNode());
+      }
+    }
+  }
+
+  const std::vector<NodeMetrics>& nodes() const { return nodes_; }
+  const std::vector<LinkMetrics>& links() const { return links_; }
+
+  size_t RandomNode() { return rng_() % nodes_.size(); }
+  size_t RandomLink() { return rng_() % links_.size(); }
+
+  // Changes the rtt of a link, returning the new metrics.
+  LinkMetrics ChangeRtt(size_t link) {
+    LinkMetrics& m = links_[link];
+    if (m.version() == METRIC_VERSION_TOMBSTONE) {
+      return m;
+    }
+    LinkMetrics updated(m.from(), m.to(), m.version() + 1, m.link_label());
+    updated.set_rtt(RandomRtt());
+    updated.set_mss(m.mss());
+    m = updated;
+    return m;
+  }
+
+  LinkMetrics RemoveLink(size_t link) {
+    LinkMetrics& m = links_[link];
+    m = LinkMetrics(m.from(), m.to(), METRIC_VERSION_TOMBSTONE,
+                    m.link_label());
+    return m;
+  }
+
+  LinkMetrics AddLink() {
+    AddLink(RandomNode(), RandomNode());
+    return links_.back();
+  }
+
+  NodeMetrics ChangeForwardingTime(size_t node) {
+    NodeMetrics& m = nodes_[node];
+    NodeMetrics updated(m.node_id(), m.version() + 1);
+    updated.set_forwarding_time(RandomRtt());
+    m = updated;
+    return m;
+  }
+
+ private:
+  TimeDelta RandomRtt() {
+    return TimeDelta::FromMicroseconds(1 + rng_() % max_rtt_us_);
+  }
+
+  void AddLink(size_t from, size_t to) {
+    LinkMetrics m(nodes_[from].node_id(), nodes_[to].node_id(), 1,
+                  next_label_++);
+    m.set_rtt(RandomRtt());
+    m.set_mss(1000 + rng_() % 1000);
+    links_.push_back(m);
+  }
+
+  void AddBidirectionalLink(size_t a, size_t b) {
+    AddLink(a, b);
+    AddLink(b, a);
+  }
+
+  std::mt19937_64 rng_;
+  const uint64_t max_rtt_us_;
+  uint64_t next_label_ = 1;
+  std::vector<NodeMetrics> nodes_;
+  std::vector<LinkMetrics> links_;
+};
+
+// Tracks the links published by a routing table.
+class Published {
+ public:
+  explicit Published(RoutingTable* table) : table_(table) {}
+
+  const RoutingTable::SelectedLinks& Get() {
+    table_->BlockUntilNoBackgroundUpdatesProcessing();
+    while (!table_->PollLinkUpdates(
+        [this](const RoutingTable::SelectedLinks& selected_links) {
+          selected_links_ = selected_links;
+        })) {
+    }
+    return selected_links_;
+  }
+
+ private:
+  RoutingTable* const table_;
+  RoutingTable::SelectedLinks selected_links_;
+};
+
+RoutingTable::SelectedLinks FromScratch(const Mesh& mesh) {
+  TestTimer timer;
+  RoutingTable table(kRoot, &timer, TraceSink(), false);
+  table.Update(mesh.nodes(), mesh.links(), false);
+  return Published(&table).Get();
+}
+
+void ExpectIncrementalMatchesFromScratch(bool allow_threading) {
+  // Random rtts over a wide range make equal cost paths unlikely, so the
+  // selected links are well defined.
+  Mesh mesh(200, 6, uint64_t(1) << 40, 123);
+  TestTimer timer;
+  RoutingTable table(kRoot, &timer, TraceSink(), allow_threading);
+  Published published(&table);
+  table.Update(mesh.nodes(), mesh.links(), false);
+  EXPECT_EQ(FromScratch(mesh), published.Get());
+  EXPECT_EQ(mesh.nodes().size() - 1, published.Get().size());
+
+  std::mt19937_64 rng(456);
+  for (int round = 0; round < 100; round++) {
+    std::vector<NodeMetrics> node_updates;
+    std::vector<LinkMetrics> link_updates;
+    const int num_changes = 1 + rng() % 4;
+    for (int i = 0; i < num_changes; i++) {
+      switch (rng() % 10) {
+        case 0:
+          link_updates.push_back(mesh.RemoveLink(mesh.RandomLink()));
+          break;
+        case 1:
+          link_updates.push_back(mesh.AddLink());
+          break;
+        case 2:
+          node_updates.push_back(
+              mesh.ChangeForwardingTime(mesh.RandomNode()));
+          break;
+        default:
+          link_updates.push_back(mesh.ChangeRtt(mesh.RandomLink()));
+          break;
+      }
+    }
+    table.Update(std::move(node_updates), std::move(link_updates), false);
+    ASSERT_EQ(FromScratch(mesh), published.Get()) << "round " << round;
+  }
+
+  const auto stats = table.stats();
+  EXPECT_EQ(1u, stats.full_updates);
+  EXPECT_GT(stats.incremental_updates, 0u);
+}
+
+TEST(RoutingTable, IncrementalMatchesFromScratch) {
+  ExpectIncrementalMatchesFromScratch(false);
+}
+
+TEST(RoutingTable, IncrementalMatchesFromScratchThreaded) {
+  ExpectIncrementalMatchesFromScratch(true);
+}
+
+TEST(RoutingTable, FlushRemovesExpiredNodes) {
+  TestTimer timer;
+  RoutingTable table(kRoot, &timer, TraceSink(), false);
+  Published published(&table);
+
+  const NodeId a(2);
+  const NodeId b(3);
+  auto link = [](NodeId from, NodeId to, uint64_t version, uint64_t label) {
+    LinkMetrics m(from, to, version, label);
+    m.set_rtt(TimeDelta::FromMilliseconds(1));
+    m.set_mss(1000);
+    return m;
+  };
+  table.Update({NodeMetrics(kRoot, 1), NodeMetrics(a, 1), NodeMetrics(b, 1)},
+               {link(kRoot, a, 1, 1), link(a, b, 1, 2)}, false);
+  EXPECT_EQ((RoutingTable::SelectedLinks{{a, {1, 1000}}, {b, {1, 1000}}}),
+            published.Get());
+
+  // Only the link to a is refreshed, so b expires.
+  timer.Step(RoutingTable::EntryExpiry().as_us() / 2);
+  table.Update({}, {link(kRoot, a, 2, 1)}, false);
+  timer.Step(RoutingTable::EntryExpiry().as_us() / 2 + 1);
+  table.Update({}, {}, true);
+  EXPECT_EQ((RoutingTable::SelectedLinks{{a, {1, 1000}}}), published.Get());
+
+  // b can come back.
+  table.Update({NodeMetrics(b, 2)}, {link(a, b, 3, 2)}, false);
+  EXPECT_EQ((RoutingTable::SelectedLinks{{a, {1, 1000}}, {b, {1, 1000}}}),
+            published.Get());
+}
+
+// Reports the cost of building routes for meshes of various sizes, and of
+// updating them after a single link changes.
+TEST(RoutingTable, Benchmark) {
+  using Clock = std::chrono::steady_clock;
+  auto us_since = [](Clock::time_point start) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() -
+                                                                 start)
+        .count();
+  };
+
+  static constexpr int kUpdates = 100;
+  BenchmarkSummary writer;
+  for (size_t num_nodes : {100, 1000, 10000}) {
+    Mesh mesh(num_nodes, 6, 100000, num_nodes);
+    TestTimer timer;
+    RoutingTable table(kRoot, &timer, TraceSink(), false);
+    Published published(&table);
+
+    auto start = Clock::now();
+    table.Update(mesh.nodes(), mesh.links(), false);
+    const auto build_us = us_since(start);
+    EXPECT_EQ(num_nodes - 1, published.Get().size());
+
+    start = Clock::now();
+    for (int i = 0; i < kUpdates; i++) {
+      table.Update({}, {mesh.ChangeRtt(mesh.RandomLink())}, false);
+    }
+    const auto update_us = us_since(start) / kUpdates;
+    const auto stats = table.stats();
+
+    writer.Put("nodes", num_nodes)
+        .Put("links", mesh.links().size())
+        .Put("build_us", build_us)
+        .Put("update_us", update_us)
+        .Put("nodes_visited_per_update",
+             static_cast<double>(stats.nodes_visited - num_nodes) / kUpdates)
+        .Put("full_updates", stats.full_updates)
+        .Put("incremental_updates", stats.incremental_updates);
+    writer.EndRow();
+  }
+}
+
+}  // namespace routing_table_test
+}  // namespace overnet
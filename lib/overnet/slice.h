@@ -130,6 +130,7 @@ class Slice final {
       total_length += it->length();
     }
 
+    Static<>::bytes_copied_ += total_length;
     return Slice::WithInitializerAndPrefix(
         total_length, desired_prefix, [begin, end](uint8_t* out) {
           size_t offset = 0;
@@ -140,8 +141,13 @@ class Slice final {
         });
   }
 
+  // Returns a slice with |length| bytes initialized by |initializer| followed
+  // by the contents of this slice. If there's no room to add the prefix in
+  // place the contents are copied, leaving room for a further |desired_prefix|
+  // bytes of prefix in the copy.
   template <class F>
-  Slice WithPrefix(size_t length, F initializer) const {
+  Slice WithPrefix(size_t length, F initializer,
+                   size_t desired_prefix = 0) const {
     Data new_slice_data;
     if (uint8_t* prefix =
             vtable_->maybe_add_prefix(&data_, length, &new_slice_data)) {
@@ -150,8 +156,9 @@ class Slice final {
     } else {
       size_t own_length = this->length();
       const uint8_t* begin = this->begin();
-      return WithInitializer(
-          own_length + length,
+      Static<>::bytes_copied_ += own_length;
+      return WithInitializerAndPrefix(
+          own_length + length, desired_prefix,
           [length, own_length, initializer, begin](uint8_t* p) {
             initializer(p);
             memcpy(p + length, begin, own_length);
@@ -159,6 +166,24 @@ class Slice final {
     }
   }
 
+  // Adds a prefix of |length| bytes initialized by |initializer| in place if
+  // there's room, returning false (and leaving this slice untouched) if not.
+  template <class F>
+  bool MaybeAddPrefixInPlace(size_t length, F initializer) {
+    Data new_slice_data;
+    if (uint8_t* prefix =
+            vtable_->maybe_add_prefix(&data_, length, &new_slice_data)) {
+      initializer(prefix);
+      Slice{vtable_, new_slice_data}.Swap(this);
+      return true;
+    }
+    return false;
+  }
+
+  // Number of bytes of existing slices copied on this thread by WithPrefix and
+  // Join, for measuring the cost of framing.
+  static uint64_t BytesCopied() { return Static<>::bytes_copied_; }
+
   std::string AsStdString() const { return std::string(begin(), end()); }
 
   /////////////////////////////////////////////////////////////////////////////
@@ -342,9 +367,13 @@ class Slice final {
     static const VTable small_vtable_;
     static const VTable const_vtable_;
     static const VTable block_vtable_;
+    static thread_local uint64_t bytes_copied_;
   };
 };
 
+template <int I>
+thread_local uint64_t Slice::Static<I>::bytes_copied_ = 0;
+
 template <int I>
 const Slice::VTable Slice::Static<I>::small_vtable_ = {
     // begin
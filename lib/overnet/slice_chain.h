@@ -0,0 +1,77 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <vector>
+#include "slice.h"
+
+namespace overnet {
+
+// A sequence of slices that together form one run of bytes. Framing code can
+// prefix headers and append payloads to a chain without copying any of them;
+// the chain is flattened (or gathered, as with sendmsg) only where a single
+// buffer is finally needed.
+class SliceChain final {
+ public:
+  SliceChain() {}
+  explicit SliceChain(Slice slice) { Append(std::move(slice)); }
+
+  size_t length() const { return length_; }
+  bool empty() const { return length_ == 0; }
+
+  void Append(Slice slice) {
+    if (slice.length() == 0)
+      return;
+    length_ += slice.length();
+    slices_.emplace_back(std::move(slice));
+  }
+
+  void Append(SliceChain chain) {
+    for (auto& slice : chain.slices_) {
+      Append(std::move(slice));
+    }
+  }
+
+  void Prepend(Slice slice) {
+    if (slice.length() == 0)
+      return;
+    length_ += slice.length();
+    slices_.emplace(slices_.begin(), std::move(slice));
+  }
+
+  // Adds a prefix of |length| bytes initialized by |initializer|: in place in
+  // the first slice if there's room, otherwise as a new slice.
+  template <class F>
+  void AddPrefix(size_t length, F initializer) {
+    if (!slices_.empty() &&
+        slices_.front().MaybeAddPrefixInPlace(length, initializer)) {
+      length_ += length;
+      return;
+    }
+    Prepend(Slice::WithInitializer(length, initializer));
+  }
+
+  // Visits each slice in order, e.g. to build an iovec for a gathering write.
+  template <class F>
+  void ForEachSlice(F f) const {
+    for (const auto& slice : slices_) {
+      f(slice);
+    }
+  }
+
+  size_t slice_count() const { return slices_.size(); }
+
+  // Returns the chain as one slice, copying unless it's already a single
+  // slice. A copy leaves room for |desired_prefix| bytes of prefix.
+  Slice Flatten(size_t desired_prefix = 0) const {
+    return Slice::Join(slices_.begin(), slices_.end(), desired_prefix);
+  }
+
+ private:
+  std::vector<Slice> slices_;
+  size_t length_ = 0;
+};
+
+}  // namespace overnet
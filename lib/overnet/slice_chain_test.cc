@@ -0,0 +1,73 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "slice_chain.h"
+#include "gtest/gtest.h"
+
+namespace overnet {
+namespace slice_chain_test {
+
+TEST(SliceChain, Empty) {
+  SliceChain chain;
+  EXPECT_TRUE(chain.empty());
+  EXPECT_EQ(0u, chain.length());
+  EXPECT_EQ(Slice(), chain.Flatten());
+}
+
+TEST(SliceChain, AppendAndPrepend) {
+  SliceChain chain(Slice::FromStaticString("b"));
+  chain.Append(Slice::FromStaticString("cd"));
+  chain.Prepend(Slice::FromStaticString("a"));
+  chain.Append(Slice());
+  SliceChain tail(Slice::FromStaticString("ef"));
+  chain.Append(std::move(tail));
+  EXPECT_EQ(6u, chain.length());
+  EXPECT_EQ(4u, chain.slice_count());
+  EXPECT_EQ(Slice::FromStaticString("abcdef"), chain.Flatten());
+
+  std::string gathered;
+  chain.ForEachSlice(
+      [&gathered](const Slice& slice) { gathered += slice.AsStdString(); });
+  EXPECT_EQ("abcdef", gathered);
+}
+
+TEST(SliceChain, AddPrefixDoesNotCopy) {
+  const std::string payload(100, 'x');
+  SliceChain chain(Slice::FromCopiedBuffer(payload.data(), payload.length()));
+  const uint64_t copied_before = Slice::BytesCopied();
+  chain.AddPrefix(2, [](uint8_t* p) {
+    p[0] = 'h';
+    p[1] = 'd';
+  });
+  chain.AddPrefix(1, [](uint8_t* p) { *p = 'l'; });
+  EXPECT_EQ(copied_before, Slice::BytesCopied());
+  EXPECT_EQ(103u, chain.length());
+  // The second prefix fits in front of the first (small) header slice.
+  EXPECT_EQ(2u, chain.slice_count());
+  EXPECT_EQ("lhd" + payload, chain.Flatten().AsStdString());
+}
+
+TEST(SliceChain, AddPrefixInPlace) {
+  SliceChain chain(Slice::WithInitializerAndPrefix(
+      100, 8, [](uint8_t* p) { memset(p, 'x', 100); }));
+  chain.AddPrefix(8, [](uint8_t* p) { memset(p, 'h', 8); });
+  EXPECT_EQ(1u, chain.slice_count());
+  EXPECT_EQ(std::string(8, 'h') + std::string(100, 'x'),
+            chain.Flatten().AsStdString());
+}
+
+TEST(SliceChain, FlattenLeavesRoomForPrefix) {
+  SliceChain chain(Slice::RepeatedChar(50, 'a'));
+  chain.Append(Slice::RepeatedChar(50, 'b'));
+  const uint64_t copied_before = Slice::BytesCopied();
+  Slice flat = chain.Flatten(4);
+  EXPECT_EQ(copied_before + 100, Slice::BytesCopied());
+  Slice prefixed = flat.WithPrefix(4, [](uint8_t* p) { memset(p, 'p', 4); });
+  EXPECT_EQ(copied_before + 100, Slice::BytesCopied());
+  EXPECT_EQ(std::string(4, 'p') + std::string(50, 'a') + std::string(50, 'b'),
+            prefixed.AsStdString());
+}
+
+}  // namespace slice_chain_test
+}  // namespace overnet
@@ -3,7 +3,10 @@
 // found in the LICENSE file.
 
 #include <dlfcn.h>
+#include <zircon/syscalls.h>
+#include <algorithm>
 #include <cmath>
+#include <memory>
 
 #include "garnet/bin/media/audio_core/mixer/fx_loader.h"
 #include "garnet/bin/media/audio_core/mixer/fx_processor.h"
@@ -917,5 +920,153 @@ TEST_F(FxProcessorTest, ProcessInPlaceFlush) {
   EXPECT_EQ(fx_processor_->Flush(), ZX_OK);
 }
 
+// Verify out-of-place processing through a chain that changes channelization.
+TEST_F(FxProcessorTest, Process_Rechannel) {
+  constexpr uint32_t kNumFrames = 2;
+  float buff_in[kNumFrames * DfxRechannel::kNumChannelsIn] = {
+      1.0f,  -1.0f, 0.25f, -1.0f, 0.98765432f, -0.09876544f,
+      -1.0f, 1.0f,  0.0f,  0.0f,  0.0f,        0.0f};
+  float buff_out[kNumFrames * DfxRechannel::kNumChannelsOut] = {0.0f};
+  // Rechannel (see FxRechannelTest.Process), then swap left and right.
+  float expected[kNumFrames * DfxRechannel::kNumChannelsOut] = {
+      -0.340580851f, 0.799536645f, 0.369398062f, -0.369398062f};
+
+  // An empty chain has no defined channelization, so it cannot Process.
+  EXPECT_EQ(fx_processor_->Process(kNumFrames, buff_in, buff_out),
+            ZX_ERR_BAD_STATE);
+
+  fx_token_t swap_token = fx_processor_->CreateFx(
+      Effect::Swap, DfxSwap::kNumChannelsIn, DfxSwap::kNumChannelsOut, 0);
+  ASSERT_NE(swap_token, FUCHSIA_AUDIO_DFX_INVALID_TOKEN);
+  fx_token_t rechannel_token = fx_processor_->CreateFx(
+      Effect::Rechannel, DfxRechannel::kNumChannelsIn,
+      DfxRechannel::kNumChannelsOut, 1);
+  ASSERT_NE(rechannel_token, FUCHSIA_AUDIO_DFX_INVALID_TOKEN);
+
+  // [swap, rechannel] is mismatched: swap emits 2 chans, rechannel wants 6.
+  EXPECT_EQ(fx_processor_->Process(kNumFrames, buff_in, buff_out),
+            ZX_ERR_BAD_STATE);
+
+  // [rechannel, swap] is 6-in, 2-out.
+  ASSERT_EQ(fx_processor_->ReorderFx(rechannel_token, 0), ZX_OK);
+  EXPECT_EQ(fx_processor_->channels_in(), DfxRechannel::kNumChannelsIn);
+  EXPECT_EQ(fx_processor_->channels_out(), DfxSwap::kNumChannelsOut);
+
+  ASSERT_EQ(fx_processor_->Process(kNumFrames, buff_in, buff_out), ZX_OK);
+  for (uint32_t sample = 0;
+       sample < kNumFrames * DfxRechannel::kNumChannelsOut; ++sample) {
+    EXPECT_FLOAT_EQ(buff_out[sample], expected[sample]) << sample;
+  }
+
+  // Zero num_frames is valid, but null buffers are not.
+  EXPECT_EQ(fx_processor_->Process(0, buff_in, buff_out), ZX_OK);
+  EXPECT_NE(fx_processor_->Process(0, nullptr, buff_out), ZX_OK);
+  EXPECT_NE(fx_processor_->Process(0, buff_in, nullptr), ZX_OK);
+}
+
+// Verify that requests larger than the block size are processed seamlessly.
+TEST_F(FxProcessorTest, Process_MultipleBlocks) {
+  constexpr uint32_t kBlockFrames = 4;
+  constexpr uint32_t kNumFrames = kBlockFrames * 2 + 1;
+  audio::FxProcessor processor(&fx_loader_, 48000, kBlockFrames);
+
+  fx_token_t delay_token =
+      processor.CreateFx(Effect::Delay, kTestChans, kTestChans, 0);
+  ASSERT_NE(delay_token, FUCHSIA_AUDIO_DFX_INVALID_TOKEN);
+  ASSERT_EQ(fx_loader_.FxSetControlValue(delay_token, 0, kTestDelay1), ZX_OK);
+
+  float buff_in[kNumFrames * kTestChans];
+  float buff_out[kNumFrames * kTestChans];
+  for (uint32_t sample = 0; sample < kNumFrames * kTestChans; ++sample) {
+    buff_in[sample] = static_cast<float>(sample + 1);
+  }
+
+  ASSERT_EQ(processor.Process(kNumFrames, buff_in, buff_out), ZX_OK);
+  EXPECT_EQ(buff_out[0], 0.0f);
+  EXPECT_EQ(buff_out[1], 0.0f);
+  for (uint32_t sample = kTestChans; sample < kNumFrames * kTestChans;
+       ++sample) {
+    EXPECT_EQ(buff_out[sample], buff_in[sample - kTestChans]) << sample;
+  }
+}
+
+// Control changes are queued, and take effect at the next Process call.
+TEST_F(FxProcessorTest, SetControlValue) {
+  float buff[kTestChans] = {1.0f, -1.0f};
+
+  fx_token_t delay_token =
+      fx_processor_->CreateFx(Effect::Delay, kTestChans, kTestChans, 0);
+  ASSERT_NE(delay_token, FUCHSIA_AUDIO_DFX_INVALID_TOKEN);
+
+  ASSERT_EQ(fx_processor_->SetControlValue(delay_token, 0, kTestDelay1), ZX_OK);
+  float value;
+  ASSERT_EQ(fx_loader_.FxGetControlValue(delay_token, 0, &value), ZX_OK);
+  EXPECT_NE(value, kTestDelay1);
+
+  ASSERT_EQ(fx_processor_->ProcessInPlace(1, buff), ZX_OK);
+  ASSERT_EQ(fx_loader_.FxGetControlValue(delay_token, 0, &value), ZX_OK);
+  EXPECT_EQ(value, kTestDelay1);
+  EXPECT_EQ(buff[0], 0.0f);
+
+  // The queue is bounded; once full, callers must wait for the mix thread.
+  uint32_t num_queued = 0;
+  while (fx_processor_->SetControlValue(delay_token, 0, kTestDelay2) == ZX_OK) {
+    ++num_queued;
+    ASSERT_LE(num_queued, audio::FxProcessor::kMaxPendingControlChanges);
+  }
+  EXPECT_EQ(num_queued, audio::FxProcessor::kMaxPendingControlChanges);
+  EXPECT_EQ(fx_processor_->ProcessInPlace(0, buff), ZX_OK);
+  EXPECT_EQ(fx_processor_->SetControlValue(delay_token, 0, kTestDelay2), ZX_OK);
+
+  EXPECT_NE(fx_processor_->SetControlValue(FUCHSIA_AUDIO_DFX_INVALID_TOKEN, 0,
+                                           kTestDelay1),
+            ZX_OK);
+}
+
+// Not a pass/fail test: display the time taken to run a typical 10-ms block
+// through a 5.1-to-stereo chain, in-place stages included, out-of-place.
+TEST_F(FxProcessorTest, ProcessChainProfile) {
+  constexpr uint32_t kFrameRate = 48000;
+  constexpr uint32_t kNumFrames = kFrameRate / 100;
+  constexpr uint32_t kNumRuns = 2000;
+
+  audio::FxProcessor processor(&fx_loader_, kFrameRate);
+  ASSERT_NE(processor.CreateFx(Effect::Rechannel, DfxRechannel::kNumChannelsIn,
+                               DfxRechannel::kNumChannelsOut, 0),
+            FUCHSIA_AUDIO_DFX_INVALID_TOKEN);
+  ASSERT_NE(processor.CreateFx(Effect::Swap, kTestChans, kTestChans, 1),
+            FUCHSIA_AUDIO_DFX_INVALID_TOKEN);
+  fx_token_t delay_token =
+      processor.CreateFx(Effect::Delay, kTestChans, kTestChans, 2);
+  ASSERT_NE(delay_token, FUCHSIA_AUDIO_DFX_INVALID_TOKEN);
+  ASSERT_EQ(processor.SetControlValue(delay_token, 0, kTestDelay2), ZX_OK);
+
+  auto buff_in =
+      std::make_unique<float[]>(kNumFrames * DfxRechannel::kNumChannelsIn);
+  auto buff_out =
+      std::make_unique<float[]>(kNumFrames * DfxRechannel::kNumChannelsOut);
+  for (uint32_t sample = 0; sample < kNumFrames * DfxRechannel::kNumChannelsIn;
+       ++sample) {
+    buff_in[sample] = (sample % 2 ? 0.5f : -0.5f);
+  }
+
+  zx_duration_t worst = 0, total = 0;
+  for (uint32_t run = 0; run < kNumRuns; ++run) {
+    zx_time_t start_time = zx_clock_get(ZX_CLOCK_MONOTONIC);
+    ASSERT_EQ(processor.Process(kNumFrames, buff_in.get(), buff_out.get()),
+              ZX_OK);
+    zx_duration_t elapsed = zx_clock_get(ZX_CLOCK_MONOTONIC) - start_time;
+
+    worst = std::max(worst, elapsed);
+    total += elapsed;
+  }
+
+  printf("\n   Rechannel-Swap-Delay chain, %u frames, %u runs\n", kNumFrames,
+         kNumRuns);
+  printf("   Mean: %.3f ns/frame\tWorst: %.3f ns/frame\n",
+         static_cast<double>(total) / kNumRuns / kNumFrames,
+         static_cast<double>(worst) / kNumFrames);
+}
+
 }  // namespace audio_dfx_test
 }  // namespace media